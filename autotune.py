@@ -0,0 +1,222 @@
+#!/usr/bin/env python3
+#
+#  Copyright (c) 2023, Intel Corporation
+#  All rights reserved.
+#
+#  Redistribution and use in source and binary forms, with or without
+#  modification, are permitted provided that the following conditions are
+#  met:
+#
+#    * Redistributions of source code must retain the above copyright
+#      notice, this list of conditions and the following disclaimer.
+#
+#    * Redistributions in binary form must reproduce the above copyright
+#      notice, this list of conditions and the following disclaimer in the
+#      documentation and/or other materials provided with the distribution.
+#
+#    * Neither the name of Intel Corporation nor the names of its
+#      contributors may be used to endorse or promote products derived from
+#      this software without specific prior written permission.
+#
+#
+#   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+#   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+#   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+#   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+#   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+#   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+#   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+#   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+#   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+#   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+
+
+# Autotuner of the benchmarks (benchmarks/cmake/AddBenchmark.cmake). It builds
+# a benchmark for every point of a search space of ISPC targets, --opt variants
+# and values of macros of the kernel (e.g. an unroll count or a task grain size),
+# runs it on the host and writes the fastest configuration to a CMake file,
+# which the benchmarks build reads with -DBENCHMARKS_TUNING_FILE=<file>:
+#
+#   autotune.py -b 06_sgemm -t avx2-i32x8,avx2-i32x16 -D TILE_ROWS=2,4,8 -o tuning.cmake
+#
+# The score of a configuration is the geomean of the median real time of the
+# benchmark cases over the repetitions, the lower the better. Configurations
+# which fail to build or to run (e.g. a target the host doesn't support) are
+# skipped. The file keeps the configurations of the other benchmarks, so one
+# file per host can be grown by running the autotuner for several benchmarks.
+
+import glob
+import itertools
+import json
+import os
+import platform
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+from optparse import OptionParser
+
+import common
+import perf
+
+# Multipliers to nanoseconds of the Google Benchmark time units.
+TIME_UNITS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+def parse_defines(defines):
+    space = []
+    for define in defines:
+        if define.find("=") == -1:
+            common.error("expected NAME=value1,value2... for --define, found \"%s\"" % define, 1)
+        name, values = define.split("=", 1)
+        space.append([(name, v) for v in values.split(",")])
+    return space
+
+# All configurations of the search space, as (targets, flags, label) tuples.
+def search_space(options):
+    targets = [t for t in options.targets.split(";") if t]
+    opts = options.opt.split(",")
+    defines = parse_defines(options.defines)
+    configs = []
+    for target, opt in itertools.product(targets, opts):
+        for values in itertools.product(*defines):
+            flags = options.flags.split() + perf.opt_flags(opt)
+            flags += ["-D%s=%s" % (name, value) for name, value in values]
+            label = " ".join([target] + flags[len(options.flags.split()):])
+            configs.append((target, " ".join(flags), label))
+    return configs
+
+def host_cpu():
+    try:
+        with open("/proc/cpuinfo", 'r') as f:
+            for line in f:
+                if line.startswith("model name"):
+                    return line.split(":", 1)[1].strip()
+    except OSError:
+        pass
+    return platform.processor() or platform.machine()
+
+def run_command(cmd, log):
+    with open(log, 'a') as f:
+        f.write(" ".join(cmd) + "\n")
+        f.flush()
+        return subprocess.call(cmd, stdout=f, stderr=subprocess.STDOUT) == 0
+
+# Configure and build the benchmark in its own directory, return the path to the executable.
+def build(options, target, flags, build_dir, log):
+    source = os.path.join(os.path.abspath(options.path), "benchmarks")
+    cmd = ["cmake", "-S", source, "-B", build_dir, "-DCMAKE_BUILD_TYPE=Release",
+           "-DBENCHMARKS_ISPC_TARGETS=" + target, "-DBENCHMARKS_ISPC_FLAGS=" + flags]
+    if options.generator:
+        cmd += ["-G", options.generator]
+    if options.ispc:
+        cmd += ["-DISPC_EXECUTABLE=" + os.path.abspath(options.ispc)]
+    if not run_command(cmd, log):
+        return None
+    if not run_command(["cmake", "--build", build_dir, "--target", options.benchmark, "--config", "Release"], log):
+        return None
+    for exe in glob.glob(os.path.join(build_dir, "*", "**", options.benchmark + "*"), recursive=True):
+        if os.path.isfile(exe) and os.access(exe, os.X_OK) and re.match(options.benchmark + r"(\.exe)?$",
+                                                                         os.path.basename(exe)):
+            return exe
+    return None
+
+# Run the benchmark and return {case: median real time in ns}.
+def measure(options, exe, log):
+    out = os.path.join(os.path.dirname(exe), "autotune.json")
+    cmd = [exe, "--benchmark_format=json", "--benchmark_out=" + out, "--benchmark_out_format=json",
+           "--benchmark_repetitions=" + options.repetitions, "--benchmark_report_aggregates_only=true",
+           "--benchmark_min_time=" + options.min_time]
+    if options.filter:
+        cmd += ["--benchmark_filter=" + options.filter]
+    if not run_command(cmd, log):
+        return None
+    with open(out, 'r') as f:
+        results = json.load(f)
+    times = {}
+    for b in results.get("benchmarks", []):
+        if b.get("aggregate_name") != "median" or b.get("run_name", "").startswith("warm_up"):
+            continue
+        times[b["run_name"]] = b["real_time"] * TIME_UNITS.get(b.get("time_unit", "ns"), 1.0)
+    return times
+
+def tune(options):
+    configs = search_space(options)
+    root = options.build_dir if options.build_dir else tempfile.mkdtemp(prefix="autotune_")
+    log = os.path.join(root, "autotune.log")
+    os.makedirs(root, exist_ok=True)
+    results = []
+    for i, (target, flags, label) in enumerate(configs):
+        if not options.silent:
+            print("[%d/%d] %s" % (i + 1, len(configs), label))
+        exe = build(options, target, flags, os.path.join(root, "config_%d" % i), log)
+        times = measure(options, exe, log) if exe else None
+        if not times:
+            common.error("%s failed to %s, see %s" % (label, "run" if exe else "build", log), 2)
+            continue
+        results.append((target, flags, label, times))
+    if not options.keep and not options.build_dir:
+        shutil.rmtree(root, ignore_errors=True)
+    if not results:
+        common.error("no configuration of %s was built and run" % options.benchmark, 1)
+
+    # Compare the configurations on the cases all of them ran.
+    cases = sorted(set.intersection(*[set(r[3].keys()) for r in results]))
+    scored = sorted(((perf.geomean([r[3][c] for c in cases]), r) for r in results), key=lambda x: x[0])
+    print("%s, geomean of %d cases:" % (options.benchmark, len(cases)))
+    for score, (target, flags, label, times) in scored:
+        print("    %12.2f ns  %s" % (score, label))
+    return scored[0]
+
+# Replace the configuration of the benchmark in the tuning file and keep the others.
+def write_tuning(options, score, target, flags):
+    prefix = "BENCHMARKS_TUNED_%s_" % options.benchmark
+    lines = []
+    if os.path.exists(options.output):
+        with open(options.output, 'r') as f:
+            lines = [l for l in f.readlines() if l.find(prefix) == -1]
+    if not lines:
+        lines = ["# Benchmark configurations found by autotune.py, pass it to CMake with\n",
+                 "# -DBENCHMARKS_TUNING_FILE=<file>.\n"]
+    lines.append("# %s: %.2f ns on %s\n" % (prefix + "*", score, host_cpu()))
+    lines.append("set(%sTARGETS \"%s\")\n" % (prefix, target))
+    lines.append("set(%sFLAGS \"%s\")\n" % (prefix, flags))
+    with open(options.output, 'w') as f:
+        f.writelines(lines)
+
+if __name__ == "__main__":
+    default_targets = "avx2-i32x8;avx2-i32x16"
+    if platform.machine().lower() in ["arm64", "aarch64"]:
+        default_targets = "neon-i32x4;neon-i32x8"
+    parser = OptionParser()
+    parser.add_option('-b', '--benchmark', dest='benchmark',
+        help='benchmark to tune, e.g. 06_sgemm or 01_tasking_omp', default="")
+    parser.add_option('-p', '--path', dest='path', help='path to ispc root', default=".")
+    parser.add_option('--ispc', dest='ispc', help='ispc executable, found in PATH by default', default="")
+    parser.add_option('-t', '--targets', dest='targets',
+        help='semicolon-separated target configurations, each one a target or a comma-separated multi-target list',
+        default=default_targets)
+    parser.add_option('--opt', dest='opt',
+        help='comma separated --opt variants, e.g. none,fast-math,disable-fma; "+" combines options of one variant',
+        default="none")
+    parser.add_option('-D', '--define', dest='defines', action="append", default=[],
+        help='macro of the kernel and its values, NAME=value1,value2...; may be repeated')
+    parser.add_option('--flags', dest='flags', help='ispc flags of all configurations', default="-O3 --woff")
+    parser.add_option('-f', '--filter', dest='filter', help='regex to select benchmark cases', default="")
+    parser.add_option('-n', '--repetitions', dest='repetitions', help='number of repetitions of every case',
+        default="5")
+    parser.add_option('--min-time', dest='min_time', help='minimum time of a repetition, in seconds', default="0.1")
+    parser.add_option('--build-dir', dest='build_dir',
+        help='directory to build the configurations in, a temporary one by default', default="")
+    parser.add_option('-g', '--generator', dest='generator', help='cmake generator', default="")
+    parser.add_option('-k', '--keep', dest='keep', help='keep the temporary build directory',
+        default=False, action="store_true")
+    parser.add_option('-o', '--output', dest='output', help='tuning file to write', default="benchmarks_tuning.cmake")
+    parser.add_option('-s', '--silent', dest='silent', help='no progress output', default=False, action="store_true")
+    (options, args) = parser.parse_args()
+
+    if not options.benchmark:
+        common.error("the benchmark to tune is not set, use --benchmark", 1)
+    score, (target, flags, label, times) = tune(options)
+    print("Best configuration: %s" % label)
+    write_tuning(options, score, target, flags)
@@ -0,0 +1,50 @@
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <stdio.h>
+#include <vector>
+
+#include "../common.h"
+#include "01_aobench_ispc.h"
+
+static Docs docs("Ambient occlusion renderer (examples/cpu/aobench) on a square image of the given size:\n"
+                 " - 2x2 subsamples and 8x8 occlusion rays per pixel.\n"
+                 " - stresses divergent control flow (cif), short vectors, math functions and atomics.\n"
+                 "Expectations:\n"
+                 " - No regressions\n");
+
+WARM_UP_RUN();
+
+#define ARGS Arg(32)->Arg(64)->Arg(128)
+
+static void check(const std::vector<float> &image) {
+    // Occlusion is accumulated over the subsamples, so every value is in [0, 1]. Rays towards the sky miss,
+    // the lower half of the image sees the ground plane.
+    size_t hits = 0;
+    for (size_t i = 0; i < image.size(); i++) {
+        if (!(image[i] >= 0.f && image[i] <= 1.0001f)) {
+            printf("Error i=%zu, value=%f\n", i, image[i]);
+            return;
+        }
+        hits += image[i] > 0.f;
+    }
+    if (hits < image.size() / 4) {
+        printf("Error: only %zu of %zu values are lit\n", hits, image.size());
+    }
+}
+
+static void aobench(benchmark::State &state) {
+    int size = static_cast<int>(state.range(0));
+    const int nsubsamples = 2;
+    std::vector<float> image(size * size * 3);
+
+    for (auto _ : state) {
+        std::fill(image.begin(), image.end(), 0.f);
+        ispc::ao_ispc(size, size, nsubsamples, image.data());
+    }
+
+    check(image);
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(aobench)->ARGS;
+
+BENCHMARK_MAIN();
@@ -0,0 +1,84 @@
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <stdio.h>
+#include <vector>
+
+#include "../common.h"
+#include "02_stencil_ispc.h"
+
+static Docs docs("3D 8th-order wave equation stencil (examples/cpu/stencil) on an N^3 grid, 4 time steps:\n"
+                 " - 3D foreach with 25 loads per point at constant offsets.\n"
+                 " - first size fits in L2, the others stream from L3 and memory.\n"
+                 "Expectations:\n"
+                 " - All stencil loads are vector loads, no gathers\n"
+                 " - No regressions\n");
+
+WARM_UP_RUN();
+
+#define ARGS Arg(32)->Arg(64)->Arg(128)
+
+static const int steps = 4;
+static const int halo = 4;
+static const float coef[4] = {0.5f, -0.25f, 0.125f, -0.0625f};
+
+static void init(std::vector<float> &Aeven, std::vector<float> &Aodd, std::vector<float> &vsq, int N) {
+    for (int z = 0; z < N; z++)
+        for (int y = 0; y < N; y++)
+            for (int x = 0; x < N; x++) {
+                int index = (z * N + y) * N + x;
+                Aeven[index] = Aodd[index] = (x < N / 2) ? x / float(N) : y / float(N);
+                vsq[index] = x * y * z / float(N * N * N);
+            }
+}
+
+static void loop_stencil_serial(int t0, int t1, int x0, int x1, int y0, int y1, int z0, int z1, int N,
+                                const float vsq[], float Aeven[], float Aodd[]) {
+    int Nxy = N * N;
+    for (int t = t0; t < t1; ++t) {
+        const float *Ain = (t & 1) == 0 ? Aeven : Aodd;
+        float *Aout = (t & 1) == 0 ? Aodd : Aeven;
+        for (int z = z0; z < z1; ++z)
+            for (int y = y0; y < y1; ++y)
+                for (int x = x0; x < x1; ++x) {
+                    int index = (z * Nxy) + (y * N) + x;
+                    float div = coef[0] * Ain[index];
+                    for (int r = 1; r < 4; r++)
+                        div += coef[r] * (Ain[index + r] + Ain[index - r] + Ain[index + r * N] + Ain[index - r * N] +
+                                          Ain[index + r * Nxy] + Ain[index - r * Nxy]);
+                    Aout[index] = 2 * Ain[index] - Aout[index] + vsq[index] * div;
+                }
+    }
+}
+
+static void check(const std::vector<float> &result, int N) {
+    std::vector<float> Aeven(N * N * N), Aodd(N * N * N), vsq(N * N * N);
+    init(Aeven, Aodd, vsq, N);
+    loop_stencil_serial(0, steps, halo, N - halo, halo, N - halo, halo, N - halo, N, vsq.data(), Aeven.data(),
+                        Aodd.data());
+    for (int i = 0; i < N * N * N; i++) {
+        if (std::abs(result[i] - Aeven[i]) > 1e-3f * std::max(1.f, std::abs(Aeven[i]))) {
+            printf("Error i=%d, value=%f, expected=%f\n", i, result[i], Aeven[i]);
+            return;
+        }
+    }
+}
+
+static void stencil(benchmark::State &state) {
+    int N = static_cast<int>(state.range(0));
+    std::vector<float> Aeven(N * N * N), Aodd(N * N * N), vsq(N * N * N);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        init(Aeven, Aodd, vsq, N);
+        state.ResumeTiming();
+        ispc::loop_stencil_ispc(0, steps, halo, N - halo, halo, N - halo, halo, N - halo, N, N, coef, vsq.data(),
+                                Aeven.data(), Aodd.data());
+    }
+
+    check(Aeven, N);
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(stencil)->ARGS;
+
+BENCHMARK_MAIN();
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <stdio.h>
+#include <vector>
+
+#include "../common.h"
+#include "03_spmv_ispc.h"
+
+static Docs docs("Sparse matrix-vector multiplication with a CSR matrix of the given number of rows:\n"
+                 " - rows have 4 to 60 nonzeros clustered around the diagonal, like a FEM matrix.\n"
+                 " - row_per_lane: one row per program instance, gathers and divergent loop trip counts.\n"
+                 " - gang_per_row: vector loads of each row, one gather from x and a reduce_add() per row.\n"
+                 " - ell: rows padded to the longest one and interleaved, vector loads and one gather per column.\n"
+                 " - sell: SELL-C-sigma, chunks of a gang of rows sorted by length, each padded to its longest row.\n"
+                 "Expectations:\n"
+                 " - No regressions\n");
+
+WARM_UP_RUN();
+
+#define ARGS Arg(1024)->Arg(16384)->Arg(262144)
+
+struct CSR {
+    std::vector<int> rowptr, col;
+    std::vector<float> val;
+};
+
+static void init(CSR &A, std::vector<float> &x, int nrows) {
+    unsigned int seed = 1;
+    auto rnd = [&seed]() {
+        seed = seed * 1103515245u + 12345u;
+        return (seed >> 16) & 0x7fff;
+    };
+    A.rowptr.assign(1, 0);
+    A.col.clear();
+    A.val.clear();
+    for (int row = 0; row < nrows; row++) {
+        int len = 4 + rnd() % 57;
+        int first = std::max(0, std::min(nrows - len, row - len / 2));
+        for (int j = 0; j < len; j++) {
+            A.col.push_back(first + j);
+            A.val.push_back((rnd() % 100) / 50.f - 1.f);
+        }
+        A.rowptr.push_back(static_cast<int>(A.col.size()));
+    }
+    x.resize(nrows);
+    for (int i = 0; i < nrows; i++)
+        x[i] = (rnd() % 100) / 100.f;
+}
+
+static void check(const CSR &A, const std::vector<float> &x, const std::vector<float> &y) {
+    for (size_t row = 0; row < y.size(); row++) {
+        float sum = 0.f;
+        for (int j = A.rowptr[row]; j < A.rowptr[row + 1]; j++)
+            sum += A.val[j] * x[A.col[j]];
+        if (std::abs(y[row] - sum) > 1e-4f * std::max(1.f, std::abs(sum))) {
+            printf("Error row=%zu, value=%f, expected=%f\n", row, y[row], sum);
+            return;
+        }
+    }
+}
+
+#define SPMV(NAME)                                                                                                     \
+    static void NAME(benchmark::State &state) {                                                                        \
+        int nrows = static_cast<int>(state.range(0));                                                                  \
+        CSR A;                                                                                                         \
+        std::vector<float> x, y(nrows);                                                                                \
+        init(A, x, nrows);                                                                                             \
+                                                                                                                       \
+        for (auto _ : state) {                                                                                         \
+            ispc::spmv_csr_##NAME(nrows, A.rowptr.data(), A.col.data(), A.val.data(), x.data(), y.data());             \
+        }                                                                                                              \
+                                                                                                                       \
+        check(A, x, y);                                                                                                \
+        state.SetComplexityN(state.range(0));                                                                          \
+    }                                                                                                                  \
+    BENCHMARK(NAME)->ARGS;
+
+SPMV(row_per_lane)
+SPMV(gang_per_row)
+
+// Column-major arrays of programCount-row chunks, with the offset and the padded length of each chunk and the row
+// of each lane. One chunk of nrows rounded up rows without sorting is ELL.
+struct Chunks {
+    std::vector<int> ptr, len, perm, col;
+    std::vector<float> val;
+};
+
+static void convert(const CSR &A, int nrows, int chunkSize, int sigma, Chunks &S) {
+    const int nchunks = (nrows + chunkSize - 1) / chunkSize;
+    S.perm.resize(nchunks * chunkSize);
+    for (int i = 0; i < nchunks * chunkSize; i++)
+        S.perm[i] = i;
+    auto length = [&](int row) { return row < nrows ? A.rowptr[row + 1] - A.rowptr[row] : 0; };
+    for (int start = 0; start < nchunks * chunkSize; start += sigma)
+        std::stable_sort(S.perm.begin() + start, S.perm.begin() + std::min(nchunks * chunkSize, start + sigma),
+                         [&](int a, int b) { return length(a) > length(b); });
+    S.ptr.assign(1, 0);
+    S.len.clear();
+    for (int chunk = 0; chunk < nchunks; chunk++) {
+        int len = 0;
+        for (int lane = 0; lane < chunkSize; lane++)
+            len = std::max(len, length(S.perm[chunk * chunkSize + lane]));
+        S.len.push_back(len);
+        S.ptr.push_back(S.ptr.back() + len * chunkSize);
+    }
+    S.col.assign(S.ptr.back(), 0);
+    S.val.assign(S.ptr.back(), 0.f);
+    for (int chunk = 0; chunk < nchunks; chunk++) {
+        for (int lane = 0; lane < chunkSize; lane++) {
+            int row = S.perm[chunk * chunkSize + lane];
+            for (int j = 0; j < length(row); j++) {
+                S.col[S.ptr[chunk] + j * chunkSize + lane] = A.col[A.rowptr[row] + j];
+                S.val[S.ptr[chunk] + j * chunkSize + lane] = A.val[A.rowptr[row] + j];
+            }
+        }
+    }
+}
+
+static void ell(benchmark::State &state) {
+    int nrows = static_cast<int>(state.range(0));
+    CSR A;
+    std::vector<float> x, y(nrows);
+    init(A, x, nrows);
+    const int chunkSize = ispc::spmv_chunk_size();
+    const int nrows_padded = (nrows + chunkSize - 1) / chunkSize * chunkSize;
+    // ELL is the column-major layout of a single chunk of all rows
+    Chunks S;
+    convert(A, nrows, nrows_padded, 1, S);
+    const int width = S.len[0];
+
+    for (auto _ : state) {
+        ispc::spmv_ell(nrows, nrows_padded, width, S.col.data(), S.val.data(), x.data(), y.data());
+    }
+
+    check(A, x, y);
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(ell)->ARGS;
+
+static void sell(benchmark::State &state) {
+    int nrows = static_cast<int>(state.range(0));
+    CSR A;
+    std::vector<float> x, y(nrows);
+    init(A, x, nrows);
+    const int chunkSize = ispc::spmv_chunk_size();
+    Chunks S;
+    convert(A, nrows, chunkSize, 32 * chunkSize, S);
+    const int nchunks = static_cast<int>(S.len.size());
+
+    for (auto _ : state) {
+        ispc::spmv_sell(nrows, nchunks, S.ptr.data(), S.len.data(), S.perm.data(), S.col.data(), S.val.data(),
+                        x.data(), y.data());
+    }
+
+    check(A, x, y);
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(sell)->ARGS;
+
+BENCHMARK_MAIN();
@@ -0,0 +1,66 @@
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <stdio.h>
+#include <vector>
+
+#include "../common.h"
+#include "04_radix_sort_ispc.h"
+
+static Docs docs("sort_by_key() on uint32 keys with int32 values (examples/cpu/sort):\n"
+                 " - LSD radix sort with 8-bit digits: per-digit histograms, an exclusive scan and a scatter pass.\n"
+                 " - low_bits: keys below 256, so three of the four passes are skipped.\n"
+                 " - the input is restored for every iteration, which is included in the time.\n"
+                 "Expectations:\n"
+                 " - No regressions\n");
+
+WARM_UP_RUN();
+
+#define ARGS Arg(1024)->Arg(65536)->Arg(1 << 20)
+
+static void init(std::vector<uint32_t> &keys, int n) {
+    keys.resize(n);
+    uint32_t seed = 7;
+    for (int i = 0; i < n; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        keys[i] = seed;
+    }
+}
+
+static void check(const std::vector<uint32_t> &input, const std::vector<uint32_t> &keys,
+                  const std::vector<int32_t> &values, uint32_t keyMask) {
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (i > 0 && (keys[i - 1] > keys[i] || (keys[i - 1] == keys[i] && values[i - 1] > values[i]))) {
+            printf("Error: output is not stably sorted at i=%zu\n", i);
+            return;
+        }
+        if ((input[values[i]] & keyMask) != keys[i]) {
+            printf("Error: key and value do not match at i=%zu\n", i);
+            return;
+        }
+    }
+}
+
+#define SORT(NAME, MASK)                                                                                               \
+    static void NAME(benchmark::State &state) {                                                                        \
+        int n = static_cast<int>(state.range(0));                                                                      \
+        std::vector<uint32_t> input, keys(n);                                                                          \
+        std::vector<int32_t> values(n);                                                                                \
+        init(input, n);                                                                                                \
+                                                                                                                       \
+        for (auto _ : state) {                                                                                         \
+            std::copy(input.begin(), input.end(), keys.begin());                                                       \
+            for (int i = 0; i < n; i++)                                                                                \
+                values[i] = i;                                                                                         \
+            ispc::NAME##_ispc(keys.data(), values.data(), n);                                                          \
+        }                                                                                                              \
+                                                                                                                       \
+        check(input, keys, values, MASK);                                                                              \
+        state.SetComplexityN(state.range(0));                                                                          \
+    }                                                                                                                  \
+    BENCHMARK(NAME)->ARGS;
+
+SORT(sort_by_key, 0xffffffffu)
+SORT(sort_by_key_low_bits, 0xffu)
+
+BENCHMARK_MAIN();
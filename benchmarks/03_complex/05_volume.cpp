@@ -0,0 +1,64 @@
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <stdio.h>
+#include <vector>
+
+#include "../common.h"
+#include "05_volume_ispc.h"
+
+static Docs docs("Volume ray marching with single scattering (examples/cpu/volume_rendering):\n"
+                 " - a 64^3 density grid, rendered to a square image of the given size.\n"
+                 " - trilinear interpolation gathers, nested divergent loops with early termination (cwhile).\n"
+                 "Expectations:\n"
+                 " - No regressions\n");
+
+WARM_UP_RUN();
+
+#define ARGS Arg(32)->Arg(64)->Arg(128)
+
+static const int gridSize = 64;
+
+// A fuzzy sphere with a few harmonics on top.
+static void init(std::vector<float> &density) {
+    int n = gridSize;
+    density.resize(n * n * n);
+    for (int z = 0; z < n; z++)
+        for (int y = 0; y < n; y++)
+            for (int x = 0; x < n; x++) {
+                float px = (x + 0.5f) / n - 0.5f, py = (y + 0.5f) / n - 0.5f, pz = (z + 0.5f) / n - 0.5f;
+                float r = std::sqrt(px * px + py * py + pz * pz);
+                float d = 1.f - r / 0.45f + 0.2f * std::sin(20 * px) * std::sin(20 * py) * std::sin(20 * pz);
+                density[(z * n + y) * n + x] = d > 0.f ? d : 0.f;
+            }
+}
+
+static void check(const std::vector<float> &image, int size) {
+    int lit = 0;
+    for (size_t i = 0; i < image.size(); i++) {
+        if (!(image[i] >= 0.f) || std::isinf(image[i])) {
+            printf("Error i=%zu, value=%f\n", i, image[i]);
+            return;
+        }
+        lit += image[i] > 0.f;
+    }
+    // The corners see only empty space, the center sees the sphere.
+    if (image[0] != 0.f || image[(size / 2) * size + size / 2] <= 0.f || lit == 0) {
+        printf("Error: unexpected image\n");
+    }
+}
+
+static void volume(benchmark::State &state) {
+    int size = static_cast<int>(state.range(0));
+    std::vector<float> density, image(size * size);
+    init(density);
+
+    for (auto _ : state) {
+        ispc::volume_ispc(density.data(), gridSize, size, size, image.data());
+    }
+
+    check(image, size);
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(volume)->ARGS;
+
+BENCHMARK_MAIN();
@@ -0,0 +1,63 @@
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <stdio.h>
+#include <vector>
+
+#include "../common.h"
+#include "06_sgemm_ispc.h"
+
+static Docs docs("SGEMM on square matrices of the given size (examples/cpu/sgemm):\n"
+                 " - naive: one element of C per program instance, gathers from A.\n"
+                 " - tile: TILE_ROWS (4 by default) x programCount register tile of C, uniform loads of A and\n"
+                 "   vector loads of B.\n"
+                 "Expectations:\n"
+                 " - tile is several times faster than naive\n"
+                 " - No regressions\n");
+
+WARM_UP_RUN();
+
+#define ARGS Arg(64)->Arg(128)->Arg(256)
+
+static void init(std::vector<float> &A, std::vector<float> &B, int size) {
+    A.resize(size * size);
+    B.resize(size * size);
+    for (int i = 0; i < size * size; i++) {
+        A[i] = ((i * 7) % 17) / 16.f - 0.5f;
+        B[i] = ((i * 5) % 13) / 12.f - 0.5f;
+    }
+}
+
+static void check(const std::vector<float> &A, const std::vector<float> &B, const std::vector<float> &C, int size) {
+    for (int m = 0; m < size; m++) {
+        for (int k = 0; k < size; k++) {
+            float sum = 0.f;
+            for (int n = 0; n < size; n++)
+                sum += A[m * size + n] * B[n * size + k];
+            if (std::abs(C[m * size + k] - sum) > 1e-3f * std::max(1.f, std::abs(sum))) {
+                printf("Error m=%d, k=%d, value=%f, expected=%f\n", m, k, C[m * size + k], sum);
+                return;
+            }
+        }
+    }
+}
+
+#define SGEMM(NAME)                                                                                                    \
+    static void NAME(benchmark::State &state) {                                                                        \
+        int size = static_cast<int>(state.range(0));                                                                   \
+        std::vector<float> A, B, C(size * size);                                                                       \
+        init(A, B, size);                                                                                              \
+                                                                                                                       \
+        for (auto _ : state) {                                                                                         \
+            ispc::NAME(A.data(), B.data(), C.data(), size, size, size);                                                \
+        }                                                                                                              \
+                                                                                                                       \
+        check(A, B, C, size);                                                                                          \
+        state.SetComplexityN(state.range(0));                                                                          \
+    }                                                                                                                  \
+    BENCHMARK(NAME)->ARGS;
+
+SGEMM(sgemm_naive)
+SGEMM(sgemm_tile)
+
+BENCHMARK_MAIN();
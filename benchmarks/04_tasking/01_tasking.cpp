@@ -0,0 +1,129 @@
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <thread>
+
+#include "../common.h"
+#include "01_tasking_ispc.h"
+
+// Entry points of the tasking runtime (ispcrt/ispc_tasking.cpp) this benchmark is linked with.
+extern "C" {
+void ISPCLaunch(void **handlePtr, void *f, void *data, int countx, int county, int countz);
+void *ISPCAlloc(void **handlePtr, int64_t size, int32_t alignment);
+void ISPCSync(void *handle);
+}
+
+static Docs docs("Overhead of the tasking runtime, task system: " BENCHMARKS_TASK_SYSTEM "\n"
+                 " - launch_empty: launch[N] of an empty task followed by sync.\n"
+                 " - launch_grain: launch[] over 1M floats split into tasks of the given grain size.\n"
+                 " - nested: tasks launching tasks, outer x inner empty tasks.\n"
+                 " - sync_latency: ISPCSync() of a task group whose only task has (normally) already finished.\n"
+                 " - alloc: N calls to ISPCAlloc() for task arguments followed by one launch and sync.\n"
+                 "Expectations:\n"
+                 " - No regressions\n");
+
+WARM_UP_RUN();
+
+static void launch_empty(benchmark::State &state) {
+    int count = static_cast<int>(state.range(0));
+
+    for (auto _ : state) {
+        ispc::launch_empty(count);
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()) * count);
+}
+BENCHMARK(launch_empty)->Arg(1)->Arg(16)->Arg(256)->Arg(4096)->UseRealTime();
+
+static void check_grain(const float *a, int n, int64_t iterations) {
+    // Every iteration maps x to x * 0.5 + 1, which converges to 2 starting from 0.
+    float expected = 0.0f;
+    for (int64_t i = 0; i < iterations && expected != 2.0f; i++) {
+        expected = expected * 0.5f + 1.0f;
+    }
+    for (int i = 0; i < n; i++) {
+        if (a[i] != expected) {
+            printf("Error i=%d, value=%f, expected=%f\n", i, a[i], expected);
+            return;
+        }
+    }
+}
+
+static void launch_grain(benchmark::State &state) {
+    int grain = static_cast<int>(state.range(0));
+    const int n = 1 << 20;
+    float *a = static_cast<float *>(aligned_alloc_helper(sizeof(float) * n));
+    for (int i = 0; i < n; i++) {
+        a[i] = 0.0f;
+    }
+
+    for (auto _ : state) {
+        ispc::launch_grain(a, n, grain);
+    }
+
+    check_grain(a, n, state.iterations());
+    aligned_free_helper(a);
+    state.SetItemsProcessed(int64_t(state.iterations()) * ((n + grain - 1) / grain));
+}
+BENCHMARK(launch_grain)->RangeMultiplier(4)->Range(64, 65536)->UseRealTime();
+
+static void nested(benchmark::State &state) {
+    int outer = static_cast<int>(state.range(0));
+    int inner = static_cast<int>(state.range(1));
+
+    for (auto _ : state) {
+        ispc::launch_nested(outer, inner);
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()) * outer * (inner + 1));
+}
+BENCHMARK(nested)->Args({8, 8})->Args({64, 64})->UseRealTime();
+
+static std::atomic<int> task_done;
+
+static void flag_task(void *, int, int, int, int, int, int, int, int, int, int) {
+    task_done.store(1, std::memory_order_release);
+}
+
+static void sync_latency(benchmark::State &state) {
+    for (auto _ : state) {
+        void *handle = nullptr;
+        task_done.store(0, std::memory_order_relaxed);
+        ISPCLaunch(&handle, reinterpret_cast<void *>(flag_task), nullptr, 1, 1, 1);
+        // Give the worker threads a chance to run the task. Some task systems (or a single hardware thread) only run
+        // tasks from ISPCSync(), so the wait is bounded and the sync then includes running the task.
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(100);
+        while (task_done.load(std::memory_order_acquire) == 0 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+
+        // Only the sync is timed, the launch is excluded.
+        auto start = std::chrono::high_resolution_clock::now();
+        ISPCSync(handle);
+        auto end = std::chrono::high_resolution_clock::now();
+        state.SetIterationTime(std::chrono::duration<double>(end - start).count());
+    }
+}
+BENCHMARK(sync_latency)->UseManualTime();
+
+static void alloc(benchmark::State &state) {
+    int count = static_cast<int>(state.range(0));
+
+    for (auto _ : state) {
+        void *handle = nullptr;
+        void *data = nullptr;
+        for (int i = 0; i < count; i++) {
+            data = ISPCAlloc(&handle, 64, 64);
+            benchmark::DoNotOptimize(data);
+        }
+        ISPCLaunch(&handle, reinterpret_cast<void *>(flag_task), data, 1, 1, 1);
+        ISPCSync(handle);
+    }
+
+    state.SetItemsProcessed(int64_t(state.iterations()) * count);
+}
+BENCHMARK(alloc)->Arg(1)->Arg(16)->Arg(256)->UseRealTime();
+
+BENCHMARK_MAIN();
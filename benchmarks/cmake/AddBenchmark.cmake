@@ -70,7 +70,7 @@ else()
 endif()
 
 # Suffixes for multi-target compilation (x86 only)
-set(ISPC_KNOWN_TARGETS "sse2" "sse4" "avx1" "avx2" "avx512knl" "avx512skx")
+set(ISPC_KNOWN_TARGETS "sse2" "sse4" "avx1" "avx2" "avx512knl" "avx512skx" "avx512spr")
 
 #######################
 #  add_ispc_to_target
@@ -82,12 +82,16 @@ set(ISPC_KNOWN_TARGETS "sse2" "sse4" "avx1" "avx2" "avx512knl" "avx512skx")
 #  TARGET : Name of the target to add ISPC to.
 #  CPP_MAIN_FILE : Main cpp file which includes ispc headers
 #  SOURCES : List of ISPC source files.
+#  ISPC_TARGETS : ISPC targets, BENCHMARKS_ISPC_TARGETS by default.
+#  ISPC_FLAGS : ISPC flags, BENCHMARKS_ISPC_FLAGS by default.
 #
 function(add_ispc_to_target)
     set(options)
     set(one_value_args
         TARGET
         CPP_MAIN_FILE
+        ISPC_TARGETS
+        ISPC_FLAGS
     )
     set(multi_value_args
         SOURCES
@@ -98,12 +102,19 @@ function(add_ispc_to_target)
         "${multi_value_args}"
         ${ARGN}
     )
+    if(NOT ADD_ISPC_ISPC_TARGETS)
+        set(ADD_ISPC_ISPC_TARGETS ${BENCHMARKS_ISPC_TARGETS})
+    endif()
+    if(NOT DEFINED ADD_ISPC_ISPC_FLAGS)
+        set(ADD_ISPC_ISPC_FLAGS ${BENCHMARKS_ISPC_FLAGS})
+    endif()
 
-    set(ISPC_DST_DIR "${CMAKE_CURRENT_BINARY_DIR}/${CMAKE_CFG_INTDIR}/CMakeFiles/ispc/")
+    # One directory per target, so that several targets can be built from the same ISPC source.
+    set(ISPC_DST_DIR "${CMAKE_CURRENT_BINARY_DIR}/${CMAKE_CFG_INTDIR}/CMakeFiles/ispc/${ADD_ISPC_TARGET}/")
     file(TO_NATIVE_PATH "${ISPC_DST_DIR}" ISPC_DST_DIR)
     file(MAKE_DIRECTORY ${ISPC_DST_DIR})
 
-    string(FIND ${BENCHMARKS_ISPC_TARGETS} "," MULTI_TARGET)
+    string(FIND ${ADD_ISPC_ISPC_TARGETS} "," MULTI_TARGET)
 
     foreach(ISPC_SRC_FILE ${ADD_ISPC_SOURCES})
         set(ISPC_TARGET_HEADERS "")
@@ -123,7 +134,7 @@ function(add_ispc_to_target)
         # Collect list of expected outputs in case of multiple targets
         if(${MULTI_TARGET} GREATER -1)
             foreach (ISPC_TARGET ${ISPC_KNOWN_TARGETS})
-                string(FIND ${BENCHMARKS_ISPC_TARGETS} ${ISPC_TARGET} FOUND_TARGET)
+                string(FIND ${ADD_ISPC_ISPC_TARGETS} ${ISPC_TARGET} FOUND_TARGET)
                 if(${FOUND_TARGET} GREATER -1)
                     set(OUTPUT_TARGET ${ISPC_TARGET})
                     if (${ISPC_TARGET} STREQUAL "avx1")
@@ -145,12 +156,12 @@ function(add_ispc_to_target)
 
         # Passing space separate string yields escaped spaces.
         # So convert to a list and then use generator expression, i.e. "$<JOIN:${FLAGS},;>"
-        separate_arguments(FLAGS NATIVE_COMMAND ${BENCHMARKS_ISPC_FLAGS})
+        separate_arguments(FLAGS NATIVE_COMMAND "${ADD_ISPC_ISPC_FLAGS}")
 
         add_custom_command(
             OUTPUT ${ISPC_TARGET_OBJS} ${ISPC_TARGET_HEADERS}
-            COMMENT "Compiling ${ISPC_SRC_FILE} for ${BENCHMARKS_ISPC_TARGETS} target(s)"
-            COMMAND           ${ISPC_EXECUTABLE} ${SRC_LOCATION} -o ${ISPC_OBJ} -h ${ISPC_HEADER} --arch=${ISPC_ARCH} --target=${BENCHMARKS_ISPC_TARGETS} ${ISPC_PIC} "$<JOIN:${FLAGS},;>"
+            COMMENT "Compiling ${ISPC_SRC_FILE} for ${ADD_ISPC_ISPC_TARGETS} target(s)"
+            COMMAND           ${ISPC_EXECUTABLE} ${SRC_LOCATION} -o ${ISPC_OBJ} -h ${ISPC_HEADER} --arch=${ISPC_ARCH} --target=${ADD_ISPC_ISPC_TARGETS} ${ISPC_PIC} "$<JOIN:${FLAGS},;>"
             DEPENDS ${ISPC_EXECUTABLE}
             DEPENDS ${ISPC_SRC_FILE}
             COMMAND_EXPAND_LISTS
@@ -176,9 +187,25 @@ function(add_ispc_to_target)
     target_link_libraries(${ADD_ISPC_TARGET} PRIVATE ${ISPC_OBJS_LIST})
 endfunction()
 
+# Targets and flags of a benchmark: the ones written to BENCHMARKS_TUNING_FILE by
+# autotune.py for it, or BENCHMARKS_ISPC_TARGETS and BENCHMARKS_ISPC_FLAGS.
+macro(get_benchmark_ispc_options name)
+    if(DEFINED BENCHMARKS_TUNED_${name}_TARGETS)
+        set(${name}_ISPC_TARGETS ${BENCHMARKS_TUNED_${name}_TARGETS})
+    else()
+        set(${name}_ISPC_TARGETS ${BENCHMARKS_ISPC_TARGETS})
+    endif()
+    if(DEFINED BENCHMARKS_TUNED_${name}_FLAGS)
+        set(${name}_ISPC_FLAGS ${BENCHMARKS_TUNED_${name}_FLAGS})
+    else()
+        set(${name}_ISPC_FLAGS ${BENCHMARKS_ISPC_FLAGS})
+    endif()
+endmacro()
+
 # A macro to add a benchmark
 macro(compile_benchmark_test name)
     add_executable(${name} "")
+    get_benchmark_ispc_options(${name})
 
     # aligned_alloc() requires C++17
     set_target_properties(${name} PROPERTIES
@@ -188,7 +215,9 @@ macro(compile_benchmark_test name)
     add_ispc_to_target(
         TARGET ${name}
         CPP_MAIN_FILE ${CMAKE_CURRENT_SOURCE_DIR}/${name}.cpp
-        SOURCES ${name}.ispc)
+        SOURCES ${name}.ispc
+        ISPC_TARGETS "${${name}_ISPC_TARGETS}"
+        ISPC_FLAGS "${${name}_ISPC_FLAGS}")
 
     target_sources(
         ${name}
@@ -196,8 +225,8 @@ macro(compile_benchmark_test name)
 
     target_compile_definitions(
         ${name}
-        PRIVATE BENCHMARKS_ISPC_TARGETS=\"${BENCHMARKS_ISPC_TARGETS}\"
-                BENCHMARKS_ISPC_FLAGS=\"${BENCHMARKS_ISPC_FLAGS}\")
+        PRIVATE BENCHMARKS_ISPC_TARGETS=\"${${name}_ISPC_TARGETS}\"
+                BENCHMARKS_ISPC_FLAGS=\"${${name}_ISPC_FLAGS}\")
 
     # Turn on AVX2 support in the C++ compiler to be able to use AVX2 intrinsics.
     if((CMAKE_CXX_COMPILER_ID MATCHES "GNU") OR (CMAKE_CXX_COMPILER_ID MATCHES "Clang"))
@@ -220,3 +249,70 @@ macro(compile_benchmark_test name)
     add_test(NAME ${name}_test COMMAND ${name} --benchmark_min_time=0.01)
     add_dependencies(${BENCHMARKS_PROJECT_NAME} ${name})
 endmacro(compile_benchmark_test)
+
+# Add a benchmark of the tasking runtime, linked with ispcrt/ispc_tasking.cpp
+# built for the task system selected by DEFINITION.
+function(add_tasking_benchmark name task_system definition library)
+    set(target ${name}_${task_system})
+    add_executable(${target} "")
+    get_benchmark_ispc_options(${target})
+
+    set_target_properties(${target} PROPERTIES
+        CXX_STANDARD 17
+        CXX_STANDARD_REQUIRED YES)
+
+    add_ispc_to_target(
+        TARGET ${target}
+        CPP_MAIN_FILE ${CMAKE_CURRENT_SOURCE_DIR}/${name}.cpp
+        SOURCES ${name}.ispc
+        ISPC_TARGETS "${${target}_ISPC_TARGETS}"
+        ISPC_FLAGS "${${target}_ISPC_FLAGS}")
+
+    target_sources(
+        ${target}
+        PRIVATE ${name}.cpp
+                ${PROJECT_SOURCE_DIR}/../ispcrt/ispc_tasking.cpp)
+
+    target_compile_definitions(
+        ${target}
+        PRIVATE ${definition}
+                BENCHMARKS_TASK_SYSTEM=\"${task_system}\"
+                BENCHMARKS_ISPC_TARGETS=\"${${target}_ISPC_TARGETS}\"
+                BENCHMARKS_ISPC_FLAGS=\"${${target}_ISPC_FLAGS}\")
+
+    target_link_libraries(${target} PRIVATE benchmark ${library})
+
+    get_filename_component(INSTALL_SUBFOLDER "${CMAKE_CURRENT_SOURCE_DIR}" NAME)
+
+    install(
+        TARGETS ${target}
+        RUNTIME DESTINATION "benchmarks/${INSTALL_SUBFOLDER}")
+
+    add_test(NAME ${target}_test COMMAND ${target} --benchmark_min_time=0.01)
+    add_dependencies(${BENCHMARKS_PROJECT_NAME} ${target})
+endfunction()
+
+# A macro to add a tasking benchmark once for every task system that can be
+# built on the host: the platform default ones, work stealing, and OpenMP and
+# TBB when they are found.
+macro(compile_tasking_benchmark_test name)
+    find_package(Threads REQUIRED)
+    find_package(OpenMP QUIET)
+    find_package(TBB QUIET COMPONENTS tbb)
+
+    if(WIN32)
+        add_tasking_benchmark(${name} concrt ISPC_USE_CONCRT "")
+    elseif(APPLE)
+        add_tasking_benchmark(${name} gcd ISPC_USE_GCD "")
+    else()
+        add_tasking_benchmark(${name} pthreads ISPC_USE_PTHREADS Threads::Threads)
+    endif()
+    add_tasking_benchmark(${name} work_stealing ISPC_USE_WORK_STEALING Threads::Threads)
+    if(OpenMP_CXX_FOUND)
+        add_tasking_benchmark(${name} omp ISPC_USE_OMP OpenMP::OpenMP_CXX)
+    endif()
+    if(TBB_FOUND)
+        add_tasking_benchmark(${name} tbb_parallel_for ISPC_USE_TBB_PARALLEL_FOR TBB::tbb)
+        add_tasking_benchmark(${name} tbb_task_group ISPC_USE_TBB_TASK_GROUP TBB::tbb)
+    endif()
+endmacro(compile_tasking_benchmark_test)
@@ -12,7 +12,7 @@ parser.add_argument("src", help="Source file to process")
 parser.add_argument("--type", help="Type of processed file", choices=['dispatch', 'builtins-c', 'ispc-target'], required=True)
 parser.add_argument("--runtime", help="Runtime", choices=['32', '64'], nargs='?', default='')
 parser.add_argument("--os", help="Target OS", choices=['windows', 'linux', 'macos', 'freebsd', 'android', 'ios', 'ps4', 'web', 'WINDOWS', 'UNIX', 'WEB'], default='')
-parser.add_argument("--arch", help="Target architecture", choices=['i686', 'x86_64', 'armv7', 'arm64', 'aarch64', 'wasm32', 'xe32', 'xe64'], default='')
+parser.add_argument("--arch", help="Target architecture", choices=['i686', 'x86_64', 'armv7', 'arm64', 'aarch64', 'riscv64', 'wasm32', 'xe32', 'xe64'], default='')
 parser.add_argument("--llvm_as", help="Path to LLVM assembler executable", dest="path_to_llvm_as")
 args = parser.parse_known_args()
 src = args[0].src
@@ -63,7 +63,7 @@ else:
 
 target_arch = ""
 ispc_arch = ""
-if args[0].arch in ["i686", "x86_64", "amd64", "armv7", "arm64", "aarch64", "wasm32", "xe32", "xe64"]:
+if args[0].arch in ["i686", "x86_64", "amd64", "armv7", "arm64", "aarch64", "riscv64", "wasm32", "xe32", "xe64"]:
     target_arch = args[0].arch + "_"
     # Canoncalization of arch value for Arch enum in ISPC.
     if args[0].arch == "i686":
@@ -74,6 +74,8 @@ if args[0].arch in ["i686", "x86_64", "amd64", "armv7", "arm64", "aarch64", "was
         ispc_arch = "arm"
     elif args[0].arch == "arm64" or args[0].arch == "aarch64":
         ispc_arch = "aarch64"
+    elif args[0].arch == "riscv64":
+        ispc_arch = "riscv64"
     elif args[0].arch == "wasm32":
         ispc_arch = "wasm32"
     elif args[0].arch == "xe32" or args[0].arch == "xe64":
@@ -125,6 +127,10 @@ elif args[0].type == 'ispc-target':
         arch = "x86" if args[0].runtime == "32" else "x86_64" if args[0].runtime == "64" else "error"
     elif "neon" in target:
         arch = "arm" if args[0].runtime == "32" else "aarch64" if args[0].runtime == "64" else "error"
+    elif "sve" in target:
+        arch = "aarch64" if args[0].runtime == "64" else "error"
+    elif "rvv" in target:
+        arch = "riscv64" if args[0].runtime == "64" else "error"
     elif "wasm" in target:
         arch = "wasm32"
     elif ("gen9" in target) or ("xe" in target):
@@ -221,6 +221,40 @@ return:                                          ; preds = %if.else, %if.else70,
 
 declare void @abort() noreturn nounwind
 
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; Hybrid processors have cores of different types, and a thread may migrate
+;; between them at any time, so the AVX-512 ISAs are only selected if every
+;; core supports them, which isn't known on hybrid processors.  This
+;; function takes the value of __get_system_isa() and returns the AVX2 ISA
+;; instead of the AVX-512 ones on processors with the hybrid CPUID bit:
+;;
+;; int32_t __hybrid_safe_isa(int32_t isa) {
+;;     if (isa <= 3)
+;;         return isa;
+;;     // Call cpuid with eax=7, ecx=0
+;;     int info[4];
+;;     __cpuid_count(info, 7, 0);
+;;     _Bool hybrid = (info[3] & (1 << 15)) != 0;
+;;     return hybrid ? 3 : isa; // AVX2
+;; }
+
+define internal i32 @__hybrid_safe_isa(i32 %isa) nounwind uwtable {
+entry:
+  %avx512 = icmp sgt i32 %isa, 3
+  br i1 %avx512, label %check_hybrid, label %done
+
+check_hybrid:
+  %0 = tail call { i32, i32, i32, i32 } asm sideeffect "xchg$(l$)\09$(%$)ebx, $1\0A\09cpuid\0A\09xchg$(l$)\09$(%$)ebx, $1\0A\09", "={ax},=r,={cx},={dx},0,2,~{dirflag},~{fpsr},~{flags}"(i32 7, i32 0) nounwind
+  %edx = extractvalue { i32, i32, i32, i32 } %0, 3
+  %hybrid_bit = and i32 %edx, 32768
+  %hybrid = icmp ne i32 %hybrid_bit, 0
+  %safe_isa = select i1 %hybrid, i32 3, i32 %isa
+  ret i32 %safe_isa
+
+done:
+  ret i32 %isa
+}
+
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ;; This function is called by each of the dispatch functions we generate;
 ;; it sets @__system_best_isa if it is unset.
@@ -232,7 +266,8 @@ entry:
   br i1 %unset, label %set_system_isa, label %done
 
 set_system_isa:
-  %bival = call i32 @__get_system_isa()
+  %isa = call i32 @__get_system_isa()
+  %bival = call i32 @__hybrid_safe_isa(i32 %isa)
   store i32 %bival, i32* @__system_best_isa
   ret void
 
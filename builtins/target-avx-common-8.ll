@@ -34,6 +34,7 @@
 
 define(`WIDTH',`8')
 define(`MASK',`i32')
+define(`HAVE_CRC32C',`1')
 include(`util.m4')
 
 stdlib_core()
@@ -34,6 +34,7 @@
 
 define(`WIDTH',`4')
 define(`MASK',`i64')
+define(`HAVE_CRC32C',`1')
 include(`util.m4')
 
 stdlib_core()
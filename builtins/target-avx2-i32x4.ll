@@ -34,6 +34,7 @@ define(`HAVE_GATHER', `1')
 define(`WIDTH',`4')
 define(`MASK',`i32')
 define(`ISA',`AVX2')
+define(`HAVE_CRC32C',`1')
 include(`util.m4')
 
 stdlib_core()
@@ -33,6 +33,7 @@ define(`WIDTH',`32')
 define(`MASK',`i8')
 define(`HAVE_GATHER',`1')
 define(`ISA',`AVX2')
+define(`HAVE_CRC32C',`1')
 
 include(`util.m4')
 
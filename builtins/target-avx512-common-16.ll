@@ -32,6 +32,7 @@
 define(`MASK',`i1')
 define(`HAVE_GATHER',`1')
 define(`HAVE_SCATTER',`1')
+define(`HAVE_CONFLICT',`1')
 
 include(`target-avx512-utils.ll')
 
@@ -34,6 +34,7 @@ define(`MASK',`i1')
 define(`HAVE_GATHER',`1')
 define(`HAVE_SCATTER',`1')
 define(`ISA',`AVX512SKX')
+define(`HAVE_CRC32C',`1')
 
 include(`util.m4')
 
@@ -34,6 +34,7 @@ define(`MASK',`i1')
 define(`HAVE_GATHER',`1')
 define(`HAVE_SCATTER',`1')
 define(`ISA',`AVX512SKX')
+define(`HAVE_CRC32C',`1')
 
 include(`util.m4')
 
@@ -794,18 +795,18 @@ define i64 @__reduce_max_uint64(<64 x i64>) nounwind readnone alwaysinline {
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ;; unaligned loads/loads+broadcasts
 
-masked_load(i8,  1)
-masked_load(i16, 2)
-masked_load(half, 2)
-masked_load(i32, 4)
-masked_load(float, 4)
-masked_load(i64, 8)
-masked_load(double, 8)
+gen_masked_load_native(i8, v64i8, 1)
+gen_masked_load_native(i16, v64i16, 2)
+gen_masked_load_native(half, v64f16, 2)
+gen_masked_load_native(i32, v64i32, 4)
+gen_masked_load_native(float, v64f32, 4)
+gen_masked_load_native(i64, v64i64, 8)
+gen_masked_load_native(double, v64f64, 8)
 
-gen_masked_store(i8)
-gen_masked_store(i16)
-gen_masked_store(i32)
-gen_masked_store(i64)
+gen_masked_store_native(i8, v64i8, 1)
+gen_masked_store_native(i16, v64i16, 2)
+gen_masked_store_native(i32, v64i32, 4)
+gen_masked_store_native(i64, v64i64, 8)
 
 masked_store_float_double()
 
@@ -927,4 +928,4 @@ rcpd_decl()
 transcendetals_decl()
 trigonometry_decl()
 
-saturation_arithmetic_novec()
+saturation_arithmetic_native()
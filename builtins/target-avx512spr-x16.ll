@@ -31,6 +31,7 @@
 
 define(`WIDTH',`16')
 define(`ISA',`AVX512SKX')
+define(`HAVE_VNNI',`1')
 
 include(`target-avx512-common-16.ll')
 
@@ -31,6 +31,7 @@
 
 define(`WIDTH',`4')
 define(`ISA',`AVX512SKX')
+define(`HAVE_VNNI',`1')
 
 include(`target-avx512-common-4.ll')
 
@@ -0,0 +1,513 @@
+;;  Copyright (c) 2023, Intel Corporation
+;;  All rights reserved.
+;;
+;;  Redistribution and use in source and binary forms, with or without
+;;  modification, are permitted provided that the following conditions are
+;;  met:
+;;
+;;    * Redistributions of source code must retain the above copyright
+;;      notice, this list of conditions and the following disclaimer.
+;;
+;;    * Redistributions in binary form must reproduce the above copyright
+;;      notice, this list of conditions and the following disclaimer in the
+;;      documentation and/or other materials provided with the distribution.
+;;
+;;    * Neither the name of Intel Corporation nor the names of its
+;;      contributors may be used to endorse or promote products derived from
+;;      this software without specific prior written permission.
+;;
+;;
+;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+;;   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+;;   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+;;   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+;;   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+;;   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+;;   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+;; Common definitions for targets with predicated vector instruction sets
+;; (SVE, RVV).
+;;
+;; The mask is a vector of i1, which the backend keeps in predicate (mask)
+;; registers. Everything here is written in terms of target independent LLVM
+;; vector operations and intrinsics (masked load/store, masked gather/scatter,
+;; vector reductions); the backend lowers them to predicated instructions
+;; because the module is compiled with a known minimal vector length.
+;;
+;; Floating point environment control (__fastmath() and FTZ/DAZ handling)
+;; differs between architectures and is defined by the including file.
+
+define(`MASK',`i1')
+define(`HAVE_GATHER',`1')
+define(`HAVE_SCATTER',`1')
+
+include(`util.m4')
+
+;; LLVM intrinsic mangling suffixes for the element type $1.
+define(`PRED_ST',
+`ifelse($1, `half', `f16', $1, `float', `f32', $1, `double', `f64', $1)')
+define(`PRED_VT', `v'WIDTH`'PRED_ST($1))
+define(`PRED_VPT', `v'WIDTH`p0'PRED_ST($1))
+
+stdlib_core()
+scans()
+reduce_equal(WIDTH)
+rdrand_decls()
+define_shuffles()
+aossoa()
+ctlztz()
+popcnt()
+halfTypeGenericImplementation()
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; half conversion routines
+
+define float @__half_to_float_uniform(i16 %v) nounwind readnone alwaysinline {
+  %h = bitcast i16 %v to half
+  %r = fpext half %h to float
+  ret float %r
+}
+
+define i16 @__float_to_half_uniform(float %v) nounwind readnone alwaysinline {
+  %h = fptrunc float %v to half
+  %r = bitcast half %h to i16
+  ret i16 %r
+}
+
+define <WIDTH x float> @__half_to_float_varying(<WIDTH x i16> %v) nounwind readnone alwaysinline {
+  %h = bitcast <WIDTH x i16> %v to <WIDTH x half>
+  %r = fpext <WIDTH x half> %h to <WIDTH x float>
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x i16> @__float_to_half_varying(<WIDTH x float> %v) nounwind readnone alwaysinline {
+  %h = fptrunc <WIDTH x float> %v to <WIDTH x half>
+  %r = bitcast <WIDTH x half> %h to <WIDTH x i16>
+  ret <WIDTH x i16> %r
+}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; round/floor/ceil
+
+;; $1: type, $2: ispc function name, $3: llvm intrinsic name
+define(`pred_unary_fp', `
+declare $1 @llvm.$3.PRED_ST($1)($1)
+declare <WIDTH x $1> @llvm.$3.PRED_VT($1)(<WIDTH x $1>)
+
+define $1 @__$2_uniform_$1($1) nounwind readnone alwaysinline {
+  %r = call $1 @llvm.$3.PRED_ST($1)($1 %0)
+  ret $1 %r
+}
+
+define <WIDTH x $1> @__$2_varying_$1(<WIDTH x $1>) nounwind readnone alwaysinline {
+  %r = call <WIDTH x $1> @llvm.$3.PRED_VT($1)(<WIDTH x $1> %0)
+  ret <WIDTH x $1> %r
+}
+')
+
+pred_unary_fp(float, round, nearbyint)
+pred_unary_fp(float, floor, floor)
+pred_unary_fp(float, ceil, ceil)
+pred_unary_fp(double, round, nearbyint)
+pred_unary_fp(double, floor, floor)
+pred_unary_fp(double, ceil, ceil)
+
+truncate()
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; min/max
+
+;; $1: type, $2: ispc type name, $3: comparison for min, $4: comparison for max
+define(`pred_minmax', `
+define $1 @__min_uniform_$2($1, $1) nounwind readnone alwaysinline {
+  %cmp = $3 $1 %0, %1
+  %r = select i1 %cmp, $1 %0, $1 %1
+  ret $1 %r
+}
+
+define $1 @__max_uniform_$2($1, $1) nounwind readnone alwaysinline {
+  %cmp = $4 $1 %0, %1
+  %r = select i1 %cmp, $1 %0, $1 %1
+  ret $1 %r
+}
+
+define <WIDTH x $1> @__min_varying_$2(<WIDTH x $1>, <WIDTH x $1>) nounwind readnone alwaysinline {
+  %m = $3 <WIDTH x $1> %0, %1
+  %r = select <WIDTH x i1> %m, <WIDTH x $1> %0, <WIDTH x $1> %1
+  ret <WIDTH x $1> %r
+}
+
+define <WIDTH x $1> @__max_varying_$2(<WIDTH x $1>, <WIDTH x $1>) nounwind readnone alwaysinline {
+  %m = $4 <WIDTH x $1> %0, %1
+  %r = select <WIDTH x i1> %m, <WIDTH x $1> %0, <WIDTH x $1> %1
+  ret <WIDTH x $1> %r
+}
+')
+
+pred_minmax(i32, int32, icmp slt, icmp sgt)
+pred_minmax(i32, uint32, icmp ult, icmp ugt)
+pred_minmax(i64, int64, icmp slt, icmp sgt)
+pred_minmax(i64, uint64, icmp ult, icmp ugt)
+pred_minmax(float, float, fcmp olt, fcmp ogt)
+pred_minmax(double, double, fcmp olt, fcmp ogt)
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; sqrt/rsqrt/rcp
+
+pred_unary_fp(float, sqrt, sqrt)
+pred_unary_fp(double, sqrt, sqrt)
+
+define float @__rcp_uniform_float(float) nounwind readnone alwaysinline {
+  %r = fdiv float 1., %0
+  ret float %r
+}
+
+define float @__rcp_fast_uniform_float(float) nounwind readnone alwaysinline {
+  %r = fdiv fast float 1., %0
+  ret float %r
+}
+
+define float @__rsqrt_uniform_float(float) nounwind readnone alwaysinline {
+  %s = call float @llvm.sqrt.f32(float %0)
+  %r = fdiv float 1., %s
+  ret float %r
+}
+
+define float @__rsqrt_fast_uniform_float(float) nounwind readnone alwaysinline {
+  %s = call fast float @llvm.sqrt.f32(float %0)
+  %r = fdiv fast float 1., %s
+  ret float %r
+}
+
+define <WIDTH x float> @__rcp_varying_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  %r = fdiv <WIDTH x float> const_vector(float, 1.), %0
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x float> @__rcp_fast_varying_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  %r = fdiv fast <WIDTH x float> const_vector(float, 1.), %0
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x float> @__rsqrt_varying_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  %s = call <WIDTH x float> @llvm.sqrt.PRED_VT(float)(<WIDTH x float> %0)
+  %r = fdiv <WIDTH x float> const_vector(float, 1.), %s
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x float> @__rsqrt_fast_varying_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  %s = call fast <WIDTH x float> @llvm.sqrt.PRED_VT(float)(<WIDTH x float> %0)
+  %r = fdiv fast <WIDTH x float> const_vector(float, 1.), %s
+  ret <WIDTH x float> %r
+}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; reciprocals in double precision, if supported
+
+rsqrtd_decl()
+rcpd_decl()
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; rcp/rsqrt declarations for half
+rcph_rsqrth_decl
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; svml
+
+include(`svml.m4')
+svml_stubs(float,f,WIDTH)
+svml_stubs(double,d,WIDTH)
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; mask handling
+
+define i64 @__movmsk(<WIDTH x MASK> %mask) nounwind readnone alwaysinline {
+  %intmask = bitcast <WIDTH x MASK> %mask to i`'WIDTH
+  %res = zext i`'WIDTH %intmask to i64
+  ret i64 %res
+}
+
+define i1 @__any(<WIDTH x MASK> %mask) nounwind readnone alwaysinline {
+  %intmask = bitcast <WIDTH x MASK> %mask to i`'WIDTH
+  %res = icmp ne i`'WIDTH %intmask, 0
+  ret i1 %res
+}
+
+define i1 @__all(<WIDTH x MASK> %mask) nounwind readnone alwaysinline {
+  %intmask = bitcast <WIDTH x MASK> %mask to i`'WIDTH
+  %res = icmp eq i`'WIDTH %intmask, -1
+  ret i1 %res
+}
+
+define i1 @__none(<WIDTH x MASK> %mask) nounwind readnone alwaysinline {
+  %intmask = bitcast <WIDTH x MASK> %mask to i`'WIDTH
+  %res = icmp eq i`'WIDTH %intmask, 0
+  ret i1 %res
+}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; reductions
+
+;; $1: element type, $2: ispc type name, $3: widened result type
+define(`pred_reduce_add_int', `
+declare $3 @llvm.vector.reduce.add.PRED_VT($3)(<WIDTH x $3>)
+
+define $3 @__reduce_add_$2(<WIDTH x $1>) nounwind readnone alwaysinline {
+  %ext = sext <WIDTH x $1> %0 to <WIDTH x $3>
+  %r = call $3 @llvm.vector.reduce.add.PRED_VT($3)(<WIDTH x $3> %ext)
+  ret $3 %r
+}
+')
+
+pred_reduce_add_int(i8, int8, i16)
+pred_reduce_add_int(i16, int16, i32)
+pred_reduce_add_int(i32, int32, i64)
+
+define i64 @__reduce_add_int64(<WIDTH x i64>) nounwind readnone alwaysinline {
+  %r = call i64 @llvm.vector.reduce.add.PRED_VT(i64)(<WIDTH x i64> %0)
+  ret i64 %r
+}
+
+;; $1: element type, $2: ispc type name, $3: ispc reduction, $4: llvm reduction
+define(`pred_reduce_minmax', `
+declare $1 @llvm.vector.reduce.$4.PRED_VT($1)(<WIDTH x $1>)
+
+define $1 @__reduce_$3_$2(<WIDTH x $1>) nounwind readnone alwaysinline {
+  %r = call $1 @llvm.vector.reduce.$4.PRED_VT($1)(<WIDTH x $1> %0)
+  ret $1 %r
+}
+')
+
+pred_reduce_minmax(i32, int32, min, smin)
+pred_reduce_minmax(i32, int32, max, smax)
+pred_reduce_minmax(i32, uint32, min, umin)
+pred_reduce_minmax(i32, uint32, max, umax)
+pred_reduce_minmax(i64, int64, min, smin)
+pred_reduce_minmax(i64, int64, max, smax)
+pred_reduce_minmax(i64, uint64, min, umin)
+pred_reduce_minmax(i64, uint64, max, umax)
+pred_reduce_minmax(float, float, min, fmin)
+pred_reduce_minmax(float, float, max, fmax)
+pred_reduce_minmax(double, double, min, fmin)
+pred_reduce_minmax(double, double, max, fmax)
+
+;; reduce_add() does not promise any particular association order, so let
+;; LLVM emit a tree reduction (faddv) rather than a strictly ordered one.
+declare float @llvm.vector.reduce.fadd.PRED_VT(float)(float, <WIDTH x float>)
+declare double @llvm.vector.reduce.fadd.PRED_VT(double)(double, <WIDTH x double>)
+
+define float @__reduce_add_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  %r = call reassoc float @llvm.vector.reduce.fadd.PRED_VT(float)(float -0., <WIDTH x float> %0)
+  ret float %r
+}
+
+define double @__reduce_add_double(<WIDTH x double>) nounwind readnone alwaysinline {
+  %r = call reassoc double @llvm.vector.reduce.fadd.PRED_VT(double)(double -0., <WIDTH x double> %0)
+  ret double %r
+}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; masked load/store
+
+;; $1: type, $2: alignment
+define(`pred_masked_load', `
+declare <WIDTH x $1> @llvm.masked.load.PRED_VT($1).p0`'PRED_VT($1)(<WIDTH x $1>*, i32, <WIDTH x i1>, <WIDTH x $1>)
+
+define <WIDTH x $1> @__masked_load_$1(i8 * %ptr, <WIDTH x MASK> %mask) nounwind readonly alwaysinline {
+  %ptr_typed = bitcast i8* %ptr to <WIDTH x $1>*
+  %r = call <WIDTH x $1> @llvm.masked.load.PRED_VT($1).p0`'PRED_VT($1)(<WIDTH x $1>* %ptr_typed, i32 $2,
+                                         <WIDTH x i1> %mask, <WIDTH x $1> undef)
+  ret <WIDTH x $1> %r
+}
+')
+
+pred_masked_load(i8, 1)
+pred_masked_load(i16, 2)
+pred_masked_load(half, 2)
+pred_masked_load(i32, 4)
+pred_masked_load(float, 4)
+pred_masked_load(i64, 8)
+pred_masked_load(double, 8)
+
+define(`pred_masked_store', `
+declare void @llvm.masked.store.PRED_VT($1).p0`'PRED_VT($1)(<WIDTH x $1>, <WIDTH x $1>*, i32, <WIDTH x i1>)
+
+define void @__masked_store_$1(<WIDTH x $1>* nocapture, <WIDTH x $1>,
+                               <WIDTH x MASK>) nounwind alwaysinline {
+  call void @llvm.masked.store.PRED_VT($1).p0`'PRED_VT($1)(<WIDTH x $1> %1, <WIDTH x $1>* %0, i32 $2,
+                                                   <WIDTH x i1> %2)
+  ret void
+}
+')
+
+pred_masked_store(i8, 1)
+pred_masked_store(i16, 2)
+pred_masked_store(i32, 4)
+pred_masked_store(i64, 8)
+masked_store_float_double()
+
+define(`pred_masked_store_blend', `
+define void @__masked_store_blend_$1(<WIDTH x $1>* nocapture, <WIDTH x $1>,
+                                     <WIDTH x MASK>) nounwind alwaysinline {
+  %v = load PTR_OP_ARGS(`<WIDTH x $1> ')  %0
+  %v1 = select <WIDTH x i1> %2, <WIDTH x $1> %1, <WIDTH x $1> %v
+  store <WIDTH x $1> %v1, <WIDTH x $1> * %0
+  ret void
+}
+')
+
+pred_masked_store_blend(i8)
+pred_masked_store_blend(i16)
+pred_masked_store_blend(i32)
+pred_masked_store_blend(i64)
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; gather/scatter
+
+;; Both are expressed with the generic masked intrinsics on a vector of
+;; pointers, which the backend maps to indexed predicated loads and stores.
+;; $1: type, $2: alignment
+define(`pred_gather', `
+declare <WIDTH x $1> @llvm.masked.gather.PRED_VT($1).PRED_VPT($1)(<WIDTH x $1*>, i32, <WIDTH x i1>, <WIDTH x $1>)
+
+define <WIDTH x $1>
+@__gather_base_offsets64_$1(i8 * %ptr, i32 %offset_scale, <WIDTH x i64> %offsets,
+                            <WIDTH x MASK> %vecmask) nounwind readonly alwaysinline {
+  %scale64 = sext i32 %offset_scale to i64
+  %scale_ins = insertelement <WIDTH x i64> undef, i64 %scale64, i32 0
+  %scale_vec = shufflevector <WIDTH x i64> %scale_ins, <WIDTH x i64> undef, <WIDTH x i32> zeroinitializer
+  %byte_offsets = mul <WIDTH x i64> %offsets, %scale_vec
+  %ptrs_i8 = getelementptr i8, i8 * %ptr, <WIDTH x i64> %byte_offsets
+  %ptrs = bitcast <WIDTH x i8*> %ptrs_i8 to <WIDTH x $1*>
+  %res = call <WIDTH x $1> @llvm.masked.gather.PRED_VT($1).PRED_VPT($1)(<WIDTH x $1*> %ptrs, i32 $2,
+                                         <WIDTH x i1> %vecmask, <WIDTH x $1> undef)
+  ret <WIDTH x $1> %res
+}
+
+define <WIDTH x $1>
+@__gather_base_offsets32_$1(i8 * %ptr, i32 %offset_scale, <WIDTH x i32> %offsets,
+                            <WIDTH x MASK> %vecmask) nounwind readonly alwaysinline {
+  %offsets64 = sext <WIDTH x i32> %offsets to <WIDTH x i64>
+  %res = call <WIDTH x $1> @__gather_base_offsets64_$1(i8 * %ptr, i32 %offset_scale,
+                                         <WIDTH x i64> %offsets64, <WIDTH x MASK> %vecmask)
+  ret <WIDTH x $1> %res
+}
+
+define <WIDTH x $1>
+@__gather64_$1(<WIDTH x i64> %ptrs, <WIDTH x MASK> %vecmask) nounwind readonly alwaysinline {
+  %ptrs_typed = inttoptr <WIDTH x i64> %ptrs to <WIDTH x $1*>
+  %res = call <WIDTH x $1> @llvm.masked.gather.PRED_VT($1).PRED_VPT($1)(<WIDTH x $1*> %ptrs_typed, i32 $2,
+                                         <WIDTH x i1> %vecmask, <WIDTH x $1> undef)
+  ret <WIDTH x $1> %res
+}
+
+define <WIDTH x $1>
+@__gather32_$1(<WIDTH x i32> %ptrs, <WIDTH x MASK> %vecmask) nounwind readonly alwaysinline {
+  %ptrs64 = zext <WIDTH x i32> %ptrs to <WIDTH x i64>
+  %res = call <WIDTH x $1> @__gather64_$1(<WIDTH x i64> %ptrs64, <WIDTH x MASK> %vecmask)
+  ret <WIDTH x $1> %res
+}
+')
+
+define(`pred_scatter', `
+declare void @llvm.masked.scatter.PRED_VT($1).PRED_VPT($1)(<WIDTH x $1>, <WIDTH x $1*>, i32, <WIDTH x i1>)
+
+define void
+@__scatter_base_offsets64_$1(i8* %ptr, i32 %offset_scale, <WIDTH x i64> %offsets,
+                             <WIDTH x $1> %vals, <WIDTH x MASK> %vecmask) nounwind {
+  %scale64 = sext i32 %offset_scale to i64
+  %scale_ins = insertelement <WIDTH x i64> undef, i64 %scale64, i32 0
+  %scale_vec = shufflevector <WIDTH x i64> %scale_ins, <WIDTH x i64> undef, <WIDTH x i32> zeroinitializer
+  %byte_offsets = mul <WIDTH x i64> %offsets, %scale_vec
+  %ptrs_i8 = getelementptr i8, i8 * %ptr, <WIDTH x i64> %byte_offsets
+  %ptrs = bitcast <WIDTH x i8*> %ptrs_i8 to <WIDTH x $1*>
+  call void @llvm.masked.scatter.PRED_VT($1).PRED_VPT($1)(<WIDTH x $1> %vals, <WIDTH x $1*> %ptrs, i32 $2,
+                                                   <WIDTH x i1> %vecmask)
+  ret void
+}
+
+define void
+@__scatter_base_offsets32_$1(i8* %ptr, i32 %offset_scale, <WIDTH x i32> %offsets,
+                             <WIDTH x $1> %vals, <WIDTH x MASK> %vecmask) nounwind {
+  %offsets64 = sext <WIDTH x i32> %offsets to <WIDTH x i64>
+  call void @__scatter_base_offsets64_$1(i8* %ptr, i32 %offset_scale, <WIDTH x i64> %offsets64,
+                                         <WIDTH x $1> %vals, <WIDTH x MASK> %vecmask)
+  ret void
+}
+
+define void
+@__scatter64_$1(<WIDTH x i64> %ptrs, <WIDTH x $1> %values, <WIDTH x MASK> %vecmask) nounwind alwaysinline {
+  %ptrs_typed = inttoptr <WIDTH x i64> %ptrs to <WIDTH x $1*>
+  call void @llvm.masked.scatter.PRED_VT($1).PRED_VPT($1)(<WIDTH x $1> %values, <WIDTH x $1*> %ptrs_typed, i32 $2,
+                                                   <WIDTH x i1> %vecmask)
+  ret void
+}
+
+define void
+@__scatter32_$1(<WIDTH x i32> %ptrs, <WIDTH x $1> %values, <WIDTH x MASK> %vecmask) nounwind alwaysinline {
+  %ptrs64 = zext <WIDTH x i32> %ptrs to <WIDTH x i64>
+  call void @__scatter64_$1(<WIDTH x i64> %ptrs64, <WIDTH x $1> %values, <WIDTH x MASK> %vecmask)
+  ret void
+}
+')
+
+pred_gather(i8, 1)
+pred_gather(i16, 2)
+pred_gather(half, 2)
+pred_gather(i32, 4)
+pred_gather(float, 4)
+pred_gather(i64, 8)
+pred_gather(double, 8)
+
+pred_scatter(i8, 1)
+pred_scatter(i16, 2)
+pred_scatter(half, 2)
+pred_scatter(i32, 4)
+pred_scatter(float, 4)
+pred_scatter(i64, 8)
+pred_scatter(double, 8)
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; packed_load/store
+
+packed_load_and_store(TRUE)
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; prefetch
+
+define_prefetches()
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; int8/int16 builtins
+
+define_avgs()
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; saturation arithmetic
+
+;; $1: type, $2: ispc function name, $3: llvm intrinsic name
+define(`pred_saturation', `
+declare <WIDTH x $1> @llvm.$3.PRED_VT($1)(<WIDTH x $1>, <WIDTH x $1>)
+
+define <WIDTH x $1> @__$2(<WIDTH x $1>, <WIDTH x $1>) nounwind readnone alwaysinline {
+  %r = call <WIDTH x $1> @llvm.$3.PRED_VT($1)(<WIDTH x $1> %0, <WIDTH x $1> %1)
+  ret <WIDTH x $1> %r
+}
+')
+
+pred_saturation(i8, padds_vi8, sadd.sat)
+pred_saturation(i16, padds_vi16, sadd.sat)
+pred_saturation(i8, paddus_vi8, uadd.sat)
+pred_saturation(i16, paddus_vi16, uadd.sat)
+pred_saturation(i8, psubs_vi8, ssub.sat)
+pred_saturation(i16, psubs_vi16, ssub.sat)
+pred_saturation(i8, psubus_vi8, usub.sat)
+pred_saturation(i16, psubus_vi16, usub.sat)
+
+;; Trigonometry
+transcendetals_decl()
+trigonometry_decl()
@@ -0,0 +1,62 @@
+;;  Copyright (c) 2023, Intel Corporation
+;;  All rights reserved.
+;;
+;;  Redistribution and use in source and binary forms, with or without
+;;  modification, are permitted provided that the following conditions are
+;;  met:
+;;
+;;    * Redistributions of source code must retain the above copyright
+;;      notice, this list of conditions and the following disclaimer.
+;;
+;;    * Redistributions in binary form must reproduce the above copyright
+;;      notice, this list of conditions and the following disclaimer in the
+;;      documentation and/or other materials provided with the distribution.
+;;
+;;    * Neither the name of Intel Corporation nor the names of its
+;;      contributors may be used to endorse or promote products derived from
+;;      this software without specific prior written permission.
+;;
+;;
+;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+;;   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+;;   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+;;   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+;;   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+;;   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+;;   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+;; Common definitions for the SVE targets.
+
+include(`target-predicated-common.ll')
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; math
+
+declare void @llvm.aarch64.set.fpcr(i64) nounwind
+declare i64 @llvm.aarch64.get.fpcr() nounwind
+
+define void @__fastmath() nounwind alwaysinline {
+  %x = call i64 @llvm.aarch64.get.fpcr()
+  ; Turn on FTZ (bit 24) and default NaN (bit 25)
+  %y = or i64 %x, 50331648
+  call void @llvm.aarch64.set.fpcr(i64 %y)
+  ret void
+}
+
+define i64 @__set_ftz_daz_flags() nounwind alwaysinline {
+  %x = call i64 @llvm.aarch64.get.fpcr()
+  ; Turn on FTZ (bit 24) and default NaN (bit 25)
+  %y = or i64 %x, 50331648
+  call void @llvm.aarch64.set.fpcr(i64 %y)
+  ret i64 %x
+}
+
+define void @__restore_ftz_daz_flags(i64 %oldVal) nounwind alwaysinline {
+  ; restore value to previously saved
+  call void @llvm.aarch64.set.fpcr(i64 %oldVal)
+  ret void
+}
@@ -46,6 +46,7 @@ define(`ISA',`WASM')
 define(`HAS_CUSTOM_CLOCK',`1')
 
 include(`util.m4')
+ifdef(`WASM_RELAXED_SIMD', `include(`target-wasm-relaxed-common.ll')')
 
 stdlib_core()
 scans()
@@ -152,6 +153,10 @@ define void @__masked_store_blend_i16(<WIDTH x i16>* nocapture %ptr, <WIDTH x i1
   ret void
 }
 
+ifdef(`WASM_RELAXED_SIMD', `
+relaxed_masked_store_blend(i32)
+relaxed_masked_store_blend(i64)
+', `
 define void @__masked_store_blend_i32(<WIDTH x i32>* nocapture %ptr, <WIDTH x i32> %new, 
                                       <WIDTH x MASK> %mask) nounwind alwaysinline {
   %old = load PTR_OP_ARGS(`<WIDTH x i32> ')  %ptr
@@ -169,6 +174,7 @@ define void @__masked_store_blend_i64(<WIDTH x i64>* nocapture %ptr,
   store <WIDTH x i64> %result, <WIDTH x i64> * %ptr
   ret void
 }
+')
 
 define i64 @__movmsk(<WIDTH x MASK> %mask) nounwind readnone alwaysinline {
   %mask1 = trunc <WIDTH x MASK> %mask to <WIDTH x i1>
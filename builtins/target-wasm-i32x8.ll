@@ -0,0 +1,484 @@
+;;  Copyright (c) 2023, Intel Corporation
+;;  All rights reserved.
+;;
+;;  Redistribution and use in source and binary forms, with or without
+;;  modification, are permitted provided that the following conditions are
+;;  met:
+;;
+;;    * Redistributions of source code must retain the above copyright
+;;      notice, this list of conditions and the following disclaimer.
+;;
+;;    * Redistributions in binary form must reproduce the above copyright
+;;      notice, this list of conditions and the following disclaimer in the
+;;      documentation and/or other materials provided with the distribution.
+;;
+;;    * Neither the name of Intel Corporation nor the names of its
+;;      contributors may be used to endorse or promote products derived from
+;;      this software without specific prior written permission.
+;;
+;;
+;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+;;   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+;;   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+;;   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+;;   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+;;   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+;;   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+;; 8-wide WebAssembly target: every varying value is a pair of 128-bit
+;; SIMD registers and most operations are written against generic LLVM
+;; vectors, which the backend splits in halves.
+
+define(`WIDTH',`8')
+;; FIXME: Workaround for "BUILD_OS should be defined to either UNIX or WINDOWS" error
+define(`BUILD_OS',`UNIX')
+define(`RUNTIME',`32')
+define(`MASK',`i32')
+define(`ISA',`WASM')
+;; Wasm has custom clock function
+define(`HAS_CUSTOM_CLOCK',`1')
+
+include(`util.m4')
+ifdef(`WASM_RELAXED_SIMD', `include(`target-wasm-relaxed-common.ll')')
+
+stdlib_core()
+scans()
+rdrand_decls()
+define_shuffles()
+aossoa()
+ctlztz()
+trigonometry_decl()
+transcendetals_decl()
+include(`svml.m4')
+svml_stubs(float,f,WIDTH)
+svml_stubs(double,d,WIDTH)
+define_avgs()
+saturation_arithmetic_novec()
+halfTypeGenericImplementation()
+
+declare float @__half_to_float_uniform(i16 %v) nounwind readnone
+declare <WIDTH x float> @__half_to_float_varying(<WIDTH x i16> %v) nounwind readnone
+declare i16 @__float_to_half_uniform(float %v) nounwind readnone
+declare <WIDTH x i16> @__float_to_half_varying(<WIDTH x float> %v) nounwind readnone
+
+define i1 @__wasm_cmp_msk_eq(<WIDTH x i32> %v1, <WIDTH x i32> %v2) nounwind readnone alwaysinline {
+  %v1_i256 = bitcast <WIDTH x i32> %v1 to i256
+  %v2_i256 = bitcast <WIDTH x i32> %v2 to i256
+  %ret = icmp eq i256 %v1_i256, %v2_i256
+  ret i1 %ret
+}
+
+define i64 @__clock() {
+entry:
+  %call = tail call i32 @clock()
+  %conv = sext i32 %call to i64
+  ret i64 %conv
+}
+
+declare i32 @clock()
+
+define void @__fastmath() {
+entry:
+  ret void
+}
+
+define i32 @__set_ftz_daz_flags() nounwind alwaysinline {
+  ret i32 0
+}
+
+define void @__restore_ftz_daz_flags(i32 %oldVal) nounwind alwaysinline {
+  ret void
+}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; mask handling
+
+define i64 @__movmsk(<WIDTH x MASK> %mask) nounwind readnone alwaysinline {
+  %mask1 = trunc <WIDTH x MASK> %mask to <WIDTH x i1>
+  %res = bitcast <WIDTH x i1> %mask1 to i8
+  %res_i64 = zext i8 %res to i64
+  ret i64 %res_i64
+}
+
+define i1 @__any(<WIDTH x MASK> %mask) nounwind readnone alwaysinline {
+  %any_true = bitcast <WIDTH x MASK> %mask to i256
+  %cmp = icmp ne i256 %any_true, 0
+  ret i1 %cmp
+}
+
+define i1 @__all(<WIDTH x MASK> %mask) nounwind readnone alwaysinline {
+  %all_true = bitcast <WIDTH x MASK> %mask to i256
+  %cmp = icmp eq i256 %all_true, -1
+  ret i1 %cmp
+}
+
+define i1 @__none(<WIDTH x MASK> %mask) nounwind readnone alwaysinline {
+  %any = call i1 @__any(<WIDTH x MASK> %mask)
+  %none = icmp eq i1 %any, 0
+  ret i1 %none
+}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; rcp, rsqrt and sqrt
+
+declare float @llvm.sqrt.f32(float)
+declare double @llvm.sqrt.f64(double)
+declare <WIDTH x float> @llvm.sqrt.v8f32(<WIDTH x float>)
+declare <WIDTH x double> @llvm.sqrt.v8f64(<WIDTH x double>)
+
+define float @__rcp_uniform_float(float) nounwind readnone alwaysinline {
+  %r = fdiv float 1., %0
+  ret float %r
+}
+
+define float @__rcp_fast_uniform_float(float) nounwind readnone alwaysinline {
+  %r = fdiv float 1., %0
+  ret float %r
+}
+
+define double @__rcp_uniform_double(double) nounwind readnone alwaysinline {
+  %r = fdiv double 1., %0
+  ret double %r
+}
+
+define double @__rcp_fast_uniform_double(double) nounwind readnone alwaysinline {
+  %r = fdiv double 1., %0
+  ret double %r
+}
+
+define <WIDTH x float> @__rcp_varying_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  %r = fdiv <WIDTH x float> const_vector(float, 1.000000e+00), %0
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x float> @__rcp_fast_varying_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  %r = fdiv <WIDTH x float> const_vector(float, 1.000000e+00), %0
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x double> @__rcp_varying_double(<WIDTH x double>) nounwind readnone alwaysinline {
+  %r = fdiv <WIDTH x double> const_vector(double, 1.000000e+00), %0
+  ret <WIDTH x double> %r
+}
+
+define float @__sqrt_uniform_float(float) nounwind readnone alwaysinline {
+  %r = call float @llvm.sqrt.f32(float %0)
+  ret float %r
+}
+
+define double @__sqrt_uniform_double(double) nounwind readnone alwaysinline {
+  %r = call double @llvm.sqrt.f64(double %0)
+  ret double %r
+}
+
+define <WIDTH x float> @__sqrt_varying_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  %r = call <WIDTH x float> @llvm.sqrt.v8f32(<WIDTH x float> %0)
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x double> @__sqrt_varying_double(<WIDTH x double>) nounwind readnone alwaysinline {
+  %r = call <WIDTH x double> @llvm.sqrt.v8f64(<WIDTH x double> %0)
+  ret <WIDTH x double> %r
+}
+
+define float @__rsqrt_uniform_float(float) nounwind readnone alwaysinline {
+  %s = call float @llvm.sqrt.f32(float %0)
+  %r = fdiv float 1., %s
+  ret float %r
+}
+
+define float @__rsqrt_fast_uniform_float(float) nounwind readnone alwaysinline {
+  %s = call float @llvm.sqrt.f32(float %0)
+  %r = fdiv float 1., %s
+  ret float %r
+}
+
+define double @__rsqrt_uniform_double(double) nounwind readnone alwaysinline {
+  %s = call double @llvm.sqrt.f64(double %0)
+  %r = fdiv double 1., %s
+  ret double %r
+}
+
+define double @__rsqrt_fast_uniform_double(double) nounwind readnone alwaysinline {
+  %s = call double @llvm.sqrt.f64(double %0)
+  %r = fdiv double 1., %s
+  ret double %r
+}
+
+define <WIDTH x float> @__rsqrt_varying_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  %s = call <WIDTH x float> @llvm.sqrt.v8f32(<WIDTH x float> %0)
+  %r = fdiv <WIDTH x float> const_vector(float, 1.000000e+00), %s
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x float> @__rsqrt_fast_varying_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  %s = call <WIDTH x float> @llvm.sqrt.v8f32(<WIDTH x float> %0)
+  %r = fdiv <WIDTH x float> const_vector(float, 1.000000e+00), %s
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x double> @__rsqrt_varying_double(<WIDTH x double>) nounwind readnone alwaysinline {
+  %s = call <WIDTH x double> @llvm.sqrt.v8f64(<WIDTH x double> %0)
+  %r = fdiv <WIDTH x double> const_vector(double, 1.000000e+00), %s
+  ret <WIDTH x double> %r
+}
+
+define <WIDTH x double> @__rsqrt_fast_varying_double(<WIDTH x double>) nounwind readnone alwaysinline {
+  %s = call <WIDTH x double> @llvm.sqrt.v8f64(<WIDTH x double> %0)
+  %r = fdiv <WIDTH x double> const_vector(double, 1.000000e+00), %s
+  ret <WIDTH x double> %r
+}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; rounding
+;;
+;; wasm SIMD has nearest/floor/ceil for both float and double lanes.
+
+declare float @llvm.nearbyint.f32(float)
+declare float @llvm.floor.f32(float)
+declare float @llvm.ceil.f32(float)
+declare double @llvm.nearbyint.f64(double)
+declare double @llvm.floor.f64(double)
+declare double @llvm.ceil.f64(double)
+declare <WIDTH x float> @llvm.nearbyint.v8f32(<WIDTH x float>)
+declare <WIDTH x float> @llvm.floor.v8f32(<WIDTH x float>)
+declare <WIDTH x float> @llvm.ceil.v8f32(<WIDTH x float>)
+declare <WIDTH x double> @llvm.nearbyint.v8f64(<WIDTH x double>)
+declare <WIDTH x double> @llvm.floor.v8f64(<WIDTH x double>)
+declare <WIDTH x double> @llvm.ceil.v8f64(<WIDTH x double>)
+
+;; $1: round/floor/ceil, $2: LLVM intrinsic name
+define(`wasm_rounding', `
+define float @__$1_uniform_float(float) nounwind readnone alwaysinline {
+  %r = call float @llvm.$2.f32(float %0)
+  ret float %r
+}
+
+define double @__$1_uniform_double(double) nounwind readnone alwaysinline {
+  %r = call double @llvm.$2.f64(double %0)
+  ret double %r
+}
+
+define <WIDTH x float> @__$1_varying_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  %r = call <WIDTH x float> @llvm.$2.v8f32(<WIDTH x float> %0)
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x double> @__$1_varying_double(<WIDTH x double>) nounwind readnone alwaysinline {
+  %r = call <WIDTH x double> @llvm.$2.v8f64(<WIDTH x double> %0)
+  ret <WIDTH x double> %r
+}
+')
+
+wasm_rounding(round, nearbyint)
+wasm_rounding(floor, floor)
+wasm_rounding(ceil, ceil)
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; trunc float and double
+
+truncate()
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; min/max
+
+;; $1: min/max, $2: LLVM type, $3: compare instruction, $4: predicate, $5: ispc type name
+define(`wasm_minmax', `
+define $2 @__$1_uniform_$5($2, $2) nounwind readnone alwaysinline {
+  %c = $3 $4 $2 %0, %1
+  %r = select i1 %c, $2 %0, $2 %1
+  ret $2 %r
+}
+
+define <WIDTH x $2> @__$1_varying_$5(<WIDTH x $2>, <WIDTH x $2>) nounwind readnone alwaysinline {
+  %c = $3 $4 <WIDTH x $2> %0, %1
+  %r = select <WIDTH x i1> %c, <WIDTH x $2> %0, <WIDTH x $2> %1
+  ret <WIDTH x $2> %r
+}
+')
+
+wasm_minmax(min, float, fcmp, olt, float)
+wasm_minmax(max, float, fcmp, ogt, float)
+wasm_minmax(min, double, fcmp, olt, double)
+wasm_minmax(max, double, fcmp, ogt, double)
+wasm_minmax(min, i32, icmp, slt, int32)
+wasm_minmax(max, i32, icmp, sgt, int32)
+wasm_minmax(min, i32, icmp, ult, uint32)
+wasm_minmax(max, i32, icmp, ugt, uint32)
+wasm_minmax(min, i64, icmp, slt, int64)
+wasm_minmax(max, i64, icmp, sgt, int64)
+wasm_minmax(min, i64, icmp, ult, uint64)
+wasm_minmax(max, i64, icmp, ugt, uint64)
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; horizontal ops / reductions
+
+declare i16 @llvm.vector.reduce.add.v8i16(<WIDTH x i16>)
+declare i32 @llvm.vector.reduce.add.v8i32(<WIDTH x i32>)
+declare i64 @llvm.vector.reduce.add.v8i64(<WIDTH x i64>)
+
+define i16 @__reduce_add_int8(<WIDTH x i8>) nounwind readnone alwaysinline {
+  %ext = sext <WIDTH x i8> %0 to <WIDTH x i16>
+  %r = call i16 @llvm.vector.reduce.add.v8i16(<WIDTH x i16> %ext)
+  ret i16 %r
+}
+
+define i16 @__reduce_add_int16(<WIDTH x i16>) nounwind readnone alwaysinline {
+  %r = call i16 @llvm.vector.reduce.add.v8i16(<WIDTH x i16> %0)
+  ret i16 %r
+}
+
+define i32 @__reduce_add_int32(<WIDTH x i32>) nounwind readnone alwaysinline {
+  %r = call i32 @llvm.vector.reduce.add.v8i32(<WIDTH x i32> %0)
+  ret i32 %r
+}
+
+define i64 @__reduce_add_int64(<WIDTH x i64>) nounwind readnone alwaysinline {
+  %r = call i64 @llvm.vector.reduce.add.v8i64(<WIDTH x i64> %0)
+  ret i64 %r
+}
+
+define internal <WIDTH x float> @__add_varying_float(<WIDTH x float>, <WIDTH x float>) nounwind readnone alwaysinline {
+  %r = fadd <WIDTH x float> %0, %1
+  ret <WIDTH x float> %r
+}
+
+define internal float @__add_uniform_float(float, float) nounwind readnone alwaysinline {
+  %r = fadd float %0, %1
+  ret float %r
+}
+
+define internal <WIDTH x double> @__add_varying_double(<WIDTH x double>,
+                                                       <WIDTH x double>) nounwind readnone alwaysinline {
+  %r = fadd <WIDTH x double> %0, %1
+  ret <WIDTH x double> %r
+}
+
+define internal double @__add_uniform_double(double, double) nounwind readnone alwaysinline {
+  %r = fadd double %0, %1
+  ret double %r
+}
+
+define float @__reduce_add_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  reduce8(float, @__add_varying_float, @__add_uniform_float)
+}
+
+define double @__reduce_add_double(<WIDTH x double>) nounwind readnone alwaysinline {
+  reduce8(double, @__add_varying_double, @__add_uniform_double)
+}
+
+define float @__reduce_min_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  reduce8(float, @__min_varying_float, @__min_uniform_float)
+}
+
+define float @__reduce_max_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  reduce8(float, @__max_varying_float, @__max_uniform_float)
+}
+
+define double @__reduce_min_double(<WIDTH x double>) nounwind readnone alwaysinline {
+  reduce8(double, @__min_varying_double, @__min_uniform_double)
+}
+
+define double @__reduce_max_double(<WIDTH x double>) nounwind readnone alwaysinline {
+  reduce8(double, @__max_varying_double, @__max_uniform_double)
+}
+
+define i32 @__reduce_min_int32(<WIDTH x i32>) nounwind readnone alwaysinline {
+  reduce8(i32, @__min_varying_int32, @__min_uniform_int32)
+}
+
+define i32 @__reduce_max_int32(<WIDTH x i32>) nounwind readnone alwaysinline {
+  reduce8(i32, @__max_varying_int32, @__max_uniform_int32)
+}
+
+define i32 @__reduce_min_uint32(<WIDTH x i32>) nounwind readnone alwaysinline {
+  reduce8(i32, @__min_varying_uint32, @__min_uniform_uint32)
+}
+
+define i32 @__reduce_max_uint32(<WIDTH x i32>) nounwind readnone alwaysinline {
+  reduce8(i32, @__max_varying_uint32, @__max_uniform_uint32)
+}
+
+define i64 @__reduce_min_int64(<WIDTH x i64>) nounwind readnone alwaysinline {
+  reduce8(i64, @__min_varying_int64, @__min_uniform_int64)
+}
+
+define i64 @__reduce_max_int64(<WIDTH x i64>) nounwind readnone alwaysinline {
+  reduce8(i64, @__max_varying_int64, @__max_uniform_int64)
+}
+
+define i64 @__reduce_min_uint64(<WIDTH x i64>) nounwind readnone alwaysinline {
+  reduce8(i64, @__min_varying_uint64, @__min_uniform_uint64)
+}
+
+define i64 @__reduce_max_uint64(<WIDTH x i64>) nounwind readnone alwaysinline {
+  reduce8(i64, @__max_varying_uint64, @__max_uniform_uint64)
+}
+
+reduce_equal(8)
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; masked store
+
+;; $1: type
+define(`wasm_masked_store_blend', `
+define void @__masked_store_blend_$1(<WIDTH x $1>* nocapture %ptr, <WIDTH x $1> %new,
+                                     <WIDTH x MASK> %mask) nounwind alwaysinline {
+  %old = load PTR_OP_ARGS(`<WIDTH x $1> ')  %ptr
+  %mask1 = trunc <WIDTH x MASK> %mask to <WIDTH x i1>
+  %result = select <WIDTH x i1> %mask1, <WIDTH x $1> %new, <WIDTH x $1> %old
+  store <WIDTH x $1> %result, <WIDTH x $1> * %ptr
+  ret void
+}
+')
+
+wasm_masked_store_blend(i8)
+wasm_masked_store_blend(i16)
+ifdef(`WASM_RELAXED_SIMD', `
+relaxed_masked_store_blend(i32)
+relaxed_masked_store_blend(i64)
+', `
+wasm_masked_store_blend(i32)
+wasm_masked_store_blend(i64)
+')
+
+gen_masked_store(i8)
+gen_masked_store(i16)
+gen_masked_store(i32)
+gen_masked_store(i64)
+masked_store_float_double()
+
+masked_load(i8,  1)
+masked_load(i16, 2)
+masked_load(half, 2)
+masked_load(i32, 4)
+masked_load(float, 4)
+masked_load(i64, 8)
+masked_load(double, 8)
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; gather/scatter
+
+gen_gather_factored(i8)
+gen_gather_factored(i16)
+gen_gather_factored(half)
+gen_gather_factored(i32)
+gen_gather_factored(float)
+gen_gather_factored(i64)
+gen_gather_factored(double)
+
+gen_scatter(i8)
+gen_scatter(i16)
+gen_scatter(half)
+gen_scatter(i32)
+gen_scatter(float)
+gen_scatter(i64)
+gen_scatter(double)
+
+packed_load_and_store(FALSE)
+define_prefetches()
+popcnt()
@@ -0,0 +1,231 @@
+;;  Copyright (c) 2023, Intel Corporation
+;;  All rights reserved.
+;;
+;;  Redistribution and use in source and binary forms, with or without
+;;  modification, are permitted provided that the following conditions are
+;;  met:
+;;
+;;    * Redistributions of source code must retain the above copyright
+;;      notice, this list of conditions and the following disclaimer.
+;;
+;;    * Redistributions in binary form must reproduce the above copyright
+;;      notice, this list of conditions and the following disclaimer in the
+;;      documentation and/or other materials provided with the distribution.
+;;
+;;    * Neither the name of Intel Corporation nor the names of its
+;;      contributors may be used to endorse or promote products derived from
+;;      this software without specific prior written permission.
+;;
+;;
+;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+;;   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+;;   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+;;   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+;;   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+;;   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+;;   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+;; Common definitions for the WebAssembly relaxed SIMD targets, included by
+;; the wasm target files after util.m4 when WASM_RELAXED_SIMD is defined.
+;;
+;; Relaxed SIMD instructions may produce implementation-defined results for
+;; some inputs. They are used here only where ispc does not care about the
+;; difference:
+;; - relaxed madd for a * b + c, which may or may not be fused; it is used
+;;   only when FP contraction is allowed (it is unless --opt=disable-fma);
+;; - relaxed laneselect for blends with the execution mask, whose lanes are
+;;   always all ones or all zeros;
+;; - relaxed swizzle for shuffle(), which requires in-range indices.
+
+;; The relaxed SIMD intrinsics were renamed in LLVM 16.
+define(`RELAXED_MADD',
+`ifelse(LLVM_VERSION, `LLVM_14_0', `llvm.wasm.fma', LLVM_VERSION, `LLVM_15_0', `llvm.wasm.fma',
+        `llvm.wasm.relaxed.madd')')
+define(`RELAXED_LANESELECT',
+`ifelse(LLVM_VERSION, `LLVM_14_0', `llvm.wasm.laneselect', LLVM_VERSION, `LLVM_15_0', `llvm.wasm.laneselect',
+        `llvm.wasm.relaxed.laneselect')')
+
+declare <4 x float> @RELAXED_MADD.v4f32(<4 x float>, <4 x float>, <4 x float>) nounwind readnone
+declare <2 x double> @RELAXED_MADD.v2f64(<2 x double>, <2 x double>, <2 x double>) nounwind readnone
+declare <4 x i32> @RELAXED_LANESELECT.v4i32(<4 x i32>, <4 x i32>, <4 x i32>) nounwind readnone
+declare <2 x i64> @RELAXED_LANESELECT.v2i64(<2 x i64>, <2 x i64>, <2 x i64>) nounwind readnone
+declare <16 x i8> @llvm.wasm.relaxed.swizzle(<16 x i8>, <16 x i8>) nounwind readnone
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; multiply-add
+;;
+;; The peephole pass turns a * b + c into calls to these when the target
+;; defines them, so they must stay free of plain fmul/fadd pairs.
+
+define <WIDTH x float> @__muladd_varying_float(<WIDTH x float> %a, <WIDTH x float> %b,
+                                               <WIDTH x float> %c) nounwind readnone alwaysinline {
+ifelse(WIDTH, `4', `
+  %r = call <4 x float> @RELAXED_MADD.v4f32(<4 x float> %a, <4 x float> %b, <4 x float> %c)',
+`
+  v8tov4(float, %a, %a0, %a1)
+  v8tov4(float, %b, %b0, %b1)
+  v8tov4(float, %c, %c0, %c1)
+  %r0 = call <4 x float> @RELAXED_MADD.v4f32(<4 x float> %a0, <4 x float> %b0, <4 x float> %c0)
+  %r1 = call <4 x float> @RELAXED_MADD.v4f32(<4 x float> %a1, <4 x float> %b1, <4 x float> %c1)
+  %r = shufflevector <4 x float> %r0, <4 x float> %r1,
+         <8 x i32> <i32 0, i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7>')
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x double> @__muladd_varying_double(<WIDTH x double> %a, <WIDTH x double> %b,
+                                                 <WIDTH x double> %c) nounwind readnone alwaysinline {
+ifelse(WIDTH, `4', `
+  v4tov2(double, %a, %a0, %a1)
+  v4tov2(double, %b, %b0, %b1)
+  v4tov2(double, %c, %c0, %c1)
+  %r0 = call <2 x double> @RELAXED_MADD.v2f64(<2 x double> %a0, <2 x double> %b0, <2 x double> %c0)
+  %r1 = call <2 x double> @RELAXED_MADD.v2f64(<2 x double> %a1, <2 x double> %b1, <2 x double> %c1)
+  %r = shufflevector <2 x double> %r0, <2 x double> %r1, <4 x i32> <i32 0, i32 1, i32 2, i32 3>',
+`
+  v8tov2(double, %a, %a0, %a1, %a2, %a3)
+  v8tov2(double, %b, %b0, %b1, %b2, %b3)
+  v8tov2(double, %c, %c0, %c1, %c2, %c3)
+  %r0 = call <2 x double> @RELAXED_MADD.v2f64(<2 x double> %a0, <2 x double> %b0, <2 x double> %c0)
+  %r1 = call <2 x double> @RELAXED_MADD.v2f64(<2 x double> %a1, <2 x double> %b1, <2 x double> %c1)
+  %r2 = call <2 x double> @RELAXED_MADD.v2f64(<2 x double> %a2, <2 x double> %b2, <2 x double> %c2)
+  %r3 = call <2 x double> @RELAXED_MADD.v2f64(<2 x double> %a3, <2 x double> %b3, <2 x double> %c3)
+  %r01 = shufflevector <2 x double> %r0, <2 x double> %r1, <4 x i32> <i32 0, i32 1, i32 2, i32 3>
+  %r23 = shufflevector <2 x double> %r2, <2 x double> %r3, <4 x i32> <i32 0, i32 1, i32 2, i32 3>
+  %r = shufflevector <4 x double> %r01, <4 x double> %r23,
+         <8 x i32> <i32 0, i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7>')
+  ret <WIDTH x double> %r
+}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; blends
+
+;; Returns %new in the lanes where %mask is on and %old elsewhere.
+define <WIDTH x i32> @__wasm_laneselect_i32(<WIDTH x i32> %new, <WIDTH x i32> %old,
+                                            <WIDTH x MASK> %mask) nounwind readnone alwaysinline {
+ifelse(WIDTH, `4', `
+  %r = call <4 x i32> @RELAXED_LANESELECT.v4i32(<4 x i32> %new, <4 x i32> %old, <4 x i32> %mask)',
+`
+  v8tov4(i32, %new, %new0, %new1)
+  v8tov4(i32, %old, %old0, %old1)
+  v8tov4(i32, %mask, %mask0, %mask1)
+  %r0 = call <4 x i32> @RELAXED_LANESELECT.v4i32(<4 x i32> %new0, <4 x i32> %old0, <4 x i32> %mask0)
+  %r1 = call <4 x i32> @RELAXED_LANESELECT.v4i32(<4 x i32> %new1, <4 x i32> %old1, <4 x i32> %mask1)
+  %r = shufflevector <4 x i32> %r0, <4 x i32> %r1,
+         <8 x i32> <i32 0, i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7>')
+  ret <WIDTH x i32> %r
+}
+
+define <WIDTH x i64> @__wasm_laneselect_i64(<WIDTH x i64> %new, <WIDTH x i64> %old,
+                                            <WIDTH x MASK> %mask) nounwind readnone alwaysinline {
+  %m = sext <WIDTH x MASK> %mask to <WIDTH x i64>
+ifelse(WIDTH, `4', `
+  v4tov2(i64, %new, %new0, %new1)
+  v4tov2(i64, %old, %old0, %old1)
+  v4tov2(i64, %m, %m0, %m1)
+  %r0 = call <2 x i64> @RELAXED_LANESELECT.v2i64(<2 x i64> %new0, <2 x i64> %old0, <2 x i64> %m0)
+  %r1 = call <2 x i64> @RELAXED_LANESELECT.v2i64(<2 x i64> %new1, <2 x i64> %old1, <2 x i64> %m1)
+  %r = shufflevector <2 x i64> %r0, <2 x i64> %r1, <4 x i32> <i32 0, i32 1, i32 2, i32 3>',
+`
+  v8tov2(i64, %new, %new0, %new1, %new2, %new3)
+  v8tov2(i64, %old, %old0, %old1, %old2, %old3)
+  v8tov2(i64, %m, %m0, %m1, %m2, %m3)
+  %r0 = call <2 x i64> @RELAXED_LANESELECT.v2i64(<2 x i64> %new0, <2 x i64> %old0, <2 x i64> %m0)
+  %r1 = call <2 x i64> @RELAXED_LANESELECT.v2i64(<2 x i64> %new1, <2 x i64> %old1, <2 x i64> %m1)
+  %r2 = call <2 x i64> @RELAXED_LANESELECT.v2i64(<2 x i64> %new2, <2 x i64> %old2, <2 x i64> %m2)
+  %r3 = call <2 x i64> @RELAXED_LANESELECT.v2i64(<2 x i64> %new3, <2 x i64> %old3, <2 x i64> %m3)
+  %r01 = shufflevector <2 x i64> %r0, <2 x i64> %r1, <4 x i32> <i32 0, i32 1, i32 2, i32 3>
+  %r23 = shufflevector <2 x i64> %r2, <2 x i64> %r3, <4 x i32> <i32 0, i32 1, i32 2, i32 3>
+  %r = shufflevector <4 x i64> %r01, <4 x i64> %r23,
+         <8 x i32> <i32 0, i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7>')
+  ret <WIDTH x i64> %r
+}
+
+;; $1: type
+define(`relaxed_masked_store_blend', `
+define void @__masked_store_blend_$1(<WIDTH x $1>* nocapture %ptr, <WIDTH x $1> %new,
+                                     <WIDTH x MASK> %mask) nounwind alwaysinline {
+  %old = load PTR_OP_ARGS(`<WIDTH x $1> ')  %ptr
+  %result = call <WIDTH x $1> @__wasm_laneselect_$1(<WIDTH x $1> %new, <WIDTH x $1> %old, <WIDTH x MASK> %mask)
+  store <WIDTH x $1> %result, <WIDTH x $1> * %ptr
+  ret void
+}
+')
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; 32-bit element permutations
+;;
+;; Lane i of the result takes bytes 4 * index[i] + (0, 1, 2, 3) of the
+;; source. With eight lanes each source half is swizzled separately and the
+;; result picked with index bit 2.
+
+;; $1: result, $2: <4 x i32> lane indices in [0, 3]
+define(`swizzle_byte_indices', `
+  %$1_scaled = shl <4 x i32> $2, <i32 2, i32 2, i32 2, i32 2>
+  %$1_spread = mul <4 x i32> %$1_scaled, <i32 16843009, i32 16843009, i32 16843009, i32 16843009>
+  %$1_bytes = add <4 x i32> %$1_spread, <i32 50462976, i32 50462976, i32 50462976, i32 50462976>
+  %$1 = bitcast <4 x i32> %$1_bytes to <16 x i8>
+')
+
+;; $1: type
+define(`relaxed_shuffle', `
+define <WIDTH x $1> @__shuffle_$1(<WIDTH x $1>, <WIDTH x i32>) nounwind readnone alwaysinline {
+  %isc = call i1 @__is_compile_time_constant_varying_int32(<WIDTH x i32> %1)
+  br i1 %isc, label %is_const, label %not_const
+
+is_const:
+  ; constant permutations are left to LLVM, as in the generic version
+forloop(i, 0, eval(WIDTH-1), `
+  %index_`'i = extractelement <WIDTH x i32> %1, i32 i')
+forloop(i, 0, eval(WIDTH-1), `
+  %v_`'i = extractelement <WIDTH x $1> %0, i32 %index_`'i')
+
+  %ret_0 = insertelement <WIDTH x $1> undef, $1 %v_0, i32 0
+forloop(i, 1, eval(WIDTH-1), `  %ret_`'i = insertelement <WIDTH x $1> %ret_`'eval(i-1), $1 %v_`'i, i32 i
+')
+  ret <WIDTH x $1> %ret_`'eval(WIDTH-1)
+
+not_const:
+ifelse(WIDTH, `4', `
+  swizzle_byte_indices(idx, %1)
+  %src = bitcast <4 x $1> %0 to <16 x i8>
+  %r8 = call <16 x i8> @llvm.wasm.relaxed.swizzle(<16 x i8> %src, <16 x i8> %idx)
+  %r = bitcast <16 x i8> %r8 to <4 x $1>',
+`
+  %v = bitcast <8 x $1> %0 to <8 x i32>
+  v8tov4(i32, %v, %v0, %v1)
+  %src0 = bitcast <4 x i32> %v0 to <16 x i8>
+  %src1 = bitcast <4 x i32> %v1 to <16 x i8>
+  v8tov4(i32, %1, %i0, %i1)
+  %lane0 = and <4 x i32> %i0, <i32 3, i32 3, i32 3, i32 3>
+  %lane1 = and <4 x i32> %i1, <i32 3, i32 3, i32 3, i32 3>
+  %high0 = and <4 x i32> %i0, <i32 4, i32 4, i32 4, i32 4>
+  %high1 = and <4 x i32> %i1, <i32 4, i32 4, i32 4, i32 4>
+  %hcmp0 = icmp ne <4 x i32> %high0, zeroinitializer
+  %hcmp1 = icmp ne <4 x i32> %high1, zeroinitializer
+  %hmask0 = sext <4 x i1> %hcmp0 to <4 x i32>
+  %hmask1 = sext <4 x i1> %hcmp1 to <4 x i32>
+  swizzle_byte_indices(idx0, %lane0)
+  swizzle_byte_indices(idx1, %lane1)
+  %lo0_8 = call <16 x i8> @llvm.wasm.relaxed.swizzle(<16 x i8> %src0, <16 x i8> %idx0)
+  %hi0_8 = call <16 x i8> @llvm.wasm.relaxed.swizzle(<16 x i8> %src1, <16 x i8> %idx0)
+  %lo1_8 = call <16 x i8> @llvm.wasm.relaxed.swizzle(<16 x i8> %src0, <16 x i8> %idx1)
+  %hi1_8 = call <16 x i8> @llvm.wasm.relaxed.swizzle(<16 x i8> %src1, <16 x i8> %idx1)
+  %lo0 = bitcast <16 x i8> %lo0_8 to <4 x i32>
+  %hi0 = bitcast <16 x i8> %hi0_8 to <4 x i32>
+  %lo1 = bitcast <16 x i8> %lo1_8 to <4 x i32>
+  %hi1 = bitcast <16 x i8> %hi1_8 to <4 x i32>
+  %r0 = call <4 x i32> @RELAXED_LANESELECT.v4i32(<4 x i32> %hi0, <4 x i32> %lo0, <4 x i32> %hmask0)
+  %r1 = call <4 x i32> @RELAXED_LANESELECT.v4i32(<4 x i32> %hi1, <4 x i32> %lo1, <4 x i32> %hmask1)
+  %r32 = shufflevector <4 x i32> %r0, <4 x i32> %r1,
+           <8 x i32> <i32 0, i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7>
+  %r = bitcast <8 x i32> %r32 to <8 x $1>')
+  ret <WIDTH x $1> %r
+}
+')
+
+define(`custom_shuffle_i32', `relaxed_shuffle(i32)')
+define(`custom_shuffle_float', `relaxed_shuffle(float)')
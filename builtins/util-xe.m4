@@ -1481,35 +1481,58 @@ mask_converts(WIDTH)
 
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ;; global_atomic_associative
-;; Implementation for atomics for vector types
+;; Implementation for atomics for vector types with a uniform address.
+;; Instead of issuing an atomic for each of the active lanes, which are then
+;; serialized on the same address, the values of the active lanes are
+;; combined first and a single atomic is issued for the gang:
+;; tmp = (val0 op val1 op ...)
+;; result0 = atomic_op(ptr, tmp)
+;; result1 = (result0 op val0)
+;; ..
 ;;
-;; Takes four parameters:
+;; Takes five parameters:
 ;; $1: vector width of the target
 ;; $2: operation being performed (w.r.t. ISPC stdlib/VC atomic intrinsic names)
 ;;     (add, sub...)
 ;; $3: return type of the VC atomic (e.g. i32)
 ;; $4: return type of the VC atomic type, in ispc naming paralance (e.g. int32)
+;; $5: identity value for the operator (e.g. 0 for add, -1 for AND, ...)
 
 define(`global_atomic_associative', `
 define <$1 x $3> @__atomic_$2_$4_global(i8* %ptr, <$1 x $3> %val,
                                         <$1 x MASK> %m) nounwind alwaysinline {
-  ifelse($1, 8,`
-    %dst = alloca <$1 x $3>
-    %dst_load = load <$1 x $3>, <$1 x $3>* %dst
-    %ptr_to_int = ptrtoint i8* %ptr to i64
-    %base = insertelement <WIDTH x i64> undef, i64 %ptr_to_int, i32 0
-    %shuffle = shufflevector <WIDTH x i64> %base, <WIDTH x i64> undef, <WIDTH x i32> zeroinitializer
-    %res = call <$1 x $3> @llvm.genx.svm.atomic.$2.XE_SUFFIX($3).XE_SUFFIX(i1).XE_SUFFIX(i64)(<$1 x i1> %m, <$1 x i64> %shuffle, <$1 x $3> %val, <$1 x $3> %dst_load)
-  ',`
-    %ret_ptr = alloca <$1 x $3>
-    per_lane($1, <$1 x MASK> %m, `
-      %val_LANE_ID = extractelement <$1 x $3> %val, i32 LANE
-      %res_LANE_ID = call $3 @__atomic_$2_uniform_$4_global(i8 * %ptr, $3 %val_LANE_ID)
-      %store_ptr_LANE_ID = getelementptr PTR_OP_ARGS(`<$1 x $3>') %ret_ptr, i32 0, i32 LANE
-      store $3 %res_LANE_ID, $3 * %store_ptr_LANE_ID
-    ')
-    %res = load PTR_OP_ARGS(`<$1 x $3> ')  %ret_ptr
-  ')
+entry:
+  ; the lanes that are off hold the identity value
+  %idv1 = insertelement <$1 x $3> undef, $3 $5, i32 0
+  %idvec = shufflevector <$1 x $3> %idv1, <$1 x $3> undef, <$1 x i32> zeroinitializer
+  %valp = select <$1 x MASK> %m, <$1 x $3> %val, <$1 x $3> %idvec
+
+  ; compute the reduction (val0 op val1 op ... ) and %eltvec, which holds
+  ; the identity in the 0th element, val0 in the first one, (val0 op val1)
+  ; in the second one, ..; the values subtracted are combined with add
+  %red0 = extractelement <$1 x $3> %valp, i32 0
+  %eltvec0 = insertelement <$1 x $3> undef, $3 $5, i32 0
+  forloop(i, 1, eval($1-1), `
+  %elt`'i = extractelement <$1 x $3> %valp, i32 i
+  %red`'i = ifelse($2, `sub', `add', `$2') $3 %red`'eval(i-1), %elt`'i
+  %eltvec`'i = insertelement <$1 x $3> %eltvec`'eval(i-1), $3 %red`'eval(i-1), i32 i')
+
+  ; make the atomic call for the whole gang, unless all of the lanes are off
+  %mm = call i64 @__movmsk(<$1 x MASK> %m)
+  %any_on = icmp ne i64 %mm, 0
+  br i1 %any_on, label %do_atomic, label %done
+
+do_atomic:
+  %final0 = call $3 @__atomic_$2_uniform_$4_global(i8 * %ptr, $3 %red`'eval($1-1))
+  br label %done
+
+done:
+  ; smear the old value returned by the atomic across the vector and apply
+  ; the op with %eltvec to get the values returned to the program instances
+  %final = phi $3 [ %final0, %do_atomic ], [ $5, %entry ]
+  %finalv1 = insertelement <$1 x $3> undef, $3 %final, i32 0
+  %final_base = shufflevector <$1 x $3> %finalv1, <$1 x $3> undef, <$1 x i32> zeroinitializer
+  %res = $2 <$1 x $3> %final_base, %eltvec`'eval($1-1)
   ret <$1 x $3> %res
 }
 ')
@@ -3599,6 +3622,58 @@ define void
 ')
 
 
+;; Generic AoS/SoA conversions for 2 to 16 fields of 8, 16, 32 and 64-bit
+;; elements. The whole block of fields is loaded or stored as one vector
+;; and split or merged with strided shufflevector instructions, which the
+;; interleaved access lowering and the target shuffle lowering turn into
+;; native instruction sequences.
+define(`aossoa_fields', `
+define void
+@__aos_to_soa$1_$2(i8 * noalias %p, i8 * noalias %out) nounwind alwaysinline {
+  %p0 = bitcast i8 * %p to <eval($1 * WIDTH) x $2> *
+  %v = load PTR_OP_ARGS(`<eval($1 * WIDTH) x $2> ')  %p0, align 1
+  %outptr = bitcast i8 * %out to <WIDTH x $2> *
+forloop(f, 0, eval($1 - 1), `
+  %v_`'f = shufflevector <eval($1 * WIDTH) x $2> %v, <eval($1 * WIDTH) x $2> undef,
+      <WIDTH x i32> < forloop(i, 0, eval(WIDTH - 2), `i32 eval(f + i * $1), ')i32 eval(f + (WIDTH - 1) * $1) >
+  %outptr_`'f = getelementptr PTR_OP_ARGS(`<WIDTH x $2>') %outptr, i32 f
+  store <WIDTH x $2> %v_`'f, <WIDTH x $2> * %outptr_`'f, align 1
+')
+  ret void
+}
+
+define void
+@__soa_to_aos$1_$2(i8 * noalias %in, i8 * noalias %p) nounwind alwaysinline {
+  %inptr = bitcast i8 * %in to <WIDTH x $2> *
+forloop(f, 0, eval($1 - 1), `
+  %inptr_`'f = getelementptr PTR_OP_ARGS(`<WIDTH x $2>') %inptr, i32 f
+  %v_`'f = load PTR_OP_ARGS(`<WIDTH x $2> ') %inptr_`'f, align 1
+')
+forloop(k, 2, eval($1 - 1), `
+  %w_`'k = shufflevector <WIDTH x $2> %v_`'k, <WIDTH x $2> undef,
+      <eval(k * WIDTH) x i32> < forloop(i, 0, eval(WIDTH - 1), `i32 i, ')forloop(i, WIDTH, eval(k * WIDTH - 2), `i32 undef, ')i32 undef >')
+  %acc_1 = shufflevector <WIDTH x $2> %v_0, <WIDTH x $2> %v_1,
+      <eval(2 * WIDTH) x i32> < forloop(i, 0, eval(2 * WIDTH - 2), `i32 i, ')i32 eval(2 * WIDTH - 1) >
+forloop(k, 2, eval($1 - 1), `
+  %acc_`'k = shufflevector <eval(k * WIDTH) x $2> %acc_`'eval(k - 1), <eval(k * WIDTH) x $2> %w_`'k,
+      <eval((k + 1) * WIDTH) x i32> < forloop(i, 0, eval((k + 1) * WIDTH - 2), `i32 i, ')i32 eval((k + 1) * WIDTH - 1) >')
+  %aos = shufflevector <eval($1 * WIDTH) x $2> %acc_`'eval($1 - 1), <eval($1 * WIDTH) x $2> undef,
+      <eval($1 * WIDTH) x i32> < forloop(j, 0, eval($1 * WIDTH - 2), `i32 eval((j % $1) * WIDTH + j / $1), ')i32 eval($1 * WIDTH - 1) >
+  %p0 = bitcast i8 * %p to <eval($1 * WIDTH) x $2> *
+  store <eval($1 * WIDTH) x $2> %aos, <eval($1 * WIDTH) x $2> * %p0, align 1
+  ret void
+}
+')
+
+define(`aossoa_generic', `
+forloop(n, 2, 16, `
+aossoa_fields(n, i8)
+aossoa_fields(n, i16)
+aossoa_fields(n, i32)
+aossoa_fields(n, i64)
+')
+')
+
 ;; versions to be called from stdlib
 define(`aossoa', `
 
@@ -3795,6 +3870,8 @@ define void
          <WIDTH x double> * %out0, <WIDTH x double> * %out1)
   ret void
 }
+
+aossoa_generic()
 ')
 
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
@@ -3831,6 +3908,8 @@ declare i32 @__fast_masked_vload()
 
 declare i8* @ISPCAlloc(i8**, i64, i32) nounwind
 declare void @ISPCLaunch(i8**, i8*, i8*, i32, i32, i32) nounwind
+declare void @ISPCLaunchAfter(i8**, i8*, i8*, i32, i32, i32, i64*, i32) nounwind
+declare void @ISPCLaunchWithHints(i8**, i8*, i8*, i32, i32, i32, i64*, i32, i32, i32, i32) nounwind
 declare void @ISPCSync(i8*) nounwind
 declare void @ISPCInstrument(i8*, i8*, i32, i64) nounwind
 
@@ -5042,6 +5121,11 @@ define void @__do_assume_uniform(i1 %test) alwaysinline {
   ret void
 }
 
+define void @__do_assume_aligned_uniform(i8 * %ptr, i64 %alignment) alwaysinline {
+  call void @llvm.assume(i1 true) [ "align"(i8 * %ptr, i64 %alignment) ]
+  ret void
+}
+
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ;; assert
 
@@ -5406,6 +5490,22 @@ m4exit(`1')
 ')
 
 
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; scratch memory for stdlib routines
+;;
+;; stdlib.ispc is compiled once for both 32 and 64 bit runtimes, so it
+;; cannot pick between the _32rt and _64rt variants above itself.
+
+define noalias i8 * @__stdlib_scratch_alloc(i64 %size) nounwind alwaysinline {
+  %ptr = call i8 * @__new_uniform_`'RUNTIME`'rt(i64 %size)
+  ret i8 * %ptr
+}
+
+define void @__stdlib_scratch_free(i8 * %ptr) nounwind alwaysinline {
+  call void @__delete_uniform_`'RUNTIME`'rt(i8 * %ptr)
+  ret void
+}
+
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ;; read hw clock
 
@@ -5426,10 +5526,174 @@ define i64 @__clock() nounwind {
   ret i64 %res
 }
 
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; dot products of packed integers
+;;
+;; __dot4add_u8i8packed(a, b, acc) adds to each 32-bit lane of acc the sum
+;; of products of the four unsigned bytes of a with the four signed bytes
+;; of b. __dot2add_i16i16packed(a, b, acc) does the same with the two
+;; signed 16-bit halves of a and b. The _sat variants saturate the result
+;; to the int32 range instead of wrapping around.
+
+define <WIDTH x i32> @__dot4add_u8i8packed(<WIDTH x i32> %a, <WIDTH x i32> %b,
+                                           <WIDTH x i32> %acc) nounwind readnone alwaysinline {
+  %a0 = and <WIDTH x i32> %a, const_vector(i32, 255)
+  %a1_sh = lshr <WIDTH x i32> %a, const_vector(i32, 8)
+  %a1 = and <WIDTH x i32> %a1_sh, const_vector(i32, 255)
+  %a2_sh = lshr <WIDTH x i32> %a, const_vector(i32, 16)
+  %a2 = and <WIDTH x i32> %a2_sh, const_vector(i32, 255)
+  %a3 = lshr <WIDTH x i32> %a, const_vector(i32, 24)
+  %b0_sh = shl <WIDTH x i32> %b, const_vector(i32, 24)
+  %b0 = ashr <WIDTH x i32> %b0_sh, const_vector(i32, 24)
+  %b1_sh = shl <WIDTH x i32> %b, const_vector(i32, 16)
+  %b1 = ashr <WIDTH x i32> %b1_sh, const_vector(i32, 24)
+  %b2_sh = shl <WIDTH x i32> %b, const_vector(i32, 8)
+  %b2 = ashr <WIDTH x i32> %b2_sh, const_vector(i32, 24)
+  %b3 = ashr <WIDTH x i32> %b, const_vector(i32, 24)
+  %p0 = mul <WIDTH x i32> %a0, %b0
+  %p1 = mul <WIDTH x i32> %a1, %b1
+  %p2 = mul <WIDTH x i32> %a2, %b2
+  %p3 = mul <WIDTH x i32> %a3, %b3
+  %p01 = add <WIDTH x i32> %p0, %p1
+  %p23 = add <WIDTH x i32> %p2, %p3
+  %sum = add <WIDTH x i32> %p01, %p23
+  %r = add <WIDTH x i32> %acc, %sum
+  ret <WIDTH x i32> %r
+}
+
+;; the sum of the four byte products always fits in 32 bits, so a single
+;; saturating add gives the exact result
+define <WIDTH x i32> @__dot4add_u8i8packed_sat(<WIDTH x i32> %a, <WIDTH x i32> %b,
+                                               <WIDTH x i32> %acc) nounwind readnone alwaysinline {
+  %sum = call <WIDTH x i32> @__dot4add_u8i8packed(<WIDTH x i32> %a, <WIDTH x i32> %b,
+                                                  <WIDTH x i32> zeroinitializer)
+  %r = call <WIDTH x i32> @llvm.genx.ssadd.sat.v`'WIDTH`'i32(<WIDTH x i32> %acc, <WIDTH x i32> %sum)
+  ret <WIDTH x i32> %r
+}
+
+define <WIDTH x i32> @__dot2add_i16i16packed(<WIDTH x i32> %a, <WIDTH x i32> %b,
+                                             <WIDTH x i32> %acc) nounwind readnone alwaysinline {
+  %a0_sh = shl <WIDTH x i32> %a, const_vector(i32, 16)
+  %a0 = ashr <WIDTH x i32> %a0_sh, const_vector(i32, 16)
+  %a1 = ashr <WIDTH x i32> %a, const_vector(i32, 16)
+  %b0_sh = shl <WIDTH x i32> %b, const_vector(i32, 16)
+  %b0 = ashr <WIDTH x i32> %b0_sh, const_vector(i32, 16)
+  %b1 = ashr <WIDTH x i32> %b, const_vector(i32, 16)
+  %p0 = mul <WIDTH x i32> %a0, %b0
+  %p1 = mul <WIDTH x i32> %a1, %b1
+  %sum = add <WIDTH x i32> %p0, %p1
+  %r = add <WIDTH x i32> %acc, %sum
+  ret <WIDTH x i32> %r
+}
+
+;; the sum of the two 16-bit products may not fit in 32 bits, so the
+;; saturating version accumulates in 64 bits and clamps the final value
+define <WIDTH x i32> @__dot2add_i16i16packed_sat(<WIDTH x i32> %a, <WIDTH x i32> %b,
+                                                 <WIDTH x i32> %acc) nounwind readnone alwaysinline {
+  %a0_sh = shl <WIDTH x i32> %a, const_vector(i32, 16)
+  %a0 = ashr <WIDTH x i32> %a0_sh, const_vector(i32, 16)
+  %a1 = ashr <WIDTH x i32> %a, const_vector(i32, 16)
+  %b0_sh = shl <WIDTH x i32> %b, const_vector(i32, 16)
+  %b0 = ashr <WIDTH x i32> %b0_sh, const_vector(i32, 16)
+  %b1 = ashr <WIDTH x i32> %b, const_vector(i32, 16)
+  %p0 = mul <WIDTH x i32> %a0, %b0
+  %p1 = mul <WIDTH x i32> %a1, %b1
+  %p0_64 = sext <WIDTH x i32> %p0 to <WIDTH x i64>
+  %p1_64 = sext <WIDTH x i32> %p1 to <WIDTH x i64>
+  %acc_64 = sext <WIDTH x i32> %acc to <WIDTH x i64>
+  %sum = add <WIDTH x i64> %p0_64, %p1_64
+  %res = add <WIDTH x i64> %acc_64, %sum
+  %over_mask = icmp sgt <WIDTH x i64> %res, const_vector(i64, 2147483647)
+  %over_res = select <WIDTH x i1> %over_mask, <WIDTH x i64> const_vector(i64, 2147483647), <WIDTH x i64> %res
+  %under_mask = icmp slt <WIDTH x i64> %over_res, const_vector(i64, -2147483648)
+  %clamped = select <WIDTH x i1> %under_mask, <WIDTH x i64> const_vector(i64, -2147483648), <WIDTH x i64> %over_res
+  %r = trunc <WIDTH x i64> %clamped to <WIDTH x i32>
+  ret <WIDTH x i32> %r
+}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; conflict detection
+;;
+;; Xe has no conflict detection instruction, so stdlib.ispc never calls
+;; __conflict_i32() here.
+
+define i1 @__have_conflict_detection() nounwind readnone alwaysinline {
+  ret i1 false
+}
+
+define <WIDTH x i32> @__conflict_i32(<WIDTH x i32> %v) nounwind readnone alwaysinline {
+  ret <WIDTH x i32> zeroinitializer
+}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; fused multiply-add
+
+declare float @llvm.fma.f32(float, float, float) nounwind readnone
+declare double @llvm.fma.f64(double, double, double) nounwind readnone
+declare <WIDTH x float> @llvm.fma.v`'WIDTH`'f32(<WIDTH x float>, <WIDTH x float>, <WIDTH x float>) nounwind readnone
+declare <WIDTH x double> @llvm.fma.v`'WIDTH`'f64(<WIDTH x double>, <WIDTH x double>, <WIDTH x double>) nounwind readnone
+
+define i1 @__have_fma() nounwind readnone alwaysinline {
+  ret i1 true
+}
+
+define float @__fma_uniform_float(float, float, float) nounwind readnone alwaysinline {
+  %r = call float @llvm.fma.f32(float %0, float %1, float %2)
+  ret float %r
+}
+
+define double @__fma_uniform_double(double, double, double) nounwind readnone alwaysinline {
+  %r = call double @llvm.fma.f64(double %0, double %1, double %2)
+  ret double %r
+}
+
+define <WIDTH x float> @__fma_varying_float(<WIDTH x float>, <WIDTH x float>,
+                                            <WIDTH x float>) nounwind readnone alwaysinline {
+  %r = call <WIDTH x float> @llvm.fma.v`'WIDTH`'f32(<WIDTH x float> %0, <WIDTH x float> %1, <WIDTH x float> %2)
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x double> @__fma_varying_double(<WIDTH x double>, <WIDTH x double>,
+                                              <WIDTH x double>) nounwind readnone alwaysinline {
+  %r = call <WIDTH x double> @llvm.fma.v`'WIDTH`'f64(<WIDTH x double> %0, <WIDTH x double> %1, <WIDTH x double> %2)
+  ret <WIDTH x double> %r
+}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; CRC32C
+;;
+;; Xe has no CRC instruction, so stdlib.ispc never calls __crc32c_u64()
+;; here.
+
+define i1 @__have_crc32c() nounwind readnone alwaysinline {
+  ret i1 false
+}
+
+define i32 @__crc32c_u64(i32 %crc, i64 %v) nounwind readnone alwaysinline {
+  ret i32 0
+}
+
 define i32 @__num_cores() nounwind {
   ret i32 -1;
 }
 
+;; There are no worker threads on Xe, so there's no per-worker scratch memory.
+
+define i8 * @__worker_scratch(i64 %size) nounwind {
+  ret i8 * null
+}
+
+;; Tasks launched from Xe code are run in loops by the launching thread, so
+;; there's nothing to cancel.
+
+define void @__cancel_tasks() nounwind {
+  ret void
+}
+
+define i1 @__task_cancelled() nounwind {
+  ret i1 false
+}
+
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ;; stdlib transcendentals
 ;;
@@ -5582,6 +5846,13 @@ define void @__memory_barrier() nounwind readnone alwaysinline {
   ret void
 }
 
+;; Waits for all of the tasks of the workgroup to reach the barrier, so that
+;; their writes to "shared" variables are visible to each other after it.
+define void @__workgroup_barrier() nounwind alwaysinline {
+  call void @llvm.genx.barrier()
+  ret void
+}
+
 global_atomic_associative(WIDTH, add, i32, int32, 0)
 global_atomic_associative(WIDTH, sub, i32, int32, 0)
 global_atomic_associative(WIDTH, and, i32, int32, -1)
@@ -5673,6 +5944,48 @@ define double @__atomic_compare_exchange_uniform_double_global(i8 * %ptr, double
 ')
 
 
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; matrix multiply-add on the systolic arrays (DPAS)
+;;
+;; Computes res = acc + a * b with a systolic depth and repeat count of 8.
+;; a is a tile of 8 rows of 8 dwords, the same for all program instances,
+;; and b has a column of 8 dwords for each program instance, with the
+;; 4 / sizeof(element) elements of consecutive rows packed in each dword.
+;; acc and res are 8 rows of WIDTH results.  Only called for the targets
+;; whose DPAS execution size is WIDTH.  Parameters:
+;; $1: suffix for function name
+;; $2: result type
+;; $3: precision of the elements of a and b (S8 = 8, BF16 = 9, FP16 = 10)
+;; $4: 1 if the result is signed, 0 otherwise
+
+define(`DPAS_N', `eval(8 * WIDTH)')
+define(`DPAS_NAME', `@llvm.genx.dpas2.XE_SUFFIXN($1, DPAS_N).XE_SUFFIXN($1, DPAS_N).XE_SUFFIXN(i32, DPAS_N).v64i32')
+
+declare <DPAS_N x float>
+DPAS_NAME(float)(<DPAS_N x float>, <DPAS_N x i32>, <64 x i32>, i32, i32, i32, i32, i32, i32)
+declare <DPAS_N x i32>
+DPAS_NAME(i32)(<DPAS_N x i32>, <DPAS_N x i32>, <64 x i32>, i32, i32, i32, i32, i32, i32)
+
+define(`xe_dpas', `
+define void @__xe_dpas_$1(i8 * %res, i8 * %acc, i8 * %a, i8 * %b) nounwind alwaysinline {
+  %acc_ptr = bitcast i8 * %acc to <DPAS_N x $2> *
+  %acc_val = load PTR_OP_ARGS(`<DPAS_N x $2>') %acc_ptr
+  %a_ptr = bitcast i8 * %a to <64 x i32> *
+  %a_val = load PTR_OP_ARGS(`<64 x i32>') %a_ptr
+  %b_ptr = bitcast i8 * %b to <DPAS_N x i32> *
+  %b_val = load PTR_OP_ARGS(`<DPAS_N x i32>') %b_ptr
+  %r = call <DPAS_N x $2>
+    DPAS_NAME($2)(<DPAS_N x $2> %acc_val, <DPAS_N x i32> %b_val, <64 x i32> %a_val, i32 $3, i32 $3, i32 8, i32 8, i32 $4, i32 $4)
+  %res_ptr = bitcast i8 * %res to <DPAS_N x $2> *
+  store <DPAS_N x $2> %r, <DPAS_N x $2> * %res_ptr
+  ret void
+}
+')
+
+xe_dpas(fp16, float, 10, 0)
+xe_dpas(bf16, float, 9, 0)
+xe_dpas(i8, i32, 8, 1)
+
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ;; Emit general-purpose code to do a masked load for targets that dont have
 ;; an instruction to do that.  Parameters:
@@ -6083,6 +6396,8 @@ define i32 @__packed_store_active2$1(i8 * %startptr, <WIDTH x $1> %vals,
 ;; loads a sequential value from the array.
 
 define(`packed_load_and_store', `
+  packed_load_and_store_type(i8, 1)
+  packed_load_and_store_type(i16, 2)
   packed_load_and_store_type(i32, 4)
   packed_load_and_store_type(i64, 8)
 ')
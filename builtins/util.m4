@@ -340,6 +340,30 @@ saturation_arithmetic_novec_universal(sub)
 saturation_arithmetic_novec_universal(add)
 ')
 
+;; Saturation arithmetic on i8 and i16 through the generic LLVM intrinsics, for
+;; targets which have native instructions for it at any width (AVX-512 with BW).
+;; $1: type, $2: LLVM name of the vector type, $3: ispc function name, $4: intrinsic
+
+define(`saturation_arithmetic_native_op', `
+declare <WIDTH x $1> @llvm.$4.$2(<WIDTH x $1>, <WIDTH x $1>)
+
+define <WIDTH x $1> @__$3(<WIDTH x $1>, <WIDTH x $1>) nounwind readnone alwaysinline {
+  %r = call <WIDTH x $1> @llvm.$4.$2(<WIDTH x $1> %0, <WIDTH x $1> %1)
+  ret <WIDTH x $1> %r
+}
+')
+
+define(`saturation_arithmetic_native', `
+saturation_arithmetic_native_op(i8, v`'WIDTH`'i8, padds_vi8, sadd.sat)
+saturation_arithmetic_native_op(i16, v`'WIDTH`'i16, padds_vi16, sadd.sat)
+saturation_arithmetic_native_op(i8, v`'WIDTH`'i8, paddus_vi8, uadd.sat)
+saturation_arithmetic_native_op(i16, v`'WIDTH`'i16, paddus_vi16, uadd.sat)
+saturation_arithmetic_native_op(i8, v`'WIDTH`'i8, psubs_vi8, ssub.sat)
+saturation_arithmetic_native_op(i16, v`'WIDTH`'i16, psubs_vi16, ssub.sat)
+saturation_arithmetic_native_op(i8, v`'WIDTH`'i8, psubus_vi8, usub.sat)
+saturation_arithmetic_native_op(i16, v`'WIDTH`'i16, psubus_vi16, usub.sat)
+')
+
 ;;4-wide vector saturation arithmetic
 
 define(`saturation_arithmetic_vec4', `
@@ -2016,6 +2040,23 @@ divert`'dnl
 ;; target's vector width
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 
+;; Generic shuffle with a varying permutation vector.
+;; $1: type
+
+define(`generic_shuffle', `
+define <WIDTH x $1> @__shuffle_$1(<WIDTH x $1>, <WIDTH x i32>) nounwind readnone alwaysinline {
+forloop(i, 0, eval(WIDTH-1), `
+  %index_`'i = extractelement <WIDTH x i32> %1, i32 i')
+forloop(i, 0, eval(WIDTH-1), `
+  %v_`'i = extractelement <WIDTH x $1> %0, i32 %index_`'i')
+
+  %ret_0 = insertelement <WIDTH x $1> undef, $1 %v_0, i32 0
+forloop(i, 1, eval(WIDTH-1), `  %ret_`'i = insertelement <WIDTH x $1> %ret_`'eval(i-1), $1 %v_`'i, i32 i
+')
+  ret <WIDTH x $1> %ret_`'eval(WIDTH-1)
+}
+')
+
 define(`shuffles', `
 define <WIDTH x $1> @__broadcast_$1(<WIDTH x $1>, i32) nounwind readnone alwaysinline {
   %v = extractelement <WIDTH x $1> %0, i32 %1
@@ -2075,17 +2116,9 @@ define <WIDTH x $1> @__shift_$1(<WIDTH x $1>, i32) nounwind readnone alwaysinlin
 }
 
 
-define <WIDTH x $1> @__shuffle_$1(<WIDTH x $1>, <WIDTH x i32>) nounwind readnone alwaysinline {
-forloop(i, 0, eval(WIDTH-1), `
-  %index_`'i = extractelement <WIDTH x i32> %1, i32 i')
-forloop(i, 0, eval(WIDTH-1), `
-  %v_`'i = extractelement <WIDTH x $1> %0, i32 %index_`'i')
-
-  %ret_0 = insertelement <WIDTH x $1> undef, $1 %v_0, i32 0
-forloop(i, 1, eval(WIDTH-1), `  %ret_`'i = insertelement <WIDTH x $1> %ret_`'eval(i-1), $1 %v_`'i, i32 i
-')
-  ret <WIDTH x $1> %ret_`'eval(WIDTH-1)
-}
+;; Targets may provide their own __shuffle_<type> by defining the
+;; custom_shuffle_<type> macro; it is expanded in place of the generic one.
+ifdef(`custom_shuffle_$1', `custom_shuffle_$1()', `generic_shuffle($1)')
 
 define <WIDTH x $1> @__shuffle2_$1(<WIDTH x $1>, <WIDTH x $1>, <WIDTH x i32>) nounwind readnone alwaysinline {
   %v2 = shufflevector <WIDTH x $1> %0, <WIDTH x $1> %1, <eval(2*WIDTH) x i32> <
@@ -2151,7 +2184,8 @@ shuffles(i64, 8)
 ;; result0 = atomic_op(ptr, tmp)
 ;; result1 = (result0 op val0)
 ;; ..
-;; And more efficiently compute the same result
+;; And more efficiently compute the same result.  For sub, the values are
+;; combined with add, as (ptr - val0 - val1) == (ptr - (val0 + val1)).
 ;;
 ;; Takes five parameters:
 ;; $1: vector width of the target
@@ -2280,7 +2314,7 @@ define <$1 x $3> @__atomic_$2_$4_global(i8 * %ptr, <$1 x $3> %val,
 
   forloop(i, 1, eval($1-1), `
   %elt`'i = extractelement <$1 x $3> %valp, i32 i
-  %red`'i = $2 $3 %red`'eval(i-1), %elt`'i
+  %red`'i = ifelse($2, `sub', `add', `$2') $3 %red`'eval(i-1), %elt`'i
   %eltvec`'i = insertelement <$1 x $3> %eltvec`'eval(i-1), $3 %red`'eval(i-1), i32 i')
 
   ; make the atomic call, passing it the final reduced value
@@ -4815,6 +4849,58 @@ define void
 }
 ')
 
+;; Generic AoS/SoA conversions for 2 to 16 fields of 8, 16, 32 and 64-bit
+;; elements. The whole block of fields is loaded or stored as one vector
+;; and split or merged with strided shufflevector instructions, which the
+;; interleaved access lowering and the target shuffle lowering turn into
+;; native instruction sequences.
+define(`aossoa_fields', `
+define void
+@__aos_to_soa$1_$2(i8 * noalias %p, i8 * noalias %out) nounwind alwaysinline {
+  %p0 = bitcast i8 * %p to <eval($1 * WIDTH) x $2> *
+  %v = load PTR_OP_ARGS(`<eval($1 * WIDTH) x $2> ')  %p0, align 1
+  %outptr = bitcast i8 * %out to <WIDTH x $2> *
+forloop(f, 0, eval($1 - 1), `
+  %v_`'f = shufflevector <eval($1 * WIDTH) x $2> %v, <eval($1 * WIDTH) x $2> undef,
+      <WIDTH x i32> < forloop(i, 0, eval(WIDTH - 2), `i32 eval(f + i * $1), ')i32 eval(f + (WIDTH - 1) * $1) >
+  %outptr_`'f = getelementptr PTR_OP_ARGS(`<WIDTH x $2>') %outptr, i32 f
+  store <WIDTH x $2> %v_`'f, <WIDTH x $2> * %outptr_`'f, align 1
+')
+  ret void
+}
+
+define void
+@__soa_to_aos$1_$2(i8 * noalias %in, i8 * noalias %p) nounwind alwaysinline {
+  %inptr = bitcast i8 * %in to <WIDTH x $2> *
+forloop(f, 0, eval($1 - 1), `
+  %inptr_`'f = getelementptr PTR_OP_ARGS(`<WIDTH x $2>') %inptr, i32 f
+  %v_`'f = load PTR_OP_ARGS(`<WIDTH x $2> ') %inptr_`'f, align 1
+')
+forloop(k, 2, eval($1 - 1), `
+  %w_`'k = shufflevector <WIDTH x $2> %v_`'k, <WIDTH x $2> undef,
+      <eval(k * WIDTH) x i32> < forloop(i, 0, eval(WIDTH - 1), `i32 i, ')forloop(i, WIDTH, eval(k * WIDTH - 2), `i32 undef, ')i32 undef >')
+  %acc_1 = shufflevector <WIDTH x $2> %v_0, <WIDTH x $2> %v_1,
+      <eval(2 * WIDTH) x i32> < forloop(i, 0, eval(2 * WIDTH - 2), `i32 i, ')i32 eval(2 * WIDTH - 1) >
+forloop(k, 2, eval($1 - 1), `
+  %acc_`'k = shufflevector <eval(k * WIDTH) x $2> %acc_`'eval(k - 1), <eval(k * WIDTH) x $2> %w_`'k,
+      <eval((k + 1) * WIDTH) x i32> < forloop(i, 0, eval((k + 1) * WIDTH - 2), `i32 i, ')i32 eval((k + 1) * WIDTH - 1) >')
+  %aos = shufflevector <eval($1 * WIDTH) x $2> %acc_`'eval($1 - 1), <eval($1 * WIDTH) x $2> undef,
+      <eval($1 * WIDTH) x i32> < forloop(j, 0, eval($1 * WIDTH - 2), `i32 eval((j % $1) * WIDTH + j / $1), ')i32 eval($1 * WIDTH - 1) >
+  %p0 = bitcast i8 * %p to <eval($1 * WIDTH) x $2> *
+  store <eval($1 * WIDTH) x $2> %aos, <eval($1 * WIDTH) x $2> * %p0, align 1
+  ret void
+}
+')
+
+define(`aossoa_generic', `
+forloop(n, 2, 16, `
+aossoa_fields(n, i8)
+aossoa_fields(n, i16)
+aossoa_fields(n, i32)
+aossoa_fields(n, i64)
+')
+')
+
 ;; versions to be called from stdlib
 define(`aossoa', `
 
@@ -5016,6 +5102,8 @@ define void
          <WIDTH x double> * %out0, <WIDTH x double> * %out1)
   ret void
 }
+
+aossoa_generic()
 ')
 
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
@@ -5098,6 +5186,273 @@ define void @__masked_store_blend_half(<WIDTH x half> * nocapture, <WIDTH x half
 }
 ')
 
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; dot products of packed integers
+;;
+;; __dot4add_u8i8packed(a, b, acc) adds to each 32-bit lane of acc the sum
+;; of products of the four unsigned bytes of a with the four signed bytes
+;; of b. __dot2add_i16i16packed(a, b, acc) does the same with the two
+;; signed 16-bit halves of a and b. The _sat variants saturate the result
+;; to the int32 range instead of wrapping around.
+;;
+;; Targets with AVX512-VNNI map these onto the vpdpbusd/vpdpwssd family of
+;; instructions; all others use the portable shift/multiply/add sequences.
+
+;; $1: builtin name
+;; $2: VNNI intrinsic name, without the vector width suffix
+define(`dot_product_vnni_op', `
+ifelse(WIDTH, `4', `declare <4 x i32> @llvm.x86.avx512.$2.128(<4 x i32>, <4 x i32>, <4 x i32>) nounwind readnone',
+       WIDTH, `8', `declare <8 x i32> @llvm.x86.avx512.$2.256(<8 x i32>, <8 x i32>, <8 x i32>) nounwind readnone',
+                   `declare <16 x i32> @llvm.x86.avx512.$2.512(<16 x i32>, <16 x i32>, <16 x i32>) nounwind readnone')
+
+define <WIDTH x i32> @$1(<WIDTH x i32> %a, <WIDTH x i32> %b, <WIDTH x i32> %acc) nounwind readnone alwaysinline {
+ifelse(WIDTH, `4', `
+  %r = call <4 x i32> @llvm.x86.avx512.$2.128(<4 x i32> %acc, <4 x i32> %a, <4 x i32> %b)',
+       WIDTH, `8', `
+  %r = call <8 x i32> @llvm.x86.avx512.$2.256(<8 x i32> %acc, <8 x i32> %a, <8 x i32> %b)',
+       WIDTH, `16', `
+  %r = call <16 x i32> @llvm.x86.avx512.$2.512(<16 x i32> %acc, <16 x i32> %a, <16 x i32> %b)',
+       WIDTH, `32', `
+  v32tov16(i32, %a, %a0, %a1)
+  v32tov16(i32, %b, %b0, %b1)
+  v32tov16(i32, %acc, %acc0, %acc1)
+  %r0 = call <16 x i32> @llvm.x86.avx512.$2.512(<16 x i32> %acc0, <16 x i32> %a0, <16 x i32> %b0)
+  %r1 = call <16 x i32> @llvm.x86.avx512.$2.512(<16 x i32> %acc1, <16 x i32> %a1, <16 x i32> %b1)
+  v16tov32(i32, %r0, %r1, %r)',
+       WIDTH, `64', `
+  v64tov16(i32, %a, %a0, %a1, %a2, %a3)
+  v64tov16(i32, %b, %b0, %b1, %b2, %b3)
+  v64tov16(i32, %acc, %acc0, %acc1, %acc2, %acc3)
+  %r0 = call <16 x i32> @llvm.x86.avx512.$2.512(<16 x i32> %acc0, <16 x i32> %a0, <16 x i32> %b0)
+  %r1 = call <16 x i32> @llvm.x86.avx512.$2.512(<16 x i32> %acc1, <16 x i32> %a1, <16 x i32> %b1)
+  %r2 = call <16 x i32> @llvm.x86.avx512.$2.512(<16 x i32> %acc2, <16 x i32> %a2, <16 x i32> %b2)
+  %r3 = call <16 x i32> @llvm.x86.avx512.$2.512(<16 x i32> %acc3, <16 x i32> %a3, <16 x i32> %b3)
+  v16tov64(i32, %r0, %r1, %r2, %r3, %r)',
+                     `errprint(`ERROR: dot_product_vnni() macro called with unsupported width = 'WIDTH
+)
+                      m4exit(`1')')
+  ret <WIDTH x i32> %r
+}
+')
+
+define(`dot_product_vnni', `
+dot_product_vnni_op(__dot4add_u8i8packed, vpdpbusd)
+dot_product_vnni_op(__dot4add_u8i8packed_sat, vpdpbusds)
+dot_product_vnni_op(__dot2add_i16i16packed, vpdpwssd)
+dot_product_vnni_op(__dot2add_i16i16packed_sat, vpdpwssds)
+')
+
+define(`dot_product_emulated', `
+define <WIDTH x i32> @__dot4add_u8i8packed(<WIDTH x i32> %a, <WIDTH x i32> %b,
+                                           <WIDTH x i32> %acc) nounwind readnone alwaysinline {
+  %a0 = and <WIDTH x i32> %a, const_vector(i32, 255)
+  %a1_sh = lshr <WIDTH x i32> %a, const_vector(i32, 8)
+  %a1 = and <WIDTH x i32> %a1_sh, const_vector(i32, 255)
+  %a2_sh = lshr <WIDTH x i32> %a, const_vector(i32, 16)
+  %a2 = and <WIDTH x i32> %a2_sh, const_vector(i32, 255)
+  %a3 = lshr <WIDTH x i32> %a, const_vector(i32, 24)
+  %b0_sh = shl <WIDTH x i32> %b, const_vector(i32, 24)
+  %b0 = ashr <WIDTH x i32> %b0_sh, const_vector(i32, 24)
+  %b1_sh = shl <WIDTH x i32> %b, const_vector(i32, 16)
+  %b1 = ashr <WIDTH x i32> %b1_sh, const_vector(i32, 24)
+  %b2_sh = shl <WIDTH x i32> %b, const_vector(i32, 8)
+  %b2 = ashr <WIDTH x i32> %b2_sh, const_vector(i32, 24)
+  %b3 = ashr <WIDTH x i32> %b, const_vector(i32, 24)
+  %p0 = mul <WIDTH x i32> %a0, %b0
+  %p1 = mul <WIDTH x i32> %a1, %b1
+  %p2 = mul <WIDTH x i32> %a2, %b2
+  %p3 = mul <WIDTH x i32> %a3, %b3
+  %p01 = add <WIDTH x i32> %p0, %p1
+  %p23 = add <WIDTH x i32> %p2, %p3
+  %sum = add <WIDTH x i32> %p01, %p23
+  %r = add <WIDTH x i32> %acc, %sum
+  ret <WIDTH x i32> %r
+}
+
+declare <WIDTH x i32> @llvm.sadd.sat.v`'WIDTH`'i32(<WIDTH x i32>, <WIDTH x i32>)
+
+;; the sum of the four byte products always fits in 32 bits, so a single
+;; saturating add gives the exact result
+define <WIDTH x i32> @__dot4add_u8i8packed_sat(<WIDTH x i32> %a, <WIDTH x i32> %b,
+                                               <WIDTH x i32> %acc) nounwind readnone alwaysinline {
+  %sum = call <WIDTH x i32> @__dot4add_u8i8packed(<WIDTH x i32> %a, <WIDTH x i32> %b,
+                                                  <WIDTH x i32> zeroinitializer)
+  %r = call <WIDTH x i32> @llvm.sadd.sat.v`'WIDTH`'i32(<WIDTH x i32> %acc, <WIDTH x i32> %sum)
+  ret <WIDTH x i32> %r
+}
+
+define <WIDTH x i32> @__dot2add_i16i16packed(<WIDTH x i32> %a, <WIDTH x i32> %b,
+                                             <WIDTH x i32> %acc) nounwind readnone alwaysinline {
+  %a0_sh = shl <WIDTH x i32> %a, const_vector(i32, 16)
+  %a0 = ashr <WIDTH x i32> %a0_sh, const_vector(i32, 16)
+  %a1 = ashr <WIDTH x i32> %a, const_vector(i32, 16)
+  %b0_sh = shl <WIDTH x i32> %b, const_vector(i32, 16)
+  %b0 = ashr <WIDTH x i32> %b0_sh, const_vector(i32, 16)
+  %b1 = ashr <WIDTH x i32> %b, const_vector(i32, 16)
+  %p0 = mul <WIDTH x i32> %a0, %b0
+  %p1 = mul <WIDTH x i32> %a1, %b1
+  %sum = add <WIDTH x i32> %p0, %p1
+  %r = add <WIDTH x i32> %acc, %sum
+  ret <WIDTH x i32> %r
+}
+
+;; the sum of the two 16-bit products may not fit in 32 bits, so the
+;; saturating version accumulates in 64 bits and clamps the final value
+define <WIDTH x i32> @__dot2add_i16i16packed_sat(<WIDTH x i32> %a, <WIDTH x i32> %b,
+                                                 <WIDTH x i32> %acc) nounwind readnone alwaysinline {
+  %a0_sh = shl <WIDTH x i32> %a, const_vector(i32, 16)
+  %a0 = ashr <WIDTH x i32> %a0_sh, const_vector(i32, 16)
+  %a1 = ashr <WIDTH x i32> %a, const_vector(i32, 16)
+  %b0_sh = shl <WIDTH x i32> %b, const_vector(i32, 16)
+  %b0 = ashr <WIDTH x i32> %b0_sh, const_vector(i32, 16)
+  %b1 = ashr <WIDTH x i32> %b, const_vector(i32, 16)
+  %p0 = mul <WIDTH x i32> %a0, %b0
+  %p1 = mul <WIDTH x i32> %a1, %b1
+  %p0_64 = sext <WIDTH x i32> %p0 to <WIDTH x i64>
+  %p1_64 = sext <WIDTH x i32> %p1 to <WIDTH x i64>
+  %acc_64 = sext <WIDTH x i32> %acc to <WIDTH x i64>
+  %sum = add <WIDTH x i64> %p0_64, %p1_64
+  %res = add <WIDTH x i64> %acc_64, %sum
+  %over_mask = icmp sgt <WIDTH x i64> %res, const_vector(i64, 2147483647)
+  %over_res = select <WIDTH x i1> %over_mask, <WIDTH x i64> const_vector(i64, 2147483647), <WIDTH x i64> %res
+  %under_mask = icmp slt <WIDTH x i64> %over_res, const_vector(i64, -2147483648)
+  %clamped = select <WIDTH x i1> %under_mask, <WIDTH x i64> const_vector(i64, -2147483648), <WIDTH x i64> %over_res
+  %r = trunc <WIDTH x i64> %clamped to <WIDTH x i32>
+  ret <WIDTH x i32> %r
+}
+')
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; conflict detection
+;;
+;; __conflict_i32(v) returns for each lane a bitmask of the lower lanes that
+;; hold the same value as it, like the AVX512CD vpconflictd instruction.
+;; Only targets with AVX512CD and at most 16 lanes provide it; on all others
+;; __have_conflict_detection() returns false, and stdlib.ispc never calls
+;; the placeholder __conflict_i32() defined there.
+
+define(`conflict_detect_avx512', `
+ifelse(WIDTH, `4', `declare <4 x i32> @llvm.x86.avx512.conflict.d.128(<4 x i32>) nounwind readnone',
+       WIDTH, `8', `declare <8 x i32> @llvm.x86.avx512.conflict.d.256(<8 x i32>) nounwind readnone',
+                   `declare <16 x i32> @llvm.x86.avx512.conflict.d.512(<16 x i32>) nounwind readnone')
+
+define i1 @__have_conflict_detection() nounwind readnone alwaysinline {
+  ret i1 true
+}
+
+define <WIDTH x i32> @__conflict_i32(<WIDTH x i32> %v) nounwind readnone alwaysinline {
+ifelse(WIDTH, `4', `
+  %r = call <4 x i32> @llvm.x86.avx512.conflict.d.128(<4 x i32> %v)',
+       WIDTH, `8', `
+  %r = call <8 x i32> @llvm.x86.avx512.conflict.d.256(<8 x i32> %v)',
+       WIDTH, `16', `
+  %r = call <16 x i32> @llvm.x86.avx512.conflict.d.512(<16 x i32> %v)',
+                     `errprint(`ERROR: conflict_detect_avx512() macro called with unsupported width = 'WIDTH
+)
+                      m4exit(`1')')
+  ret <WIDTH x i32> %r
+}
+')
+
+define(`conflict_detect_none', `
+define i1 @__have_conflict_detection() nounwind readnone alwaysinline {
+  ret i1 false
+}
+
+define <WIDTH x i32> @__conflict_i32(<WIDTH x i32> %v) nounwind readnone alwaysinline {
+  ret <WIDTH x i32> zeroinitializer
+}
+')
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; CRC32C
+;;
+;; __crc32c_u64(crc, v) folds the eight bytes of v into crc with the SSE4.2
+;; crc32 instruction.  Only the AVX and AVX-512 targets use it, since the
+;; sse4 builtins are shared with the SSE4.1-only sse41 targets.  On all
+;; others __have_crc32c() returns false and stdlib.ispc uses a table driven
+;; implementation instead.
+
+define(`crc32c_sse42', `
+declare i32 @llvm.x86.sse42.crc32.32.32(i32, i32) nounwind readnone
+ifelse(RUNTIME, `64', `declare i64 @llvm.x86.sse42.crc32.64.64(i64, i64) nounwind readnone')
+
+define i1 @__have_crc32c() nounwind readnone alwaysinline {
+  ret i1 true
+}
+
+define i32 @__crc32c_u64(i32 %crc, i64 %v) nounwind readnone alwaysinline {
+ifelse(RUNTIME, `64', `
+  %c = zext i32 %crc to i64
+  %r64 = call i64 @llvm.x86.sse42.crc32.64.64(i64 %c, i64 %v)
+  %r = trunc i64 %r64 to i32', `
+  %lo = trunc i64 %v to i32
+  %v_hi = lshr i64 %v, 32
+  %hi = trunc i64 %v_hi to i32
+  %c = call i32 @llvm.x86.sse42.crc32.32.32(i32 %crc, i32 %lo)
+  %r = call i32 @llvm.x86.sse42.crc32.32.32(i32 %c, i32 %hi)')
+  ret i32 %r
+}
+')
+
+define(`crc32c_none', `
+define i1 @__have_crc32c() nounwind readnone alwaysinline {
+  ret i1 false
+}
+
+define i32 @__crc32c_u64(i32 %crc, i64 %v) nounwind readnone alwaysinline {
+  ret i32 0
+}
+')
+
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; fused multiply-add
+;;
+;; __fma_*(a, b, c) computes a * b + c with a single rounding.  llvm.fma is
+;; correctly rounded on all targets, but without the instruction it becomes
+;; a libm call per lane, so __have_fma() tells stdlib.ispc whether it's fast.
+
+define(`fma_decls', `
+declare float @llvm.fma.f32(float, float, float) nounwind readnone
+declare double @llvm.fma.f64(double, double, double) nounwind readnone
+declare <WIDTH x float> @llvm.fma.v`'WIDTH`'f32(<WIDTH x float>, <WIDTH x float>, <WIDTH x float>) nounwind readnone
+declare <WIDTH x double> @llvm.fma.v`'WIDTH`'f64(<WIDTH x double>, <WIDTH x double>, <WIDTH x double>) nounwind readnone
+
+define i1 @__have_fma() nounwind readnone alwaysinline {
+ifelse(ISA, `AVX2', `  ret i1 true',
+       ISA, `AVX512KNL', `  ret i1 true',
+       ISA, `AVX512SKX', `  ret i1 true',
+       ISA, `SVE', `  ret i1 true',
+       ISA, `RVV', `  ret i1 true',
+       ISA, `NEON', `ifelse(RUNTIME, `64', `  ret i1 true', `  ret i1 false')',
+                    `  ret i1 false')
+}
+
+define float @__fma_uniform_float(float, float, float) nounwind readnone alwaysinline {
+  %r = call float @llvm.fma.f32(float %0, float %1, float %2)
+  ret float %r
+}
+
+define double @__fma_uniform_double(double, double, double) nounwind readnone alwaysinline {
+  %r = call double @llvm.fma.f64(double %0, double %1, double %2)
+  ret double %r
+}
+
+define <WIDTH x float> @__fma_varying_float(<WIDTH x float>, <WIDTH x float>,
+                                            <WIDTH x float>) nounwind readnone alwaysinline {
+  %r = call <WIDTH x float> @llvm.fma.v`'WIDTH`'f32(<WIDTH x float> %0, <WIDTH x float> %1, <WIDTH x float> %2)
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x double> @__fma_varying_double(<WIDTH x double>, <WIDTH x double>,
+                                              <WIDTH x double>) nounwind readnone alwaysinline {
+  %r = call <WIDTH x double> @llvm.fma.v`'WIDTH`'f64(<WIDTH x double> %0, <WIDTH x double> %1, <WIDTH x double> %2)
+  ret <WIDTH x double> %r
+}
+')
+
+
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 
 
@@ -5107,6 +5462,8 @@ declare i32 @__fast_masked_vload()
 
 declare i8* @ISPCAlloc(i8**, i64, i32) nounwind
 declare void @ISPCLaunch(i8**, i8*, i8*, i32, i32, i32) nounwind
+declare void @ISPCLaunchAfter(i8**, i8*, i8*, i32, i32, i32, i64*, i32) nounwind
+declare void @ISPCLaunchWithHints(i8**, i8*, i8*, i32, i32, i32, i64*, i32, i32, i32, i32) nounwind
 declare void @ISPCSync(i8*) nounwind
 declare void @ISPCInstrument(i8*, i8*, i32, i64) nounwind
 
@@ -6334,18 +6691,30 @@ define void @__do_assume_uniform(i1 %test) alwaysinline {
   ret void
 }
 
+define void @__do_assume_aligned_uniform(i8 * %ptr, i64 %alignment) alwaysinline {
+  call void @llvm.assume(i1 true) [ "align"(i8 * %ptr, i64 %alignment) ]
+  ret void
+}
+
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ;; assert
 
 declare i32 @puts(i8*)
 declare void @abort() noreturn
 
+;; The failure path of assertions, which is kept out of line so that only
+;; the test of the condition is emitted where the assertion is.
+define void @__do_assert_fail(i8 *%str) cold noinline noreturn {
+  %call = call i32 @puts(i8* %str)
+  call void @abort() noreturn
+  unreachable
+}
+
 define void @__do_assert_uniform(i8 *%str, i1 %test, <WIDTH x MASK> %mask) {
   br i1 %test, label %ok, label %fail
 
 fail:
-  %call = call i32 @puts(i8* %str)
-  call void @abort() noreturn
+  call void @__do_assert_fail(i8* %str) noreturn
   unreachable
 
 ok:
@@ -6363,8 +6732,7 @@ define void @__do_assert_varying(i8 *%str, <WIDTH x MASK> %test,
   br i1 %all_ok, label %ok, label %fail
 
 fail:
-  %call = call i32 @puts(i8* %str)
-  call void @abort() noreturn
+  call void @__do_assert_fail(i8* %str) noreturn
   unreachable
 
 ok:
@@ -6665,6 +7033,112 @@ errprint(`BUILD_OS should be defined to either UNIX or WINDOWS
 m4exit(`1')
 ')
 
+;; Set of functions used instead of the ones above with --custom-allocator,
+;; they call the allocator of the application, which has to provide:
+;;   void *ISPCMalloc(int64_t size, int32_t alignment);
+;;   void ISPCFree(void *ptr);
+;; Same functions for 32 and 64 bit runtime, pointers go through i8*.
+;; Define:
+;; - __new_uniform_custom
+;; - __new_varying32_custom
+;; - __new_varying64_custom
+;; - __delete_uniform_custom
+;; - __delete_varying_custom
+
+declare noalias i8 * @ISPCMalloc(i64, i32)
+declare void @ISPCFree(i8 *)
+
+define noalias i8 * @__new_uniform_custom(i64 %size) {
+  %alignment = load PTR_OP_ARGS(`i32')  @memory_alignment
+  %ptr = call noalias i8 * @ISPCMalloc(i64 %size, i32 %alignment)
+  ret i8* %ptr
+}
+
+define <WIDTH x i64> @__new_varying64_custom(<WIDTH x i64> %size, <WIDTH x MASK> %mask) {
+  %ret = alloca <WIDTH x i64>
+  store <WIDTH x i64> zeroinitializer, <WIDTH x i64> * %ret
+  %ret64 = bitcast <WIDTH x i64> * %ret to i64 *
+  %alignment = load PTR_OP_ARGS(`i32')  @memory_alignment
+
+  per_lane(WIDTH, <WIDTH x MASK> %mask, `
+    %sz64_LANE_ID = extractelement <WIDTH x i64> %size, i32 LANE
+    %ptr_LANE_ID = call noalias i8 * @ISPCMalloc(i64 %sz64_LANE_ID, i32 %alignment)
+    %ptr_int_LANE_ID = ptrtoint i8 * %ptr_LANE_ID to i64
+    %store_LANE_ID = getelementptr PTR_OP_ARGS(`i64') %ret64, i32 LANE
+    store i64 %ptr_int_LANE_ID, i64 * %store_LANE_ID')
+
+  %r = load PTR_OP_ARGS(`<WIDTH x i64> ')  %ret
+  ret <WIDTH x i64> %r
+}
+
+define <WIDTH x i64> @__new_varying32_custom(<WIDTH x i32> %size, <WIDTH x MASK> %mask) {
+  %size64 = zext <WIDTH x i32> %size to <WIDTH x i64>
+  %r = call <WIDTH x i64> @__new_varying64_custom(<WIDTH x i64> %size64, <WIDTH x MASK> %mask)
+  ret <WIDTH x i64> %r
+}
+
+define void @__delete_uniform_custom(i8 * %ptr) {
+  call void @ISPCFree(i8 * %ptr)
+  ret void
+}
+
+define void @__delete_varying_custom(<WIDTH x i64> %ptr, <WIDTH x MASK> %mask) {
+  per_lane(WIDTH, <WIDTH x MASK> %mask, `
+      %iptr_LANE_ID = extractelement <WIDTH x i64> %ptr, i32 LANE
+      %ptr_LANE_ID = inttoptr i64 %iptr_LANE_ID to i8 *
+      call void @ISPCFree(i8 * %ptr_LANE_ID)
+  ')
+  ret void
+}
+
+;; Per-worker scratch memory, provided by the tasking system as:
+;;   void *ISPCWorkerScratch(int64_t size);
+;; It returns a cache line aligned slab of at least size bytes owned by the
+;; calling thread, which is reused by all the tasks the thread runs.
+
+declare i8 * @ISPCWorkerScratch(i64) nounwind
+
+define i8 * @__worker_scratch(i64 %size) nounwind {
+  %ptr = call i8 * @ISPCWorkerScratch(i64 %size)
+  ret i8* %ptr
+}
+
+;; Cooperative cancellation of the tasks of a launching function, provided
+;; by the tasking system as:
+;;   void ISPCCancelTasks();
+;;   int ISPCTasksCancelled();
+;; They refer to the task group of the task being run by the calling thread.
+
+declare void @ISPCCancelTasks() nounwind
+declare i32 @ISPCTasksCancelled() nounwind
+
+define void @__cancel_tasks() nounwind {
+  call void @ISPCCancelTasks()
+  ret void
+}
+
+define i1 @__task_cancelled() nounwind {
+  %c = call i32 @ISPCTasksCancelled()
+  %r = icmp ne i32 %c, 0
+  ret i1 %r
+}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; scratch memory for stdlib routines
+;;
+;; stdlib.ispc is compiled once for both 32 and 64 bit runtimes, so it
+;; cannot pick between the _32rt and _64rt variants above itself.
+
+define noalias i8 * @__stdlib_scratch_alloc(i64 %size) nounwind alwaysinline {
+  %ptr = call i8 * @__new_uniform_`'RUNTIME`'rt(i64 %size)
+  ret i8 * %ptr
+}
+
+define void @__stdlib_scratch_free(i8 * %ptr) nounwind alwaysinline {
+  call void @__delete_uniform_`'RUNTIME`'rt(i8 * %ptr)
+  ret void
+}
+
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ;; read hw clock
 
@@ -6678,6 +7152,26 @@ define i64 @__clock() nounwind {
 }
 ')
 
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; dot products of packed integers
+
+ifelse(HAVE_VNNI, `1', `dot_product_vnni()', `dot_product_emulated()')
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; conflict detection
+
+ifelse(HAVE_CONFLICT, `1', `conflict_detect_avx512()', `conflict_detect_none()')
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; CRC32C
+
+ifelse(HAVE_CRC32C, `1', `crc32c_sse42()', `crc32c_none()')
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; fused multiply-add
+
+fma_decls()
+
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ;; stdlib transcendentals
 ;;
@@ -6831,6 +7325,19 @@ define void @__memory_barrier() nounwind readnone alwaysinline {
   ret void
 }
 
+;; Each task is a workgroup of its own on the CPU and the program instances
+;; of a gang don't need to be synchronized, so only keep the compiler from
+;; moving memory accesses across the barrier.
+define void @__workgroup_barrier() nounwind alwaysinline {
+  fence syncscope("singlethread") seq_cst
+  ret void
+}
+
+;; There are no systolic arrays on the CPU, matrix_mad() doesn't call these.
+declare void @__xe_dpas_fp16(i8 *, i8 *, i8 *, i8 *)
+declare void @__xe_dpas_bf16(i8 *, i8 *, i8 *, i8 *)
+declare void @__xe_dpas_i8(i8 *, i8 *, i8 *, i8 *)
+
 global_atomic_associative(WIDTH, add, i32, int32, 0)
 global_atomic_associative(WIDTH, sub, i32, int32, 0)
 global_atomic_associative(WIDTH, and, i32, int32, -1)
@@ -7347,6 +7854,32 @@ define void @__masked_store_$1(<WIDTH x $1>* nocapture, <WIDTH x $1>, <WIDTH x M
 }
 ')
 
+;; Masked load and store through the LLVM intrinsics, for targets which have
+;; native masked moves for the type (e.g. AVX-512 with BW for i8 and i16).
+;; $1: element type (i8, i16, ...)
+;; $2: LLVM name of the vector type (v64i8, v32f16, ...)
+;; $3: alignment for elements of type $1
+
+define(`gen_masked_load_native', `
+declare <WIDTH x $1> @llvm.masked.load.$2.p0$2(<WIDTH x $1>*, i32, <WIDTH x i1>, <WIDTH x $1>)
+
+define <WIDTH x $1> @__masked_load_$1(i8 * %ptr, <WIDTH x MASK> %mask) nounwind readonly alwaysinline {
+  %ptr_typed = bitcast i8* %ptr to <WIDTH x $1>*
+  %r = call <WIDTH x $1> @llvm.masked.load.$2.p0$2(<WIDTH x $1>* %ptr_typed, i32 $3,
+                                                 <WIDTH x i1> %mask, <WIDTH x $1> undef)
+  ret <WIDTH x $1> %r
+}
+')
+
+define(`gen_masked_store_native', `
+declare void @llvm.masked.store.$2.p0$2(<WIDTH x $1>, <WIDTH x $1>*, i32, <WIDTH x i1>)
+
+define void @__masked_store_$1(<WIDTH x $1>* nocapture, <WIDTH x $1>, <WIDTH x MASK>) nounwind alwaysinline {
+  call void @llvm.masked.store.$2.p0$2(<WIDTH x $1> %1, <WIDTH x $1>* %0, i32 $3, <WIDTH x i1> %2)
+  ret void
+}
+')
+
 define(`masked_store_blend_8_16_by_4', `
 define void @__masked_store_blend_i8(<4 x i8>* nocapture, <4 x i8>,
                                      <4 x i32>) nounwind alwaysinline {
@@ -7600,11 +8133,18 @@ done:
 ;; destination array.  For packed load, each lane that has an active mask
 ;; loads a sequential value from the array.
 ;;
+;; They are implemented with the LLVM expandload/compressstore intrinsics,
+;; which become single vpexpand/vpcompress instructions on AVX512 targets
+;; (for 8 and 16-bit elements, only on targets with VBMI2) and are
+;; scalarized elsewhere.
+;;
 ;; $1: 'TRUE' if LLVM compressstore/expandload intrinsics should be used for implementation of '__packed_store_active2'.
 ;;     This is the case for the targets with native support of these intrinsics (AVX512).
 ;;     For other targets branchless emulation sequence should be used (triggered by 'FALSE').
 
 define(`packed_load_and_store', `
+  packed_load_and_store_type(i8, $1, 1)
+  packed_load_and_store_type(i16, $1, 2)
   packed_load_and_store_type(i32, $1, 4)
   packed_load_and_store_type(i64, $1, 8)
 ')
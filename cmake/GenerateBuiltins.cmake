@@ -62,8 +62,14 @@ list(APPEND M4_IMPLICIT_DEPENDENCIES
     builtins/target-avx512-common-16.ll
     builtins/target-avx512-utils.ll
     builtins/target-neon-common.ll
+    builtins/target-predicated-common.ll
+    builtins/target-rvv-common.ll
     builtins/target-sse2-common.ll
     builtins/target-sse4-common.ll
+    builtins/target-sve-common.ll
+    builtins/target-wasm-i32x4.ll
+    builtins/target-wasm-i32x8.ll
+    builtins/target-wasm-relaxed-common.ll
     builtins/target-xe.ll
     builtins/util-xe.m4
     builtins/util.m4)
@@ -79,6 +85,16 @@ function(target_ll_to_cpp llFileName bit os_name resultFileName)
         return()
     endif()
 
+    # SVE targets constraints: SVE is available only in AArch64 state.
+    if ("${bit}" STREQUAL "32" AND ${llFileName} MATCHES "^target-sve-")
+        return()
+    endif()
+
+    # RVV targets constraints: only RV64 on Unix-like OSes is supported.
+    if (${llFileName} MATCHES "^target-rvv-" AND ("${bit}" STREQUAL "32" OR ${os_name} STREQUAL "windows"))
+        return()
+    endif()
+
     set(output ${CMAKE_CURRENT_BINARY_DIR}/${CMAKE_CFG_INTDIR}/builtins-${llFileName}-${bit}bit-${os_name}.cpp)
     add_custom_command(
         OUTPUT ${output}
@@ -122,6 +138,11 @@ function(builtin_to_cpp bit os_name arch supported_archs supported_oses resultFi
         return()
     endif()
 
+    # Only 64-bit RISC-V Linux is supported.
+    if (${arch} STREQUAL "riscv" AND (NOT ${os_name} STREQUAL "linux" OR NOT "${bit}" STREQUAL "64"))
+        return()
+    endif()
+
     if ("${bit}" STREQUAL "32" AND ${arch} STREQUAL "x86")
         set(target_arch "i686")
     elseif ("${bit}" STREQUAL "64" AND ${arch} STREQUAL "x86")
@@ -132,6 +153,8 @@ function(builtin_to_cpp bit os_name arch supported_archs supported_oses resultFi
         set(target_arch "aarch64")
     elseif ("${bit}" STREQUAL "32" AND ${arch} STREQUAL "wasm32")
         set(target_arch "wasm32")
+    elseif ("${bit}" STREQUAL "64" AND ${arch} STREQUAL "riscv")
+        set(target_arch "riscv64")
     else()
         message(FATAL_ERROR "Error")
     endif()
@@ -197,7 +220,8 @@ function(builtin_to_cpp bit os_name arch supported_archs supported_oses resultFi
     if (${os_name} STREQUAL "windows")
         set(triple ${target_arch}-pc-win32)
     elseif (${os_name} STREQUAL "linux")
-        if (${target_arch} STREQUAL "i686" OR ${target_arch} STREQUAL "x86_64" OR ${target_arch} STREQUAL "aarch64")
+        if (${target_arch} STREQUAL "i686" OR ${target_arch} STREQUAL "x86_64" OR ${target_arch} STREQUAL "aarch64" OR
+            ${target_arch} STREQUAL "riscv64")
             set(triple ${target_arch}-unknown-linux-gnu)
             set(debian_triple ${target_arch}-linux-gnu)
         elseif (${target_arch} STREQUAL "armv7")
@@ -392,6 +416,9 @@ function (generate_common_builtins resultList)
     if (ARM_ENABLED)
         list (APPEND supported_archs "arm")
     endif()
+    if (RISCV_ENABLED)
+        list (APPEND supported_archs "riscv")
+    endif()
     if (WASM_ENABLED)
         list (APPEND supported_archs "wasm32")
         list (APPEND supported_oses "web")
@@ -423,7 +450,7 @@ function (generate_common_builtins resultList)
     message (STATUS "ISPC will be built with support of ${supported_oses} for ${supported_archs}")
     foreach (bit 32 64)
         foreach (os_name "windows" "linux" "freebsd" "macos" "android" "ios" "ps4" "web")
-            foreach (arch "x86" "arm" "wasm32")
+            foreach (arch "x86" "arm" "riscv" "wasm32")
                 builtin_to_cpp(${bit} ${os_name} ${arch} "${supported_archs}" "${supported_oses}" res${bit}${os_name}${arch})
                 list(APPEND tmpList ${res${bit}${os_name}${arch}} )
                 if(MSVC)
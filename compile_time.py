@@ -0,0 +1,252 @@
+#!/usr/bin/env python3
+#
+#  Copyright (c) 2023, Intel Corporation
+#  All rights reserved.
+#
+#  Redistribution and use in source and binary forms, with or without
+#  modification, are permitted provided that the following conditions are
+#  met:
+#
+#    * Redistributions of source code must retain the above copyright
+#      notice, this list of conditions and the following disclaimer.
+#
+#    * Redistributions in binary form must reproduce the above copyright
+#      notice, this list of conditions and the following disclaimer in the
+#      documentation and/or other materials provided with the distribution.
+#
+#    * Neither the name of Intel Corporation nor the names of its
+#      contributors may be used to endorse or promote products derived from
+#      this software without specific prior written permission.
+#
+#
+#   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+#   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+#   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+#   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+#   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+#   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+#   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+#   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+#   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+#   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+
+# Compile-time benchmark of ispc itself. It compiles the tests/ corpus and the
+# CPU examples for each target configuration (single target or comma-separated
+# multi-target), records wall time, peak RSS and the per-phase timings reported
+# by --time-trace, and optionally compares the run against a baseline:
+#
+#   compile_time.py -o base.json
+#   compile_time.py -o new.json --baseline base.json --threshold 5
+
+import glob
+import json
+import os
+import platform
+import re
+import subprocess
+import sys
+import tempfile
+import time
+from optparse import OptionParser
+
+# Top-level --time-trace scopes of ispc, see Module::CompileFile() and friends.
+PHASES = ["DefineStdlib", "Frontend parser", "LinkLazyBuiltins", "GenerateIR", "Optimize", "Backend", "ExecuteCompiler"]
+
+# Signatures of the test functions, the same mapping as run_tests.py uses to set TEST_SIG.
+SIG2DEF = {"f_v(": 0, "f_f(": 1, "f_fu(": 2, "f_fi(": 3, "f_du(": 4, "f_duf(": 5, "f_di(": 6, "f_sz": 7,
+           "f_t(": 8, "print_uf(": 32, "print_f(": 33, "print_fuf(": 34, "print_no(": 35}
+
+def test_sig(filename):
+    with open(filename, 'r', errors='replace') as f:
+        for line in f:
+            if line.find("task") == -1 and line.find("export") == -1:
+                continue
+            for pattern, ident in SIG2DEF.items():
+                if line.find(pattern) != -1:
+                    return ident
+    return -1
+
+def collect_sources(root, corpus, file_filter):
+    sources = []
+    if "tests" in corpus:
+        for f in sorted(glob.glob(os.path.join(root, "tests", "*.ispc"))):
+            sig = test_sig(f)
+            # Tests that are expected to fail or have no known signature are not part of the corpus.
+            if sig != -1 and os.path.basename(f).find("failing_") == -1:
+                sources.append((f, ["-DTEST_SIG=%d" % sig]))
+    if "examples" in corpus:
+        for f in sorted(glob.glob(os.path.join(root, "examples", "cpu", "*", "*.ispc"))):
+            sources.append((f, []))
+    if file_filter:
+        regex = re.compile(file_filter)
+        sources = [s for s in sources if regex.search(s[0])]
+    return sources
+
+# Sum of the durations (in ms) of the top-level phases in a --time-trace file.
+def parse_time_trace(filename):
+    phases = dict((p, 0.0) for p in PHASES)
+    with open(filename, 'r') as f:
+        trace = json.load(f)
+    for event in trace.get("traceEvents", []):
+        if event.get("ph") == "X" and event.get("name") in phases:
+            phases[event["name"]] += event.get("dur", 0) / 1000.0
+    return phases
+
+# Run a command and return its exit code, wall time in ms and peak RSS in MB (None when not available).
+def run_measured(cmd):
+    start = time.perf_counter()
+    proc = subprocess.Popen(cmd, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    if hasattr(os, "wait4"):
+        _, status, usage = os.wait4(proc.pid, 0)
+        wall = (time.perf_counter() - start) * 1000.0
+        # ru_maxrss is in bytes on macOS and in kilobytes elsewhere.
+        rss = usage.ru_maxrss / (1024.0 * 1024.0 if platform.system() == "Darwin" else 1024.0)
+        proc.returncode = os.waitstatus_to_exitcode(status) if hasattr(os, "waitstatus_to_exitcode") else status
+        return proc.returncode, wall, rss
+    proc.wait()
+    return proc.returncode, (time.perf_counter() - start) * 1000.0, None
+
+def compile_one(options, source, defines, target, tmpdir):
+    obj = os.path.join(tmpdir, "out.o")
+    cmd = [options.ispc, source, "-o", obj, "--target=" + target, "--woff", "--time-trace"] + defines
+    cmd += options.flags.split()
+    best = None
+    for _ in range(int(options.number)):
+        code, wall, rss = run_measured(cmd)
+        if code != 0:
+            return None
+        phases = parse_time_trace(obj + ".json")
+        # Keep the fastest run, the peak RSS is the maximum over all runs.
+        if best is None or wall < best["wall"]:
+            best = {"wall": wall, "rss": rss if best is None else best["rss"], "phases": phases}
+        if rss is not None and (best["rss"] is None or rss > best["rss"]):
+            best["rss"] = rss
+    return best
+
+def ispc_version(ispc):
+    try:
+        return subprocess.check_output([ispc, "--version"], universal_newlines=True).strip()
+    except (OSError, subprocess.CalledProcessError):
+        return ""
+
+def run(options):
+    root = os.path.abspath(options.path)
+    sources = collect_sources(root, options.corpus.split(","), options.filter)
+    configs = [t for t in options.targets.split(";") if t]
+    results = {"ispc": ispc_version(options.ispc), "flags": options.flags, "targets": configs, "runs": {}}
+    failed = 0
+    with tempfile.TemporaryDirectory() as tmpdir:
+        for config in configs:
+            runs = {}
+            for i, (source, defines) in enumerate(sources):
+                name = os.path.relpath(source, root).replace(os.sep, "/")
+                if not options.silent:
+                    sys.stdout.write("\r[%s] %d/%d %s\033[K" % (config, i + 1, len(sources), name))
+                    sys.stdout.flush()
+                res = compile_one(options, source, defines, config, tmpdir)
+                if res is None:
+                    failed += 1
+                    continue
+                runs[name] = res
+            results["runs"][config] = runs
+            if not options.silent:
+                sys.stdout.write("\r\033[K")
+            print_summary(config, runs)
+    if failed:
+        print("%d compilations failed and were excluded" % failed)
+    return results
+
+def summarize(runs, names=None):
+    names = runs.keys() if names is None else names
+    total = {"wall": 0.0, "rss": 0.0, "phases": dict((p, 0.0) for p in PHASES)}
+    for name in names:
+        r = runs[name]
+        total["wall"] += r["wall"]
+        total["rss"] = max(total["rss"], r["rss"] or 0.0)
+        for p in PHASES:
+            total["phases"][p] += r["phases"].get(p, 0.0)
+    return total
+
+def print_summary(config, runs):
+    total = summarize(runs)
+    print("%s: %d files, total %.1f ms, peak RSS %.1f MB" % (config, len(runs), total["wall"], total["rss"]))
+    for p in PHASES:
+        print("    %-18s %10.1f ms" % (p, total["phases"][p]))
+
+def change(new, old):
+    return (new - old) * 100.0 / old if old > 0 else 0.0
+
+# Compare the totals of every configuration over the files compiled in both runs,
+# and the individual files above the noise floor. Return the number of regressions.
+def compare(results, baseline, options):
+    regressions = 0
+    threshold = float(options.threshold)
+    rss_threshold = float(options.rss_threshold)
+    for config, runs in results["runs"].items():
+        if config not in baseline["runs"]:
+            print("%s: not in the baseline" % config)
+            continue
+        base_runs = baseline["runs"][config]
+        common = sorted(set(runs.keys()) & set(base_runs.keys()))
+        new, old = summarize(runs, common), summarize(base_runs, common)
+        print("%s: %d files in common" % (config, len(common)))
+        rows = [("total", new["wall"], old["wall"], threshold)]
+        rows += [(p, new["phases"][p], old["phases"][p], threshold) for p in PHASES]
+        rows += [("peak RSS (MB)", new["rss"], old["rss"], rss_threshold)]
+        for name, n, o, limit in rows:
+            c = change(n, o)
+            bad = c > limit
+            regressions += bad
+            print("    %-18s %10.1f -> %10.1f  %+6.1f%%%s" % (name, o, n, c, "  REGRESSION" if bad else ""))
+        for name in common:
+            n, o = runs[name]["wall"], base_runs[name]["wall"]
+            if o >= float(options.min_time) and change(n, o) > float(options.file_threshold):
+                print("    %s: %.1f -> %.1f ms (%+.1f%%)" % (name, o, n, change(n, o)))
+    return regressions
+
+if __name__ == "__main__":
+    default_targets = "avx2-i32x8;sse4-i32x4,avx2-i32x8,avx512skx-x16"
+    if platform.machine().lower() in ["arm64", "aarch64"]:
+        default_targets = "neon-i32x4;neon-i32x4,neon-i32x8"
+    parser = OptionParser()
+    parser.add_option('--ispc', dest='ispc', help='ispc executable to measure', default="ispc")
+    parser.add_option('-p', '--path', dest='path', help='path to ispc root', default=".")
+    parser.add_option('-t', '--targets', dest='targets',
+        help='semicolon-separated target configurations, each one a target or a comma-separated multi-target list',
+        default=default_targets)
+    parser.add_option('-c', '--corpus', dest='corpus', help='comma-separated list of: tests, examples',
+        default="tests,examples")
+    parser.add_option('-f', '--filter', dest='filter', help='regex to select source files', default="")
+    parser.add_option('--flags', dest='flags', help='additional ispc flags', default="-O2")
+    parser.add_option('-n', '--number', dest='number', help='number of repeats, the fastest is kept', default="1")
+    parser.add_option('-o', '--output', dest='output', help='file to save results in JSON format', default="")
+    parser.add_option('-b', '--baseline', dest='baseline', help='results in JSON format to compare with', default="")
+    parser.add_option('--compare-only', dest='compare_only',
+        help='compare results in JSON format with the baseline instead of running ispc', default="")
+    parser.add_option('--threshold', dest='threshold',
+        help='allowed increase of total and per-phase time, in percent', default="5")
+    parser.add_option('--rss-threshold', dest='rss_threshold',
+        help='allowed increase of peak RSS, in percent', default="5")
+    parser.add_option('--file-threshold', dest='file_threshold',
+        help='report files whose time increased by more than this, in percent', default="20")
+    parser.add_option('--min-time', dest='min_time',
+        help='ignore files faster than this in the baseline, in ms', default="100")
+    parser.add_option('-s', '--silent', dest='silent', help='no progress output', default=False, action="store_true")
+    (options, args) = parser.parse_args()
+
+    if options.compare_only:
+        with open(options.compare_only, 'r') as f:
+            results = json.load(f)
+    else:
+        results = run(options)
+        if options.output:
+            with open(options.output, 'w') as f:
+                json.dump(results, f, indent=1)
+
+    if options.baseline:
+        with open(options.baseline, 'r') as f:
+            baseline = json.load(f)
+        regressions = compare(results, baseline, options)
+        if regressions:
+            print("%d compile-time regressions above threshold" % regressions)
+            sys.exit(1)
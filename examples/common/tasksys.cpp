@@ -191,6 +191,10 @@ extern "C" {
 void ISPCLaunch(void **handlePtr, void *f, void *data, int countx, int county, int countz);
 void *ISPCAlloc(void **handlePtr, int64_t size, int32_t alignment);
 void ISPCSync(void *handle);
+void ISPCLaunchAfter(void **handlePtr, void *f, void *data, int countx, int county, int countz, const int64_t *after,
+                     int numAfter);
+void ISPCLaunchWithHints(void **handlePtr, void *f, void *data, int countx, int county, int countz,
+                         const int64_t *after, int numAfter, int grain, int affinity, int priority);
 }
 
 ///////////////////////////////////////////////////////////////////////////
@@ -364,11 +368,23 @@ static inline int32_t lAtomicAdd(volatile int32_t *v, int32_t delta) {
 ///////////////////////////////////////////////////////////////////////////
 
 #ifdef ISPC_USE_CONCRT
-// With ConcRT, we don't need to extend TaskGroupBase at all.
+/* With ConcRT, we only need to keep track of the tasks that have been
+   waited for already, since ISPCLaunchAfter() may wait for the tasks of the
+   group before more of them are launched. */
 class TaskGroup : public TaskGroupBase {
   public:
+    TaskGroup() { nSyncedTasks = 0; }
+
+    void Reset() {
+        TaskGroupBase::Reset();
+        nSyncedTasks = 0;
+    }
+
     void Launch(int baseIndex, int count);
     void Sync();
+
+  private:
+    int nSyncedTasks;
 };
 #endif // ISPC_USE_CONCRT
 
@@ -552,11 +568,12 @@ inline void TaskGroup::Launch(int baseIndex, int count) {
 }
 
 inline void TaskGroup::Sync() {
-    for (int i = 0; i < nextTaskInfoIndex; ++i) {
+    for (int i = nSyncedTasks; i < nextTaskInfoIndex; ++i) {
         TaskInfo *ti = GetTaskInfo(i);
         ti->taskEvent.wait();
         ti->taskEvent.reset();
     }
+    nSyncedTasks = nextTaskInfoIndex;
 }
 
 #endif // ISPC_USE_CONCRT
@@ -715,6 +732,11 @@ static void InitTaskSystem() {
 }
 
 inline void TaskGroup::Launch(int baseCoord, int count) {
+    // An empty launch mustn't put the task group on the active list, since
+    // the workers expect it to have waiting tasks there.
+    if (count == 0)
+        return;
+
     //
     // Acquire mutex, add task
     //
@@ -1030,6 +1052,28 @@ void ISPCSync(void *h) {
     }
 }
 
+void ISPCLaunchAfter(void **taskGroupPtr, void *func, void *data, int count0, int count1, int count2,
+                     const int64_t *after, int numAfter) {
+    // The individual launches aren't tracked here, so wait for all of the
+    // tasks launched so far if there's anything to wait for.
+    TaskGroup *taskGroup = (TaskGroup *)(*taskGroupPtr);
+    if (taskGroup != NULL) {
+        for (int i = 0; i < numAfter; ++i) {
+            if (after[i] >= 0) {
+                taskGroup->Sync();
+                break;
+            }
+        }
+    }
+    ISPCLaunch(taskGroupPtr, func, data, count0, count1, count2);
+}
+
+// The scheduling hints are ignored here.
+void ISPCLaunchWithHints(void **taskGroupPtr, void *func, void *data, int count0, int count1, int count2,
+                         const int64_t *after, int numAfter, int, int, int) {
+    ISPCLaunchAfter(taskGroupPtr, func, data, count0, count1, count2, after, numAfter);
+}
+
 void *ISPCAlloc(void **taskGroupPtr, int64_t size, int32_t alignment) {
     TaskGroup *taskGroup;
     if (*taskGroupPtr == NULL) {
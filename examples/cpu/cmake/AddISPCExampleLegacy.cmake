@@ -42,7 +42,7 @@ function(add_ispc_example)
     set(ISPC_KNOWN_TARGETS "sse2" "sse4" "avx1-" "avx2" "avx512knl" "avx512skx" "neon")
     set(ISPC_HEADER_NAME "${CMAKE_CURRENT_BINARY_DIR}/${ISPC_SRC_NAME}_ispc.h")
     set(ISPC_OBJ_NAME "${CMAKE_CURRENT_BINARY_DIR}/${ISPC_SRC_NAME}.ispc${CMAKE_CXX_OUTPUT_EXTENSION}")
-    set(ISPC_FLAGS ${example_ISPC_FLAGS})
+    set(ISPC_FLAGS ${example_ISPC_FLAGS} ${ISPC_EXTRA_FLAGS})
     if (UNIX)
       list(APPEND ISPC_FLAGS --pic)
     endif()
@@ -0,0 +1,123 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/** @file bvh.h
+
+    @brief Host side of bvh.isph: construction of the wide BVH from the
+           binary BVH of the rt scene files
+
+    The collapse fills the WideBVHNode and reads the LinearBVHNode
+    structures of the header generated by ispc for rt.ispc, so this file must
+    be included after that header.  The width of the BVH is the one the ISPC
+    code was built with, i.e. the size of the arrays of WideBVHNode.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+namespace bvh {
+
+constexpr int Width = sizeof(ispc::WideBVHNode::child) / sizeof(int);
+
+inline float surfaceArea(const ispc::LinearBVHNode &node) {
+    float dx = node.bounds[1][0] - node.bounds[0][0];
+    float dy = node.bounds[1][1] - node.bounds[0][1];
+    float dz = node.bounds[1][2] - node.bounds[0][2];
+    return 2.f * (dx * dy + dy * dz + dz * dx);
+}
+
+// Add the wide node of the binary node index, and recursively the wide
+// nodes below it, return its index.  The children of a binary node are the
+// next node and the node of its offset.  The wide node takes the binary
+// ones below index that are opened in order of decreasing surface area,
+// as long as there are free slots.
+inline int collapse(const ispc::LinearBVHNode nodes[], int index, std::vector<ispc::WideBVHNode> &wide) {
+    std::vector<int> slots;
+    if (nodes[index].nPrimitives > 0)
+        slots.push_back(index);
+    else
+        slots = {index + 1, (int)nodes[index].offset};
+    while ((int)slots.size() < Width) {
+        int open = -1;
+        for (int i = 0; i < (int)slots.size(); i++) {
+            if (nodes[slots[i]].nPrimitives == 0 &&
+                (open < 0 || surfaceArea(nodes[slots[i]]) > surfaceArea(nodes[slots[open]])))
+                open = i;
+        }
+        if (open < 0)
+            break;
+        int node = slots[open];
+        slots[open] = node + 1;
+        slots.push_back(nodes[node].offset);
+    }
+
+    int w = (int)wide.size();
+    wide.emplace_back();
+    for (int i = 0; i < Width; i++) {
+        ispc::WideBVHNode &slot = wide[w];
+        if (i >= (int)slots.size()) {
+            for (int axis = 0; axis < 3; axis++)
+                slot.lower[axis][i] = slot.upper[axis][i] = 0.f;
+            slot.child[i] = -1;
+            slot.count[i] = 0;
+            continue;
+        }
+        const ispc::LinearBVHNode &node = nodes[slots[i]];
+        for (int axis = 0; axis < 3; axis++) {
+            slot.lower[axis][i] = node.bounds[0][axis];
+            slot.upper[axis][i] = node.bounds[1][axis];
+        }
+        slot.count[i] = node.nPrimitives;
+        slot.child[i] = (int)node.offset;
+        if (node.nPrimitives == 0) {
+            // wide is reallocated by the recursion
+            int child = collapse(nodes, slots[i], wide);
+            wide[w].child[i] = child;
+        }
+    }
+    return w;
+}
+
+// Number of nodes on the longest path from the root to a leaf.
+inline int depth(const std::vector<ispc::WideBVHNode> &wide, int index = 0) {
+    int d = 0;
+    for (int i = 0; i < Width; i++) {
+        if (wide[index].child[i] >= 0 && wide[index].count[i] == 0)
+            d = std::max(d, depth(wide, wide[index].child[i]));
+    }
+    return d + 1;
+}
+
+} // namespace bvh
@@ -46,9 +46,12 @@
 #include <stdio.h>
 #include <string.h>
 #include <sys/types.h>
+#include <vector>
 
 using namespace ispc;
 
+#include "bvh.h"
+
 typedef unsigned int uint;
 
 extern void raytrace_serial(int width, int height, int baseWidth, int baseHeight, const float raster2camera[4][4],
@@ -238,6 +241,55 @@ int main(int argc, char *argv[]) {
 
     writeImage(id, image, width, height, "rt-ispc-tasks.ppm");
 
+    //
+    // The ray stream traversal of the wide BVH, with ispc + 1 core and
+    // with ispc + tasks.  The hits must be the ones of the runs above, but
+    // for the triangles at the same distance.
+    //
+    std::vector<int> refId(id, id + width * height);
+    std::vector<WideBVHNode> wideNodes;
+    bvh::collapse(nodes, 0, wideNodes);
+    if (bvh::depth(wideNodes) * (bvh::Width - 1) + 1 > bvh_stack_size()) {
+        fprintf(stderr, "The %d-wide BVH is too deep for the stack of the stream traversal\n", bvh::Width);
+        return 1;
+    }
+    printf("%d-wide BVH of %d nodes, depth %d\n", bvh::Width, (int)wideNodes.size(), bvh::depth(wideNodes));
+
+    double minTimeStream = 1e30;
+    for (uint i = 0; i < test_iterations[0]; ++i) {
+        memset(id, 0, width * height * sizeof(int));
+        reset_and_start_timer();
+        raytrace_ispc_stream(width, height, baseWidth, baseHeight, raster2camera, camera2world, image, id,
+                             wideNodes.data(), triangles);
+        double dt = get_elapsed_mcycles();
+        printf("@time of ISPC stream run:\t\t\t[%.3f] million cycles\n", dt);
+        minTimeStream = std::min(dt, minTimeStream);
+    }
+    printf("[rt ispc stream, 1 core]:\t[%.3f] million cycles for %d x %d image\n", minTimeStream, width, height);
+
+    double minTimeStreamTasks = 1e30;
+    for (uint i = 0; i < test_iterations[1]; ++i) {
+        memset(id, 0, width * height * sizeof(int));
+        reset_and_start_timer();
+        raytrace_ispc_stream_tasks(width, height, baseWidth, baseHeight, raster2camera, camera2world, image, id,
+                                   wideNodes.data(), triangles);
+        double dt = get_elapsed_mcycles();
+        printf("@time of ISPC stream + TASKS run:\t\t\t[%.3f] million cycles\n", dt);
+        minTimeStreamTasks = std::min(dt, minTimeStreamTasks);
+    }
+    printf("[rt ispc stream + tasks]:\t[%.3f] million cycles for %d x %d image\n", minTimeStreamTasks, width,
+           height);
+    printf("\t\t\t\t(%.2fx speedup over ISPC, %.2fx speedup over ISPC + tasks)\n", minTimeISPC / minTimeStream,
+           minTimeISPCtasks / minTimeStreamTasks);
+
+    int mismatches = 0;
+    for (int i = 0; i < width * height; ++i)
+        mismatches += id[i] != refId[i];
+    if (mismatches > 0)
+        printf("%d pixels hit another triangle than with ISPC + tasks\n", mismatches);
+
+    writeImage(id, image, width, height, "rt-ispc-stream-tasks.ppm");
+
     memset(id, 0, width * height * sizeof(int));
     memset(image, 0, width * height * sizeof(float));
 
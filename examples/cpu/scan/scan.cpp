@@ -0,0 +1,169 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "../../common/timing.h"
+#include "scan_ispc.h"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace ispc;
+
+static void scan_serial(const int in[], int out[], int n) {
+    int sum = 0;
+    for (int i = 0; i < n; i++)
+        out[i] = sum += in[i];
+}
+
+static void segmented_scan_serial(const int in[], const bool flags[], int out[], int n) {
+    int sum = 0;
+    for (int i = 0; i < n; i++)
+        out[i] = sum = flags[i] ? in[i] : sum + in[i];
+}
+
+static int reduce_by_key_serial(const int keys[], const int values[], int n, int keys_out[], int values_out[]) {
+    int m = 0;
+    for (int i = 0; i < n; i++) {
+        if (i == 0 || keys[i] != keys[i - 1]) {
+            keys_out[m] = keys[i];
+            values_out[m++] = values[i];
+        } else {
+            values_out[m - 1] += values[i];
+        }
+    }
+    return m;
+}
+
+static int partition_serial(const int in[], const bool flags[], int out[], int n) {
+    int m = 0;
+    for (int i = 0; i < n; i++)
+        if (flags[i])
+            out[m++] = in[i];
+    int selected = m;
+    for (int i = 0; i < n; i++)
+        if (!flags[i])
+            out[m++] = in[i];
+    return selected;
+}
+
+static bool check(const char *what, const std::vector<int> &ref, const std::vector<int> &res, int n) {
+    for (int i = 0; i < n; i++) {
+        if (ref[i] != res[i]) {
+            printf("%s: mismatch at %d, expected %d, got %d\n", what, i, ref[i], res[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    int n = argc == 1 ? 10000000 : atoi(argv[1]);
+    std::vector<int> in(n), out(n), ref(n), keys(n), keysOut(n), keysRef(n);
+    bool *flags = new bool[n];
+
+    srand(0);
+    for (int i = 0; i < n; i++) {
+        in[i] = rand() % 16;
+        flags[i] = rand() % 100 == 0;
+        keys[i] = i == 0 ? 0 : keys[i - 1] + (rand() % 50 == 0);
+    }
+
+    bool ok = true;
+    scan_serial(in.data(), ref.data(), n);
+    for (int ntasks = 0; ntasks <= 1; ntasks++) {
+        scan_ispc(in.data(), out.data(), n, ntasks);
+        ok &= check("scan", ref, out, n);
+    }
+    segmented_scan_serial(in.data(), flags, ref.data(), n);
+    for (int ntasks = 0; ntasks <= 1; ntasks++) {
+        segmented_scan_ispc(in.data(), flags, out.data(), n, ntasks);
+        ok &= check("segmented scan", ref, out, n);
+    }
+    int m = reduce_by_key_serial(keys.data(), in.data(), n, keysRef.data(), ref.data());
+    for (int ntasks = 0; ntasks <= 1; ntasks++) {
+        int mi = reduce_by_key_ispc(keys.data(), in.data(), n, keysOut.data(), out.data(), ntasks);
+        if (mi != m) {
+            printf("reduce_by_key: expected %d segments, got %d\n", m, mi);
+            ok = false;
+            continue;
+        }
+        ok &= check("reduce_by_key keys", keysRef, keysOut, m);
+        ok &= check("reduce_by_key values", ref, out, m);
+    }
+    // The first part of the partition is the compacted stream.
+    m = partition_serial(in.data(), flags, ref.data(), n);
+    for (int ntasks = 0; ntasks <= 1; ntasks++) {
+        int mi = compact_ispc(in.data(), flags, out.data(), n, ntasks);
+        if (mi != m) {
+            printf("stream_compact: expected %d elements, got %d\n", m, mi);
+            ok = false;
+            continue;
+        }
+        ok &= check("stream_compact", ref, out, m);
+        mi = partition_ispc(in.data(), flags, out.data(), n, ntasks);
+        if (mi != m) {
+            printf("partition: expected %d selected elements, got %d\n", m, mi);
+            ok = false;
+            continue;
+        }
+        ok &= check("partition", ref, out, n);
+    }
+    if (!ok)
+        return 1;
+
+    // Report the minimum time of three runs of each inclusive scan.
+    double minSerial = 1e30, minISPC = 1e30, minTasks = 1e30;
+    for (int i = 0; i < 3; i++) {
+        reset_and_start_timer();
+        scan_serial(in.data(), out.data(), n);
+        minSerial = std::min(minSerial, get_elapsed_mcycles());
+
+        reset_and_start_timer();
+        scan_ispc(in.data(), out.data(), n, 1);
+        minISPC = std::min(minISPC, get_elapsed_mcycles());
+
+        reset_and_start_timer();
+        scan_ispc(in.data(), out.data(), n, 0);
+        minTasks = std::min(minTasks, get_elapsed_mcycles());
+    }
+
+    printf("[scan serial]:\t\t[%.3f] million cycles\n", minSerial);
+    printf("[scan ispc]:\t\t[%.3f] million cycles\n", minISPC);
+    printf("[scan ispc + tasks]:\t[%.3f] million cycles\n", minTasks);
+    printf("\t\t\t\t(%.2fx speedup from ISPC, %.2fx speedup from ISPC + tasks)\n", minSerial / minISPC,
+           minSerial / minTasks);
+
+    delete[] flags;
+    return 0;
+}
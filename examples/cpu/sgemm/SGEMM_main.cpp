@@ -55,9 +55,11 @@ M  |         |   X     N |         |   =     M |         |
 
 #include "../../common/timing.h"
 
+#include <algorithm>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <vector>
 
 // OS Independent millisec wall timers
 #ifdef _WIN32
@@ -186,6 +188,48 @@ void Test_SGEMM(SGEMMFuncPtr SGEMMFunc, char *pcFuncName, float matrixA[], float
     init_matrix(matrixC, M, K, 0.0f);
 }
 
+// Runs the double and half precision packed-panel GEMMs on the inputs of the other tests converted to their
+// types, and checks them with a tolerance relative to the CPU result of the inputs they actually got.
+void Test_DGEMM_HGEMM(float matrixA[], float matrixB[], unsigned int M, unsigned int N, unsigned int K,
+                      unsigned int numIterations) {
+    TIMER_DECLARE_AND_INIT();
+    float fFlopsPerGEMM = (float)(M * N * K) + (M * N * (K - 1));
+    std::vector<double> dA(matrixA, matrixA + M * N), dB(matrixB, matrixB + N * K), dC(M * K);
+    std::vector<unsigned short> hA(M * N), hB(N * K), hC(M * K);
+    std::vector<float> fA(M * N), fB(N * K), fC(M * K), valid(M * K);
+    GEMM_float_to_half(matrixA, hA.data(), M * N);
+    GEMM_float_to_half(matrixB, hB.data(), N * K);
+
+    auto report = [&](const char *name, double totalWallTime, std::vector<float> &result, float tolerance) {
+        float avgTime = (float)totalWallTime / (float)numIterations;
+        bool bValid = true;
+        for (unsigned int i = 0; i < M * K; i++)
+            bValid &= fabs(result[i] - valid[i]) <= tolerance * fmax(1.0f, fabs(valid[i]));
+        printf("%40s %10.4f millisecs %10.4f GFLOPs Validation: %s.\n", name, avgTime,
+               (fFlopsPerGEMM / (avgTime / 1000.0f)) / 1000000000.0f, (bValid ? "valid" : "ERROR"));
+    };
+
+    SGEMM_CPU_validation(matrixA, matrixB, valid.data(), M, N, K);
+    TIMER_RESET_AND_START();
+    for (unsigned int i = 0; i < numIterations; i++)
+        DGEMM_packed_withTasks(dA.data(), dB.data(), dC.data(), M, N, K);
+    double totalWallTime = TIMER_GET_ELAPSED_MSEC();
+    std::copy(dC.begin(), dC.end(), fC.begin());
+    report("DGEMM_packed_withTasks", totalWallTime, fC, 1e-5f);
+
+    // The reference is computed from the inputs rounded to half precision, and the result is rounded once per
+    // block of the inner dimension.
+    GEMM_half_to_float(hA.data(), fA.data(), M * N);
+    GEMM_half_to_float(hB.data(), fB.data(), N * K);
+    SGEMM_CPU_validation(fA.data(), fB.data(), valid.data(), M, N, K);
+    TIMER_RESET_AND_START();
+    for (unsigned int i = 0; i < numIterations; i++)
+        HGEMM_packed_withTasks(hA.data(), hB.data(), hC.data(), M, N, K);
+    totalWallTime = TIMER_GET_ELAPSED_MSEC();
+    GEMM_half_to_float(hC.data(), fC.data(), M * K);
+    report("HGEMM_packed_withTasks", totalWallTime, fC, 4e-3f);
+}
+
 int main(int argc, char **argv) {
     // Random number filled matrix test case:
 
@@ -299,6 +343,12 @@ int main(int argc, char **argv) {
                matrixA, matrixB, matrixC, M, N, K, tasks, ITERATIONS, matrixValid);
     Test_SGEMM((SGEMMFuncPtr)SGEMM_tileBlockNoSIMDIntrin_2_withTasks, (char *)"SGEMM_tileBlockNoSIMDIntrin_2_withTasks",
                matrixA, matrixB, matrixC, M, N, K, tasks, ITERATIONS, matrixValid);
+    Test_SGEMM((SGEMMFuncPtr)SGEMM_packed_withTasks, (char *)"SGEMM_packed_withTasks", matrixA, matrixB, matrixC, M, N,
+               K, tasks, ITERATIONS, matrixValid);
+    printf("\n");
+
+    // Other precisions of the packed-panel version:
+    Test_DGEMM_HGEMM(matrixA, matrixB, M, N, K, ITERATIONS);
 
     free(matrixA);
     free(matrixB);
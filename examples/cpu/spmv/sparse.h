@@ -0,0 +1,152 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/** @file sparse.h
+
+    @brief Host side of sparse.isph: CSR matrices and their conversion to
+           the ELL and SELL-C-sigma formats
+
+    The conversions fill the EllMatrix and SellMatrix structures of the
+    header generated by ispc for a file that includes sparse.isph, so this
+    file must be included after that header.  The chunk size must be the
+    gang width of the target the kernels run on, as returned by
+    sparse_chunk_size().
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+struct CsrMatrix {
+    int nrows = 0;
+    std::vector<int> rowptr{0}, col;
+    std::vector<float> val;
+
+    int rowLength(int row) const { return rowptr[row + 1] - rowptr[row]; }
+};
+
+// The padding entries repeat the last column of their row, so that the gathers of x stay in the cache lines of
+// the row, or use column 0 for empty rows.
+static inline int paddingColumn(const CsrMatrix &A, int row) {
+    return A.rowLength(row) > 0 ? A.col[A.rowptr[row + 1] - 1] : 0;
+}
+
+struct EllStorage {
+    std::vector<int> col;
+    std::vector<float> val;
+    ispc::EllMatrix matrix;
+
+    EllStorage(const CsrMatrix &A, int chunkSize) {
+        const int nrows_padded = (A.nrows + chunkSize - 1) / chunkSize * chunkSize;
+        int width = 0;
+        for (int row = 0; row < A.nrows; row++)
+            width = std::max(width, A.rowLength(row));
+        col.assign(static_cast<size_t>(width) * nrows_padded, 0);
+        val.assign(col.size(), 0.f);
+        for (int row = 0; row < A.nrows; row++) {
+            const int len = A.rowLength(row);
+            for (int j = 0; j < width; j++) {
+                const size_t idx = static_cast<size_t>(j) * nrows_padded + row;
+                col[idx] = j < len ? A.col[A.rowptr[row] + j] : paddingColumn(A, row);
+                val[idx] = j < len ? A.val[A.rowptr[row] + j] : 0.f;
+            }
+        }
+        matrix = {A.nrows, nrows_padded, width, col.data(), val.data()};
+    }
+
+    EllStorage(const EllStorage &) = delete;
+    EllStorage &operator=(const EllStorage &) = delete;
+
+    // Entries stored per nonzero, 1 without any padding
+    double fill(const CsrMatrix &A) const { return A.col.empty() ? 1. : double(col.size()) / A.col.size(); }
+};
+
+// 'sigma' is the number of rows sorted by length at a time, a multiple of the chunk size. The sort moves the long
+// rows of a window into the same chunks, which makes less padding the larger the windows are, while the rows of a
+// chunk come from a smaller part of the matrix, and read closer entries of x, the smaller the windows are.
+struct SellStorage {
+    std::vector<int> chunk_ptr, chunk_len, perm, col;
+    std::vector<float> val;
+    ispc::SellMatrix matrix;
+
+    SellStorage(const CsrMatrix &A, int chunkSize, int sigma) {
+        const int nchunks = (A.nrows + chunkSize - 1) / chunkSize;
+        perm.resize(static_cast<size_t>(nchunks) * chunkSize);
+        std::iota(perm.begin(), perm.end(), 0);
+        auto length = [&A](int row) { return row < A.nrows ? A.rowLength(row) : 0; };
+        for (size_t start = 0; start < perm.size(); start += sigma) {
+            const size_t end = std::min(perm.size(), start + sigma);
+            std::stable_sort(perm.begin() + start, perm.begin() + end,
+                             [&length](int a, int b) { return length(a) > length(b); });
+        }
+        // The padding rows of the last chunk are marked with nrows
+        for (auto &row : perm)
+            row = std::min(row, A.nrows);
+
+        chunk_ptr.resize(nchunks);
+        chunk_len.resize(nchunks);
+        int entries = 0;
+        for (int chunk = 0; chunk < nchunks; chunk++) {
+            int len = 0;
+            for (int lane = 0; lane < chunkSize; lane++)
+                len = std::max(len, length(perm[chunk * chunkSize + lane]));
+            chunk_ptr[chunk] = entries;
+            chunk_len[chunk] = len;
+            entries += len * chunkSize;
+        }
+        col.assign(entries, 0);
+        val.assign(entries, 0.f);
+        for (int chunk = 0; chunk < nchunks; chunk++) {
+            for (int lane = 0; lane < chunkSize; lane++) {
+                const int row = perm[chunk * chunkSize + lane];
+                if (row == A.nrows)
+                    continue;
+                const int len = A.rowLength(row);
+                for (int j = 0; j < chunk_len[chunk]; j++) {
+                    const int idx = chunk_ptr[chunk] + j * chunkSize + lane;
+                    col[idx] = j < len ? A.col[A.rowptr[row] + j] : paddingColumn(A, row);
+                    val[idx] = j < len ? A.val[A.rowptr[row] + j] : 0.f;
+                }
+            }
+        }
+        matrix = {A.nrows, nchunks, chunk_ptr.data(), chunk_len.data(), perm.data(), col.data(), val.data()};
+    }
+
+    SellStorage(const SellStorage &) = delete;
+    SellStorage &operator=(const SellStorage &) = delete;
+
+    // Entries stored per nonzero, 1 without any padding
+    double fill(const CsrMatrix &A) const { return A.col.empty() ? 1. : double(col.size()) / A.col.size(); }
+};
@@ -0,0 +1,137 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "../../common/timing.h"
+#include "spmv_ispc.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace ispc;
+
+#include "sparse.h"
+
+// Rows have 4 to 60 nonzeros clustered around the diagonal, like a FEM
+// matrix, and one row in a hundred has 20 times more, which is what the
+// padding of ELL is the most sensitive to.
+static void init(CsrMatrix &A, std::vector<float> &x, int nrows, int nvec) {
+    srand(0);
+    A.nrows = nrows;
+    for (int row = 0; row < nrows; row++) {
+        int len = std::min(nrows, (4 + rand() % 57) * (rand() % 100 == 0 ? 20 : 1));
+        int first = std::max(0, std::min(nrows - len, row - len / 2));
+        for (int j = 0; j < len; j++) {
+            A.col.push_back(first + j);
+            A.val.push_back((rand() % 100) / 50.f - 1.f);
+        }
+        A.rowptr.push_back(static_cast<int>(A.col.size()));
+    }
+    x.resize(static_cast<size_t>(nrows) * nvec);
+    for (auto &v : x)
+        v = (rand() % 100) / 100.f;
+}
+
+static void spmm_serial(const CsrMatrix &A, const float X[], float Y[], int nvec) {
+    for (int row = 0; row < A.nrows; row++) {
+        for (int v = 0; v < nvec; v++) {
+            float sum = 0.f;
+            for (int j = A.rowptr[row]; j < A.rowptr[row + 1]; j++)
+                sum += A.val[j] * X[A.col[j] * nvec + v];
+            Y[row * nvec + v] = sum;
+        }
+    }
+}
+
+static bool check(const char *what, const std::vector<float> &ref, const std::vector<float> &res) {
+    for (size_t i = 0; i < ref.size(); i++) {
+        if (std::abs(ref[i] - res[i]) > 1e-3f * std::max(1.f, std::abs(ref[i]))) {
+            printf("%s: mismatch at %zu, expected %f, got %f\n", what, i, ref[i], res[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+static double timeRun(const char *what, const std::function<void()> &run) {
+    double minTime = 1e30;
+    for (int i = 0; i < 5; i++) {
+        reset_and_start_timer();
+        run();
+        minTime = std::min(minTime, get_elapsed_mcycles());
+    }
+    printf("[%s]:\t[%.3f] million cycles\n", what, minTime);
+    return minTime;
+}
+
+int main(int argc, char *argv[]) {
+    const int nrows = argc == 1 ? 1 << 20 : atoi(argv[1]);
+    const int nvec = 4;
+    const int chunkSize = sparse_chunk_size();
+    CsrMatrix A;
+    std::vector<float> x, ref(nrows), y(nrows);
+    init(A, x, nrows, nvec);
+
+    EllStorage ell(A, chunkSize);
+    SellStorage sell(A, chunkSize, 32 * chunkSize);
+    printf("%d rows, %zu nonzeros, stored entries per nonzero: ELL %.2f, SELL-%d-%d %.2f\n", nrows, A.col.size(),
+           ell.fill(A), chunkSize, 32 * chunkSize, sell.fill(A));
+
+    // The vector is the first column of the row-major X
+    std::vector<float> x1(nrows);
+    for (int i = 0; i < nrows; i++)
+        x1[i] = x[static_cast<size_t>(i) * nvec];
+
+    bool ok = true;
+    double serial = timeRun("spmv serial", [&]() { spmm_serial(A, x1.data(), ref.data(), 1); });
+    double csr = timeRun("spmv csr ispc+tasks", [&]() {
+        spmv_csr_ispc(nrows, A.rowptr.data(), A.col.data(), A.val.data(), x1.data(), y.data());
+    });
+    ok &= check("spmv csr", ref, y);
+    double ellTime = timeRun("spmv ell ispc+tasks", [&]() { spmv_ell_ispc(&ell.matrix, x1.data(), y.data()); });
+    ok &= check("spmv ell", ref, y);
+    double sellTime = timeRun("spmv sell ispc+tasks", [&]() { spmv_sell_ispc(&sell.matrix, x1.data(), y.data()); });
+    ok &= check("spmv sell", ref, y);
+    printf("\t\t\t\t(%.2fx csr, %.2fx ell, %.2fx sell speedup from ISPC + tasks)\n", serial / csr, serial / ellTime,
+           serial / sellTime);
+
+    std::vector<float> refY(static_cast<size_t>(nrows) * nvec), Y(refY.size());
+    serial = timeRun("spmm serial", [&]() { spmm_serial(A, x.data(), refY.data(), nvec); });
+    sellTime = timeRun("spmm sell ispc+tasks", [&]() { spmm_sell_ispc(&sell.matrix, x.data(), Y.data(), nvec); });
+    ok &= check("spmm sell", refY, Y);
+    printf("\t\t\t\t(%.2fx speedup from ISPC + tasks)\n", serial / sellTime);
+
+    return ok ? 0 : 1;
+}
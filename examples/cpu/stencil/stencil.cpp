@@ -50,6 +50,13 @@ using namespace ispc;
 extern void loop_stencil_serial(int t0, int t1, int x0, int x1, int y0, int y1, int z0, int z1, int Nx, int Ny, int Nz,
                                 const float coef[5], const float vsq[], float Aeven[], float Aodd[]);
 
+static int CheckData(int Nx, int Ny, int Nz, const float *Aref, const float *A) {
+    int errors = 0;
+    for (int offset = 0; offset < Nx * Ny * Nz; ++offset)
+        errors += fabsf((Aref[offset] - A[offset]) / Aref[offset]) > 1e-4;
+    return errors;
+}
+
 void InitData(int Nx, int Ny, int Nz, float *A[2], float *vsq) {
     int offset = 0;
     for (int z = 0; z < Nz; ++z)
@@ -145,6 +152,38 @@ int main(int argc, char *argv[]) {
     printf("\t\t\t\t(%.2fx speedup from ISPC, %.2fx speedup from ISPC + tasks)\n", minTimeSerial / minTimeISPC,
            minTimeSerial / minTimeISPCTasks);
 
+    //
+    // The stencil engine versions, which must give the results of the
+    // serial implementation after the same number of runs.
+    //
+    int timeBlock = 4;
+    float *Aengine[2] = {new float[Nx * Ny * Nz], new float[Nx * Ny * Nz]};
+    for (int version = 0; version < 2; ++version) {
+        InitData(Nx, Ny, Nz, Aengine, vsq);
+        double minTime = 1e30;
+        for (unsigned int i = 0; i < test_iterations[1]; ++i) {
+            reset_and_start_timer();
+            if (version == 0)
+                loop_stencil_ispc_blocked(0, 6, width, Nx - width, width, Ny - width, width, Nz - width, Nx, Ny, Nz,
+                                          coeff, vsq, Aengine[0], Aengine[1]);
+            else
+                loop_stencil_ispc_wavefront(0, 6, width, Nx - width, width, Ny - width, width, Nz - width, Nx, Ny,
+                                            Nz, coeff, vsq, Aengine[0], Aengine[1], timeBlock);
+            double dt = get_elapsed_mcycles();
+            minTime = std::min(minTime, dt);
+        }
+        if (version == 0)
+            printf("[stencil ispc blocked 1 core]:\t[%.3f] million cycles (%.2fx speedup from ISPC)\n", minTime,
+                   minTimeISPC / minTime);
+        else
+            printf("[stencil ispc wavefront + tasks, %d steps per wave]:\t[%.3f] million cycles (%.2fx speedup "
+                   "from ISPC + tasks)\n",
+                   timeBlock, minTime, minTimeISPCTasks / minTime);
+        int errors = CheckData(Nx, Ny, Nz, Aserial[1], Aengine[1]);
+        if (errors > 0)
+            printf("%d errors of the %s version\n", errors, version == 0 ? "blocked" : "wavefront");
+    }
+
     // Check for agreement
     int offset = 0;
     for (int z = 0; z < Nz; ++z)
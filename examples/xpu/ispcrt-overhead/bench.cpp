@@ -0,0 +1,145 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Google Benchmark
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#include "overhead.hpp"
+
+// Overhead of ISPC Run Time API calls on every available device. Results can be exported for tracking with
+// --benchmark_out=<file> --benchmark_out_format=json. Allocations are measured with the memory pools of the
+// runtime (default) and without them (ISPCRT_MEM_POOL=0) on GPU, using a separate device object for each.
+
+static void launch(benchmark::State &state, OverheadApp *app) {
+    size_t tasks = state.range(0);
+    for (auto _ : state) {
+        app->launch(tasks);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void launch_with_copies(benchmark::State &state, OverheadApp *app) {
+    for (auto _ : state) {
+        app->launchWithCopies();
+    }
+    if (!app->validate()) {
+        state.SkipWithError("Validation failed");
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void allocate(benchmark::State &state, OverheadApp *app, bool shared) {
+    size_t bytes = state.range(0);
+    for (auto _ : state) {
+        app->allocate(bytes, shared);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void copy_to_device(benchmark::State &state, OverheadApp *app) {
+    size_t bytes = state.range(0);
+    app->copyToDevice(bytes);
+    for (auto _ : state) {
+        app->copyToDevice(bytes);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * bytes);
+}
+
+static void copy_to_host(benchmark::State &state, OverheadApp *app) {
+    size_t bytes = state.range(0);
+    app->copyToHost(bytes);
+    for (auto _ : state) {
+        app->copyToHost(bytes);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * bytes);
+}
+
+static void load_module(benchmark::State &state, OverheadApp *app) {
+    for (auto _ : state) {
+        app->loadModule();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+int main(int argc, char **argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+
+    // The memory pool setting is read when a device is created
+    std::unique_ptr<OverheadApp> apps[2][2];
+    for (ISPCRTDeviceType type : {ISPCRT_DEVICE_TYPE_CPU, ISPCRT_DEVICE_TYPE_GPU}) {
+        if (!OverheadApp::hasDevice(type)) {
+            continue;
+        }
+        const int t = type == ISPCRT_DEVICE_TYPE_GPU;
+        const std::string dev = deviceName(type);
+        // Memory pools are implemented only for GPU
+        const int pools = t ? 2 : 1;
+        apps[t][0].reset(new OverheadApp(type));
+        if (pools > 1) {
+            setenv("ISPCRT_MEM_POOL", "0", 1);
+            apps[t][1].reset(new OverheadApp(type));
+            unsetenv("ISPCRT_MEM_POOL");
+        }
+
+        OverheadApp *app = apps[t][0].get();
+        benchmark::RegisterBenchmark(("launch/" + dev).c_str(), launch, app)->Arg(1)->Arg(64)->Arg(1024);
+        benchmark::RegisterBenchmark(("launch_with_copies/" + dev).c_str(), launch_with_copies, app);
+        benchmark::RegisterBenchmark(("load_module/" + dev).c_str(), load_module, app)->Unit(benchmark::kMillisecond);
+        for (int pool = 0; pool < pools; pool++) {
+            const std::string suffix = dev + (pools == 1 ? "" : pool == 0 ? "/pool" : "/no_pool");
+            OverheadApp *a = apps[t][pool].get();
+            benchmark::RegisterBenchmark(("alloc_device/" + suffix).c_str(), allocate, a, false)
+                ->RangeMultiplier(16)
+                ->Range(64, 1 << 22);
+            benchmark::RegisterBenchmark(("alloc_shared/" + suffix).c_str(), allocate, a, true)
+                ->RangeMultiplier(16)
+                ->Range(64, 1 << 22);
+        }
+        benchmark::RegisterBenchmark(("copy_to_device/" + dev).c_str(), copy_to_device, app)
+            ->RangeMultiplier(8)
+            ->Range(1 << 10, 1 << 28);
+        benchmark::RegisterBenchmark(("copy_to_host/" + dev).c_str(), copy_to_host, app)
+            ->RangeMultiplier(8)
+            ->Range(1 << 10, 1 << 28);
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
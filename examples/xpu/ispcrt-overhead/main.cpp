@@ -0,0 +1,112 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "overhead.hpp"
+
+// Average time of 'iterations' calls of 'op' in microseconds, after one untimed call
+static double measure(unsigned iterations, const std::function<void()> &op) {
+    op();
+    auto start = std::chrono::high_resolution_clock::now();
+    for (unsigned i = 0; i < iterations; i++) {
+        op();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / iterations;
+}
+
+static int run(ISPCRTDeviceType type, unsigned iterations) {
+    OverheadApp app(type);
+
+    std::cout << "Executed on: " << deviceName(type) << '\n' << std::fixed << std::setprecision(3);
+    std::cout << "launch, 1 task:           " << measure(iterations, [&] { app.launch(1); }) << " us\n";
+    std::cout << "launch, 1024 tasks:       " << measure(iterations, [&] { app.launch(1024); }) << " us\n";
+    std::cout << "launch with copies:       " << measure(iterations, [&] { app.launchWithCopies(); }) << " us\n";
+    std::cout << "module load:              " << measure(iterations, [&] { app.loadModule(); }) << " us\n";
+    for (size_t bytes : {size_t(64), size_t(1) << 16, size_t(1) << 22}) {
+        std::cout << "allocate " << std::setw(8) << bytes << " B, device: "
+                  << measure(iterations, [&] { app.allocate(bytes, false); }) << " us\n";
+        std::cout << "allocate " << std::setw(8) << bytes << " B, shared: "
+                  << measure(iterations, [&] { app.allocate(bytes, true); }) << " us\n";
+    }
+    for (size_t bytes : {size_t(1) << 12, size_t(1) << 20, size_t(1) << 26}) {
+        double to = measure(iterations, [&] { app.copyToDevice(bytes); });
+        double from = measure(iterations, [&] { app.copyToHost(bytes); });
+        std::cout << "copy " << std::setw(8) << bytes << " B to device: " << bytes / to * 1e-3 << " GB/s, to host: "
+                  << bytes / from * 1e-3 << " GB/s\n";
+    }
+
+    if (!app.validate()) {
+        std::cout << "Validation failed\n";
+        return -1;
+    }
+    return 0;
+}
+
+void usage(const char *p) {
+    std::cout << "Usage:\n";
+    std::cout << p << " [--cpu | --gpu] [iterations] | -h\n";
+    std::cout << "Set ISPCRT_MEM_POOL=0 to measure the allocations without memory pools.\n";
+    std::cout << "Use bench-ispcrt-overhead for detailed measurements in JSON format.\n";
+}
+
+int main(int argc, char *argv[]) {
+    std::ios_base::fmtflags f(std::cout.flags());
+
+    ISPCRTDeviceType device_type = ISPCRT_DEVICE_TYPE_AUTO;
+    unsigned iterations = 100;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--cpu") {
+            device_type = ISPCRT_DEVICE_TYPE_CPU;
+        } else if (arg == "--gpu") {
+            device_type = ISPCRT_DEVICE_TYPE_GPU;
+        } else if (arg != "-h" && std::atoi(argv[i]) > 0) {
+            iterations = std::atoi(argv[i]);
+        } else {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    int success = run(device_type, iterations);
+    std::cout.flags(f);
+    return success;
+}
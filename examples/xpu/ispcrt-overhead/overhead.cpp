@@ -0,0 +1,125 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "overhead.hpp"
+
+#include <stdexcept>
+
+static const char *MODULE_NAME = "xe_ispcrt-overhead";
+
+OverheadApp::OverheadApp(ISPCRTDeviceType type)
+    : m_device(type), m_queue(m_device), m_module(m_device, MODULE_NAME), m_empty(m_device, m_module, "empty_ispc"),
+      m_touch(m_device, m_module, "touch_ispc"), m_touchBuf(1, 0.0f), m_touchView(m_device, m_touchBuf) {
+    m_p.buf = m_touchView.devicePtr();
+    m_p.count = 1;
+    m_params = ispcrt::Array<Parameters>(m_device, m_p);
+    m_queue.copyToDevice(m_params);
+    m_queue.copyToDevice(m_touchView);
+    m_queue.sync();
+}
+
+void OverheadApp::launch(size_t tasks) {
+    m_queue.launch(m_empty, tasks);
+    m_queue.sync();
+}
+
+void OverheadApp::launchWithCopies() {
+    m_queue.copyToDevice(m_touchView);
+    m_queue.launch(m_touch, m_params, 1);
+    m_queue.copyToHost(m_touchView);
+    m_queue.sync();
+    m_touchLaunches++;
+}
+
+bool OverheadApp::validate() {
+    // Every launch increments the value copied to the device and the result is copied back
+    bool valid = m_touchBuf[0] == static_cast<float>(m_touchLaunches);
+    m_touchBuf[0] = 0.0f;
+    m_touchLaunches = 0;
+    return valid;
+}
+
+void OverheadApp::allocate(size_t bytes, bool shared) {
+    if (shared) {
+        ispcrt::Array<uint8_t, ispcrt::AllocType::Shared> view(m_device, bytes);
+        if (view.sharedPtr() == nullptr) {
+            throw std::runtime_error("Failed to allocate shared memory");
+        }
+    } else {
+        // Device memory is allocated at the first use of the device pointer, the host memory is reused
+        if (m_allocBuf.size() < bytes) {
+            m_allocBuf.resize(bytes);
+        }
+        ispcrt::Array<uint8_t> view(m_device, m_allocBuf.data(), bytes);
+        if (view.devicePtr() == nullptr) {
+            throw std::runtime_error("Failed to allocate device memory");
+        }
+    }
+}
+
+void OverheadApp::resize(size_t bytes) {
+    if (m_copyBuf.size() != bytes) {
+        m_copyBuf.assign(bytes, 1);
+        m_copyView = ispcrt::Array<uint8_t>(m_device, m_copyBuf);
+    }
+}
+
+void OverheadApp::copyToDevice(size_t bytes) {
+    resize(bytes);
+    m_queue.copyToDevice(m_copyView);
+    m_queue.sync();
+}
+
+void OverheadApp::copyToHost(size_t bytes) {
+    resize(bytes);
+    m_queue.copyToHost(m_copyView);
+    m_queue.sync();
+}
+
+void OverheadApp::loadModule() {
+    ispcrt::Module module(m_device, MODULE_NAME);
+    ispcrt::Kernel kernel(m_device, module, "empty_ispc");
+}
+
+bool OverheadApp::hasDevice(ISPCRTDeviceType type) { return ispcrt::Device::deviceCount(type) > 0; }
+
+const char *deviceName(ISPCRTDeviceType type) {
+    switch (type) {
+    case ISPCRT_DEVICE_TYPE_GPU:
+        return "gpu";
+    case ISPCRT_DEVICE_TYPE_CPU:
+        return "cpu";
+    default:
+        return "auto";
+    }
+}
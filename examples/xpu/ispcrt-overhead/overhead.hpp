@@ -0,0 +1,92 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// ispcrt
+#include "ispcrt.hpp"
+
+// Parameters of touch_ispc(), see overhead.ispc
+struct Parameters {
+    float *buf;
+    int count;
+};
+
+// Runtime objects of one device and the operations whose overhead is measured. Every operation is synchronous: it
+// returns when the device has completed it, so timing a call measures its full round-trip.
+class OverheadApp {
+  public:
+    explicit OverheadApp(ISPCRTDeviceType type);
+
+    // Launch 'tasks' tasks of an empty kernel and wait for them
+    void launch(size_t tasks);
+    // Launch a kernel that reads and writes its parameters, copied to the device before and back after the launch
+    void launchWithCopies();
+    // Allocate a memory view of 'bytes' bytes in device or shared memory, and release it
+    void allocate(size_t bytes, bool shared);
+    // Copy a buffer of 'bytes' bytes to or from the device, the buffer is reallocated when the size changes
+    void copyToDevice(size_t bytes);
+    void copyToHost(size_t bytes);
+    // Load the module of the kernels and create one of its kernels
+    void loadModule();
+
+    // Check the result of the launches done by launchWithCopies() and reset it
+    bool validate();
+
+    static bool hasDevice(ISPCRTDeviceType type);
+
+  private:
+    void resize(size_t bytes);
+
+    ispcrt::Device m_device;
+    ispcrt::TaskQueue m_queue;
+    ispcrt::Module m_module;
+    ispcrt::Kernel m_empty;
+    ispcrt::Kernel m_touch;
+
+    std::vector<uint8_t> m_copyBuf;
+    ispcrt::Array<uint8_t> m_copyView;
+
+    std::vector<float> m_touchBuf;
+    ispcrt::Array<float> m_touchView;
+    Parameters m_p;
+    ispcrt::Array<Parameters> m_params;
+
+    std::vector<uint8_t> m_allocBuf;
+    int m_touchLaunches{0};
+};
+
+const char *deviceName(ISPCRTDeviceType type);
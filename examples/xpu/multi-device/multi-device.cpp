@@ -0,0 +1,146 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// ispcrt
+#include "ispcrt.hpp"
+
+struct Parameters {
+    float *x;
+    float *y;
+    float a;
+    int count;
+};
+
+#define EPSILON 0.01f
+bool validate_result(const std::vector<float> &vout, const std::vector<float> &vgold) {
+    bool bValid = true;
+    for (unsigned int i = 0; i < vout.size(); i++) {
+        float delta = (float)fabs(vgold[i] - vout[i]);
+        if (delta > EPSILON) {
+            std::cout << "Validation failed on i=" << i << ": vout[i] = " << vout[i] << ", but " << vgold[i]
+                      << " was expected\n";
+            bValid = false;
+        }
+    }
+    return bValid;
+}
+
+static int run(const ISPCRTDeviceType device_type, const unsigned int SIZE, const unsigned int TASKS) {
+    const float a = 2.0f;
+    std::vector<float> x(SIZE);
+    std::vector<float> y(SIZE);
+    std::vector<float> vgold(SIZE);
+    std::generate(x.begin(), x.end(), [i = 0]() mutable { return i++; });
+    std::fill(y.begin(), y.end(), 1.0f);
+
+    // Calculate gold result
+    for (unsigned int i = 0; i < SIZE; i++) {
+        vgold[i] = a * x[i] + y[i];
+    }
+
+    // All devices of the system run their part of the work
+    ispcrt::DeviceGroup group(device_type);
+    std::cout << "Running on " << group.size() << " device(s)\n";
+    auto kernels = group.newKernels("xe_multi-device", "saxpy");
+
+    // Every device gets its part of the arrays and the parameters describing it
+    auto x_dev = group.scatter(x.data(), SIZE);
+    auto y_dev = group.scatter(y.data(), SIZE);
+    auto parts = group.partition(SIZE);
+    std::vector<ispcrt::Array<Parameters, ispcrt::AllocType::Shared>> params;
+    for (size_t i = 0; i < group.size(); i++) {
+        params.emplace_back(group.device(i));
+        auto p = params[i].sharedPtr();
+        p->x = x_dev[i].devicePtr();
+        p->y = y_dev[i].devicePtr();
+        p->a = a;
+        p->count = parts[i].count;
+    }
+
+    group.copyToDevice(x_dev);
+    group.copyToDevice(y_dev);
+    // The grid of tasks is split between the devices as the arrays are
+    auto futures = group.launch(kernels, params, 0, TASKS);
+    group.copyToHost(y_dev);
+    group.sync();
+
+    for (size_t i = 0; i < futures.size(); i++) {
+        if (futures[i].valid()) {
+            std::cout << "Device " << i << ": " << parts[i].count << " elements in " << futures[i].time() * 1e-3
+                      << " us\n";
+        }
+    }
+
+    if (validate_result(y, vgold)) {
+        std::cout << "Validation passed!\n";
+        return 0;
+    }
+    return -1;
+}
+
+void usage(const char *p) {
+    std::cout << "Usage:\n";
+    std::cout << p << " --cpu | --gpu | -h\n";
+}
+
+int main(int argc, char *argv[]) {
+    constexpr unsigned int SIZE = 1024 * 1024;
+    constexpr unsigned int TASKS = 256;
+
+    // Device group needs to know the type of all its devices
+    ISPCRTDeviceType device_type = ISPCRT_DEVICE_TYPE_GPU;
+
+    if (argc > 2 || (argc == 2 && std::string(argv[1]) == "-h")) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    if (argc == 2) {
+        std::string dev_param = argv[1];
+        if (dev_param == "--cpu") {
+            device_type = ISPCRT_DEVICE_TYPE_CPU;
+        } else if (dev_param == "--gpu") {
+            device_type = ISPCRT_DEVICE_TYPE_GPU;
+        } else {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    return run(device_type, SIZE, TASKS);
+}
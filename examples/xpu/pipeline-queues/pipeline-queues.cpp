@@ -0,0 +1,155 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// ispcrt
+#include "ispcrt.hpp"
+
+struct Parameters {
+    float *data;
+    int count;
+};
+
+void pipeline_CPU_validation(const std::vector<float> &vin, std::vector<float> &vgold) {
+    for (unsigned int i = 0; i < vin.size(); i++) {
+        vgold[i] = (vin[i] + 1.0f) * 2.0f - 0.5f;
+    }
+}
+
+#define EPSILON 0.01f
+bool validate_result(const std::vector<float> &vout, const std::vector<float> &vgold) {
+    bool bValid = true;
+    for (unsigned int i = 0; i < vout.size(); i++) {
+        float delta = (float)fabs(vgold[i] - vout[i]);
+        if (delta > EPSILON) {
+            std::cout << "Validation failed on i=" << i << ": vout[i] = " << vout[i] << ", but " << vgold[i]
+                      << " was expected\n";
+            bValid = false;
+        }
+    }
+    return bValid;
+}
+
+static int run(const ISPCRTDeviceType device_type, const unsigned int CHUNKS, const unsigned int CHUNK_SIZE) {
+    std::vector<float> data(CHUNKS * CHUNK_SIZE);
+    std::vector<float> vgold(CHUNKS * CHUNK_SIZE);
+    std::generate(data.begin(), data.end(), [i = 0]() mutable { return i++; });
+
+    // Calculate gold result
+    pipeline_CPU_validation(data, vgold);
+
+    ispcrt::Device device(device_type);
+
+    // Create module and kernel to execute
+    ispcrt::Module module(device, "xe_pipeline-queues");
+    ispcrt::Kernel kernel(device, module, "pipeline_stage");
+
+    // Every chunk of the data has its own device memory and parameters
+    std::vector<ispcrt::Array<float>> chunks;
+    std::vector<Parameters> params(CHUNKS);
+    std::vector<ispcrt::Array<Parameters>> params_dev;
+    for (unsigned int i = 0; i < CHUNKS; i++) {
+        chunks.emplace_back(device, data.data() + i * CHUNK_SIZE, CHUNK_SIZE);
+        params[i].data = chunks[i].devicePtr();
+        params[i].count = CHUNK_SIZE;
+        params_dev.emplace_back(device, params[i]);
+    }
+
+    // Each stage of the pipeline has its own task queue, so copies of one chunk to the device and to the host
+    // run on copy engines while the kernel processes another chunk. A stage waits only on the future of the
+    // previous stage for the same chunk.
+    ispcrt::TaskQueue upload(device);
+    ispcrt::TaskQueue compute(device);
+    ispcrt::TaskQueue download(device);
+
+    for (unsigned int i = 0; i < CHUNKS; i++) {
+        upload.copyToDevice(params_dev[i]);
+        upload.copyToDevice(chunks[i]);
+        auto uploaded = upload.signal();
+        upload.submit();
+
+        compute.wait(uploaded);
+        auto computed = compute.launch(kernel, params_dev[i], 1);
+        compute.submit();
+
+        download.wait(computed);
+        download.copyToHost(chunks[i]);
+        download.submit();
+    }
+
+    // Task queues are synchronized after the task queues waiting on their futures
+    download.sync();
+    compute.sync();
+    upload.sync();
+
+    if (validate_result(data, vgold)) {
+        std::cout << "Validation passed!\n";
+        return 0;
+    }
+    return -1;
+}
+
+void usage(const char *p) {
+    std::cout << "Usage:\n";
+    std::cout << p << " --cpu | --gpu | -h\n";
+}
+
+int main(int argc, char *argv[]) {
+    constexpr unsigned int CHUNKS = 8;
+    constexpr unsigned int CHUNK_SIZE = 1024;
+
+    ISPCRTDeviceType device_type = ISPCRT_DEVICE_TYPE_AUTO;
+
+    if (argc > 2 || (argc == 2 && std::string(argv[1]) == "-h")) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    if (argc == 2) {
+        std::string dev_param = argv[1];
+        if (dev_param == "--cpu") {
+            device_type = ISPCRT_DEVICE_TYPE_CPU;
+        } else if (dev_param == "--gpu") {
+            device_type = ISPCRT_DEVICE_TYPE_GPU;
+        } else {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    return run(device_type, CHUNKS, CHUNK_SIZE);
+}
@@ -20,15 +20,25 @@ struct Device : public RefCounted {
 
     virtual MemoryView *newMemoryView(void *appMemory, size_t numBytes, const ISPCRTNewMemoryViewFlags *flags) const = 0;
 
+    // Wrap memory allocated outside of ISPCRT without copying or owning it
+    virtual MemoryView *importMemoryView(void *memBuffer, size_t numBytes) const = 0;
+    virtual MemoryView *importDmaBufMemoryView(int fd, size_t numBytes) const = 0;
+
     virtual TaskQueue *newTaskQueue() const = 0;
 
     virtual Module *newModule(const char *moduleFile, const ISPCRTModuleOptions &opts) const = 0;
+    virtual Module *newModuleFromMemory(const void *image, size_t size, ISPCRTModuleImageFormat format,
+                                        const ISPCRTModuleOptions &opts) const = 0;
 
     virtual void dynamicLinkModules(Module **modules, uint32_t numModules) const = 0;
     virtual Module* staticLinkModules(Module **modules, uint32_t numModules) const = 0;
 
     virtual Kernel *newKernel(const Module &module, const char *name) const = 0;
 
+    // Sub-devices (tiles) of the device
+    virtual uint32_t subDeviceCount() const = 0;
+    virtual Device *subDevice(uint32_t subDeviceIdx) const = 0;
+
     virtual void *platformNativeHandle() const = 0;
     virtual void *deviceNativeHandle() const = 0;
     virtual void *contextNativeHandle() const = 0;
@@ -7,6 +7,11 @@
 #include "../ispcrt.h"
 // internal
 #include "IntrusivePtr.h"
+// std
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
 
 namespace ispcrt {
 namespace base {
@@ -17,6 +22,57 @@ struct Future : public RefCounted {
 
     virtual uint64_t time() = 0;
     virtual bool valid() = 0;
+    // Timestamps of the command, false if they were not recorded
+    virtual bool timestamps(ISPCRTFutureTimestamps &ts) = 0;
+};
+
+// Memory of the deleted futures of one type, reused for the new ones. A future is allocated for every command
+// of a task queue and deleted once it's synchronized and released by the application, so that a queue running
+// many launches doesn't go through the heap allocator for each of them. At most MaxFree blocks are kept.
+template <typename T> struct FuturePool {
+    static constexpr size_t MaxFree = 4096;
+
+    static void *allocate(size_t size) {
+        if (size == sizeof(T)) {
+            std::lock_guard<std::mutex> lock(mutex());
+            auto &blocks = free();
+            if (!blocks.empty()) {
+                void *p = blocks.back();
+                blocks.pop_back();
+                return p;
+            }
+        }
+        return ::operator new(size);
+    }
+
+    static void release(void *p, size_t size) noexcept {
+        if (p == nullptr)
+            return;
+        if (size == sizeof(T)) {
+            std::lock_guard<std::mutex> lock(mutex());
+            auto &blocks = free();
+            if (blocks.size() < MaxFree) {
+                try {
+                    blocks.push_back(p);
+                    return;
+                } catch (...) {
+                }
+            }
+        }
+        ::operator delete(p);
+    }
+
+  private:
+    // Leaked, so that futures released by static objects at exit still find the pool
+    static std::mutex &mutex() {
+        static auto *m = new std::mutex;
+        return *m;
+    }
+
+    static std::vector<void *> &free() {
+        static auto *blocks = new std::vector<void *>;
+        return *blocks;
+    }
 };
 
 } // namespace base
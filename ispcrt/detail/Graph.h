@@ -0,0 +1,20 @@
+// Copyright 2023 Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+// public
+#include "../ispcrt.h"
+// internal
+#include "IntrusivePtr.h"
+
+namespace ispcrt {
+namespace base {
+
+struct Graph : public RefCounted {
+    Graph() = default;
+    virtual ~Graph() = default;
+};
+
+} // namespace base
+} // namespace ispcrt
@@ -21,9 +21,9 @@ class RefCounted {
     RefCounted &operator=(const RefCounted &) = delete;
     RefCounted &operator=(RefCounted &&) = delete;
 
-    void refInc() const;
-    void refDec() const;
-    long long useCount() const;
+    void refInc() const noexcept;
+    void refDec() const noexcept;
+    long long useCount() const noexcept;
 
   private:
     mutable std::atomic<long long> refCounter{1};
@@ -31,14 +31,19 @@ class RefCounted {
 
 // Inlined definitions //
 
-inline void RefCounted::refInc() const { refCounter++; }
+// A new reference is taken from an existing one, so incrementing needs no ordering. The last decrement
+// synchronizes with the earlier ones, so that the accesses through the other references happen before
+// the deletion.
+inline void RefCounted::refInc() const noexcept { refCounter.fetch_add(1, std::memory_order_relaxed); }
 
-inline void RefCounted::refDec() const {
-    if ((--refCounter) == 0)
+inline void RefCounted::refDec() const noexcept {
+    if (refCounter.fetch_sub(1, std::memory_order_release) == 1) {
+        std::atomic_thread_fence(std::memory_order_acquire);
         delete this;
+    }
 }
 
-inline long long RefCounted::useCount() const { return refCounter.load(); }
+inline long long RefCounted::useCount() const noexcept { return refCounter.load(std::memory_order_relaxed); }
 
 /////////////////////////////////////////////////////////////////////////////
 // Pointer to a RefCounted object ///////////////////////////////////////////
@@ -111,8 +116,12 @@ template <typename T> inline IntrusivePtr<T> &IntrusivePtr<T>::operator=(const I
 }
 
 template <typename T> inline IntrusivePtr<T> &IntrusivePtr<T>::operator=(IntrusivePtr &&input) {
-    ptr = input.ptr;
-    input.ptr = nullptr;
+    if (this != &input) {
+        if (ptr)
+            ptr->refDec();
+        ptr = input.ptr;
+        input.ptr = nullptr;
+    }
     return *this;
 }
 
@@ -0,0 +1,46 @@
+// Copyright 2023 Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+// Optional ITT API annotations (VTune, or any collector loaded through INTEL_LIBITTNOTIFY64), enabled with the
+// ISPCRT_BUILD_ITT CMake option. Without it the annotations compile to nothing.
+
+#ifdef ISPCRT_BUILD_ITT
+#include <ittnotify.h>
+
+namespace ispcrt {
+namespace itt {
+
+inline __itt_domain *domain() {
+    static __itt_domain *d = __itt_domain_create("ispcrt");
+    return d;
+}
+
+// String handles are interned by ITT, so creating one for an existing name returns the same handle.
+inline __itt_string_handle *name(const char *s) { return __itt_string_handle_create(s); }
+
+// Marks the lifetime of the object as a task of the ispcrt domain.
+class Task {
+  public:
+    explicit Task(__itt_string_handle *name) { __itt_task_begin(domain(), __itt_null, __itt_null, name); }
+    ~Task() { __itt_task_end(domain()); }
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+};
+
+} // namespace itt
+} // namespace ispcrt
+
+#define ISPCRT_ITT_CONCAT_(a, b) a##b
+#define ISPCRT_ITT_CONCAT(a, b) ISPCRT_ITT_CONCAT_(a, b)
+// Annotate the rest of the scope as a task with the given string handle
+#define ISPCRT_ITT_TASK(handle) ispcrt::itt::Task ISPCRT_ITT_CONCAT(ittTask, __LINE__)(handle)
+// Annotate the rest of the scope as a task with a constant name
+#define ISPCRT_ITT_TASK_NAMED(str)                                                                                     \
+    static __itt_string_handle *ISPCRT_ITT_CONCAT(ittName, __LINE__) = ispcrt::itt::name(str);                         \
+    ISPCRT_ITT_TASK(ISPCRT_ITT_CONCAT(ittName, __LINE__))
+#else
+#define ISPCRT_ITT_TASK(handle)
+#define ISPCRT_ITT_TASK_NAMED(str)
+#endif // ISPCRT_BUILD_ITT
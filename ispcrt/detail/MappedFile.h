@@ -0,0 +1,146 @@
+// Copyright 2023 Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+// internal
+#include "Device.h"
+#include "Exception.h"
+#include "MemoryView.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+#include "windows.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+// std
+#include <cstdint>
+#include <string>
+
+namespace ispcrt {
+namespace base {
+
+// Private mapping of the [offset, offset + numBytes) range of a file, or of the
+// rest of the file from offset when numBytes is 0. The pages are copied on
+// write, so the memory can be written (e.g. by kernels on CPU) without
+// changing the file. The pages are read ahead, as the file is expected to be
+// read sequentially.
+struct MappedFile {
+    MappedFile(const char *path, size_t offset, size_t numBytes) {
+        if (path == nullptr)
+            throw ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "No file to map!");
+#if defined(_WIN32) || defined(_WIN64)
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            throw ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, std::string("Failed to open ") + path);
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        const size_t granularity = info.dwAllocationGranularity;
+        m_size = range(path, offset, numBytes, (size_t)fileSize.QuadPart);
+        const uint64_t start = offset & ~(uint64_t)(granularity - 1);
+        m_delta = offset - start;
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (mapping == nullptr)
+            throw ispcrt_runtime_error(ISPCRT_OUT_OF_MEMORY, std::string("Failed to map ") + path);
+        m_base = MapViewOfFile(mapping, FILE_MAP_COPY, (DWORD)(start >> 32), (DWORD)start, m_delta + m_size);
+        CloseHandle(mapping);
+        if (m_base == nullptr)
+            throw ispcrt_runtime_error(ISPCRT_OUT_OF_MEMORY, std::string("Failed to map ") + path);
+#else
+        int fd = open(path, O_RDONLY);
+        if (fd < 0)
+            throw ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, std::string("Failed to open ") + path);
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            throw ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, std::string("Failed to open ") + path);
+        }
+        try {
+            m_size = range(path, offset, numBytes, (size_t)st.st_size);
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+        const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        const off_t start = (off_t)(offset & ~(page - 1));
+        m_delta = offset - (size_t)start;
+        m_base = mmap(nullptr, m_delta + m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, start);
+        close(fd);
+        if (m_base == MAP_FAILED) {
+            m_base = nullptr;
+            throw ispcrt_runtime_error(ISPCRT_OUT_OF_MEMORY, std::string("Failed to map ") + path);
+        }
+        madvise(m_base, m_delta + m_size, MADV_SEQUENTIAL);
+#endif
+    }
+
+    ~MappedFile() {
+        if (m_base == nullptr)
+            return;
+#if defined(_WIN32) || defined(_WIN64)
+        UnmapViewOfFile(m_base);
+#else
+        munmap(m_base, m_delta + m_size);
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    void *data() const { return static_cast<uint8_t *>(m_base) + m_delta; }
+
+    size_t size() const { return m_size; }
+
+  private:
+    static size_t range(const char *path, size_t offset, size_t numBytes, size_t fileSize) {
+        if (offset > fileSize || numBytes > fileSize - offset)
+            throw ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, std::string("Range is out of the bounds of ") + path);
+        size_t size = numBytes ? numBytes : fileSize - offset;
+        if (size == 0)
+            throw ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, std::string("Nothing to map in ") + path);
+        return size;
+    }
+
+    void *m_base{nullptr};
+    size_t m_delta{0};
+    size_t m_size{0};
+};
+
+// Device memory view whose host memory is a mapped file. On CPU the kernels
+// use the mapping itself, while on GPU it's copied to the device memory of the
+// view with copyToDevice().
+struct MappedFileMemoryView : public MemoryView {
+    MappedFileMemoryView(const Device &device, const char *path, size_t offset, size_t numBytes,
+                         const ISPCRTNewMemoryViewFlags *flags)
+        : m_file(path, offset, numBytes) {
+        m_view = device.newMemoryView(m_file.data(), m_file.size(), flags);
+    }
+
+    ~MappedFileMemoryView() {
+        if (m_view)
+            m_view->refDec();
+    }
+
+    bool isShared() { return m_view->isShared(); }
+
+    void *hostPtr() { return m_view->hostPtr(); }
+
+    void *devicePtr() { return m_view->devicePtr(); }
+
+    size_t numBytes() { return m_view->numBytes(); }
+
+  private:
+    // Declared first, so the mapping outlives the view using it
+    MappedFile m_file;
+    MemoryView *m_view{nullptr};
+};
+
+} // namespace base
+} // namespace ispcrt
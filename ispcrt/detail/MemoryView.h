@@ -3,8 +3,12 @@
 
 #pragma once
 
+#include "Exception.h"
 #include "IntrusivePtr.h"
 
+// std
+#include <cstdint>
+
 namespace ispcrt {
 namespace base {
 
@@ -20,5 +24,34 @@ struct MemoryView : public RefCounted {
     virtual size_t numBytes() = 0;
 };
 
+// A view of the [offset, offset + numBytes) range of another memory view. It
+// owns no memory, keeps the parent alive and can be passed anywhere the parent
+// could, so e.g. copying it to the device copies only this range.
+struct MemoryViewRange : public MemoryView {
+    MemoryViewRange(MemoryView &parent, size_t offset, size_t numBytes)
+        : m_parent(&parent), m_offset(offset), m_size(numBytes) {
+        if (offset > parent.numBytes() || numBytes > parent.numBytes() - offset)
+            throw ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "Memory view range is out of the parent bounds!");
+        m_parent->refInc();
+    }
+
+    ~MemoryViewRange() { m_parent->refDec(); }
+
+    bool isShared() { return m_parent->isShared(); }
+
+    void *hostPtr() { return offsetPtr(m_parent->hostPtr()); }
+
+    void *devicePtr() { return offsetPtr(m_parent->devicePtr()); }
+
+    size_t numBytes() { return m_size; }
+
+  private:
+    void *offsetPtr(void *p) const { return p ? static_cast<uint8_t *>(p) + m_offset : nullptr; }
+
+    MemoryView *m_parent{nullptr};
+    size_t m_offset{0};
+    size_t m_size{0};
+};
+
 } // namespace base
 } // namespace ispcrt
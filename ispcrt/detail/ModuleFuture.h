@@ -0,0 +1,82 @@
+// Copyright 2023 Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+// public
+#include "../ispcrt.h"
+// internal
+#include "Device.h"
+#include "Future.h"
+// std
+#include <chrono>
+#include <exception>
+#include <future>
+#include <string>
+
+namespace ispcrt {
+namespace base {
+
+// Future of a module which is loaded on a background thread. It is valid once
+// the module is loaded successfully, and its time is the time of the loading.
+struct ModuleFuture : public Future {
+    ModuleFuture(const Device &device, const char *moduleFile, const ISPCRTModuleOptions &opts)
+        : m_device(device), m_file(moduleFile) {
+        // The device must outlive the loading
+        m_device.refInc();
+        m_task = std::async(std::launch::async, [this, opts]() {
+            auto start = std::chrono::steady_clock::now();
+            try {
+                m_module = m_device.newModule(m_file.c_str(), opts);
+            } catch (...) {
+                m_error = std::current_exception();
+            }
+            m_time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start)
+                         .count();
+            m_device.refDec();
+        });
+    }
+
+    ~ModuleFuture() override {
+        m_task.wait();
+        if (m_module)
+            m_module->refDec();
+    }
+
+    uint64_t time() override { return wait() ? m_time : 0; }
+
+    bool valid() override {
+        return m_task.wait_for(std::chrono::seconds(0)) == std::future_status::ready && m_module != nullptr;
+    }
+
+    bool timestamps(ISPCRTFutureTimestamps &) override { return false; }
+
+    // Wait for the loading and return the module with a reference owned by the caller,
+    // the error of the loading is rethrown.
+    Module *module() {
+        if (!wait()) {
+            if (m_error)
+                std::rethrow_exception(m_error);
+            return nullptr;
+        }
+        m_module->refInc();
+        return m_module;
+    }
+
+  private:
+    bool wait() {
+        m_task.wait();
+        return m_module != nullptr;
+    }
+
+    const Device &m_device;
+    std::string m_file;
+    // Shared, so it can be waited for from several threads
+    std::shared_future<void> m_task;
+    Module *m_module{nullptr};
+    std::exception_ptr m_error;
+    uint64_t m_time{0};
+};
+
+} // namespace base
+} // namespace ispcrt
@@ -4,6 +4,7 @@
 #pragma once
 
 #include "Future.h"
+#include "Graph.h"
 #include "Kernel.h"
 #include "MemoryView.h"
 
@@ -21,10 +22,27 @@ struct TaskQueue : public RefCounted {
     virtual void copyMemoryView(base::MemoryView &mv_dst, base::MemoryView &mv_src, const size_t size) = 0;
 
     virtual base::Future *launch(Kernel &k, base::MemoryView *params, size_t dim0, size_t dim1, size_t dim2) = 0;
+    // The parameters are copied at the launch, so they don't need to outlive the call
+    virtual base::Future *launchInline(Kernel &k, const void *params, size_t size, size_t dim0, size_t dim1,
+                                       size_t dim2) = 0;
+    // 'count' launches of the kernel, each with 'size' bytes of 'params' and 3 values of 'dims', and one future
+    // completed when all of them completed
+    virtual base::Future *launchBatch(Kernel &k, const void *params, size_t size, const size_t *dims,
+                                      size_t count) = 0;
 
     virtual void submit() = 0;
     virtual void sync() = 0;
 
+    virtual base::Future *signal() = 0;
+    virtual void wait(base::Future &f) = 0;
+
+    virtual void beginCapture() = 0;
+    virtual base::Graph *endCapture() = 0;
+    virtual void replay(base::Graph &g) = 0;
+
+    virtual void setProfiling(bool enable) = 0;
+    virtual void writeTrace(const char *fileName) = 0;
+
     virtual void* taskQueueNativeHandle() const = 0;
 };
 
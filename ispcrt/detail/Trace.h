@@ -0,0 +1,205 @@
+// Copyright 2023 Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include "Exception.h"
+#include "Future.h"
+
+// std
+#include <atomic>
+#include <cstdarg>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ispcrt {
+namespace base {
+
+// Nanoseconds of the host clock the timestamps of futures are expressed in
+inline uint64_t profilingClockNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/* The trace of the whole process, which all task queues are profiled into
+   when the ISPCRT_TRACE environment variable is set to the name of the file
+   to write it to.  The task queues add the commands completed at each sync,
+   and the file is written when the process exits. */
+struct TraceFile {
+    // nullptr unless ISPCRT_TRACE is set
+    static TraceFile *instance() {
+        static TraceFile file(getenv("ISPCRT_TRACE"));
+        return file.m_fileName.empty() ? nullptr : &file;
+    }
+
+    void append(const std::string &events) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_events += events;
+    }
+
+    ~TraceFile() {
+        if (m_fileName.empty())
+            return;
+        FILE *file = fopen(m_fileName.c_str(), "w");
+        if (!file || fprintf(file, "{\"traceEvents\":[\n%s\n],\"displayTimeUnit\":\"ns\"}\n",
+                             m_events.empty() ? "" : m_events.c_str() + 2) < 0) {
+            fprintf(stderr, "[ISPCRT][WARNING] Could not write trace file %s\n", m_fileName.c_str());
+        }
+        if (file)
+            fclose(file);
+    }
+
+  private:
+    TraceFile(const char *fileName) : m_fileName(fileName ? fileName : "") {}
+
+    std::string m_fileName;
+    std::mutex m_mutex;
+    // Events, each one preceded by a separator
+    std::string m_events;
+};
+
+/* The kernel launches and copies of a profiled task queue, written in the
+   Chrome trace event format that chrome://tracing and Perfetto load.  Each
+   launch is a slice of the row of the task queue from its start to its end,
+   and the time it waited since it was enqueued is an asynchronous slice from
+   its submission to its start, so that the latency of a pipeline of launches
+   can be followed from the host to the device.  Copies are on a row of their
+   own, as they may run on a copy engine next to the launches. */
+struct Trace {
+    Trace(const char *deviceName) : m_id(nextId()), m_deviceName(deviceName) {}
+    ~Trace() { clear(); }
+
+    Trace(const Trace &) = delete;
+    Trace &operator=(const Trace &) = delete;
+
+    // The future is kept alive until the command is written or the trace is cleared
+    void add(const std::string &name, Future *future, bool copy = false) {
+        future->refInc();
+        m_commands.push_back({name, future, copy});
+    }
+
+    void clear() {
+        for (auto &command : m_commands)
+            command.future->refDec();
+        m_commands.clear();
+    }
+
+    // Write the completed commands and forget them, the others are kept for the next write.
+    void write(const char *fileName) {
+        if (!fileName)
+            throw ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "Trace file name is NULL!");
+        FILE *file = fopen(fileName, "w");
+        if (!file)
+            throw ispcrt_runtime_error(ISPCRT_UNKNOWN_ERROR, std::string("Could not open trace file ") + fileName);
+
+        std::string events = rowNames();
+        drain(events);
+        fprintf(file, "{\"traceEvents\":[\n%s\n],\"displayTimeUnit\":\"ns\"}\n", events.c_str() + 2);
+        const bool failed = ferror(file) != 0;
+        fclose(file);
+        if (failed)
+            throw ispcrt_runtime_error(ISPCRT_UNKNOWN_ERROR, std::string("Could not write trace file ") + fileName);
+    }
+
+    // Add the completed commands to the trace of the process, if it is recorded. Called at sync.
+    void flush() {
+        TraceFile *file = TraceFile::instance();
+        if (!file)
+            return;
+        std::string events;
+        if (!m_flushed) {
+            events = rowNames();
+            m_flushed = true;
+        }
+        drain(events);
+        file->append(events);
+    }
+
+  private:
+    static int nextId() {
+        static std::atomic<int> id{0};
+        return id++;
+    }
+
+    int launchRow() const { return 2 * m_id; }
+    int copyRow() const { return 2 * m_id + 1; }
+
+    // Append the formatted text to the string
+    static void appendf(std::string &str, const char *format, ...) {
+        va_list args, argsCopy;
+        va_start(args, format);
+        va_copy(argsCopy, args);
+        const int size = vsnprintf(nullptr, 0, format, args);
+        va_end(args);
+        if (size > 0) {
+            const size_t offset = str.size();
+            str.resize(offset + size + 1);
+            vsnprintf(&str[offset], size + 1, format, argsCopy);
+            str.resize(offset + size);
+        }
+        va_end(argsCopy);
+    }
+
+    std::string rowNames() const {
+        std::string names;
+        appendf(names,
+                ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                "\"args\":{\"name\":\"ispcrt %s task queue %d\"}}"
+                ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                "\"args\":{\"name\":\"ispcrt %s task queue %d copies\"}}",
+                launchRow(), m_deviceName, m_id, copyRow(), m_deviceName, m_id);
+        return names;
+    }
+
+    // Append the events of the completed commands, each one preceded by a separator, and forget them.
+    void drain(std::string &events) {
+        std::vector<Command> pending;
+        for (auto &command : m_commands) {
+            ISPCRTFutureTimestamps ts;
+            if (!command.future->valid() || !command.future->timestamps(ts)) {
+                pending.push_back(command);
+                continue;
+            }
+            const char *name = command.name.c_str();
+            const char *cat = command.copy ? "copy" : "launch";
+            const int tid = command.copy ? copyRow() : launchRow();
+            appendf(events,
+                    ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                    "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"queued_us\":%.3f}}"
+                    ",\n{\"name\":\"%s\",\"cat\":\"queued\",\"ph\":\"b\",\"id\":%llu,\"pid\":1,\"tid\":%d,"
+                    "\"ts\":%.3f}"
+                    ",\n{\"name\":\"%s\",\"cat\":\"queued\",\"ph\":\"e\",\"id\":%llu,\"pid\":1,\"tid\":%d,"
+                    "\"ts\":%.3f}",
+                    name, cat, tid, ts.startNs / 1000.0, (ts.endNs - ts.startNs) / 1000.0,
+                    (ts.startNs - ts.submitNs) / 1000.0, name, (unsigned long long)eventId(), tid,
+                    ts.submitNs / 1000.0, name, (unsigned long long)eventId(), tid, ts.startNs / 1000.0);
+            m_nextEventId++;
+            command.future->refDec();
+        }
+        m_commands.swap(pending);
+    }
+
+    // Ids of the asynchronous slices, unique in the trace of the process
+    uint64_t eventId() const { return ((uint64_t)m_id << 32) | m_nextEventId; }
+
+    struct Command {
+        std::string name;
+        Future *future;
+        bool copy;
+    };
+    std::vector<Command> m_commands;
+    // Rows of the task queue in the trace
+    int m_id;
+    const char *m_deviceName;
+    uint64_t m_nextEventId{0};
+    // Whether the names of the rows were added to the trace of the process
+    bool m_flushed{false};
+};
+
+} // namespace base
+} // namespace ispcrt
@@ -0,0 +1,99 @@
+// Copyright 2023 Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "BitcodeModule.h"
+#include "../Exception.h"
+
+// std
+#include <mutex>
+#include <string>
+
+// llvm
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/TargetSelect.h>
+
+namespace ispcrt {
+namespace cpu {
+
+struct BitcodeModule::Impl {
+    std::unique_ptr<llvm::orc::LLJIT> jit;
+};
+
+static void initializeLLVM() {
+    static std::once_flag initialized;
+    std::call_once(initialized, [] {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+    });
+}
+
+static std::string errorMessage(const char *what, llvm::Error error) {
+    return std::string(what) + ": " + llvm::toString(std::move(error));
+}
+
+BitcodeModule::BitcodeModule(const void *image, size_t size) : m_impl(new Impl) {
+    initializeLLVM();
+
+    // The bitcode is parsed into a context of its own, which the JIT then owns
+    // along with the module, so the image can be freed once it's loaded.
+    auto context = std::make_unique<llvm::LLVMContext>();
+    llvm::MemoryBufferRef buffer(llvm::StringRef((const char *)image, size), "ispcrt-bitcode-module");
+    auto module = llvm::parseBitcodeFile(buffer, *context);
+    if (!module)
+        throw base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT,
+                                         errorMessage("Could not parse bitcode module", module.takeError()));
+
+    auto jtmb = llvm::orc::JITTargetMachineBuilder::detectHost();
+    if (!jtmb)
+        throw base::ispcrt_runtime_error(ISPCRT_UNSUPPORTED,
+                                         errorMessage("Could not detect host CPU", jtmb.takeError()));
+    if ((*module)->getTargetTriple().empty())
+        (*module)->setTargetTriple(jtmb->getTargetTriple().str());
+    jtmb->setCodeGenOptLevel(llvm::CodeGenOpt::Aggressive);
+
+    auto jit = llvm::orc::LLJITBuilder().setJITTargetMachineBuilder(std::move(*jtmb)).create();
+    if (!jit)
+        throw base::ispcrt_runtime_error(ISPCRT_UNKNOWN_ERROR,
+                                         errorMessage("Could not create JIT", jit.takeError()));
+
+    // The task system, the C library and the like are resolved against the
+    // symbols of the process, which include the ones of ispcrt itself.
+    auto generator =
+        llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess((*jit)->getDataLayout().getGlobalPrefix());
+    if (!generator)
+        throw base::ispcrt_runtime_error(ISPCRT_UNKNOWN_ERROR,
+                                         errorMessage("Could not resolve symbols of the process", generator.takeError()));
+    (*jit)->getMainJITDylib().addGenerator(std::move(*generator));
+
+    if (auto error = (*jit)->addIRModule(llvm::orc::ThreadSafeModule(std::move(*module), std::move(context))))
+        throw base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT,
+                                         errorMessage("Could not add bitcode module", std::move(error)));
+
+    m_impl->jit = std::move(*jit);
+}
+
+BitcodeModule::~BitcodeModule() = default;
+
+void *BitcodeModule::lookup(const char *name) const {
+    // Functions are compiled on their first lookup.
+    auto symbol = m_impl->jit->lookup(name);
+    if (!symbol) {
+        llvm::consumeError(symbol.takeError());
+        return nullptr;
+    }
+#if LLVM_VERSION_MAJOR >= 15
+    return symbol->toPtr<void *>();
+#else
+    return reinterpret_cast<void *>(symbol->getAddress());
+#endif
+}
+
+} // namespace cpu
+} // namespace ispcrt
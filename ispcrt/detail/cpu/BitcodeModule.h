@@ -0,0 +1,31 @@
+// Copyright 2023 Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+// std
+#include <cstddef>
+#include <memory>
+
+namespace ispcrt {
+namespace cpu {
+
+// LLVM bitcode of a module compiled by ispc for the host CPU, which is
+// compiled to machine code with LLVM ORC when it's loaded.
+struct BitcodeModule {
+    BitcodeModule(const void *image, size_t size);
+    ~BitcodeModule();
+
+    BitcodeModule(const BitcodeModule &) = delete;
+    BitcodeModule &operator=(const BitcodeModule &) = delete;
+
+    // Address of the function or nullptr if the module doesn't define it
+    void *lookup(const char *name) const;
+
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+
+} // namespace cpu
+} // namespace ispcrt
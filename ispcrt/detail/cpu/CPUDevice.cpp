@@ -3,19 +3,40 @@
 
 #include "CPUDevice.h"
 #include "CPUContext.h"
+#include "../Itt.h"
+#include "../Trace.h"
+#ifdef ISPCRT_BUILD_JIT
+#include "BitcodeModule.h"
+#endif
 
 #if defined(_WIN32) || defined(_WIN64)
 #include "windows.h"
 #else
 #include <dlfcn.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+#endif
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
 #endif
 // std
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <condition_variable>
 #include <cstddef>
 #include <cstring>
+#include <deque>
 #include <exception>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace ispcrt {
@@ -25,37 +46,145 @@ struct Future : public ispcrt::base::Future {
     Future() = default;
     virtual ~Future() = default;
 
-    bool valid() override { return m_valid; }
+    static void *operator new(size_t size) { return base::FuturePool<Future>::allocate(size); }
+    static void operator delete(void *p, size_t size) { base::FuturePool<Future>::release(p, size); }
+
+    // The future is completed by the worker thread of the task queue, so
+    // m_valid is set after m_time and read before reading it.
+    bool valid() override { return m_valid.load(std::memory_order_acquire); }
     uint64_t time() override { return m_time; }
+    bool timestamps(ISPCRTFutureTimestamps &ts) override {
+        ts = m_timestamps;
+        return m_timestamps.submitNs != 0;
+    }
 
+    friend struct Graph;
     friend struct TaskQueue;
 
   private:
     uint64_t m_time{0};
-    bool m_valid{false};
+    ISPCRTFutureTimestamps m_timestamps{0, 0, 0};
+    std::atomic<bool> m_valid{false};
 };
 
 using CPUKernelEntryPoint = void (*)(void *, size_t, size_t, size_t);
 
+// Copies of at least ParallelCopyMinSize bytes are split between threads, each copying at least
+// ParallelCopyPartSize bytes, as a single core gets only a fraction of the memory bandwidth of a socket.
+// The parts are written with non-temporal stores, since much more than the caches is copied.
+static constexpr size_t ParallelCopyMinSize = 16 * 1024 * 1024;
+static constexpr size_t ParallelCopyPartSize = 8 * 1024 * 1024;
+
+static void streamingCopy(std::byte *dst, const std::byte *src, size_t size) {
+#if defined(__x86_64__) || defined(_M_X64)
+    const size_t head = std::min(size, (16 - (reinterpret_cast<uintptr_t>(dst) & 15)) & 15);
+    memcpy(dst, src, head);
+    size_t i = head;
+    for (; i + 64 <= size; i += 64) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 16));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 32));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 48));
+        _mm_stream_si128(reinterpret_cast<__m128i *>(dst + i), a);
+        _mm_stream_si128(reinterpret_cast<__m128i *>(dst + i + 16), b);
+        _mm_stream_si128(reinterpret_cast<__m128i *>(dst + i + 32), c);
+        _mm_stream_si128(reinterpret_cast<__m128i *>(dst + i + 48), d);
+    }
+    memcpy(dst + i, src + i, size - i);
+    _mm_sfence();
+#else
+    memcpy(dst, src, size);
+#endif
+}
+
+// Call f(offset, count) for contiguous parts of [0, size) on several threads, the first part on this thread
+static void parallelParts(size_t size, const std::function<void(size_t, size_t)> &f) {
+    const size_t threads =
+        std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), size / ParallelCopyPartSize));
+    // Parts of whole pages, so that no two threads write the same page
+    const size_t part = ((size / threads) + 4095) & ~size_t(4095);
+    std::vector<std::thread> helpers;
+    for (size_t offset = part; offset < size; offset += part) {
+        helpers.emplace_back(f, offset, std::min(part, size - offset));
+    }
+    f(0, std::min(part, size));
+    for (auto &t : helpers) {
+        t.join();
+    }
+}
+
+static void parallelCopy(std::byte *dst, const std::byte *src, size_t size) {
+    if (size < ParallelCopyMinSize) {
+        memcpy(dst, src, size);
+        return;
+    }
+    parallelParts(size, [=](size_t offset, size_t count) { streamingCopy(dst + offset, src + offset, count); });
+}
+
+/* Memory of the views is aligned to cache lines, to pages for views of at least a page and to huge pages
+   for views of at least a huge page, which are backed by transparent huge pages on Linux. With
+   ISPCRT_FIRST_TOUCH=1, large views are zeroed in contiguous parts by several threads when they are
+   allocated, so that the first-touch policy of the OS spreads their pages over the NUMA nodes of the
+   threads, like the ranges of tasks of the launches processing them, instead of placing all of them on
+   the node of the thread which happens to touch them first. */
+static constexpr size_t MemoryViewAlignment = 64;
+static constexpr size_t PageSize = 4096;
+static constexpr size_t HugePageSize = 2 * 1024 * 1024;
+
+static bool firstTouchEnabled() {
+    static const bool enabled = []() {
+        const char *env = getenv("ISPCRT_FIRST_TOUCH");
+        return env != nullptr && atoi(env) != 0;
+    }();
+    return enabled;
+}
+
+static void *allocateMemory(size_t size) {
+    const size_t alignment = size >= HugePageSize ? HugePageSize : size >= PageSize ? PageSize : MemoryViewAlignment;
+#if defined(_WIN32) || defined(_WIN64)
+    void *ptr = _aligned_malloc(size, alignment);
+#else
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, alignment, size) != 0)
+        ptr = nullptr;
+#endif
+    if (!ptr)
+        throw std::bad_alloc();
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (alignment == HugePageSize)
+        madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+    if (size >= ParallelCopyMinSize && firstTouchEnabled()) {
+        auto *bytes = static_cast<std::byte *>(ptr);
+        parallelParts(size, [=](size_t offset, size_t count) { memset(bytes + offset, 0, count); });
+    }
+    return ptr;
+}
+
+static void freeMemory(void *ptr) {
+#if defined(_WIN32) || defined(_WIN64)
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
 struct MemoryView : public ispcrt::base::MemoryView {
     MemoryView(void *appMem, size_t numBytes, bool shared) : m_hostPtr(appMem), m_devicePtr(appMem), m_size(numBytes), m_shared(shared) {}
 
     ~MemoryView() {
         if (!m_external_alloc && m_devicePtr)
-            free(m_devicePtr);
+            freeMemory(m_devicePtr);
     }
 
     bool isShared() { return m_shared; }
 
     void *hostPtr() {
-        if (m_shared) {
+        // The host and the device share the memory, so a device view allocated by ispcrt is its own host memory
+        if (m_shared || !m_hostPtr) {
             return devicePtr();
         }
-        else {
-            if (!m_hostPtr)
-                 throw std::logic_error("pointer to the host memory is NULL");
-            return m_hostPtr;
-        }
+        return m_hostPtr;
     };
 
     void *devicePtr() {
@@ -68,9 +197,7 @@ struct MemoryView : public ispcrt::base::MemoryView {
 
   private:
     void allocate() {
-        m_devicePtr = malloc(m_size);
-        if (!m_devicePtr)
-            throw std::bad_alloc();
+        m_devicePtr = allocateMemory(m_size);
         m_external_alloc = false;
     }
     bool m_external_alloc{true};
@@ -103,11 +230,36 @@ struct Module : public ispcrt::base::Module {
         }
     }
 
+    Module(const void *image, size_t size, ISPCRTModuleImageFormat format) {
+        if (!image || size == 0)
+            throw base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "Module image is empty!");
+        switch (format) {
+        case ISPCRT_MODULE_IMAGE_NATIVE:
+            openSharedObject(image, size);
+            break;
+        case ISPCRT_MODULE_IMAGE_BITCODE:
+#ifdef ISPCRT_BUILD_JIT
+            m_bitcode.push_back(std::make_shared<BitcodeModule>(image, size));
+            break;
+#else
+            throw base::ispcrt_runtime_error(ISPCRT_UNSUPPORTED,
+                                       "Bitcode modules require ispcrt to be built with ISPCRT_BUILD_JIT");
+#endif
+        default:
+            throw base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "Unknown module image format!");
+        }
+    }
+
     Module(Module **modules, const uint32_t numModules) {
         for (uint32_t i = 0; i < numModules; i++ ) {
             for (auto lib : modules[i]->libs()) {
                 m_libs.push_back(lib);
             }
+#ifdef ISPCRT_BUILD_JIT
+            for (auto &bitcode : modules[i]->m_bitcode) {
+                m_bitcode.push_back(bitcode);
+            }
+#endif
         }
     }
 
@@ -123,6 +275,11 @@ struct Module : public ispcrt::base::Module {
                 }
             }
         }
+#if defined(__linux__)
+        for (int fd : m_fds) {
+            close(fd);
+        }
+#endif
     }
 
     void *functionPtr(const char *name) const override {
@@ -136,6 +293,11 @@ struct Module : public ispcrt::base::Module {
             if (fptr != nullptr)
                 break;
         }
+#ifdef ISPCRT_BUILD_JIT
+        for (size_t i = 0; !fptr && i < m_bitcode.size(); i++) {
+            fptr = m_bitcode[i]->lookup(name);
+        }
+#endif
         if (!fptr)
             throw std::logic_error("could not find CPU function");
         return fptr;
@@ -144,8 +306,67 @@ struct Module : public ispcrt::base::Module {
     std::vector<void*> libs() { return m_libs; };
 
   private:
+    // The shared object is written to a file that is only visible to dlopen,
+    // an anonymous file in memory on Linux and a file that is removed right
+    // after it's opened elsewhere.  dlopen() returns the library loaded before
+    // from the same path, so the anonymous file is kept open, and its path
+    // taken, as long as the library is loaded.
+    void openSharedObject(const void *image, size_t size) {
+#if defined(_WIN32) || defined(_WIN64)
+        throw base::ispcrt_runtime_error(ISPCRT_UNSUPPORTED,
+                                         "Loading CPU shared modules from memory is not supported on Windows");
+#else
+#if defined(__linux__)
+        int fd = memfd_create("ispcrt-module", MFD_CLOEXEC);
+        std::string path = "/proc/self/fd/" + std::to_string(fd);
+#else
+        const char *tmpDir = getenv("TMPDIR");
+        std::string path = std::string(tmpDir ? tmpDir : "/tmp") + "/ispcrt-module-XXXXXX";
+        int fd = mkstemp(&path[0]);
+#endif
+        if (fd < 0)
+            throw base::ispcrt_runtime_error(ISPCRT_UNKNOWN_ERROR,
+                                             "Could not create a file for the CPU shared module!");
+
+        const char *data = (const char *)image;
+        size_t written = 0;
+        while (written < size) {
+            ssize_t n = write(fd, data + written, size - written);
+            if (n <= 0)
+                break;
+            written += (size_t)n;
+        }
+        void *lib = written == size ? dlopen(path.c_str(), RTLD_LAZY | RTLD_LOCAL) : nullptr;
+        const char *error = lib ? nullptr : dlerror();
+#if defined(__linux__)
+        if (lib)
+            m_fds.push_back(fd);
+        else
+            close(fd);
+#else
+        unlink(path.c_str());
+        close(fd);
+#endif
+
+        if (written != size)
+            throw base::ispcrt_runtime_error(ISPCRT_UNKNOWN_ERROR, "Could not write the CPU shared module!");
+        if (!lib)
+            throw std::logic_error(std::string("could not open CPU shared module from memory: ") +
+                                   (error ? error : "unknown error"));
+        m_libs.push_back(lib);
+#endif
+    }
+
     std::string m_file;
     std::vector<void*>m_libs;
+#if defined(__linux__)
+    // Anonymous files of the shared objects loaded from memory
+    std::vector<int> m_fds;
+#endif
+#ifdef ISPCRT_BUILD_JIT
+    // Static linking shares the compiled bitcode between modules
+    std::vector<std::shared_ptr<BitcodeModule>> m_bitcode;
+#endif
 };
 
 struct Kernel : public ispcrt::base::Kernel {
@@ -160,6 +381,9 @@ struct Kernel : public ispcrt::base::Kernel {
 
         m_fcn = (CPUKernelEntryPoint)fcn;
         m_module->refInc();
+#ifdef ISPCRT_BUILD_ITT
+        m_ittName = itt::name(_name);
+#endif
     }
 
     ~Kernel() {
@@ -168,28 +392,76 @@ struct Kernel : public ispcrt::base::Kernel {
     }
 
     CPUKernelEntryPoint entryPoint() const { return m_fcn; }
+    const std::string &name() const { return m_fcnName; }
+#ifdef ISPCRT_BUILD_ITT
+    __itt_string_handle *ittName() const { return m_ittName; }
+#endif
 
   private:
     std::string m_fcnName;
     CPUKernelEntryPoint m_fcn{nullptr};
+#ifdef ISPCRT_BUILD_ITT
+    __itt_string_handle *m_ittName{nullptr};
+#endif
 
     const ispcrt::base::Module *m_module{nullptr};
 };
 
-struct TaskQueue : public ispcrt::base::TaskQueue {
-    TaskQueue() {
-        // no-op
-    }
+/* The commands recorded by a task queue between beginCapture() and
+   endCapture().  A replay runs all of them as a single command of the
+   queue. */
+struct Graph : public ispcrt::base::Graph {
+    Graph() = default;
 
-    ~TaskQueue() {
+    ~Graph() {
         for (auto f : m_futures) {
-            delete f;
+            f->refDec();
         }
         m_futures.clear();
     }
 
+    void run() {
+        for (auto f : m_futures) {
+            f->m_valid.store(false, std::memory_order_relaxed);
+        }
+        for (auto &command : m_commands) {
+            command();
+        }
+    }
+
+    friend struct TaskQueue;
+
+  private:
+    std::vector<std::function<void()>> m_commands;
+    std::vector<cpu::Future *> m_futures;
+};
+
+/* The commands of a task queue are run in order by a worker thread of the
+   queue, so that launches run asynchronously to the host and to the other
+   queues, like on GPUs.  The kernels and memory views must stay alive until
+   the queue is synchronized. */
+struct TaskQueue : public ispcrt::base::TaskQueue {
+    TaskQueue() : m_worker(&TaskQueue::run, this) {}
+
+    ~TaskQueue() {
+        if (m_capture) {
+            m_capture->refDec();
+            m_capture = nullptr;
+        }
+        sync();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_commandAdded.notify_one();
+        m_worker.join();
+
+        m_trace.clear();
+        releaseFutures();
+    }
+
     void barrier() override {
-        // no-op
+        // no-op, the commands are run in order
     }
 
     void copyToHost(ispcrt::base::MemoryView &) override {
@@ -201,45 +473,275 @@ struct TaskQueue : public ispcrt::base::TaskQueue {
     }
 
     void copyMemoryView(base::MemoryView &mv_dst, base::MemoryView &mv_src, const size_t size) override {
-        auto view_dst_ptr = static_cast<std::byte*>(((cpu::MemoryView &)mv_dst).devicePtr());
-        auto view_src_ptr = static_cast<std::byte*>(((cpu::MemoryView &)mv_src).devicePtr());
-        std::copy(view_src_ptr, view_src_ptr + size, view_dst_ptr);
+        auto view_dst_ptr = static_cast<std::byte*>(mv_dst.devicePtr());
+        auto view_src_ptr = static_cast<std::byte*>(mv_src.devicePtr());
+        if (!m_profiling || m_capture) {
+            enqueue([=]() { parallelCopy(view_dst_ptr, view_src_ptr, size); });
+            return;
+        }
+        // The copy shows up in the trace, through a future owned by the task queue
+        auto *future = new cpu::Future;
+        assert(future);
+        m_futures.push_back(future);
+        future->m_timestamps.submitNs = base::profilingClockNs();
+        m_trace.add("copyMemoryView", future, true);
+        enqueue([=]() {
+            future->m_timestamps.startNs = base::profilingClockNs();
+            parallelCopy(view_dst_ptr, view_src_ptr, size);
+            future->m_timestamps.endNs = base::profilingClockNs();
+            future->m_time = future->m_timestamps.endNs - future->m_timestamps.startNs;
+            future->m_valid.store(true, std::memory_order_release);
+        });
     }
 
     ispcrt::base::Future *launch(ispcrt::base::Kernel &k, ispcrt::base::MemoryView *params, size_t dim0, size_t dim1,
                                  size_t dim2) override {
+        ISPCRT_ITT_TASK_NAMED("ispcrtLaunch");
+        // Allocate the parameters here rather than on the worker thread.
+        void *param_ptr = params ? params->devicePtr() : nullptr;
+        return enqueueLaunch((cpu::Kernel &)k, param_ptr, nullptr, dim0, dim1, dim2);
+    }
+
+    ispcrt::base::Future *launchInline(ispcrt::base::Kernel &k, const void *params, size_t size, size_t dim0,
+                                       size_t dim1, size_t dim2) override {
+        ISPCRT_ITT_TASK_NAMED("ispcrtLaunch");
+        if (!params || size == 0)
+            return enqueueLaunch((cpu::Kernel &)k, nullptr, nullptr, dim0, dim1, dim2);
+        // The command owns the copy, so it is there for the kernel however late it runs, and on every replay of
+        // a graph the launch is captured into.
+        auto copy = std::make_shared<std::vector<std::max_align_t>>((size + sizeof(std::max_align_t) - 1) /
+                                                                    sizeof(std::max_align_t));
+        std::memcpy(copy->data(), params, size);
+        return enqueueLaunch((cpu::Kernel &)k, copy->data(), copy, dim0, dim1, dim2);
+    }
+
+    ispcrt::base::Future *launchBatch(ispcrt::base::Kernel &k, const void *params, size_t size, const size_t *dims,
+                                      size_t count) override {
+        ISPCRT_ITT_TASK_NAMED("ispcrtLaunchBatch");
         auto &kernel = (cpu::Kernel &)k;
-        auto *parameters = (cpu::MemoryView *)params;
+        for (size_t i = 0; i < count; i++)
+            checkGrid(dims[3 * i], dims[3 * i + 1], dims[3 * i + 2]);
+
+        // One command runs all the launches in sequence, with the parameters and grids copied into one block
+        const size_t stride = params ? (size + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t) : 0;
+        auto copy = std::make_shared<std::vector<std::max_align_t>>(stride * count);
+        for (size_t i = 0; stride && i < count; i++)
+            std::memcpy(copy->data() + i * stride, static_cast<const uint8_t *>(params) + i * size, size);
+        auto grids = std::make_shared<std::vector<size_t>>(dims, dims + 3 * count);
 
         auto *fcn = kernel.entryPoint();
+        auto *future = newLaunchFuture(kernel);
+        const bool profile = m_profiling && !m_capture;
+
+#ifdef ISPCRT_BUILD_ITT
+        __itt_string_handle *ittName = kernel.ittName();
+#endif
+        enqueue([=]() {
+            ISPCRT_ITT_TASK(ittName);
+            const uint64_t start = base::profilingClockNs();
+            for (size_t i = 0; i < count; i++) {
+                const size_t *grid = grids->data() + 3 * i;
+                fcn(stride ? copy->data() + i * stride : nullptr, grid[0], grid[1], grid[2]);
+            }
+            const uint64_t end = base::profilingClockNs();
 
+            future->m_time = end - start;
+            if (profile) {
+                future->m_timestamps.startNs = start;
+                future->m_timestamps.endNs = end;
+            }
+            future->m_valid.store(true, std::memory_order_release);
+        });
+
+        return future;
+    }
+
+    void submit() override {
+        // no-op, the commands start running as soon as they're enqueued
+    }
+
+    void sync() override {
+        if (m_capture)
+            throw std::logic_error("cannot sync a task queue that is capturing a graph");
+        ISPCRT_ITT_TASK_NAMED("ispcrtSync");
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_commandsDone.wait(lock, [this]() { return m_commands.empty() && !m_running; });
+        }
+        m_trace.flush();
+        // The futures of the commands are completed, so the task queue doesn't need them anymore. Like on GPU,
+        // the ones the application kept are retained by it.
+        releaseFutures();
+    }
+
+    base::Future *signal() override {
+        if (m_capture)
+            throw std::logic_error("cannot signal a future while capturing a graph");
         auto *future = new cpu::Future;
         assert(future);
-        // Vector to know what to deallocate when TaskQueue object destructed
         m_futures.push_back(future);
+        enqueue([future]() { future->m_valid.store(true, std::memory_order_release); });
+        return future;
+    }
 
-        auto start = std::chrono::high_resolution_clock::now();
-        fcn(parameters ? parameters->devicePtr() : nullptr, dim0, dim1, dim2);
-        auto end = std::chrono::high_resolution_clock::now();
+    void wait(base::Future &f) override {
+        if (m_capture)
+            throw std::logic_error("cannot wait on a future while capturing a graph");
+        auto *future = (cpu::Future *)&f;
+        if (future->valid())
+            return;
+        // The future is completed by the worker thread of another task queue, which may release it at its sync
+        // before the command runs
+        future->refInc();
+        enqueue([future]() {
+            while (!future->valid())
+                std::this_thread::yield();
+            future->refDec();
+        });
+    }
 
-        future->m_time = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
-        future->m_valid = true;
+    void beginCapture() override {
+        if (m_capture)
+            throw std::logic_error("task queue is already capturing a graph");
+        m_capture = new cpu::Graph;
+    }
 
-        return future;
+    base::Graph *endCapture() override {
+        if (!m_capture)
+            throw std::logic_error("task queue is not capturing a graph");
+        auto *graph = m_capture;
+        m_capture = nullptr;
+        return graph;
     }
 
-    void submit() override {
-        // no-op
+    void replay(base::Graph &g) override {
+        if (m_capture)
+            throw std::logic_error("cannot replay a graph while capturing a graph");
+        auto *graph = (cpu::Graph *)&g;
+        // Keep the graph alive until the replay has run
+        graph->refInc();
+        enqueue([graph]() {
+            graph->run();
+            graph->refDec();
+        });
     }
 
-    void sync() override {
-        // no-op
+    void setProfiling(bool enable) override {
+        m_profiling = enable;
+        if (!enable)
+            m_trace.clear();
     }
 
+    void writeTrace(const char *fileName) override { m_trace.write(fileName); }
+
     void *taskQueueNativeHandle() const override { return nullptr; }
 
   private:
+    // 'paramsOwner' is kept by the command until it ran, if the parameters are owned by the launch
+    ispcrt::base::Future *enqueueLaunch(cpu::Kernel &kernel, void *param_ptr, std::shared_ptr<void> paramsOwner,
+                                        size_t dim0, size_t dim1, size_t dim2) {
+        checkGrid(dim0, dim1, dim2);
+
+        auto *fcn = kernel.entryPoint();
+        auto *future = newLaunchFuture(kernel);
+        const bool profile = m_profiling && !m_capture;
+
+#ifdef ISPCRT_BUILD_ITT
+        __itt_string_handle *ittName = kernel.ittName();
+#endif
+        enqueue([=]() {
+            (void)paramsOwner; // captured to keep the parameters alive
+            // The kernel runs on the worker thread of the task queue, as a task named after the kernel
+            ISPCRT_ITT_TASK(ittName);
+            const uint64_t start = base::profilingClockNs();
+            fcn(param_ptr, dim0, dim1, dim2);
+            const uint64_t end = base::profilingClockNs();
+
+            future->m_time = end - start;
+            if (profile) {
+                future->m_timestamps.startNs = start;
+                future->m_timestamps.endNs = end;
+            }
+            future->m_valid.store(true, std::memory_order_release);
+        });
+
+        return future;
+    }
+
+    static void checkGrid(size_t dim0, size_t dim1, size_t dim2) {
+        // The entry point defined by DEFINE_CPU_ENTRY_POINT() launches the
+        // grid as ispc tasks, which the task system spreads across the
+        // cores, and the task system counts the tasks of a launch in an int.
+        const size_t maxTasks = std::numeric_limits<int>::max();
+        if (dim0 > maxTasks || dim1 > maxTasks || dim2 > maxTasks ||
+            (dim0 != 0 && dim1 != 0 && dim2 != 0 && dim0 * dim1 > maxTasks / dim2))
+            throw std::runtime_error("launch grid has too many tasks for the CPU device");
+    }
+
+    cpu::Future *newLaunchFuture(cpu::Kernel &kernel) {
+        auto *future = new cpu::Future;
+        assert(future);
+        // Vector to know what to deallocate when TaskQueue (or Graph) object destructed
+        (m_capture ? m_capture->m_futures : m_futures).push_back(future);
+        // Launches replayed from graphs are not profiled, their futures are updated by each replay
+        if (m_profiling && !m_capture) {
+            future->m_timestamps.submitNs = base::profilingClockNs();
+            m_trace.add(kernel.name(), future);
+        }
+        return future;
+    }
+
+    void releaseFutures() {
+        for (auto f : m_futures) {
+            f->refDec();
+        }
+        m_futures.clear();
+    }
+
+    void enqueue(std::function<void()> command) {
+        if (m_capture) {
+            m_capture->m_commands.push_back(std::move(command));
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_commands.push_back(std::move(command));
+        }
+        m_commandAdded.notify_one();
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+            m_commandAdded.wait(lock, [this]() { return m_stop || !m_commands.empty(); });
+            if (m_commands.empty())
+                break;
+            auto command = std::move(m_commands.front());
+            m_commands.pop_front();
+            m_running = true;
+            lock.unlock();
+            command();
+            lock.lock();
+            m_running = false;
+            if (m_commands.empty())
+                m_commandsDone.notify_all();
+        }
+    }
+
     std::vector<cpu::Future*> m_futures;
+    // Graph the enqueued commands are recorded into, if any
+    cpu::Graph *m_capture{nullptr};
+    // All task queues are profiled while the trace of the process is recorded
+    bool m_profiling{base::TraceFile::instance() != nullptr};
+    base::Trace m_trace{"CPU"};
+
+    std::mutex m_mutex;
+    std::condition_variable m_commandAdded, m_commandsDone;
+    std::deque<std::function<void()>> m_commands;
+    bool m_running{false};
+    bool m_stop{false};
+    // Started last, once the members it uses are initialized.
+    std::thread m_worker;
 };
 
 uint32_t deviceCount() { return 1; }
@@ -248,6 +750,7 @@ ISPCRTDeviceInfo deviceInfo(uint32_t deviceIdx) {
     ISPCRTDeviceInfo info;
     info.deviceId = 0; // for CPU we don't support it yet
     info.vendorId = 0;
+    info.subDeviceCount = 0;
     return info;
 }
 
@@ -257,12 +760,28 @@ ispcrt::base::MemoryView *CPUDevice::newMemoryView(void *appMem, size_t numBytes
     return new cpu::MemoryView(appMem, numBytes, flags->allocType == ISPCRT_ALLOC_TYPE_SHARED);
 }
 
+ispcrt::base::MemoryView *CPUDevice::importMemoryView(void *memBuffer, size_t numBytes) const {
+    if (!memBuffer)
+        throw base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "Imported memory pointer is NULL!");
+    // Any host memory is device memory for CPU, so it is used as shared memory as it is
+    return new cpu::MemoryView(memBuffer, numBytes, true);
+}
+
+ispcrt::base::MemoryView *CPUDevice::importDmaBufMemoryView(int, size_t) const {
+    throw std::logic_error("dma-buf import is not supported on CPU device");
+}
+
 ispcrt::base::TaskQueue *CPUDevice::newTaskQueue() const { return new cpu::TaskQueue(); }
 
 ispcrt::base::Module *CPUDevice::newModule(const char *moduleFile, const ISPCRTModuleOptions &moduleOpts) const {
     return new cpu::Module(moduleFile);
 }
 
+ispcrt::base::Module *CPUDevice::newModuleFromMemory(const void *image, size_t size, ISPCRTModuleImageFormat format,
+                                                       const ISPCRTModuleOptions &moduleOpts) const {
+    return new cpu::Module(image, size, format);
+}
+
 void CPUDevice::dynamicLinkModules(base::Module **modules, const uint32_t numModules) const {}
 
 ispcrt::base::Module *CPUDevice::staticLinkModules(base::Module **modules, const uint32_t numModules) const {
@@ -279,6 +798,12 @@ void *CPUDevice::deviceNativeHandle() const { return nullptr; }
 
 void *CPUDevice::contextNativeHandle() const { return nullptr; }
 
+uint32_t CPUDevice::subDeviceCount() const { return 0; }
+
+base::Device *CPUDevice::subDevice(uint32_t) const {
+    throw base::ispcrt_runtime_error(ISPCRT_UNSUPPORTED, "CPU devices have no sub-devices");
+}
+
 ISPCRTAllocationType CPUDevice::getMemAllocType(void* appMemory) const {
     return ISPCRT_ALLOC_TYPE_UNKNOWN;
 }
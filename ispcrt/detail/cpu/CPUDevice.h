@@ -19,16 +19,23 @@ struct CPUDevice : public base::Device {
     CPUDevice() = default;
 
     base::MemoryView *newMemoryView(void *appMem, size_t numBytes, const ISPCRTNewMemoryViewFlags *flags) const override;
+    base::MemoryView *importMemoryView(void *memBuffer, size_t numBytes) const override;
+    base::MemoryView *importDmaBufMemoryView(int fd, size_t numBytes) const override;
 
     base::TaskQueue *newTaskQueue() const override;
 
     base::Module *newModule(const char *moduleFile, const ISPCRTModuleOptions &moduleOpts) const override;
+    base::Module *newModuleFromMemory(const void *image, size_t size, ISPCRTModuleImageFormat format,
+                                      const ISPCRTModuleOptions &moduleOpts) const override;
 
     void dynamicLinkModules(base::Module **modules, const uint32_t numModules) const override;
     base::Module *staticLinkModules(base::Module **modules, const uint32_t numModules) const override;
 
     base::Kernel *newKernel(const base::Module &module, const char *name) const override;
 
+    uint32_t subDeviceCount() const override;
+    base::Device *subDevice(uint32_t subDeviceIdx) const override;
+
     void *platformNativeHandle() const override;
     void *deviceNativeHandle() const override;
     void *contextNativeHandle() const override;
@@ -6,7 +6,7 @@
 #include <memory>
 
 namespace ispcrt {
-namespace gpu { class ChunkedPool; }
+namespace gpu { class MemPools; }
 
 struct GPUContext : public ispcrt::base::Context {
     GPUContext();
@@ -16,13 +16,11 @@ struct GPUContext : public ispcrt::base::Context {
     ISPCRTDeviceType getDeviceType() const override;
 
     virtual void* contextNativeHandle() const override;
-    gpu::ChunkedPool *memPool(ISPCRTSharedMemoryAllocationHint type) const;
 private:
     void *m_context{nullptr};
     void *m_driver{nullptr};
     bool  m_is_mock{false};
     bool  m_has_context_ownership{true};
-    std::unique_ptr<gpu::ChunkedPool> m_memPoolHWDR;
-    std::unique_ptr<gpu::ChunkedPool> m_memPoolHRDW;
+    std::unique_ptr<gpu::MemPools> m_memPools;
 };
 }
@@ -3,6 +3,8 @@
 
 #include "GPUDevice.h"
 #include "GPUContext.h"
+#include "../Itt.h"
+#include "../Trace.h"
 
 #if defined(_WIN32) || defined(_WIN64)
 
@@ -12,16 +14,23 @@
 // std
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cstdio>
 #include <cstring>
 #include <deque>
 #include <exception>
 #include <fstream>
 #include <iostream>
+#include <iomanip>
+#include <iterator>
 #include <limits>
+#include <random>
 #include <sstream>
 #include <vector>
 #include <memory>
+#include <mutex>
 #include <list>
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -44,11 +53,16 @@ DECLARE_ENV(ISPCRT_GPU_THREAD_GROUP_SIZE_Y)
 DECLARE_ENV(ISPCRT_GPU_THREAD_GROUP_SIZE_Z)
 DECLARE_ENV(ISPCRT_DISABLE_MULTI_COMMAND_LISTS)
 DECLARE_ENV(ISPCRT_DISABLE_COPY_ENGINE)
+DECLARE_ENV(ISPCRT_IMMEDIATE_COMMAND_LISTS)
+DECLARE_ENV(ISPCRT_SUBMIT_BATCH_SIZE)
+DECLARE_ENV(ISPCRT_SUBMIT_BATCH_TIME_US)
 DECLARE_ENV(ISPCRT_IGC_OPTIONS)
 DECLARE_ENV(ISPCRT_USE_ZEBIN)
+DECLARE_ENV(ISPCRT_MODULE_CACHE_DIR)
 DECLARE_ENV(ISPCRT_MEM_POOL)
 DECLARE_ENV(ISPCRT_MEM_POOL_MIN_CHUNK_POW2)
 DECLARE_ENV(ISPCRT_MEM_POOL_MAX_CHUNK_POW2)
+DECLARE_ENV(ISPCRT_STAGING_BUFFER_MB)
 #undef DECLARE_ENV
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -81,7 +95,8 @@ static void print_env(const char *env) {
 }
 
 // Return true for name=1 and false for name=0. If any other value set (even empty string) then runtime error occures.
-static bool get_bool_envvar(const char *name) {
+// If no variable presented in environment then return default_value.
+static bool get_bool_envvar(const char *name, bool default_value = false) {
     int parsed = 0;
     const char *val = getenv_wr(name);
     if (val) {
@@ -98,7 +113,7 @@ static bool get_bool_envvar(const char *name) {
         ss << "Incorrect value of " << name << " variable, set 0 or 1.";
         throw std::runtime_error(ss.str());
     }
-    return false;
+    return default_value;
 }
 
 // Parse numberic value of size_t type from value of name environment variable.
@@ -300,18 +315,34 @@ static const std::string getIspcrtErrorMessage(ze_result_t err) {
         }                                                                                                              \
     } while (0)
 
+struct Event;
+
 struct Future : public ispcrt::base::Future {
-    Future() {}
+    Future(Event *event) : m_event(event) {}
     virtual ~Future() {}
 
+    static void *operator new(size_t size) { return base::FuturePool<Future>::allocate(size); }
+    static void operator delete(void *p, size_t size) { base::FuturePool<Future>::release(p, size); }
+
     bool valid() override { return m_valid; }
     uint64_t time() override { return m_time; }
+    bool timestamps(ISPCRTFutureTimestamps &ts) override {
+        ts = m_timestamps;
+        return m_timestamps.submitNs != 0;
+    }
 
+    friend struct Graph;
     friend struct TaskQueue;
 
   private:
     uint64_t m_time{0};
-    bool m_valid{false};
+    ISPCRTFutureTimestamps m_timestamps{0, 0, 0};
+    // Futures may be waited on by other task queues, possibly from other threads
+    std::atomic<bool> m_valid{false};
+    // Event signaled by the command of the future, released once the future is valid
+    Event *m_event{nullptr};
+    // Number of task queues waiting on the event that were not synchronized yet
+    std::atomic<uint32_t> m_waiters{0};
 };
 
 struct Event {
@@ -368,11 +399,22 @@ struct Event {
 };
 
 struct CommandList {
-    CommandList(ze_device_handle_t device, ze_context_handle_t context, const uint32_t ordinal)
-        : m_device(device), m_context(context), m_ordinal(ordinal) {
-        ze_command_list_desc_t commandListDesc = {ZE_STRUCTURE_TYPE_COMMAND_LIST_DESC, nullptr, m_ordinal, 0};
+    CommandList(ze_device_handle_t device, ze_context_handle_t context, const uint32_t ordinal,
+                const bool immediate = false)
+        : m_device(device), m_context(context), m_ordinal(ordinal), m_immediate(immediate) {
+        if (m_immediate) {
+            // Immediate command list: commands are submitted to the device as soon as they are appended.
+            ze_command_queue_desc_t desc = {};
+            desc.ordinal = m_ordinal;
+            desc.mode = ZE_COMMAND_QUEUE_MODE_ASYNCHRONOUS;
+            desc.priority = ZE_COMMAND_QUEUE_PRIORITY_NORMAL;
+
+            L0_SAFE_CALL(zeCommandListCreateImmediate(m_context, m_device, &desc, &m_handle));
+        } else {
+            ze_command_list_desc_t commandListDesc = {ZE_STRUCTURE_TYPE_COMMAND_LIST_DESC, nullptr, m_ordinal, 0};
 
-        L0_SAFE_CALL(zeCommandListCreate(m_context, m_device, &commandListDesc, &m_handle));
+            L0_SAFE_CALL(zeCommandListCreate(m_context, m_device, &commandListDesc, &m_handle));
+        }
         if (!m_handle)
             throw std::runtime_error("Failed to create command list!");
     }
@@ -394,20 +436,32 @@ struct CommandList {
     }
 
     void reset() {
-        if (m_numCommands > 0) {
+        // Immediate command lists are never closed, so there is nothing to reset
+        if (!m_immediate && m_numCommands > 0) {
             L0_SAFE_CALL(zeCommandListReset(m_handle));
         }
         clear();
     }
 
     void submit(ze_command_queue_handle_t q) {
+        if (m_immediate) {
+            m_submitted = true;
+            return;
+        }
         if (!m_submitted && m_numCommands > 0) {
-            L0_SAFE_CALL(zeCommandListClose(m_handle));
-            L0_SAFE_CALL(zeCommandQueueExecuteCommandLists(q, 1, &m_handle, nullptr));
+            close();
+            execute(q);
             m_submitted = true;
         }
     }
 
+    void close() { L0_SAFE_CALL(zeCommandListClose(m_handle)); }
+
+    // Execute closed command list, it can be executed again until it is reset.
+    void execute(ze_command_queue_handle_t q) {
+        L0_SAFE_CALL(zeCommandQueueExecuteCommandLists(q, 1, &m_handle, nullptr));
+    }
+
     void inc() {
         m_numCommands++;
         m_submitted = false;
@@ -415,8 +469,17 @@ struct CommandList {
 
     uint32_t count() { return m_numCommands; }
 
+    // Wait on host until all commands appended to immediate command list are completed.
+    void hostSynchronize(Event *event) {
+        assert(m_immediate);
+        L0_SAFE_CALL(zeCommandListAppendBarrier(m_handle, event->handle(), 0, nullptr));
+        L0_SAFE_CALL(zeEventHostSynchronize(event->handle(), std::numeric_limits<uint64_t>::max()));
+    }
+
     void addEvent(Event *event) { m_events.push_back(event); }
 
+    const std::vector<Event *> &events() const { return m_events; }
+
     std::vector<ze_event_handle_t> getEventHandlers() {
         std::vector<ze_event_handle_t> hEvents;
         for (const auto &ev : m_events) {
@@ -430,6 +493,7 @@ struct CommandList {
     ze_context_handle_t m_context{nullptr};
     ze_device_handle_t m_device{nullptr};
     const uint32_t m_ordinal{0};
+    const bool m_immediate{false};
     bool m_submitted{false};
     uint32_t m_numCommands{0};
     // List of events associated with command list
@@ -519,8 +583,8 @@ struct EventPool {
         Event *event = nullptr;
         if (m_events_pool.size() > 0) {
             for (const auto &ev : m_events_pool) {
-                // If event is completed, reuse it
-                if (ev->isReady()) {
+                // If event is completed and no command waits on it anymore, reuse it
+                if (!ev->isActive() && ev->isReady()) {
                     event = ev;
                     event->resetEvent();
                     event->setActive();
@@ -563,21 +627,21 @@ struct EventPool {
 // It is virtually splitted into smaller chunks of same size.
 class Bulk {
   public:
-    // No actual shared memory allocation happen in bulk constructor. It is
-    // delayed until actual requests to allocate memory.
-    Bulk(size_t chunkSize, size_t size, ze_context_handle_t ctxt, ze_device_handle_t dev) :
-      m_chunkSize(chunkSize), m_size(size), m_numChunks(size / chunkSize), m_ctxt(ctxt), m_dev(dev) { }
-
-    // Note: when using that constructor, one should set device handle later.
-    Bulk(size_t chunkSize, size_t size, ze_context_handle_t ctxt) :
-      m_chunkSize(chunkSize), m_size(size), m_numChunks(size / chunkSize), m_ctxt(ctxt) { }
+    // No actual memory allocation happen in bulk constructor. It is delayed
+    // until actual requests to allocate memory.
+    // Note: device handle may be set later for shared memory bulks.
+    Bulk(ISPCRTAllocationType allocType, size_t chunkSize, size_t size, ze_context_handle_t ctxt,
+         ze_device_handle_t dev = nullptr) :
+      m_allocType(allocType), m_chunkSize(chunkSize), m_size(size), m_numChunks(size / chunkSize), m_ctxt(ctxt),
+      m_dev(dev) { }
 
     // Free memory hunk
     ~Bulk() {
         deallocate();
     }
 
-    // Allocate and return a pointer to free chunk inside bulk
+    // Allocate and return a pointer to free chunk inside bulk or nullptr if
+    // all chunks are in use
     void *allocChunk() {
         // Allocate size hunk once lazily on the first real allocation.
         if (!m_memPtr)
@@ -593,19 +657,14 @@ class Bulk {
             void *ptr = chunkPtr(m_initFreeChunks);
             m_usedChunks[ptr] = m_initFreeChunks++;
             return ptr;
-        } else {
-            if (!m_freeChunks.empty()) {
-                size_t idx = m_freeChunks.front();
-                m_freeChunks.pop_front();
-                void *ptr = chunkPtr(idx);
-                m_usedChunks[ptr] = idx;
-                return ptr;
-            } else {
-                // TODO! Really?
-                assert(false);
-                return nullptr;
-            }
+        } else if (!m_freeChunks.empty()) {
+            size_t idx = m_freeChunks.front();
+            m_freeChunks.pop_front();
+            void *ptr = chunkPtr(idx);
+            m_usedChunks[ptr] = idx;
+            return ptr;
         }
+        return nullptr;
     }
 
     // Free chunk
@@ -630,6 +689,7 @@ class Bulk {
 
     char  *m_memPtr{nullptr};
 
+    ISPCRTAllocationType m_allocType{ISPCRT_ALLOC_TYPE_SHARED};
     size_t m_size{0};
     size_t m_chunkSize{0};
     size_t m_numChunks{0};
@@ -652,11 +712,19 @@ class Bulk {
         ze_device_mem_alloc_desc_t dev_desc = {};
         ze_host_mem_alloc_desc_t host_desc = {};
 
-        // The best scenario would be if zeMemAllocShared was able to allocate
-        // memory aligned to size. In that case, it would be easier to
-        // found the Bulk that own a specific chunk. At least, 4 MB doesn't
-        // work, so we need to track chuck(ptr)->Bulk map in the ChunkedPool.
-        status = zeMemAllocShared(m_ctxt, &dev_desc, &host_desc, m_size, 64, m_dev, (void**)&m_memPtr);
+        if (m_allocType == ISPCRT_ALLOC_TYPE_DEVICE) {
+            // Align device memory hunk to its size, so every chunk is aligned
+            // to the chunk size as standalone device allocations are.
+            status = zeMemAllocDevice(m_ctxt, &dev_desc, m_size, m_size, m_dev, (void**)&m_memPtr);
+        } else {
+            // The best scenario would be if zeMemAllocShared was able to allocate
+            // memory aligned to size. In that case, it would be easier to
+            // found the Bulk that own a specific chunk. At least, 4 MB doesn't
+            // work, so we need to track chuck(ptr)->Bulk map in the ChunkedPool.
+            status = zeMemAllocShared(m_ctxt, &dev_desc, &host_desc, m_size, 64, m_dev, (void**)&m_memPtr);
+        }
+        if (status != ZE_RESULT_SUCCESS)
+            m_memPtr = nullptr;
         L0_THROW_IF(status);
 
         return m_memPtr;
@@ -668,11 +736,14 @@ class Bulk {
     }
 };
 
-// ChunkedPool contains Bulks for some chunk size. It manages lists of bulks
-// for every size. If needed additional bulks are created.
+// ChunkedPool contains Bulks of one allocation type for power of 2 chunk
+// sizes (size classes). It manages lists of bulks for every size. If needed
+// additional bulks are created. ChunkedPool may be used from several threads.
 class ChunkedPool {
   public:
-    ChunkedPool(ISPCRTSharedMemoryAllocationHint type, ze_context_handle_t ctxt) : m_type(type), m_ctxt(ctxt) {
+    ChunkedPool(ISPCRTAllocationType allocType, ISPCRTSharedMemoryAllocationHint type, ze_context_handle_t ctxt,
+                ze_device_handle_t dev = nullptr)
+        : m_allocType(allocType), m_type(type), m_ctxt(ctxt), m_dev(dev) {
         m_minPow2 = get_number_envvar(ISPCRT_MEM_POOL_MIN_CHUNK_POW2, m_minPow2);
         if (!(m_minPow2 >= 1 && m_minPow2 <= 30)) {
             throw std::runtime_error("ISPCRT_MEM_POOL_MIN_CHUNK_POW2 is beyond reasonable limits");
@@ -687,7 +758,8 @@ class ChunkedPool {
         // Create empty Bulk objects for chunks of power of 2.
         for (size_t i = m_minPow2; i <= m_maxPow2 ; i++) {
             size_t chunkSize = 1ULL << i;
-            m_bulks[chunkSize] = std::list<Bulk*>( { new Bulk(chunkSize, m_maxChunkSize, m_ctxt) } );
+            m_bulks[chunkSize] =
+                std::list<Bulk *>({new Bulk(m_allocType, chunkSize, m_maxChunkSize, m_ctxt, m_dev)});
         }
     }
 
@@ -702,6 +774,7 @@ class ChunkedPool {
         assert(size <= m_maxChunkSize);
         assert(size >= m_minChunkSize);
 
+        std::lock_guard<std::mutex> lock(m_mutex);
         auto &bulks = m_bulks[size];
 
         bool allFull = true;
@@ -717,16 +790,18 @@ class ChunkedPool {
             break;
         }
         if (allFull) {
-            blk = new Bulk(size, m_maxChunkSize, m_ctxt, m_dev);
-            bulks.push_back(blk);
+            blk = new Bulk(m_allocType, size, m_maxChunkSize, m_ctxt, m_dev);
+            bulks.push_front(blk);
         }
 
         void *mem_ptr = blk->allocChunk();
+        assert(mem_ptr);
         m_allocated[mem_ptr] = blk;
         return mem_ptr;
     }
 
     void deallocate(void *ptr) {
+        std::lock_guard<std::mutex> lock(m_mutex);
         auto it = m_allocated.find(ptr);
         assert(it != m_allocated.end());
         Bulk *blk = it->second;
@@ -736,8 +811,14 @@ class ChunkedPool {
 
     // Getter and setter for device handle. It is needed because ChunkedPool
     // may be constructed inside Context before device creation.
-    ze_device_handle_t hDev() const { return m_dev; }
+    ze_device_handle_t hDev() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_dev;
+    }
     void hDev(ze_device_handle_t dev) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_dev)
+            return;
         m_dev = dev;
         // Update device handle in all bulks.
         for(auto &l : m_bulks)
@@ -750,6 +831,8 @@ class ChunkedPool {
     size_t maxChunkSize() const { return m_maxChunkSize; }
 
   private:
+    // Type of memory allocated by this ChunkedPool
+    ISPCRTAllocationType m_allocType;
     // Shared memory with allocation hint stored in this ChunkedPool
     ISPCRTSharedMemoryAllocationHint m_type;
 
@@ -759,6 +842,8 @@ class ChunkedPool {
     // Map every allocated memory to Bulk that contains it.
     std::unordered_map<void*, Bulk*> m_allocated;
 
+    std::mutex m_mutex;
+
     ze_context_handle_t m_ctxt{nullptr};
     ze_device_handle_t m_dev{nullptr};
 
@@ -773,29 +858,67 @@ class ChunkedPool {
     size_t m_maxChunkSize{1ULL << 21};
 };
 
+// Memory pools of a context or a device: one ChunkedPool for every shared
+// memory allocation hint and one for device memory when the device is known.
+class MemPools {
+  public:
+    MemPools(ze_context_handle_t ctxt, ze_device_handle_t dev) {
+        // Memory pools are enabled by default, ISPCRT_MEM_POOL=0 disables them
+        m_enabled = get_bool_envvar(ISPCRT_MEM_POOL, true);
+        if (!m_enabled)
+            return;
+        for (auto hint : {ISPCRT_SM_HOST_DEVICE_READ_WRITE, ISPCRT_SM_HOST_WRITE_DEVICE_READ,
+                          ISPCRT_SM_HOST_READ_DEVICE_WRITE}) {
+            m_shared[hint] = std::unique_ptr<ChunkedPool>(new ChunkedPool(ISPCRT_ALLOC_TYPE_SHARED, hint, ctxt, dev));
+        }
+        if (dev) {
+            m_device = std::unique_ptr<ChunkedPool>(
+                new ChunkedPool(ISPCRT_ALLOC_TYPE_DEVICE, ISPCRT_SM_HOST_DEVICE_READ_WRITE, ctxt, dev));
+        }
+    }
+
+    // Return pool for the memory view allocation or nullptr if there is no one
+    ChunkedPool *get(const ISPCRTNewMemoryViewFlags *flags) const {
+        if (!m_enabled)
+            return nullptr;
+        switch (flags->allocType) {
+        case ISPCRT_ALLOC_TYPE_DEVICE:
+            return m_device.get();
+        case ISPCRT_ALLOC_TYPE_SHARED:
+            if (flags->smHint >= ISPCRT_SM_UNKNOWN)
+                throw std::runtime_error("requested incorrect MemPool");
+            return m_shared[flags->smHint].get();
+        default:
+            return nullptr;
+        }
+    }
+
+  private:
+    bool m_enabled{false};
+    std::unique_ptr<ChunkedPool> m_shared[ISPCRT_SM_UNKNOWN];
+    std::unique_ptr<ChunkedPool> m_device;
+};
+
 struct MemoryView : public ispcrt::base::MemoryView {
-    MemoryView(ze_context_handle_t context, ze_device_handle_t device,
-               void *appMem, size_t numBytes, const ISPCRTNewMemoryViewFlags *flags, const GPUContext *ctxt)
+    MemoryView(ze_context_handle_t context, ze_device_handle_t device, void *appMem, size_t numBytes,
+               const ISPCRTNewMemoryViewFlags *flags, const RefCounted *owner, ChunkedPool *memPool)
         : m_hostPtr(appMem), m_size(numBytes), m_requestedSize(numBytes), m_context(context), m_device(device),
-          m_shared(flags->allocType == ISPCRT_ALLOC_TYPE_SHARED), m_smhint(flags->smHint), m_ctxtGPU(ctxt)
+          m_shared(flags->allocType == ISPCRT_ALLOC_TYPE_SHARED), m_smhint(flags->smHint), m_owner(owner),
+          m_memPool(memPool)
     {
-        // We need context object to be alive until memoryview is alive
-        if (m_ctxtGPU) {
-            m_ctxtGPU->refInc();
+        // We need context or device object owning memory pool to be alive until memoryview is alive
+        if (m_owner) {
+            m_owner->refInc();
         }
 
-        // Use MemPool only when it is explicitly enabled with env var and memory hint is not device/host read/write
-        m_useMemPool = get_bool_envvar(ISPCRT_MEM_POOL) && (m_smhint != ISPCRT_SM_HOST_DEVICE_READ_WRITE);
-        if (m_ctxtGPU && m_useMemPool) {
-            m_memPool = m_ctxtGPU->memPool(m_smhint);
-            if (!m_memPool->hDev())
-                m_memPool->hDev(device);
+        if (m_memPool && device) {
+            m_memPool->hDev(device);
         }
     }
 
     ~MemoryView() {
-        if (m_devicePtr) {
-            if (m_shared && m_useMemPool && m_size <= m_memPool->maxChunkSize()) {
+        if (m_devicePtr && !m_imported) {
+            if (m_pooled) {
                 m_memPool->deallocate(m_devicePtr);
                 if (UNLIKELY(is_verbose)) {
                     std::cout << "MemPool deallocation at " << m_devicePtr << std::endl;
@@ -805,8 +928,8 @@ struct MemoryView : public ispcrt::base::MemoryView {
             }
         }
 
-        if (m_ctxtGPU) {
-            m_ctxtGPU->refDec();
+        if (m_owner) {
+            m_owner->refDec();
         }
     }
 
@@ -822,6 +945,29 @@ struct MemoryView : public ispcrt::base::MemoryView {
 
     size_t numBytes() { return m_size; };
 
+    // Use USM allocated by the application instead of allocating memory. It stays owned by the application.
+    void importPtr(void *devicePtr) {
+        m_devicePtr = devicePtr;
+        m_imported = true;
+    }
+
+    // Allocate device memory backed by the dma-buf 'fd' exported by another driver or process
+    void importDmaBuf(int fd) {
+        if (!m_device)
+            throw std::runtime_error("Device handle is NULL!");
+
+        ze_external_memory_import_fd_t importDesc = {ZE_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMPORT_FD};
+        importDesc.flags = ZE_EXTERNAL_MEMORY_TYPE_FLAG_DMA_BUF;
+        importDesc.fd = fd;
+        ze_device_mem_alloc_desc_t allocDesc = {ZE_STRUCTURE_TYPE_DEVICE_MEM_ALLOC_DESC};
+        allocDesc.pNext = &importDesc;
+        ze_result_t status = zeMemAllocDevice(m_context, &allocDesc, m_size, 0, m_device, &m_devicePtr);
+
+        if (status != ZE_RESULT_SUCCESS)
+            m_devicePtr = nullptr;
+        L0_THROW_IF(status);
+    }
+
   private:
     void allocDevice() {
         if (!m_device)
@@ -854,24 +1000,26 @@ struct MemoryView : public ispcrt::base::MemoryView {
     }
 
     void allocate() {
-        if (m_shared) {
-
-            if (m_useMemPool && m_size <= m_memPool->maxChunkSize()) {
-                m_size = round_up_pow2(m_requestedSize);
-                if (m_size < m_memPool->minChunkSize()) {
-                    m_size = m_memPool->minChunkSize();
-                }
-
-                m_devicePtr = m_memPool->allocate(m_size);
-                assert(m_devicePtr);
-                if (UNLIKELY(is_verbose)) {
-                    std::cout << "MemPool allocation " << m_size << "(" << m_requestedSize
-                              << ") at " << m_devicePtr << std::endl;
-                }
-            } else {
-                allocShared();
+        if (m_memPool && m_requestedSize <= m_memPool->maxChunkSize()) {
+            size_t chunkSize = round_up_pow2(m_requestedSize);
+            if (chunkSize < m_memPool->minChunkSize()) {
+                chunkSize = m_memPool->minChunkSize();
             }
 
+            m_devicePtr = m_memPool->allocate(chunkSize);
+            assert(m_devicePtr);
+            m_pooled = true;
+            // Shared memory view spans the whole chunk, while device memory
+            // view keeps the requested size as it is copied from/to host memory.
+            if (m_shared) {
+                m_size = chunkSize;
+            }
+            if (UNLIKELY(is_verbose)) {
+                std::cout << "MemPool allocation " << chunkSize << "(" << m_requestedSize
+                          << ") at " << m_devicePtr << std::endl;
+            }
+        } else if (m_shared) {
+            allocShared();
         } else {
             allocDevice();
         }
@@ -879,7 +1027,10 @@ struct MemoryView : public ispcrt::base::MemoryView {
 
     ISPCRTSharedMemoryAllocationHint m_smhint{ISPCRT_SM_HOST_DEVICE_READ_WRITE};
     bool m_shared{false};
-    bool m_useMemPool{false};
+    // Memory is allocated from m_memPool
+    bool m_pooled{false};
+    // Memory is allocated by the application
+    bool m_imported{false};
 
     void *m_hostPtr{nullptr};
     void *m_devicePtr{nullptr};
@@ -889,13 +1040,103 @@ struct MemoryView : public ispcrt::base::MemoryView {
     ze_device_handle_t m_device{nullptr};
     ze_context_handle_t m_context{nullptr};
 
-    const GPUContext *m_ctxtGPU{nullptr};
+    const RefCounted *m_owner{nullptr};
     ChunkedPool *m_memPool{nullptr};
 };
 
+// On-disk cache of native binaries of the modules built from SPIR-V. It is enabled by setting
+// ISPCRT_MODULE_CACHE_DIR to an existing directory. A binary is stored in a file named by the hash of its key:
+// the SPIR-V code, the build options, the device and the driver version. The file starts with the key itself,
+// so a hash collision or a file left by another driver is never loaded.
+class ModuleCache {
+  public:
+    ModuleCache(ze_driver_handle_t driver, ze_device_handle_t device, const std::vector<unsigned char> &code,
+                const std::string &options) {
+        const char *dir = getenv_wr(ISPCRT_MODULE_CACHE_DIR);
+        if (!dir || !*dir)
+            return;
+
+        ze_driver_properties_t driverProperties = {ZE_STRUCTURE_TYPE_DRIVER_PROPERTIES};
+        L0_SAFE_CALL(zeDriverGetProperties(driver, &driverProperties));
+        ze_device_properties_t deviceProperties = {ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES};
+        L0_SAFE_CALL(zeDeviceGetProperties(device, &deviceProperties));
+
+        std::ostringstream key;
+        key << "ispcrt module cache v1\n";
+        key << "device " << std::hex << deviceProperties.vendorId << ":" << deviceProperties.deviceId << " ";
+        for (auto b : deviceProperties.uuid.id)
+            key << std::setw(2) << std::setfill('0') << (unsigned)b;
+        key << "\ndriver " << driverProperties.driverVersion << "\n";
+        key << "spirv " << code.size() << ":" << hash(code.data(), code.size()) << "\n";
+        key << "options " << options;
+        m_key = key.str();
+
+        std::ostringstream path;
+        path << dir << "/" << std::hex << std::setw(16) << std::setfill('0') << hash(m_key.data(), m_key.size())
+             << ".zebin";
+        m_path = path.str();
+    }
+
+    bool enabled() const { return !m_path.empty(); }
+
+    // Read the binary stored in cache, return false if there is none for the key
+    bool load(std::vector<unsigned char> &binary) const {
+        std::ifstream is(m_path, std::ios::binary);
+        if (!is.good())
+            return false;
+        std::vector<char> data((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+        // Stored key is followed by the terminating zero and the binary
+        if (data.size() <= m_key.size() + 1 || std::memcmp(data.data(), m_key.c_str(), m_key.size() + 1) != 0)
+            return false;
+        binary.assign(data.begin() + m_key.size() + 1, data.end());
+        return true;
+    }
+
+    // Store the native binary of the module. Cache is best effort, so failures are ignored.
+    void store(ze_module_handle_t module) const {
+        size_t size = 0;
+        if (zeModuleGetNativeBinary(module, &size, nullptr) != ZE_RESULT_SUCCESS || size == 0)
+            return;
+        std::vector<uint8_t> binary(size);
+        if (zeModuleGetNativeBinary(module, &size, binary.data()) != ZE_RESULT_SUCCESS)
+            return;
+
+        // Write to a temporary file first, so other processes never read a partially written binary
+        std::ostringstream tmpPath;
+        tmpPath << m_path << ".tmp" << std::hex << std::random_device{}();
+        std::ofstream os(tmpPath.str(), std::ios::binary);
+        os.write(m_key.c_str(), m_key.size() + 1);
+        os.write((const char *)binary.data(), size);
+        os.close();
+        if (!os.good() || std::rename(tmpPath.str().c_str(), m_path.c_str()) != 0) {
+            std::remove(tmpPath.str().c_str());
+            return;
+        }
+        if (UNLIKELY(is_verbose)) {
+            std::cout << "Module binary is stored to cache " << m_path << std::endl;
+        }
+    }
+
+    const std::string &path() const { return m_path; }
+
+  private:
+    // 64-bit FNV-1a hash
+    static uint64_t hash(const void *data, size_t size) {
+        uint64_t h = 14695981039346656037ULL;
+        for (size_t i = 0; i < size; i++) {
+            h ^= ((const unsigned char *)data)[i];
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    std::string m_key;
+    std::string m_path;
+};
+
 struct Module : public ispcrt::base::Module {
-    Module(ze_device_handle_t device, ze_context_handle_t context, const char *moduleFile, const bool is_mock_dev,
-           const ISPCRTModuleOptions &opts)
+    Module(ze_driver_handle_t driver, ze_device_handle_t device, ze_context_handle_t context, const char *moduleFile,
+           const bool is_mock_dev, const ISPCRTModuleOptions &opts)
         : m_file(moduleFile) {
         std::ifstream is;
         ze_module_format_t moduleFormat = ZE_MODULE_FORMAT_IL_SPIRV;
@@ -984,6 +1225,32 @@ struct Module : public ispcrt::base::Module {
         m_module_desc.pBuildFlags = m_igc_options.c_str();
 
         assert(device != nullptr);
+
+        // Native binaries built by the driver from SPIR-V before are loaded from cache, skipping the compilation.
+        // m_module_desc still describes the SPIR-V code which is needed for static linking of modules.
+        std::unique_ptr<ModuleCache> cache;
+        if (!is_mock_dev && moduleFormat == ZE_MODULE_FORMAT_IL_SPIRV) {
+            cache = std::unique_ptr<ModuleCache>(new ModuleCache(driver, device, m_code, m_igc_options));
+            std::vector<unsigned char> binary;
+            if (cache->enabled() && cache->load(binary)) {
+                ze_module_desc_t nativeDesc = {ZE_STRUCTURE_TYPE_MODULE_DESC};
+                nativeDesc.format = ZE_MODULE_FORMAT_NATIVE;
+                nativeDesc.inputSize = binary.size();
+                nativeDesc.pInputModule = binary.data();
+                nativeDesc.pBuildFlags = "";
+                // The cached binary may be rejected by the driver, then the module is built from SPIR-V again
+                if (zeModuleCreate(context, device, &nativeDesc, &m_module, nullptr) != ZE_RESULT_SUCCESS) {
+                    m_module = nullptr;
+                }
+                if (UNLIKELY(is_verbose)) {
+                    std::cout << "Module " << m_file << (m_module ? " is loaded from" : " is rejected by")
+                              << " cache " << cache->path() << std::endl;
+                }
+                if (m_module)
+                    return;
+            }
+        }
+
         if (UNLIKELY(is_verbose)) {
             ze_module_build_log_handle_t hLog = nullptr;
             size_t size = 0;
@@ -1009,6 +1276,9 @@ struct Module : public ispcrt::base::Module {
 
         if (m_module == nullptr)
             throw std::runtime_error("Failed to load spv module!");
+
+        if (cache && cache->enabled())
+            cache->store(m_module);
     }
 
     Module(ze_device_handle_t device, ze_context_handle_t context, Module** modules, const uint32_t numModules) {
@@ -1085,7 +1355,8 @@ struct Module : public ispcrt::base::Module {
 };
 
 struct Kernel : public ispcrt::base::Kernel {
-    Kernel(const ispcrt::base::Module &_module, const char *name) : m_fcnName(name), m_module(&_module) {
+    Kernel(const ispcrt::base::Module &_module, const char *name, ze_device_handle_t device)
+        : m_fcnName(name), m_module(&_module) {
         const gpu::Module &module = (const gpu::Module &)_module;
 
         ze_kernel_desc_t kernelDesc = {};
@@ -1101,7 +1372,26 @@ struct Kernel : public ispcrt::base::Kernel {
 
         L0_SAFE_CALL(zeKernelSetIndirectAccess(m_kernel, kernel_flags));
 
+        // Shared local memory of the kernel's "shared" variables, which the
+        // driver allocates for each workgroup.
+        ze_kernel_properties_t kernelProperties = {ZE_STRUCTURE_TYPE_KERNEL_PROPERTIES};
+        L0_SAFE_CALL(zeKernelGetProperties(m_kernel, &kernelProperties));
+        m_slmSize = kernelProperties.localMemSize;
+        if (m_slmSize > 0 && device != nullptr) {
+            ze_device_compute_properties_t computeProperties = {ZE_STRUCTURE_TYPE_DEVICE_COMPUTE_PROPERTIES};
+            L0_SAFE_CALL(zeDeviceGetComputeProperties(device, &computeProperties));
+            if (m_slmSize > computeProperties.maxSharedLocalMemory) {
+                L0_SAFE_CALL_NOEXCEPT(zeKernelDestroy(m_kernel));
+                throw std::runtime_error("Kernel " + m_fcnName + " uses " + std::to_string(m_slmSize) +
+                                         " bytes of shared local memory, more than the device's " +
+                                         std::to_string(computeProperties.maxSharedLocalMemory) + "!");
+            }
+        }
+
         m_module->refInc();
+#ifdef ISPCRT_BUILD_ITT
+        m_ittName = itt::name(name);
+#endif
     }
 
     ~Kernel() {
@@ -1111,12 +1401,151 @@ struct Kernel : public ispcrt::base::Kernel {
     }
 
     ze_kernel_handle_t handle() const { return m_kernel; }
+    const std::string &name() const { return m_fcnName; }
+    uint32_t slmSize() const { return m_slmSize; }
+#ifdef ISPCRT_BUILD_ITT
+    __itt_string_handle *ittName() const { return m_ittName; }
+#endif
 
   private:
     std::string m_fcnName;
 
     const ispcrt::base::Module *m_module{nullptr};
     ze_kernel_handle_t m_kernel{nullptr};
+    uint32_t m_slmSize{0};
+#ifdef ISPCRT_BUILD_ITT
+    __itt_string_handle *m_ittName{nullptr};
+#endif
+};
+
+// Copies and launches recorded by a task queue into command lists that are closed once
+// and executed again on every replay.
+struct Graph : public ispcrt::base::Graph {
+    Graph(ze_device_handle_t device, ze_context_handle_t context, uint32_t computeOrdinal, uint32_t copyOrdinal,
+          bool sharedCommandList)
+        : m_ep_compute(context, device, ISPCRTEventPoolType::compute),
+          m_ep_copy(context, device, ISPCRTEventPoolType::copy), m_context(context) {
+        m_cl_compute = std::make_shared<CommandList>(device, context, computeOrdinal);
+        if (sharedCommandList) {
+            m_cl_mem_h2d = m_cl_compute;
+            m_cl_mem_d2h = m_cl_compute;
+        } else {
+            m_cl_mem_h2d = std::make_shared<CommandList>(device, context, copyOrdinal);
+            m_cl_mem_d2h = std::make_shared<CommandList>(device, context, copyOrdinal);
+        }
+    }
+
+    ~Graph() {
+        for (const auto &p : m_events_compute_list) {
+            auto e = p.first;
+            auto f = p.second;
+            // The launch won't be replayed anymore
+            f->m_valid = false;
+            f->refDec();
+            m_ep_compute.deleteEvent(e);
+        }
+        m_events_compute_list.clear();
+        for (auto *p : m_params)
+            L0_SAFE_CALL_NOEXCEPT(zeMemFree(m_context, p));
+    }
+
+    friend struct TaskQueue;
+
+  private:
+    // Distinct command lists, in the order they are executed, that have commands
+    std::vector<CommandList *> commandLists() {
+        std::vector<CommandList *> lists;
+        for (const auto &cl : {m_cl_mem_h2d, m_cl_compute, m_cl_mem_d2h}) {
+            if (cl->count() > 0 && std::find(lists.begin(), lists.end(), cl.get()) == lists.end()) {
+                lists.push_back(cl.get());
+            }
+        }
+        return lists;
+    }
+
+    EventPool m_ep_compute, m_ep_copy;
+    std::shared_ptr<CommandList> m_cl_compute;
+    std::shared_ptr<CommandList> m_cl_mem_h2d;
+    std::shared_ptr<CommandList> m_cl_mem_d2h;
+    std::vector<std::pair<Event *, Future *>> m_events_compute_list;
+    // Parameters of the inline launches, read by every replay
+    std::vector<void *> m_params;
+    ze_context_handle_t m_context{nullptr};
+    // Graph was replayed and the task queue it was replayed on was not synchronized yet
+    bool m_pending{false};
+};
+
+// Pinned host memory the copies between pageable application memory and the device are staged through, so the
+// copy engine transfers them at full link bandwidth instead of the driver bouncing them through its own staging.
+// Copies reserve consecutive parts of the buffer, which wraps around to its beginning on task queue sync, when
+// all of them completed. The buffer is allocated lazily and grows at sync up to its maximal size to fit all the
+// copies enqueued between two syncs, so a copy that does not fit goes directly from the application memory.
+class StagingBuffer {
+  public:
+    StagingBuffer(ze_context_handle_t ctxt, size_t maxSize) : m_ctxt(ctxt), m_maxSize(maxSize) {}
+
+    ~StagingBuffer() { deallocate(); }
+
+    // Return 'numBytes' of the buffer or nullptr if they don't fit into it until the next reset()
+    void *reserve(size_t numBytes) {
+        size_t size = (numBytes + Alignment - 1) & ~(Alignment - 1);
+        m_demand += size;
+        if (m_used + size > m_size)
+            return nullptr;
+        void *ptr = m_memPtr + m_used;
+        m_used += size;
+        return ptr;
+    }
+
+    bool inUse() const { return m_used > 0; }
+
+    // All copies through the buffer completed, so it can be reused and resized to fit them all next time
+    void reset() {
+        size_t size = std::min(m_demand, m_maxSize);
+        if (size > m_size) {
+            deallocate();
+            allocate(size);
+        }
+        m_used = 0;
+        m_demand = 0;
+    }
+
+    constexpr static size_t Alignment = 64;
+
+  private:
+    void allocate(size_t size) {
+        ze_host_mem_alloc_desc_t host_desc = {};
+        ze_result_t status = zeMemAllocHost(m_ctxt, &host_desc, size, Alignment, (void **)&m_memPtr);
+        if (status != ZE_RESULT_SUCCESS) {
+            // Copies just go directly from the application memory when pinned memory is exhausted
+            if (UNLIKELY(is_verbose)) {
+                std::cout << "zeMemAllocHost " << size << " for staging buffer failed: "
+                          << getIspcrtErrorMessage(status) << std::endl;
+            }
+            m_memPtr = nullptr;
+            m_maxSize = 0;
+            return;
+        }
+        m_size = size;
+        if (UNLIKELY(is_verbose)) {
+            std::cout << "zeMemAllocHost " << size << " for staging buffer at " << (void *)m_memPtr << std::endl;
+        }
+    }
+
+    void deallocate() {
+        if (m_memPtr)
+            L0_SAFE_CALL_NOEXCEPT(zeMemFree(m_ctxt, m_memPtr));
+        m_memPtr = nullptr;
+        m_size = 0;
+    }
+
+    ze_context_handle_t m_ctxt{nullptr};
+    char *m_memPtr{nullptr};
+    size_t m_size{0};
+    size_t m_maxSize{0};
+    // Bytes reserved since the last reset, whether they fit into the buffer or not
+    size_t m_used{0};
+    size_t m_demand{0};
 };
 
 struct CommandQueue {
@@ -1145,7 +1574,8 @@ struct CommandQueue {
 struct TaskQueue : public ispcrt::base::TaskQueue {
     TaskQueue(ze_device_handle_t device, ze_context_handle_t context, const bool is_mock_dev)
         : m_ep_compute(context, device, ISPCRTEventPoolType::compute),
-          m_ep_copy(context, device, ISPCRTEventPoolType::copy) {
+          m_ep_copy(context, device, ISPCRTEventPoolType::copy),
+          m_staging(context, is_mock_dev ? 0 : get_number_envvar(ISPCRT_STAGING_BUFFER_MB, 256) << 20) {
         m_context = context;
         m_device = device;
 
@@ -1154,6 +1584,12 @@ struct TaskQueue : public ispcrt::base::TaskQueue {
         // Check env variable before queue configuration
         bool isCopyEngineEnabled = !get_bool_envvar(ISPCRT_DISABLE_COPY_ENGINE);
         bool useMultipleCommandLists = !get_bool_envvar(ISPCRT_DISABLE_MULTI_COMMAND_LISTS);
+        m_useImmediateCommandLists = !is_mock_dev && get_bool_envvar(ISPCRT_IMMEDIATE_COMMAND_LISTS);
+        // Batching thresholds are meaningless for immediate command lists, every command is submitted on append.
+        if (!m_useImmediateCommandLists) {
+            m_batchSize = get_number_envvar(ISPCRT_SUBMIT_BATCH_SIZE, 0);
+            m_batchTime = std::chrono::microseconds(get_number_envvar(ISPCRT_SUBMIT_BATCH_TIME_US, 0));
+        }
         // No need to create copy queue if only one command list is requested.
         if (!is_mock_dev && isCopyEngineEnabled && useMultipleCommandLists) {
             // Discover all command queue groups
@@ -1207,6 +1643,32 @@ struct TaskQueue : public ispcrt::base::TaskQueue {
     }
 
     ~TaskQueue() {
+        if (m_capture) {
+            swapCapture();
+            m_capture->refDec();
+            m_capture = nullptr;
+        }
+        for (auto *g : m_replayed) {
+            g->m_pending = false;
+            g->refDec();
+        }
+        m_replayed.clear();
+
+        // Copies and launches still in flight may access the staging buffer or the parameters
+        if (m_staging.inUse() || !m_params.empty()) {
+            try {
+                if (m_useImmediateCommandLists) {
+                    synchronizeImmediateCommandLists();
+                }
+            } catch (...) {
+            }
+            const uint64_t timeout = std::numeric_limits<uint64_t>::max();
+            L0_SAFE_CALL_NOEXCEPT(zeCommandQueueSynchronize(m_q_compute->handle(), timeout));
+            if (useCopyEngine) {
+                L0_SAFE_CALL_NOEXCEPT(zeCommandQueueSynchronize(m_q_copy->handle(), timeout));
+            }
+        }
+
         // Clean up any events that could be in the queue
         for (const auto &p : m_events_compute_list) {
             auto e = p.first;
@@ -1214,45 +1676,88 @@ struct TaskQueue : public ispcrt::base::TaskQueue {
             // Any commands associated with this future will never
             // be executed so we mark the future as not valid
             f->m_valid = false;
+            f->m_event = nullptr;
             f->refDec();
             m_ep_compute.deleteEvent(e);
         }
 
         m_events_compute_list.clear();
+        freeParams();
+
+        for (auto *f : m_waited_futures) {
+            f->m_waiters--;
+            f->refDec();
+        }
+        m_waited_futures.clear();
+        // Task queues waiting on these events must be synchronized before
+        for (const auto &p : m_events_waited) {
+            p.second->m_event = nullptr;
+            p.second->refDec();
+            m_ep_compute.deleteEvent(p.first);
+        }
+        m_events_waited.clear();
+
+        // Profiled copies that were not synced never complete
+        for (const auto &p : m_profiled_copies) {
+            p.second->refDec();
+        }
+        m_profiled_copies.clear();
     }
 
-    void barrier() override { L0_SAFE_CALL(zeCommandListAppendBarrier(m_cl_compute->handle(), nullptr, 0, nullptr)); }
+    void barrier() override {
+        L0_SAFE_CALL(zeCommandListAppendBarrier(m_cl_compute->handle(), nullptr, 0, nullptr));
+        commandAdded();
+    }
 
-    void copyToHost(ispcrt::base::MemoryView &mv) override {
-        auto &view = (gpu::MemoryView &)mv;
+    void copyToHost(ispcrt::base::MemoryView &view) override {
+        // The staged copy lands in the application memory on sync
+        void *staging = stagingPtr(view);
+        void *dst = staging ? staging : view.hostPtr();
         // Form a vector of compute events which should complete before copying memory to host
         std::vector<ze_event_handle_t> waitEvents;
         for (const auto &ev : m_events_compute_list) {
             waitEvents.push_back(ev.first->handle());
         }
-        L0_SAFE_CALL(zeCommandListAppendMemoryCopy(m_cl_mem_d2h->handle(), view.hostPtr(), view.devicePtr(),
-                                                   view.numBytes(), nullptr, (uint32_t)waitEvents.size(),
-                                                   waitEvents.data()));
+        if (!m_capture) {
+            for (const auto &ev : m_replayed_compute_events) {
+                waitEvents.push_back(ev->handle());
+            }
+        }
+        Event *copyEvent = profileCopy("copyToHost");
+        L0_SAFE_CALL(zeCommandListAppendMemoryCopy(m_cl_mem_d2h->handle(), dst, view.devicePtr(),
+                                                   view.numBytes(), copyEvent ? copyEvent->handle() : nullptr,
+                                                   (uint32_t)waitEvents.size(), waitEvents.data()));
+        if (staging) {
+            m_staged_to_host.push_back({view.hostPtr(), staging, view.numBytes()});
+        }
 
         m_cl_mem_d2h->inc();
+        commandAdded();
     }
 
-    void copyToDevice(ispcrt::base::MemoryView &mv) override {
-        auto &view = (gpu::MemoryView &)mv;
+    void copyToDevice(ispcrt::base::MemoryView &view) override {
+        // The application memory is read into the staging buffer right away, so the copy engine reads pinned memory
+        void *src = view.hostPtr();
+        void *staging = stagingPtr(view);
+        if (staging) {
+            memcpy(staging, src, view.numBytes());
+            src = staging;
+        }
         // Create event which will signal when memory copy is completed
-        Event *copyEvent = m_ep_copy.getEvent();
-        L0_SAFE_CALL(zeCommandListAppendMemoryCopy(m_cl_mem_h2d->handle(), view.devicePtr(), view.hostPtr(),
+        Event *copyEvent = profileCopy("copyToDevice");
+        if (!copyEvent) {
+            copyEvent = copyEventPool().getEvent();
+        }
+        L0_SAFE_CALL(zeCommandListAppendMemoryCopy(m_cl_mem_h2d->handle(), view.devicePtr(), src,
                                                    view.numBytes(), copyEvent->handle(), 0, nullptr));
         m_cl_mem_h2d->inc();
         m_cl_mem_h2d->addEvent(copyEvent);
+        commandAdded();
     }
 
-    void copyMemoryView(base::MemoryView &mv_dst, base::MemoryView &mv_src, const size_t size) override {
-        auto &view_dst = (gpu::MemoryView &)mv_dst;
-        auto &view_src = (gpu::MemoryView &)mv_src;
-
+    void copyMemoryView(base::MemoryView &view_dst, base::MemoryView &view_src, const size_t size) override {
         // Create event and add it to m_cl_compute command list
-        auto event = m_ep_compute.createEvent();
+        auto event = computeEventPool().createEvent();
         if (event == nullptr)
             throw std::runtime_error("Failed to create event!");
         try {
@@ -1261,68 +1766,105 @@ struct TaskQueue : public ispcrt::base::TaskQueue {
             m_cl_compute->inc();
         } catch (ispcrt::base::ispcrt_runtime_error &e) {
             // cleanup and rethrow
-            m_ep_compute.deleteEvent(event);
+            computeEventPool().deleteEvent(event);
             throw e;
         }
-        auto *future = new gpu::Future;
+        auto *future = new gpu::Future(event);
         assert(future);
         m_events_compute_list.push_back(std::make_pair(event, future));
+        if (m_profiling && !m_capture) {
+            future->m_timestamps.submitNs = base::profilingClockNs();
+            m_trace.add("copyMemoryView", future, true);
+        }
+        commandAdded();
     }
 
     ispcrt::base::Future *launch(ispcrt::base::Kernel &k, ispcrt::base::MemoryView *params, size_t dim0, size_t dim1,
                                  size_t dim2) override {
         auto &kernel = (gpu::Kernel &)k;
+        // Host side of the launch, the kernel itself runs on the device and shows up in GPU profiles
+        ISPCRT_ITT_TASK_NAMED("ispcrtLaunch");
+        ISPCRT_ITT_TASK(kernel.ittName());
 
         void *param_ptr = nullptr;
         if (params)
             param_ptr = params->devicePtr();
+        return enqueueLaunch(kernel, param_ptr, dim0, dim1, dim2);
+    }
 
-        // If param_ptr is nullptr, it was not set on host, so do not set kernel argument.
-        if (param_ptr != nullptr) {
-            L0_SAFE_CALL(zeKernelSetArgumentValue(kernel.handle(), 0, sizeof(void *), &param_ptr));
-        }
+    ispcrt::base::Future *launchInline(ispcrt::base::Kernel &k, const void *params, size_t size, size_t dim0,
+                                       size_t dim1, size_t dim2) override {
+        auto &kernel = (gpu::Kernel &)k;
+        ISPCRT_ITT_TASK_NAMED("ispcrtLaunch");
+        ISPCRT_ITT_TASK(kernel.ittName());
 
-        std::array<uint32_t, 3> suggestedGroupSize = {0};
-        L0_SAFE_CALL(zeKernelSuggestGroupSize(kernel.handle(), uint32_t(dim0), uint32_t(dim1), uint32_t(dim2),
-                                              &suggestedGroupSize[0], &suggestedGroupSize[1], &suggestedGroupSize[2]));
-        // TODO: Is this needed? Didn't find info in spec on the valid values that zeKernelSuggestGroupSize will return
-        suggestedGroupSize[0] = std::max(suggestedGroupSize[0], uint32_t(1));
-        suggestedGroupSize[1] = std::max(suggestedGroupSize[1], uint32_t(1));
-        suggestedGroupSize[2] = std::max(suggestedGroupSize[2], uint32_t(1));
+        void *param_ptr = nullptr;
+        if (params && size > 0) {
+            param_ptr = reserveParams(size);
+            memcpy(param_ptr, params, size);
+        }
+        return enqueueLaunch(kernel, param_ptr, dim0, dim1, dim2);
+    }
 
-        L0_SAFE_CALL(
-            zeKernelSetGroupSize(kernel.handle(), suggestedGroupSize[0], suggestedGroupSize[1], suggestedGroupSize[2]));
+    ispcrt::base::Future *launchBatch(ispcrt::base::Kernel &k, const void *params, size_t size, const size_t *dims,
+                                      size_t count) override {
+        auto &kernel = (gpu::Kernel &)k;
+        ISPCRT_ITT_TASK_NAMED("ispcrtLaunchBatch");
+        ISPCRT_ITT_TASK(kernel.ittName());
+
+        // The parameters of all launches go to one block of host memory, and the launches are appended without
+        // events, followed by a single barrier signaling the future of the batch.
+        const size_t stride = (size + StagingBuffer::Alignment - 1) & ~(StagingBuffer::Alignment - 1);
+        uint8_t *param_base = nullptr;
+        if (params && size > 0) {
+            param_base = static_cast<uint8_t *>(reserveParams(stride * count));
+            for (size_t i = 0; i < count; i++)
+                memcpy(param_base + i * stride, static_cast<const uint8_t *>(params) + i * size, size);
+        }
+        for (size_t i = 0; i < count; i++) {
+            appendLaunch(kernel, param_base ? param_base + i * stride : nullptr, dims[3 * i], dims[3 * i + 1],
+                         dims[3 * i + 2], nullptr);
+        }
 
-        const ze_group_count_t dispatchTraits = {uint32_t(dim0) / suggestedGroupSize[0],
-                                                 uint32_t(dim1) / suggestedGroupSize[1],
-                                                 uint32_t(dim2) / suggestedGroupSize[2]};
-        auto event = m_ep_compute.createEvent();
+        auto event = computeEventPool().createEvent();
         if (event == nullptr)
             throw std::runtime_error("Failed to create event!");
         try {
-            L0_SAFE_CALL(zeCommandListAppendLaunchKernel(
-                m_cl_compute->handle(), kernel.handle(), &dispatchTraits, event->handle(),
-                (uint32_t)m_cl_mem_h2d->getEventHandlers().size(), m_cl_mem_h2d->getEventHandlers().data()));
+            L0_SAFE_CALL(zeCommandListAppendBarrier(m_cl_compute->handle(), event->handle(), 0, nullptr));
             m_cl_compute->inc();
         } catch (ispcrt::base::ispcrt_runtime_error &e) {
             // cleanup and rethrow
-            m_ep_compute.deleteEvent(event);
+            computeEventPool().deleteEvent(event);
             throw e;
         }
-
-        auto *future = new gpu::Future;
-        assert(future);
-        m_events_compute_list.push_back(std::make_pair(event, future));
-
-        return future;
+        return addLaunchFuture(kernel, event);
     }
 
     void sync() override {
+        if (m_capture) {
+            throw std::logic_error("cannot sync a task queue that is capturing a graph");
+        }
+        ISPCRT_ITT_TASK_NAMED("ispcrtSync");
+        // Batches flushed and graphs replayed since the last sync may still be running on either queue, and so
+        // may commands waiting on other task queues.
+        const bool anySubmittedCommandList =
+            !m_cl_submitted.empty() || !m_replayed.empty() || !m_waited_futures.empty();
+
         // Submit command lists
         submit();
 
         // Synchronize
-        if (useCopyEngine) {
+        if (m_useImmediateCommandLists) {
+            synchronizeImmediateCommandLists();
+        }
+        if (anySubmittedCommandList) {
+            L0_SAFE_CALL(zeCommandQueueSynchronize(m_q_compute->handle(), std::numeric_limits<uint64_t>::max()));
+            if (useCopyEngine) {
+                L0_SAFE_CALL(zeCommandQueueSynchronize(m_q_copy->handle(), std::numeric_limits<uint64_t>::max()));
+            }
+        } else if (m_useImmediateCommandLists) {
+            // Nothing was executed by the command queues
+        } else if (useCopyEngine) {
             // If there are commands to copy from device to host,
             // run sync of copy queue - it will ensure that all commands in pipeline were executed before.
             if (anyD2HCopyCommand()) {
@@ -1344,34 +1886,212 @@ struct TaskQueue : public ispcrt::base::TaskQueue {
                 L0_SAFE_CALL(zeCommandQueueSynchronize(m_q_compute->handle(), std::numeric_limits<uint64_t>::max()));
             }
         }
+        // All copies through the staging buffer completed
+        for (const auto &c : m_staged_to_host) {
+            memcpy(c.dst, c.src, c.size);
+        }
+        m_staged_to_host.clear();
+        m_staging.reset();
+        freeParams();
+
         m_cl_compute->reset();
         m_cl_mem_h2d->reset();
         m_cl_mem_d2h->reset();
+        for (const auto &cl : m_cl_submitted) {
+            cl->reset();
+            m_cl_free.push_back(cl);
+        }
+        m_cl_submitted.clear();
+        m_batchCommands = 0;
+
+        // Commands of the task queue don't wait on the futures of other task queues anymore
+        for (auto *f : m_waited_futures) {
+            f->m_waiters--;
+            f->refDec();
+        }
+        m_waited_futures.clear();
+
+        // Events kept at the previous sync can be released if other task queues don't wait on them anymore
+        std::vector<std::pair<Event *, Future *>> waitedEvents;
+        std::swap(waitedEvents, m_events_waited);
+        for (const auto &p : waitedEvents) {
+            releaseEvent(p.first, p.second);
+        }
 
         // Update future objects corresponding to the events that have just completed
+        m_clockSyncHostNs = 0;
         for (const auto &p : m_events_compute_list) {
             auto e = p.first;
             auto f = p.second;
-            ze_kernel_timestamp_result_t tsResult;
-            L0_SAFE_CALL(zeEventQueryKernelTimestamp(e->handle(), &tsResult));
-            if (tsResult.context.kernelEnd >= tsResult.context.kernelStart) {
-                f->m_time = (tsResult.context.kernelEnd - tsResult.context.kernelStart);
-            } else {
-                // If we overflow kernelEnd counter then this method
-                // should be used for calculate time.
-                f->m_time = ((m_ep_compute.getTimestampMaxValue() - tsResult.context.kernelStart) +
-                             tsResult.context.kernelEnd + 1);
+            completeFuture(m_ep_compute, e, f);
+            releaseEvent(e, f);
+        }
+        // Futures of replayed graphs stay owned by the graphs
+        for (auto *g : m_replayed) {
+            for (const auto &p : g->m_events_compute_list) {
+                completeFuture(g->m_ep_compute, p.first, p.second);
             }
-            f->m_time *= m_ep_compute.getTimestampRes();
-            f->m_valid = true;
-            f->refDec();
-            m_ep_compute.deleteEvent(e);
+            g->m_pending = false;
+            g->refDec();
         }
+        m_replayed.clear();
+        m_replayed_compute_events.clear();
 
         m_events_compute_list.clear();
+        for (const auto &p : m_profiled_copies) {
+            completeFuture(m_ep_copy, p.first, p.second);
+            p.second->refDec();
+        }
+        m_profiled_copies.clear();
         m_ep_copy.releaseEvents();
+        m_trace.flush();
+    }
+
+    ispcrt::base::Future *signal() override {
+        if (m_capture) {
+            throw std::logic_error("cannot signal a future while capturing a graph");
+        }
+        auto event = m_ep_compute.createEvent();
+        if (event == nullptr)
+            throw std::runtime_error("Failed to create event!");
+        try {
+            // Launches already wait on the copies to device, copies to host run after the launches they wait
+            // on, so the command lists are joined on the one executed last.
+            std::vector<ze_event_handle_t> waitEvents;
+            if (m_cl_mem_h2d != m_cl_compute) {
+                waitEvents = m_cl_mem_h2d->getEventHandlers();
+            }
+            if (m_cl_mem_d2h == m_cl_compute) {
+                L0_SAFE_CALL(zeCommandListAppendBarrier(m_cl_compute->handle(), event->handle(),
+                                                        (uint32_t)waitEvents.size(), waitEvents.data()));
+                m_cl_compute->inc();
+            } else {
+                ze_event_handle_t computeEvent = m_ep_copy.getEvent()->handle();
+                L0_SAFE_CALL(zeCommandListAppendBarrier(m_cl_compute->handle(), computeEvent,
+                                                        (uint32_t)waitEvents.size(), waitEvents.data()));
+                m_cl_compute->inc();
+                L0_SAFE_CALL(zeCommandListAppendBarrier(m_cl_mem_d2h->handle(), event->handle(), 1, &computeEvent));
+                m_cl_mem_d2h->inc();
+            }
+        } catch (ispcrt::base::ispcrt_runtime_error &e) {
+            // cleanup and rethrow
+            m_ep_compute.deleteEvent(event);
+            throw e;
+        }
+
+        auto *future = new gpu::Future(event);
+        assert(future);
+        m_events_compute_list.push_back(std::make_pair(event, future));
+        commandAdded();
+
+        return future;
+    }
+
+    void wait(ispcrt::base::Future &f) override {
+        if (m_capture) {
+            throw std::logic_error("cannot wait on a future while capturing a graph");
+        }
+        auto &future = (gpu::Future &)f;
+        // The task queue of the future keeps its event while there are waiters, so register before checking
+        future.m_waiters++;
+        if (future.valid()) {
+            future.m_waiters--;
+            return;
+        }
+        if (!future.m_event) {
+            future.m_waiters--;
+            throw std::logic_error("cannot wait on a future of a destroyed task queue");
+        }
+
+        // Every next command of the task queue waits on the event, including copies to device
+        ze_event_handle_t hEvent = future.m_event->handle();
+        std::vector<CommandList *> lists;
+        for (const auto &cl : {m_cl_mem_h2d, m_cl_compute, m_cl_mem_d2h}) {
+            if (std::find(lists.begin(), lists.end(), cl.get()) == lists.end()) {
+                lists.push_back(cl.get());
+            }
+        }
+        for (auto *cl : lists) {
+            L0_SAFE_CALL(zeCommandListAppendBarrier(cl->handle(), nullptr, 1, &hEvent));
+            cl->inc();
+        }
+        future.refInc();
+        m_waited_futures.push_back(&future);
+        commandAdded();
+    }
+
+    void beginCapture() override {
+        if (m_capture) {
+            throw std::logic_error("task queue is already capturing a graph");
+        }
+        m_capture = new gpu::Graph(m_device, m_context, m_cl_compute->ordinal(), m_cl_mem_h2d->ordinal(),
+                                   m_cl_mem_h2d == m_cl_compute);
+        swapCapture();
+    }
+
+    base::Graph *endCapture() override {
+        if (!m_capture) {
+            throw std::logic_error("task queue is not capturing a graph");
+        }
+        swapCapture();
+        auto *graph = m_capture;
+        m_capture = nullptr;
+        for (auto *cl : graph->commandLists()) {
+            cl->close();
+        }
+        return graph;
     }
 
+    void replay(base::Graph &g) override {
+        if (m_capture) {
+            throw std::logic_error("cannot replay a graph while capturing a graph");
+        }
+        auto &graph = (gpu::Graph &)g;
+        // Events of the graph are reused by every replay, so replays can't overlap
+        if (graph.m_pending) {
+            throw std::logic_error("graph is replayed again before the task queue it was replayed on is synced");
+        }
+
+        // Commands enqueued before must be submitted first to keep the order of the commands on each queue
+        if (m_useImmediateCommandLists) {
+            // Immediate command lists are not executed by the queues of the graph, so wait for them
+            synchronizeImmediateCommandLists();
+        } else {
+            flushBatch();
+        }
+
+        for (const auto &ev : graph.m_cl_mem_h2d->events()) {
+            ev->resetEvent();
+        }
+        for (const auto &p : graph.m_events_compute_list) {
+            p.first->resetEvent();
+            p.second->m_valid = false;
+        }
+        for (auto *cl : graph.commandLists()) {
+            cl->execute(cl == graph.m_cl_compute.get() ? m_q_compute->handle() : m_q_copy->handle());
+        }
+
+        // Next launches depend on the copies and next copies to host on the launches of the graph
+        for (const auto &ev : graph.m_cl_mem_h2d->events()) {
+            m_cl_mem_h2d->addEvent(ev);
+        }
+        for (const auto &p : graph.m_events_compute_list) {
+            m_replayed_compute_events.push_back(p.first);
+        }
+        graph.m_pending = true;
+        graph.refInc();
+        m_replayed.push_back(&graph);
+    }
+
+    void setProfiling(bool enable) override {
+        m_profiling = enable;
+        if (!enable) {
+            m_trace.clear();
+        }
+    }
+
+    void writeTrace(const char *fileName) override { m_trace.write(fileName); }
+
     void *taskQueueNativeHandle() const override { return m_q_compute->handle(); }
 
   private:
@@ -1384,18 +2104,286 @@ struct TaskQueue : public ispcrt::base::TaskQueue {
     std::shared_ptr<CommandList> m_cl_compute;
     std::shared_ptr<CommandList> m_cl_mem_h2d;
     std::shared_ptr<CommandList> m_cl_mem_d2h;
+    // Command lists of flushed batches that may still be executing and are waiting for sync to be reset
+    std::vector<std::shared_ptr<CommandList>> m_cl_submitted;
+    // Command lists that were reset and can be reused by next batches
+    std::vector<std::shared_ptr<CommandList>> m_cl_free;
+
+    // Graph the enqueued commands are recorded into, if any
+    gpu::Graph *m_capture{nullptr};
+    // Graphs replayed since the last sync and their launch events
+    std::vector<gpu::Graph *> m_replayed;
+    std::vector<Event *> m_replayed_compute_events;
 
     EventPool m_ep_compute, m_ep_copy;
+    StagingBuffer m_staging;
+    // Parameters of the inline launches that didn't fit into the staging buffer, freed on sync
+    std::vector<void *> m_params;
+    // Copies to the staging buffer that are copied to the application memory on sync
+    struct StagedCopy {
+        void *dst;
+        const void *src;
+        size_t size;
+    };
+    std::vector<StagedCopy> m_staged_to_host;
     std::vector<std::pair<Event *, Future *>> m_events_compute_list;
+    // Completed futures whose events other task queues may still wait on
+    std::vector<std::pair<Event *, Future *>> m_events_waited;
+    // Futures of other task queues the commands enqueued since the last sync wait on
+    std::vector<Future *> m_waited_futures;
 
     bool useCopyEngine{false};
+    bool m_useImmediateCommandLists{false};
+
+    // All task queues are profiled while the trace of the process is recorded
+    bool m_profiling{base::TraceFile::instance() != nullptr};
+    base::Trace m_trace{"GPU"};
+    // Copies to and from the host are profiled through events of the copy event pool, which are released at sync
+    std::vector<std::pair<Event *, Future *>> m_profiled_copies;
+    // Host clock and device timestamp read together at sync, once the profiled launches completed
+    uint64_t m_clockSyncHostNs{0};
+    uint64_t m_clockSyncDeviceTs{0};
+
+    constexpr static size_t MinStagedCopySize = 64 * 1024;
+
+    // Auto-batching policy: when either limit is non-zero, the current command lists are submitted as soon as
+    // the number of appended commands or the time since the first of them reaches the limit.
+    size_t m_batchSize{0};
+    std::chrono::microseconds m_batchTime{0};
+    size_t m_batchCommands{0};
+    std::chrono::steady_clock::time_point m_batchStart;
 
     std::shared_ptr<CommandList> createCommandList(uint32_t ordinal) {
-        std::shared_ptr<CommandList> cmdl{ new CommandList(m_device, m_context, ordinal) };
+        std::shared_ptr<CommandList> cmdl{ new CommandList(m_device, m_context, ordinal, m_useImmediateCommandLists) };
         assert(cmdl.get());
         return cmdl;
     }
 
+    std::shared_ptr<CommandList> acquireCommandList(uint32_t ordinal) {
+        for (auto it = m_cl_free.begin(); it != m_cl_free.end(); ++it) {
+            if ((*it)->ordinal() == ordinal) {
+                auto cmdl = *it;
+                m_cl_free.erase(it);
+                return cmdl;
+            }
+        }
+        return createCommandList(ordinal);
+    }
+
+    EventPool &computeEventPool() { return m_capture ? m_capture->m_ep_compute : m_ep_compute; }
+    EventPool &copyEventPool() { return m_capture ? m_capture->m_ep_copy : m_ep_copy; }
+
+    void freeParams() {
+        for (auto *p : m_params)
+            L0_SAFE_CALL_NOEXCEPT(zeMemFree(m_context, p));
+        m_params.clear();
+    }
+
+    // Host memory for the parameters of inline launches. The kernel reads them from host memory directly, so
+    // there is no copy command to wait for. They are placed into the staging buffer, which is not reused until
+    // sync, when it has room left.
+    void *reserveParams(size_t size) {
+        void *param_ptr = m_capture ? nullptr : m_staging.reserve(size);
+        if (!param_ptr) {
+            ze_host_mem_alloc_desc_t host_desc = {};
+            L0_SAFE_CALL(zeMemAllocHost(m_context, &host_desc, size, StagingBuffer::Alignment, &param_ptr));
+            (m_capture ? m_capture->m_params : m_params).push_back(param_ptr);
+        }
+        return param_ptr;
+    }
+
+    ispcrt::base::Future *enqueueLaunch(gpu::Kernel &kernel, void *param_ptr, size_t dim0, size_t dim1,
+                                        size_t dim2) {
+        auto event = computeEventPool().createEvent();
+        if (event == nullptr)
+            throw std::runtime_error("Failed to create event!");
+        try {
+            appendLaunch(kernel, param_ptr, dim0, dim1, dim2, event->handle());
+        } catch (ispcrt::base::ispcrt_runtime_error &e) {
+            // cleanup and rethrow
+            computeEventPool().deleteEvent(event);
+            throw e;
+        }
+        return addLaunchFuture(kernel, event);
+    }
+
+    // Append the launch to the compute command list, signaling 'event' if it's not nullptr
+    void appendLaunch(gpu::Kernel &kernel, void *param_ptr, size_t dim0, size_t dim1, size_t dim2,
+                      ze_event_handle_t event) {
+        // If param_ptr is nullptr, it was not set on host, so do not set kernel argument.
+        if (param_ptr != nullptr) {
+            L0_SAFE_CALL(zeKernelSetArgumentValue(kernel.handle(), 0, sizeof(void *), &param_ptr));
+        }
+
+        std::array<uint32_t, 3> suggestedGroupSize = {0};
+        L0_SAFE_CALL(zeKernelSuggestGroupSize(kernel.handle(), uint32_t(dim0), uint32_t(dim1), uint32_t(dim2),
+                                              &suggestedGroupSize[0], &suggestedGroupSize[1], &suggestedGroupSize[2]));
+        // TODO: Is this needed? Didn't find info in spec on the valid values that zeKernelSuggestGroupSize will return
+        suggestedGroupSize[0] = std::max(suggestedGroupSize[0], uint32_t(1));
+        suggestedGroupSize[1] = std::max(suggestedGroupSize[1], uint32_t(1));
+        suggestedGroupSize[2] = std::max(suggestedGroupSize[2], uint32_t(1));
+
+        L0_SAFE_CALL(
+            zeKernelSetGroupSize(kernel.handle(), suggestedGroupSize[0], suggestedGroupSize[1], suggestedGroupSize[2]));
+
+        const ze_group_count_t dispatchTraits = {uint32_t(dim0) / suggestedGroupSize[0],
+                                                 uint32_t(dim1) / suggestedGroupSize[1],
+                                                 uint32_t(dim2) / suggestedGroupSize[2]};
+        L0_SAFE_CALL(zeCommandListAppendLaunchKernel(
+            m_cl_compute->handle(), kernel.handle(), &dispatchTraits, event,
+            (uint32_t)m_cl_mem_h2d->getEventHandlers().size(), m_cl_mem_h2d->getEventHandlers().data()));
+        m_cl_compute->inc();
+    }
+
+    ispcrt::base::Future *addLaunchFuture(gpu::Kernel &kernel, Event *event) {
+        auto *future = new gpu::Future(event);
+        assert(future);
+        m_events_compute_list.push_back(std::make_pair(event, future));
+        // Launches replayed from graphs are not profiled, their futures are updated by each replay
+        if (m_profiling && !m_capture) {
+            future->m_timestamps.submitNs = base::profilingClockNs();
+            m_trace.add(kernel.name(), future);
+        }
+        commandAdded();
+
+        return future;
+    }
+
+    // Event to signal by a profiled copy to or from the host, nullptr if the copy is not profiled. The copy is
+    // recorded in the trace through a future which is completed at sync.
+    Event *profileCopy(const char *name) {
+        if (!m_profiling || m_capture) {
+            return nullptr;
+        }
+        Event *event = m_ep_copy.getEvent();
+        auto *future = new gpu::Future(nullptr);
+        assert(future);
+        future->m_timestamps.submitNs = base::profilingClockNs();
+        m_trace.add(name, future, true);
+        m_profiled_copies.push_back(std::make_pair(event, future));
+        return event;
+    }
+
+    // Part of the staging buffer to copy the view through or nullptr to copy it directly. The driver copies small
+    // views from pageable memory at no extra cost, and graphs replay their copies long after they were recorded.
+    void *stagingPtr(ispcrt::base::MemoryView &view) {
+        if (m_capture || view.isShared() || view.numBytes() < MinStagedCopySize || !view.hostPtr())
+            return nullptr;
+        return m_staging.reserve(view.numBytes());
+    }
+
+    // Exchange the command lists and launches of the task queue with the ones of the graph being captured
+    void swapCapture() {
+        std::swap(m_cl_compute, m_capture->m_cl_compute);
+        std::swap(m_cl_mem_h2d, m_capture->m_cl_mem_h2d);
+        std::swap(m_cl_mem_d2h, m_capture->m_cl_mem_d2h);
+        std::swap(m_events_compute_list, m_capture->m_events_compute_list);
+    }
+
+    // There is no command queue behind immediate command lists, so wait for each list that has commands
+    // on a barrier appended to it.
+    void synchronizeImmediateCommandLists() {
+        std::vector<CommandList *> lists;
+        for (const auto &cl : {m_cl_mem_h2d, m_cl_compute, m_cl_mem_d2h}) {
+            if (cl->count() > 0 && std::find(lists.begin(), lists.end(), cl.get()) == lists.end()) {
+                lists.push_back(cl.get());
+            }
+        }
+        for (auto *cl : lists) {
+            cl->hostSynchronize(m_ep_copy.getEvent());
+        }
+    }
+
+    void completeFuture(EventPool &pool, Event *e, Future *f) {
+        ze_kernel_timestamp_result_t tsResult = {};
+        L0_SAFE_CALL(zeEventQueryKernelTimestamp(e->handle(), &tsResult));
+        if (tsResult.context.kernelEnd >= tsResult.context.kernelStart) {
+            f->m_time = (tsResult.context.kernelEnd - tsResult.context.kernelStart);
+        } else {
+            // If we overflow kernelEnd counter then this method
+            // should be used for calculate time.
+            f->m_time = ((pool.getTimestampMaxValue() - tsResult.context.kernelStart) + tsResult.context.kernelEnd + 1);
+        }
+        f->m_time *= pool.getTimestampRes();
+        if (f->m_timestamps.submitNs != 0) {
+            f->m_timestamps.startNs = hostClockNs(pool, tsResult.global.kernelStart);
+            f->m_timestamps.endNs = hostClockNs(pool, tsResult.global.kernelEnd);
+        }
+        f->m_valid = true;
+    }
+
+    // Convert a kernel timestamp of a completed launch to the host clock. The kernel timestamps only keep the
+    // low bits of the device timer, so they are taken relative to a device timestamp read at sync.
+    uint64_t hostClockNs(EventPool &pool, uint64_t kernelTs) {
+        if (m_clockSyncHostNs == 0) {
+            uint64_t hostTs = 0;
+            L0_SAFE_CALL(zeDeviceGetGlobalTimestamps(m_device, &hostTs, &m_clockSyncDeviceTs));
+            m_clockSyncHostNs = base::profilingClockNs();
+        }
+        const uint64_t ticks = (m_clockSyncDeviceTs - kernelTs) & pool.getTimestampMaxValue();
+        return m_clockSyncHostNs - ticks * pool.getTimestampRes();
+    }
+
+    // Release the event of a completed future. Other task queues may wait on it in command lists that were not
+    // executed yet, so then it is kept until a next sync.
+    void releaseEvent(Event *e, Future *f) {
+        if (f->m_waiters > 0) {
+            m_events_waited.push_back(std::make_pair(e, f));
+            return;
+        }
+        f->m_event = nullptr;
+        f->refDec();
+        m_ep_compute.deleteEvent(e);
+    }
+
+    void commandAdded() {
+        if (m_capture || (m_batchSize == 0 && m_batchTime.count() == 0)) {
+            return;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (m_batchCommands++ == 0) {
+            m_batchStart = now;
+        }
+        if ((m_batchSize > 0 && m_batchCommands >= m_batchSize) ||
+            (m_batchTime.count() > 0 && now - m_batchStart >= m_batchTime)) {
+            flushBatch();
+        }
+    }
+
+    // Submit the current batch and continue appending commands to fresh command lists. Command lists are
+    // executed in submission order on their queue, while copy events of all batches since last sync are kept as
+    // dependencies of next kernel launches since they may run on a different queue.
+    void flushBatch() {
+        submit();
+        const std::vector<Event *> copyEvents = m_cl_mem_h2d->events();
+        const bool sharedCommandList = m_cl_mem_h2d == m_cl_compute;
+
+        if (sharedCommandList) {
+            rotateCommandList(m_cl_compute);
+            m_cl_mem_h2d = m_cl_compute;
+            m_cl_mem_d2h = m_cl_compute;
+        } else {
+            rotateCommandList(m_cl_compute);
+            rotateCommandList(m_cl_mem_h2d);
+            rotateCommandList(m_cl_mem_d2h);
+        }
+        if (m_cl_mem_h2d->events().empty()) {
+            for (const auto &ev : copyEvents) {
+                m_cl_mem_h2d->addEvent(ev);
+            }
+        }
+        m_batchCommands = 0;
+    }
+
+    // Replace submitted command list with a free one, empty command lists are kept as is.
+    void rotateCommandList(std::shared_ptr<CommandList> &cmdl) {
+        if (cmdl->count() == 0) {
+            return;
+        }
+        m_cl_submitted.push_back(cmdl);
+        cmdl = acquireCommandList(cmdl->ordinal());
+    }
+
     std::shared_ptr<CommandQueue> createCommandQueue(uint32_t ordinal) {
         std::shared_ptr<CommandQueue> cmdq{ new CommandQueue(m_device, m_context, ordinal) };
         return cmdq;
@@ -1431,10 +2419,12 @@ static ze_driver_handle_t deviceDiscovery(bool *p_is_mock) {
         print_env(ISPCRT_DISABLE_COPY_ENGINE);
         print_env(ISPCRT_IGC_OPTIONS);
         print_env(ISPCRT_USE_ZEBIN);
+        print_env(ISPCRT_MODULE_CACHE_DIR);
         print_env(ISPCRT_MAX_KERNEL_LAUNCHES);
         print_env(ISPCRT_MEM_POOL);
         print_env(ISPCRT_MEM_POOL_MIN_CHUNK_POW2);
         print_env(ISPCRT_MEM_POOL_MAX_CHUNK_POW2);
+        print_env(ISPCRT_STAGING_BUFFER_MB);
     }
 
     static ze_driver_handle_t selectedDriver = nullptr;
@@ -1496,6 +2486,8 @@ ISPCRTDeviceInfo deviceInfo(uint32_t deviceIdx) {
     L0_SAFE_CALL(zeDeviceGetProperties(g_deviceList[deviceIdx], &dp));
     info.deviceId = dp.deviceId;
     info.vendorId = dp.vendorId;
+    info.subDeviceCount = 0;
+    L0_SAFE_CALL(zeDeviceGetSubDevices(g_deviceList[deviceIdx], &info.subDeviceCount, nullptr));
     return info;
 }
 
@@ -1586,17 +2578,68 @@ GPUDevice::GPUDevice(void* nativeContext, void* nativeDevice, uint32_t deviceIdx
     }
     if (!m_context)
         throw std::runtime_error("failed to create GPU context");
+
+    m_memPools = std::unique_ptr<gpu::MemPools>(
+        new gpu::MemPools((ze_context_handle_t)m_context, (ze_device_handle_t)m_device));
+}
+
+GPUDevice::GPUDevice(const GPUDevice &parent, void *nativeSubDevice)
+    : m_driver(parent.m_driver), m_device(nativeSubDevice), m_context(parent.m_context), m_is_mock(parent.m_is_mock),
+      m_has_context_ownership(false), m_parent(&parent) {
+    // The context must outlive the sub-device
+    m_parent->refInc();
+    m_memPools = std::unique_ptr<gpu::MemPools>(
+        new gpu::MemPools((ze_context_handle_t)m_context, (ze_device_handle_t)m_device));
 }
 
 GPUDevice::~GPUDevice() {
+    // Destroy mem pools earlier than context, because context is used inside mem pools to deallocate memory.
+    m_memPools.reset();
     // Destroy context if it was created in GPUDevice.
     if (m_context && m_has_context_ownership)
         L0_SAFE_CALL_NOEXCEPT(zeContextDestroy((ze_context_handle_t)m_context));
+    if (m_parent)
+        m_parent->refDec();
 }
 
 base::MemoryView *GPUDevice::newMemoryView(void *appMem, size_t numBytes, const ISPCRTNewMemoryViewFlags *flags) const {
-    return new gpu::MemoryView((ze_context_handle_t)m_context,
-                               (ze_device_handle_t)m_device, appMem, numBytes, flags, nullptr);
+    return new gpu::MemoryView((ze_context_handle_t)m_context, (ze_device_handle_t)m_device, appMem, numBytes, flags,
+                               this, m_memPools->get(flags));
+}
+
+base::MemoryView *GPUDevice::importMemoryView(void *memBuffer, size_t numBytes) const {
+    if (!memBuffer)
+        throw base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "Imported memory pointer is NULL!");
+    ISPCRTNewMemoryViewFlags flags = {ISPCRT_ALLOC_TYPE_DEVICE, ISPCRT_SM_HOST_DEVICE_READ_WRITE};
+    switch (getMemAllocType(memBuffer)) {
+    case ISPCRT_ALLOC_TYPE_DEVICE:
+        break;
+    case ISPCRT_ALLOC_TYPE_SHARED:
+    case ISPCRT_ALLOC_TYPE_HOST:
+        // Host USM is accessible from the device the same way as shared memory
+        flags.allocType = ISPCRT_ALLOC_TYPE_SHARED;
+        break;
+    default:
+        throw base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT,
+                                         "Only USM allocations can be imported into a memory view!");
+    }
+    auto *view = new gpu::MemoryView((ze_context_handle_t)m_context, (ze_device_handle_t)m_device, nullptr, numBytes,
+                                     &flags, this, nullptr);
+    view->importPtr(memBuffer);
+    return view;
+}
+
+base::MemoryView *GPUDevice::importDmaBufMemoryView(int fd, size_t numBytes) const {
+    ISPCRTNewMemoryViewFlags flags = {ISPCRT_ALLOC_TYPE_DEVICE, ISPCRT_SM_HOST_DEVICE_READ_WRITE};
+    auto *view = new gpu::MemoryView((ze_context_handle_t)m_context, (ze_device_handle_t)m_device, nullptr, numBytes,
+                                     &flags, this, nullptr);
+    try {
+        view->importDmaBuf(fd);
+    } catch (...) {
+        view->refDec();
+        throw;
+    }
+    return view;
 }
 
 base::TaskQueue *GPUDevice::newTaskQueue() const {
@@ -1604,7 +2647,28 @@ base::TaskQueue *GPUDevice::newTaskQueue() const {
 }
 
 base::Module *GPUDevice::newModule(const char *moduleFile, const ISPCRTModuleOptions &opts) const {
-    return new gpu::Module((ze_device_handle_t)m_device, (ze_context_handle_t)m_context, moduleFile, m_is_mock, opts);
+    return new gpu::Module((ze_driver_handle_t)m_driver, (ze_device_handle_t)m_device, (ze_context_handle_t)m_context,
+                           moduleFile, m_is_mock, opts);
+}
+
+base::Module *GPUDevice::newModuleFromMemory(const void *image, size_t size, ISPCRTModuleImageFormat format,
+                                             const ISPCRTModuleOptions &opts) const {
+    throw base::ispcrt_runtime_error(ISPCRT_UNSUPPORTED, "Loading modules from memory is only supported on CPU");
+}
+
+uint32_t GPUDevice::subDeviceCount() const {
+    uint32_t count = 0;
+    L0_SAFE_CALL(zeDeviceGetSubDevices((ze_device_handle_t)m_device, &count, nullptr));
+    return count;
+}
+
+base::Device *GPUDevice::subDevice(uint32_t subDeviceIdx) const {
+    uint32_t count = subDeviceCount();
+    if (subDeviceIdx >= count)
+        throw base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "Invalid sub-device number!");
+    std::vector<ze_device_handle_t> subDevices(count);
+    L0_SAFE_CALL(zeDeviceGetSubDevices((ze_device_handle_t)m_device, &count, subDevices.data()));
+    return new GPUDevice(*this, subDevices[subDeviceIdx]);
 }
 
 void GPUDevice::dynamicLinkModules(base::Module **modules, const uint32_t numModules) const {
@@ -1616,7 +2680,7 @@ base::Module *GPUDevice::staticLinkModules(base::Module **modules, const uint32_
 }
 
 base::Kernel *GPUDevice::newKernel(const base::Module &module, const char *name) const {
-    return new gpu::Kernel(module, name);
+    return new gpu::Kernel(module, name, (ze_device_handle_t)m_device);
 }
 
 void *GPUDevice::platformNativeHandle() const { return m_driver; }
@@ -1659,38 +2723,24 @@ GPUContext::GPUContext(void *nativeContext) {
     if (!m_context)
         throw std::runtime_error("failed to create GPU context");
 
-    ze_context_handle_t ctxt = (ze_context_handle_t) m_context;
-    m_memPoolHWDR = std::unique_ptr<gpu::ChunkedPool>(new gpu::ChunkedPool(ISPCRT_SM_HOST_WRITE_DEVICE_READ, ctxt));
-    m_memPoolHRDW = std::unique_ptr<gpu::ChunkedPool>(new gpu::ChunkedPool(ISPCRT_SM_HOST_READ_DEVICE_WRITE, ctxt));
+    // Device is not known for context, so memory pools are only for shared memory
+    m_memPools = std::unique_ptr<gpu::MemPools>(new gpu::MemPools((ze_context_handle_t)m_context, nullptr));
 }
 
 GPUContext::~GPUContext() {
     // Destroy mem pools earlier than context, because context is used inside mem pools to deallocate memory.
-    m_memPoolHWDR.reset();
-    m_memPoolHRDW.reset();
+    m_memPools.reset();
     if (m_context && m_has_context_ownership)
         L0_SAFE_CALL_NOEXCEPT(zeContextDestroy((ze_context_handle_t)m_context));
 }
 
 base::MemoryView *GPUContext::newMemoryView(void *appMem, size_t numBytes, const ISPCRTNewMemoryViewFlags *flags) const {
-    return new gpu::MemoryView((ze_context_handle_t)m_context, nullptr, appMem, numBytes, flags, this);
+    return new gpu::MemoryView((ze_context_handle_t)m_context, nullptr, appMem, numBytes, flags, this,
+                               m_memPools->get(flags));
 }
 
 ISPCRTDeviceType GPUContext::getDeviceType() const { return ISPCRTDeviceType::ISPCRT_DEVICE_TYPE_GPU; }
 
 void *GPUContext::contextNativeHandle() const { return m_context; }
 
-gpu::ChunkedPool *GPUContext::memPool(ISPCRTSharedMemoryAllocationHint type) const {
-    switch (type) {
-        case ISPCRT_SM_HOST_DEVICE_READ_WRITE:
-            throw std::runtime_error("MemPool for shared memory with HOST_DEVICE_READ_WRITE is not supported");
-        case ISPCRT_SM_HOST_WRITE_DEVICE_READ:
-            return m_memPoolHWDR.get();
-        case ISPCRT_SM_HOST_READ_DEVICE_WRITE:
-            return m_memPoolHRDW.get();
-        default:
-            throw std::runtime_error("requested incorrect MemPool");
-    }
-}
-
 } // namespace ispcrt
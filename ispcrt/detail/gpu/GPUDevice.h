@@ -8,6 +8,7 @@
 #include "../Future.h"
 
 // std
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
@@ -18,26 +19,37 @@ namespace gpu {
 uint32_t deviceCount();
 ISPCRTDeviceInfo deviceInfo(uint32_t deviceIdx);
 
+class MemPools;
+
 }; // gpu
 
 struct GPUDevice : public base::Device {
 
     GPUDevice();
     GPUDevice(void* nativeContext, void* nativeDevice, uint32_t deviceIdx);
+    // Sub-device of 'parent', using its context
+    GPUDevice(const GPUDevice &parent, void *nativeSubDevice);
 
     ~GPUDevice();
 
     base::MemoryView *newMemoryView(void *appMem, size_t numBytes, const ISPCRTNewMemoryViewFlags *flags) const override;
+    base::MemoryView *importMemoryView(void *memBuffer, size_t numBytes) const override;
+    base::MemoryView *importDmaBufMemoryView(int fd, size_t numBytes) const override;
 
     base::TaskQueue *newTaskQueue() const override;
 
     base::Module *newModule(const char *moduleFile, const ISPCRTModuleOptions &opts) const override;
+    base::Module *newModuleFromMemory(const void *image, size_t size, ISPCRTModuleImageFormat format,
+                                      const ISPCRTModuleOptions &opts) const override;
 
     void dynamicLinkModules(base::Module **modules, const uint32_t numModules) const override;
     base::Module *staticLinkModules(base::Module **modules, const uint32_t numModules) const override;
 
     base::Kernel *newKernel(const base::Module &module, const char *name) const override;
 
+    uint32_t subDeviceCount() const override;
+    base::Device *subDevice(uint32_t subDeviceIdx) const override;
+
     void *platformNativeHandle() const override;
     void *deviceNativeHandle() const override;
     void *contextNativeHandle() const override;
@@ -50,6 +62,9 @@ struct GPUDevice : public base::Device {
     void *m_context{nullptr};
     bool  m_is_mock{false};
     bool  m_has_context_ownership{true};
+    // The device of a sub-device, which owns the context
+    const GPUDevice *m_parent{nullptr};
+    std::unique_ptr<gpu::MemPools> m_memPools;
 };
 
 } // namespace ispcrt
@@ -0,0 +1,282 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+  This file implements ISPCInstrument(), the function that ispc-generated
+  code calls at every instrumentation point of programs compiled with
+  --instrument, as a low-overhead profiler of SIMD efficiency.
+
+  Each thread counts the calls, the active program instances and the calls
+  with no active program instances of every instrumentation point in a
+  table of its own, so no locks or atomics are taken on the fast path.  The
+  points are identified by the addresses of the file name and note strings
+  passed by the generated code together with the line number, which needs
+  no string operations.  The tables of all threads are merged by file name,
+  line and note when the report is written, at exit or when
+  ISPCInstrumentReport() is called.
+
+  The report lists the points with the lowest SIMD efficiency (active
+  program instances / gang width) weighted by their share of all calls,
+  which are the places where divergence costs the most.  The gang width is
+  the width of the widest mask seen, unless it is set with the
+  ISPC_INSTRUMENT_WIDTH environment variable.  It is printed to stderr, or
+  to the file named by ISPC_INSTRUMENT_OUTPUT, and lists ISPC_INSTRUMENT_TOP
+  points (20 by default, 0 for all of them).
+*/
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <tuple>
+#include <vector>
+
+extern "C" {
+void ISPCInstrument(const char *fn, const char *note, int line, uint64_t mask);
+void ISPCInstrumentReport();
+}
+
+namespace {
+
+struct Counters {
+    const char *fn{nullptr};
+    const char *note{nullptr};
+    int line{0};
+    uint64_t calls{0};
+    uint64_t lanes{0};
+    uint64_t allOff{0};
+    uint64_t maskBits{0};
+};
+
+// Open addressing hash table of the instrumentation points seen by one thread.
+class ThreadCounters {
+  public:
+    ThreadCounters() : m_entries(256) {}
+
+    Counters &get(const char *fn, const char *note, int line) {
+        size_t mask = m_entries.size() - 1;
+        size_t i = hash(fn, note, line) & mask;
+        while (true) {
+            Counters &c = m_entries[i];
+            if (c.fn == fn && c.note == note && c.line == line) {
+                return c;
+            }
+            if (c.fn == nullptr) {
+                if (2 * (m_used + 1) > m_entries.size()) {
+                    grow();
+                    return get(fn, note, line);
+                }
+                c.fn = fn;
+                c.note = note;
+                c.line = line;
+                m_used++;
+                return c;
+            }
+            i = (i + 1) & mask;
+        }
+    }
+
+    const std::vector<Counters> &entries() const { return m_entries; }
+
+  private:
+    static size_t hash(const char *fn, const char *note, int line) {
+        uint64_t h = (uint64_t)(uintptr_t)fn * 0x9E3779B97F4A7C15ull;
+        h ^= (uint64_t)(uintptr_t)note + 0x7F4A7C15ull + (h << 6) + (h >> 2);
+        h ^= (uint64_t)line * 0xC2B2AE3D27D4EB4Full;
+        return (size_t)(h ^ (h >> 29));
+    }
+
+    void grow() {
+        std::vector<Counters> old(m_entries.size() * 2);
+        old.swap(m_entries);
+        m_used = 0;
+        for (const Counters &c : old) {
+            if (c.fn != nullptr) {
+                Counters &n = get(c.fn, c.note, c.line);
+                n.calls = c.calls;
+                n.lanes = c.lanes;
+                n.allOff = c.allOff;
+                n.maskBits = c.maskBits;
+            }
+        }
+    }
+
+    std::vector<Counters> m_entries;
+    size_t m_used{0};
+};
+
+// Tables of all threads, kept until the end of the program so that threads that exited are reported too.
+struct Registry {
+    std::mutex lock;
+    std::vector<std::unique_ptr<ThreadCounters>> threads;
+    bool atExitRegistered{false};
+};
+
+Registry &registry() {
+    // Never destroyed, the report is written from an atexit() handler.
+    static Registry *r = new Registry;
+    return *r;
+}
+
+void reportAtExit() { ISPCInstrumentReport(); }
+
+ThreadCounters &threadCounters() {
+    static thread_local ThreadCounters *counters = nullptr;
+    if (counters == nullptr) {
+        Registry &r = registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        r.threads.emplace_back(new ThreadCounters);
+        counters = r.threads.back().get();
+        if (!r.atExitRegistered) {
+            r.atExitRegistered = true;
+            atexit(reportAtExit);
+        }
+    }
+    return *counters;
+}
+
+int envInt(const char *name, int defaultValue) {
+    const char *value = getenv(name);
+    return (value != nullptr && *value != '\0') ? atoi(value) : defaultValue;
+}
+
+int popcount(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(v);
+#else
+    int n = 0;
+    for (; v != 0; v &= v - 1) {
+        n++;
+    }
+    return n;
+#endif
+}
+
+} // namespace
+
+void ISPCInstrument(const char *fn, const char *note, int line, uint64_t mask) {
+    Counters &c = threadCounters().get(fn, note, line);
+    c.calls++;
+    c.lanes += popcount(mask);
+    c.allOff += mask == 0;
+    c.maskBits |= mask;
+}
+
+void ISPCInstrumentReport() {
+    struct Point {
+        std::string fn;
+        int line;
+        std::string note;
+        uint64_t calls;
+        uint64_t lanes;
+        uint64_t allOff;
+    };
+
+    // Merge the tables of all threads. The same point may be seen with different string addresses, for example when
+    // it is compiled for several targets, so they are merged by the contents of the strings.
+    std::map<std::tuple<std::string, int, std::string>, Point> points;
+    uint64_t maskBits = 0, totalCalls = 0;
+    {
+        Registry &r = registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        for (const auto &t : r.threads) {
+            for (const Counters &c : t->entries()) {
+                if (c.fn == nullptr || c.calls == 0) {
+                    continue;
+                }
+                Point &p = points[std::make_tuple(std::string(c.fn), c.line, std::string(c.note))];
+                p.fn = c.fn;
+                p.line = c.line;
+                p.note = c.note;
+                p.calls += c.calls;
+                p.lanes += c.lanes;
+                p.allOff += c.allOff;
+                maskBits |= c.maskBits;
+                totalCalls += c.calls;
+            }
+        }
+    }
+    if (points.empty()) {
+        return;
+    }
+
+    int width = envInt("ISPC_INSTRUMENT_WIDTH", 0);
+    if (width <= 0) {
+        // Round up the widest mask to a power of two, gangs are 4 to 64 wide.
+        width = 4;
+        while (width < 64 && (maskBits >> width) != 0) {
+            width *= 2;
+        }
+    }
+
+    std::vector<Point> sorted;
+    for (auto &p : points) {
+        sorted.push_back(p.second);
+    }
+    // Lanes wasted at a point, relative to all the lanes of all the calls, is what divergence there costs.
+    auto wasted = [width](const Point &p) { return (double)p.calls * width - (double)p.lanes; };
+    std::sort(sorted.begin(), sorted.end(), [&](const Point &a, const Point &b) { return wasted(a) > wasted(b); });
+
+    FILE *out = stderr;
+    const char *outName = getenv("ISPC_INSTRUMENT_OUTPUT");
+    if (outName != nullptr && *outName != '\0') {
+        out = fopen(outName, "w");
+        if (out == nullptr) {
+            fprintf(stderr, "ISPCInstrument: cannot open %s, writing the report to stderr\n", outName);
+            out = stderr;
+        }
+    }
+
+    uint64_t totalLanes = 0;
+    for (const Point &p : sorted) {
+        totalLanes += p.lanes;
+    }
+    fprintf(out, "ISPC SIMD efficiency: %zu instrumentation points, %llu calls, gang width %d, %.2f%% active lanes\n",
+            sorted.size(), (unsigned long long)totalCalls, width, 100.0 * totalLanes / ((double)totalCalls * width));
+    fprintf(out, "%10s %8s %8s %8s  %s\n", "calls", "calls%", "active%", "alloff%", "location");
+    int top = envInt("ISPC_INSTRUMENT_TOP", 20);
+    size_t count = top > 0 ? std::min(sorted.size(), (size_t)top) : sorted.size();
+    for (size_t i = 0; i < count; i++) {
+        const Point &p = sorted[i];
+        fprintf(out, "%10llu %7.2f%% %7.2f%% %7.2f%%  %s:%d %s\n", (unsigned long long)p.calls,
+                100.0 * p.calls / totalCalls, 100.0 * p.lanes / ((double)p.calls * width), 100.0 * p.allOff / p.calls,
+                p.fn.c_str(), p.line, p.note.c_str());
+    }
+    if (out != stderr) {
+        fclose(out);
+    }
+}
@@ -0,0 +1,332 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+  This file implements ISPCPerfCountersBegin() and ISPCPerfCountersEnd(),
+  the functions that the exported functions of programs compiled with
+  --instrument=perfcounters call on entry and exit, to measure them with the
+  hardware performance counters of the CPU.
+
+  On Linux, each thread opens a group of perf events the first time it calls
+  an exported function: cycles, instructions, L1 data cache read misses and
+  last level cache misses, plus the raw event given in hexadecimal by the
+  ISPC_PERFCOUNTERS_FP_EVENT environment variable, if any, which is meant to
+  count floating point operations since there is no portable event for them
+  (for example 0x1c7 counts FP_ARITH_INST_RETIRED.SCALAR_DOUBLE on recent
+  Intel CPUs).  Events that can't be opened, like in some virtual machines
+  or when kernel.perf_event_paranoid forbids it, are reported as missing.
+  On other systems, and when no event can be opened, only the calls and the
+  elapsed time are measured.
+
+  The counters only count the thread calling the exported function, so the
+  work of tasks run by other threads isn't included; set ISPC_NUM_THREADS=1
+  to run them on the calling thread when measuring functions that launch
+  tasks.  Nested calls of exported functions are included in the counts of
+  the functions calling them.
+
+  Each thread adds the differences of the counters between entry and exit to
+  a table of its own, keyed by the address of the function name string, so
+  no locks are taken while measuring.  The tables of all threads are merged
+  by function name when the report is written, at exit or when
+  ISPCPerfCountersReport() is called, to stderr or to the file named by
+  ISPC_PERFCOUNTERS_OUTPUT.  It lists the instructions per cycle of each
+  function and, with the floating point event, its floating point operations
+  per byte loaded from memory, counting a cache line per last level cache
+  miss.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+extern "C" {
+void ISPCPerfCountersBegin(const char *function);
+void ISPCPerfCountersEnd(const char *function);
+void ISPCPerfCountersReport();
+}
+
+namespace {
+
+enum Event { Cycles, Instructions, L1DMisses, LLCMisses, FPOps, NumEvents };
+
+const char *eventNames[NumEvents] = {"cycles", "instructions", "L1D read misses", "LLC misses", "FP ops"};
+
+struct Counts {
+    uint64_t calls{0};
+    uint64_t nanoseconds{0};
+    uint64_t events[NumEvents]{};
+};
+
+uint64_t nanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// The perf events of one thread, read together as a group.
+class EventGroup {
+  public:
+    EventGroup() {
+#ifdef __linux__
+        const uint64_t l1dReadMiss = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        open(Cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        open(Instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        open(L1DMisses, PERF_TYPE_HW_CACHE, l1dReadMiss);
+        open(LLCMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        const char *fpEvent = getenv("ISPC_PERFCOUNTERS_FP_EVENT");
+        if (fpEvent != nullptr && *fpEvent != '\0') {
+            open(FPOps, PERF_TYPE_RAW, strtoull(fpEvent, nullptr, 16));
+        }
+#endif
+    }
+
+    ~EventGroup() {
+#ifdef __linux__
+        for (int fd : m_fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    EventGroup(const EventGroup &) = delete;
+    EventGroup &operator=(const EventGroup &) = delete;
+
+    // Current values of the events, zero for the events that are missing.
+    void read(uint64_t values[NumEvents]) const {
+        std::fill(values, values + NumEvents, 0);
+#ifdef __linux__
+        if (m_leader < 0) {
+            return;
+        }
+        // PERF_FORMAT_GROUP: the number of events, then their values in the order they were opened.
+        uint64_t buffer[1 + NumEvents];
+        if (::read(m_leader, buffer, sizeof(buffer)) < (ssize_t)sizeof(uint64_t)) {
+            return;
+        }
+        for (uint64_t i = 0; i < buffer[0] && i < m_order.size(); i++) {
+            values[m_order[i]] = buffer[1 + i];
+        }
+#endif
+    }
+
+    bool available(Event e) const { return m_fds[e] >= 0; }
+
+  private:
+#ifdef __linux__
+    void open(Event e, uint32_t type, uint64_t config) {
+        perf_event_attr attr = {};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.read_format = PERF_FORMAT_GROUP;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        int fd = (int)syscall(SYS_perf_event_open, &attr, 0 /* this thread */, -1 /* any CPU */, m_leader, 0);
+        if (fd < 0) {
+            return;
+        }
+        if (m_leader < 0) {
+            m_leader = fd;
+        }
+        m_fds[e] = fd;
+        m_order.push_back(e);
+    }
+
+    int m_leader{-1};
+    std::vector<Event> m_order;
+#endif
+    int m_fds[NumEvents]{-1, -1, -1, -1, -1};
+};
+
+struct Frame {
+    const char *function;
+    uint64_t nanoseconds;
+    uint64_t events[NumEvents];
+};
+
+struct ThreadCounts {
+    std::unordered_map<const char *, Counts> functions;
+    bool available[NumEvents]{};
+};
+
+// Tables of all threads, kept until the end of the program so that threads that exited are reported too.
+struct Registry {
+    std::mutex lock;
+    std::vector<std::unique_ptr<ThreadCounts>> threads;
+    bool atExitRegistered{false};
+};
+
+Registry &registry() {
+    // Never destroyed, the report is written from an atexit() handler.
+    static Registry *r = new Registry;
+    return *r;
+}
+
+void reportAtExit() { ISPCPerfCountersReport(); }
+
+struct ThreadState {
+    ThreadState() {
+        Registry &r = registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        r.threads.emplace_back(new ThreadCounts);
+        counts = r.threads.back().get();
+        for (int e = 0; e < NumEvents; e++) {
+            counts->available[e] = events.available((Event)e);
+        }
+        if (!r.atExitRegistered) {
+            r.atExitRegistered = true;
+            atexit(reportAtExit);
+        }
+    }
+
+    EventGroup events;
+    std::vector<Frame> stack;
+    ThreadCounts *counts{nullptr};
+};
+
+ThreadState &threadState() {
+    static thread_local ThreadState state;
+    return state;
+}
+
+} // namespace
+
+void ISPCPerfCountersBegin(const char *function) {
+    ThreadState &t = threadState();
+    t.stack.emplace_back();
+    Frame &f = t.stack.back();
+    f.function = function;
+    f.nanoseconds = nanoseconds();
+    t.events.read(f.events);
+}
+
+void ISPCPerfCountersEnd(const char *function) {
+    uint64_t events[NumEvents];
+    ThreadState &t = threadState();
+    t.events.read(events);
+    const uint64_t end = nanoseconds();
+    if (t.stack.empty() || t.stack.back().function != function) {
+        return;
+    }
+    const Frame &f = t.stack.back();
+    Counts &c = t.counts->functions[function];
+    c.calls++;
+    c.nanoseconds += end - f.nanoseconds;
+    for (int e = 0; e < NumEvents; e++) {
+        c.events[e] += events[e] - f.events[e];
+    }
+    t.stack.pop_back();
+}
+
+void ISPCPerfCountersReport() {
+    std::map<std::string, Counts> functions;
+    bool available[NumEvents]{};
+    {
+        Registry &r = registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        for (const auto &t : r.threads) {
+            for (int e = 0; e < NumEvents; e++) {
+                available[e] |= t->available[e];
+            }
+            // The same function is seen with different string addresses when several modules export it.
+            for (const auto &p : t->functions) {
+                Counts &c = functions[p.first];
+                c.calls += p.second.calls;
+                c.nanoseconds += p.second.nanoseconds;
+                for (int e = 0; e < NumEvents; e++) {
+                    c.events[e] += p.second.events[e];
+                }
+            }
+        }
+    }
+    if (functions.empty()) {
+        return;
+    }
+
+    std::vector<std::pair<std::string, Counts>> sorted(functions.begin(), functions.end());
+    std::sort(sorted.begin(), sorted.end(), [](const std::pair<std::string, Counts> &a,
+                                               const std::pair<std::string, Counts> &b) {
+        return a.second.nanoseconds > b.second.nanoseconds;
+    });
+
+    FILE *out = stderr;
+    const char *outName = getenv("ISPC_PERFCOUNTERS_OUTPUT");
+    if (outName != nullptr && *outName != '\0') {
+        out = fopen(outName, "w");
+        if (out == nullptr) {
+            fprintf(stderr, "ISPCPerfCounters: cannot open %s, writing the report to stderr\n", outName);
+            out = stderr;
+        }
+    }
+
+    std::string missing;
+    for (int e = 0; e < NumEvents; e++) {
+        if (!available[e]) {
+            missing += missing.empty() ? "" : ", ";
+            missing += eventNames[e];
+        }
+    }
+    fprintf(out, "ISPC performance counters of %zu exported functions%s%s\n", sorted.size(),
+            missing.empty() ? "" : ", missing events: ", missing.c_str());
+    fprintf(out, "%10s %12s %14s %14s %6s %12s %12s %14s %8s  %s\n", "calls", "time (ms)", "cycles", "instructions",
+            "IPC", "L1D misses", "LLC misses", "FP ops", "FP/byte", "function");
+    for (const auto &p : sorted) {
+        const Counts &c = p.second;
+        const double ipc = c.events[Cycles] ? (double)c.events[Instructions] / c.events[Cycles] : 0.0;
+        const double fpPerByte = c.events[LLCMisses] ? (double)c.events[FPOps] / (64.0 * c.events[LLCMisses]) : 0.0;
+        fprintf(out, "%10llu %12.3f %14llu %14llu %6.2f %12llu %12llu %14llu %8.2f  %s\n", (unsigned long long)c.calls,
+                c.nanoseconds / 1e6, (unsigned long long)c.events[Cycles], (unsigned long long)c.events[Instructions],
+                ipc, (unsigned long long)c.events[L1DMisses], (unsigned long long)c.events[LLCMisses],
+                (unsigned long long)c.events[FPOps], fpPerByte, p.first.c_str());
+    }
+    if (out != stderr) {
+        fclose(out);
+    }
+}
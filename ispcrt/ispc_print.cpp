@@ -0,0 +1,391 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+  This file implements ISPCPrint() and ISPCPrintFlush(), the functions that
+  ispc-generated code calls for print() statements and before failing
+  assert() statements of programs compiled with --async-print.
+
+  ISPCPrint() doesn't format anything.  It copies the format and types
+  string pointers, the gang width, the mask and the raw argument values
+  into a compact binary record in a single producer, single consumer ring
+  buffer of the calling thread, which takes no locks once the ring of the
+  thread is registered.  A background thread drains the rings of all
+  threads every millisecond, or as soon as one of them is full, formats
+  the records the same way __do_print() does and writes them to stdout in
+  batches.  The output of each thread is in program order, the output of
+  different threads is interleaved record by record.
+
+  The size of the ring of each thread is ISPC_PRINT_BUFFER_SIZE bytes (1MB
+  by default).  A thread that fills its ring waits for the drain thread to
+  make room, and records that don't fit in half of the ring are written
+  synchronously.  The format and types strings are read when the records
+  are drained, so ISPCPrintFlush() must be called before the code that
+  printed them is unloaded.  Everything is flushed at exit.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "builtins/array.hpp"
+
+using SizeT = int;
+using MaskT = uint64_t;
+constexpr SizeT RES_STR_SIZE = 8196;
+constexpr SizeT ARG_STR_SIZE = 1024;
+template <typename T, SizeT Size> using StaticContainer = notstd::array<T, Size>;
+template <typename T, SizeT Size> using StaticContainerRef = StaticContainer<T, Size> &;
+
+template <SizeT Size> using StaticString = StaticContainer<char, Size>;
+template <SizeT Size> using StaticStringRef = StaticContainerRef<char, Size>;
+
+#include "builtins/builtins-c-common.hpp"
+
+extern "C" {
+void ISPCPrint(const char *format, const char *types, int width, uint64_t mask, const void *const *args);
+void ISPCPrintFlush();
+}
+
+namespace {
+
+// Header of a record, followed by the values of the arguments, each of them 8 bytes aligned. Records with a zero
+// width pad the ring to its end and only have their size and width written.
+struct Record {
+    uint32_t size;
+    int32_t width;
+    const char *format;
+    const char *types;
+    uint64_t mask;
+};
+
+constexpr size_t Align = 8;
+
+size_t alignUp(size_t n) { return (n + Align - 1) & ~(Align - 1); }
+
+// Size of one value of the argument of the given type, bools are passed as ints.
+size_t elementSize(char type) {
+    PrintInfo::Encoding e = static_cast<PrintInfo::Encoding>(type);
+    if (!PrintInfo::isUniformEncoding(e)) {
+        e = PrintInfo::getCorrespondingEncoding4Uniform(e);
+    }
+    switch (e) {
+    case PrintInfo::Bool:
+    case PrintInfo::Int:
+    case PrintInfo::UInt:
+    case PrintInfo::Float:
+        return 4;
+    case PrintInfo::Long:
+    case PrintInfo::ULong:
+    case PrintInfo::Double:
+        return 8;
+    case PrintInfo::Ptr:
+        return sizeof(void *);
+    default:
+        return 0;
+    }
+}
+
+size_t argumentSize(char type, int width) {
+    size_t n = elementSize(type);
+    return PrintInfo::isUniformEncoding(static_cast<PrintInfo::Encoding>(type)) ? n : n * width;
+}
+
+size_t recordSize(const char *types, int width) {
+    size_t size = alignUp(sizeof(Record));
+    for (const char *t = types; *t != '\0'; t++) {
+        size += alignUp(argumentSize(*t, width));
+    }
+    return size;
+}
+
+template <typename T> T load(const char *p, int lane) {
+    T v;
+    memcpy(&v, p + lane * sizeof(T), sizeof(T));
+    return v;
+}
+
+template <> bool load<bool>(const char *p, int lane) { return load<int>(p, lane) != 0; }
+
+// Writes the arguments of a record for GetFormatedStr(), like the ArgWriter of __do_print() does with the arguments
+// passed to it.
+class RecordArgWriter {
+  public:
+    RecordArgWriter(const Record *r) : m_record(r), m_arg(reinterpret_cast<const char *>(r) + alignUp(sizeof(Record))) {
+        m_type = r->types;
+    }
+
+    template <typename T> StaticString<ARG_STR_SIZE> uniform2Str() {
+        StaticString<ARG_STR_SIZE> res;
+        snprintf(&res[0], ARG_STR_SIZE, PrintInfo::type2Specifier<T>(), ValueAdapter<T>(load<T>(next(), 0)));
+        return res;
+    }
+
+    template <typename T> StaticString<ARG_STR_SIZE> varying2Str() {
+        const char *fmt = PrintInfo::type2Specifier<T>();
+        const char *arg = next();
+        StaticString<ARG_STR_SIZE> res;
+        int n = 0;
+        res[n++] = '[';
+        for (int lane = 0; lane < m_record->width; lane++) {
+            if (m_record->mask & (1ull << lane)) {
+                n += snprintf(&res[n], ARG_STR_SIZE - n, fmt, ValueAdapter<T>(load<T>(arg, lane)));
+            } else if (std::is_same<T, bool>::value) {
+                n += snprintf(&res[n], ARG_STR_SIZE - n, "%s", OffLaneBoolStr);
+            } else {
+                n += snprintf(&res[n], ARG_STR_SIZE - n, "((");
+                n += snprintf(&res[n], ARG_STR_SIZE - n, fmt, ValueAdapter<T>(load<T>(arg, lane)));
+                n += snprintf(&res[n], ARG_STR_SIZE - n, "))");
+            }
+            n = std::min(n, ARG_STR_SIZE - 3);
+            res[n++] = lane == m_record->width - 1 ? ']' : ',';
+        }
+        res[n] = '\0';
+        return res;
+    }
+
+  private:
+    const char *next() {
+        const char *arg = m_arg;
+        m_arg += alignUp(argumentSize(*m_type++, m_record->width));
+        return arg;
+    }
+
+    const Record *m_record;
+    const char *m_arg;
+    const char *m_type;
+};
+
+void formatRecord(const Record *r, std::string &out) {
+    RecordArgWriter writer(r);
+    StaticString<RES_STR_SIZE> str = GetFormatedStr(r->format, r->types, writer);
+    out += &str[0];
+}
+
+// Single producer, single consumer ring of records. Positions only grow, their remainders modulo the capacity are
+// the offsets in the ring.
+struct Ring {
+    explicit Ring(size_t capacity) : data(new uint64_t[capacity / sizeof(uint64_t)]), capacity(capacity) {}
+
+    char *at(uint64_t pos) { return reinterpret_cast<char *>(data.get()) + (pos & (capacity - 1)); }
+
+    std::unique_ptr<uint64_t[]> data;
+    const size_t capacity;
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+    // Set when the thread owning the ring exits, the ring is released once it's drained.
+    std::atomic<bool> closed{false};
+};
+
+struct Printer {
+    std::mutex lock;
+    std::vector<std::shared_ptr<Ring>> rings;
+    // Held while the rings are drained, so that they have a single consumer.
+    std::mutex drainLock;
+    std::condition_variable wake;
+    std::thread drainer;
+    bool stop{false};
+    size_t capacity{0};
+};
+
+Printer &printer() {
+    // Never destroyed, the rings are drained from an atexit() handler.
+    static Printer *p = new Printer;
+    return *p;
+}
+
+// Drains the rings of all threads to stdout. Must be called with drainLock held.
+void drain(Printer &p) {
+    std::vector<std::shared_ptr<Ring>> rings;
+    {
+        std::lock_guard<std::mutex> guard(p.lock);
+        rings = p.rings;
+    }
+    std::string out;
+    for (const std::shared_ptr<Ring> &ring : rings) {
+        bool closed = ring->closed.load(std::memory_order_acquire);
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        while (tail != head) {
+            const Record *r = reinterpret_cast<const Record *>(ring->at(tail));
+            if (r->width != 0) {
+                formatRecord(r, out);
+            }
+            tail += r->size;
+        }
+        ring->tail.store(tail, std::memory_order_release);
+        if (closed) {
+            std::lock_guard<std::mutex> guard(p.lock);
+            p.rings.erase(std::find(p.rings.begin(), p.rings.end(), ring));
+        }
+    }
+    if (!out.empty()) {
+        fwrite(out.data(), 1, out.size(), stdout);
+        fflush(stdout);
+    }
+}
+
+void drainLoop() {
+    Printer &p = printer();
+    std::unique_lock<std::mutex> guard(p.drainLock);
+    while (!p.stop) {
+        p.wake.wait_for(guard, std::chrono::milliseconds(1));
+        drain(p);
+    }
+}
+
+void stopAtExit() {
+    Printer &p = printer();
+    {
+        std::lock_guard<std::mutex> guard(p.drainLock);
+        p.stop = true;
+    }
+    p.wake.notify_one();
+    if (p.drainer.joinable()) {
+        p.drainer.join();
+    }
+    std::lock_guard<std::mutex> guard(p.drainLock);
+    drain(p);
+}
+
+size_t bufferSize() {
+    const char *value = getenv("ISPC_PRINT_BUFFER_SIZE");
+    size_t requested = (value != nullptr && *value != '\0') ? strtoull(value, nullptr, 0) : 0;
+    if (requested == 0) {
+        requested = 1 << 20;
+    }
+    size_t size = 4096;
+    while (size < requested && size < ((size_t)1 << 40)) {
+        size *= 2;
+    }
+    return size;
+}
+
+// Closes the ring of a thread when the thread exits.
+struct ThreadRing {
+    ~ThreadRing() {
+        if (ring) {
+            ring->closed.store(true, std::memory_order_release);
+        }
+    }
+    std::shared_ptr<Ring> ring;
+};
+
+Ring &threadRing() {
+    static thread_local ThreadRing t;
+    if (!t.ring) {
+        Printer &p = printer();
+        static std::once_flag started;
+        std::call_once(started, [&p] {
+            p.capacity = bufferSize();
+            p.drainer = std::thread(drainLoop);
+            atexit(stopAtExit);
+        });
+        t.ring = std::make_shared<Ring>(p.capacity);
+        std::lock_guard<std::mutex> guard(p.lock);
+        p.rings.push_back(t.ring);
+    }
+    return *t.ring;
+}
+
+// Writes the record of a print() statement at dst.
+Record *writeRecord(char *dst, size_t size, const char *format, const char *types, int width, uint64_t mask,
+                    const void *const *args) {
+    Record *r = reinterpret_cast<Record *>(dst);
+    *r = Record{(uint32_t)size, width, format, types, mask};
+    dst += alignUp(sizeof(Record));
+    for (int i = 0; types[i] != '\0'; i++) {
+        size_t n = argumentSize(types[i], width);
+        memcpy(dst, args[i], n);
+        dst += alignUp(n);
+    }
+    return r;
+}
+
+// Waits until the ring has room for the given number of bytes, waking the drain thread up.
+void reserve(Ring &ring, uint64_t head, size_t size) {
+    while (ring.capacity - (head - ring.tail.load(std::memory_order_acquire)) < size) {
+        printer().wake.notify_one();
+        std::this_thread::yield();
+    }
+}
+
+} // namespace
+
+void ISPCPrint(const char *format, const char *types, int width, uint64_t mask, const void *const *args) {
+    Ring &ring = threadRing();
+    size_t size = recordSize(types, width);
+    if (size > ring.capacity / 2) {
+        // Too large to be buffered, write it synchronously after whatever this thread printed before.
+        ISPCPrintFlush();
+        std::unique_ptr<uint64_t[]> record(new uint64_t[size / sizeof(uint64_t)]);
+        std::string out;
+        formatRecord(writeRecord(reinterpret_cast<char *>(record.get()), size, format, types, width, mask, args), out);
+        fputs(out.c_str(), stdout);
+        fflush(stdout);
+        return;
+    }
+
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    size_t room = ring.capacity - (head & (ring.capacity - 1));
+    if (room < size) {
+        // The record doesn't fit before the end of the ring, pad the ring up to it. There may be only room for the
+        // size and the width of the padding record.
+        reserve(ring, head, room);
+        Record *pad = reinterpret_cast<Record *>(ring.at(head));
+        pad->size = (uint32_t)room;
+        pad->width = 0;
+        head += room;
+        ring.head.store(head, std::memory_order_release);
+    }
+    reserve(ring, head, size);
+    writeRecord(ring.at(head), size, format, types, width, mask, args);
+    ring.head.store(head + size, std::memory_order_release);
+}
+
+void ISPCPrintFlush() {
+    Printer &p = printer();
+    std::lock_guard<std::mutex> guard(p.drainLock);
+    drain(p);
+}
@@ -47,6 +47,7 @@
     - TBB (ISPC_USE_TBB_TASK_GROUP, ISPC_USE_TBB_PARALLEL_FOR)
     - OpenMP (ISPC_USE_OMP)
     - HPX (ISPC_USE_HPX)
+    - work stealing over C++11 threads (ISPC_USE_WORK_STEALING)
 
   The task system implementation can be selected at compile time, by defining
   the appropriate preprocessor symbol on the command line (for e.g.: -D ISPC_USE_TBB).
@@ -75,11 +76,45 @@
   Number of threads can be specified as commandline parameter with
   --hpx:threads, use "all" to spawn one thread per processing unit.
 
+#define ISPC_USE_WORK_STEALING
+  The ISPC_USE_WORK_STEALING model gives each worker thread its own Chase-Lev
+  deque.  Tasks launched from within a task go to the deque of the worker
+  running it, which runs them in LIFO order, and idle workers steal the oldest
+  tasks from the deques of randomly chosen workers.  Tasks launched from other
+  threads go to a shared queue.  A launch is queued as a single range of tasks
+  from which threads claim chunks, whose size shrinks as the range runs out, so
+  launches of many tasks need no per-task storage.  Threads waiting in a sync
+  run pending tasks in the meantime, so nested launches don't leave cores idle.
+  It only needs the C++11 thread support library.  The affinity hint of
+  ISPCLaunchWithHints() is followed by splitting a launch across the nodes
+  ("spread") or keeping it on the node of the launching thread ("compact"),
+  and launches with a high priority from outside the workers are queued
+  ahead of the others.  On hybrid processors, the workers are pinned to the
+  cores of their class (e.g. the P-cores or the E-cores), taken from the
+  fastest cores first, and steal from the workers of their class first; the
+  workers of slower cores leave launches with a high priority to the workers
+  of the fastest ones while some of them are idle.
+
+#define ISPC_USE_NUMA
+  Defined along with ISPC_USE_WORK_STEALING on Linux, this pins the workers to
+  the CPUs of the NUMA nodes they're assigned to.  Launches from outside the
+  workers are split into one contiguous range of task indices per node, which
+  the workers of the node run before they steal from other nodes, and task
+  groups are reused on the node that used them last, so that the memory
+  returned by ISPCAlloc() was first touched on that node.
+
+#define ISPC_USE_ITT
+  Defined along with any of the task systems, this annotates the runs of the
+  task functions, ISPCLaunch() and the waits in ISPCSync() with the ITT API,
+  so that they show up as tasks in Intel(R) VTune(TM) Profiler.  It requires
+  ittnotify.h and the libittnotify static library.
+
 */
 
 #if !(defined ISPC_USE_CONCRT || defined ISPC_USE_GCD || defined ISPC_USE_PTHREADS ||                                  \
       defined ISPC_USE_PTHREADS_FULLY_SUBSCRIBED || defined ISPC_USE_TBB_TASK_GROUP ||                                 \
-      defined ISPC_USE_TBB_PARALLEL_FOR || defined ISPC_USE_OMP || defined ISPC_USE_HPX)
+      defined ISPC_USE_TBB_PARALLEL_FOR || defined ISPC_USE_OMP || defined ISPC_USE_HPX ||                           \
+      defined ISPC_USE_WORK_STEALING)
 
 // If no task model chosen from the compiler cmdline, pick a reasonable default
 #if defined(_WIN32) || defined(_WIN64)
@@ -99,6 +134,10 @@
 #define ISPC_IS_APPLE
 #endif
 
+#if defined(ISPC_USE_NUMA) && !(defined(ISPC_USE_WORK_STEALING) && defined(ISPC_IS_LINUX))
+#error "ISPC_USE_NUMA requires ISPC_USE_WORK_STEALING on Linux"
+#endif
+
 #define DBG(x)
 
 #ifdef ISPC_IS_WINDOWS
@@ -118,6 +157,7 @@ using namespace Concurrency;
 #include <errno.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <sched.h>
 #include <semaphore.h>
 #include <sys/param.h>
 #include <sys/stat.h>
@@ -140,9 +180,11 @@ using namespace Concurrency;
 #include <stack>
 #endif // ISPC_USE_PTHREADS_FULLY_SUBSCRIBED
 #ifdef ISPC_USE_TBB_PARALLEL_FOR
+#include <tbb/global_control.h>
 #include <tbb/parallel_for.h>
 #endif // ISPC_USE_TBB_PARALLEL_FOR
 #ifdef ISPC_USE_TBB_TASK_GROUP
+#include <tbb/global_control.h>
 #include <tbb/task_group.h>
 #endif // ISPC_USE_TBB_TASK_GROUP
 #ifdef ISPC_USE_OMP
@@ -152,29 +194,87 @@ using namespace Concurrency;
 #include <hpx/include/async.hpp>
 #include <hpx/lcos/wait_all.hpp>
 #endif // ISPC_USE_HPX
+#ifdef ISPC_USE_WORK_STEALING
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#endif // ISPC_USE_WORK_STEALING
+#ifdef ISPC_USE_ITT
+#include <ittnotify.h>
+#include <mutex>
+#include <unordered_map>
+#ifndef ISPC_IS_WINDOWS
+#include <dlfcn.h>
+#endif
+#endif // ISPC_USE_ITT
 #ifdef ISPC_IS_LINUX
+#include <sched.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #endif // ISPC_IS_LINUX
+#ifdef ISPC_IS_APPLE
+#include <unistd.h>
+#endif // ISPC_IS_APPLE
 
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <limits.h>
+#include <mutex>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <thread>
+#include <vector>
 
 // Signature of ispc-generated 'task' functions
 typedef void (*TaskFuncType)(void *data, int threadIndex, int threadCount, int taskIndex, int taskCount, int taskIndex0,
                              int taskIndex1, int taskIndex2, int taskCount0, int taskCount1, int taskCount2);
 
+class TaskGroup;
+
 // Small structure used to hold the data for each task
 struct TaskInfo {
     TaskFuncType func;
     void *data;
+    // The group the tasks were launched from.
+    TaskGroup *group;
+    // The TaskInfo stands for the taskGrain tasks from taskIndex on; the
+    // grain of ISPCLaunchWithHints() groups several of them.
     int taskIndex;
+    int taskGrain;
     int taskCount3d[3];
+    // When the task was queued, for the statistics.
+    int64_t queueTime;
 #if defined(ISPC_USE_CONCRT)
     event taskEvent;
+#endif
+#if defined(ISPC_USE_WORK_STEALING)
+    // A TaskInfo describes a range of the tasks of a launch, which is all
+    // of them unless they are split across NUMA nodes; nextTask is the
+    // first one that hasn't been claimed by a thread yet.
+    int node;
+    bool highPriority;
+    std::atomic<int64_t> nextTask;
+    int endTask;
+
+    /* The first TaskInfo of a launch also tracks the launch as a whole:
+       the TaskInfos of its ranges, the number of references to them in the
+       task queues plus the number of their chunks being run, the number of
+       launches that it still waits for, and the launches waiting for it. */
+    TaskInfo *launch;
+    int launchBaseIndex, launchRanges;
+    std::atomic<int32_t> launchPending;
+    std::atomic<int32_t> launchWaitingFor;
+    std::mutex launchMutex;
+    bool launchDone;
+    std::vector<TaskInfo *> launchDependents;
 #endif
     int taskCount() const { return taskCount3d[0] * taskCount3d[1] * taskCount3d[2]; }
     int taskIndex0() const { return taskIndex % taskCount3d[0]; }
@@ -183,24 +283,154 @@ struct TaskInfo {
     int taskCount0() const { return taskCount3d[0]; }
     int taskCount1() const { return taskCount3d[1]; }
     int taskCount2() const { return taskCount3d[2]; }
+    int taskGrainCount() const { return std::min(taskGrain, taskCount() - taskIndex); }
+    // Run the tasks of the TaskInfo one after the other.
+    void run(int threadIndex, int threadCount) const;
     TaskInfo() = default;
 };
 
+/* An executor of the application that ISPCSetTaskExecutor() installs to run
+   the tasks instead of the task system, e.g. on its own thread pool or in a
+   TBB task arena.  launch() should call run(arg, taskIndex, threadIndex,
+   threadCount) for each taskIndex from 0 to count-1, asynchronously, in
+   the group *group, which it creates when it's NULL.  sync() waits for all
+   of the tasks of a group and frees it. */
+struct ISPCTaskExecutor {
+    void *context;
+    void (*launch)(void *context, void **group, void (*run)(void *arg, int taskIndex, int threadIndex, int threadCount),
+                   void *arg, int count);
+    void (*sync)(void *context, void *group);
+};
+
+// Values of the affinity and priority hints of ISPCLaunchWithHints()
+enum LaunchAffinity { AffinityDefault = 0, AffinityCompact = 1, AffinitySpread = 2 };
+enum LaunchPriority { PriorityLow = -1, PriorityNormal = 0, PriorityHigh = 1 };
+
 // ispc expects these functions to have C linkage / not be mangled
 extern "C" {
 void ISPCLaunch(void **handlePtr, void *f, void *data, int countx, int county, int countz);
 void *ISPCAlloc(void **handlePtr, int64_t size, int32_t alignment);
 void ISPCSync(void *handle);
+void ISPCLaunchAfter(void **handlePtr, void *f, void *data, int countx, int county, int countz, const int64_t *after,
+                     int numAfter);
+void ISPCLaunchWithHints(void **handlePtr, void *f, void *data, int countx, int county, int countz,
+                         const int64_t *after, int numAfter, int grain, int affinity, int priority);
+void ISPCSetTaskingThreads(int numThreads, const int *cpus, int numCpus);
+void ISPCSetTaskingSpin(int microseconds);
+void ISPCSetTaskExecutor(const ISPCTaskExecutor *executor);
+void *ISPCWorkerScratch(int64_t size);
+void ISPCCancelTasks();
+int ISPCTasksCancelled();
+}
+
+///////////////////////////////////////////////////////////////////////////
+// Memory buffers of ISPCAlloc()
+
+/* The buffers that ISPCAlloc() allocates from are aligned to cache lines,
+   so that the data of tasks run by different threads doesn't share lines
+   with other allocations.  On Linux, setting the ISPC_HUGE_PAGES environment
+   variable to 1 backs the buffers of at least HUGE_PAGE_SIZE bytes with
+   transparent huge pages, which saves TLB misses and page faults for
+   launches that pass a lot of data.  The buffers are kept by the task
+   groups, which are recycled, so they're allocated only once.
+ */
+#define MEM_BUFFER_ALIGNMENT 64
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+static bool lUseHugePages() {
+#ifdef ISPC_IS_LINUX
+    static const bool useHugePages = []() {
+        const char *env = getenv("ISPC_HUGE_PAGES");
+        return env != NULL && atoi(env) != 0;
+    }();
+    return useHugePages;
+#else
+    return false;
+#endif
+}
+
+// Allocates a buffer of at least *size bytes, and updates *size to its size.
+static char *lAllocMemBuffer(int *size) {
+    size_t alignment = MEM_BUFFER_ALIGNMENT;
+    if (*size >= HUGE_PAGE_SIZE && lUseHugePages()) {
+        alignment = HUGE_PAGE_SIZE;
+        *size = (*size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    }
+#ifdef ISPC_IS_WINDOWS
+    void *ptr = _aligned_malloc(*size, alignment);
+#else
+    void *ptr = NULL;
+    if (posix_memalign(&ptr, alignment, *size) != 0)
+        ptr = NULL;
+#endif
+    if (ptr == NULL) {
+        fprintf(stderr, "Failed to allocate %d bytes for ISPCAlloc().  Exiting.\n", *size);
+        exit(1);
+    }
+#if defined(ISPC_IS_LINUX) && defined(MADV_HUGEPAGE)
+    if (alignment == HUGE_PAGE_SIZE)
+        madvise(ptr, *size, MADV_HUGEPAGE);
+#endif
+    return (char *)ptr;
+}
+
+static void lFreeMemBuffer(char *ptr) {
+#ifdef ISPC_IS_WINDOWS
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////
+// Per-worker scratch memory of ISPCWorkerScratch()
+
+/* Each thread that calls ISPCWorkerScratch() owns a slab, which is allocated
+   with lAllocMemBuffer() and sized to a multiple of the cache line size, so
+   that the slabs of different workers never share lines.  The slab is kept
+   for the lifetime of the thread and reused by all of the tasks it runs, so
+   reductions can keep per-worker partial results there without allocating
+   memory for each launch.  A request for more memory than the slab has
+   replaces it with one at least twice as large; its contents aren't kept.
+ */
+struct WorkerScratch {
+    char *data = NULL;
+    int size = 0;
+
+    ~WorkerScratch() {
+        if (data != NULL)
+            lFreeMemBuffer(data);
+    }
+};
+
+static thread_local WorkerScratch workerScratch;
+
+void *ISPCWorkerScratch(int64_t size) {
+    if (size < 0 || size > INT_MAX / 2)
+        return NULL;
+    if (workerScratch.data != NULL && size <= workerScratch.size)
+        return workerScratch.data;
+
+    int64_t newSize = std::max(size, std::min((int64_t)workerScratch.size * 2, (int64_t)INT_MAX / 2));
+    int allocSize = (int)((newSize + MEM_BUFFER_ALIGNMENT - 1) & ~(int64_t)(MEM_BUFFER_ALIGNMENT - 1));
+    if (allocSize == 0)
+        allocSize = MEM_BUFFER_ALIGNMENT;
+    if (workerScratch.data != NULL)
+        lFreeMemBuffer(workerScratch.data);
+    workerScratch.data = lAllocMemBuffer(&allocSize);
+    workerScratch.size = allocSize;
+    return workerScratch.data;
 }
 
 ///////////////////////////////////////////////////////////////////////////
 // TaskGroupBase
 
 #define LOG_TASK_QUEUE_CHUNK_SIZE 14
-#define MAX_TASK_QUEUE_CHUNKS 128
 #define TASK_QUEUE_CHUNK_SIZE (1 << LOG_TASK_QUEUE_CHUNK_SIZE)
 
-#define MAX_LAUNCHED_TASKS (MAX_TASK_QUEUE_CHUNKS * TASK_QUEUE_CHUNK_SIZE)
+// Chunk k holds TASK_QUEUE_CHUNK_SIZE << k tasks, so this many chunks cover
+// all of the non-negative task indices.
+#define MAX_TASK_QUEUE_CHUNKS (32 - LOG_TASK_QUEUE_CHUNK_SIZE)
 
 #define NUM_MEM_BUFFERS 16
 
@@ -220,24 +450,41 @@ class TaskGroupBase {
 
     void *AllocMemory(int64_t size, int32_t alignment);
 
+    /* Cancelling the group skips the tasks launched from it that haven't
+       started yet, up to the next sync; the ones being run finish, but can
+       check IsCancelled() to return early. */
+    void Cancel() { cancelled.store(true, std::memory_order_relaxed); }
+    bool IsCancelled() const { return cancelled.load(std::memory_order_relaxed); }
+
+    // Link for the stack of free task groups.
+    TaskGroup *nextFree;
+
+    // The group of the tasks launched with an ISPCTaskExecutor, if any.
+    void *executorGroup;
+
   protected:
     TaskGroupBase();
     ~TaskGroupBase();
 
     int nextTaskInfoIndex;
+    std::atomic<bool> cancelled;
 
   private:
-    /* We allocate blocks of TASK_QUEUE_CHUNK_SIZE TaskInfo structures as
-       needed by the calling function.  We hold up to MAX_TASK_QUEUE_CHUNKS
-       of these (and then exit at runtime if more than this many tasks are
-       launched.)
+    /* We allocate blocks of TaskInfo structures as needed by the calling
+       function.  Each block is twice the size of the previous one, starting
+       with TASK_QUEUE_CHUNK_SIZE, so that few of them are needed for
+       launches of many tasks.  The blocks are never moved once allocated,
+       so the tasks can be accessed by the worker threads while more of
+       them are launched.
      */
     TaskInfo *taskInfo[MAX_TASK_QUEUE_CHUNKS];
 
     /* We also allocate chunks of memory to service ISPCAlloc() calls.  The
        memBuffers[] array holds pointers to this memory.  The first element
        of this array is initialized to point to mem and then any subsequent
-       elements required are initialized with dynamic allocation.
+       elements required are initialized with dynamic allocation.  They are
+       kept when the task group is reset, so that a reused task group
+       doesn't need to allocate memory again.
      */
     int curMemBuffer, curMemBufferOffset;
     int memBufferSize[NUM_MEM_BUFFERS];
@@ -247,6 +494,9 @@ class TaskGroupBase {
 
 inline TaskGroupBase::TaskGroupBase() {
     nextTaskInfoIndex = 0;
+    cancelled.store(false, std::memory_order_relaxed);
+    nextFree = NULL;
+    executorGroup = NULL;
 
     curMemBuffer = 0;
     curMemBufferOffset = 0;
@@ -265,38 +515,43 @@ inline TaskGroupBase::~TaskGroupBase() {
     // Note: don't delete memBuffers[0], since it points to the start of
     // the "mem" member!
     for (int i = 1; i < NUM_MEM_BUFFERS; ++i)
-        delete[](memBuffers[i]);
+        if (memBuffers[i] != NULL)
+            lFreeMemBuffer(memBuffers[i]);
+    for (int i = 0; i < MAX_TASK_QUEUE_CHUNKS; ++i)
+        delete[] taskInfo[i];
 }
 
 inline void TaskGroupBase::Reset() {
     nextTaskInfoIndex = 0;
+    cancelled.store(false, std::memory_order_relaxed);
+    executorGroup = NULL;
     curMemBuffer = 0;
     curMemBufferOffset = 0;
 }
 
 inline int TaskGroupBase::AllocTaskInfo(int count) {
     int ret = nextTaskInfoIndex;
+    if (count > INT32_MAX - ret) {
+        fprintf(stderr,
+                "More than %d tasks have been launched from the current "
+                "function, which is the maximum number of tasks.  Exiting.\n",
+                INT32_MAX);
+        exit(1);
+    }
     nextTaskInfoIndex += count;
     return ret;
 }
 
 inline TaskInfo *TaskGroupBase::GetTaskInfo(int index) {
-    int chunk = (index >> LOG_TASK_QUEUE_CHUNK_SIZE);
-    int offset = index & (TASK_QUEUE_CHUNK_SIZE - 1);
-
-    if (chunk == MAX_TASK_QUEUE_CHUNKS) {
-        fprintf(stderr,
-                "A total of %d tasks have been launched from the "
-                "current function--the simple built-in task system can handle "
-                "no more. You can increase the values of TASK_QUEUE_CHUNK_SIZE "
-                "and LOG_TASK_QUEUE_CHUNK_SIZE to work around this limitation.  "
-                "Sorry!  Exiting.\n",
-                index);
-        exit(1);
-    }
+    // Chunk k starts at index TASK_QUEUE_CHUNK_SIZE * (2^k - 1).
+    uint32_t scaled = ((uint32_t)index >> LOG_TASK_QUEUE_CHUNK_SIZE) + 1;
+    int chunk = 0;
+    while ((scaled >> (chunk + 1)) != 0)
+        ++chunk;
+    int offset = index - (((1 << chunk) - 1) << LOG_TASK_QUEUE_CHUNK_SIZE);
 
     if (taskInfo[chunk] == NULL)
-        taskInfo[chunk] = new TaskInfo[TASK_QUEUE_CHUNK_SIZE];
+        taskInfo[chunk] = new TaskInfo[(size_t)TASK_QUEUE_CHUNK_SIZE << chunk];
     return &taskInfo[chunk][offset];
 }
 
@@ -315,14 +570,489 @@ inline void *TaskGroupBase::AllocMemory(int64_t size, int32_t alignment) {
     curMemBufferOffset = 0;
     assert(curMemBuffer < NUM_MEM_BUFFERS);
 
+    // Reuse the buffer from before the last reset if it's big enough.
+    if (memBufferSize[curMemBuffer] >= int(size + alignment))
+        return AllocMemory(size, alignment);
+
     int allocSize = 1 << (12 + curMemBuffer);
     allocSize = std::max(int(size + alignment), allocSize);
-    char *newBuf = new char[allocSize];
+    if (memBuffers[curMemBuffer] != NULL)
+        lFreeMemBuffer(memBuffers[curMemBuffer]);
+    char *newBuf = lAllocMemBuffer(&allocSize);
     memBufferSize[curMemBuffer] = allocSize;
     memBuffers[curMemBuffer] = newBuf;
     return AllocMemory(size, alignment);
 }
 
+///////////////////////////////////////////////////////////////////////////
+// Thread configuration
+
+/* The number of threads that run tasks, counting the thread that waits in
+   ISPCSync(), and the CPUs to pin the worker threads to.  They're set with
+   ISPCSetTaskingThreads(), or else with the ISPC_NUM_THREADS and
+   ISPC_AFFINITY environment variables, and are read when the task system is
+   initialized. */
+static bool taskingConfigSet = false;
+static int taskingThreads = 0;
+static std::vector<int> taskingCpus;
+
+/* Parse a list of CPUs like "0-7,16-23", as used by the ISPC_AFFINITY
+   variable and by Linux. */
+static std::vector<int> lParseCpuList(const char *list) {
+    std::vector<int> cpus;
+    while (*list != '\0') {
+        char *end;
+        long first = strtol(list, &end, 10), last = first;
+        if (end == list || first < 0)
+            break;
+        if (*end == '-') {
+            list = end + 1;
+            last = strtol(list, &end, 10);
+            if (end == list)
+                break;
+        }
+        for (long cpu = first; cpu <= last; ++cpu)
+            cpus.push_back((int)cpu);
+        if (*end != ',')
+            break;
+        list = end + 1;
+    }
+    return cpus;
+}
+
+static void lReadTaskingConfig() {
+    if (taskingConfigSet)
+        return;
+    taskingConfigSet = true;
+
+    const char *numThreads = getenv("ISPC_NUM_THREADS");
+    if (numThreads != NULL)
+        taskingThreads = std::max(0, atoi(numThreads));
+    const char *affinity = getenv("ISPC_AFFINITY");
+    if (affinity != NULL)
+        taskingCpus = lParseCpuList(affinity);
+}
+
+#ifdef __linux__
+/* The number of CPUs that the CPU bandwidth limit of the cgroup of the
+   process amounts to, rounded up, or 0 if it has no limit. */
+static int lCgroupCpuLimit() {
+    long long quota = -1, period = 0;
+    FILE *f = fopen("/sys/fs/cgroup/cpu.max", "r");
+    if (f != NULL) {
+        // cgroup v2: "<quota> <period>", where the quota is "max" when
+        // there's no limit.
+        char quotaStr[32];
+        if (fscanf(f, "%31s %lld", quotaStr, &period) == 2 && strcmp(quotaStr, "max") != 0)
+            quota = atoll(quotaStr);
+        fclose(f);
+    } else {
+        // cgroup v1, where the quota is -1 when there's no limit.
+        if ((f = fopen("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", "r")) != NULL) {
+            if (fscanf(f, "%lld", &quota) != 1)
+                quota = -1;
+            fclose(f);
+        }
+        if ((f = fopen("/sys/fs/cgroup/cpu/cpu.cfs_period_us", "r")) != NULL) {
+            if (fscanf(f, "%lld", &period) != 1)
+                period = 0;
+            fclose(f);
+        }
+    }
+    if (quota <= 0 || period <= 0)
+        return 0;
+    return (int)((quota + period - 1) / period);
+}
+#endif // __linux__
+
+// The number of CPUs that the process can make use of.
+static int lNumCpus() {
+#ifdef ISPC_IS_WINDOWS
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int nCpus = (int)info.dwNumberOfProcessors;
+#else
+    int nCpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif // ISPC_IS_WINDOWS
+#ifdef __linux__
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+        nCpus = std::min(nCpus, CPU_COUNT(&allowed));
+    int limit = lCgroupCpuLimit();
+    if (limit > 0)
+        nCpus = std::min(nCpus, limit);
+#endif // __linux__
+    return std::max(1, nCpus);
+}
+
+/* The number of threads to run tasks on, including the thread that waits
+   for them.  Without a setting, it's the number of CPUs to pin the threads
+   to, if any, or else the number of CPUs available to the process. */
+static int lNumTaskingThreads() {
+    lReadTaskingConfig();
+    if (taskingThreads > 0)
+        return taskingThreads;
+    if (!taskingCpus.empty())
+        return (int)taskingCpus.size();
+    return lNumCpus();
+}
+
+#if defined(ISPC_USE_OMP) || defined(ISPC_USE_TBB_PARALLEL_FOR) || defined(ISPC_USE_TBB_TASK_GROUP) ||                 \
+    defined(ISPC_USE_PTHREADS_FULLY_SUBSCRIBED)
+// Whether the number of threads was set explicitly.
+static bool lTaskingThreadsSet() {
+    lReadTaskingConfig();
+    return taskingThreads > 0;
+}
+#endif
+
+#if defined(ISPC_USE_PTHREADS) || defined(ISPC_USE_WORK_STEALING)
+// Pin the current thread, the given worker, to its CPU, if CPUs were set.
+static void lPinWorkerThread(int worker) {
+    lReadTaskingConfig();
+    if (taskingCpus.empty())
+        return;
+    int cpu = taskingCpus[worker % taskingCpus.size()];
+#if defined(__linux__)
+    if (cpu < CPU_SETSIZE) {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(cpu, &cpuset);
+        sched_setaffinity(0, sizeof(cpuset), &cpuset);
+    }
+#elif defined(ISPC_IS_WINDOWS)
+    if (cpu < 64)
+        SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu);
+#else
+    // There is no way to pin threads on macOS.
+    (void)cpu;
+#endif
+}
+#endif
+
+void ISPCSetTaskingThreads(int numThreads, const int *cpus, int numCpus) {
+    taskingConfigSet = true;
+    taskingThreads = std::max(0, numThreads);
+    if (cpus != NULL && numCpus > 0)
+        taskingCpus.assign(cpus, cpus + numCpus);
+    else
+        taskingCpus.clear();
+}
+
+/* How long idle workers spin, looking for new launches, before they go to
+   sleep, in nanoseconds.  It's set with ISPCSetTaskingSpin() or else with
+   the ISPC_SPIN_WAIT environment variable, in microseconds; it's -1 until
+   either of them is read.  Spinning starts the tasks of launches that come
+   in soon after the previous ones without waking up the workers, at the
+   cost of keeping their cores busy for that long.  It can be changed at any
+   time, e.g. to spin only while frames are being rendered. */
+static std::atomic<int64_t> taskingSpinNanoseconds(-1);
+
+static int64_t lSpinNanoseconds() {
+    int64_t spin = taskingSpinNanoseconds.load(std::memory_order_relaxed);
+    if (spin < 0) {
+        const char *env = getenv("ISPC_SPIN_WAIT");
+        int64_t envSpin = env != NULL ? std::max(0, atoi(env)) * (int64_t)1000 : 0;
+        // Unless ISPCSetTaskingSpin() was called in the meantime.
+        if (taskingSpinNanoseconds.compare_exchange_strong(spin, envSpin, std::memory_order_relaxed))
+            spin = envSpin;
+    }
+    return spin;
+}
+
+void ISPCSetTaskingSpin(int microseconds) {
+    taskingSpinNanoseconds.store(std::max(0, microseconds) * (int64_t)1000, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////
+// Statistics
+
+/* Counting is off unless it's turned on with ISPCSetTaskingStats() or with
+   the ISPC_TASKING_STATS environment variable set to 1, which also prints
+   the statistics to stderr at exit.  Each thread that launches, runs or
+   waits for tasks then counts what it does in its own TaskingThreadStats,
+   which only it writes to, so that counting is cheap; ISPCGetTaskingStats()
+   reads them along with their totals.  When a thread exits, its counts are
+   added to the totals of the threads that have exited.  The scheduling
+   counters (tasks run, steals, idle time, latency and queue depth) are only
+   kept by the pthreads and work-stealing task systems, which do their own
+   scheduling. */
+#define ISPC_TASKING_LATENCY_BUCKETS 24
+
+struct ISPCTaskingStats {
+    int32_t threadIndex; // as passed to the tasks, or -1 for the totals and
+                         // for the threads that don't belong to the task system
+    int32_t isWorker;    // whether the thread belongs to the task system
+    int64_t launches;
+    int64_t tasksLaunched;
+    int64_t tasksRun;
+    int64_t steals;          // ranges of tasks taken from other workers
+    int64_t maxQueueDepth;   // most tasks (or ranges) queued at once
+    int64_t syncNanoseconds; // time spent waiting in ISPCSync()
+    int64_t idleNanoseconds; // time workers spent waiting for tasks
+    // Number of tasks (or chunks of them) that started running less than
+    // 2^(i+1) microseconds after they were launched, and at least 2^i
+    // microseconds after for i > 0.
+    int64_t latencyHistogram[ISPC_TASKING_LATENCY_BUCKETS];
+};
+
+extern "C" int ISPCGetTaskingStats(ISPCTaskingStats *stats, int maxStats);
+extern "C" void ISPCSetTaskingStats(int enable);
+
+// Index of the worker thread, as passed to the tasks, which the task system
+// sets when the thread starts, or -1 for the other threads.
+static thread_local int32_t statsWorkerIndex = -1;
+
+/* The statistics of a thread, which it registers when it first counts
+   something, and which add their counts to retiredTaskingStats and
+   unregister when the thread exits. */
+struct TaskingThreadStats {
+    TaskingThreadStats();
+    ~TaskingThreadStats();
+
+    int32_t threadIndex;
+    int32_t isWorker;
+    std::atomic<int64_t> launches, tasksLaunched, tasksRun, steals, maxQueueDepth;
+    std::atomic<int64_t> syncNanoseconds, idleNanoseconds;
+    std::atomic<int64_t> latencyHistogram[ISPC_TASKING_LATENCY_BUCKETS];
+};
+
+static std::mutex taskingStatsMutex;
+static std::vector<TaskingThreadStats *> taskingStats;
+static ISPCTaskingStats retiredTaskingStats;
+static thread_local TaskingThreadStats threadStats;
+
+// 1 if counting is on, 0 if it's off, or -1 until ISPC_TASKING_STATS is read.
+static std::atomic<int> taskingStatsEnabled(-1);
+
+static inline int64_t lNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Only the owning thread updates its counters, so this needs no atomic
+// read-modify-write.
+static inline void lStatsAdd(std::atomic<int64_t> &counter, int64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+static void lPrintTaskingStats();
+
+static bool lStatsEnabled() {
+    int enabled = taskingStatsEnabled.load(std::memory_order_relaxed);
+    if (enabled < 0) {
+        const char *env = getenv("ISPC_TASKING_STATS");
+        int envEnabled = env != NULL && atoi(env) != 0;
+        // Unless ISPCSetTaskingStats() was called in the meantime.
+        if (taskingStatsEnabled.compare_exchange_strong(enabled, envEnabled, std::memory_order_relaxed)) {
+            enabled = envEnabled;
+            if (enabled)
+                atexit(lPrintTaskingStats);
+        }
+    }
+    return enabled != 0;
+}
+
+void ISPCSetTaskingStats(int enable) { taskingStatsEnabled.store(enable != 0, std::memory_order_relaxed); }
+
+TaskingThreadStats::TaskingThreadStats() : threadIndex(statsWorkerIndex), isWorker(statsWorkerIndex >= 0) {
+    launches = tasksLaunched = tasksRun = steals = maxQueueDepth = 0;
+    syncNanoseconds = idleNanoseconds = 0;
+    for (int i = 0; i < ISPC_TASKING_LATENCY_BUCKETS; ++i)
+        latencyHistogram[i] = 0;
+    std::lock_guard<std::mutex> lock(taskingStatsMutex);
+    taskingStats.push_back(this);
+}
+
+// The time to count from, or 0 when counting is off, which the lStats*()
+// functions below then ignore.
+static inline int64_t lStatsNanoseconds() { return lStatsEnabled() ? lNanoseconds() : 0; }
+
+#if defined(ISPC_USE_PTHREADS) || defined(ISPC_USE_WORK_STEALING)
+// Called by the worker threads of a task system when they start.
+static void lStatsSetWorker(int threadIndex) { statsWorkerIndex = threadIndex; }
+#endif
+
+static inline void lStatsLaunch(int count) {
+    if (!lStatsEnabled())
+        return;
+    lStatsAdd(threadStats.launches, 1);
+    lStatsAdd(threadStats.tasksLaunched, count);
+}
+
+static inline void lStatsQueueDepth(int64_t depth) {
+    if (!lStatsEnabled())
+        return;
+    if (depth > threadStats.maxQueueDepth.load(std::memory_order_relaxed))
+        threadStats.maxQueueDepth.store(depth, std::memory_order_relaxed);
+}
+
+static inline void lStatsSteal() {
+    if (!lStatsEnabled())
+        return;
+    lStatsAdd(threadStats.steals, 1);
+}
+
+// Count the time since start, from lStatsNanoseconds(), in the counter.
+static inline void lStatsTime(std::atomic<int64_t> TaskingThreadStats::*counter, int64_t start) {
+    if (start == 0 || !lStatsEnabled())
+        return;
+    lStatsAdd(threadStats.*counter, lNanoseconds() - start);
+}
+
+// Count tasks that start running, given when they were queued.
+static inline void lStatsRunTasks(int count, int64_t queueTime) {
+    if (!lStatsEnabled())
+        return;
+    lStatsAdd(threadStats.tasksRun, count);
+    if (queueTime == 0)
+        return;
+    int64_t micros = (lNanoseconds() - queueTime) / 1000;
+    int bucket = 0;
+    while (micros > 1 && bucket < ISPC_TASKING_LATENCY_BUCKETS - 1) {
+        micros >>= 1;
+        ++bucket;
+    }
+    lStatsAdd(threadStats.latencyHistogram[bucket], 1);
+}
+
+static void lSumTaskingStats(const TaskingThreadStats &ts, ISPCTaskingStats &sum) {
+    sum.launches += ts.launches.load(std::memory_order_relaxed);
+    sum.tasksLaunched += ts.tasksLaunched.load(std::memory_order_relaxed);
+    sum.tasksRun += ts.tasksRun.load(std::memory_order_relaxed);
+    sum.steals += ts.steals.load(std::memory_order_relaxed);
+    sum.maxQueueDepth = std::max(sum.maxQueueDepth, ts.maxQueueDepth.load(std::memory_order_relaxed));
+    sum.syncNanoseconds += ts.syncNanoseconds.load(std::memory_order_relaxed);
+    sum.idleNanoseconds += ts.idleNanoseconds.load(std::memory_order_relaxed);
+    for (int i = 0; i < ISPC_TASKING_LATENCY_BUCKETS; ++i)
+        sum.latencyHistogram[i] += ts.latencyHistogram[i].load(std::memory_order_relaxed);
+}
+
+TaskingThreadStats::~TaskingThreadStats() {
+    std::lock_guard<std::mutex> lock(taskingStatsMutex);
+    lSumTaskingStats(*this, retiredTaskingStats);
+    taskingStats.erase(std::find(taskingStats.begin(), taskingStats.end(), this));
+}
+
+/* Fill in the totals and then the statistics of each thread, up to
+   maxStats of them, and return the number of entries available. */
+int ISPCGetTaskingStats(ISPCTaskingStats *stats, int maxStats) {
+    std::lock_guard<std::mutex> lock(taskingStatsMutex);
+    const int nStats = (int)taskingStats.size() + 1;
+    for (int i = 0; i < std::min(maxStats, nStats); ++i) {
+        memset(&stats[i], 0, sizeof(ISPCTaskingStats));
+        if (i == 0) {
+            stats[i] = retiredTaskingStats;
+            stats[i].threadIndex = -1;
+            for (TaskingThreadStats *ts : taskingStats)
+                lSumTaskingStats(*ts, stats[i]);
+        } else {
+            stats[i].threadIndex = taskingStats[i - 1]->threadIndex;
+            stats[i].isWorker = taskingStats[i - 1]->isWorker;
+            lSumTaskingStats(*taskingStats[i - 1], stats[i]);
+        }
+    }
+    return nStats;
+}
+
+static void lPrintTaskingStats() {
+    int nStats = ISPCGetTaskingStats(NULL, 0);
+    std::vector<ISPCTaskingStats> stats(nStats);
+    nStats = std::min(nStats, ISPCGetTaskingStats(stats.data(), nStats));
+
+    fprintf(stderr, "ispc tasking statistics:\n");
+    fprintf(stderr, "  %-8s %6s %10s %12s %12s %10s %8s %12s %12s\n", "thread", "worker", "launches", "launched",
+            "run", "steals", "queue", "sync ms", "idle ms");
+    for (int i = 0; i < nStats; ++i) {
+        const ISPCTaskingStats &s = stats[i];
+        char name[16];
+        if (i == 0)
+            snprintf(name, sizeof(name), "total");
+        else
+            snprintf(name, sizeof(name), "%d", s.threadIndex);
+        fprintf(stderr, "  %-8s %6s %10lld %12lld %12lld %10lld %8lld %12.3f %12.3f\n", name,
+                i == 0 ? "" : (s.isWorker ? "yes" : "no"), (long long)s.launches, (long long)s.tasksLaunched,
+                (long long)s.tasksRun, (long long)s.steals, (long long)s.maxQueueDepth, s.syncNanoseconds * 1e-6,
+                s.idleNanoseconds * 1e-6);
+    }
+    fprintf(stderr, "  launch to start latency:\n");
+    for (int i = 0; i < ISPC_TASKING_LATENCY_BUCKETS; ++i) {
+        if (stats[0].latencyHistogram[i] != 0)
+            fprintf(stderr, "    < %lld us: %lld\n", 2LL << i, (long long)stats[0].latencyHistogram[i]);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////
+// ITT annotations
+
+// With ISPC_USE_ITT, each run of a task function shows up as an ITT task
+// named after the function in VTune, and so do the waits in ISPCSync() and
+// the time spent queuing tasks in ISPCLaunch().  The task functions are
+// named with dladdr(), so the name is only found when the symbol is
+// exported; otherwise the address of the function is used.
+
+#ifdef ISPC_USE_ITT
+
+static __itt_domain *lIttDomain() {
+    static __itt_domain *domain = __itt_domain_create("ispc");
+    return domain;
+}
+
+static __itt_string_handle *lIttLookupTaskName(void *func) {
+    char name[256];
+    snprintf(name, sizeof(name), "ispc task %p", func);
+#ifndef ISPC_IS_WINDOWS
+    Dl_info info;
+    if (dladdr(func, &info) != 0 && info.dli_sname != NULL && info.dli_saddr == func) {
+        // Drop the mangled parameter types that follow the ispc function name.
+        const char *end = strstr(info.dli_sname, "___");
+        int length = end != NULL ? (int)(end - info.dli_sname) : (int)strlen(info.dli_sname);
+        snprintf(name, sizeof(name), "%.*s", length, info.dli_sname);
+    }
+#endif // !ISPC_IS_WINDOWS
+    return __itt_string_handle_create(name);
+}
+
+// Returns the name of the task function, looking it up once per function;
+// consecutive tasks usually run the same function, so the last one
+// looked up by the thread is kept without taking the lock.
+static __itt_string_handle *lIttTaskName(void *func) {
+    static thread_local void *lastFunc = NULL;
+    static thread_local __itt_string_handle *lastName = NULL;
+    if (func == lastFunc)
+        return lastName;
+
+    static std::mutex mutex;
+    static std::unordered_map<void *, __itt_string_handle *> names;
+    std::lock_guard<std::mutex> lock(mutex);
+    __itt_string_handle *&name = names[func];
+    if (name == NULL)
+        name = lIttLookupTaskName(func);
+    lastFunc = func;
+    lastName = name;
+    return name;
+}
+
+class IttTask {
+  public:
+    explicit IttTask(__itt_string_handle *name) { __itt_task_begin(lIttDomain(), __itt_null, __itt_null, name); }
+    ~IttTask() { __itt_task_end(lIttDomain()); }
+    IttTask(const IttTask &) = delete;
+    IttTask &operator=(const IttTask &) = delete;
+};
+
+#define ISPC_ITT_TASK(func) IttTask ittTask(lIttTaskName((void *)(func)))
+#define ISPC_ITT_SCOPE(str)                                                                                            \
+    static __itt_string_handle *ittScopeName = __itt_string_handle_create(str);                                        \
+    IttTask ittScope(ittScopeName)
+
+#else
+
+#define ISPC_ITT_TASK(func)
+#define ISPC_ITT_SCOPE(str)
+
+#endif // ISPC_USE_ITT
+
 ///////////////////////////////////////////////////////////////////////////
 // Atomics and the like
 
@@ -333,16 +1063,6 @@ static inline void lMemFence() {
 #endif
 }
 
-static void *lAtomicCompareAndSwapPointer(void **v, void *newValue, void *oldValue) {
-#ifdef ISPC_IS_WINDOWS
-    return InterlockedCompareExchangePointer(v, newValue, oldValue);
-#else
-    void *result = __sync_val_compare_and_swap(v, oldValue, newValue);
-    lMemFence();
-    return result;
-#endif // ISPC_IS_WINDOWS
-}
-
 static int32_t lAtomicCompareAndSwap32(volatile int32_t *v, int32_t newValue, int32_t oldValue) {
 #ifdef ISPC_IS_WINDOWS
     return InterlockedCompareExchange((volatile LONG *)v, newValue, oldValue);
@@ -364,11 +1084,23 @@ static inline int32_t lAtomicAdd(volatile int32_t *v, int32_t delta) {
 ///////////////////////////////////////////////////////////////////////////
 
 #ifdef ISPC_USE_CONCRT
-// With ConcRT, we don't need to extend TaskGroupBase at all.
+/* With ConcRT, we only need to keep track of the tasks that have been
+   waited for already, since ISPCLaunchAfter() may wait for the tasks of the
+   group before more of them are launched. */
 class TaskGroup : public TaskGroupBase {
   public:
+    TaskGroup() { nSyncedTasks = 0; }
+
+    void Reset() {
+        TaskGroupBase::Reset();
+        nSyncedTasks = 0;
+    }
+
     void Launch(int baseIndex, int count);
     void Sync();
+
+  private:
+    int nSyncedTasks;
 };
 #endif // ISPC_USE_CONCRT
 
@@ -448,6 +1180,12 @@ class TaskGroup : public TaskGroupBase {
     void Launch(int baseIndex, int count);
     void Sync();
 
+    // TBB also drops the tasks of the group that haven't been started.
+    void Cancel() {
+        TaskGroupBase::Cancel();
+        tbbTaskGroup.cancel();
+    }
+
   private:
     tbb::task_group tbbTaskGroup;
 };
@@ -467,7 +1205,118 @@ class TaskGroup : public TaskGroupBase {
 
 #endif // ISPC_USE_HPX
 
+#ifdef ISPC_USE_WORK_STEALING
+
+class TaskGroup : public TaskGroupBase {
+  public:
+    TaskGroup() : numPending(0) {}
+
+    void Reset() {
+        TaskGroupBase::Reset();
+        assert(numPending.load() == 0);
+        launches.clear();
+    }
+
+    void Launch(int baseIndex, int count);
+    void Sync();
+
+    void AddPending(int delta) { numPending.fetch_add(delta, std::memory_order_acq_rel); }
+
+    /* The launches of the group, numbered in the order they were made,
+       which is how ispc refers to them in "after" clauses.  Only used by
+       the thread that launches from the group. */
+    void AddLaunch(TaskInfo *launch) { launches.push_back(launch); }
+    TaskInfo *GetLaunch(int64_t index) const {
+        return (index >= 0 && index < (int64_t)launches.size()) ? launches[index] : NULL;
+    }
+
+  private:
+    std::vector<TaskInfo *> launches;
+
+    /* The number of references to the launches of this group that are in
+       the task queues, plus the number of chunks of tasks being run.  The
+       group's TaskInfos may only be reused once this drops to zero. */
+    std::atomic<int32_t> numPending;
+};
+
+#endif // ISPC_USE_WORK_STEALING
+
+///////////////////////////////////////////////////////////////////////////
+// Idle spinning
+
+// Tell the processor that the thread is spinning, which saves power and
+// leaves more resources to the other hyper-thread of the core.
+static inline void lCpuRelax() {
+#if defined(ISPC_IS_WINDOWS)
+    YieldProcessor();
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+#define SPIN_CHECK_INTERVAL 256
+
+/* Spin for up to the spin time of lSpinNanoseconds() until ready() returns
+   true, and return whether it did, so the caller only needs to sleep if it
+   didn't.  The processor is given up now and then, in case other threads
+   are waiting to run on it. */
+template <typename Ready> static bool lSpinUntil(Ready ready) {
+    const int64_t spin = lSpinNanoseconds();
+    if (spin == 0)
+        return false;
+    const int64_t deadline = lNanoseconds() + spin;
+    for (int i = 1;; ++i) {
+        if (ready())
+            return true;
+        lCpuRelax();
+        if (i % SPIN_CHECK_INTERVAL == 0) {
+            if (lNanoseconds() >= deadline)
+                return ready();
+            std::this_thread::yield();
+        }
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////
+// Cancellation
+
+#ifndef ISPC_USE_PTHREADS_FULLY_SUBSCRIBED
+
+/* The group of the tasks that the thread is running, which cancel_tasks()
+   and task_cancelled() refer to.  It's saved and restored around the tasks,
+   since a thread runs the tasks of other groups while it waits in
+   ISPCSync(). */
+static thread_local TaskGroup *currentTaskGroup = NULL;
+
+// Run the tasks from begin to end of the TaskInfo, unless its group is
+// cancelled; the group is checked again before each task.
+static void lRunTaskRange(const TaskInfo *ti, int begin, int end, int threadIndex, int threadCount) {
+    TaskGroup *group = ti->group;
+    TaskGroup *outerGroup = currentTaskGroup;
+    currentTaskGroup = group;
+    const int count = ti->taskCount();
+    const int count0 = ti->taskCount0(), count1 = ti->taskCount1(), count2 = ti->taskCount2();
+    for (int i = begin; i < end && !group->IsCancelled(); ++i)
+        ti->func(ti->data, threadIndex, threadCount, i, count, i % count0, (i / count0) % count1,
+                 i / (count0 * count1), count0, count1, count2);
+    currentTaskGroup = outerGroup;
+}
+
+inline void TaskInfo::run(int threadIndex, int threadCount) const {
+    lRunTaskRange(this, taskIndex, taskIndex + taskGrainCount(), threadIndex, threadCount);
+}
+
+// Cancel the group of the running task; does nothing outside of tasks.
+void ISPCCancelTasks() {
+    if (currentTaskGroup != NULL)
+        currentTaskGroup->Cancel();
+}
+
+int ISPCTasksCancelled() { return currentTaskGroup != NULL && currentTaskGroup->IsCancelled(); }
+
+#endif // ISPC_USE_PTHREADS_FULLY_SUBSCRIBED
 
 ///////////////////////////////////////////////////////////////////////////
 // Grand Central Dispatch
@@ -505,9 +1354,8 @@ static void lRunTask(void *ti) {
     int threadCount = 1;
 
     // Actually run the task
-    taskInfo->func(taskInfo->data, threadIndex, threadCount, taskInfo->taskIndex, taskInfo->taskCount(),
-                   taskInfo->taskIndex0(), taskInfo->taskIndex1(), taskInfo->taskIndex2(), taskInfo->taskCount0(),
-                   taskInfo->taskCount1(), taskInfo->taskCount2());
+    ISPC_ITT_TASK(taskInfo->func);
+    taskInfo->run(threadIndex, threadCount);
 }
 
 inline void TaskGroup::Launch(int baseIndex, int count) {
@@ -539,8 +1387,10 @@ static void __cdecl lRunTask(LPVOID param) {
     // will cause bugs in code that uses those.
     int threadIndex = 0;
     int threadCount = 1;
-    ti->func(ti->data, threadIndex, threadCount, ti->taskIndex, ti->taskCount(), ti->taskIndex0(), ti->taskIndex1(),
-             ti->taskIndex2(), ti->taskCount0(), ti->taskCount1(), ti->taskCount2());
+    {
+        ISPC_ITT_TASK(ti->func);
+        ti->run(threadIndex, threadCount);
+    }
 
     // Signal the event that this task is done
     ti->taskEvent.set();
@@ -552,11 +1402,12 @@ inline void TaskGroup::Launch(int baseIndex, int count) {
 }
 
 inline void TaskGroup::Sync() {
-    for (int i = 0; i < nextTaskInfoIndex; ++i) {
+    for (int i = nSyncedTasks; i < nextTaskInfoIndex; ++i) {
         TaskInfo *ti = GetTaskInfo(i);
         ti->taskEvent.wait();
         ti->taskEvent.reset();
     }
+    nSyncedTasks = nextTaskInfoIndex;
 }
 
 #endif // ISPC_USE_CONCRT
@@ -575,9 +1426,23 @@ static pthread_mutex_t taskSysMutex;
 static std::vector<TaskGroup *> activeTaskGroups;
 static sem_t *workerSemaphore;
 
+// Index of the worker running on this thread, -1 for other threads.
+static thread_local int workerIndex = -1;
+
+/* A thread waiting in TaskGroup::Sync() runs tasks from other groups in the
+   meantime.  Those tasks may wait for their own tasks in turn, so this
+   limits how deeply such waits nest on the thread's stack; beyond it, only
+   the tasks of the group being waited for are run. */
+#define MAX_SYNC_HELP_DEPTH 64
+static thread_local int syncHelpDepth = 0;
+
 static void *lTaskEntry(void *arg) {
-    int threadIndex = (int)((int64_t)arg);
-    int threadCount = nThreads;
+    workerIndex = (int)((int64_t)arg);
+    // The threads that wait in Sync() also run tasks and use index zero.
+    int threadIndex = workerIndex + 1;
+    int threadCount = nThreads + 1;
+    lPinWorkerThread(workerIndex);
+    lStatsSetWorker(threadIndex);
 
     while (1) {
         int err;
@@ -585,10 +1450,13 @@ static void *lTaskEntry(void *arg) {
         // Wait on the semaphore until we're woken up due to the arrival of
         // more work.
         //
-        if ((err = sem_wait(workerSemaphore)) != 0) {
+        int64_t idleStart = lStatsNanoseconds();
+        bool woken = lSpinUntil([]() { return sem_trywait(workerSemaphore) == 0; });
+        if (!woken && (err = sem_wait(workerSemaphore)) != 0) {
             fprintf(stderr, "Error from sem_wait: %s\n", strerror(err));
             exit(1);
         }
+        lStatsTime(&TaskingThreadStats::idleNanoseconds, idleStart);
 
         //
         // Acquire the mutex
@@ -635,9 +1503,11 @@ static void *lTaskEntry(void *arg) {
         //
         DBG(fprintf(stderr, "running task %d from group %p\n", taskNumber, tg));
         TaskInfo *myTask = tg->GetTaskInfo(taskNumber);
-        myTask->func(myTask->data, threadIndex, threadCount, myTask->taskIndex, myTask->taskCount(),
-                     myTask->taskIndex0(), myTask->taskIndex1(), myTask->taskIndex2(), myTask->taskCount0(),
-                     myTask->taskCount1(), myTask->taskCount2());
+        lStatsRunTasks(myTask->taskGrainCount(), myTask->queueTime);
+        {
+            ISPC_ITT_TASK(myTask->func);
+            myTask->run(threadIndex, threadCount);
+        }
 
         //
         // Decrement the "number of unfinished tasks" counter in the task
@@ -659,7 +1529,7 @@ static void InitTaskSystem() {
                     // We launch one fewer thread than there are cores,
                     // since the main thread here will also grab jobs from
                     // the task queue itself.
-                    nThreads = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+                    nThreads = lNumTaskingThreads() - 1;
 
                     int err;
                     if ((err = pthread_mutex_init(&taskSysMutex, NULL)) != 0) {
@@ -687,7 +1557,7 @@ static void InitTaskSystem() {
                         exit(1);
                     }
 
-                    threads = (pthread_t *)malloc(nThreads * sizeof(pthread_t));
+                    threads = (pthread_t *)malloc(std::max(1, nThreads) * sizeof(pthread_t));
                     if (threads == NULL) {
                         fprintf(stderr, "Error creating pthreads: %s\n", strerror(err));
                         exit(1);
@@ -715,6 +1585,11 @@ static void InitTaskSystem() {
 }
 
 inline void TaskGroup::Launch(int baseCoord, int count) {
+    // An empty launch mustn't put the task group on the active list, since
+    // the workers expect it to have waiting tasks there.
+    if (count == 0)
+        return;
+
     //
     // Acquire mutex, add task
     //
@@ -733,6 +1608,7 @@ inline void TaskGroup::Launch(int baseCoord, int count) {
     // per-TaskGroup mutex showed worse performance!)
     for (int i = 0; i < count; ++i)
         waitingTasks.push_back(baseCoord + i);
+    lStatsQueueDepth(waitingTasks.size());
 
     // Add the task group to the global active list if it isn't there
     // already.
@@ -766,6 +1642,9 @@ inline void TaskGroup::Launch(int baseCoord, int count) {
 
 inline void TaskGroup::Sync() {
     DBG(fprintf(stderr, "syncing %p - %d unfinished\n", tg, numUnfinishedTasks));
+    const int threadIndex = workerIndex + 1;
+    const int threadCount = nThreads + 1;
+    ++syncHelpDepth;
 
     while (numUnfinishedTasks > 0) {
         // All of the tasks in this group aren't finished yet.  We'll try
@@ -800,19 +1679,18 @@ inline void TaskGroup::Sync() {
             // Other threads are already working on all of the tasks in
             // this group, so we can't help out by running one ourself.
             // We'll try to run one from another group to make ourselves
-            // useful here.
-            if (activeTaskGroups.size() == 0) {
-                // No active task groups left--there's nothing for us to do.
+            // useful here.  The last group on the active list is the most
+            // recently launched one, which is usually the most deeply
+            // nested one and the quickest to finish.
+            if (activeTaskGroups.size() == 0 || syncHelpDepth > MAX_SYNC_HELP_DEPTH) {
+                // Nothing that we can run--the remaining tasks of the group
+                // are just about done by the other threads, so give up the
+                // processor only briefly rather than sleeping.
                 if ((err = pthread_mutex_unlock(&taskSysMutex)) != 0) {
                     fprintf(stderr, "Error from pthread_mutex_unlock: %s\n", strerror(err));
                     exit(1);
                 }
-                // FIXME: We basically end up busy-waiting here, which is
-                // extra wasteful in a world with hyper-threading.  It would
-                // be much better to put this thread to sleep on a
-                // condition variable that was signaled when the last task
-                // in this group was finished.
-                usleep(1);
+                sched_yield();
                 continue;
             }
 
@@ -840,10 +1718,11 @@ inline void TaskGroup::Sync() {
         //
         // Do work for _myTask_
         //
-        // FIXME: bogus values for thread index/thread count here as well..
-        myTask->func(myTask->data, 0, 1, myTask->taskIndex, myTask->taskCount(), myTask->taskIndex0(),
-                     myTask->taskIndex1(), myTask->taskIndex2(), myTask->taskCount0(), myTask->taskCount1(),
-                     myTask->taskCount2());
+        lStatsRunTasks(myTask->taskGrainCount(), myTask->queueTime);
+        {
+            ISPC_ITT_TASK(myTask->func);
+            myTask->run(threadIndex, threadCount);
+        }
 
         //
         // Decrement the number of unfinished tasks counter
@@ -851,6 +1730,7 @@ inline void TaskGroup::Sync() {
         lMemFence();
         lAtomicAdd(&runtg->numUnfinishedTasks, -1);
     }
+    --syncHelpDepth;
     DBG(fprintf(stderr, "sync for %p done!n", tg));
 }
 
@@ -861,12 +1741,18 @@ inline void TaskGroup::Sync() {
 
 #ifdef ISPC_USE_OMP
 
+static int ompNumThreads = 0;
+
 static void InitTaskSystem() {
-    // No initialization needed
+    // Without a setting, the OpenMP runtime picks the number of threads,
+    // which can be controlled with OMP_NUM_THREADS, and their affinity
+    // with OMP_PLACES and OMP_PROC_BIND.
+    if (ompNumThreads == 0)
+        ompNumThreads = lTaskingThreadsSet() ? lNumTaskingThreads() : omp_get_max_threads();
 }
 
 inline void TaskGroup::Launch(int baseIndex, int count) {
-#pragma omp parallel
+#pragma omp parallel num_threads(ompNumThreads)
     {
         const int threadIndex = omp_get_thread_num();
         const int threadCount = omp_get_num_threads();
@@ -876,8 +1762,8 @@ inline void TaskGroup::Launch(int baseIndex, int count) {
             TaskInfo *ti = GetTaskInfo(baseIndex + i);
 
             // Actually run the task.
-            ti->func(ti->data, threadIndex, threadCount, ti->taskIndex, ti->taskCount(), ti->taskIndex0(),
-                     ti->taskIndex1(), ti->taskIndex2(), ti->taskCount0(), ti->taskCount1(), ti->taskCount2());
+            ISPC_ITT_TASK(ti->func);
+            ti->run(threadIndex, threadCount);
         }
     }
 }
@@ -889,13 +1775,21 @@ inline void TaskGroup::Sync() {}
 ///////////////////////////////////////////////////////////////////////////
 // Thread Building Blocks
 
-#ifdef ISPC_USE_TBB_PARALLEL_FOR
+#if defined(ISPC_USE_TBB_PARALLEL_FOR) || defined(ISPC_USE_TBB_TASK_GROUP)
+
+static tbb::global_control *tbbThreadLimit = NULL;
 
 static void InitTaskSystem() {
-    // No initialization needed by default
-    // tbb::task_scheduler_init();
+    // TBB picks the number of threads unless it's set.  The CPUs to pin
+    // threads to aren't supported, since TBB owns its threads.
+    if (tbbThreadLimit == NULL && lTaskingThreadsSet())
+        tbbThreadLimit = new tbb::global_control(tbb::global_control::max_allowed_parallelism, lNumTaskingThreads());
 }
 
+#endif // ISPC_USE_TBB_PARALLEL_FOR || ISPC_USE_TBB_TASK_GROUP
+
+#ifdef ISPC_USE_TBB_PARALLEL_FOR
+
 inline void TaskGroup::Launch(int baseIndex, int count) {
     tbb::parallel_for(0, count, [=](int i) {
         TaskInfo *ti = GetTaskInfo(baseIndex + i);
@@ -905,8 +1799,8 @@ inline void TaskGroup::Launch(int baseIndex, int count) {
         int threadIndex = ti->taskIndex;
         int threadCount = ti->taskCount();
 
-        ti->func(ti->data, threadIndex, threadCount, ti->taskIndex, ti->taskCount(), ti->taskIndex0(), ti->taskIndex1(),
-                 ti->taskIndex2(), ti->taskCount0(), ti->taskCount1(), ti->taskCount2());
+        ISPC_ITT_TASK(ti->func);
+        ti->run(threadIndex, threadCount);
     });
 }
 
@@ -916,11 +1810,6 @@ inline void TaskGroup::Sync() {}
 
 #ifdef ISPC_USE_TBB_TASK_GROUP
 
-static void InitTaskSystem() {
-    // No initialization needed by default
-    // tbb::task_scheduler_init();
-}
-
 inline void TaskGroup::Launch(int baseIndex, int count) {
     for (int i = 0; i < count; i++) {
         tbbTaskGroup.run([=]() {
@@ -929,8 +1818,8 @@ inline void TaskGroup::Launch(int baseIndex, int count) {
             // TBB does not expose the task -> thread mapping so we pretend it's 1:1
             int threadIndex = ti->taskIndex;
             int threadCount = ti->taskCount();
-            ti->func(ti->data, threadIndex, threadCount, ti->taskIndex, ti->taskCount(), ti->taskIndex0(),
-                     ti->taskIndex1(), ti->taskIndex2(), ti->taskCount0(), ti->taskCount1(), ti->taskCount2());
+            ISPC_ITT_TASK(ti->func);
+            ti->run(threadIndex, threadCount);
         });
     }
 }
@@ -951,9 +1840,7 @@ inline void TaskGroup::Launch(int baseIndex, int count) {
         TaskInfo *ti = GetTaskInfo(baseIndex + i);
         int threadIndex = i;
         int threadCount = count;
-        futures.push_back(hpx::async(ti->func, ti->data, threadIndex, threadCount, ti->taskIndex, ti->taskCount(),
-                                     ti->taskIndex0(), ti->taskIndex1(), ti->taskIndex2(), ti->taskCount0(),
-                                     ti->taskCount1(), ti->taskCount2()));
+        futures.push_back(hpx::async([=]() { ti->run(threadIndex, threadCount); }));
     }
 }
 
@@ -962,23 +1849,789 @@ inline void TaskGroup::Sync() {
     futures.clear();
 }
 #endif
+
 ///////////////////////////////////////////////////////////////////////////
+// Work stealing
 
-#ifndef ISPC_USE_PTHREADS_FULLY_SUBSCRIBED
+#ifdef ISPC_USE_WORK_STEALING
 
-#define MAX_FREE_TASK_GROUPS 64
-static TaskGroup *freeTaskGroups[MAX_FREE_TASK_GROUPS];
+/* The Chase-Lev work-stealing deque ("Dynamic Circular Work-Stealing
+   Deque", SPAA 2005), with the memory orderings of Le et al., "Correct and
+   Efficient Work-Stealing for Weak Memory Models", PPoPP 2013.  Only the
+   owning thread pushes and pops at the bottom; other threads steal from
+   the top.  The buffers replaced when the deque grows are kept until the
+   deque is destroyed, since thieves may still read from them.
+ */
+class WorkStealingDeque {
+  public:
+    WorkStealingDeque() : top(0), bottom(0) {
+        buffers.push_back(new Buffer(1024));
+        buffer.store(buffers.back(), std::memory_order_relaxed);
+    }
 
-static inline TaskGroup *AllocTaskGroup() {
-    for (int i = 0; i < MAX_FREE_TASK_GROUPS; ++i) {
-        TaskGroup *tg = freeTaskGroups[i];
-        if (tg != NULL) {
-            void *ptr = lAtomicCompareAndSwapPointer((void **)(&freeTaskGroups[i]), NULL, tg);
-            if (ptr != NULL) {
-                return (TaskGroup *)ptr;
+    ~WorkStealingDeque() {
+        for (Buffer *b : buffers)
+            delete b;
+    }
+
+    // Returns the number of tasks in the deque, not counting any that are
+    // being stolen concurrently.
+    int64_t Push(TaskInfo *ti) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        Buffer *a = buffer.load(std::memory_order_relaxed);
+        if (b - t > a->size - 1) {
+            a = Grow(a, t, b);
+        }
+        a->Put(b, ti);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return b + 1 - t;
+    }
+
+    TaskInfo *Pop() {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Buffer *a = buffer.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        TaskInfo *ti = NULL;
+        if (t <= b) {
+            ti = a->Get(b);
+            if (t == b) {
+                // Last task in the deque; race against the thieves for it.
+                if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    ti = NULL;
+                bottom.store(b + 1, std::memory_order_relaxed);
             }
+        } else {
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return ti;
+    }
+
+    TaskInfo *Steal() {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return NULL;
+        Buffer *a = buffer.load(std::memory_order_acquire);
+        TaskInfo *ti = a->Get(t);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return NULL; // Lost the race to the owner or another thief
+        return ti;
+    }
+
+  private:
+    struct Buffer {
+        Buffer(int64_t size) : size(size), tasks(new std::atomic<TaskInfo *>[size]) {}
+        ~Buffer() { delete[] tasks; }
+        TaskInfo *Get(int64_t i) const { return tasks[i & (size - 1)].load(std::memory_order_relaxed); }
+        void Put(int64_t i, TaskInfo *ti) { tasks[i & (size - 1)].store(ti, std::memory_order_relaxed); }
+
+        const int64_t size;
+        std::atomic<TaskInfo *> *tasks;
+    };
+
+    Buffer *Grow(Buffer *a, int64_t t, int64_t b) {
+        Buffer *grown = new Buffer(2 * a->size);
+        for (int64_t i = t; i < b; ++i)
+            grown->Put(i, a->Get(i));
+        buffers.push_back(grown);
+        buffer.store(grown, std::memory_order_release);
+        return grown;
+    }
+
+    std::atomic<int64_t> top;
+    std::atomic<int64_t> bottom;
+    std::atomic<Buffer *> buffer;
+    // Only accessed by the owner.
+    std::vector<Buffer *> buffers;
+};
+
+/* Hybrid processors have cores of different classes, like the P-cores and
+   E-cores of Intel(R) processors.  The CPUs that this process may run on are
+   returned for each class, from the fastest to the slowest, or in no class
+   at all if the cores are all alike or can't be told apart, if the CPUs to
+   pin the workers to were set, or if the ISPC_CORE_CLASSES environment
+   variable is set to 0.  On Linux, they're read from the CPU lists of the
+   cpu_core and cpu_atom PMUs in sysfs, or else from the capacities of the
+   CPUs that the scheduler uses on other architectures, and on Windows from
+   the efficiency classes of the cores. */
+#define MAX_CORE_CLASSES 4
+
+// Group the CPUs by their rank, lowest first, into at most MAX_CORE_CLASSES classes.
+static std::vector<std::vector<int>> lGroupCoreClasses(std::vector<std::pair<long, int>> &ranked) {
+    std::vector<std::vector<int>> classes;
+    std::sort(ranked.begin(), ranked.end());
+    for (size_t i = 0; i < ranked.size(); ++i) {
+        if (i == 0 || (ranked[i].first != ranked[i - 1].first && classes.size() < MAX_CORE_CLASSES))
+            classes.push_back(std::vector<int>());
+        classes.back().push_back(ranked[i].second);
+    }
+    return classes;
+}
+
+static std::vector<std::vector<int>> lGetCoreClassCpus() {
+    std::vector<std::vector<int>> classes;
+    lReadTaskingConfig();
+    const char *env = getenv("ISPC_CORE_CLASSES");
+    if ((env != NULL && atoi(env) == 0) || !taskingCpus.empty())
+        return classes;
+#if defined(__linux__)
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return classes;
+    auto readCpuList = [&allowed](const char *path) {
+        std::vector<int> cpus;
+        FILE *f = fopen(path, "r");
+        if (f == NULL)
+            return cpus;
+        char list[4096];
+        if (fgets(list, sizeof(list), f) != NULL) {
+            for (int cpu : lParseCpuList(list))
+                if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+                    cpus.push_back(cpu);
+        }
+        fclose(f);
+        return cpus;
+    };
+    std::vector<int> pCores = readCpuList("/sys/devices/cpu_core/cpus");
+    std::vector<int> eCores = readCpuList("/sys/devices/cpu_atom/cpus");
+    if (!pCores.empty() || !eCores.empty()) {
+        classes.push_back(pCores);
+        classes.push_back(eCores);
+    } else {
+        std::vector<std::pair<long, int>> ranked;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (!CPU_ISSET(cpu, &allowed))
+                continue;
+            char path[96];
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpu_capacity", cpu);
+            FILE *f = fopen(path, "r");
+            if (f == NULL)
+                return classes;
+            long capacity;
+            if (fscanf(f, "%ld", &capacity) == 1)
+                ranked.push_back(std::make_pair(-capacity, cpu));
+            fclose(f);
+        }
+        classes = lGroupCoreClasses(ranked);
+    }
+#elif defined(ISPC_IS_WINDOWS)
+    DWORD size = 0;
+    GetLogicalProcessorInformationEx(RelationProcessorCore, NULL, &size);
+    std::vector<char> buffer(size);
+    DWORD_PTR processMask, systemMask;
+    if (size == 0 ||
+        !GetLogicalProcessorInformationEx(RelationProcessorCore,
+                                          (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *)buffer.data(), &size) ||
+        !GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+        return classes;
+    // Only the CPUs of the first processor group, which SetThreadAffinityMask() pins to.
+    std::vector<std::pair<long, int>> ranked;
+    for (DWORD offset = 0; offset < size;) {
+        const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *info =
+            (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *)(buffer.data() + offset);
+        const PROCESSOR_RELATIONSHIP &core = info->Processor;
+        if (core.GroupCount > 0 && core.GroupMask[0].Group == 0) {
+            for (int cpu = 0; cpu < (int)(8 * sizeof(KAFFINITY)); ++cpu)
+                if (core.GroupMask[0].Mask & processMask & ((KAFFINITY)1 << cpu))
+                    ranked.push_back(std::make_pair(-(long)core.EfficiencyClass, cpu));
+        }
+        offset += info->Size;
+    }
+    classes = lGroupCoreClasses(ranked);
+#endif
+    classes.erase(std::remove_if(classes.begin(), classes.end(),
+                                 [](const std::vector<int> &cpus) { return cpus.empty(); }),
+                  classes.end());
+    if (classes.size() < 2)
+        classes.clear();
+    return classes;
+}
+
+// Pin the current thread to the given CPUs.
+static void lPinThreadToCpus(const std::vector<int> &cpus) {
+#if defined(__linux__)
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for (int cpu : cpus)
+        if (cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &cpuset);
+    sched_setaffinity(0, sizeof(cpuset), &cpuset);
+#elif defined(ISPC_IS_WINDOWS)
+    DWORD_PTR mask = 0;
+    for (int cpu : cpus)
+        if (cpu < (int)(8 * sizeof(DWORD_PTR)))
+            mask |= (DWORD_PTR)1 << cpu;
+    SetThreadAffinityMask(GetCurrentThread(), mask);
+#else
+    (void)cpus;
+#endif
+}
+
+/* The state of the task system is allocated once and never freed, so that
+   the worker threads, which are never joined, don't outlive it at exit. */
+struct WorkStealingSystem {
+    int nWorkers;
+    WorkStealingDeque *deques;
+
+    // Worker i runs on node workerNode[i]; the workers of node n are
+    // nodeFirstWorker[n] up to nodeFirstWorker[n + 1].  There's a single
+    // node unless ISPC_USE_NUMA is defined.
+    int nNodes;
+    int *workerNode;
+    int *nodeFirstWorker;
+#ifdef ISPC_USE_NUMA
+    cpu_set_t *nodeCpus;
+    std::vector<int> cpuNode;
+#endif
+
+    // Worker i runs on the cores of class workerClass[i], 0 being the
+    // fastest; the workers of class c are classFirstWorker[c] up to
+    // classFirstWorker[c + 1], pinned to classCpus[c].  There's a single
+    // class unless the processor is hybrid and there's a single node.
+    int nClasses;
+    int *workerClass;
+    int *classFirstWorker;
+    std::vector<std::vector<int>> classCpus;
+
+    // Tasks launched from threads other than the workers, for each node.
+    struct SubmittedQueue {
+        std::mutex mutex;
+        std::deque<TaskInfo *> tasks;
+    };
+    SubmittedQueue *submitted;
+
+    // Sleeping workers are woken up when launchEpoch changes.
+    std::atomic<uint64_t> launchEpoch;
+    std::atomic<int> nSleeping;
+    // The sleeping workers of the fastest class, when there are several.
+    std::atomic<int> nSleepingFastest;
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+};
+
+static std::atomic<WorkStealingSystem *> workStealingSystem(NULL);
+static std::mutex workStealingInitMutex;
+
+// Index of the worker running on this thread, -1 for other threads.
+static thread_local int workerIndex = -1;
+
+static int lCurrentNode(WorkStealingSystem *ws) {
+    if (workerIndex >= 0)
+        return ws->workerNode[workerIndex];
+#ifdef ISPC_USE_NUMA
+    int cpu = sched_getcpu();
+    if (cpu >= 0 && cpu < (int)ws->cpuNode.size())
+        return ws->cpuNode[cpu];
+#endif
+    return 0;
+}
+
+static void lPushTask(WorkStealingSystem *ws, TaskInfo *ti) {
+    if (workerIndex >= 0) {
+        // Launches from a task go to the deque of the worker, from where
+        // it and the thieves pick them up.
+        lStatsQueueDepth(ws->deques[workerIndex].Push(ti));
+    } else {
+        WorkStealingSystem::SubmittedQueue &queue = ws->submitted[ti->node];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (ti->highPriority)
+            queue.tasks.push_front(ti);
+        else
+            queue.tasks.push_back(ti);
+        lStatsQueueDepth(queue.tasks.size());
+    }
+}
+
+/* The number of ranges to split a launch of the current thread into.  Only
+   launches from outside the workers are split across the nodes, unless the
+   affinity hint asks otherwise; the tasks launched from a task stay with the
+   worker's deque. */
+static int lNumLaunchRanges(int affinity) {
+    WorkStealingSystem *ws = workStealingSystem.load(std::memory_order_acquire);
+    if (ws->nWorkers == 0 || affinity == AffinityCompact)
+        return 1;
+    return (workerIndex >= 0 && affinity != AffinitySpread) ? 1 : ws->nNodes;
+}
+
+/* Set up the range of tasks of the given launch range.  The tasks are split
+   into contiguous ranges, sized by the number of workers of each node. */
+static void lSetLaunchRange(TaskInfo *ti, int range, int nRanges) {
+    WorkStealingSystem *ws = workStealingSystem.load(std::memory_order_acquire);
+    const int64_t count = ti->taskCount();
+    if (nRanges == 1) {
+        ti->node = lCurrentNode(ws);
+        ti->nextTask.store(0, std::memory_order_relaxed);
+        ti->endTask = (int)count;
+    } else {
+        ti->node = range;
+        ti->nextTask.store(count * ws->nodeFirstWorker[range] / ws->nWorkers, std::memory_order_relaxed);
+        ti->endTask = (int)(count * ws->nodeFirstWorker[range + 1] / ws->nWorkers);
+    }
+}
+
+// Queue the ranges of a launch once none of the launches it waits for is left.
+static void lLaunchDependencyDone(TaskInfo *launch) {
+    if (launch->launchWaitingFor.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        launch->group->Launch(launch->launchBaseIndex, launch->launchRanges);
+}
+
+static void lFinishLaunch(TaskInfo *launch) {
+    {
+        std::lock_guard<std::mutex> lock(launch->launchMutex);
+        launch->launchDone = true;
+    }
+    // No more dependents are added once the launch is done.
+    for (TaskInfo *dependent : launch->launchDependents)
+        lLaunchDependencyDone(dependent);
+}
+
+/* Claim a chunk of the remaining tasks of a launch and run them.  If tasks
+   remain after the chunk, the launch is queued again first, so that other
+   threads can claim them in the meantime.  The chunks get smaller as the
+   launch runs out of tasks, which keeps the threads busy until the end
+   without claiming each task separately while many are left. */
+static void lRunTasks(WorkStealingSystem *ws, TaskInfo *ti, int threadIndex, int threadCount) {
+    TaskGroup *group = ti->group;
+    TaskInfo *launch = ti->launch;
+    int64_t remaining = ti->endTask - ti->nextTask.load(std::memory_order_relaxed);
+    int64_t grain = std::max<int64_t>(ti->taskGrain, remaining / (2 * threadCount));
+    int64_t begin = ti->nextTask.fetch_add(grain, std::memory_order_relaxed);
+    // Once the group is cancelled, the claimed tasks are dropped and the
+    // launch isn't queued again.
+    if (begin < ti->endTask && !group->IsCancelled()) {
+        int64_t end = std::min<int64_t>(ti->endTask, begin + grain);
+        if (end < ti->endTask) {
+            launch->launchPending.fetch_add(1, std::memory_order_relaxed);
+            group->AddPending(1);
+            lPushTask(ws, ti);
+        }
+
+        lStatsRunTasks(end - begin, ti->queueTime);
+        ISPC_ITT_TASK(ti->func);
+        lRunTaskRange(ti, (int)begin, (int)end, threadIndex, threadCount);
+    }
+    if (launch->launchPending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        lFinishLaunch(launch);
+    // The task group may be reused as soon as the count drops to zero, so
+    // this must be the last access to the launch.
+    group->AddPending(-1);
+}
+
+// Try to steal from randomly chosen workers among the given ones.
+static TaskInfo *lSteal(WorkStealingSystem *ws, int firstVictim, int nVictims, uint32_t &rngState) {
+    for (int i = 0; i < nVictims; ++i) {
+        // xorshift32
+        rngState ^= rngState << 13;
+        rngState ^= rngState >> 17;
+        rngState ^= rngState << 5;
+        int victim = firstVictim + rngState % nVictims;
+        if (victim == workerIndex)
+            continue;
+        TaskInfo *ti = ws->deques[victim].Steal();
+        if (ti != NULL) {
+            lStatsSteal();
+            return ti;
+        }
+    }
+    return NULL;
+}
+
+/* Find a task to run: from the own deque for the workers, then from the
+   tasks submitted by other threads, then by stealing from random workers.
+   The submitted tasks and workers of the current node come first, and the
+   workers of the same class of cores on hybrid processors.  The workers of
+   the slower cores leave the submitted tasks with a high priority, which
+   should finish soon, to the workers of the fastest ones while some of them
+   are sleeping, as those are woken up for them. */
+static TaskInfo *lFindTask(WorkStealingSystem *ws, uint32_t &rngState) {
+    if (workerIndex >= 0) {
+        TaskInfo *ti = ws->deques[workerIndex].Pop();
+        if (ti != NULL)
+            return ti;
+    }
+
+    const int workerClass = workerIndex >= 0 ? ws->workerClass[workerIndex] : 0;
+    const bool leaveHighPriority = workerClass > 0 && ws->nSleepingFastest.load(std::memory_order_relaxed) > 0;
+    const int node = lCurrentNode(ws);
+    for (int i = 0; i < ws->nNodes; ++i) {
+        WorkStealingSystem::SubmittedQueue &queue = ws->submitted[(node + i) % ws->nNodes];
+        std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+        if (lock.owns_lock() && !queue.tasks.empty() && !(leaveHighPriority && queue.tasks.front()->highPriority)) {
+            TaskInfo *ti = queue.tasks.front();
+            queue.tasks.pop_front();
+            return ti;
+        }
+    }
+
+    int firstVictim = ws->nodeFirstWorker[node];
+    int nVictims = ws->nodeFirstWorker[node + 1] - firstVictim;
+    if (ws->nClasses > 1 && workerIndex >= 0) {
+        firstVictim = ws->classFirstWorker[workerClass];
+        nVictims = ws->classFirstWorker[workerClass + 1] - firstVictim;
+    }
+    TaskInfo *ti = lSteal(ws, firstVictim, nVictims, rngState);
+    if (ti == NULL && nVictims < ws->nWorkers)
+        ti = lSteal(ws, 0, ws->nWorkers, rngState);
+    return ti;
+}
+
+static void lWorkerEntry(WorkStealingSystem *ws, int index) {
+    workerIndex = index;
+    const bool fastest = ws->nClasses > 1 && ws->workerClass[index] == 0;
+    if (ws->nClasses > 1)
+        lPinThreadToCpus(ws->classCpus[ws->workerClass[index]]);
+#ifdef ISPC_USE_NUMA
+    else if (ws->nNodes > 1)
+        sched_setaffinity(0, sizeof(cpu_set_t), &ws->nodeCpus[ws->workerNode[index]]);
+#endif // ISPC_USE_NUMA
+    else
+        lPinWorkerThread(index);
+    uint32_t rngState = 2463534242u + index;
+    const int threadCount = ws->nWorkers + 1;
+    lStatsSetWorker(index + 1);
+
+    while (1) {
+        uint64_t epoch = ws->launchEpoch.load();
+        TaskInfo *ti = lFindTask(ws, rngState);
+        if (ti != NULL) {
+            // Thread index 0 is used by the threads outside of the task
+            // system.
+            lRunTasks(ws, ti, index + 1, threadCount);
+            continue;
         }
+
+        // Nothing to run.  Spin for a while, if set, and then sleep until
+        // more tasks are launched, unless some were launched since we
+        // started looking.
+        int64_t idleStart = lStatsNanoseconds();
+        if (lSpinUntil([&]() { return ws->launchEpoch.load(std::memory_order_relaxed) != epoch; })) {
+            lStatsTime(&TaskingThreadStats::idleNanoseconds, idleStart);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(ws->sleepMutex);
+        ws->nSleeping.fetch_add(1);
+        if (fastest)
+            ws->nSleepingFastest.fetch_add(1);
+        while (ws->launchEpoch.load() == epoch)
+            ws->sleepCondition.wait(lock);
+        if (fastest)
+            ws->nSleepingFastest.fetch_sub(1);
+        ws->nSleeping.fetch_sub(1);
+        lStatsTime(&TaskingThreadStats::idleNanoseconds, idleStart);
     }
+}
+
+#ifdef ISPC_USE_NUMA
+#define MAX_NUMA_NODES 64
+
+/* Get the CPUs that this process may run on, and that the workers are
+   pinned to if those were set, for each NUMA node that has any, from the
+   cpulist files of the nodes in sysfs. */
+static std::vector<std::vector<int>> lGetNumaNodeCpus() {
+    std::vector<std::vector<int>> nodes;
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return nodes;
+    lReadTaskingConfig();
+    if (!taskingCpus.empty()) {
+        cpu_set_t pinned;
+        CPU_ZERO(&pinned);
+        for (int cpu : taskingCpus)
+            if (cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &pinned);
+        CPU_AND(&allowed, &allowed, &pinned);
+    }
+
+    for (int node = 0; node < MAX_NUMA_NODES; ++node) {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE *f = fopen(path, "r");
+        // The node numbers aren't necessarily contiguous.
+        if (f == NULL)
+            continue;
+
+        char list[4096];
+        std::vector<int> cpus;
+        if (fgets(list, sizeof(list), f) != NULL) {
+            for (int cpu : lParseCpuList(list))
+                if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+                    cpus.push_back(cpu);
+        }
+        fclose(f);
+        if (!cpus.empty())
+            nodes.push_back(cpus);
+    }
+    return nodes;
+}
+#endif // ISPC_USE_NUMA
+
+static void InitTaskSystem() {
+    if (workStealingSystem.load(std::memory_order_acquire) != NULL)
+        return;
+
+    std::lock_guard<std::mutex> lock(workStealingInitMutex);
+    if (workStealingSystem.load(std::memory_order_relaxed) != NULL)
+        return;
+
+    WorkStealingSystem *ws = new WorkStealingSystem;
+    // We launch one fewer thread than there are cores, since the thread
+    // calling sync will also run the tasks.
+    std::vector<int> nodeWorkers;
+#ifdef ISPC_USE_NUMA
+    std::vector<std::vector<int>> nodes = lGetNumaNodeCpus();
+    if (nodes.size() > 1) {
+        ws->nodeCpus = new cpu_set_t[nodes.size()];
+        int callerCpu = sched_getcpu();
+        bool callerFound = false;
+        for (size_t n = 0; n < nodes.size(); ++n) {
+            CPU_ZERO(&ws->nodeCpus[n]);
+            int nCpus = 0;
+            for (int cpu : nodes[n]) {
+                CPU_SET(cpu, &ws->nodeCpus[n]);
+                if (cpu >= (int)ws->cpuNode.size())
+                    ws->cpuNode.resize(cpu + 1, 0);
+                ws->cpuNode[cpu] = (int)n;
+                if (cpu == callerCpu)
+                    callerFound = true;
+                else
+                    ++nCpus;
+            }
+            nodeWorkers.push_back(nCpus);
+        }
+        if (!callerFound)
+            nodeWorkers[0] = std::max(0, nodeWorkers[0] - 1);
+
+        // Take workers from the nodes with the most if fewer threads were
+        // requested.
+        int nWorkers = 0;
+        for (int n : nodeWorkers)
+            nWorkers += n;
+        for (; nWorkers > lNumTaskingThreads() - 1; --nWorkers)
+            --*std::max_element(nodeWorkers.begin(), nodeWorkers.end());
+    }
+#endif // ISPC_USE_NUMA
+    if (nodeWorkers.empty())
+        nodeWorkers.push_back(lNumTaskingThreads() - 1);
+
+    ws->nNodes = (int)nodeWorkers.size();
+    ws->nodeFirstWorker = new int[ws->nNodes + 1];
+    ws->nodeFirstWorker[0] = 0;
+    for (int n = 0; n < ws->nNodes; ++n)
+        ws->nodeFirstWorker[n + 1] = ws->nodeFirstWorker[n] + nodeWorkers[n];
+    ws->nWorkers = ws->nodeFirstWorker[ws->nNodes];
+    ws->workerNode = new int[ws->nWorkers];
+    for (int n = 0; n < ws->nNodes; ++n)
+        for (int i = ws->nodeFirstWorker[n]; i < ws->nodeFirstWorker[n + 1]; ++i)
+            ws->workerNode[i] = n;
+
+    // Give the workers to the fastest cores first, and any more than there
+    // are cores to the fastest ones too.
+    if (ws->nNodes == 1)
+        ws->classCpus = lGetCoreClassCpus();
+    ws->nClasses = std::max(1, (int)ws->classCpus.size());
+    std::vector<int> classWorkers(ws->nClasses, ws->nWorkers);
+    if (ws->nClasses > 1) {
+        int unassigned = ws->nWorkers;
+        for (int c = 0; c < ws->nClasses; ++c) {
+            classWorkers[c] = std::min(unassigned, (int)ws->classCpus[c].size());
+            unassigned -= classWorkers[c];
+        }
+        classWorkers[0] += unassigned;
+    }
+    ws->classFirstWorker = new int[ws->nClasses + 1];
+    ws->classFirstWorker[0] = 0;
+    for (int c = 0; c < ws->nClasses; ++c)
+        ws->classFirstWorker[c + 1] = ws->classFirstWorker[c] + classWorkers[c];
+    ws->workerClass = new int[ws->nWorkers];
+    for (int c = 0; c < ws->nClasses; ++c)
+        for (int i = ws->classFirstWorker[c]; i < ws->classFirstWorker[c + 1]; ++i)
+            ws->workerClass[i] = c;
+    ws->submitted = new WorkStealingSystem::SubmittedQueue[ws->nNodes];
+    ws->deques = new WorkStealingDeque[ws->nWorkers];
+    ws->launchEpoch.store(0);
+    ws->nSleeping.store(0);
+    ws->nSleepingFastest.store(0);
+    for (int i = 0; i < ws->nWorkers; ++i)
+        std::thread(lWorkerEntry, ws, i).detach();
+    workStealingSystem.store(ws, std::memory_order_release);
+}
+
+/* Queue the ranges of a launch, which are the TaskInfos here, once the
+   launches it waits for have finished. */
+inline void TaskGroup::Launch(int baseIndex, int count) {
+    WorkStealingSystem *ws = workStealingSystem.load(std::memory_order_acquire);
+    const int64_t queueTime = lStatsNanoseconds();
+    for (int i = 0; i < count; ++i) {
+        TaskInfo *ti = GetTaskInfo(baseIndex + i);
+        ti->queueTime = queueTime;
+        lPushTask(ws, ti);
+    }
+
+    ws->launchEpoch.fetch_add(1);
+    if (ws->nSleeping.load() > 0) {
+        // Taking the mutex makes sure that a worker which has seen the old
+        // epoch is waiting on the condition before it's notified.
+        { std::lock_guard<std::mutex> lock(ws->sleepMutex); }
+        ws->sleepCondition.notify_all();
+    }
+}
+
+/* Set up a launch that starts once the launches of the group with the given
+   numbers have finished.  The threads claim chunks from ranges of tasks,
+   which need a single TaskInfo each; the grain is the smallest chunk. */
+static void lLaunch(TaskGroup *taskGroup, void *func, void *data, int count0, int count1, int count2,
+                    const int64_t *after, int numAfter, int grain, int affinity, int priority) {
+    const int nRanges = lNumLaunchRanges(affinity);
+    int baseIndex = taskGroup->AllocTaskInfo(nRanges);
+    TaskInfo *launch = taskGroup->GetTaskInfo(baseIndex);
+    for (int i = 0; i < nRanges; ++i) {
+        TaskInfo *ti = taskGroup->GetTaskInfo(baseIndex + i);
+        ti->func = (TaskFuncType)func;
+        ti->data = data;
+        ti->taskIndex = 0;
+        ti->taskGrain = grain;
+        ti->taskCount3d[0] = count0;
+        ti->taskCount3d[1] = count1;
+        ti->taskCount3d[2] = count2;
+        ti->group = taskGroup;
+        ti->highPriority = priority == PriorityHigh;
+        ti->launch = launch;
+        lSetLaunchRange(ti, i, nRanges);
+    }
+    launch->launchBaseIndex = baseIndex;
+    launch->launchRanges = nRanges;
+    launch->launchPending.store(nRanges, std::memory_order_relaxed);
+    launch->launchDone = false;
+    launch->launchDependents.clear();
+    taskGroup->AddPending(nRanges);
+    lStatsLaunch(count0 * count1 * count2);
+
+    // Hold back the launch until all of the dependencies are registered.
+    launch->launchWaitingFor.store(1, std::memory_order_relaxed);
+    for (int i = 0; i < numAfter; ++i) {
+        // Launches from before the last sync have finished and have
+        // negative numbers.
+        TaskInfo *dependency = taskGroup->GetLaunch(after[i]);
+        if (dependency == NULL)
+            continue;
+        std::lock_guard<std::mutex> lock(dependency->launchMutex);
+        if (!dependency->launchDone) {
+            dependency->launchDependents.push_back(launch);
+            launch->launchWaitingFor.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    taskGroup->AddLaunch(launch);
+    lLaunchDependencyDone(launch);
+}
+
+inline void TaskGroup::Sync() {
+    WorkStealingSystem *ws = workStealingSystem.load(std::memory_order_acquire);
+    uint32_t rngState = 88675123u ^ (uint32_t)(intptr_t)this;
+    const int threadIndex = workerIndex + 1;
+    const int threadCount = ws->nWorkers + 1;
+
+    // Run tasks, from this group or others, instead of waiting idle for
+    // the remaining tasks of the group.
+    while (numPending.load(std::memory_order_acquire) > 0) {
+        TaskInfo *ti = lFindTask(ws, rngState);
+        if (ti != NULL)
+            lRunTasks(ws, ti, threadIndex, threadCount);
+        else
+            std::this_thread::yield();
+    }
+}
+
+#endif // ISPC_USE_WORK_STEALING
+
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef ISPC_USE_PTHREADS_FULLY_SUBSCRIBED
+
+/* Freed task groups are kept for reuse, along with their memory, first in
+   a small list of the thread that freed them, which needs no
+   synchronization, and then in a global stack.  A thread whose list is
+   empty takes task groups from the stack before allocating new ones. */
+#define MAX_LOCAL_FREE_TASK_GROUPS 8
+#define MAX_FREE_TASK_GROUPS 64
+
+#ifdef ISPC_USE_NUMA
+// Task groups are reused on the node that freed them, so that their memory
+// stays local to the threads that use it.
+#define NUM_FREE_TASK_GROUP_STACKS MAX_NUMA_NODES
+static inline int lFreeTaskGroupStack() {
+    // There's no task system with an executor installed.
+    WorkStealingSystem *ws = workStealingSystem.load(std::memory_order_acquire);
+    return ws != NULL ? lCurrentNode(ws) : 0;
+}
+#else
+#define NUM_FREE_TASK_GROUP_STACKS 1
+static inline int lFreeTaskGroupStack() { return 0; }
+#endif // ISPC_USE_NUMA
+
+struct FreeTaskGroupStack {
+    volatile int32_t lock;
+    int count;
+    TaskGroup *top;
+};
+static FreeTaskGroupStack freeTaskGroupStacks[NUM_FREE_TASK_GROUP_STACKS];
+
+static void lPushFreeTaskGroup(TaskGroup *tg) {
+    FreeTaskGroupStack &stack = freeTaskGroupStacks[lFreeTaskGroupStack()];
+    while (lAtomicCompareAndSwap32(&stack.lock, 1, 0) != 0)
+        ;
+    bool full = stack.count == MAX_FREE_TASK_GROUPS;
+    if (!full) {
+        tg->nextFree = stack.top;
+        stack.top = tg;
+        ++stack.count;
+    }
+    lMemFence();
+    stack.lock = 0;
+
+    if (full)
+        delete tg;
+}
+
+static TaskGroup *lPopFreeTaskGroup() {
+    FreeTaskGroupStack &stack = freeTaskGroupStacks[lFreeTaskGroupStack()];
+    while (lAtomicCompareAndSwap32(&stack.lock, 1, 0) != 0)
+        ;
+    TaskGroup *tg = stack.top;
+    if (tg != NULL) {
+        stack.top = tg->nextFree;
+        --stack.count;
+    }
+    lMemFence();
+    stack.lock = 0;
+    return tg;
+}
+
+struct LocalFreeTaskGroups {
+    LocalFreeTaskGroups() : count(0) {}
+    // Hand the task groups of an exiting thread over to the other threads.
+    ~LocalFreeTaskGroups() {
+        while (count > 0)
+            lPushFreeTaskGroup(groups[--count]);
+    }
+
+    int count;
+    TaskGroup *groups[MAX_LOCAL_FREE_TASK_GROUPS];
+};
+static thread_local LocalFreeTaskGroups localFreeTaskGroups;
+
+static inline TaskGroup *AllocTaskGroup() {
+    LocalFreeTaskGroups &local = localFreeTaskGroups;
+    if (local.count > 0)
+        return local.groups[--local.count];
+
+    TaskGroup *tg = lPopFreeTaskGroup();
+    if (tg != NULL)
+        return tg;
 
     return new TaskGroup;
 }
@@ -986,60 +2639,172 @@ static inline TaskGroup *AllocTaskGroup() {
 static inline void FreeTaskGroup(TaskGroup *tg) {
     tg->Reset();
 
-    for (int i = 0; i < MAX_FREE_TASK_GROUPS; ++i) {
-        if (freeTaskGroups[i] == NULL) {
-            void *ptr = lAtomicCompareAndSwapPointer((void **)&freeTaskGroups[i], tg, NULL);
-            if (ptr == NULL)
-                return;
-        }
-    }
+    LocalFreeTaskGroups &local = localFreeTaskGroups;
+    if (local.count < MAX_LOCAL_FREE_TASK_GROUPS)
+        local.groups[local.count++] = tg;
+    else
+        lPushFreeTaskGroup(tg);
+}
 
-    delete tg;
+///////////////////////////////////////////////////////////////////////////
+// External executors
+
+/* With an executor installed, the task groups only hold the memory and the
+   TaskInfos of the launches; a launch needs a single TaskInfo, since the
+   executor passes the task index to lRunExecutorTask().  With a grain, the
+   executor runs one index for each chunk of that many tasks. */
+static ISPCTaskExecutor taskExecutor;
+static bool taskExecutorSet = false;
+
+void ISPCSetTaskExecutor(const ISPCTaskExecutor *executor) {
+    taskExecutorSet = executor != NULL;
+    if (executor != NULL)
+        taskExecutor = *executor;
+}
+
+static void lRunExecutorTask(void *arg, int chunkIndex, int threadIndex, int threadCount) {
+    TaskInfo *ti = (TaskInfo *)arg;
+    const int64_t begin = (int64_t)chunkIndex * ti->taskGrain;
+    const int64_t end = std::min<int64_t>(begin + ti->taskGrain, ti->taskCount());
+    lStatsRunTasks((int)(end - begin), ti->queueTime);
+    ISPC_ITT_TASK(ti->func);
+    lRunTaskRange(ti, (int)begin, (int)end, threadIndex, threadCount);
+}
+
+static void lExecutorLaunch(TaskGroup *taskGroup, void *func, void *data, int count0, int count1, int count2,
+                            int grain) {
+    TaskInfo *ti = taskGroup->GetTaskInfo(taskGroup->AllocTaskInfo(1));
+    ti->func = (TaskFuncType)func;
+    ti->data = data;
+    ti->group = taskGroup;
+    ti->taskIndex = 0;
+    ti->taskGrain = grain;
+    ti->taskCount3d[0] = count0;
+    ti->taskCount3d[1] = count1;
+    ti->taskCount3d[2] = count2;
+    ti->queueTime = lStatsNanoseconds();
+    lStatsLaunch(ti->taskCount());
+    const int nChunks = (int)(((int64_t)ti->taskCount() + grain - 1) / grain);
+    if (nChunks > 0)
+        taskExecutor.launch(taskExecutor.context, &taskGroup->executorGroup, lRunExecutorTask, ti, nChunks);
+}
+
+static void lExecutorSync(TaskGroup *taskGroup) {
+    if (taskGroup->executorGroup != NULL) {
+        taskExecutor.sync(taskExecutor.context, taskGroup->executorGroup);
+        taskGroup->executorGroup = NULL;
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////
 
-void ISPCLaunch(void **taskGroupPtr, void *func, void *data, int count0, int count1, int count2) {
-    const int count = count0 * count1 * count2;
-    TaskGroup *taskGroup;
+static inline TaskGroup *lGetTaskGroup(void **taskGroupPtr) {
     if (*taskGroupPtr == NULL) {
-        InitTaskSystem();
-        taskGroup = AllocTaskGroup();
-        *taskGroupPtr = taskGroup;
-    } else
-        taskGroup = (TaskGroup *)(*taskGroupPtr);
+        if (!taskExecutorSet)
+            InitTaskSystem();
+        *taskGroupPtr = AllocTaskGroup();
+    }
+    return (TaskGroup *)(*taskGroupPtr);
+}
 
-    int baseIndex = taskGroup->AllocTaskInfo(count);
-    for (int i = 0; i < count; ++i) {
+/* Queue the tasks of a launch in chunks of grain tasks, which each need a
+   TaskInfo.  Only the work-stealing task system follows the affinity and
+   priority hints. */
+static void lLaunchTasks(void **taskGroupPtr, void *func, void *data, int count0, int count1, int count2, int grain,
+                         int affinity, int priority) {
+    const int count = count0 * count1 * count2;
+    TaskGroup *taskGroup = lGetTaskGroup(taskGroupPtr);
+    if (taskExecutorSet) {
+        lExecutorLaunch(taskGroup, func, data, count0, count1, count2, grain);
+        return;
+    }
+
+#ifdef ISPC_USE_WORK_STEALING
+    (void)count;
+    lLaunch(taskGroup, func, data, count0, count1, count2, NULL, 0, grain, affinity, priority);
+#else
+    (void)affinity;
+    (void)priority;
+    const int nChunks = (int)(((int64_t)count + grain - 1) / grain);
+    int baseIndex = taskGroup->AllocTaskInfo(nChunks);
+    const int64_t queueTime = lStatsNanoseconds();
+    for (int i = 0; i < nChunks; ++i) {
         TaskInfo *ti = taskGroup->GetTaskInfo(baseIndex + i);
         ti->func = (TaskFuncType)func;
         ti->data = data;
-        ti->taskIndex = i;
+        ti->group = taskGroup;
+        ti->taskIndex = (int)((int64_t)i * grain);
+        ti->taskGrain = grain;
         ti->taskCount3d[0] = count0;
         ti->taskCount3d[1] = count1;
         ti->taskCount3d[2] = count2;
+        ti->queueTime = queueTime;
     }
-    taskGroup->Launch(baseIndex, count);
+    lStatsLaunch(count);
+    taskGroup->Launch(baseIndex, nChunks);
+#endif // ISPC_USE_WORK_STEALING
+}
+
+void ISPCLaunch(void **taskGroupPtr, void *func, void *data, int count0, int count1, int count2) {
+    ISPC_ITT_SCOPE("ISPCLaunch");
+    lLaunchTasks(taskGroupPtr, func, data, count0, count1, count2, 1, AffinityDefault, PriorityNormal);
+}
+
+// Wait for all of the tasks launched from the task group.
+static void lSyncTaskGroup(TaskGroup *taskGroup) {
+    ISPC_ITT_SCOPE("ISPCSync");
+    int64_t syncStart = lStatsNanoseconds();
+    if (taskExecutorSet)
+        lExecutorSync(taskGroup);
+    else
+        taskGroup->Sync();
+    lStatsTime(&TaskingThreadStats::syncNanoseconds, syncStart);
+}
+
+void ISPCLaunchWithHints(void **taskGroupPtr, void *func, void *data, int count0, int count1, int count2,
+                         const int64_t *after, int numAfter, int grain, int affinity, int priority) {
+    ISPC_ITT_SCOPE("ISPCLaunch");
+    // A chunk has at least one task and at most all of them, so the chunk
+    // arithmetic of the task systems doesn't overflow.
+    grain = std::min(std::max(grain, 1), std::max(count0 * count1 * count2, 1));
+#ifdef ISPC_USE_WORK_STEALING
+    if (!taskExecutorSet) {
+        lLaunch(lGetTaskGroup(taskGroupPtr), func, data, count0, count1, count2, after, numAfter, grain, affinity,
+                priority);
+        return;
+    }
+#endif // ISPC_USE_WORK_STEALING
+    // The other task systems and the executors don't keep track of the
+    // individual launches, so wait for all of the tasks launched so far if
+    // there's anything to wait for.
+    TaskGroup *taskGroup = (TaskGroup *)(*taskGroupPtr);
+    if (taskGroup != NULL) {
+        for (int i = 0; i < numAfter; ++i) {
+            if (after[i] >= 0) {
+                lSyncTaskGroup(taskGroup);
+                break;
+            }
+        }
+    }
+    lLaunchTasks(taskGroupPtr, func, data, count0, count1, count2, grain, affinity, priority);
+}
+
+void ISPCLaunchAfter(void **taskGroupPtr, void *func, void *data, int count0, int count1, int count2,
+                     const int64_t *after, int numAfter) {
+    ISPCLaunchWithHints(taskGroupPtr, func, data, count0, count1, count2, after, numAfter, 1, AffinityDefault,
+                        PriorityNormal);
 }
 
 void ISPCSync(void *h) {
     TaskGroup *taskGroup = (TaskGroup *)h;
     if (taskGroup != NULL) {
-        taskGroup->Sync();
+        lSyncTaskGroup(taskGroup);
         FreeTaskGroup(taskGroup);
     }
 }
 
 void *ISPCAlloc(void **taskGroupPtr, int64_t size, int32_t alignment) {
-    TaskGroup *taskGroup;
-    if (*taskGroupPtr == NULL) {
-        InitTaskSystem();
-        taskGroup = AllocTaskGroup();
-        *taskGroupPtr = taskGroup;
-    } else
-        taskGroup = (TaskGroup *)(*taskGroupPtr);
-
-    return taskGroup->AllocMemory(size, alignment);
+    return lGetTaskGroup(taskGroupPtr)->AllocMemory(size, alignment);
 }
 
 #else // ISPC_USE_PTHREADS_FULLY_SUBSCRIBED
@@ -1214,7 +2979,7 @@ void TaskSys::createThreads() {
     init();
     int reserved = 4;
     int minid = 2;
-    nThreads = sysconf(_SC_NPROCESSORS_ONLN) - reserved;
+    nThreads = lTaskingThreadsSet() ? lNumTaskingThreads() : sysconf(_SC_NPROCESSORS_ONLN) - reserved;
 
     thread = (pthread_t *)malloc(nThreads * sizeof(pthread_t));
 
@@ -1224,7 +2989,7 @@ void TaskSys::createThreads() {
         pthread_attr_init(&attr);
         pthread_attr_setstacksize(&attr, 2 * 1024 * 1024);
 
-        int threadID = minid + i;
+        int threadID = taskingCpus.empty() ? minid + i : taskingCpus[i % taskingCpus.size()];
         cpu_set_t cpuset;
         CPU_ZERO(&cpuset);
         CPU_SET(threadID, &cpuset);
@@ -3,11 +3,14 @@
 
 #include "ispcrt.h"
 // std
+#include <cstring>
 #include <exception>
 #include <iostream>
 // ispcrt
 #include "detail/Exception.h"
+#include "detail/MappedFile.h"
 #include "detail/Module.h"
+#include "detail/ModuleFuture.h"
 #include "detail/TaskQueue.h"
 
 #ifdef ISPCRT_BUILD_CPU
@@ -90,23 +93,21 @@ void ispcrtSetErrorFunc(ISPCRTErrorFunc fcn) { g_errorFcn = fcn; }
 // Object lifetime ////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
-long long ispcrtUseCount(ISPCRTGenericHandle h) ISPCRT_CATCH_BEGIN {
+// Reference counting can't fail, so it doesn't go through the translation of exceptions into errors
+long long ispcrtUseCount(ISPCRTGenericHandle h) {
     auto &obj = referenceFromHandle(h);
     return obj.useCount();
 }
-ISPCRT_CATCH_END(0)
 
-void ispcrtRelease(ISPCRTGenericHandle h) ISPCRT_CATCH_BEGIN {
+void ispcrtRelease(ISPCRTGenericHandle h) {
     auto &obj = referenceFromHandle(h);
     obj.refDec();
 }
-ISPCRT_CATCH_END_NO_RETURN()
 
-void ispcrtRetain(ISPCRTGenericHandle h) ISPCRT_CATCH_BEGIN {
+void ispcrtRetain(ISPCRTGenericHandle h) {
     auto &obj = referenceFromHandle(h);
     obj.refInc();
 }
-ISPCRT_CATCH_END_NO_RETURN()
 
 ///////////////////////////////////////////////////////////////////////////////
 // Device initialization //////////////////////////////////////////////////////
@@ -229,6 +230,20 @@ void ispcrtGetDeviceInfo(ISPCRTDeviceType type, uint32_t deviceIdx, ISPCRTDevice
 }
 ISPCRT_CATCH_END_NO_RETURN()
 
+uint32_t ispcrtGetSubDeviceCount(ISPCRTDevice d) ISPCRT_CATCH_BEGIN {
+    const auto &device = referenceFromHandle<ispcrt::base::Device>(d);
+    return device.subDeviceCount();
+}
+ISPCRT_CATCH_END(0)
+
+ISPCRTDevice ispcrtGetSubDevice(ISPCRTDevice d, uint32_t subDeviceIdx) ISPCRT_CATCH_BEGIN {
+    const auto &device = referenceFromHandle<ispcrt::base::Device>(d);
+    if (subDeviceIdx >= device.subDeviceCount())
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "Invalid sub-device number!");
+    return (ISPCRTDevice)device.subDevice(subDeviceIdx);
+}
+ISPCRT_CATCH_END(nullptr)
+
 ///////////////////////////////////////////////////////////////////////////////
 // Context initialization //////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
@@ -305,6 +320,41 @@ ISPCRTMemoryView ispcrtNewMemoryViewForContext(ISPCRTContext c, void *appMemory,
 }
 ISPCRT_CATCH_END(nullptr)
 
+ISPCRTMemoryView ispcrtNewMemoryViewRange(ISPCRTMemoryView p, size_t offset, size_t numBytes) ISPCRT_CATCH_BEGIN {
+    auto &parent = referenceFromHandle<ispcrt::base::MemoryView>(p);
+    return (ISPCRTMemoryView) new ispcrt::base::MemoryViewRange(parent, offset, numBytes);
+}
+ISPCRT_CATCH_END(nullptr)
+
+ISPCRTMemoryView ispcrtImportMemoryView(ISPCRTDevice d, void *memBuffer, size_t numBytes) ISPCRT_CATCH_BEGIN {
+    const auto &device = referenceFromHandle<ispcrt::base::Device>(d);
+    return (ISPCRTMemoryView)device.importMemoryView(memBuffer, numBytes);
+}
+ISPCRT_CATCH_END(nullptr)
+
+ISPCRTMemoryView ispcrtImportDmaBufMemoryView(ISPCRTDevice d, int fd, size_t numBytes) ISPCRT_CATCH_BEGIN {
+    const auto &device = referenceFromHandle<ispcrt::base::Device>(d);
+    return (ISPCRTMemoryView)device.importDmaBufMemoryView(fd, numBytes);
+}
+ISPCRT_CATCH_END(nullptr)
+
+ISPCRTMemoryView ispcrtNewMemoryViewFromFile(ISPCRTDevice d, const char *path, size_t offset, size_t numBytes,
+                                             ISPCRTNewMemoryViewFlags *flags) ISPCRT_CATCH_BEGIN {
+    const auto &device = referenceFromHandle<ispcrt::base::Device>(d);
+    if (flags->allocType == ISPCRT_ALLOC_TYPE_SHARED) {
+        // Shared memory is allocated by the driver, so it can't be the mapping
+        ispcrt::base::MappedFile file(path, offset, numBytes);
+        auto *view = device.newMemoryView(nullptr, file.size(), flags);
+        memcpy(view->hostPtr(), file.data(), file.size());
+        return (ISPCRTMemoryView)view;
+    }
+    if (flags->allocType != ISPCRT_ALLOC_TYPE_DEVICE) {
+        throw std::runtime_error("Unsupported memory allocation type requested!");
+    }
+    return (ISPCRTMemoryView) new ispcrt::base::MappedFileMemoryView(device, path, offset, numBytes, flags);
+}
+ISPCRT_CATCH_END(nullptr)
+
 void *ispcrtHostPtr(ISPCRTMemoryView h) ISPCRT_CATCH_BEGIN {
     auto &mv = referenceFromHandle<ispcrt::base::MemoryView>(h);
     return mv.hostPtr();
@@ -355,6 +405,30 @@ ISPCRTModule ispcrtLoadModule(ISPCRTDevice d, const char *moduleFile,
 }
 ISPCRT_CATCH_END(nullptr)
 
+ISPCRTFuture ispcrtLoadModuleAsync(ISPCRTDevice d, const char *moduleFile,
+                                   ISPCRTModuleOptions moduleOpts) ISPCRT_CATCH_BEGIN {
+    if (!moduleFile)
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "Module file name is NULL!");
+    const auto &device = referenceFromHandle<ispcrt::base::Device>(d);
+    return (ISPCRTFuture) new ispcrt::base::ModuleFuture(device, moduleFile, moduleOpts);
+}
+ISPCRT_CATCH_END(nullptr)
+
+ISPCRTModule ispcrtFutureGetModule(ISPCRTFuture f) ISPCRT_CATCH_BEGIN {
+    auto *future = dynamic_cast<ispcrt::base::ModuleFuture *>(&referenceFromHandle<ispcrt::base::Future>(f));
+    if (!future)
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "Future is not a module loading!");
+    return (ISPCRTModule)future->module();
+}
+ISPCRT_CATCH_END(nullptr)
+
+ISPCRTModule ispcrtLoadModuleFromMemory(ISPCRTDevice d, const void *image, size_t size, ISPCRTModuleImageFormat format,
+                                        ISPCRTModuleOptions moduleOpts) ISPCRT_CATCH_BEGIN {
+    const auto &device = referenceFromHandle<ispcrt::base::Device>(d);
+    return (ISPCRTModule)device.newModuleFromMemory(image, size, format, moduleOpts);
+}
+ISPCRT_CATCH_END(nullptr)
+
 void ispcrtDynamicLinkModules(ISPCRTDevice d, ISPCRTModule *modules, const uint32_t numModules) ISPCRT_CATCH_BEGIN {
     const auto &device = referenceFromHandle<ispcrt::base::Device>(d);
     device.dynamicLinkModules((ispcrt::base::Module **)modules, numModules);
@@ -424,37 +498,116 @@ void ispcrtCopyMemoryView(ISPCRTTaskQueue q, ISPCRTMemoryView mvDst, ISPCRTMemor
 }
 ISPCRT_CATCH_END_NO_RETURN()
 
+// The launches of all dimensions share these, so that each call goes through a single try block
+static ISPCRTFuture launch(ISPCRTTaskQueue q, ISPCRTKernel k, ISPCRTMemoryView p, size_t dim0, size_t dim1,
+                           size_t dim2) {
+    auto &queue = referenceFromHandle<ispcrt::base::TaskQueue>(q);
+    auto &kernel = referenceFromHandle<ispcrt::base::Kernel>(k);
+
+    ispcrt::base::MemoryView *params = nullptr;
+
+    if (p)
+        params = &referenceFromHandle<ispcrt::base::MemoryView>(p);
+
+    return (ISPCRTFuture)queue.launch(kernel, params, dim0, dim1, dim2);
+}
+
+static ISPCRTFuture launchInline(ISPCRTTaskQueue q, ISPCRTKernel k, const void *params, size_t size, size_t dim0,
+                                 size_t dim1, size_t dim2) {
+    auto &queue = referenceFromHandle<ispcrt::base::TaskQueue>(q);
+    auto &kernel = referenceFromHandle<ispcrt::base::Kernel>(k);
+    return (ISPCRTFuture)queue.launchInline(kernel, params, size, dim0, dim1, dim2);
+}
+
 ISPCRTFuture ispcrtLaunch1D(ISPCRTTaskQueue q, ISPCRTKernel k, ISPCRTMemoryView p, size_t dim0) ISPCRT_CATCH_BEGIN {
-    return ispcrtLaunch3D(q, k, p, dim0, 1, 1);
+    return launch(q, k, p, dim0, 1, 1);
 }
 ISPCRT_CATCH_END(nullptr)
 
 ISPCRTFuture ispcrtLaunch2D(ISPCRTTaskQueue q, ISPCRTKernel k, ISPCRTMemoryView p, size_t dim0,
                             size_t dim1) ISPCRT_CATCH_BEGIN {
-    return ispcrtLaunch3D(q, k, p, dim0, dim1, 1);
+    return launch(q, k, p, dim0, dim1, 1);
 }
 ISPCRT_CATCH_END(nullptr)
 
 ISPCRTFuture ispcrtLaunch3D(ISPCRTTaskQueue q, ISPCRTKernel k, ISPCRTMemoryView p, size_t dim0, size_t dim1,
                             size_t dim2) ISPCRT_CATCH_BEGIN {
-    auto &queue = referenceFromHandle<ispcrt::base::TaskQueue>(q);
-    auto &kernel = referenceFromHandle<ispcrt::base::Kernel>(k);
+    return launch(q, k, p, dim0, dim1, dim2);
+}
+ISPCRT_CATCH_END(nullptr)
 
-    ispcrt::base::MemoryView *params = nullptr;
+ISPCRTFuture ispcrtLaunchInline1D(ISPCRTTaskQueue q, ISPCRTKernel k, const void *params, size_t size,
+                                  size_t dim0) ISPCRT_CATCH_BEGIN {
+    return launchInline(q, k, params, size, dim0, 1, 1);
+}
+ISPCRT_CATCH_END(nullptr)
 
-    if (p)
-        params = &referenceFromHandle<ispcrt::base::MemoryView>(p);
+ISPCRTFuture ispcrtLaunchInline2D(ISPCRTTaskQueue q, ISPCRTKernel k, const void *params, size_t size, size_t dim0,
+                                  size_t dim1) ISPCRT_CATCH_BEGIN {
+    return launchInline(q, k, params, size, dim0, dim1, 1);
+}
+ISPCRT_CATCH_END(nullptr)
 
-    return (ISPCRTFuture)queue.launch(kernel, params, dim0, dim1, dim2);
+ISPCRTFuture ispcrtLaunchInline3D(ISPCRTTaskQueue q, ISPCRTKernel k, const void *params, size_t size, size_t dim0,
+                                  size_t dim1, size_t dim2) ISPCRT_CATCH_BEGIN {
+    return launchInline(q, k, params, size, dim0, dim1, dim2);
 }
 ISPCRT_CATCH_END(nullptr)
 
+ISPCRTFuture ispcrtLaunchBatch(ISPCRTTaskQueue q, ISPCRTKernel k, const void *params, size_t size, const size_t *dims,
+                               size_t count) ISPCRT_CATCH_BEGIN {
+    auto &queue = referenceFromHandle<ispcrt::base::TaskQueue>(q);
+    auto &kernel = referenceFromHandle<ispcrt::base::Kernel>(k);
+    if (count == 0 || dims == nullptr)
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "No launches in the batch!");
+    return (ISPCRTFuture)queue.launchBatch(kernel, params, size, dims, count);
+}
+ISPCRT_CATCH_END(nullptr)
+
+void ispcrtSubmit(ISPCRTTaskQueue q) ISPCRT_CATCH_BEGIN {
+    auto &queue = referenceFromHandle<ispcrt::base::TaskQueue>(q);
+    queue.submit();
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
 void ispcrtSync(ISPCRTTaskQueue q) ISPCRT_CATCH_BEGIN {
     auto &queue = referenceFromHandle<ispcrt::base::TaskQueue>(q);
     queue.sync();
 }
 ISPCRT_CATCH_END_NO_RETURN()
 
+ISPCRTFuture ispcrtQueueSignal(ISPCRTTaskQueue q) ISPCRT_CATCH_BEGIN {
+    auto &queue = referenceFromHandle<ispcrt::base::TaskQueue>(q);
+    return (ISPCRTFuture)queue.signal();
+}
+ISPCRT_CATCH_END(nullptr)
+
+void ispcrtQueueWaitFuture(ISPCRTTaskQueue q, ISPCRTFuture f) ISPCRT_CATCH_BEGIN {
+    auto &queue = referenceFromHandle<ispcrt::base::TaskQueue>(q);
+    auto &future = referenceFromHandle<ispcrt::base::Future>(f);
+    queue.wait(future);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
+void ispcrtBeginCapture(ISPCRTTaskQueue q) ISPCRT_CATCH_BEGIN {
+    auto &queue = referenceFromHandle<ispcrt::base::TaskQueue>(q);
+    queue.beginCapture();
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
+ISPCRTGraph ispcrtEndCapture(ISPCRTTaskQueue q) ISPCRT_CATCH_BEGIN {
+    auto &queue = referenceFromHandle<ispcrt::base::TaskQueue>(q);
+    return (ISPCRTGraph)queue.endCapture();
+}
+ISPCRT_CATCH_END(nullptr)
+
+void ispcrtReplayGraph(ISPCRTTaskQueue q, ISPCRTGraph g) ISPCRT_CATCH_BEGIN {
+    auto &queue = referenceFromHandle<ispcrt::base::TaskQueue>(q);
+    auto &graph = referenceFromHandle<ispcrt::base::Graph>(g);
+    queue.replay(graph);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
 uint64_t ispcrtFutureGetTimeNs(ISPCRTFuture f) ISPCRT_CATCH_BEGIN {
     if (!f)
         return -1;
@@ -474,6 +627,26 @@ bool ispcrtFutureIsValid(ISPCRTFuture f) ISPCRT_CATCH_BEGIN {
 }
 ISPCRT_CATCH_END(false)
 
+bool ispcrtFutureGetTimestamps(ISPCRTFuture f, ISPCRTFutureTimestamps *ts) ISPCRT_CATCH_BEGIN {
+    if (!ts)
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "Timestamps pointer is NULL!");
+    auto &future = referenceFromHandle<ispcrt::base::Future>(f);
+    return future.valid() && future.timestamps(*ts);
+}
+ISPCRT_CATCH_END(false)
+
+void ispcrtQueueSetProfiling(ISPCRTTaskQueue q, bool enable) ISPCRT_CATCH_BEGIN {
+    auto &queue = referenceFromHandle<ispcrt::base::TaskQueue>(q);
+    queue.setProfiling(enable);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
+void ispcrtQueueWriteTrace(ISPCRTTaskQueue q, const char *fileName) ISPCRT_CATCH_BEGIN {
+    auto &queue = referenceFromHandle<ispcrt::base::TaskQueue>(q);
+    queue.writeTrace(fileName);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
 ///////////////////////////////////////////////////////////////////////////////
 // Native handles//////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
@@ -20,6 +20,7 @@ struct _ISPCRTTaskQueue;
 struct _ISPCRTModule;
 struct _ISPCRTKernel;
 struct _ISPCRTFuture;
+struct _ISPCRTGraph;
 
 typedef _ISPCRTContext *ISPCRTContext;
 typedef _ISPCRTDevice *ISPCRTDevice;
@@ -28,6 +29,7 @@ typedef _ISPCRTTaskQueue *ISPCRTTaskQueue;
 typedef _ISPCRTModule *ISPCRTModule;
 typedef _ISPCRTKernel *ISPCRTKernel;
 typedef _ISPCRTFuture *ISPCRTFuture;
+typedef _ISPCRTGraph *ISPCRTGraph;
 #else
 typedef void *ISPCRTContext;
 typedef void *ISPCRTDevice;
@@ -36,6 +38,7 @@ typedef void *ISPCRTTaskQueue;
 typedef void *ISPCRTModule;
 typedef void *ISPCRTKernel;
 typedef void *ISPCRTFuture;
+typedef void *ISPCRTGraph;
 #endif
 
 // NOTE: ISPCRTGenericHandle usage implies compatibility with any of the above
@@ -79,6 +82,8 @@ typedef enum {
 typedef struct {
     uint32_t vendorId;
     uint32_t deviceId;
+    // Number of sub-devices (tiles) of the device, see ispcrtGetSubDevice()
+    uint32_t subDeviceCount;
 } ISPCRTDeviceInfo;
 
 // deviceIdx is an index of the device in the list of supported devices
@@ -92,6 +97,13 @@ ISPCRTDevice ispcrtGetDeviceFromNativeHandle(ISPCRTContext context, ISPCRTGeneri
 uint32_t ispcrtGetDeviceCount(ISPCRTDeviceType);
 void ispcrtGetDeviceInfo(ISPCRTDeviceType, uint32_t deviceIdx, ISPCRTDeviceInfo*);
 
+// Sub-device (tile) of a multi-tile GPU device, 'subDeviceIdx' is less than ispcrtGetSubDeviceCount().
+// Task queues of a sub-device run the kernels on that tile only and its memory views are allocated in the
+// memory local to the tile, while the memory views of the device itself may be spread over all tiles.
+// A sub-device shares the context of its device and keeps it alive. CPU devices have no sub-devices.
+uint32_t ispcrtGetSubDeviceCount(ISPCRTDevice);
+ISPCRTDevice ispcrtGetSubDevice(ISPCRTDevice, uint32_t subDeviceIdx);
+
 // Context initialization //////////////////////////////////////////////////////
 
 ISPCRTContext ispcrtNewContext(ISPCRTDeviceType);
@@ -128,6 +140,23 @@ typedef struct {
 ISPCRTMemoryView ispcrtNewMemoryView(ISPCRTDevice, void *appMemory, size_t numBytes, ISPCRTNewMemoryViewFlags *flags);
 ISPCRTMemoryView ispcrtNewMemoryViewForContext(ISPCRTContext c, void *appMemory, size_t numBytes, ISPCRTNewMemoryViewFlags *flags);
 
+// View of 'numBytes' of the parent memory view starting at 'offset' bytes. It shares the parent memory and keeps the
+// parent alive, so copying it to or from the device (or passing it to a kernel) touches only that range.
+ISPCRTMemoryView ispcrtNewMemoryViewRange(ISPCRTMemoryView parent, size_t offset, size_t numBytes);
+
+// Wrap memory allocated outside of ISPCRT without reallocating or copying it. The memory is not released with the
+// view. Device USM becomes a device memory view without host memory, while shared and host USM (host-pinned memory)
+// become a shared memory view. Memory of unknown type, see ispcrtGetMemoryAllocType(), cannot be imported on GPU.
+ISPCRTMemoryView ispcrtImportMemoryView(ISPCRTDevice, void *memBuffer, size_t numBytes);
+// Import the dma-buf file descriptor 'fd' as device memory of a memory view (GPU only)
+ISPCRTMemoryView ispcrtImportDmaBufMemoryView(ISPCRTDevice, int fd, size_t numBytes);
+// Memory view of 'numBytes' of the file 'path' starting at 'offset' bytes, or of the rest of the file when 'numBytes'
+// is 0. With ISPCRT_ALLOC_TYPE_DEVICE the host memory of the view is a copy-on-write mapping of the file, which
+// kernels on CPU use without copying and which is copied to the device memory with ispcrtCopyToDevice() on GPU. With
+// ISPCRT_ALLOC_TYPE_SHARED the file is read into shared memory. The file isn't modified by writes to the view.
+ISPCRTMemoryView ispcrtNewMemoryViewFromFile(ISPCRTDevice, const char *path, size_t offset, size_t numBytes,
+                                             ISPCRTNewMemoryViewFlags *flags);
+
 void *ispcrtHostPtr(ISPCRTMemoryView);
 void *ispcrtDevicePtr(ISPCRTMemoryView);
 void *ispcrtSharedPtr(ISPCRTMemoryView);
@@ -153,6 +182,24 @@ struct ISPCRTModuleOptions_ {
 typedef struct ISPCRTModuleOptions_ ISPCRTModuleOptions;
 
 ISPCRTModule ispcrtLoadModule(ISPCRTDevice, const char *moduleFile, ISPCRTModuleOptions);
+
+// Load a module on a background thread, so several modules can be loaded in parallel. The returned future
+// becomes valid once the module is loaded, ispcrtFutureGetModule() waits for it and returns the module,
+// which must be released by the caller, or NULL if it failed to load.
+ISPCRTFuture ispcrtLoadModuleAsync(ISPCRTDevice, const char *moduleFile, ISPCRTModuleOptions);
+ISPCRTModule ispcrtFutureGetModule(ISPCRTFuture);
+
+typedef enum {
+    // Shared library of a CPU module
+    ISPCRT_MODULE_IMAGE_NATIVE = 0,
+    // LLVM bitcode of a CPU module compiled for the host CPU with --emit-llvm,
+    // which ispcrt compiles when it's loaded if it's built with ISPCRT_BUILD_JIT
+    ISPCRT_MODULE_IMAGE_BITCODE,
+} ISPCRTModuleImageFormat;
+
+// Load a module from an image in memory, which can be freed once it's loaded
+ISPCRTModule ispcrtLoadModuleFromMemory(ISPCRTDevice, const void *image, size_t size, ISPCRTModuleImageFormat,
+                                        ISPCRTModuleOptions);
 void ispcrtDynamicLinkModules(ISPCRTDevice, ISPCRTModule *modules, uint32_t numModules);
 ISPCRTModule ispcrtStaticLinkModules(ISPCRTDevice, ISPCRTModule *modules, uint32_t numModules);
 void *ispcrtFunctionPtr(ISPCRTModule, const char *name);
@@ -174,13 +221,78 @@ ISPCRTFuture ispcrtLaunch2D(ISPCRTTaskQueue, ISPCRTKernel, ISPCRTMemoryView para
 ISPCRTFuture ispcrtLaunch3D(ISPCRTTaskQueue, ISPCRTKernel, ISPCRTMemoryView params, size_t dim0, size_t dim1,
                             size_t dim2);
 
+// NOTE: the inline launches copy 'size' bytes of 'params' when they are enqueued, so there is no memory view
+//       to allocate and copy to the device for the parameters of small kernels. The kernel gets a pointer to
+//       the copy, which is in host memory the device reads directly, and the copy must not be changed by it.
+ISPCRTFuture ispcrtLaunchInline1D(ISPCRTTaskQueue, ISPCRTKernel, const void *params, size_t size, size_t dim0);
+ISPCRTFuture ispcrtLaunchInline2D(ISPCRTTaskQueue, ISPCRTKernel, const void *params, size_t size, size_t dim0,
+                                  size_t dim1);
+ISPCRTFuture ispcrtLaunchInline3D(ISPCRTTaskQueue, ISPCRTKernel, const void *params, size_t size, size_t dim0,
+                                  size_t dim1, size_t dim2);
+
+// NOTE: the batched launch enqueues 'count' inline launches of the kernel at once. Launch 'i' gets a copy of the
+//       'size' bytes at 'params + i * size' (or NULL if 'params' is NULL) and the grid of 'dims[3 * i]',
+//       'dims[3 * i + 1]' and 'dims[3 * i + 2]' tasks. The launches run in order and the returned future is
+//       completed when all of them are completed.
+ISPCRTFuture ispcrtLaunchBatch(ISPCRTTaskQueue, ISPCRTKernel, const void *params, size_t size, const size_t *dims,
+                               size_t count);
+
+void ispcrtSubmit(ISPCRTTaskQueue);
 void ispcrtSync(ISPCRTTaskQueue);
 
+// Dependencies between task queues ///////////////////////////////////////////
+
+// NOTE: the future returned by ispcrtQueueSignal() is completed once all the
+//       commands enqueued to the task queue before are completed. After
+//       ispcrtQueueWaitFuture() the commands enqueued to the task queue don't
+//       start until the command of the future, which may belong to another
+//       task queue of the same device, is completed. The task queue of the
+//       future must be submitted for these commands to progress and must not
+//       be destroyed before the waiting task queue is synchronized.
+ISPCRTFuture ispcrtQueueSignal(ISPCRTTaskQueue);
+void ispcrtQueueWaitFuture(ISPCRTTaskQueue, ISPCRTFuture);
+
+// Graphs /////////////////////////////////////////////////////////////////////
+
+// NOTE: between ispcrtBeginCapture() and ispcrtEndCapture() the copies and
+//       launches enqueued to the task queue are recorded into a graph instead
+//       of being executed. The futures returned by the recorded launches are
+//       updated by each replay of the graph once the queue is synchronized.
+void ispcrtBeginCapture(ISPCRTTaskQueue);
+ISPCRTGraph ispcrtEndCapture(ISPCRTTaskQueue);
+void ispcrtReplayGraph(ISPCRTTaskQueue, ISPCRTGraph);
+
 // Futures and task timing ////////////////////////////////////////////////////
 
 uint64_t ispcrtFutureGetTimeNs(ISPCRTFuture);
 bool ispcrtFutureIsValid(ISPCRTFuture);
 
+// NOTE: the timestamps are nanoseconds of a monotonic host clock, the same for
+//       all devices, of when the launch was enqueued, started and completed.
+//       They are only recorded for launches enqueued to a task queue while its
+//       profiling is enabled, ispcrtFutureGetTimestamps() returns false for
+//       other futures and futures that are not valid yet.
+typedef struct {
+    uint64_t submitNs;
+    uint64_t startNs;
+    uint64_t endNs;
+} ISPCRTFutureTimestamps;
+
+bool ispcrtFutureGetTimestamps(ISPCRTFuture, ISPCRTFutureTimestamps *);
+
+// Profiling //////////////////////////////////////////////////////////////////
+
+// NOTE: while profiling is enabled, the task queue records the timestamps of
+//       the kernel launches and copies enqueued outside of graph captures and
+//       keeps their futures. ispcrtQueueWriteTrace() writes the completed ones
+//       to a file in the Chrome trace event format, which chrome://tracing and
+//       Perfetto load, and releases them, so it is usually called after a sync.
+//       When the ISPCRT_TRACE environment variable is set to a file name, all
+//       task queues are profiled and the commands completed at each sync are
+//       written to that file when the process exits.
+void ispcrtQueueSetProfiling(ISPCRTTaskQueue, bool enable);
+void ispcrtQueueWriteTrace(ISPCRTTaskQueue, const char *fileName);
+
 // Access to objects of native runtime ///////////////////////////////////////
 
 ISPCRTGenericHandle ispcrtPlatformNativeHandle(ISPCRTDevice);
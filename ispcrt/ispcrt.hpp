@@ -7,7 +7,10 @@
 // std
 #include <array>
 #include <cassert>
+#include <functional>
 #include <iostream>
+#include <stdexcept>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
@@ -91,6 +94,8 @@ class Future : public GenericObject<ISPCRTFuture> {
     ~Future() = default;
     bool valid() const;
     uint64_t time() const;
+    // false if the task queue did not profile the launch or it is not completed yet
+    bool timestamps(ISPCRTFutureTimestamps &ts) const;
 };
 
 inline Future::Future(ISPCRTFuture f) : GenericObject<ISPCRTFuture>(f) { if (f) ispcrtRetain(f); }
@@ -99,6 +104,21 @@ inline bool Future::valid() const { return handle() && ispcrtFutureIsValid(handl
 
 inline uint64_t Future::time() const { return ispcrtFutureGetTimeNs(handle()); }
 
+inline bool Future::timestamps(ISPCRTFutureTimestamps &ts) const {
+    return handle() && ispcrtFutureGetTimestamps(handle(), &ts);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Graph wrapper ////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
+
+class Graph : public GenericObject<ISPCRTGraph> {
+  public:
+    Graph() = default;
+    Graph(ISPCRTGraph g) : GenericObject<ISPCRTGraph>(g) {}
+    ~Graph() = default;
+};
+
 /////////////////////////////////////////////////////////////////////////////
 // Context wrapper ///////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////
@@ -149,6 +169,9 @@ class Device : public GenericObject<ISPCRTDevice> {
     Module staticLinkModules(ISPCRTModule* modules, const uint32_t num);
     // check memory type
     ISPCRTAllocationType getMemoryAllocType(void *memBuffer);
+    // sub-devices (tiles) of the device
+    uint32_t subDeviceCount() const;
+    Device subDevice(uint32_t subDeviceIdx) const;
 };
 
 // Inlined definitions //
@@ -195,6 +218,14 @@ inline ISPCRTAllocationType Device::getMemoryAllocType(void *memBuffer) {
     return ispcrtGetMemoryAllocType(handle(), memBuffer);
 }
 
+inline uint32_t Device::subDeviceCount() const { return ispcrtGetSubDeviceCount(handle()); }
+
+inline Device Device::subDevice(uint32_t subDeviceIdx) const {
+    Device d;
+    d.m_handle = ispcrtGetSubDevice(handle(), subDeviceIdx);
+    return d;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // Arrays (MemoryView wrapper w/ element type) //////////////////////////////
 /////////////////////////////////////////////////////////////////////////////
@@ -257,6 +288,17 @@ template <typename T, AllocType AT = AllocType::Device> class Array : public Gen
               SharedMemoryUsageHint SMAT = SharedMemoryUsageHint::HostDeviceReadWrite,
               EnableForSharedAllocation<alloc> = 0);
 
+    //////// Constructors that can be used for all types of memory allocations ////////
+
+    // View of 'size' objects of 'parent' starting at object 'offset', sharing the parent memory
+    Array(const Array<T, AT> &parent, size_t offset, size_t size);
+
+    // Wrap 'size' objects of USM allocated by the application without copying or owning it
+    static Array<T, AT> import(const Device &device, T *memory, size_t size);
+
+    // 'size' objects of the file 'path' starting at byte 'offset', or the rest of the file when 'size' is 0
+    static Array<T, AT> fromFile(const Device &device, const char *path, size_t offset = 0, size_t size = 0);
+
     //////// Methods valid only for Device memory allocations ////////
 
     // For shared memory objects those will return the same pointer //
@@ -350,6 +392,35 @@ template<AllocType alloc>
             m_handle = ispcrtNewMemoryViewForContext(context.handle(), nullptr, size * sizeof(T), &flags);
         }
 
+// Memory allocations of all types
+
+template<typename T, AllocType AT>
+    inline Array<T, AT>::Array(const Array<T, AT> &parent, size_t offset, size_t size) : m_smuh(parent.m_smuh),
+        GenericObject<ISPCRTMemoryView>() {
+            m_handle = ispcrtNewMemoryViewRange(parent.handle(), offset * sizeof(T), size * sizeof(T));
+        }
+
+template<typename T, AllocType AT>
+    inline Array<T, AT> Array<T, AT>::import(const Device &device, T *memory, size_t size) {
+        Array<T, AT> a;
+        a.m_handle = ispcrtImportMemoryView(device.handle(), memory, size * sizeof(T));
+        return a;
+    }
+
+template<typename T, AllocType AT>
+    inline Array<T, AT> Array<T, AT>::fromFile(const Device &device, const char *path, size_t offset, size_t size) {
+        ISPCRTNewMemoryViewFlags flags;
+        if (AT == AllocType::Shared) {
+            set_shared_memory_view_flags(&flags, SharedMemoryUsageHint::HostDeviceReadWrite);
+        } else {
+            flags.allocType = ISPCRT_ALLOC_TYPE_DEVICE;
+            flags.smHint = ISPCRT_SM_HOST_DEVICE_READ_WRITE;
+        }
+        Array<T, AT> a;
+        a.m_handle = ispcrtNewMemoryViewFromFile(device.handle(), path, offset, size * sizeof(T), &flags);
+        return a;
+    }
+
 // Device-only methods
 
 template<typename T, AllocType AT>
@@ -437,8 +508,16 @@ class Module : public GenericObject<ISPCRTModule> {
   public:
     Module() = default;
     Module(const Device &device, const char *moduleName, const ISPCRTModuleOptions &opts = ISPCRTModuleOptions{});
+    Module(const Device &device, const void *image, size_t size, ISPCRTModuleImageFormat format,
+           const ISPCRTModuleOptions &opts = ISPCRTModuleOptions{});
     Module(ISPCRTModule module);
+    // Wait for the module loaded by loadAsync()
+    Module(const Future &loading);
     void *functionPtr(const char *functionName);
+
+    // Load the module on a background thread, see ispcrtLoadModuleAsync()
+    static Future loadAsync(const Device &device, const char *moduleName,
+                            const ISPCRTModuleOptions &opts = ISPCRTModuleOptions{});
 };
 
 // Inlined definitions //
@@ -446,8 +525,23 @@ class Module : public GenericObject<ISPCRTModule> {
 inline Module::Module(const Device &device, const char *moduleName, const ISPCRTModuleOptions &opts)
     : GenericObject<ISPCRTModule>(ispcrtLoadModule(device.handle(), moduleName, opts)) {}
 
+inline Module::Module(const Device &device, const void *image, size_t size, ISPCRTModuleImageFormat format,
+                      const ISPCRTModuleOptions &opts)
+    : GenericObject<ISPCRTModule>(ispcrtLoadModuleFromMemory(device.handle(), image, size, format, opts)) {}
+
 inline Module::Module(ISPCRTModule module) : GenericObject<ISPCRTModule>(module) {}
 
+inline Module::Module(const Future &loading) : GenericObject<ISPCRTModule>(ispcrtFutureGetModule(loading.handle())) {}
+
+inline Future Module::loadAsync(const Device &device, const char *moduleName, const ISPCRTModuleOptions &opts) {
+    ISPCRTFuture f = ispcrtLoadModuleAsync(device.handle(), moduleName, opts);
+    Future future(f);
+    // The wrapper holds a reference of its own
+    if (f)
+        ispcrtRelease(f);
+    return future;
+}
+
 inline void* Module::functionPtr(const char *functionName){
     return ispcrtFunctionPtr(handle(), functionName);
 }
@@ -495,12 +589,38 @@ class TaskQueue : public GenericObject<ISPCRTTaskQueue> {
     template <typename T, AllocType AT>
     Future launch(const Kernel &k, const Array<T,AT> &p, size_t dim0, size_t dim1, size_t dim2) const;
 
+    // pass a copy of the parameters with the launch instead of an array copied to the device
+    template <typename P> Future launchInline(const Kernel &k, const P &p, size_t dim0) const;
+    template <typename P> Future launchInline(const Kernel &k, const P &p, size_t dim0, size_t dim1) const;
+    template <typename P> Future launchInline(const Kernel &k, const P &p, size_t dim0, size_t dim1, size_t dim2) const;
+
+    // inline launches of the kernel with params[i] over the grid dims[i], enqueued at once and completing one future
+    template <typename P>
+    Future launchBatch(const Kernel &k, const std::vector<P> &params,
+                       const std::vector<std::array<size_t, 3>> &dims) const;
+
     // start executing, but don't wait for the completion
     void submit() const;
 
     // wait for the command list to be executed (start the execution if needed as well)
     void sync() const;
 
+    // get a future completed once the commands enqueued so far are completed
+    Future signal() const;
+    // make the following commands wait for the completion of a future of any task queue
+    void wait(const Future &f) const;
+
+    // record the following copies and launches into a graph instead of executing them
+    void beginCapture() const;
+    Graph endCapture() const;
+    // enqueue all commands recorded into the graph
+    void replay(const Graph &g) const;
+
+    // record the timestamps of the following launches and keep them for writeTrace()
+    void setProfiling(bool enable) const;
+    // write the completed profiled launches as a Chrome trace
+    void writeTrace(const char *fileName) const;
+
     void* nativeTaskQueueHandle() const;
 };
 
@@ -549,8 +669,327 @@ inline Future TaskQueue::launch(const Kernel &k, const Array<T,AT> &p, size_t di
     return ispcrtLaunch3D(handle(), k.handle(), p.handle(), dim0, dim1, dim2);
 }
 
+template <typename P> inline Future TaskQueue::launchInline(const Kernel &k, const P &p, size_t dim0) const {
+    return launchInline(k, p, dim0, 1, 1);
+}
+
+template <typename P>
+inline Future TaskQueue::launchInline(const Kernel &k, const P &p, size_t dim0, size_t dim1) const {
+    return launchInline(k, p, dim0, dim1, 1);
+}
+
+template <typename P>
+inline Future TaskQueue::launchInline(const Kernel &k, const P &p, size_t dim0, size_t dim1, size_t dim2) const {
+    static_assert(std::is_trivially_copyable<P>::value, "parameters of inline launches are copied bytewise");
+    return ispcrtLaunchInline3D(handle(), k.handle(), &p, sizeof(P), dim0, dim1, dim2);
+}
+
+template <typename P>
+inline Future TaskQueue::launchBatch(const Kernel &k, const std::vector<P> &params,
+                                     const std::vector<std::array<size_t, 3>> &dims) const {
+    static_assert(std::is_trivially_copyable<P>::value, "parameters of inline launches are copied bytewise");
+    static_assert(sizeof(std::array<size_t, 3>) == 3 * sizeof(size_t), "grids are passed as packed triples");
+    assert(params.size() == dims.size());
+    const size_t *grids = reinterpret_cast<const size_t *>(dims.data());
+    return ispcrtLaunchBatch(handle(), k.handle(), params.data(), sizeof(P), grids, dims.size());
+}
+
+inline void TaskQueue::submit() const { ispcrtSubmit(handle()); }
+
 inline void TaskQueue::sync() const { ispcrtSync(handle()); }
 
+inline Future TaskQueue::signal() const { return ispcrtQueueSignal(handle()); }
+
+inline void TaskQueue::wait(const Future &f) const { ispcrtQueueWaitFuture(handle(), f.handle()); }
+
+inline void TaskQueue::beginCapture() const { ispcrtBeginCapture(handle()); }
+
+inline Graph TaskQueue::endCapture() const { return Graph(ispcrtEndCapture(handle())); }
+
+inline void TaskQueue::replay(const Graph &g) const { ispcrtReplayGraph(handle(), g.handle()); }
+
+inline void TaskQueue::setProfiling(bool enable) const { ispcrtQueueSetProfiling(handle(), enable); }
+
+inline void TaskQueue::writeTrace(const char *fileName) const { ispcrtQueueWriteTrace(handle(), fileName); }
+
 inline void* TaskQueue::nativeTaskQueueHandle() const { return ispcrtTaskQueueNativeHandle(handle()); }
 
+/////////////////////////////////////////////////////////////////////////////
+// Device group /////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
+
+// Contiguous part [offset, offset + count) of 'total' items assigned to one device of a group
+struct Partition {
+    size_t offset{0};
+    size_t count{0};
+    size_t total{0};
+};
+
+// Devices of one context, each with its own task queue, that run one grid of tasks split between them. On GPU
+// these are all GPUs of the system, or all their tiles when the driver exposes tiles as devices (e.g. with
+// ZE_FLAT_DEVICE_HIERARCHY=FLAT). The grid is split along one dimension into the parts returned by partition(),
+// and every device runs its part as a grid of its own, so task indices of the split dimension start from 0 on
+// every device. The parameters of each part should therefore carry its Partition for the kernel to add 'offset'
+// to the task index and use 'total' instead of the task count.
+class DeviceGroup {
+  public:
+    // All devices of the given type
+    DeviceGroup(ISPCRTDeviceType type);
+    // Devices of the context with the given indices
+    DeviceGroup(const Context &context, const std::vector<uint32_t> &deviceIdxs);
+
+    size_t size() const;
+    const Context &context() const;
+    const Device &device(size_t i) const;
+    const TaskQueue &queue(size_t i) const;
+
+    // Split 'total' items into contiguous parts of nearly equal size, part i for device i
+    std::vector<Partition> partition(size_t total) const;
+
+    // Load the module and create the kernel on every device
+    std::vector<Kernel> newKernels(const char *moduleFile, const char *kernelName,
+                                   const ISPCRTModuleOptions &opts = ISPCRTModuleOptions{});
+
+    // Device memory of every device holding a copy of the whole application memory, for data read by all parts
+    template <typename T> std::vector<Array<T>> replicate(T *appMemory, size_t size) const;
+    // Device memory of every device holding its part of the application memory, as returned by partition(size)
+    template <typename T> std::vector<Array<T>> scatter(T *appMemory, size_t size) const;
+
+    // Copy array i to or from device i
+    template <typename T, AllocType AT> void copyToDevice(const std::vector<Array<T, AT>> &arrs) const;
+    template <typename T, AllocType AT> void copyToHost(const std::vector<Array<T, AT>> &arrs) const;
+
+    // Launch the dim0 x dim1 x dim2 grid split along dimension 'splitDim' (0, 1 or 2) with the partition() of
+    // its size: part i with parameters params[i] on device i. Devices with an empty part launch nothing and get
+    // an empty future.
+    template <typename T, AllocType AT>
+    std::vector<Future> launch(const std::vector<Kernel> &kernels, const std::vector<Array<T, AT>> &params,
+                               unsigned splitDim, size_t dim0, size_t dim1 = 1, size_t dim2 = 1) const;
+
+    // Start executing the commands of all devices, but don't wait for the completion
+    void submit() const;
+    // Wait for the completion of the commands of all devices
+    void sync() const;
+
+  private:
+    Context m_context;
+    std::vector<Device> m_devices;
+    std::vector<TaskQueue> m_queues;
+    // Modules of the kernels created by newKernels()
+    std::vector<Module> m_modules;
+};
+
+// Inlined definitions //
+
+inline DeviceGroup::DeviceGroup(ISPCRTDeviceType type) : m_context(type) {
+    const uint32_t count = Device::deviceCount(type);
+    for (uint32_t i = 0; i < count; i++) {
+        m_devices.emplace_back(m_context, i);
+        m_queues.emplace_back(m_devices.back());
+    }
+}
+
+inline DeviceGroup::DeviceGroup(const Context &context, const std::vector<uint32_t> &deviceIdxs)
+    : m_context(context) {
+    for (auto idx : deviceIdxs) {
+        m_devices.emplace_back(m_context, idx);
+        m_queues.emplace_back(m_devices.back());
+    }
+}
+
+inline size_t DeviceGroup::size() const { return m_devices.size(); }
+
+inline const Context &DeviceGroup::context() const { return m_context; }
+
+inline const Device &DeviceGroup::device(size_t i) const { return m_devices[i]; }
+
+inline const TaskQueue &DeviceGroup::queue(size_t i) const { return m_queues[i]; }
+
+inline std::vector<Partition> DeviceGroup::partition(size_t total) const {
+    std::vector<Partition> parts(size());
+    if (parts.empty())
+        return parts;
+    size_t offset = 0;
+    for (size_t i = 0; i < parts.size(); i++) {
+        // The first 'total % size()' parts get one item more
+        size_t count = total / parts.size() + (i < total % parts.size() ? 1 : 0);
+        parts[i] = {offset, count, total};
+        offset += count;
+    }
+    return parts;
+}
+
+inline std::vector<Kernel> DeviceGroup::newKernels(const char *moduleFile, const char *kernelName,
+                                                   const ISPCRTModuleOptions &opts) {
+    std::vector<Kernel> kernels;
+    for (const auto &d : m_devices) {
+        m_modules.emplace_back(d, moduleFile, opts);
+        kernels.emplace_back(d, m_modules.back(), kernelName);
+    }
+    return kernels;
+}
+
+template <typename T> inline std::vector<Array<T>> DeviceGroup::replicate(T *appMemory, size_t size) const {
+    std::vector<Array<T>> arrs;
+    for (const auto &d : m_devices) {
+        arrs.emplace_back(d, appMemory, size);
+    }
+    return arrs;
+}
+
+template <typename T> inline std::vector<Array<T>> DeviceGroup::scatter(T *appMemory, size_t size) const {
+    std::vector<Array<T>> arrs;
+    auto parts = partition(size);
+    for (size_t i = 0; i < m_devices.size(); i++) {
+        arrs.emplace_back(m_devices[i], appMemory + parts[i].offset, parts[i].count);
+    }
+    return arrs;
+}
+
+template <typename T, AllocType AT>
+inline void DeviceGroup::copyToDevice(const std::vector<Array<T, AT>> &arrs) const {
+    for (size_t i = 0; i < arrs.size(); i++) {
+        m_queues[i].copyToDevice(arrs[i]);
+    }
+}
+
+template <typename T, AllocType AT>
+inline void DeviceGroup::copyToHost(const std::vector<Array<T, AT>> &arrs) const {
+    for (size_t i = 0; i < arrs.size(); i++) {
+        m_queues[i].copyToHost(arrs[i]);
+    }
+}
+
+template <typename T, AllocType AT>
+inline std::vector<Future> DeviceGroup::launch(const std::vector<Kernel> &kernels,
+                                               const std::vector<Array<T, AT>> &params, unsigned splitDim,
+                                               size_t dim0, size_t dim1, size_t dim2) const {
+    std::array<size_t, 3> dims = {dim0, dim1, dim2};
+    if (splitDim >= dims.size())
+        throw std::invalid_argument("grid split dimension must be 0, 1 or 2");
+    auto parts = partition(dims[splitDim]);
+    std::vector<Future> futures(size());
+    for (size_t i = 0; i < size(); i++) {
+        if (parts[i].count == 0)
+            continue;
+        dims[splitDim] = parts[i].count;
+        futures[i] = m_queues[i].launch(kernels[i], params[i], dims[0], dims[1], dims[2]);
+    }
+    return futures;
+}
+
+inline void DeviceGroup::submit() const {
+    for (const auto &q : m_queues) {
+        q.submit();
+    }
+}
+
+inline void DeviceGroup::sync() const {
+    for (const auto &q : m_queues) {
+        q.sync();
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Stream pipeline //////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
+
+// Out-of-core processing of a stream of chunks of up to 'chunkSize' items: each chunk is read by the source into
+// host memory, copied to the device, processed by one launch of the kernel, copied back and passed to the sink.
+// Up to 'depth' chunks are in flight at once, each in a slot with its own task queue and buffers, so that reading
+// and writing chunks on the host overlaps the copies and launches of the others (double buffering for a depth of
+// 2, triple buffering for 3). The sink gets the chunks in the order the source produced them.
+template <typename In, typename Out, typename P> class StreamPipeline {
+  public:
+    // Fills 'data' with up to 'maxCount' items of chunk 'chunk' and returns their number, 0 at the end of the stream
+    using Source = std::function<size_t(size_t chunk, In *data, size_t maxCount)>;
+    // Parameters of the launch processing 'count' items from the device memory 'in' to 'out'
+    using Params = std::function<P(size_t chunk, In *in, Out *out, size_t count)>;
+    // Takes the 'count' items of chunk 'chunk' processed by the kernel
+    using Sink = std::function<void(size_t chunk, const Out *data, size_t count)>;
+
+    // The kernel is launched over ceil(count / itemsPerTask) tasks with the parameters passed inline
+    StreamPipeline(const Device &device, const Kernel &kernel, size_t chunkSize, unsigned depth = 2,
+                   size_t itemsPerTask = 1);
+
+    // Process the whole stream and return the number of chunks
+    size_t run(const Source &source, const Params &params, const Sink &sink);
+
+  private:
+    struct Slot {
+        TaskQueue queue;
+        std::vector<In> inHost;
+        std::vector<Out> outHost;
+        Array<In> in;
+        Array<Out> out;
+        // Ranges of the arrays for the items of the chunk in flight
+        Array<In> inRange;
+        Array<Out> outRange;
+        size_t chunk{0};
+        size_t count{0};
+        bool busy{false};
+    };
+
+    Kernel m_kernel;
+    size_t m_chunkSize;
+    size_t m_itemsPerTask;
+    std::vector<Slot> m_slots;
+};
+
+// Inlined definitions //
+
+template <typename In, typename Out, typename P>
+inline StreamPipeline<In, Out, P>::StreamPipeline(const Device &device, const Kernel &kernel, size_t chunkSize,
+                                                  unsigned depth, size_t itemsPerTask)
+    : m_kernel(kernel), m_chunkSize(chunkSize), m_itemsPerTask(itemsPerTask), m_slots(depth) {
+    static_assert(std::is_trivially_copyable<P>::value, "parameters of inline launches are copied bytewise");
+    if (chunkSize == 0 || depth == 0 || itemsPerTask == 0)
+        throw std::invalid_argument("Stream pipeline needs non-empty chunks, slots and tasks");
+    for (auto &slot : m_slots) {
+        slot.queue = TaskQueue(device);
+        slot.inHost.resize(chunkSize);
+        slot.outHost.resize(chunkSize);
+        slot.in = Array<In>(device, slot.inHost.data(), chunkSize);
+        slot.out = Array<Out>(device, slot.outHost.data(), chunkSize);
+    }
+}
+
+template <typename In, typename Out, typename P>
+inline size_t StreamPipeline<In, Out, P>::run(const Source &source, const Params &params, const Sink &sink) {
+    size_t chunks = 0;
+    size_t pending = 0;
+    bool done = false;
+    // The slots are used in turn, so waiting for the oldest chunk keeps the order of the chunks
+    for (size_t i = 0; !done || pending > 0; i = (i + 1) % m_slots.size()) {
+        Slot &slot = m_slots[i];
+        if (slot.busy) {
+            slot.queue.sync();
+            sink(slot.chunk, slot.outHost.data(), slot.count);
+            slot.busy = false;
+            pending--;
+        }
+        if (done)
+            continue;
+        size_t count = source(chunks, slot.inHost.data(), m_chunkSize);
+        if (count == 0) {
+            done = true;
+            continue;
+        }
+        if (count > m_chunkSize)
+            throw std::out_of_range("Stream pipeline source returned more items than the chunk size");
+        slot.chunk = chunks++;
+        slot.count = count;
+        slot.inRange = Array<In>(slot.in, 0, count);
+        slot.outRange = Array<Out>(slot.out, 0, count);
+        slot.queue.copyToDevice(slot.inRange);
+        slot.queue.launchInline(m_kernel, params(slot.chunk, slot.in.devicePtr(), slot.out.devicePtr(), count),
+                                (count + m_itemsPerTask - 1) / m_itemsPerTask);
+        slot.queue.copyToHost(slot.outRange);
+        slot.queue.submit();
+        slot.busy = true;
+        pending++;
+    }
+    return chunks;
+}
+
 } // namespace ispcrt
@@ -3,6 +3,8 @@
 
 #include "ze_mock.h"
 
+#include <mutex>
+
 namespace ispcrt {
 namespace testing {
 namespace mock {
@@ -10,8 +12,11 @@ namespace mock {
 // Counters
 
 std::unordered_map<std::string, int> CallCounters::counters;
+// Modules may be loaded on background threads
+static std::mutex countersMutex;
 
 void CallCounters::inc(const std::string& fun) {
+    std::lock_guard<std::mutex> lock(countersMutex);
     counters[fun]++;
 }
 
@@ -32,6 +37,7 @@ std::unordered_map<std::string, ze_result_t> Config::resultsMap;
 std::vector<CmdListElem> Config::cmdList;
 bool Config::cmdListOpened = true;
 uint32_t Config::expectedDevice = 0;
+uint32_t Config::subDeviceCount = 0;
 
 const DeviceProperties DefaultGpuDevice(VendorId::Intel, DeviceId::Gen9);
 
@@ -46,6 +52,7 @@ ze_result_t Config::getRetValue(const std::string &fun) {
 void Config::cleanup() {
     setDeviceCount(1);
     setExpectedDevice(0);
+    setSubDeviceCount(0);
     resetCmdList();
     resultsMap.clear();
 }
@@ -72,6 +79,10 @@ void Config::setExpectedDevice(uint32_t deviceIdx) {
     expectedDevice = deviceIdx;
 }
 
+void Config::setSubDeviceCount(uint32_t count) { subDeviceCount = count; }
+
+uint32_t Config::getSubDeviceCount() { return subDeviceCount; }
+
 uint32_t Config::getExpectedDevice() {
     return expectedDevice;
 }
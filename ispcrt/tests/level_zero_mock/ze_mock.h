@@ -66,6 +66,9 @@ class Config {
     static void setExpectedDevice(uint32_t deviceIdx);
     static uint32_t getExpectedDevice();
     static void setDeviceProperties(uint32_t deviceIdx, const DeviceProperties& dp);
+    // Every device has this number of sub-devices, which are represented by the device itself
+    static void setSubDeviceCount(uint32_t count);
+    static uint32_t getSubDeviceCount();
 
   private:
     static std::unordered_map<std::string, ze_result_t> resultsMap;
@@ -73,6 +76,7 @@ class Config {
     static bool cmdListOpened;
     static std::vector<DeviceProperties> devices;
     static uint32_t expectedDevice;
+    static uint32_t subDeviceCount;
 };
 
 } // namespace mock
@@ -36,6 +36,9 @@ MockHandle<ze_command_queue_handle_t> CmdQueueHandle;
 MockHandle<ze_event_pool_handle_t> EventPoolHandle;
 MockHandle<ze_event_handle_t> LaunchEventHandle;
 
+// Types of the memory allocated by the mock driver, as reported by zeMemGetAllocProperties
+std::unordered_map<const void *, ze_memory_type_t> MemAllocTypes;
+
 bool ExpectedDevice(ze_device_handle_t hDevice) {
     auto dp = reinterpret_cast<DeviceProperties *>(hDevice);
     return dp == Config::getDevicePtr(Config::getExpectedDevice());
@@ -89,6 +92,28 @@ ze_result_t zeDeviceGetProperties(ze_device_handle_t hDevice, ze_device_properti
     MOCK_RET;
 }
 
+ze_result_t zeDeviceGetSubDevices(ze_device_handle_t hDevice, uint32_t *pCount, ze_device_handle_t *phSubdevices) {
+    MOCK_CNT_CALL;
+    if (!ValidDevice(hDevice) || pCount == nullptr)
+        return ZE_RESULT_ERROR_INVALID_NULL_HANDLE;
+    if (phSubdevices) {
+        for (uint32_t i = 0; i < std::min(*pCount, Config::getSubDeviceCount()); i++)
+            phSubdevices[i] = hDevice;
+    }
+    *pCount = Config::getSubDeviceCount();
+    MOCK_RET;
+}
+
+ze_result_t zeDeviceGetGlobalTimestamps(ze_device_handle_t hDevice, uint64_t *hostTimestamp,
+                                       uint64_t *deviceTimestamp) {
+    MOCK_CNT_CALL;
+    if (!ValidDevice(hDevice) || hostTimestamp == nullptr || deviceTimestamp == nullptr)
+        return ZE_RESULT_ERROR_INVALID_NULL_HANDLE;
+    *hostTimestamp = 0;
+    *deviceTimestamp = 0;
+    MOCK_RET;
+}
+
 ze_result_t zeContextCreate(ze_driver_handle_t hDriver, const ze_context_desc_t *desc, ze_context_handle_t *phContext) {
     MOCK_CNT_CALL;
     *phContext = ContextHandle.get();
@@ -235,8 +260,10 @@ ze_result_t zeMemAllocDevice(ze_context_handle_t hContext, const ze_device_mem_a
     MOCK_CNT_CALL;
     if (hContext != ContextHandle.get())
         return ZE_RESULT_ERROR_INVALID_NULL_HANDLE;
-    if (MOCK_SHOULD_SUCCEED)
+    if (MOCK_SHOULD_SUCCEED) {
         *pptr = new uint8_t[size];
+        MemAllocTypes[*pptr] = ZE_MEMORY_TYPE_DEVICE;
+    }
     MOCK_RET;
 }
 
@@ -246,8 +273,22 @@ ze_result_t zeMemAllocShared(ze_context_handle_t hContext, const ze_device_mem_a
     MOCK_CNT_CALL;
     if (hContext != ContextHandle.get())
         return ZE_RESULT_ERROR_INVALID_NULL_HANDLE;
-    if (MOCK_SHOULD_SUCCEED)
+    if (MOCK_SHOULD_SUCCEED) {
+        *pptr = new uint8_t[size];
+        MemAllocTypes[*pptr] = ZE_MEMORY_TYPE_SHARED;
+    }
+    MOCK_RET;
+}
+
+ze_result_t zeMemAllocHost(ze_context_handle_t hContext, const ze_host_mem_alloc_desc_t *host_desc, size_t size,
+                           size_t alignment, void **pptr) {
+    MOCK_CNT_CALL;
+    if (hContext != ContextHandle.get())
+        return ZE_RESULT_ERROR_INVALID_NULL_HANDLE;
+    if (MOCK_SHOULD_SUCCEED) {
         *pptr = new uint8_t[size];
+        MemAllocTypes[*pptr] = ZE_MEMORY_TYPE_HOST;
+    }
     MOCK_RET;
 }
 
@@ -255,10 +296,22 @@ ze_result_t zeMemFree(ze_context_handle_t hContext, void *ptr) {
     MOCK_CNT_CALL;
     if (hContext != ContextHandle.get() || !ptr)
         return ZE_RESULT_ERROR_INVALID_NULL_HANDLE;
+    MemAllocTypes.erase(ptr);
     delete[](uint8_t *) ptr;
     MOCK_RET;
 }
 
+ze_result_t zeMemGetAllocProperties(ze_context_handle_t hContext, const void *ptr,
+                                    ze_memory_allocation_properties_t *pMemAllocProperties,
+                                    ze_device_handle_t *phDevice) {
+    MOCK_CNT_CALL;
+    if (hContext != ContextHandle.get() || !pMemAllocProperties)
+        return ZE_RESULT_ERROR_INVALID_NULL_HANDLE;
+    auto it = MemAllocTypes.find(ptr);
+    pMemAllocProperties->type = it != MemAllocTypes.end() ? it->second : ZE_MEMORY_TYPE_UNKNOWN;
+    MOCK_RET;
+}
+
 ze_result_t zeModuleCreate(ze_context_handle_t hContext, ze_device_handle_t hDevice, const ze_module_desc_t *desc,
                            ze_module_handle_t *phModule, ze_module_build_log_handle_t *phBuildLog) {
     MOCK_CNT_CALL;
@@ -339,6 +392,18 @@ ze_result_t zeKernelSetIndirectAccess(ze_kernel_handle_t hKernel, ze_kernel_indi
     MOCK_RET;
 }
 
+ze_result_t zeKernelGetProperties(ze_kernel_handle_t hKernel, ze_kernel_properties_t *pKernelProperties) {
+    MOCK_CNT_CALL;
+    if (hKernel != KernelHandle.get())
+        return ZE_RESULT_ERROR_INVALID_NULL_HANDLE;
+    if (pKernelProperties == NULL)
+        return ZE_RESULT_ERROR_INVALID_NULL_POINTER;
+
+    pKernelProperties->localMemSize = 0;
+
+    MOCK_RET;
+}
+
 ze_result_t zeKernelSuggestGroupSize(ze_kernel_handle_t hKernel, uint32_t globalSizeX, uint32_t globalSizeY,
                                      uint32_t globalSizeZ, uint32_t *groupSizeX, uint32_t *groupSizeY,
                                      uint32_t *groupSizeZ) {
@@ -396,6 +461,8 @@ ze_result_t zeGetDriverProcAddrTable(ze_api_version_t version, ze_driver_dditabl
 ze_result_t zeGetDeviceProcAddrTable(ze_api_version_t version, ze_device_dditable_t *pDdiTable) {
     pDdiTable->pfnGet = ispcrt::testing::mock::driver::zeDeviceGet;
     pDdiTable->pfnGetProperties = ispcrt::testing::mock::driver::zeDeviceGetProperties;
+    pDdiTable->pfnGetSubDevices = ispcrt::testing::mock::driver::zeDeviceGetSubDevices;
+    pDdiTable->pfnGetGlobalTimestamps = ispcrt::testing::mock::driver::zeDeviceGetGlobalTimestamps;
     return ZE_RESULT_SUCCESS;
 }
 
@@ -444,6 +511,7 @@ ze_result_t zeGetKernelProcAddrTable(ze_api_version_t version, ze_kernel_dditabl
     pDdiTable->pfnDestroy = ispcrt::testing::mock::driver::zeKernelDestroy;
     pDdiTable->pfnSetArgumentValue = ispcrt::testing::mock::driver::zeKernelSetArgumentValue;
     pDdiTable->pfnSetIndirectAccess = ispcrt::testing::mock::driver::zeKernelSetIndirectAccess;
+    pDdiTable->pfnGetProperties = ispcrt::testing::mock::driver::zeKernelGetProperties;
     pDdiTable->pfnSetGroupSize = ispcrt::testing::mock::driver::zeKernelSetGroupSize;
     pDdiTable->pfnSuggestGroupSize = ispcrt::testing::mock::driver::zeKernelSuggestGroupSize;
     return ZE_RESULT_SUCCESS;
@@ -452,6 +520,8 @@ ze_result_t zeGetKernelProcAddrTable(ze_api_version_t version, ze_kernel_dditabl
 ze_result_t zeGetMemProcAddrTable(ze_api_version_t version, ze_mem_dditable_t *pDdiTable) {
     pDdiTable->pfnAllocDevice = ispcrt::testing::mock::driver::zeMemAllocDevice;
     pDdiTable->pfnAllocShared = ispcrt::testing::mock::driver::zeMemAllocShared;
+    pDdiTable->pfnAllocHost = ispcrt::testing::mock::driver::zeMemAllocHost;
+    pDdiTable->pfnGetAllocProperties = ispcrt::testing::mock::driver::zeMemGetAllocProperties;
 
     pDdiTable->pfnFree = ispcrt::testing::mock::driver::zeMemFree;
     return ZE_RESULT_SUCCESS;
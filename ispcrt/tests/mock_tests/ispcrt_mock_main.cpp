@@ -6,6 +6,8 @@
 
 #include "gtest/gtest.h"
 
+#include <cstdio>
+#include <fstream>
 #include <stdlib.h>
 
 namespace ispcrt {
@@ -97,6 +99,19 @@ class MockTestWithContextMemPool : public MockTestWithContext {
     }
 };
 
+class MockTestWithContextNoMemPool : public MockTestWithContext {
+  protected:
+    void SetUp() override {
+        setenv("ISPCRT_MEM_POOL", "0", 1);
+        MockTestWithContext::SetUp();
+    }
+
+    void TearDown() override {
+        MockTestWithContext::TearDown();
+        unsetenv("ISPCRT_MEM_POOL");
+    }
+};
+
 class MockTestWithModule : public MockTestWithDevice {
   protected:
     void SetUp() override {
@@ -194,14 +209,14 @@ TEST_F(MockTest, Device_Constructor_FromContext) {
 /////////////////////////////////////////////////////////////////////
 // Context tests
 
-TEST_F(MockTestWithContext, SharedMemAlloc1) {
+TEST_F(MockTestWithContextNoMemPool, SharedMemAlloc1) {
     ispcrt::SharedMemoryAllocator<char> sma(m_ctxt);
     sma.allocate(1);
     ASSERT_EQ(CallCounters::get("zeMemAllocShared"), 1);
     ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
 }
 
-TEST_F(MockTestWithContext, SharedMemAlloc4) {
+TEST_F(MockTestWithContextNoMemPool, SharedMemAlloc4) {
     ispcrt::SharedMemoryAllocator<char> sma(m_ctxt);
     for(int i = 0; i < 4; i++)
         sma.allocate(1);
@@ -209,7 +224,7 @@ TEST_F(MockTestWithContext, SharedMemAlloc4) {
     ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
 }
 
-TEST_F(MockTestWithContext, SharedMemAllocHDRW) {
+TEST_F(MockTestWithContextNoMemPool, SharedMemAllocHDRW) {
     ispcrt::SharedMemoryAllocator<char> sma(m_ctxt,
                                             ispcrt::SharedMemoryUsageHint::HostDeviceReadWrite);
     for(int i = 0; i < 10; i++)
@@ -218,7 +233,7 @@ TEST_F(MockTestWithContext, SharedMemAllocHDRW) {
     ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
 }
 
-TEST_F(MockTestWithContext, SharedMemAllocHRDW) {
+TEST_F(MockTestWithContextNoMemPool, SharedMemAllocHRDW) {
     ispcrt::SharedMemoryAllocator<char> sma(m_ctxt,
                                             ispcrt::SharedMemoryUsageHint::HostReadDeviceWrite);
     for(int i = 0; i < 5; i++)
@@ -227,7 +242,7 @@ TEST_F(MockTestWithContext, SharedMemAllocHRDW) {
     ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
 }
 
-TEST_F(MockTestWithContext, SharedMemAllocHWDR) {
+TEST_F(MockTestWithContextNoMemPool, SharedMemAllocHWDR) {
     ispcrt::SharedMemoryAllocator<char> sma(m_ctxt,
                                             ispcrt::SharedMemoryUsageHint::HostWriteDeviceRead);
     for(int i = 0; i < 7; i++)
@@ -255,7 +270,7 @@ TEST_F(MockTestWithContextMemPool, SharedMemAllocHDRW) {
                                             ispcrt::SharedMemoryUsageHint::HostDeviceReadWrite);
     for(int i = 0; i < 10; i++)
         sma.allocate(1ULL << 10);
-    ASSERT_EQ(CallCounters::get("zeMemAllocShared"), 10);
+    ASSERT_EQ(CallCounters::get("zeMemAllocShared"), 1);
     ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
 }
 
@@ -348,6 +363,35 @@ TEST_F(MockTestWithContextMemPool, CheckFreeList) {
     ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
 }
 
+/////////////////////////////////////////////////////////////////////
+// Sub-device tests
+
+TEST_F(MockTestWithDevice, SubDevice_None) {
+    // Single-tile devices have no sub-devices
+    ASSERT_EQ(m_device.subDeviceCount(), 0);
+    ispcrt::Device tile = m_device.subDevice(0);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_ARGUMENT);
+    ASSERT_EQ(tile, 0);
+}
+
+TEST_F(MockTestWithDevice, SubDevice_QueueAndMemory) {
+    // A queue and a memory view are created on every tile
+    Config::setSubDeviceCount(2);
+    ASSERT_EQ(m_device.subDeviceCount(), 2);
+    std::vector<ispcrt::Device> tiles;
+    for (uint32_t t = 0; t < m_device.subDeviceCount(); t++)
+        tiles.push_back(m_device.subDevice(t));
+    for (auto &tile : tiles) {
+        ASSERT_NE(tile, 0);
+        ispcrt::TaskQueue tq(tile);
+        std::vector<float> buf(64 * 1024);
+        ispcrt::Array<float> buf_dev(tile, buf);
+        tq.copyToDevice(buf_dev);
+        tq.sync();
+    }
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+}
+
 /////////////////////////////////////////////////////////////////////
 // Module tests
 
@@ -380,6 +424,37 @@ TEST_F(MockTestWithDevice, Module_Constructor_zeModuleCreate) {
     ASSERT_EQ(sm_rt_error, ISPCRT_DEVICE_LOST);
 }
 
+TEST_F(MockTestWithDevice, Module_LoadAsync) {
+    // Load several modules in parallel and wait for them
+    std::array<ispcrt::Future, 4> loads;
+    for (auto &f : loads)
+        f = ispcrt::Module::loadAsync(m_device, "");
+    for (auto &f : loads) {
+        ispcrt::Module m(f);
+        ASSERT_NE(m, 0);
+        ASSERT_TRUE(f.valid());
+    }
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+}
+
+TEST_F(MockTestWithDevice, Module_LoadAsync_zeModuleCreate) {
+    // Check if error of the loading is reported when the module is requested
+    Config::setRetValue("zeModuleCreate", ZE_RESULT_ERROR_DEVICE_LOST);
+    auto f = ispcrt::Module::loadAsync(m_device, "");
+    ispcrt::Module m(f);
+    ASSERT_EQ(sm_rt_error, ISPCRT_DEVICE_LOST);
+    ASSERT_EQ(m, 0);
+    ASSERT_FALSE(f.valid());
+}
+
+TEST_F(MockTestWithDevice, Module_FromMemory_Unsupported) {
+    // Modules in memory are only loaded by CPU devices
+    const char image[] = "module";
+    ispcrt::Module m(m_device, image, sizeof(image), ISPCRT_MODULE_IMAGE_NATIVE);
+    ASSERT_EQ(sm_rt_error, ISPCRT_UNSUPPORTED);
+    ASSERT_EQ(m, 0);
+}
+
 /////////////////////////////////////////////////////////////////////
 // Dynamic binary linking tests
 
@@ -454,6 +529,12 @@ TEST_F(MockTestWithModule, Kernel_Constructor_zeKernelCreateSetIndirectAccess) {
     ASSERT_EQ(sm_rt_error, ISPCRT_DEVICE_LOST);
 }
 
+TEST_F(MockTestWithModule, Kernel_Constructor_zeKernelGetProperties) {
+    Config::setRetValue("zeKernelGetProperties", ZE_RESULT_ERROR_DEVICE_LOST);
+    ispcrt::Kernel k(m_device, m_module, "");
+    ASSERT_EQ(sm_rt_error, ISPCRT_DEVICE_LOST);
+}
+
 /////////////////////////////////////////////////////////////////////
 // Memory allocation tests
 TEST_F(MockTestWithDevice, ArrayObj) {
@@ -475,6 +556,123 @@ TEST_F(MockTestWithDevice, ArrayObj_zeMemAllocDevice) {
     ASSERT_EQ(dev_buf_ptr, nullptr);
 }
 
+TEST_F(MockTestWithDevice, ArrayObj_MemPool) {
+    std::vector<float> buf(1024);
+    ispcrt::Array<float> buf_dev1(m_device, buf);
+    ispcrt::Array<float> buf_dev2(m_device, buf);
+    ispcrt::Array<float> buf_dev3(m_device, buf);
+    auto dev_buf_ptr1 = buf_dev1.devicePtr();
+    auto dev_buf_ptr2 = buf_dev2.devicePtr();
+    auto dev_buf_ptr3 = buf_dev3.devicePtr();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_NE(dev_buf_ptr1, dev_buf_ptr2);
+    ASSERT_NE(dev_buf_ptr2, dev_buf_ptr3);
+    // Small device allocations are served by one bulk of device memory pool
+    ASSERT_EQ(CallCounters::get("zeMemAllocDevice"), 1);
+}
+
+TEST_F(MockTestWithDevice, ArrayObj_NoMemPool) {
+    setenv("ISPCRT_MEM_POOL", "0", 1);
+    {
+        ispcrt::Device d(ISPCRT_DEVICE_TYPE_GPU);
+        std::vector<float> buf(1024);
+        ispcrt::Array<float> buf_dev1(d, buf);
+        ispcrt::Array<float> buf_dev2(d, buf);
+        buf_dev1.devicePtr();
+        buf_dev2.devicePtr();
+        ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+        ASSERT_EQ(CallCounters::get("zeMemAllocDevice"), 2);
+    }
+    unsetenv("ISPCRT_MEM_POOL");
+}
+
+TEST_F(MockTestWithDevice, ArrayObj_Range) {
+    std::vector<float> buf(1024);
+    ispcrt::Array<float> buf_dev(m_device, buf);
+    ispcrt::Array<float> buf_range(buf_dev, 256, 512);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(buf_range.size(), 512);
+    ASSERT_EQ(buf_range.hostPtr(), buf.data() + 256);
+    ASSERT_EQ(buf_range.devicePtr(), buf_dev.devicePtr() + 256);
+    // The range shares the parent memory
+    ASSERT_EQ(CallCounters::get("zeMemAllocDevice"), 1);
+}
+
+TEST_F(MockTestWithDevice, ArrayObj_Range_OutOfBounds) {
+    std::vector<float> buf(1024);
+    ispcrt::Array<float> buf_dev(m_device, buf);
+    ispcrt::Array<float> buf_range(buf_dev, 1000, 32);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_ARGUMENT);
+}
+
+TEST_F(MockTestWithDevice, ArrayObj_Import) {
+    setenv("ISPCRT_MEM_POOL", "0", 1);
+    {
+        ispcrt::Device d(ISPCRT_DEVICE_TYPE_GPU);
+        std::vector<float> buf(1024);
+        ispcrt::Array<float> buf_dev(d, buf);
+        auto dev_buf_ptr = buf_dev.devicePtr();
+        {
+            auto buf_imported = ispcrt::Array<float>::import(d, dev_buf_ptr, buf.size());
+            ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+            ASSERT_EQ(buf_imported.devicePtr(), dev_buf_ptr);
+            ASSERT_EQ(buf_imported.size(), buf.size());
+        }
+        // Importing neither allocates nor releases memory
+        ASSERT_EQ(CallCounters::get("zeMemAllocDevice"), 1);
+        ASSERT_EQ(CallCounters::get("zeMemFree"), 0);
+    }
+    unsetenv("ISPCRT_MEM_POOL");
+}
+
+TEST_F(MockTestWithDevice, ArrayObj_Import_NotUSM) {
+    std::vector<float> buf(1024);
+    auto buf_imported = ispcrt::Array<float>::import(m_device, buf.data(), buf.size());
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_ARGUMENT);
+}
+
+TEST_F(MockTestWithDevice, ArrayObj_FromFile) {
+    const char *path = "ispcrt_mock_array_from_file.bin";
+    std::vector<float> data(1024);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = (float)i;
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write((const char *)data.data(), data.size() * sizeof(float));
+    }
+    {
+        auto whole = ispcrt::Array<float>::fromFile(m_device, path);
+        ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+        ASSERT_EQ(whole.size(), data.size());
+        ASSERT_EQ(whole.hostPtr()[1023], 1023.0f);
+        // The range doesn't start on a page boundary, and writes don't reach the file
+        auto range = ispcrt::Array<float>::fromFile(m_device, path, 100 * sizeof(float), 8);
+        ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+        ASSERT_EQ(range.size(), 8);
+        ASSERT_EQ(range.hostPtr()[0], 100.0f);
+        range.hostPtr()[0] = -1.0f;
+        ASSERT_EQ(whole.hostPtr()[100], 100.0f);
+        auto shared = ispcrt::Array<float, ispcrt::AllocType::Shared>::fromFile(m_device, path);
+        ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+        ASSERT_EQ(shared.size(), data.size());
+        ASSERT_EQ(shared.sharedPtr()[1023], 1023.0f);
+    }
+    auto outside = ispcrt::Array<float>::fromFile(m_device, path, 1000 * sizeof(float), 32);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_ARGUMENT);
+    remove(path);
+}
+
+// Memory views allocated on CPU are aligned to pages and are their own host memory
+TEST_F(MockTest, ArrayObj_CPUAlloc) {
+    ispcrt::Device d(ISPCRT_DEVICE_TYPE_CPU);
+    ispcrt::Array<float, ispcrt::AllocType::Shared> shared(d, 1024 * 1024);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(shared.sharedPtr()) % 4096, 0);
+    ispcrt::Array<float> small(d, nullptr, 4);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(small.devicePtr()) % 64, 0);
+    ASSERT_EQ(small.hostPtr(), small.devicePtr());
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+}
+
 TEST_F(MockTest, ArrayObj_contextAlloc) {
     ispcrt::Context c(ISPCRT_DEVICE_TYPE_GPU);
     auto buf_dev = ispcrt::Array<float, ispcrt::AllocType::Shared>(c, 64 * 1024);
@@ -609,6 +807,17 @@ TEST_F(MockTestWithDevice, TaskQueue_CopyArray_InvalidSize) {
     ASSERT_EQ(sm_rt_error, ISPCRT_UNKNOWN_ERROR);
 }
 
+TEST_F(MockTestWithDevice, TaskQueue_CopyToDevice_Range) {
+    ispcrt::TaskQueue tq(m_device);
+    std::vector<float> buf(64 * 1024);
+    ispcrt::Array<float> buf_dev(m_device, buf);
+    ispcrt::Array<float> buf_range(buf_dev, 1024, 1024);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    tq.copyToDevice(buf_range);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_TRUE(Config::checkCmdList({CmdListElem::MemoryCopy}));
+}
+
 TEST_F(MockTestWithDevice, TaskQueue_Barrier_zeCommandListAppendBarrier) {
     ispcrt::TaskQueue tq(m_device);
     ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
@@ -841,6 +1050,74 @@ TEST_F(MockTestWithModuleQueueKernel, TaskQueue_Sync) {
     ASSERT_EQ(CallCounters::get("zeCommandQueueSynchronize"), 1);
 }
 
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_Signal) {
+    auto tq = m_task_queue;
+    tq.launch(m_kernel, 0);
+    auto s = tq.signal();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    // Future of the previous commands is signaled by a barrier
+    ASSERT_TRUE(Config::checkCmdList({CmdListElem::KernelLaunch, CmdListElem::Barrier}));
+    ASSERT_FALSE(s.valid());
+    tq.sync();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_TRUE(s.valid());
+}
+
+// The task queue releases the futures at sync and the memory of the deleted ones is reused
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_FuturesReleased) {
+    ISPCRTFuture released = nullptr;
+    {
+        auto s = m_task_queue.signal();
+        ASSERT_EQ(ispcrtUseCount(s.handle()), 2);
+        m_task_queue.sync();
+        ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+        ASSERT_EQ(ispcrtUseCount(s.handle()), 1);
+        released = s.handle();
+    }
+    auto s = m_task_queue.signal();
+    ASSERT_EQ(s.handle(), released);
+    m_task_queue.sync();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_TRUE(s.valid());
+}
+
+TEST_F(MockTest, TaskQueue_CPUFuturesReleased) {
+    ispcrt::Device d(ISPCRT_DEVICE_TYPE_CPU);
+    ispcrt::TaskQueue q(d);
+    auto s = q.signal();
+    ASSERT_EQ(ispcrtUseCount(s.handle()), 2);
+    q.sync();
+    ASSERT_EQ(ispcrtUseCount(s.handle()), 1);
+    ASSERT_TRUE(s.valid());
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+}
+
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_WaitFuture) {
+    auto tq = m_task_queue;
+    auto f = tq.launch(m_kernel, 0);
+    tq.wait(f);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    tq.launch(m_kernel, 0);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_TRUE(Config::checkCmdList({CmdListElem::KernelLaunch, CmdListElem::Barrier, CmdListElem::KernelLaunch}));
+    tq.sync();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_TRUE(f.valid());
+    ASSERT_EQ(CallCounters::get("zeCommandQueueSynchronize"), 1);
+    // Nothing to wait on for completed futures
+    tq.wait(f);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_TRUE(Config::checkCmdList({}));
+    // Can't wait while capturing
+    tq.beginCapture();
+    auto f2 = tq.launch(m_kernel, 0);
+    tq.wait(f2);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_OPERATION);
+    ResetError();
+    tq.endCapture();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+}
+
 TEST_F(MockTestWithModuleQueueKernel, TaskQueue_Launch_zeKernelSetArgumentValue) {
     Config::setRetValue("zeKernelSetArgumentValue", ZE_RESULT_ERROR_DEVICE_LOST);
     // We need an argument to a kernel to make sure zeKernelSetArgumentValue is called
@@ -851,6 +1128,55 @@ TEST_F(MockTestWithModuleQueueKernel, TaskQueue_Launch_zeKernelSetArgumentValue)
     ASSERT_EQ(sm_rt_error, ISPCRT_DEVICE_LOST);
 }
 
+// Parameters passed with the launch get device accessible host memory of their own, freed on sync
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_LaunchInline) {
+    struct Params {
+        float scale;
+        int count;
+    } params = {2.0f, 64};
+    const auto allocs = CallCounters::get("zeMemAllocHost");
+    const auto frees = CallCounters::get("zeMemFree");
+    const auto args = CallCounters::get("zeKernelSetArgumentValue");
+    auto f = m_task_queue.launchInline(m_kernel, params, 1);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_TRUE(Config::checkCmdList({CmdListElem::KernelLaunch}));
+    ASSERT_EQ(CallCounters::get("zeMemAllocHost"), allocs + 1);
+    ASSERT_EQ(CallCounters::get("zeKernelSetArgumentValue"), args + 1);
+    m_task_queue.sync();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(CallCounters::get("zeMemFree"), frees + 1);
+    ASSERT_TRUE(f.valid());
+}
+
+// Batched launches share one block of host memory for their parameters and complete one future with a barrier
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_LaunchBatch) {
+    struct Params {
+        float scale;
+        int count;
+    };
+    std::vector<Params> params = {{2.0f, 64}, {3.0f, 32}, {4.0f, 16}};
+    std::vector<std::array<size_t, 3>> dims = {{1, 1, 1}, {2, 1, 1}, {4, 1, 1}};
+    const auto allocs = CallCounters::get("zeMemAllocHost");
+    const auto launches = CallCounters::get("zeCommandListAppendLaunchKernel");
+    const auto args = CallCounters::get("zeKernelSetArgumentValue");
+    auto f = m_task_queue.launchBatch(m_kernel, params, dims);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_TRUE(Config::checkCmdList(
+        {CmdListElem::KernelLaunch, CmdListElem::KernelLaunch, CmdListElem::KernelLaunch, CmdListElem::Barrier}));
+    ASSERT_EQ(CallCounters::get("zeMemAllocHost"), allocs + 1);
+    ASSERT_EQ(CallCounters::get("zeCommandListAppendLaunchKernel"), launches + 3);
+    ASSERT_EQ(CallCounters::get("zeKernelSetArgumentValue"), args + 3);
+    m_task_queue.sync();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_TRUE(f.valid());
+}
+
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_LaunchBatch_Empty) {
+    ispcrtLaunchBatch(m_task_queue.handle(), m_kernel.handle(), nullptr, 0, nullptr, 0);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_ARGUMENT);
+    sm_rt_error = ISPCRT_NO_ERROR;
+}
+
 TEST_F(MockTestWithModuleQueueKernel, TaskQueue_Launch_zeCommandListAppendLaunchKernel) {
     Config::setRetValue("zeCommandListAppendLaunchKernel", ZE_RESULT_ERROR_DEVICE_LOST);
     m_task_queue.launch(m_kernel, 0);
@@ -917,6 +1243,206 @@ TEST_F(MockTestWithModuleQueueKernel, TaskQueue_Sync_zeEventQueryKernelTimestamp
     ASSERT_EQ(sm_rt_error, ISPCRT_DEVICE_LOST);
 }
 
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_FutureTimestampsNotProfiled) {
+    auto tq = m_task_queue;
+    auto f = tq.launch(m_kernel, 0);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    tq.sync();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_TRUE(f.valid());
+    ISPCRTFutureTimestamps ts;
+    ASSERT_FALSE(f.timestamps(ts));
+    ASSERT_EQ(CallCounters::get("zeDeviceGetGlobalTimestamps"), 0);
+}
+
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_ProfilingTrace) {
+    auto tq = m_task_queue;
+    tq.setProfiling(true);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    auto f1 = tq.launch(m_kernel, 0);
+    auto f2 = tq.launch(m_kernel, 0);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    tq.sync();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    // The device timestamp is read once per sync
+    ASSERT_EQ(CallCounters::get("zeDeviceGetGlobalTimestamps"), 1);
+    ISPCRTFutureTimestamps ts;
+    ASSERT_TRUE(f1.timestamps(ts));
+    ASSERT_LE(ts.submitNs, ts.startNs);
+    ASSERT_LE(ts.startNs, ts.endNs);
+
+    const char *traceFile = "ispcrt_mock_trace.json";
+    tq.writeTrace(traceFile);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    std::ifstream trace(traceFile);
+    std::string line;
+    int launches = 0;
+    while (std::getline(trace, line)) {
+        if (line.find("\"cat\":\"launch\"") != std::string::npos)
+            launches++;
+    }
+    trace.close();
+    std::remove(traceFile);
+    ASSERT_EQ(launches, 2);
+}
+
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_ProfilingTraceCopies) {
+    auto tq = m_task_queue;
+    tq.setProfiling(true);
+    std::vector<float> buf(64 * 1024);
+    ispcrt::Array<float> buf_dev(m_device, buf);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    tq.copyToDevice(buf_dev);
+    auto f = tq.launch(m_kernel, 0);
+    tq.copyToHost(buf_dev);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    tq.sync();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+
+    const char *traceFile = "ispcrt_mock_trace_copies.json";
+    tq.writeTrace(traceFile);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    std::ifstream trace(traceFile);
+    std::string line;
+    int launches = 0, copies = 0;
+    while (std::getline(trace, line)) {
+        if (line.find("\"cat\":\"launch\"") != std::string::npos)
+            launches++;
+        if (line.find("\"cat\":\"copy\"") != std::string::npos)
+            copies++;
+    }
+    trace.close();
+    std::remove(traceFile);
+    ASSERT_EQ(launches, 1);
+    ASSERT_EQ(copies, 2);
+}
+
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_WriteTraceBadFile) {
+    auto tq = m_task_queue;
+    tq.setProfiling(true);
+    tq.writeTrace("nonexistent_dir/trace.json");
+    ASSERT_EQ(sm_rt_error, ISPCRT_UNKNOWN_ERROR);
+}
+
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_GraphReplay) {
+    auto tq = m_task_queue;
+    tq.beginCapture();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    auto f = tq.launch(m_kernel, 0);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    auto g = tq.endCapture();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_TRUE(Config::checkCmdList({CmdListElem::KernelLaunch}));
+    // Nothing is executed until the graph is replayed
+    ASSERT_FALSE(f.valid());
+    ASSERT_EQ(CallCounters::get("zeCommandQueueExecuteCommandLists"), 0);
+    for (int i = 1; i <= 3; i++) {
+        tq.replay(g);
+        ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+        tq.sync();
+        ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+        ASSERT_TRUE(f.valid());
+        // The same command list is executed again without recording or closing it
+        ASSERT_EQ(CallCounters::get("zeCommandQueueExecuteCommandLists"), i);
+        ASSERT_EQ(CallCounters::get("zeCommandListClose"), 1);
+        ASSERT_TRUE(Config::checkCmdList({CmdListElem::KernelLaunch}));
+    }
+}
+
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_GraphInvalidOperations) {
+    auto tq = m_task_queue;
+    tq.beginCapture();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    tq.beginCapture();
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_OPERATION);
+    ResetError();
+    tq.launch(m_kernel, 0);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    // Can't sync while capturing
+    tq.sync();
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_OPERATION);
+    ResetError();
+    auto g = tq.endCapture();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    tq.endCapture();
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_OPERATION);
+    ResetError();
+    tq.replay(g);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    // Can't replay before the previous replay is synced
+    tq.replay(g);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_OPERATION);
+    ResetError();
+    tq.sync();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+}
+
+/////////////////////////////////////////////////////////////////////
+// Device group tests
+TEST_F(MockTest, DeviceGroup_Launch) {
+    ispcrt::DeviceGroup group(ISPCRT_DEVICE_TYPE_GPU);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(group.size(), 1);
+    auto kernels = group.newKernels("", "");
+    std::vector<float> buf(1024);
+    auto arrs = group.scatter(buf.data(), buf.size());
+    ASSERT_EQ(arrs[0].size(), buf.size());
+    std::vector<ispcrt::Array<float>> params;
+    params.emplace_back(group.device(0), buf);
+    group.copyToDevice(arrs);
+    auto futures = group.launch(kernels, params, 1, 4, 16);
+    group.sync();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(futures.size(), 1);
+    ASSERT_TRUE(futures[0].valid());
+    ASSERT_EQ(CallCounters::get("zeCommandListAppendLaunchKernel"), 1);
+    ASSERT_THROW(group.launch(kernels, params, 3, 4, 16), std::invalid_argument);
+}
+
+TEST_F(MockTest, DeviceGroup_Partition) {
+    ispcrt::Context c(ISPCRT_DEVICE_TYPE_CPU);
+    ispcrt::DeviceGroup group(c, {0, 0, 0});
+    auto parts = group.partition(10);
+    ASSERT_EQ(parts.size(), 3);
+    ASSERT_EQ(parts[0].offset, 0);
+    ASSERT_EQ(parts[0].count, 4);
+    ASSERT_EQ(parts[1].offset, 4);
+    ASSERT_EQ(parts[1].count, 3);
+    ASSERT_EQ(parts[2].offset, 7);
+    ASSERT_EQ(parts[2].count, 3);
+    ASSERT_EQ(parts[2].total, 10);
+    // Devices may get empty parts
+    parts = group.partition(2);
+    ASSERT_EQ(parts[2].count, 0);
+}
+
+/////////////////////////////////////////////////////////////////////
+// Stream pipeline tests
+TEST_F(MockTestWithModuleQueueKernel, StreamPipeline_Run) {
+    struct Params {
+        float *in;
+        float *out;
+        size_t count;
+    };
+    ispcrt::StreamPipeline<float, float, Params> pipeline(m_device, m_kernel, 1024, 3, 16);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    const std::vector<size_t> counts = {1024, 1024, 1024, 1024, 100};
+    std::vector<size_t> sunk;
+    auto chunks = pipeline.run(
+        [&](size_t chunk, float *data, size_t maxCount) { return chunk < counts.size() ? counts[chunk] : 0; },
+        [](size_t, float *in, float *out, size_t count) { return Params{in, out, count}; },
+        [&](size_t chunk, const float *, size_t count) {
+            ASSERT_EQ(chunk, sunk.size());
+            ASSERT_EQ(count, counts[chunk]);
+            sunk.push_back(chunk);
+        });
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(chunks, counts.size());
+    ASSERT_EQ(sunk.size(), counts.size());
+    ASSERT_EQ(CallCounters::get("zeCommandListAppendLaunchKernel"), counts.size());
+    ASSERT_THROW((ispcrt::StreamPipeline<float, float, Params>(m_device, m_kernel, 1024, 0)), std::invalid_argument);
+}
+
 /// C Device API
 TEST_F(MockTest, C_API_DeviceCount1) {
     // CPU
@@ -955,6 +1481,7 @@ TEST_F(MockTest, C_API_DeviceInfoCPU) {
     ispcrtGetDeviceInfo(ISPCRT_DEVICE_TYPE_CPU, 0, &di);
     ASSERT_EQ(0, di.deviceId);
     ASSERT_EQ(0, di.vendorId);
+    ASSERT_EQ(0, di.subDeviceCount);
 }
 
 TEST_F(MockTest, C_API_DeviceInfoGPU) {
@@ -981,6 +1508,14 @@ TEST_F(MockTest, C_API_DeviceInfoGPU) {
     }
 }
 
+TEST_F(MockTest, C_API_DeviceInfoSubDevices) {
+    Config::setSubDeviceCount(2);
+    ISPCRTDeviceInfo di;
+    ispcrtGetDeviceInfo(ISPCRT_DEVICE_TYPE_GPU, 0, &di);
+    ASSERT_EQ(2, di.subDeviceCount);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+}
+
 /// C Context API
 TEST_F(MockTest, C_API_CreateDeviceFromContext) {
     Config::setDeviceCount(2);
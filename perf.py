@@ -193,7 +193,7 @@ def print_answer(answer, target_number):
         if options.output == "":
             options.output = "targets.csv"
         filelist.append("test name,ISPC speedup" + "," * target_number + "ISPC + tasks speedup\n")
-        filelist.append("," + options.perf_target + "," + options.perf_target + "\n")
+        filelist.append("," + ",".join(config_labels) + "," + ",".join(config_labels) + "\n")
     else:
         filelist.append("test name,ISPC speedup,diff," +
             "ISPC + tasks speedup,diff,ISPC time,diff,ISPC + tasks time,diff,serial,diff\n")
@@ -269,6 +269,80 @@ def print_answer(answer, target_number):
     return list_of_compare
 
 
+#returns the flags that select --opt variant of a sweep, "none" stands for no flag and
+#flags that start with "-" are passed as is, variants may combine several flags with "+"
+def opt_flags(opt):
+    flags = []
+    for flag in opt.split("+"):
+        if flag == "" or flag == "none":
+            continue
+        if flag[0] == "-":
+            flags.append(flag)
+        else:
+            flags.append("--opt=" + flag)
+    return flags
+
+def config_label(target, opt):
+    label = target
+    if opt != "":
+        label += " " + opt
+    return label
+
+#takes an answer struct of a sweep over configurations and writes, for every test and every
+#target and --opt variant, the speedups over the serial version and which configuration is the best one.
+#The best configuration is the one with the highest ISPC speedup, or ISPC + tasks speedup for tests
+#that report only that. The file is JSON when its name ends with .json and CSV otherwise.
+def print_sweep(answer, configs):
+    benchmarks = []
+    for i in range(0, len(answer), len(configs)):
+        results = []
+        best = -1
+        best_speedup = 0
+        for k in range(len(configs)):
+            test = answer[i + k]
+            result = {"target": configs[k][0], "opt": configs[k][1]}
+            for t, key in [(1, "ispc_speedup"), (2, "tasks_speedup")]:
+                result[key] = max(test[t]) if len(test[t]) != 0 else None
+            for t, key in [(3, "ispc_time"), (4, "tasks_time"), (5, "serial_time")]:
+                result[key] = min(test[t]) if len(test[t]) != 0 else None
+            speedup = result["ispc_speedup"] if result["ispc_speedup"] != None else result["tasks_speedup"]
+            if speedup != None and speedup > best_speedup:
+                best = k
+                best_speedup = speedup
+            results.append(result)
+        benchmark = {"name": answer[i][0], "results": results, "best": None}
+        if best != -1:
+            benchmark["best"] = {"target": configs[best][0], "opt": configs[best][1], "speedup": best_speedup}
+        benchmarks.append(benchmark)
+
+    print_debug("\n\n_____________________BEST CONFIGURATION____________________________\n", False, perf_log)
+    for benchmark in benchmarks:
+        if benchmark["best"] != None:
+            best = benchmark["best"]
+            print_debug("%21s:  %10.2f  %s\n" % (benchmark["name"], best["speedup"],
+                config_label(best["target"], best["opt"])), False, perf_log)
+        else:
+            print_debug("%21s:  %10s\n" % (benchmark["name"], "n/a"), False, perf_log)
+
+    output = open(options.results, 'w')
+    if options.results.endswith(".json"):
+        json.dump({"benchmarks": benchmarks}, output, indent=2)
+        output.write("\n")
+    else:
+        def field(value):
+            return "" if value == None else '%.2f' % value
+        output.write("test name,target,opt,ISPC speedup,ISPC + tasks speedup," +
+            "ISPC time,ISPC + tasks time,serial,best\n")
+        for benchmark in benchmarks:
+            for result in benchmark["results"]:
+                is_best = (benchmark["best"] != None and benchmark["best"]["target"] == result["target"] and
+                           benchmark["best"]["opt"] == result["opt"])
+                output.write(",".join([benchmark["name"], result["target"], result["opt"],
+                    field(result["ispc_speedup"]), field(result["tasks_speedup"]), field(result["ispc_time"]),
+                    field(result["tasks_time"]), field(result["serial_time"]), "yes" if is_best else ""]) + "\n")
+    output.close()
+
+
 def compare(A, B):
     print_debug("\n\n_____________________PERFORMANCE REPORT____________________________\n", False, "")
     print_debug("test name:                 ISPC time: ISPC time ref: %:\n", False, "")
@@ -329,9 +403,10 @@ def perf(options1, args):
                         sse4-i32x4 sse4-i32x8 sse4-i16x8 sse4-i8x16 \
                         sse4.1-i32x4 sse4.1-i32x8 sse4.1-i16x8 sse4.1-i8x16 \
                         avx1-i32x4 avx1-i32x8 avx1-i32x16 avx1-i64x4 \
-                        avx2-i32x4 avx2-i32x8 avx2-i32x16 avx2-i64x4 \
+                        avx2-i32x4 avx2-i32x8 avx2-i32x16 avx2-i64x4 avx2-i16x16 avx2-i8x32 \
                         avx512knl-x16 \
-                        avx512skx-x16 avx512skx-x8 avx512skx-x4 avx512skx-x64 avx512skx-x32"
+                        avx512skx-x16 avx512skx-x8 avx512skx-x4 avx512skx-x64 avx512skx-x32 \
+                        avx512spr-x4 avx512spr-x8 avx512spr-x16 avx512spr-x32 avx512spr-x64"
         test_only = options.perf_target.split(",")
         for iterator in test_only:
             if not (" " + iterator + " " in test_only_r):
@@ -443,12 +518,18 @@ def perf(options1, args):
     answer_ref = []
     # loop for all tests
     perf_targets = [""]
-    target_number = 1
+    perf_opts = [""]
     target_str_temp = ""
     if options.perf_target != "":
         perf_targets = options.perf_target.split(',')
         target_str_temp = " -DISPC_IA_TARGETS="
-        target_number = len(perf_targets)
+    if options.perf_opt != "":
+        perf_opts = options.perf_opt.split(',')
+    # every target is built with every --opt variant
+    configs = [(target, opt) for target in perf_targets for opt in perf_opts]
+    target_number = len(configs)
+    global config_labels
+    config_labels = [config_label(target, opt) for (target, opt) in configs]
     # Generate build targets for tests
     if options.generator:
         generator = options.generator
@@ -464,8 +545,12 @@ def perf(options1, args):
     if is_windows == False:
         cmake_command += " -DCMAKE_CXX_COMPILER=clang++ -DCMAKE_C_COMPILER=clang"
     for target_i in range(target_number):
-        cur_target = perf_targets[target_i]
-        target_str = target_str_temp + cur_target
+        cur_target = config_labels[target_i].replace(" ", "-opt-").replace("+", "-")
+        target_str = ""
+        if configs[target_i][0] != "":
+            target_str = target_str_temp + configs[target_i][0]
+        if configs[target_i][1] != "":
+            target_str += " \"-DISPC_EXTRA_FLAGS=" + ";".join(opt_flags(configs[target_i][1])) + "\""
         if options.ref:
             build_folder = examples_folder_ref + os.sep + cur_target
             if os.path.exists(build_folder):
@@ -513,7 +598,7 @@ def perf(options1, args):
         for target_i in range(target_number):
             test = [lines[i][:-1],[],[],[],[],[]]
             test_ref = [lines[i][:-1],[],[],[],[],[]]
-            cur_target = perf_targets[target_i]
+            cur_target = config_labels[target_i].replace(" ", "-opt-").replace("+", "-")
             folder = os.path.normpath(options.path + os.sep + examples_folder_test + os.sep + cur_target + \
                                       os.sep + install_prefix + os.sep + "examples" + os.sep + example)
             folder_ref = os.path.normpath(options.path + os.sep + examples_folder_ref + os.sep + cur_target + \
@@ -566,6 +651,8 @@ def perf(options1, args):
         B = print_answer(answer_ref, target_number)
         # print perf report
         compare(A,B)
+    if options.results != "":
+        print_sweep(answer, configs)
 
 
 
@@ -578,6 +665,7 @@ import time
 import glob
 import platform
 import shutil
+import json
 # our functions
 import common
 print_debug = common.print_debug
@@ -607,6 +695,12 @@ if __name__ == "__main__":
         help='set ispc target for building benchmarks (both test and ref)', default="")
     parser.add_option('-g', '--generator', dest='generator',
         help='cmake generator')
+    parser.add_option('--opt', dest='perf_opt',
+        help='comma separated --opt variants to build benchmarks with for every target, ' +
+            'e.g. none,fast-math,disable-fma; "+" combines options of one variant', default="")
+    parser.add_option('--results', dest='results',
+        help='file to save speedups and the best target and --opt variant of every benchmark, ' +
+            'JSON if it ends with .json and CSV otherwise', default="")
     (options, args) = parser.parse_args()
     perf(options, args)
     exit(exit_code)
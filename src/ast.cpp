@@ -40,10 +40,12 @@
 #include "ast.h"
 #include "expr.h"
 #include "func.h"
+#include "module.h"
 #include "stmt.h"
 #include "sym.h"
 #include "util.h"
 
+#include <llvm/IR/Module.h>
 #include <llvm/Support/TimeProfiler.h>
 
 using namespace ispc;
@@ -156,13 +158,58 @@ void AST::AddFunctionTemplate(TemplateSymbol *templSym, Stmt *code) {
 
 void AST::GenerateIR() {
     llvm::TimeTraceScope TimeScope("GenerateIR");
+    // Most of the static stdlib functions are not used by a program, so
+    // their IR is generated only once they are referenced by other code.
+    std::vector<Function *> onDemand;
     for (auto fn : functions) {
-        fn->GenerateIR();
+        if (fn->IsGeneratedOnDemand()) {
+            onDemand.push_back(fn);
+        } else {
+            fn->GenerateIR();
+        }
     }
 
     for (auto templateFn : functionTemplates) {
         templateFn->GenerateIR();
     }
+
+    // Generated functions may reference other stdlib functions, so repeat
+    // until no more functions are needed. On Xe, the tasks launched from
+    // device code also need a version which is called by the launching code.
+    bool generated = true;
+    while (generated) {
+        generated = false;
+        for (auto &fn : onDemand) {
+            if (fn != NULL && fn->IsReferenced()) {
+                fn->GenerateIR();
+                fn = NULL;
+                generated = true;
+            }
+        }
+        for (auto fn : functions) {
+            if (fn->IsLaunchedOnXe()) {
+                fn->GenerateXeLaunchedTaskIR();
+                generated = true;
+            }
+        }
+    }
+
+    // Tasks that are launched from Xe code must be defined in the same file.
+    if (g->target->isXeTarget()) {
+        for (llvm::Function &function : m->module->functions()) {
+            llvm::StringRef name = function.getName();
+            if (function.empty() && name.consume_back("___xe_launched")) {
+                Error(SourcePos(), "Task \"%s\" is launched from Xe code, but it isn't defined.", name.str().c_str());
+            }
+        }
+    }
+
+    // The remaining ones are not used, drop their declarations.
+    for (auto fn : onDemand) {
+        if (fn != NULL) {
+            fn->RemoveDeclaration();
+        }
+    }
 }
 
 void AST::Print(Globals::ASTDumpKind printKind) const {
@@ -344,6 +391,7 @@ ASTNode *ispc::WalkAST(ASTNode *node, ASTPreCallBackFunc preFunc, ASTPostCallBac
             fce->args = (ExprList *)WalkAST(fce->args, preFunc, postFunc, data);
             for (int k = 0; k < 3; k++)
                 fce->launchCountExpr[k] = (Expr *)WalkAST(fce->launchCountExpr[k], preFunc, postFunc, data);
+            fce->launchAfter = (ExprList *)WalkAST(fce->launchAfter, preFunc, postFunc, data);
         } else if ((ie = llvm::dyn_cast<IndexExpr>(node)) != NULL) {
             ie->baseExpr = (Expr *)WalkAST(ie->baseExpr, preFunc, postFunc, data);
             ie->index = (Expr *)WalkAST(ie->index, preFunc, postFunc, data);
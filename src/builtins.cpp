@@ -60,6 +60,7 @@
 #include <llvm/Linker/Linker.h>
 #include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Target/TargetMachine.h>
+#include <llvm/Transforms/Utils/Cloning.h>
 
 #ifdef ISPC_XE_ENABLED
 #include <llvm/GenXIntrinsics/GenXIntrinsics.h>
@@ -421,6 +422,66 @@ static void lSetInternalFunctions(llvm::Module *module) {
         "__aos_to_soa4_float4",
         "__aos_to_soa4_float64",
         "__aos_to_soa4_float8",
+        "__aos_to_soa2_i8",
+        "__aos_to_soa2_i16",
+        "__aos_to_soa2_i32",
+        "__aos_to_soa2_i64",
+        "__aos_to_soa3_i8",
+        "__aos_to_soa3_i16",
+        "__aos_to_soa3_i32",
+        "__aos_to_soa3_i64",
+        "__aos_to_soa4_i8",
+        "__aos_to_soa4_i16",
+        "__aos_to_soa4_i32",
+        "__aos_to_soa4_i64",
+        "__aos_to_soa5_i8",
+        "__aos_to_soa5_i16",
+        "__aos_to_soa5_i32",
+        "__aos_to_soa5_i64",
+        "__aos_to_soa6_i8",
+        "__aos_to_soa6_i16",
+        "__aos_to_soa6_i32",
+        "__aos_to_soa6_i64",
+        "__aos_to_soa7_i8",
+        "__aos_to_soa7_i16",
+        "__aos_to_soa7_i32",
+        "__aos_to_soa7_i64",
+        "__aos_to_soa8_i8",
+        "__aos_to_soa8_i16",
+        "__aos_to_soa8_i32",
+        "__aos_to_soa8_i64",
+        "__aos_to_soa9_i8",
+        "__aos_to_soa9_i16",
+        "__aos_to_soa9_i32",
+        "__aos_to_soa9_i64",
+        "__aos_to_soa10_i8",
+        "__aos_to_soa10_i16",
+        "__aos_to_soa10_i32",
+        "__aos_to_soa10_i64",
+        "__aos_to_soa11_i8",
+        "__aos_to_soa11_i16",
+        "__aos_to_soa11_i32",
+        "__aos_to_soa11_i64",
+        "__aos_to_soa12_i8",
+        "__aos_to_soa12_i16",
+        "__aos_to_soa12_i32",
+        "__aos_to_soa12_i64",
+        "__aos_to_soa13_i8",
+        "__aos_to_soa13_i16",
+        "__aos_to_soa13_i32",
+        "__aos_to_soa13_i64",
+        "__aos_to_soa14_i8",
+        "__aos_to_soa14_i16",
+        "__aos_to_soa14_i32",
+        "__aos_to_soa14_i64",
+        "__aos_to_soa15_i8",
+        "__aos_to_soa15_i16",
+        "__aos_to_soa15_i32",
+        "__aos_to_soa15_i64",
+        "__aos_to_soa16_i8",
+        "__aos_to_soa16_i16",
+        "__aos_to_soa16_i32",
+        "__aos_to_soa16_i64",
         "__atomic_add_int32_global",
         "__atomic_add_int64_global",
         "__atomic_add_uniform_int32_global",
@@ -472,6 +533,7 @@ static void lSetInternalFunctions(llvm::Module *module) {
         "__broadcast_i32",
         "__broadcast_i64",
         "__broadcast_i8",
+        "__cancel_tasks",
         "__cast_mask_to_i1",
         "__cast_mask_to_i8",
         "__cast_mask_to_i16",
@@ -484,21 +546,31 @@ static void lSetInternalFunctions(llvm::Module *module) {
         "__ceil_varying_float",
         "__ceil_varying_half",
         "__clock",
+        "__conflict_i32",
         "__count_trailing_zeros_i32",
         "__count_trailing_zeros_i64",
         "__count_leading_zeros_i32",
         "__count_leading_zeros_i64",
+        "__crc32c_u64",
         "__delete_uniform_32rt",
         "__delete_uniform_64rt",
+        "__delete_uniform_custom",
         "__delete_varying_32rt",
         "__delete_varying_64rt",
+        "__delete_varying_custom",
         "__do_assume_uniform",
+        "__do_assume_aligned_uniform",
         "__do_assert_uniform",
         "__do_assert_varying",
+        "__do_assert_fail",
         "__do_print",
 #ifdef ISPC_XE_ENABLED
         "__send_eot",
 #endif //ISPC_XE_ENABLED
+        "__dot2add_i16i16packed",
+        "__dot2add_i16i16packed_sat",
+        "__dot4add_u8i8packed",
+        "__dot4add_u8i8packed_sat",
         "__doublebits_uniform_int64",
         "__doublebits_varying_int64",
         "__exclusive_scan_add_double",
@@ -530,9 +602,16 @@ static void lSetInternalFunctions(llvm::Module *module) {
         "__floor_varying_double",
         "__floor_varying_float",
         "__floor_varying_half",
+        "__fma_uniform_double",
+        "__fma_uniform_float",
+        "__fma_varying_double",
+        "__fma_varying_float",
         "__get_system_isa",
         "__half_to_float_uniform",
         "__half_to_float_varying",
+        "__have_conflict_detection",
+        "__have_crc32c",
+        "__have_fma",
         "__idiv_uint8",
         "__idiv_uint16",
         "__idiv_uint32",
@@ -586,17 +665,28 @@ static void lSetInternalFunctions(llvm::Module *module) {
         "__min_varying_uint32",
         "__min_varying_uint64",
         "__movmsk",
+        "__muladd_varying_double",
+        "__muladd_varying_float",
         "__new_uniform_32rt",
         "__new_uniform_64rt",
+        "__new_uniform_custom",
         "__new_varying32_32rt",
         "__new_varying32_64rt",
+        "__new_varying32_custom",
         "__new_varying64_64rt",
+        "__new_varying64_custom",
         "__none",
         "__num_cores",
+        "__packed_load_activei8",
+        "__packed_load_activei16",
         "__packed_load_activei32",
         "__packed_load_activei64",
+        "__packed_store_activei8",
+        "__packed_store_activei16",
         "__packed_store_activei32",
         "__packed_store_activei64",
+        "__packed_store_active2i8",
+        "__packed_store_active2i16",
         "__packed_store_active2i32",
         "__packed_store_active2i64",
         "__padds_ui8",
@@ -813,6 +903,66 @@ static void lSetInternalFunctions(llvm::Module *module) {
         "__soa_to_aos4_float4",
         "__soa_to_aos4_float64",
         "__soa_to_aos4_float8",
+        "__soa_to_aos2_i8",
+        "__soa_to_aos2_i16",
+        "__soa_to_aos2_i32",
+        "__soa_to_aos2_i64",
+        "__soa_to_aos3_i8",
+        "__soa_to_aos3_i16",
+        "__soa_to_aos3_i32",
+        "__soa_to_aos3_i64",
+        "__soa_to_aos4_i8",
+        "__soa_to_aos4_i16",
+        "__soa_to_aos4_i32",
+        "__soa_to_aos4_i64",
+        "__soa_to_aos5_i8",
+        "__soa_to_aos5_i16",
+        "__soa_to_aos5_i32",
+        "__soa_to_aos5_i64",
+        "__soa_to_aos6_i8",
+        "__soa_to_aos6_i16",
+        "__soa_to_aos6_i32",
+        "__soa_to_aos6_i64",
+        "__soa_to_aos7_i8",
+        "__soa_to_aos7_i16",
+        "__soa_to_aos7_i32",
+        "__soa_to_aos7_i64",
+        "__soa_to_aos8_i8",
+        "__soa_to_aos8_i16",
+        "__soa_to_aos8_i32",
+        "__soa_to_aos8_i64",
+        "__soa_to_aos9_i8",
+        "__soa_to_aos9_i16",
+        "__soa_to_aos9_i32",
+        "__soa_to_aos9_i64",
+        "__soa_to_aos10_i8",
+        "__soa_to_aos10_i16",
+        "__soa_to_aos10_i32",
+        "__soa_to_aos10_i64",
+        "__soa_to_aos11_i8",
+        "__soa_to_aos11_i16",
+        "__soa_to_aos11_i32",
+        "__soa_to_aos11_i64",
+        "__soa_to_aos12_i8",
+        "__soa_to_aos12_i16",
+        "__soa_to_aos12_i32",
+        "__soa_to_aos12_i64",
+        "__soa_to_aos13_i8",
+        "__soa_to_aos13_i16",
+        "__soa_to_aos13_i32",
+        "__soa_to_aos13_i64",
+        "__soa_to_aos14_i8",
+        "__soa_to_aos14_i16",
+        "__soa_to_aos14_i32",
+        "__soa_to_aos14_i64",
+        "__soa_to_aos15_i8",
+        "__soa_to_aos15_i16",
+        "__soa_to_aos15_i32",
+        "__soa_to_aos15_i64",
+        "__soa_to_aos16_i8",
+        "__soa_to_aos16_i16",
+        "__soa_to_aos16_i32",
+        "__soa_to_aos16_i64",
         "__sqrt_uniform_double",
         "__sqrt_uniform_float",
         "__sqrt_uniform_half",
@@ -833,6 +983,8 @@ static void lSetInternalFunctions(llvm::Module *module) {
         "__stdlib_logf",
         "__stdlib_pow",
         "__stdlib_powf",
+        "__stdlib_scratch_alloc",
+        "__stdlib_scratch_free",
         "__stdlib_sin",
         "__stdlib_asin",
         "__stdlib_sincos",
@@ -894,6 +1046,7 @@ static void lSetInternalFunctions(llvm::Module *module) {
         "__svml_powf",
         "__svml_sqrtf",
         "__svml_invsqrtf",
+        "__task_cancelled",
         "__trunc_uniform_double",
         "__trunc_uniform_float",
         "__trunc_uniform_half",
@@ -972,8 +1125,15 @@ static void lSetInternalFunctions(llvm::Module *module) {
         "__vec4_add_int32",
         "__vselect_float",
         "__vselect_i32",
+        "__worker_scratch",
+        "__workgroup_barrier",
+        "__xe_dpas_bf16",
+        "__xe_dpas_fp16",
+        "__xe_dpas_i8",
         "ISPCAlloc",
         "ISPCLaunch",
+        "ISPCLaunchAfter",
+        "ISPCLaunchWithHints",
         "ISPCSync",
 // ISPC_XE_ENABLED
         "__task_index0",
@@ -996,6 +1156,100 @@ static void lSetInternalFunctions(llvm::Module *module) {
     }
 }
 
+/** Returns true for the builtins, calls to which may be introduced by the
+    optimization passes. Their definitions must be always linked in, even if
+    the module doesn't use them before optimization. */
+static bool lIsPersistentBuiltin(llvm::StringRef name) {
+    const char *prefixes[] = {"__pseudo_", "__masked_", "__gather", "__scatter", "__prefetch_", "__avg_", "__movmsk",
+                              "__muladd_", "__is_compile_time_constant", "__keep_funcs_live", "__spirv_"};
+    for (auto prefix : prefixes) {
+        if (name.startswith(prefix)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ispc::LinkLazyBuiltins(llvm::Module *module, std::vector<std::unique_ptr<llvm::Module>> &libs) {
+    if (libs.empty()) {
+        return;
+    }
+
+    // Drop the unused local functions first (mostly stdlib.ispc ones), so the
+    // builtins referenced only by them are not linked. Every removed function
+    // may make others unused, so iterate until nothing changes.
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto it = module->begin(); it != module->end();) {
+            llvm::Function &f = *it++;
+            f.removeDeadConstantUsers();
+            if (f.hasLocalLinkage() && f.use_empty()) {
+                f.eraseFromParent();
+                changed = true;
+            }
+        }
+    }
+
+    // Linker only pulls in definitions of the functions that are declared in
+    // the destination module, so remove declarations that nothing refers to.
+    for (auto it = module->begin(); it != module->end();) {
+        llvm::Function &f = *it++;
+        if (f.isDeclaration() && f.use_empty() && !f.isIntrinsic() && !lIsPersistentBuiltin(f.getName())) {
+            f.eraseFromParent();
+        }
+    }
+
+    // Libraries are linked in reverse order, as the target library may refer
+    // to the functions from the builtins-c one.
+    for (auto lib = libs.rbegin(); lib != libs.rend(); ++lib) {
+        if (llvm::Linker::linkModules(*module, std::move(*lib), llvm::Linker::Flags::LinkOnlyNeeded)) {
+            Error(SourcePos(), "Error linking stdlib bitcode.");
+        }
+    }
+    libs.clear();
+
+    lSetInternalFunctions(module);
+    lCheckModuleIntrinsics(module);
+}
+
+/** Libraries parsed by PreloadBitcodeLibs(). */
+static std::map<const BitcodeLib *, std::unique_ptr<llvm::Module>> lPreloadedLibs;
+
+static llvm::Expected<std::unique_ptr<llvm::Module>> lParseBitcodeLib(const BitcodeLib *lib, bool lazy) {
+    // Copying of the preloaded library is cheaper than parsing it, but lazy
+    // loading needs a module, which is not materialized yet.
+    auto preloaded = lPreloadedLibs.find(lib);
+    if (!lazy && preloaded != lPreloadedLibs.end() && &preloaded->second->getContext() == g->ctx) {
+        return llvm::CloneModule(*preloaded->second);
+    }
+
+    llvm::StringRef sb = llvm::StringRef((const char *)lib->getLib(), lib->getSize());
+    std::unique_ptr<llvm::MemoryBuffer> bcBuf = llvm::MemoryBuffer::getMemBuffer(sb, "", false);
+
+    // In lazy mode, function bodies are not read until they are materialized
+    // while linking in LinkLazyBuiltins().
+    return lazy ? llvm::getOwningLazyBitcodeModule(std::move(bcBuf), *g->ctx)
+                : llvm::parseBitcodeFile(bcBuf->getMemBufferRef(), *g->ctx);
+}
+
+void ispc::PreloadBitcodeLibs() {
+    const BitcodeLib *libs[] = {
+        g->target_registry->getBuiltinsCLib(g->target_os, g->target->getArch()),
+        g->target_registry->getISPCTargetLib(g->target->getISPCTarget(), g->target_os, g->target->getArch())};
+    for (const BitcodeLib *lib : libs) {
+        if (lib == nullptr || lPreloadedLibs.find(lib) != lPreloadedLibs.end()) {
+            continue;
+        }
+        llvm::Expected<std::unique_ptr<llvm::Module>> ModuleOrErr = lParseBitcodeLib(lib, false);
+        if (!ModuleOrErr) {
+            Error(SourcePos(), "Error parsing stdlib bitcode: %s", toString(ModuleOrErr.takeError()).c_str());
+            continue;
+        }
+        lPreloadedLibs[lib] = std::move(ModuleOrErr.get());
+    }
+}
+
 /** This utility function takes serialized binary LLVM bitcode and adds its
     definitions to the given module.  Functions in the bitcode that can be
     mapped to ispc functions are also added to the symbol table.
@@ -1003,12 +1257,11 @@ static void lSetInternalFunctions(llvm::Module *module) {
     @param lib         Pointer to BitcodeLib class representing LLVM bitcode (e.g. the contents of a *.bc file)
     @param module      Module to link the bitcode into
     @param symbolTable Symbol table to add definitions to
+    @param lazy        Add only declarations and defer linking of the needed
+                       definitions until LinkLazyBuiltins()
  */
-void ispc::AddBitcodeToModule(const BitcodeLib *lib, llvm::Module *module, SymbolTable *symbolTable) {
-    llvm::StringRef sb = llvm::StringRef((const char *)lib->getLib(), lib->getSize());
-    llvm::MemoryBufferRef bcBuf = llvm::MemoryBuffer::getMemBuffer(sb)->getMemBufferRef();
-
-    llvm::Expected<std::unique_ptr<llvm::Module>> ModuleOrErr = llvm::parseBitcodeFile(bcBuf, *g->ctx);
+void ispc::AddBitcodeToModule(const BitcodeLib *lib, llvm::Module *module, SymbolTable *symbolTable, bool lazy) {
+    llvm::Expected<std::unique_ptr<llvm::Module>> ModuleOrErr = lParseBitcodeLib(lib, lazy);
     if (!ModuleOrErr) {
         Error(SourcePos(), "Error parsing stdlib bitcode: %s", toString(ModuleOrErr.takeError()).c_str());
     } else {
@@ -1060,31 +1313,44 @@ void ispc::AddBitcodeToModule(const BitcodeLib *lib, llvm::Module *module, Symbo
             lUpdateIntrinsicsAttributes(bcModule);
         }
 
-        // A hack to move over declaration, which have no definition.
-        // New linker is kind of smart and think it knows better what to do, so
-        // it removes unused declarations without definitions.
-        // This trick should be legal, as both modules use the same LLVMContext.
-        for (llvm::Function &f : *bcModule) {
-            if (f.isDeclaration()) {
-                // Declarations with uses will be moved by Linker.
-                if (f.getNumUses() > 0)
-                    continue;
-                module->getOrInsertFunction(f.getName(), f.getFunctionType(), f.getAttributes());
-            }
-        }
-
         // Remove clang ID metadata from the bitcode module, as we don't need it.
         llvm::NamedMDNode *identMD = bcModule->getNamedMetadata("llvm.ident");
         if (identMD) {
             identMD->eraseFromParent();
         }
 
-        std::unique_ptr<llvm::Module> M(bcModule);
-        if (llvm::Linker::linkModules(*module, std::move(M))) {
-            Error(SourcePos(), "Error linking stdlib bitcode.");
-        }
+        if (lazy) {
+            // Only declare the functions for now, the definitions of those
+            // actually used are linked in later. Local functions can't be
+            // resolved by name, so they are reachable only from other
+            // functions of the library.
+            for (llvm::Function &f : *bcModule) {
+                if (!f.hasLocalLinkage()) {
+                    module->getOrInsertFunction(f.getName(), f.getFunctionType(), f.getAttributes());
+                }
+            }
+            m->lazyBuiltins.push_back(std::unique_ptr<llvm::Module>(bcModule));
+        } else {
+            // A hack to move over declaration, which have no definition.
+            // New linker is kind of smart and think it knows better what to do, so
+            // it removes unused declarations without definitions.
+            // This trick should be legal, as both modules use the same LLVMContext.
+            for (llvm::Function &f : *bcModule) {
+                if (f.isDeclaration()) {
+                    // Declarations with uses will be moved by Linker.
+                    if (f.getNumUses() > 0)
+                        continue;
+                    module->getOrInsertFunction(f.getName(), f.getFunctionType(), f.getAttributes());
+                }
+            }
+
+            std::unique_ptr<llvm::Module> M(bcModule);
+            if (llvm::Linker::linkModules(*module, std::move(M))) {
+                Error(SourcePos(), "Error linking stdlib bitcode.");
+            }
 
-        lSetInternalFunctions(module);
+            lSetInternalFunctions(module);
+        }
 
         if (symbolTable != NULL)
             lAddModuleSymbols(module, symbolTable);
@@ -1207,14 +1473,14 @@ void ispc::DefineStdlib(SymbolTable *symbolTable, llvm::LLVMContext *ctx, llvm::
     // Hence, different version for all potentially supported OSes.
     const BitcodeLib *builtins = g->target_registry->getBuiltinsCLib(g->target_os, g->target->getArch());
     Assert(builtins);
-    AddBitcodeToModule(builtins, module, symbolTable);
+    AddBitcodeToModule(builtins, module, symbolTable, g->lazyBuiltins);
 
     // Next, add the target's custom implementations of the various needed
     // builtin functions (e.g. __masked_store_32(), etc).
     const BitcodeLib *target =
         g->target_registry->getISPCTargetLib(g->target->getISPCTarget(), g->target_os, g->target->getArch());
     Assert(target);
-    AddBitcodeToModule(target, module, symbolTable);
+    AddBitcodeToModule(target, module, symbolTable, g->lazyBuiltins);
 
     // define the 'programCount' builtin variable
     lDefineConstantInt("programCount", g->target->getVectorWidth(), module, symbolTable, debug_symbols);
@@ -1244,13 +1510,20 @@ void ispc::DefineStdlib(SymbolTable *symbolTable, llvm::LLVMContext *ctx, llvm::
     lDefineConstantInt("__have_saturating_arithmetic", g->target->hasSatArith(), module, symbolTable, debug_symbols);
 #ifdef ISPC_XE_ENABLED
     lDefineConstantInt("__have_xe_prefetch", g->target->hasXePrefetch(), module, symbolTable, debug_symbols);
+    lDefineConstantInt("__have_xe_dpas", g->target->hasXeDPAS(), module, symbolTable, debug_symbols);
 #else
     lDefineConstantInt("__have_xe_prefetch", false, module, symbolTable, debug_symbols);
+    lDefineConstantInt("__have_xe_dpas", false, module, symbolTable, debug_symbols);
 #endif
     lDefineConstantInt("__is_xe_target", (int)(g->target->isXeTarget()), module, symbolTable, debug_symbols);
 
     if (g->forceAlignment != -1) {
         llvm::GlobalVariable *alignment = module->getGlobalVariable("memory_alignment", true);
+        // With lazy builtins, the variable is still in the builtins library.
+        for (auto lib = m->lazyBuiltins.begin(); alignment == NULL && lib != m->lazyBuiltins.end(); ++lib) {
+            alignment = (*lib)->getGlobalVariable("memory_alignment", true);
+        }
+        Assert(alignment != NULL);
         alignment->setInitializer(LLVMInt32(g->forceAlignment));
     }
 
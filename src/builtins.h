@@ -55,7 +55,35 @@ namespace ispc {
  */
 void DefineStdlib(SymbolTable *symbolTable, llvm::LLVMContext *ctx, llvm::Module *module, bool includeStdlib);
 
-void AddBitcodeToModule(const BitcodeLib *lib, llvm::Module *module, SymbolTable *symbolTable = NULL);
+/** Adds definitions from the given bitcode library to the module.
+
+    @param lib             Bitcode library to add
+    @param module          Module to link the bitcode into
+    @param symbolTable     SymbolTable in which to add symbol definitions
+                           for functions of the library
+    @param lazy            If true, only declarations are added to the module
+                           and the library is kept in Module::lazyBuiltins
+                           until LinkLazyBuiltins() is called
+ */
+void AddBitcodeToModule(const BitcodeLib *lib, llvm::Module *module, SymbolTable *symbolTable = NULL,
+                        bool lazy = false);
+
+/** Links in the definitions from lazily loaded builtins libraries, which
+    are needed for the given module.  Must be called after the module IR is
+    generated, but before it is optimized.
+
+    @param module          Module to link the bitcode into
+    @param libs            Lazily loaded libraries, consumed by the call
+ */
+void LinkLazyBuiltins(llvm::Module *module, std::vector<std::unique_ptr<llvm::Module>> &libs);
+
+/** Parses the builtins libraries needed for the current target into the
+    global LLVMContext and keeps them resident.  AddBitcodeToModule() then
+    copies the parsed libraries instead of parsing them again, as long as
+    the module uses the same context.  This is used by the compile server
+    (--server), where all compilations share the context of the server.
+ */
+void PreloadBitcodeLibs();
 
 /** Create ISPC symbol for LLVM intrinsics and add it to the given module.
 
@@ -50,6 +50,9 @@
 #include <llvm/BinaryFormat/Dwarf.h>
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/Instructions.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/IntrinsicsX86.h>
+#include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Metadata.h>
 #include <llvm/IR/Module.h>
 
@@ -292,8 +295,14 @@ FunctionEmitContext::FunctionEmitContext(Function *func, Symbol *funSym, llvm::F
     launchedTasks = false;
     launchGroupHandleAddressInfo = AllocaInst(LLVMTypes::VoidPointerType, "launch_group_handle");
     StoreInst(llvm::Constant::getNullValue(LLVMTypes::VoidPointerType), launchGroupHandleAddressInfo);
+    launchCounterAddressInfo = AllocaInst(LLVMTypes::Int64Type, "launch_counter");
+    StoreInst(LLVMInt64(0), launchCounterAddressInfo);
+    syncedLaunchesAddressInfo = AllocaInst(LLVMTypes::Int64Type, "synced_launches");
+    StoreInst(LLVMInt64(0), syncedLaunchesAddressInfo);
 
     disableGSWarningCount = 0;
+    nontemporalStores = false;
+    sharedLocalMemorySize = 0;
 
     const Type *returnType = function->GetReturnType();
     if (!returnType || returnType->IsVoidType())
@@ -347,7 +356,7 @@ FunctionEmitContext::FunctionEmitContext(Function *func, Symbol *funSym, llvm::F
                                          LLVMMaskAllOn, "__all_on_mask");
 
             char buf[256];
-            snprintf(buf, sizeof(buf), "__off_all_on_mask_%s", g->target->GetISAString());
+            snprintf(buf, sizeof(buf), "__off_all_on_mask_%s", g->target->GetVariantString().c_str());
 
             llvm::FunctionCallee offFuncCallee = m->module->getOrInsertFunction(buf, LLVMTypes::VoidType);
             llvm::Constant *offFunc = llvm::cast<llvm::Constant>(offFuncCallee.getCallee());
@@ -366,14 +375,17 @@ FunctionEmitContext::FunctionEmitContext(Function *func, Symbol *funSym, llvm::F
     }
 
     // If reset of FTZ/DAZ flags is requested and we're inside external function,
-    // allocate memory for keeping the old FTZ/DAZ value
-    if ((g->opt.resetFTZ_DAZ) &&
-        (func->GetType()->isExported || func->GetType()->isExternC || func->GetType()->isExternSYCL ||
-         func->GetType()->IsISPCKernel()) &&
-        // The condition below checks that the function doesn't have additional `__mask` parameter.
-        // If it has `__mask`, it's an internal version of export function and we don't need to set
-        // FTZ/DAZ flags there.
-        (lf->getFunctionType()->getNumParams() == func->GetType()->GetNumParameters())) {
+    // allocate memory for keeping the old FTZ/DAZ value.  Denormals are also
+    // flushed in CPU tasks, which run on the threads of the tasking system.
+    const FunctionType *funcType = func->GetType();
+    bool isEntry = (funcType->isExported || funcType->isExternC || funcType->isExternSYCL ||
+                    funcType->IsISPCKernel()) &&
+                   // The condition below checks that the function doesn't have additional `__mask` parameter.
+                   // If it has `__mask`, it's an internal version of export function and we don't need to set
+                   // FTZ/DAZ flags there.
+                   (lf->getFunctionType()->getNumParams() == funcType->GetNumParameters());
+    bool isCPUTask = funcType->isTask && !g->target->isXeTarget();
+    if ((g->opt.resetFTZ_DAZ && isEntry) || (funcType->FlushesDenormals() && (isEntry || isCPUTask))) {
         // On ARM the size of register with FTZ/DAZ flags is platform dependent,
         // on other platforms it's always i32.
         functionFTZ_DAZValue = AllocaInst(
@@ -383,6 +395,12 @@ FunctionEmitContext::FunctionEmitContext(Function *func, Symbol *funSym, llvm::F
         functionFTZ_DAZValue = NULL;
     }
 
+    // Likewise, only the versions of exported functions that the application calls read performance counters.
+    functionPerfCounters = g->emitPerfCounters && !g->target->isXeTarget() &&
+                           (func->GetType()->isExported || func->GetType()->isExternC) &&
+                           (lf->getFunctionType()->getNumParams() == func->GetType()->GetNumParameters());
+    functionPerfCountersName = NULL;
+
     if (m->diBuilder) {
         currentPos = funSym->pos;
 
@@ -396,7 +414,10 @@ FunctionEmitContext::FunctionEmitContext(Function *func, Symbol *funSym, llvm::F
         const FunctionType *functionType = function->GetType();
         if (functionType == NULL)
             AssertPos(currentPos, m->errorCount > 0);
-        else {
+        else if (g->debugLineTablesOnly) {
+            // Line tables don't describe the types of the parameters.
+            diSubprogramType = m->diBuilder->createSubroutineType(m->diBuilder->getOrCreateTypeArray({}));
+        } else {
             diSubprogramType = functionType->GetDIType(scope);
             /*#if ISPC_LLVM_VERSION <= ISPC_LLVM_3_6 // 3.2, 3.3, 3.4, 3.5, 3.6
                         AssertPos(currentPos, diSubprogramType.Verify());
@@ -1242,6 +1263,18 @@ void FunctionEmitContext::DisableGatherScatterWarnings() { ++disableGSWarningCou
 
 void FunctionEmitContext::EnableGatherScatterWarnings() { --disableGSWarningCount; }
 
+void FunctionEmitContext::NontemporalStoreFence() {
+    if (bblock == NULL)
+        return;
+
+    if (g->target->getArch() == Arch::x86 || g->target->getArch() == Arch::x86_64) {
+        // sfence is sufficient to order streaming stores on x86.
+        llvm::Function *sfence = llvm::Intrinsic::getDeclaration(m->module, llvm::Intrinsic::x86_sse_sfence);
+        llvm::CallInst::Create(sfence, "", bblock);
+    } else
+        new llvm::FenceInst(*g->ctx, llvm::AtomicOrdering::SequentiallyConsistent, llvm::SyncScope::System, bblock);
+}
+
 bool FunctionEmitContext::initLabelBBlocks(ASTNode *node, void *data) {
     LabeledStmt *ls = llvm::dyn_cast<LabeledStmt>(node);
     if (ls == NULL)
@@ -1365,6 +1398,9 @@ void FunctionEmitContext::SetFunctionFTZ_DAZFlags() {
     std::vector<llvm::Value *> args;
     llvm::Value *oldFTZ = CallInst(fmm, NULL, args, "");
     StoreInst(oldFTZ, functionFTZ_DAZValue);
+    // Module::CompileFile() turns this into the denormal-fp-math attributes
+    // once the module is optimized.
+    llvmFunction->addFnAttr("ispc-flush-denormals");
 }
 
 void FunctionEmitContext::RestoreFunctionFTZ_DAZFlags() {
@@ -1554,6 +1590,27 @@ void FunctionEmitContext::AddInstrumentationPoint(const char *note) {
     CallInst(finst, NULL, args, "");
 }
 
+void FunctionEmitContext::BeginFunctionPerfCounters() {
+    if (!functionPerfCounters)
+        return;
+    functionPerfCountersName = lGetStringAsValue(bblock, llvmFunction->getName().str().c_str());
+    llvm::FunctionCallee begin =
+        m->module->getOrInsertFunction("ISPCPerfCountersBegin", LLVMTypes::VoidType, LLVMTypes::VoidPointerType);
+    std::vector<llvm::Value *> args;
+    args.push_back(functionPerfCountersName);
+    CallInst(begin.getCallee(), NULL, args, "");
+}
+
+void FunctionEmitContext::EndFunctionPerfCounters() {
+    if (functionPerfCountersName == NULL)
+        return;
+    llvm::FunctionCallee end =
+        m->module->getOrInsertFunction("ISPCPerfCountersEnd", LLVMTypes::VoidType, LLVMTypes::VoidPointerType);
+    std::vector<llvm::Value *> args;
+    args.push_back(functionPerfCountersName);
+    CallInst(end.getCallee(), NULL, args, "");
+}
+
 void FunctionEmitContext::SetDebugPos(SourcePos pos) { currentPos = pos; }
 
 SourcePos FunctionEmitContext::GetDebugPos() const { return currentPos; }
@@ -1603,7 +1660,7 @@ llvm::DIScope *FunctionEmitContext::GetDIScope() const {
 }
 
 void FunctionEmitContext::EmitVariableDebugInfo(Symbol *sym) {
-    if (m->diBuilder == NULL)
+    if (m->diBuilder == NULL || g->debugLineTablesOnly)
         return;
 
     llvm::DIScope *scope = GetDIScope();
@@ -1619,7 +1676,7 @@ void FunctionEmitContext::EmitVariableDebugInfo(Symbol *sym) {
 }
 
 void FunctionEmitContext::EmitFunctionParameterDebugInfo(Symbol *sym, int argNum) {
-    if (m->diBuilder == NULL)
+    if (m->diBuilder == NULL || g->debugLineTablesOnly)
         return;
 
     llvm::DINode::DIFlags flags = llvm::DINode::FlagZero;
@@ -1636,6 +1693,108 @@ void FunctionEmitContext::EmitFunctionParameterDebugInfo(Symbol *sym, int argNum
     AddDebugPos(declareInst, &sym->pos, scope);
 }
 
+/** Returns the index of the restrict parameter that the given address is
+    computed from, or -1 if it isn't computed from exactly one of them.
+    The parameters are identified by the allocas they are stored in. */
+static int lRestrictBase(llvm::Value *v, const std::map<llvm::Value *, int> &allocas, int depth = 0) {
+    if (depth > 16)
+        return -1;
+
+    if (llvm::LoadInst *load = llvm::dyn_cast<llvm::LoadInst>(v)) {
+        auto iter = allocas.find(load->getPointerOperand());
+        return (iter != allocas.end()) ? iter->second : -1;
+    }
+    if (llvm::GetElementPtrInst *gep = llvm::dyn_cast<llvm::GetElementPtrInst>(v))
+        return lRestrictBase(gep->getPointerOperand(), allocas, depth + 1);
+    if (llvm::CastInst *cast = llvm::dyn_cast<llvm::CastInst>(v))
+        return lRestrictBase(cast->getOperand(0), allocas, depth + 1);
+    if (llvm::BinaryOperator *bop = llvm::dyn_cast<llvm::BinaryOperator>(v)) {
+        // Only an offset may be added to or subtracted from the address.
+        int base0 = lRestrictBase(bop->getOperand(0), allocas, depth + 1);
+        int base1 = lRestrictBase(bop->getOperand(1), allocas, depth + 1);
+        if (bop->getOpcode() == llvm::Instruction::Add)
+            return (base0 == -1) ? base1 : ((base1 == -1) ? base0 : -1);
+        if (bop->getOpcode() == llvm::Instruction::Sub)
+            return (base1 == -1) ? base0 : -1;
+        return -1;
+    }
+    if (llvm::InsertElementInst *ie = llvm::dyn_cast<llvm::InsertElementInst>(v)) {
+        int base = lRestrictBase(ie->getOperand(1), allocas, depth + 1);
+        if (llvm::isa<llvm::Constant>(ie->getOperand(0)))
+            return base;
+        return (lRestrictBase(ie->getOperand(0), allocas, depth + 1) == base) ? base : -1;
+    }
+    if (llvm::ShuffleVectorInst *shuffle = llvm::dyn_cast<llvm::ShuffleVectorInst>(v)) {
+        int base = lRestrictBase(shuffle->getOperand(0), allocas, depth + 1);
+        if (llvm::isa<llvm::Constant>(shuffle->getOperand(1)))
+            return base;
+        return (lRestrictBase(shuffle->getOperand(1), allocas, depth + 1) == base) ? base : -1;
+    }
+    if (llvm::SelectInst *select = llvm::dyn_cast<llvm::SelectInst>(v)) {
+        int base = lRestrictBase(select->getTrueValue(), allocas, depth + 1);
+        return (lRestrictBase(select->getFalseValue(), allocas, depth + 1) == base) ? base : -1;
+    }
+    return -1;
+}
+
+void FunctionEmitContext::AddRestrictAliasScopes(const std::vector<Symbol *> &params) {
+    // Only the parameters whose storage is written once, with the value
+    // of the parameter, and otherwise only loaded from are considered, so
+    // that every load of their storage gives the original pointer.
+    llvm::MDBuilder mdBuilder(*g->ctx);
+    llvm::MDNode *domain = mdBuilder.createAnonymousAliasScopeDomain(llvmFunction->getName());
+    std::map<llvm::Value *, int> allocas;
+    std::vector<llvm::MDNode *> scopes;
+    for (Symbol *sym : params) {
+        if (sym->storageInfo == NULL)
+            continue;
+        llvm::Value *storage = sym->storageInfo->getPointer();
+        int numStores = 0;
+        bool onlyLoaded = true;
+        for (llvm::User *user : storage->users()) {
+            if (llvm::StoreInst *store = llvm::dyn_cast<llvm::StoreInst>(user))
+                onlyLoaded &= (store->getPointerOperand() == storage && ++numStores == 1);
+            else
+                onlyLoaded &= llvm::isa<llvm::LoadInst>(user);
+        }
+        if (onlyLoaded && numStores == 1) {
+            allocas.insert(std::make_pair(storage, (int)scopes.size()));
+            scopes.push_back(mdBuilder.createAnonymousAliasScope(domain, sym->name));
+        }
+    }
+    if (scopes.size() < 2)
+        return;
+
+    for (llvm::BasicBlock &bb : *llvmFunction) {
+        for (llvm::Instruction &inst : bb) {
+            llvm::Value *address = NULL;
+            if (llvm::LoadInst *load = llvm::dyn_cast<llvm::LoadInst>(&inst))
+                address = load->getPointerOperand();
+            else if (llvm::StoreInst *store = llvm::dyn_cast<llvm::StoreInst>(&inst))
+                address = store->getPointerOperand();
+            else if (llvm::CallInst *call = llvm::dyn_cast<llvm::CallInst>(&inst)) {
+                // The address is the first operand of the pseudo memory
+                // operations that the optimization passes later lower.
+                llvm::Function *callee = call->getCalledFunction();
+                if (callee != NULL && callee->getName().startswith("__pseudo_") && call->arg_size() > 0)
+                    address = call->getArgOperand(0);
+            }
+            if (address == NULL || allocas.find(address) != allocas.end())
+                continue;
+
+            int base = lRestrictBase(address, allocas);
+            if (base == -1)
+                continue;
+            llvm::SmallVector<llvm::Metadata *, 8> others;
+            for (unsigned int i = 0; i < scopes.size(); ++i)
+                if ((int)i != base)
+                    others.push_back(scopes[i]);
+            inst.setMetadata(llvm::LLVMContext::MD_alias_scope, llvm::MDNode::get(*g->ctx, scopes[base]));
+            inst.setMetadata(llvm::LLVMContext::MD_noalias, llvm::MDNode::get(*g->ctx, others));
+        }
+    }
+}
+
 /** If the given type is an array of vector types, then it's the
     representation of an ispc VectorType with varying elements.  If it is
     one of these, return the array size (i.e. the VectorType's size).
@@ -2663,6 +2822,16 @@ void FunctionEmitContext::addGSMetadata(llvm::Value *v, SourcePos pos) {
     inst->setMetadata("last_column", md);
 }
 
+void FunctionEmitContext::addNontemporalMetadata(llvm::Value *v) {
+    llvm::Instruction *inst = llvm::dyn_cast<llvm::Instruction>(v);
+    // ImproveMemoryOps turns this into !nontemporal when the store ends up
+    // as a regular full-vector store.
+    if (inst != NULL) {
+        llvm::MDNode *N = llvm::MDNode::get(*g->ctx, llvm::MDString::get(*g->ctx, "ISPC-Nontemporal"));
+        inst->setMetadata("ISPC-Nontemporal", N);
+    }
+}
+
 llvm::Value *FunctionEmitContext::AddrSpaceCastInst(llvm::Value *val, AddressSpace as, bool atEntryBlock) {
     Assert(llvm::isa<llvm::PointerType>(val->getType()));
     llvm::PointerType *pt = llvm::dyn_cast<llvm::PointerType>(val->getType());
@@ -2888,7 +3057,10 @@ void FunctionEmitContext::maskedStore(llvm::Value *value, llvm::Value *ptr, cons
     args.push_back(value);
     args.push_back(mask);
 
-    CallInst(maskedStoreFunc, NULL, args);
+    llvm::Value *inst = CallInst(maskedStoreFunc, NULL, args);
+
+    if (nontemporalStores)
+        addNontemporalMetadata(inst);
 }
 
 /** Scatter the given varying value to the locations given by the varying
@@ -3007,6 +3179,8 @@ void FunctionEmitContext::scatter(llvm::Value *value, llvm::Value *ptr, const Ty
 
     if (disableGSWarningCount == 0)
         addGSMetadata(inst, currentPos);
+    if (nontemporalStores)
+        addNontemporalMetadata(inst);
 }
 
 void FunctionEmitContext::StoreInst(llvm::Value *value, AddressInfo *ptrInfo, const Type *ptrType) {
@@ -3064,9 +3238,11 @@ void FunctionEmitContext::StoreInst(llvm::Value *value, llvm::Value *ptr, llvm::
         else if (ptrType->GetBaseType()->IsUniformType())
             // the easy case
             StoreInst(value, ptrInfo, valueType);
-        else if (mask == LLVMMaskAllOn && !g->opt.disableMaskAllOnOptimizations)
+        else if (mask == LLVMMaskAllOn && !g->opt.disableMaskAllOnOptimizations && !nontemporalStores)
             // Otherwise it is a masked store unless we can determine that the
             // mask is all on...  (Unclear if this check is actually useful.)
+            // Non-temporal stores are left to ImproveMemoryOps, which turns
+            // all-on masked stores into regular ones.
             StoreInst(value, ptrInfo, valueType);
         else {
             maskedStore(value, ptr, ptrType, mask);
@@ -3628,6 +3804,7 @@ llvm::Instruction *FunctionEmitContext::ReturnInst() {
     if (functionFTZ_DAZValue != NULL) {
         RestoreFunctionFTZ_DAZFlags();
     }
+    EndFunctionPerfCounters();
     llvm::Instruction *rinst = NULL;
     if (returnValueAddressInfo != NULL) {
         // We have value(s) to return; load them from their storage
@@ -3645,17 +3822,30 @@ llvm::Instruction *FunctionEmitContext::ReturnInst() {
 }
 
 llvm::Value *FunctionEmitContext::LaunchInst(llvm::Value *callee, std::vector<llvm::Value *> &argVals,
-                                             llvm::Value *launchCount[3], const FunctionType *funcType) {
-    if (g->target->isXeTarget()) {
-        Error(currentPos, "\"launch\" keyword is not supported for Xe targets");
-        return NULL;
-    }
-
+                                             llvm::Value *launchCount[3], const FunctionType *funcType,
+                                             const std::vector<llvm::Value *> &afterVals, const LaunchHints *hints) {
     if (callee == NULL) {
         AssertPos(currentPos, m->errorCount > 0);
         return NULL;
     }
 
+    if (g->target->isXeTarget()) {
+        llvm::Function *task = llvm::dyn_cast<llvm::Function>(callee);
+        if (task == NULL) {
+            Error(currentPos, "Must provide function name to \"task\"-qualified function for \"launch\" "
+                              "expression on Xe targets");
+            return NULL;
+        }
+        // The tasks have finished once the launch returns, so there is
+        // nothing to wait for in "sync" or in the tasks launched after them.
+        xeLaunch(task, argVals, launchCount, funcType);
+        llvm::Value *handle = LoadInst(launchCounterAddressInfo, NULL, "launch_handle");
+        StoreInst(BinaryOperator(llvm::Instruction::Add, handle, LLVMInt64(1), "launch_counter"),
+                  launchCounterAddressInfo);
+        StoreInst(LoadInst(launchCounterAddressInfo, NULL, "launch_counter"), syncedLaunchesAddressInfo);
+        return handle;
+    }
+
     if (!(llvm::isa<llvm::Function>(callee) || llvm::isa<llvm::PointerType>(callee->getType()))) {
         Error(currentPos, "Must provide function name or uniform function pointer to \"task\"-qualified function for "
                           "\"launch\" expression");
@@ -3712,8 +3902,6 @@ llvm::Value *FunctionEmitContext::LaunchInst(llvm::Value *callee, std::vector<ll
     // a pointer to the task function being called and a pointer to the
     // argument block we just filled in
     llvm::Value *fptr = BitCastInst(callee, LLVMTypes::VoidPointerType);
-    llvm::Function *flaunch = m->module->getFunction("ISPCLaunch");
-    AssertPos(currentPos, flaunch != NULL);
     std::vector<llvm::Value *> args;
     args.push_back(launchGroupHandleAddressInfo->getPointer());
     args.push_back(fptr);
@@ -3721,12 +3909,103 @@ llvm::Value *FunctionEmitContext::LaunchInst(llvm::Value *callee, std::vector<ll
     args.push_back(launchCount[0]);
     args.push_back(launchCount[1]);
     args.push_back(launchCount[2]);
-    return CallInst(flaunch, NULL, args, "");
+    if (afterVals.empty() && hints == NULL) {
+        llvm::Function *flaunch = m->module->getFunction("ISPCLaunch");
+        AssertPos(currentPos, flaunch != NULL);
+        CallInst(flaunch, NULL, args, "");
+    } else if (afterVals.empty()) {
+        args.push_back(llvm::Constant::getNullValue(LLVMTypes::Int64PointerType));
+        args.push_back(LLVMInt32(0));
+    } else {
+        // The task system numbers the launches of a task group from zero,
+        // so pass the handles relative to the launches at the last sync,
+        // and -1 for launches from before it, which have finished.
+        llvm::ArrayType *afterArrayType = llvm::ArrayType::get(LLVMTypes::Int64Type, afterVals.size());
+        AddressInfo *afterArray = AllocaInst(afterArrayType, "launch_after");
+        llvm::Value *synced = LoadInst(syncedLaunchesAddressInfo, NULL, "synced_launches");
+        for (unsigned int i = 0; i < afterVals.size(); ++i) {
+            llvm::Value *index = BinaryOperator(llvm::Instruction::Sub, afterVals[i], synced, "after_index");
+            llvm::Value *finished =
+                CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SLT, index, LLVMInt64(0), "after_finished");
+            index = SelectInst(finished, LLVMInt64(-1), index, "after_index");
+            llvm::Value *ptr = AddElementOffset(afterArray, i, "after_ptr");
+            StoreInst(index, new AddressInfo(ptr, LLVMTypes::Int64Type));
+        }
+        args.push_back(AddElementOffset(afterArray, 0, "after_ptr"));
+        args.push_back(LLVMInt32((int32_t)afterVals.size()));
+        if (hints == NULL) {
+            llvm::Function *flaunch = m->module->getFunction("ISPCLaunchAfter");
+            AssertPos(currentPos, flaunch != NULL);
+            CallInst(flaunch, NULL, args, "");
+        }
+    }
+    if (hints != NULL) {
+        // The after clause, if any, and the scheduling hints go to the same
+        // entry point of the task system.
+        args.push_back(LLVMInt32(hints->grain));
+        args.push_back(LLVMInt32(hints->affinity));
+        args.push_back(LLVMInt32(hints->priority));
+        llvm::Function *flaunch = m->module->getFunction("ISPCLaunchWithHints");
+        AssertPos(currentPos, flaunch != NULL);
+        CallInst(flaunch, NULL, args, "");
+    }
+
+    // The handle of the launch is its number among the launches of the
+    // function.
+    llvm::Value *handle = LoadInst(launchCounterAddressInfo, NULL, "launch_handle");
+    StoreInst(BinaryOperator(llvm::Instruction::Add, handle, LLVMInt64(1), "launch_counter"),
+              launchCounterAddressInfo);
+    return handle;
+}
+
+/** Run the tasks launched from Xe code in the current thread.  The
+    launched version of the task (see GetXeLaunchedTaskFunction()) is called
+    for each task index, in loops over the dimensions of the launch with the
+    first one innermost.
+ */
+void FunctionEmitContext::xeLaunch(llvm::Function *task, std::vector<llvm::Value *> &argVals,
+                                   llvm::Value *launchCount[3], const FunctionType *funcType) {
+    llvm::Function *launched = GetXeLaunchedTaskFunction(task, funcType);
+    llvm::BasicBlock *bDone = CreateBasicBlock("launch_done");
+    AddressInfo *indexInfo[3];
+    llvm::BasicBlock *bTest[3], *bStep[3];
+    for (int d = 2; d >= 0; --d) {
+        // The index of the inner dimensions starts over in the body of the outer one.
+        indexInfo[d] = AllocaInst(LLVMTypes::Int32Type, "launch_index");
+        StoreInst(LLVMInt32(0), indexInfo[d]);
+        bTest[d] = CreateBasicBlock("launch_test");
+        llvm::BasicBlock *bBody = CreateBasicBlock("launch_body");
+        bStep[d] = CreateBasicBlock("launch_step");
+        BranchInst(bTest[d]);
+
+        SetCurrentBasicBlock(bTest[d]);
+        llvm::Value *index = LoadInst(indexInfo[d], NULL, "launch_index");
+        llvm::Value *more =
+            CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SLT, index, launchCount[d], "launch_more");
+        BranchInst(bBody, d == 2 ? bDone : bStep[d + 1], more);
+        SetCurrentBasicBlock(bBody);
+    }
+
+    std::vector<llvm::Value *> args = argVals;
+    for (int d = 0; d < 3; ++d)
+        args.push_back(LoadInst(indexInfo[d], NULL, "launch_index"));
+    for (int d = 0; d < 3; ++d)
+        args.push_back(launchCount[d]);
+    CallInst(launched, NULL, args, "");
+    BranchInst(bStep[0]);
+
+    for (int d = 0; d < 3; ++d) {
+        SetCurrentBasicBlock(bStep[d]);
+        llvm::Value *index = LoadInst(indexInfo[d], NULL, "launch_index");
+        StoreInst(BinaryOperator(llvm::Instruction::Add, index, LLVMInt32(1), "launch_index"), indexInfo[d]);
+        BranchInst(bTest[d]);
+    }
+    SetCurrentBasicBlock(bDone);
 }
 
 void FunctionEmitContext::SyncInst() {
     if (g->target->isXeTarget()) {
-        Error(currentPos, "\"sync\" keyword is not supported for Xe targets");
+        // The tasks launched from Xe code have finished already.
         return;
     }
 
@@ -3746,6 +4025,7 @@ void FunctionEmitContext::SyncInst() {
     // zero out the handle so that if ISPCLaunch is called again in this
     // function, it knows it's starting out from scratch
     StoreInst(nullPtrValue, launchGroupHandleAddressInfo);
+    StoreInst(LoadInst(launchCounterAddressInfo, NULL, "launch_counter"), syncedLaunchesAddressInfo);
 
     BranchInst(bPostSync);
 
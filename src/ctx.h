@@ -50,6 +50,7 @@
 namespace ispc {
 
 struct CFInfo;
+struct LaunchHints;
 
 ///////////////////////////////////////////////////////////////////////////
 /** AddressInfo is a helper class to work with pointers.
@@ -280,6 +281,20 @@ class FunctionEmitContext {
     /** Reenables emission of gather/scatter performance warnings. */
     void EnableGatherScatterWarnings();
 
+    /** Controls whether subsequent varying stores are marked as candidates
+        for non-temporal (streaming) stores; see '#pragma nontemporal'. */
+    void SetNontemporalStores(bool nt) { nontemporalStores = nt; }
+    bool GetNontemporalStores() const { return nontemporalStores; }
+
+    /** Emits a fence that orders preceding non-temporal stores before any
+        subsequent memory accesses. */
+    void NontemporalStoreFence();
+
+    /** Accounts for a 'shared' variable of the given size in bytes that
+        the function keeps in the workgroup's shared local memory. */
+    void AddSharedLocalMemory(uint64_t size) { sharedLocalMemorySize += size; }
+    uint64_t GetSharedLocalMemorySize() const { return sharedLocalMemorySize; }
+
     void SetContinueTarget(llvm::BasicBlock *bb) { continueTarget = bb; }
 
     /** Step through the code and find label statements; create a basic
@@ -312,6 +327,14 @@ class FunctionEmitContext {
     /** Restores FTZ/DAZ flags saved on function entry */
     void RestoreFunctionFTZ_DAZFlags();
 
+    /** If exported functions are compiled to read performance counters,
+        calls ISPCPerfCountersBegin() with the name of the function */
+    void BeginFunctionPerfCounters();
+
+    /** Calls ISPCPerfCountersEnd() if BeginFunctionPerfCounters() called
+        ISPCPerfCountersBegin() on function entry */
+    void EndFunctionPerfCounters();
+
     /** @} */
 
     /** @name Small helper/utility routines
@@ -404,6 +427,12 @@ class FunctionEmitContext {
     void EmitFunctionParameterDebugInfo(Symbol *sym, int parameterNum);
     /** @} */
 
+    /** Gives each of the given "restrict" pointer parameters its own alias
+        scope and tags the memory accesses through them so that LLVM knows
+        that the accesses through different parameters don't alias.  This
+        must be called once the code of the function has been emitted. */
+    void AddRestrictAliasScopes(const std::vector<Symbol *> &params);
+
     /** @name IR instruction emission
         @brief These methods generally closely correspond to LLVM IR
         instructions.  See the LLVM assembly language reference manual
@@ -601,9 +630,16 @@ class FunctionEmitContext {
                           const llvm::Twine &name = "");
 
     /** Launch an asynchronous task to run the given function, passing it
-        he given argument values. */
+        he given argument values.  If launch handles are given in
+        afterVals, the tasks don't start before the corresponding launches
+        have finished.  With scheduling hints, ISPCLaunchWithHints() is
+        called instead of ISPCLaunch().  Returns the handle of the new
+        launch.  On Xe, the tasks are run one after another by the current
+        thread, and the scheduling hints and after clauses have no effect. */
     llvm::Value *LaunchInst(llvm::Value *callee, std::vector<llvm::Value *> &argVals, llvm::Value *launchCount[3],
-                            const FunctionType *funcType);
+                            const FunctionType *funcType,
+                            const std::vector<llvm::Value *> &afterVals = std::vector<llvm::Value *>(),
+                            const LaunchHints *hints = NULL);
 
     void SyncInst();
 
@@ -698,6 +734,11 @@ class FunctionEmitContext {
     /** Value of the ftz/daz flags when the function starts execution.  */
     AddressInfo *functionFTZ_DAZValue;
 
+    /** Whether the function reads performance counters on entry and exit,
+        and the name of the function it passes to the runtime. */
+    bool functionPerfCounters;
+    llvm::Value *functionPerfCountersName;
+
     /** Current source file position; if debugging information is being
         generated, this position is used to set file/line information for
         instructions. */
@@ -815,18 +856,34 @@ class FunctionEmitContext {
         tasks launched from the current function. */
     AddressInfo *launchGroupHandleAddressInfo;
 
+    /** The number of launches emitted by the function so far, which is the
+        handle of the next launch, and its value at the last sync.  Handles
+        below the latter are for launches that have finished. */
+    AddressInfo *launchCounterAddressInfo;
+    AddressInfo *syncedLaunchesAddressInfo;
+
     /** Nesting count of the number of times calling code has disabled (and
         not yet reenabled) gather/scatter performance warnings. */
     int disableGSWarningCount;
 
+    /** True if varying stores should be marked as non-temporal. */
+    bool nontemporalStores;
+
+    /** Total size of the function's 'shared' variables in shared local
+        memory, in bytes. */
+    uint64_t sharedLocalMemorySize;
+
     std::map<std::string, llvm::BasicBlock *> labelMap;
 
     static bool initLabelBBlocks(ASTNode *node, void *data);
 
     llvm::Value *pointerVectorToVoidPointers(llvm::Value *value);
     static void addGSMetadata(llvm::Value *inst, SourcePos pos);
+    static void addNontemporalMetadata(llvm::Value *inst);
     bool ifsInCFAllUniform(int cfType) const;
     void jumpIfAllLoopLanesAreDone(llvm::BasicBlock *target);
+    void xeLaunch(llvm::Function *task, std::vector<llvm::Value *> &argVals, llvm::Value *launchCount[3],
+                  const FunctionType *funcType);
     llvm::Value *emitGatherCallback(llvm::Value *lvalue, llvm::Value *retPtr);
 
     llvm::Value *applyVaryingGEP(llvm::Value *basePtr, llvm::Value *index, const Type *ptrType);
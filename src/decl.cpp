@@ -45,6 +45,7 @@
 #include "util.h"
 
 #include <set>
+#include <sstream>
 #include <stdio.h>
 #include <string.h>
 
@@ -55,6 +56,8 @@ static void lPrintTypeQualifiers(int typeQualifiers) {
         printf("inline ");
     if (typeQualifiers & TYPEQUAL_CONST)
         printf("const ");
+    if (typeQualifiers & TYPEQUAL_RESTRICT)
+        printf("restrict ");
     if (typeQualifiers & TYPEQUAL_UNIFORM)
         printf("uniform ");
     if (typeQualifiers & TYPEQUAL_VARYING)
@@ -82,6 +85,14 @@ static const Type *lApplyTypeQualifiers(int typeQualifiers, const Type *type, So
         type = type->GetAsConstType();
     }
 
+    if ((typeQualifiers & TYPEQUAL_RESTRICT) != 0) {
+        const PointerType *ptrType = CastType<PointerType>(type);
+        if (ptrType != NULL)
+            type = ptrType->GetAsRestrictType();
+        else
+            Error(pos, "\"restrict\" qualifier is illegal with non-pointer type \"%s\".", type->GetString().c_str());
+    }
+
     if (((typeQualifiers & TYPEQUAL_UNIFORM) != 0) && ((typeQualifiers & TYPEQUAL_VARYING) != 0)) {
         Error(pos, "Type \"%s\" cannot be qualified with both uniform and varying.", type->GetString().c_str());
     }
@@ -224,6 +235,8 @@ static const char *lGetStorageClassName(StorageClass storageClass) {
         return "static";
     case SC_TYPEDEF:
         return "typedef";
+    case SC_SHARED:
+        return "shared";
     default:
         FATAL("Unhandled storage class in lGetStorageClassName");
         return "";
@@ -351,6 +364,7 @@ void Declarator::InitFromType(const Type *baseType, DeclSpecs *ds) {
     bool isExported = ((typeQualifiers & TYPEQUAL_EXPORT) != 0);
     bool isConst = ((typeQualifiers & TYPEQUAL_CONST) != 0);
     bool isUnmasked = ((typeQualifiers & TYPEQUAL_UNMASKED) != 0);
+    bool isRestrict = ((typeQualifiers & TYPEQUAL_RESTRICT) != 0);
 
     if (hasUniformQual && hasVaryingQual) {
         Error(pos, "Can't provide both \"uniform\" and \"varying\" qualifiers.");
@@ -364,6 +378,10 @@ void Declarator::InitFromType(const Type *baseType, DeclSpecs *ds) {
         Error(pos, "\"unmasked\" qualifier illegal in variable declaration.");
         return;
     }
+    if (kind != DK_POINTER && isRestrict) {
+        Error(pos, "\"restrict\" qualifier is only legal with pointers.");
+        return;
+    }
     if (kind != DK_FUNCTION && isExported) {
         Error(pos, "\"export\" qualifier illegal in variable declaration.");
         return;
@@ -385,7 +403,8 @@ void Declarator::InitFromType(const Type *baseType, DeclSpecs *ds) {
         /* For now, any pointer to an SOA type gets the slice property; if
            we add the capability to declare pointers as slices or not,
            we'll want to set this based on a type qualifier here. */
-        const Type *ptrType = new PointerType(baseType, variability, isConst, baseType->IsSOAType());
+        const Type *ptrType = new PointerType(baseType, variability, isConst, baseType->IsSOAType(), false,
+                                              AddressSpace::ispc_default, isRestrict);
         if (child != NULL) {
             child->InitFromType(ptrType, ds);
             type = child->type;
@@ -618,6 +637,25 @@ void Declarator::InitFromType(const Type *baseType, DeclSpecs *ds) {
                     if (cost < 0)
                         Error(ds_spec_pos, "Negative function cost %d is illegal.", cost);
                     (const_cast<FunctionType *>(functionType))->costOverride = cost;
+                } else if (!strncmp(str.c_str(), "target_clones(", 14) && str.back() == ')') {
+                    if (!isExported)
+                        Error(ds_spec_pos, "\"target_clones\" is only allowed for exported functions.");
+                    std::stringstream targets(str.substr(14, str.size() - 15));
+                    std::string targetName;
+                    while (std::getline(targets, targetName, ',')) {
+                        ISPCTarget target = ParseISPCTarget(targetName);
+                        if (target == ISPCTarget::error)
+                            Error(ds_spec_pos, "Unknown target \"%s\" in \"target_clones\".", targetName.c_str());
+                        else
+                            (const_cast<FunctionType *>(functionType))->targetClones.push_back(target);
+                    }
+                } else if (str == "denormals(flush)" || str == "denormals(preserve)") {
+                    if (!isExported && !isExternC && !isTask)
+                        Error(ds_spec_pos,
+                              "\"denormals\" is only allowed for exported, extern \"C\" and task functions.");
+                    (const_cast<FunctionType *>(functionType))->denormals = str == "denormals(flush)"
+                                                                                ? FunctionType::Denormals::Flush
+                                                                                : FunctionType::Denormals::Preserve;
                 } else
                     Error(ds_spec_pos, "__declspec parameter \"%s\" unknown.", str.c_str());
             }
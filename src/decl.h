@@ -81,6 +81,7 @@ class Declarator;
 #define TYPEQUAL_NOINLINE (1 << 9)
 #define TYPEQUAL_VECTORCALL (1 << 10)
 #define TYPEQUAL_REGCALL (1 << 11)
+#define TYPEQUAL_RESTRICT (1 << 12)
 
 /** @brief Representation of the declaration specifiers in a declaration.
 
@@ -945,7 +945,8 @@ static llvm::Value *lMaskForSymbol(Symbol *baseSym, FunctionEmitContext *ctx) {
         // depending on context...
         return ctx->GetFullMask();
 
-    llvm::Value *mask = (baseSym->parentFunction == ctx->GetFunction() && baseSym->storageClass != SC_STATIC)
+    llvm::Value *mask = (baseSym->parentFunction == ctx->GetFunction() && baseSym->storageClass != SC_STATIC &&
+                         baseSym->storageClass != SC_SHARED)
                             ? ctx->GetInternalMask()
                             : ctx->GetFullMask();
     return mask;
@@ -958,7 +959,8 @@ static void lStoreAssignResult(llvm::Value *value, llvm::Value *ptr, const Type
     Assert(baseSym == NULL || baseSym->varyingCFDepth <= ctx->VaryingCFDepth());
     if (!g->opt.disableMaskedStoreToStore && !g->opt.disableMaskAllOnOptimizations && baseSym != NULL &&
         baseSym->varyingCFDepth == ctx->VaryingCFDepth() && baseSym->storageClass != SC_STATIC &&
-        CastType<ReferenceType>(baseSym->type) == NULL && CastType<PointerType>(baseSym->type) == NULL) {
+        baseSym->storageClass != SC_SHARED && CastType<ReferenceType>(baseSym->type) == NULL &&
+        CastType<PointerType>(baseSym->type) == NULL) {
         // If the variable is declared at the same varying control flow
         // depth as where it's being assigned, then we don't need to do any
         // masking but can just do the assignment as if all the lanes were
@@ -2396,6 +2398,62 @@ static Expr *lConstFoldBinaryIntOp(ConstExpr *constArg0, ConstExpr *constArg1, B
         return origExpr;
 }
 
+/** Returns true if all of the elements of the given integer constant are
+    equal to the given value. */
+static bool lIsIntConstant(const ConstExpr *constExpr, int64_t value) {
+    const Type *type = constExpr->GetType();
+    if (CastType<AtomicType>(type) == NULL || !type->IsIntType())
+        return false;
+    int64_t values[ISPC_MAX_NVEC];
+    int count = constExpr->GetValues(values);
+    for (int i = 0; i < count; ++i) {
+        if (values[i] != value)
+            return false;
+    }
+    return true;
+}
+
+/** Simplifies integer binary operations with a single constant operand:
+    operations with the identity element are dropped and the constants of
+    chains of additions or multiplications are folded together, so that
+    index math that adds or scales by constants (e.g. "programCount") across
+    several expressions is emitted once.  Returns NULL if the operation
+    can't be simplified. */
+static Expr *lSimplifyIntBinaryOp(BinaryExpr *expr) {
+    BinaryExpr::Op op = expr->op;
+    Expr *arg0 = expr->arg0, *arg1 = expr->arg1;
+    const Type *type = expr->GetType();
+    const Type *type0 = arg0->GetType(), *type1 = arg1->GetType();
+    if (type == NULL || type0 == NULL || type1 == NULL || CastType<AtomicType>(type) == NULL || !type->IsIntType())
+        return NULL;
+
+    ConstExpr *constArg0 = llvm::dyn_cast<ConstExpr>(arg0);
+    ConstExpr *constArg1 = llvm::dyn_cast<ConstExpr>(arg1);
+    bool isAddOrMul = (op == BinaryExpr::Add || op == BinaryExpr::Mul);
+    bool isCommutative = isAddOrMul || op == BinaryExpr::BitOr || op == BinaryExpr::BitXor;
+    int64_t identity = (op == BinaryExpr::Mul || op == BinaryExpr::Div) ? 1 : 0;
+
+    // x op identity -> x
+    if (constArg1 != NULL && Type::Equal(type0, type) &&
+        (isCommutative || op == BinaryExpr::Sub || op == BinaryExpr::Div || op == BinaryExpr::Shl ||
+         op == BinaryExpr::Shr) &&
+        lIsIntConstant(constArg1, identity))
+        return arg0;
+    // identity op x -> x
+    if (constArg0 != NULL && Type::Equal(type1, type) && isCommutative && lIsIntConstant(constArg0, identity))
+        return arg1;
+
+    // (x op c0) op c1 -> x op (c0 op c1)
+    BinaryExpr *inner = llvm::dyn_cast<BinaryExpr>(arg0);
+    if (constArg1 != NULL && isAddOrMul && inner != NULL && inner->op == op && llvm::isa<ConstExpr>(inner->arg1) &&
+        Type::Equal(inner->GetType(), type) && Type::Equal(inner->arg1->GetType(), type1)) {
+        Expr *folded = ::Optimize(new BinaryExpr(op, inner->arg1, constArg1, expr->pos));
+        if (folded != NULL && llvm::isa<ConstExpr>(folded))
+            return ::Optimize(new BinaryExpr(op, inner->arg0, folded, expr->pos));
+    }
+    return NULL;
+}
+
 Expr *BinaryExpr::Optimize() {
     if (arg0 == NULL || arg1 == NULL)
         return NULL;
@@ -2472,6 +2530,12 @@ Expr *BinaryExpr::Optimize() {
         }
     }
 
+    if ((constArg0 == NULL) != (constArg1 == NULL)) {
+        Expr *simplified = lSimplifyIntBinaryOp(this);
+        if (simplified != NULL)
+            return simplified;
+    }
+
     // From here on out, we're just doing constant folding, so if both args
     // aren't constants then we're done...
     if (constArg0 == NULL || constArg1 == NULL)
@@ -3715,6 +3779,8 @@ FunctionCallExpr::FunctionCallExpr(Expr *f, ExprList *a, SourcePos p, bool il, E
     : Expr(p, FunctionCallExprID), isLaunch(il), isInvoke(iis) {
     func = f;
     args = a;
+    launchAfter = NULL;
+    launchHints = NULL;
     std::vector<const Expr *> warn;
     if (a->HasAmbiguousVariability(warn) == true) {
         for (auto w : warn) {
@@ -3845,8 +3911,21 @@ llvm::Value *FunctionCallExpr::GetValue(FunctionEmitContext *ctx) const {
         llvm::Value *launchCount[3] = {launchCountExpr[0]->GetValue(ctx), launchCountExpr[1]->GetValue(ctx),
                                        launchCountExpr[2]->GetValue(ctx)};
 
+        std::vector<llvm::Value *> afterVals;
+        if (launchAfter != NULL) {
+            for (Expr *afterExpr : launchAfter->exprs) {
+                llvm::Value *afterValue = afterExpr ? afterExpr->GetValue(ctx) : NULL;
+                if (afterValue == NULL)
+                    return NULL;
+                afterVals.push_back(afterValue);
+            }
+            ctx->SetDebugPos(pos);
+        }
+
         if (launchCount[0] != NULL)
-            ctx->LaunchInst(callee, argVals, launchCount, ft);
+            // The value of a launch expression is the handle of the launch.
+            return ctx->LaunchInst(callee, argVals, launchCount, ft, afterVals, launchHints);
+        return NULL;
     } else {
         if (isInvoke) {
             return ctx->InvokeSyclInst(callee, ft, argVals);
@@ -3904,6 +3983,9 @@ const Type *FunctionCallExpr::GetType() const {
         return type;
     }
     const FunctionType *ftype = CastType<FunctionType>(type);
+    if (ftype && ftype->isTask && isLaunch)
+        // Launches evaluate to a handle that "after" clauses refer to.
+        return AtomicType::UniformInt64;
     return ftype ? ftype->GetReturnType() : NULL;
 }
 
@@ -4040,6 +4122,24 @@ Expr *FunctionCallExpr::TypeCheck() {
             if (launchCountExpr[k] == NULL)
                 return NULL;
         }
+        if (launchAfter != NULL) {
+            for (Expr *&afterExpr : launchAfter->exprs) {
+                if (afterExpr == NULL)
+                    return NULL;
+                const Type *afterType = afterExpr->GetType();
+                if (afterType == NULL)
+                    return NULL;
+                if (afterType->IsVaryingType()) {
+                    Error(afterExpr->pos,
+                          "Launch handle in \"after\" clause must be \"uniform\", not \"%s\".",
+                          afterType->GetString().c_str());
+                    return NULL;
+                }
+                afterExpr = TypeConvertExpr(afterExpr, AtomicType::UniformInt64, "launch handle");
+                if (afterExpr == NULL)
+                    return NULL;
+            }
+        }
     } else {
         if (isLaunch) {
             Error(pos, "\"launch\" expression illegal with non-\"task\"-"
@@ -4101,6 +4201,8 @@ FunctionCallExpr *FunctionCallExpr::Instantiate(TemplateInstantiation &templInst
     inst->launchCountExpr[0] = launchCountExpr[0] ? launchCountExpr[0]->Instantiate(templInst) : nullptr;
     inst->launchCountExpr[1] = launchCountExpr[1] ? launchCountExpr[1]->Instantiate(templInst) : nullptr;
     inst->launchCountExpr[2] = launchCountExpr[2] ? launchCountExpr[2]->Instantiate(templInst) : nullptr;
+    inst->launchAfter = launchAfter ? launchAfter->Instantiate(templInst) : nullptr;
+    inst->launchHints = launchHints;
     return inst;
 }
 
@@ -4112,12 +4214,20 @@ void FunctionCallExpr::Print(Indent &indent) const {
     }
     indent.Print("FunctionCallExpr", pos);
 
-    printf("[%s] %s %s\n", GetType()->GetString().c_str(), isLaunch ? "launch" : "", isInvoke ? "invoke_sycl" : "");
-    indent.pushList(2);
+    printf("[%s] %s %s", GetType()->GetString().c_str(), isLaunch ? "launch" : "", isInvoke ? "invoke_sycl" : "");
+    if (launchHints)
+        printf(" <grain=%d, affinity=%d, priority=%d>", launchHints->grain, launchHints->affinity,
+               launchHints->priority);
+    printf("\n");
+    indent.pushList(launchAfter ? 3 : 2);
     indent.setNextLabel("func");
     func->Print(indent);
     indent.setNextLabel("args");
     args->Print(indent);
+    if (launchAfter) {
+        indent.setNextLabel("after");
+        launchAfter->Print(indent);
+    }
 
     indent.Done();
 }
@@ -5125,6 +5235,30 @@ llvm::Value *VectorMemberExpr::GetValue(FunctionEmitContext *ctx) const {
             indices.push_back(idx);
         }
 
+        // Uniform short vectors are LLVM vectors, so swizzles of their
+        // values are a single shuffle, with the padding elements undefined.
+        // (Bool vectors are left to the general path, as their storage type
+        // differs from the type of their values.)
+        if (!dereferenceExpr && exprVectorType->IsUniformType() && !exprVectorType->GetElementType()->IsBoolType() &&
+            CastType<VectorType>(expr->GetType()) != NULL) {
+            llvm::Value *exprValue = expr->GetValue(ctx);
+            if (exprValue == NULL) {
+                AssertPos(pos, m->errorCount > 0);
+                return NULL;
+            }
+            std::vector<llvm::Constant *> shuffleIndices;
+            for (int i = 0; i < memberType->getVectorMemoryCount(); ++i) {
+                if (i < (int)indices.size() && indices[i] >= 0 && indices[i] < exprVectorType->getVectorMemoryCount())
+                    shuffleIndices.push_back(LLVMInt32(indices[i]));
+                else
+                    shuffleIndices.push_back(llvm::UndefValue::get(LLVMTypes::Int32Type));
+            }
+            ctx->SetDebugPos(pos);
+            return ctx->ShuffleInst(exprValue, llvm::UndefValue::get(exprValue->getType()),
+                                    llvm::ConstantVector::get(shuffleIndices),
+                                    llvm::Twine(exprValue->getName()) + "_swizzle");
+        }
+
         llvm::Value *basePtr = NULL;
         AddressInfo *basePtrInfo = NULL;
         const Type *basePtrType = NULL;
@@ -8086,7 +8220,7 @@ FunctionSymbolExpr::FunctionSymbolExpr(const char *n, const std::vector<Symbol *
 }
 
 FunctionSymbolExpr::FunctionSymbolExpr(const char *n, const std::vector<TemplateSymbol *> &candidates,
-                                       const std::vector<std::pair<const Type *, SourcePos>> &types, SourcePos p)
+                                       const std::vector<TemplateArg> &types, SourcePos p)
     : Expr(p, FunctionSymbolExprID), name(n), candidateTemplateFunctions(candidates), templateArgs(types),
       matchingFunc(nullptr), triedToResolve(false), unresolvedButDependent(false) {
     // Do template argument "normalization", i.e apply "varying type default":
@@ -8094,9 +8228,7 @@ FunctionSymbolExpr::FunctionSymbolExpr(const char *n, const std::vector<Template
     // template <typename T> void foo(T t);
     // foo<int>(1); // T is assumed to be "varying int" here.
     for (auto &arg : templateArgs) {
-        if (arg.first->GetVariability() == Variability::Unbound) {
-            arg.first = arg.first->GetAsVaryingType();
-        }
+        arg.SetAsVaryingType();
     }
 }
 
@@ -8132,9 +8264,9 @@ FunctionSymbolExpr *FunctionSymbolExpr::Instantiate(TemplateInstantiation &templ
         Assert(candidateTemplateFunctions.size() == 0);
         return new FunctionSymbolExpr(name.c_str(), candidateFunctions, pos);
     }
-    std::vector<std::pair<const Type *, SourcePos>> instTemplateArgs;
+    std::vector<TemplateArg> instTemplateArgs;
     for (auto &arg : templateArgs) {
-        instTemplateArgs.push_back(std::make_pair(arg.first->ResolveDependenceForTopType(templInst), arg.second));
+        instTemplateArgs.push_back(arg.Instantiate(templInst));
     }
     return new FunctionSymbolExpr(name.c_str(), candidateTemplateFunctions, instTemplateArgs, pos);
 }
@@ -8388,6 +8520,16 @@ FunctionSymbolExpr::getCandidateTemplateFunctions(const std::vector<const Type *
             paramTypes.push_back(ft->GetParameterType(i));
         }
 
+        // Explicitly specified template arguments must be types for type parameters and constants for non-type
+        // parameters.
+        bool kindsMatch = templateArgs.size() <= templateParms->GetCount();
+        for (int i = 0; kindsMatch && i < templateArgs.size(); ++i) {
+            kindsMatch = templateArgs[i].IsType() == (*templateParms)[i]->IsTypeParam();
+        }
+        if (!kindsMatch) {
+            continue;
+        }
+
         // This looks like a candidate, so now we need get to instantiation and add it to candidate list.
         if (templateArgs.size() == templateParms->GetCount()) {
             // Easy, we have all template arguments specified explicitly, no deduction is needed.
@@ -8494,7 +8636,7 @@ FunctionSymbolExpr::getCandidateTemplateFunctions(const std::vector<const Type *
         }
 
         // Build a complete vector of deduced template arguments.
-        std::vector<std::pair<const Type *, SourcePos>> deducedArgs;
+        std::vector<TemplateArg> deducedArgs;
         for (int i = 0; i < templateParms->GetCount(); ++i) {
             if (i < templateArgs.size()) {
                 deducedArgs.push_back(templateArgs[i]);
@@ -8506,7 +8648,7 @@ FunctionSymbolExpr::getCandidateTemplateFunctions(const std::vector<const Type *
                     deductionFailed = true;
                     break;
                 }
-                deducedArgs.push_back(std::pair<const Type *, SourcePos>(deducedArg, pos));
+                deducedArgs.push_back(TemplateArg(deducedArg, pos));
             }
         }
         if (deductionFailed) {
@@ -8685,6 +8827,32 @@ bool FunctionSymbolExpr::ResolveOverloads(SourcePos argPos, const std::vector<co
         return true;
     }
 
+    // Non-type template arguments need to be evaluated to constants before they are matched with the templates.
+    for (auto &arg : templateArgs) {
+        if (!arg.FoldConstant()) {
+            return false;
+        }
+    }
+
+    // Calls that don't involve templates are resolved once per module for
+    // the given candidates and arguments.
+    bool cacheable = candidateTemplateFunctions.empty() && templateArgs.empty();
+    bool ambiguous = false;
+    Module::OverloadResolutionKey key;
+    if (cacheable) {
+        key.candidates = candidateFunctions;
+        key.argTypes = argTypes;
+        if (argCouldBeNULL != NULL)
+            key.argCouldBeNULL = *argCouldBeNULL;
+        if (argIsConstant != NULL)
+            key.argIsConstant = *argIsConstant;
+        auto iter = m->overloadResolutionCache.find(key);
+        if (iter != m->overloadResolutionCache.end()) {
+            matchingFunc = iter->second;
+            return true;
+        }
+    }
+
     // First, find the subset of overload candidates that take the same
     // number of arguments as have parameters (including functions that
     // take more arguments but have defaults starting no later than after
@@ -8728,6 +8896,7 @@ bool FunctionSymbolExpr::ResolveOverloads(SourcePos argPos, const std::vector<co
                         temp.push_back(actualCandidates[i]);
                         temp.push_back(actualCandidates[j]);
                         std::string candidateMessage = lGetOverloadCandidateMessage(temp, argTypes, argCouldBeNULL);
+                        ambiguous = true;
                         Warning(pos,
                                 "call to \"%s\" is ambiguous. "
                                 "This warning will be turned into error in the next ispc release.\n"
@@ -8745,8 +8914,11 @@ bool FunctionSymbolExpr::ResolveOverloads(SourcePos argPos, const std::vector<co
     }
 
     if (matches.size() == 1) {
-        // Only one match: success
+        // Only one match: success.  Ambiguous calls aren't cached, so that
+        // the warning is issued for each of them.
         matchingFunc = matches[0];
+        if (cacheable && !ambiguous)
+            m->overloadResolutionCache[std::move(key)] = matchingFunc;
         return true;
     } else if (matches.size() > 1) {
         // Multiple matches: ambiguous
@@ -8898,7 +9070,17 @@ llvm::Value *NewExpr::GetValue(FunctionEmitContext *ctx) const {
     // Determine which allocation builtin function to call: uniform or
     // varying, and taking 32-bit or 64-bit allocation counts.
     llvm::Function *func;
-    if (isVarying) {
+    if (g->customAllocator && !g->target->isXeTarget()) {
+        // The allocator of the application takes 64-bit sizes on any runtime.
+        if (isVarying) {
+            bool size32 = g->target->is32Bit() || g->opt.force32BitAddressing;
+            func = m->module->getFunction(size32 ? "__new_varying32_custom" : "__new_varying64_custom");
+        } else {
+            if (allocSize->getType() != LLVMTypes::Int64Type)
+                allocSize = ctx->SExtInst(allocSize, LLVMTypes::Int64Type, "alloc_size64");
+            func = m->module->getFunction("__new_uniform_custom");
+        }
+    } else if (isVarying) {
         if (g->target->is32Bit()) {
             func = m->module->getFunction("__new_varying32_32rt");
         } else if (g->opt.force32BitAddressing) {
@@ -278,6 +278,20 @@ class ExprList : public Expr {
     std::vector<Expr *> exprs;
 };
 
+/** @brief Scheduling hints of a "launch" expression, given as in
+    "launch[n] <grain=16, affinity=spread, priority=high> f()".  The values
+    are passed to ISPCLaunchWithHints() as they are.
+ */
+struct LaunchHints {
+    enum Affinity { AffinityDefault = 0, AffinityCompact = 1, AffinitySpread = 2 };
+    enum Priority { PriorityLow = -1, PriorityNormal = 0, PriorityHigh = 1 };
+
+    /** Number of consecutive tasks that the task system runs together. */
+    int grain = 1;
+    int affinity = AffinityDefault;
+    int priority = PriorityNormal;
+};
+
 /** @brief Expression representing a function call.
  */
 class FunctionCallExpr : public Expr {
@@ -304,6 +318,11 @@ class FunctionCallExpr : public Expr {
     bool isLaunch;
     bool isInvoke;
     Expr *launchCountExpr[3];
+    /** Handles of the launches that have to finish before the tasks of
+        this launch start, if it has an "after" clause. */
+    ExprList *launchAfter;
+    /** Scheduling hints of the launch, if it has any. */
+    const LaunchHints *launchHints;
 };
 
 /** @brief Expression representing indexing into something with an integer
@@ -743,7 +762,7 @@ class FunctionSymbolExpr : public Expr {
   public:
     FunctionSymbolExpr(const char *name, const std::vector<Symbol *> &candFuncs, SourcePos pos);
     FunctionSymbolExpr(const char *name, const std::vector<TemplateSymbol *> &candFuncs,
-                       const std::vector<std::pair<const Type *, SourcePos>> &types, SourcePos pos);
+                       const std::vector<TemplateArg> &types, SourcePos pos);
 
     static inline bool classof(FunctionSymbolExpr const *) { return true; }
     static inline bool classof(ASTNode const *N) { return N->getValueID() == FunctionSymbolExprID; }
@@ -789,7 +808,7 @@ class FunctionSymbolExpr : public Expr {
         overload is the best match. */
     std::vector<Symbol *> candidateFunctions;
     std::vector<TemplateSymbol *> candidateTemplateFunctions;
-    std::vector<std::pair<const Type *, SourcePos>> templateArgs;
+    std::vector<TemplateArg> templateArgs;
 
     /** The actual matching function found after overload resolution. */
     Symbol *matchingFunc;
@@ -85,6 +85,27 @@ bool Function::IsStdlibSymbol() const {
     return false;
 }
 
+bool Function::IsGeneratedOnDemand() const {
+    return IsStdlibSymbol() && sym->function != nullptr && sym->function->hasLocalLinkage();
+}
+
+bool Function::IsReferenced() const {
+    if (sym == nullptr || sym->function == nullptr) {
+        return false;
+    }
+    sym->function->removeDeadConstantUsers();
+    return !sym->function->use_empty();
+}
+
+void Function::RemoveDeclaration() {
+    if (sym == nullptr || sym->function == nullptr) {
+        return;
+    }
+    Assert(sym->function->empty() && sym->function->use_empty());
+    sym->function->eraseFromParent();
+    sym->function = nullptr;
+}
+
 void Function::debugPrintHelper(DebugPrintPoint dumpPoint) {
     if (code == nullptr || sym == nullptr) {
         return;
@@ -233,6 +254,7 @@ void Function::typeCheckAndOptimize() {
 
         if (code != NULL) {
             code = Optimize(code);
+            code = HoistUniformInvariants(code, args);
 
             debugPrintHelper(DebugPrintPoint::AfterOptimization);
         }
@@ -300,7 +322,8 @@ static llvm::Value *lXeGetTaskVariableValue(FunctionEmitContext *ctx, std::strin
     involves wiring up the function parameter values to be available in the
     function body code.
  */
-void Function::emitCode(FunctionEmitContext *ctx, llvm::Function *function, SourcePos firstStmtPos) {
+void Function::emitCode(FunctionEmitContext *ctx, llvm::Function *function, SourcePos firstStmtPos,
+                        bool xeLaunchedTask) {
     // Connect the __mask builtin to the location in memory that stores its
     // value
     maskSymbol->storageInfo = ctx->GetFullMaskAddressInfo();
@@ -311,8 +334,6 @@ void Function::emitCode(FunctionEmitContext *ctx, llvm::Function *function, Sour
 
     if (g->NoOmitFramePointer)
         function->addFnAttr("no-frame-pointer-elim", "true");
-    if (g->target->getArch() == Arch::wasm32)
-        function->addFnAttr("target-features", "+simd128");
 
     g->target->markFuncWithTargetAttr(function);
 #if 0
@@ -420,6 +441,14 @@ void Function::emitCode(FunctionEmitContext *ctx, llvm::Function *function, Sour
             ctx->EmitFunctionParameterDebugInfo(argSym, i);
         }
 
+        // The launched version of an Xe task gets the task indices and
+        // counts after the parameters.
+        llvm::Value *xeTaskArgs[6] = {NULL, NULL, NULL, NULL, NULL, NULL};
+        if (xeLaunchedTask) {
+            for (int i = 0; i < 6; ++i, ++argIter)
+                xeTaskArgs[i] = &*argIter;
+        }
+
         // If the number of actual function arguments is equal to the
         // number of declared arguments in decl->functionParams, then we
         // don't have a mask parameter, so set it to be all on.  This
@@ -451,39 +480,67 @@ void Function::emitCode(FunctionEmitContext *ctx, llvm::Function *function, Sour
             Assert(argIter == function->arg_end());
         }
         if (g->target->isXeTarget() && type->isTask) {
-            // Assign threadIndex and threadCount to the result of calling of corresponding builtins.
+            // Kernels get the task indices and counts from the corresponding
+            // builtins, the launched versions from their parameters, where the
+            // task index and count are computed from the ones per dimension.
+            llvm::Value *taskIndex0, *taskIndex1, *taskIndex2, *taskCount0, *taskCount1, *taskCount2;
+            llvm::Value *taskIndex, *taskCount;
+            if (xeLaunchedTask) {
+                taskIndex0 = xeTaskArgs[0];
+                taskIndex1 = xeTaskArgs[1];
+                taskIndex2 = xeTaskArgs[2];
+                taskCount0 = xeTaskArgs[3];
+                taskCount1 = xeTaskArgs[4];
+                taskCount2 = xeTaskArgs[5];
+                taskIndex = ctx->BinaryOperator(llvm::Instruction::Mul, taskCount1, taskIndex2, "task_index");
+                taskIndex = ctx->BinaryOperator(llvm::Instruction::Add, taskIndex1, taskIndex, "task_index");
+                taskIndex = ctx->BinaryOperator(llvm::Instruction::Mul, taskCount0, taskIndex, "task_index");
+                taskIndex = ctx->BinaryOperator(llvm::Instruction::Add, taskIndex0, taskIndex, "task_index");
+                taskCount = ctx->BinaryOperator(llvm::Instruction::Mul, taskCount0, taskCount1, "task_count");
+                taskCount = ctx->BinaryOperator(llvm::Instruction::Mul, taskCount, taskCount2, "task_count");
+            } else {
+                taskIndex0 = lXeGetTaskVariableValue(ctx, "__task_index0");
+                taskIndex1 = lXeGetTaskVariableValue(ctx, "__task_index1");
+                taskIndex2 = lXeGetTaskVariableValue(ctx, "__task_index2");
+                taskCount0 = lXeGetTaskVariableValue(ctx, "__task_count0");
+                taskCount1 = lXeGetTaskVariableValue(ctx, "__task_count1");
+                taskCount2 = lXeGetTaskVariableValue(ctx, "__task_count2");
+                taskIndex = lXeGetTaskVariableValue(ctx, "__task_index");
+                taskCount = lXeGetTaskVariableValue(ctx, "__task_count");
+            }
+
             // On Xe threadIndex equals to taskIndex and threadCount to taskCount.
             threadIndexSym->storageInfo = ctx->AllocaInst(LLVMTypes::Int32Type, "threadIndex");
-            ctx->StoreInst(lXeGetTaskVariableValue(ctx, "__task_index"), threadIndexSym->storageInfo);
+            ctx->StoreInst(taskIndex, threadIndexSym->storageInfo);
 
             threadCountSym->storageInfo = ctx->AllocaInst(LLVMTypes::Int32Type, "threadCount");
-            ctx->StoreInst(lXeGetTaskVariableValue(ctx, "__task_count"), threadCountSym->storageInfo);
+            ctx->StoreInst(taskCount, threadCountSym->storageInfo);
 
-            // Assign taskIndex and taskCount to the result of calling of corresponding builtins.
             taskIndexSym->storageInfo = ctx->AllocaInst(LLVMTypes::Int32Type, "taskIndex");
-            ctx->StoreInst(lXeGetTaskVariableValue(ctx, "__task_index"), taskIndexSym->storageInfo);
+            ctx->StoreInst(taskIndex, taskIndexSym->storageInfo);
 
             taskCountSym->storageInfo = ctx->AllocaInst(LLVMTypes::Int32Type, "taskCount");
-            ctx->StoreInst(lXeGetTaskVariableValue(ctx, "__task_count"), taskCountSym->storageInfo);
+            ctx->StoreInst(taskCount, taskCountSym->storageInfo);
 
             taskIndexSym0->storageInfo = ctx->AllocaInst(LLVMTypes::Int32Type, "taskIndex0");
-            ctx->StoreInst(lXeGetTaskVariableValue(ctx, "__task_index0"), taskIndexSym0->storageInfo);
+            ctx->StoreInst(taskIndex0, taskIndexSym0->storageInfo);
             taskIndexSym1->storageInfo = ctx->AllocaInst(LLVMTypes::Int32Type, "taskIndex1");
-            ctx->StoreInst(lXeGetTaskVariableValue(ctx, "__task_index1"), taskIndexSym1->storageInfo);
+            ctx->StoreInst(taskIndex1, taskIndexSym1->storageInfo);
             taskIndexSym2->storageInfo = ctx->AllocaInst(LLVMTypes::Int32Type, "taskIndex2");
-            ctx->StoreInst(lXeGetTaskVariableValue(ctx, "__task_index2"), taskIndexSym2->storageInfo);
+            ctx->StoreInst(taskIndex2, taskIndexSym2->storageInfo);
 
             taskCountSym0->storageInfo = ctx->AllocaInst(LLVMTypes::Int32Type, "taskCount0");
-            ctx->StoreInst(lXeGetTaskVariableValue(ctx, "__task_count0"), taskCountSym0->storageInfo);
+            ctx->StoreInst(taskCount0, taskCountSym0->storageInfo);
             taskCountSym1->storageInfo = ctx->AllocaInst(LLVMTypes::Int32Type, "taskCount1");
-            ctx->StoreInst(lXeGetTaskVariableValue(ctx, "__task_count1"), taskCountSym1->storageInfo);
+            ctx->StoreInst(taskCount1, taskCountSym1->storageInfo);
             taskCountSym2->storageInfo = ctx->AllocaInst(LLVMTypes::Int32Type, "taskCount2");
-            ctx->StoreInst(lXeGetTaskVariableValue(ctx, "__task_count2"), taskCountSym2->storageInfo);
+            ctx->StoreInst(taskCount2, taskCountSym2->storageInfo);
         }
     }
 
     // Set FTZ/DAZ flags if requested
     ctx->SetFunctionFTZ_DAZFlags();
+    ctx->BeginFunctionPerfCounters();
 
     // Finally, we can generate code for the function
     if (code != NULL) {
@@ -580,8 +637,24 @@ void Function::emitCode(FunctionEmitContext *ctx, llvm::Function *function, Sour
         // return instruction.  Need to add a return instruction.
         ctx->ReturnInst();
     }
+
+    // Tell LLVM that the memory accesses through different "restrict"
+    // pointer parameters don't alias.
+    std::vector<Symbol *> restrictArgs;
+    for (Symbol *argSym : args) {
+        const PointerType *pt = argSym ? CastType<PointerType>(argSym->type) : NULL;
+        if (pt != NULL && pt->IsRestrict() && !pt->IsSlice())
+            restrictArgs.push_back(argSym);
+    }
+    if (restrictArgs.size() > 1)
+        ctx->AddRestrictAliasScopes(restrictArgs);
+
 #ifdef ISPC_XE_ENABLED
-    if (type->IsISPCKernel()) {
+    if (xeLaunchedTask && ctx->GetSharedLocalMemorySize() > 0) {
+        // The launched tasks run one after another in the launching thread,
+        // so there is no work group to share the memory with.
+        Error(sym->pos, "Task \"%s\" with \"shared\" variables can't be launched from Xe code.", sym->name.c_str());
+    } else if (type->IsISPCKernel() && !xeLaunchedTask) {
         // Emit metadata for XE kernel
 
         llvm::LLVMContext &fContext = function->getContext();
@@ -636,7 +709,11 @@ void Function::emitCode(FunctionEmitContext *ctx, llvm::Function *function, Sour
         mdArgs[llvm::genx::KernelMDOp::FunctionRef] = llvm::ValueAsMetadata::get(function);
         mdArgs[llvm::genx::KernelMDOp::Name] = llvm::MDString::get(fContext, sym->name);
         mdArgs[llvm::genx::KernelMDOp::ArgKinds] = llvm::MDNode::get(fContext, argKinds);
-        mdArgs[llvm::genx::KernelMDOp::SLMSize] = llvm::ValueAsMetadata::get(llvm::ConstantInt::getNullValue(i32Type));
+        // Tasks that declare 'shared' variables use shared local memory
+        // and synchronize through it with barrier().
+        uint64_t slmSize = ctx->GetSharedLocalMemorySize();
+        mdArgs[llvm::genx::KernelMDOp::SLMSize] =
+            llvm::ValueAsMetadata::get(llvm::ConstantInt::get(i32Type, slmSize));
         mdArgs[llvm::genx::KernelMDOp::ArgOffsets] =
             llvm::ValueAsMetadata::get(llvm::ConstantInt::getNullValue(i32Type));
         mdArgs[llvm::genx::KernelMDOp::ArgIOKinds] = llvm::MDNode::get(fContext, argInOutKinds);
@@ -644,7 +721,7 @@ void Function::emitCode(FunctionEmitContext *ctx, llvm::Function *function, Sour
         mdArgs[llvm::genx::KernelMDOp::NBarrierCnt] =
             llvm::ValueAsMetadata::get(llvm::ConstantInt::getNullValue(i32Type));
         mdArgs[llvm::genx::KernelMDOp::BarrierCnt] =
-            llvm::ValueAsMetadata::get(llvm::ConstantInt::getNullValue(i32Type));
+            llvm::ValueAsMetadata::get(llvm::ConstantInt::get(i32Type, slmSize > 0 ? 1 : 0));
 
         mdKernels->addOperand(llvm::MDNode::get(fContext, mdArgs));
         // This is needed to run in L0 runtime.
@@ -653,6 +730,22 @@ void Function::emitCode(FunctionEmitContext *ctx, llvm::Function *function, Sour
 #endif
 }
 
+/** Figure out a reasonable source file position for the start of the
+    function body.  If possible, get the position of the first actual
+    non-StmtList statment...
+ */
+SourcePos Function::getFirstStmtPos() const {
+    SourcePos firstStmtPos = sym->pos;
+    if (code) {
+        StmtList *sl = llvm::dyn_cast<StmtList>(code);
+        if (sl && sl->stmts.size() > 0 && sl->stmts[0] != NULL)
+            firstStmtPos = sl->stmts[0]->pos;
+        else
+            firstStmtPos = code->pos;
+    }
+    return firstStmtPos;
+}
+
 void Function::GenerateIR() {
     if (sym == NULL)
         // May be NULL due to error earlier in compilation
@@ -675,17 +768,7 @@ void Function::GenerateIR() {
         return;
     }
 
-    // Figure out a reasonable source file position for the start of the
-    // function body.  If possible, get the position of the first actual
-    // non-StmtList statment...
-    SourcePos firstStmtPos = sym->pos;
-    if (code) {
-        StmtList *sl = llvm::dyn_cast<StmtList>(code);
-        if (sl && sl->stmts.size() > 0 && sl->stmts[0] != NULL)
-            firstStmtPos = sl->stmts[0]->pos;
-        else
-            firstStmtPos = code->pos;
-    }
+    SourcePos firstStmtPos = getFirstStmtPos();
     // And we can now go ahead and emit the code
     if (g->target->isXeTarget()) {
         // For Xe target we do not emit code for masked version of a function
@@ -729,7 +812,11 @@ void Function::GenerateIR() {
 
             llvm::Function *appFunction = llvm::Function::Create(ftype, linkage, functionName.c_str(), m->module);
             appFunction->setDoesNotThrow();
-            appFunction->setCallingConv(type->GetCallingConv());
+            // The application calls the exported functions with the C calling convention even with --regcall.
+            if (g->calling_conv == CallingConv::x86_regcall && type->isExported)
+                appFunction->setCallingConv(llvm::CallingConv::C);
+            else
+                appFunction->setCallingConv(type->GetCallingConv());
 
             // Xe kernel should have "dllexport" and "CMGenxMain" attribute,
             // otherss have "CMStackCall" attribute
@@ -791,16 +878,93 @@ void Function::GenerateIR() {
     }
 }
 
+llvm::Function *ispc::GetXeLaunchedTaskFunction(llvm::Function *task, const FunctionType *type) {
+    std::string name = (task->getName() + "___xe_launched").str();
+    if (llvm::Function *launched = m->module->getFunction(name))
+        return launched;
+
+    // The parameters of the task, then the task indices and counts per dimension.
+    std::vector<llvm::Type *> argTypes = type->LLVMFunctionArgTypes(g->ctx);
+    argTypes.insert(argTypes.end(), 6, LLVMTypes::Int32Type);
+    llvm::FunctionType *ftype = llvm::FunctionType::get(LLVMTypes::VoidType, argTypes, false);
+    llvm::Function *launched = llvm::Function::Create(ftype, llvm::GlobalValue::InternalLinkage, name, m->module);
+    launched->setDoesNotThrow();
+    launched->setCallingConv(llvm::CallingConv::SPIR_FUNC);
+    return launched;
+}
+
+bool Function::IsLaunchedOnXe() const {
+    if (sym == nullptr || sym->function == nullptr || !g->target->isXeTarget())
+        return false;
+    const FunctionType *type = CastType<FunctionType>(sym->type);
+    if (type == nullptr || !type->isTask)
+        return false;
+    llvm::Function *launched = m->module->getFunction((sym->function->getName() + "___xe_launched").str());
+    return launched != nullptr && launched->empty();
+}
+
+void Function::GenerateXeLaunchedTaskIR() {
+    const FunctionType *type = CastType<FunctionType>(sym->type);
+    llvm::Function *function = GetXeLaunchedTaskFunction(sym->function, type);
+    Assert(function->empty());
+
+    SourcePos firstStmtPos = getFirstStmtPos();
+    {
+        llvm::TimeTraceScope TimeScope("emitCode", llvm::StringRef(sym->name));
+        FunctionEmitContext ec(this, sym, function, firstStmtPos);
+        emitCode(&ec, function, firstStmtPos, true /* xeLaunchedTask */);
+    }
+    // Like the other internal functions, it is a stack call which is inlined
+    // into the launching code.
+    function->addFnAttr("CMStackCall");
+    function->addFnAttr(llvm::Attribute::AlwaysInline);
+}
+
+///////////////////////////////////////////////////////////////////////////
+// TemplateParam
+
+TemplateParam::TemplateParam(const TemplateTypeParmType *p)
+    : paramType(ParamType::Type), typeParam(p), nonTypeParam(nullptr) {}
+
+TemplateParam::TemplateParam(Symbol *s) : paramType(ParamType::NonType), typeParam(nullptr), nonTypeParam(s) {}
+
+const TemplateTypeParmType *TemplateParam::GetTypeParam() const {
+    Assert(IsTypeParam());
+    return typeParam;
+}
+
+Symbol *TemplateParam::GetNonTypeParam() const {
+    Assert(IsNonTypeParam());
+    return nonTypeParam;
+}
+
+std::string TemplateParam::GetName() const { return IsTypeParam() ? typeParam->GetName() : nonTypeParam->name; }
+
+const SourcePos &TemplateParam::GetSourcePos() const {
+    return IsTypeParam() ? typeParam->GetSourcePos() : nonTypeParam->pos;
+}
+
+bool TemplateParam::IsEqual(const TemplateParam &other) const {
+    if (paramType != other.paramType) {
+        return false;
+    }
+    if (IsTypeParam()) {
+        return Type::Equal(typeParam, other.typeParam);
+    }
+    // Non-type parameters are equivalent if they have the same type, the names don't matter.
+    return Type::Equal(nonTypeParam->type, other.nonTypeParam->type);
+}
+
 ///////////////////////////////////////////////////////////////////////////
 // TemplateParms
 
 TemplateParms::TemplateParms() {}
 
-void TemplateParms::Add(const TemplateTypeParmType *p) { parms.push_back(p); }
+void TemplateParms::Add(const TemplateParam *p) { parms.push_back(p); }
 
 size_t TemplateParms::GetCount() const { return parms.size(); }
 
-const TemplateTypeParmType *TemplateParms::operator[](size_t i) const { return parms[i]; }
+const TemplateParam *TemplateParms::operator[](size_t i) const { return parms[i]; }
 
 bool TemplateParms::IsEqual(const TemplateParms *p) const {
     if (p == nullptr) {
@@ -812,7 +976,7 @@ bool TemplateParms::IsEqual(const TemplateParms *p) const {
     }
 
     for (size_t i = 0; i < GetCount(); i++) {
-        if (!Type::Equal((*this)[i], (*p)[i])) {
+        if (!(*this)[i]->IsEqual(*(*p)[i])) {
             return false;
         }
     }
@@ -823,14 +987,14 @@ bool TemplateParms::IsEqual(const TemplateParms *p) const {
 ///////////////////////////////////////////////////////////////////////////
 // TemplateArgs
 
-TemplateArgs::TemplateArgs(const std::vector<std::pair<const Type *, SourcePos>> &a) : args(a) {}
+TemplateArgs::TemplateArgs(const std::vector<TemplateArg> &a) : args(a) {}
 
 bool TemplateArgs::IsEqual(TemplateArgs &otherArgs) const {
     if (args.size() != otherArgs.args.size()) {
         return false;
     }
     for (int i = 0; i < args.size(); i++) {
-        if (!Type::Equal(args[i].first, otherArgs.args[i].first)) {
+        if (!args[i].IsEqual(otherArgs.args[i])) {
             return false;
         }
     }
@@ -909,7 +1073,12 @@ void FunctionTemplate::Print(Indent &indent) const {
             char buffer[BUFSIZE];
             snprintf(buffer, BUFSIZE, "template param %d", i);
             indent.setNextLabel(buffer);
-            if ((*typenames)[i]) {
+            if ((*typenames)[i] && (*typenames)[i]->IsNonTypeParam()) {
+                Symbol *parmSym = (*typenames)[i]->GetNonTypeParam();
+                indent.Print("NonTypeTemplateParm", parmSym->pos);
+                printf("[%s] \"%s\"\n", parmSym->type->GetString().c_str(), parmSym->name.c_str());
+                indent.Done();
+            } else if ((*typenames)[i]) {
                 indent.Print("TemplateTypeParmType", (*typenames)[i]->GetSourcePos());
                 printf("\"%s\"\n", (*typenames)[i]->GetName().c_str());
                 indent.Done();
@@ -929,7 +1098,7 @@ void FunctionTemplate::Print(Indent &indent) const {
         std::string args;
         for (size_t i = 0; i < inst.first->args.size(); i++) {
             auto &arg = inst.first->args[i];
-            args += arg.first->GetString();
+            args += arg.GetString();
             if (i + 1 < inst.first->args.size()) {
                 args += ", ";
             }
@@ -952,17 +1121,30 @@ bool FunctionTemplate::IsStdlibSymbol() const {
     return false;
 };
 
-Symbol *FunctionTemplate::LookupInstantiation(const std::vector<std::pair<const Type *, SourcePos>> &types) {
+static std::string lTemplateArgsKey(const std::vector<TemplateArg> &types) {
+    std::string key;
+    for (const auto &arg : types) {
+        key += arg.Mangle();
+        key += ",";
+    }
+    return key;
+}
+
+Symbol *FunctionTemplate::LookupInstantiation(const std::vector<TemplateArg> &types) {
+    auto candidates = instantiationIndex.find(lTemplateArgsKey(types));
+    if (candidates == instantiationIndex.end()) {
+        return nullptr;
+    }
     TemplateArgs argsToMatch(types);
-    for (const auto &inst : instantiations) {
-        if (inst.first->IsEqual(argsToMatch)) {
-            return inst.second;
+    for (size_t index : candidates->second) {
+        if (instantiations[index].first->IsEqual(argsToMatch)) {
+            return instantiations[index].second;
         }
     }
     return nullptr;
 }
 
-Symbol *FunctionTemplate::AddInstantiation(const std::vector<std::pair<const Type *, SourcePos>> &types) {
+Symbol *FunctionTemplate::AddInstantiation(const std::vector<TemplateArg> &types) {
     const TemplateParms *typenames = GetTemplateParms();
     Assert(typenames);
     TemplateInstantiation templInst(*typenames, types);
@@ -980,6 +1162,7 @@ Symbol *FunctionTemplate::AddInstantiation(const std::vector<std::pair<const Typ
     templInst.SetFunction(inst);
 
     TemplateArgs *templArgs = new TemplateArgs(types);
+    instantiationIndex[lTemplateArgsKey(types)].push_back(instantiations.size());
     instantiations.push_back(std::make_pair(templArgs, instSym));
 
     return instSym;
@@ -988,8 +1171,7 @@ Symbol *FunctionTemplate::AddInstantiation(const std::vector<std::pair<const Typ
 ///////////////////////////////////////////////////////////////////////////
 // TemplateInstantiation
 
-TemplateInstantiation::TemplateInstantiation(const TemplateParms &typeParms,
-                                             const std::vector<std::pair<const Type *, SourcePos>> &typeArgs)
+TemplateInstantiation::TemplateInstantiation(const TemplateParms &typeParms, const std::vector<TemplateArg> &typeArgs)
     : functionSym(nullptr) {
     Assert(typeArgs.size() <= typeParms.GetCount());
     // Create a mapping from the template parameters to the arguments.
@@ -997,10 +1179,19 @@ TemplateInstantiation::TemplateInstantiation(const TemplateParms &typeParms,
     // parameters. In this case the rest of template parameters will be deduced later during template argumnet
     // deduction.
     for (int i = 0; i < typeArgs.size(); i++) {
-        std::string name = typeParms[i]->GetName();
-        const Type *type = typeArgs[i].first;
-        argsMap[name] = type;
-        templateArgs.push_back(typeArgs[i].first);
+        Assert(typeParms[i]->IsTypeParam() == typeArgs[i].IsType());
+        if (typeParms[i]->IsTypeParam()) {
+            argsMap[typeParms[i]->GetName()] = typeArgs[i].GetAsType();
+        } else {
+            // The symbol of non-type template parameter is substituted with a constant symbol, so the uses of the
+            // parameter in the function body are folded to the argument value.
+            Symbol *parmSym = typeParms[i]->GetNonTypeParam();
+            Symbol *instSym = new Symbol(parmSym->name, parmSym->pos, parmSym->type, parmSym->storageClass);
+            instSym->constValue = llvm::dyn_cast_or_null<ConstExpr>(typeArgs[i].GetAsNonType());
+            Assert(instSym->constValue || m->errorCount > 0);
+            symMap.emplace(std::make_pair(parmSym, instSym));
+        }
+        templateArgs.push_back(typeArgs[i]);
     }
 }
 
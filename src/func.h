@@ -61,12 +61,31 @@ class Function {
     void Print(Indent &indent) const;
     bool IsStdlibSymbol() const;
 
+    /** Returns true if the IR for the function is needed only when it is
+        referenced by other code, i.e. this is a static stdlib function. */
+    bool IsGeneratedOnDemand() const;
+
+    /** Returns true if the function is referenced by the generated IR. */
+    bool IsReferenced() const;
+
+    /** Removes the declaration of a function, which was never generated. */
+    void RemoveDeclaration();
+
+    /** Returns true if this is an Xe task that is launched from device code, whose launched version (see
+        GetXeLaunchedTaskFunction()) hasn't been generated yet. */
+    bool IsLaunchedOnXe() const;
+
+    /** Generate the IR of the launched version of an Xe task. */
+    void GenerateXeLaunchedTaskIR();
+
   private:
     enum class DebugPrintPoint { Initial, AfterTypeChecking, AfterOptimization };
     void debugPrintHelper(DebugPrintPoint dumpPoint);
     void typeCheckAndOptimize();
 
-    void emitCode(FunctionEmitContext *ctx, llvm::Function *function, SourcePos firstStmtPos);
+    SourcePos getFirstStmtPos() const;
+    void emitCode(FunctionEmitContext *ctx, llvm::Function *function, SourcePos firstStmtPos,
+                  bool xeLaunchedTask = false);
 
     Symbol *sym;
     std::vector<Symbol *> args;
@@ -79,25 +98,53 @@ class Function {
     Symbol *taskIndexSym2, *taskCountSym2;
 };
 
+/** On Xe, the tasks launched from device code are run by the launching thread, which calls this version of the
+    task function for every task index. It gets the task indices and counts after the parameters of the task. */
+llvm::Function *GetXeLaunchedTaskFunction(llvm::Function *task, const FunctionType *type);
+
+// A template parameter: either a type parameter ("typename T") or a non-type
+// parameter ("uniform int N"). Non-type parameters are represented by constant
+// symbols, which are declared in the scope of the template.
+class TemplateParam {
+  public:
+    enum class ParamType { Type, NonType };
+
+    TemplateParam(const TemplateTypeParmType *p);
+    TemplateParam(Symbol *s);
+
+    bool IsTypeParam() const { return paramType == ParamType::Type; }
+    bool IsNonTypeParam() const { return paramType == ParamType::NonType; }
+    const TemplateTypeParmType *GetTypeParam() const;
+    Symbol *GetNonTypeParam() const;
+    std::string GetName() const;
+    const SourcePos &GetSourcePos() const;
+    bool IsEqual(const TemplateParam &other) const;
+
+  private:
+    ParamType paramType;
+    const TemplateTypeParmType *typeParam;
+    Symbol *nonTypeParam;
+};
+
 // A helper class to manage template parameters list.
 class TemplateParms {
   public:
     TemplateParms();
-    void Add(const TemplateTypeParmType *);
+    void Add(const TemplateParam *);
     size_t GetCount() const;
-    const TemplateTypeParmType *operator[](size_t i) const;
+    const TemplateParam *operator[](size_t i) const;
     bool IsEqual(const TemplateParms *p) const;
 
   private:
-    std::vector<const TemplateTypeParmType *> parms;
+    std::vector<const TemplateParam *> parms;
 };
 
 class TemplateArgs {
   public:
-    TemplateArgs(const std::vector<std::pair<const Type *, SourcePos>> &args);
+    TemplateArgs(const std::vector<TemplateArg> &args);
     bool IsEqual(TemplateArgs &otherArgs) const;
 
-    std::vector<std::pair<const Type *, SourcePos>> args;
+    std::vector<TemplateArg> args;
 };
 
 class FunctionTemplate {
@@ -107,8 +154,8 @@ class FunctionTemplate {
     const TemplateParms *GetTemplateParms() const;
     const FunctionType *GetFunctionType() const;
 
-    Symbol *LookupInstantiation(const std::vector<std::pair<const Type *, SourcePos>> &types);
-    Symbol *AddInstantiation(const std::vector<std::pair<const Type *, SourcePos>> &types);
+    Symbol *LookupInstantiation(const std::vector<TemplateArg> &types);
+    Symbol *AddInstantiation(const std::vector<TemplateArg> &types);
 
     // Generate code for instantiations
     void GenerateIR() const;
@@ -124,6 +171,11 @@ class FunctionTemplate {
     Symbol *maskSymbol;
 
     std::vector<std::pair<TemplateArgs *, Symbol *>> instantiations;
+    // Indices of the instantiations in the vector above, keyed by the mangled
+    // template arguments, so the lookup doesn't depend on the number of
+    // instantiations.  Mangling may be the same for different types, so the
+    // candidates are compared with the arguments to match anyway.
+    std::unordered_map<std::string, std::vector<size_t>> instantiationIndex;
 };
 
 // A helper class to drive function instantiation, it provides the following:
@@ -131,8 +183,7 @@ class FunctionTemplate {
 // - type instantiation
 class TemplateInstantiation {
   public:
-    TemplateInstantiation(const TemplateParms &typeParms,
-                          const std::vector<std::pair<const Type *, SourcePos>> &typeArgs);
+    TemplateInstantiation(const TemplateParms &typeParms, const std::vector<TemplateArg> &typeArgs);
     const Type *InstantiateType(const std::string &name);
     Symbol *InstantiateSymbol(Symbol *sym);
     Symbol *InstantiateTemplateSymbol(TemplateSymbol *sym);
@@ -144,11 +195,12 @@ class TemplateInstantiation {
     // Function Symbol of the instantiation.
     Symbol *functionSym;
     // Mapping of the symbols in the template to correspoding symbols in the instantiation.
+    // The symbols of non-type template parameters are mapped to constants with the argument values.
     std::unordered_map<Symbol *, Symbol *> symMap;
     // Mapping of template parameter names to the types in the instantiation.
     std::unordered_map<std::string, const Type *> argsMap;
     // Template arguments in the order of the template parameters.
-    std::vector<const Type *> templateArgs;
+    std::vector<TemplateArg> templateArgs;
 
     llvm::Function *createLLVMFunction(Symbol *functionSym, bool isInline, bool isNoInline);
 };
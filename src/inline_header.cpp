@@ -0,0 +1,1093 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/** @file inline_header.cpp
+    @brief Translation of optimized LLVM functions to inline C++ functions.
+*/
+
+#include "inline_header.h"
+#include "util.h"
+
+#include <cstdint>
+#include <cstdio>
+
+#include <llvm/ADT/APInt.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/GetElementPtrTypeIterator.h>
+#include <llvm/IR/InstrTypes.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/Operator.h>
+#include <llvm/Support/MathExtras.h>
+#include <llvm/Support/raw_ostream.h>
+
+using namespace ispc;
+
+/** Helpers used by the generated functions.  They are guarded, since the
+    inline headers of several ispc files may be included together. */
+static const char *lHelpers = R"(#ifndef __ISPC_INLINE_HELPERS__
+#define __ISPC_INLINE_HELPERS__
+template <typename T, typename F> static inline T __ispc_bitcast(F from) {
+    static_assert(sizeof(T) == sizeof(F), "bitcast between types of different sizes");
+    T to;
+    memcpy(&to, &from, sizeof(to));
+    return to;
+}
+template <typename T, typename V> static inline T __ispc_mask_to_bits(V mask) {
+    T bits = 0;
+    for (int i = 0; i < (int)(sizeof(V) / sizeof(mask[0])); ++i)
+        bits |= (T)(mask[i] != 0) << i;
+    return bits;
+}
+template <typename V, typename T> static inline V __ispc_bits_to_mask(T bits) {
+    V mask = {};
+    for (int i = 0; i < (int)(sizeof(V) / sizeof(mask[0])); ++i)
+        mask[i] = ((bits >> i) & 1) ? -1 : 0;
+    return mask;
+}
+#endif // __ISPC_INLINE_HELPERS__
+)";
+
+static std::string lTypeString(const llvm::Type *type) {
+    std::string str;
+    llvm::raw_string_ostream os(str);
+    type->print(os);
+    return os.str();
+}
+
+// Masks are vectors of i1, which are kept as lanes of 0 or -1 bytes
+static bool lIsMask(const llvm::Type *type) {
+    return type->isVectorTy() && type->getScalarType()->isIntegerTy(1);
+}
+
+static unsigned lLaneCount(const llvm::Type *type) {
+    return type->isVectorTy() ? llvm::cast<llvm::FixedVectorType>(type)->getNumElements() : 1;
+}
+
+/** Writes the bytes of the constant at the given offset, returning false if
+    its value isn't known before linking (e.g. an address). */
+static bool lConstantBytes(const llvm::Constant *c, uint64_t offset, const llvm::DataLayout &dl,
+                           std::vector<uint8_t> &bytes) {
+    if (llvm::isa<llvm::ConstantAggregateZero>(c) || llvm::isa<llvm::UndefValue>(c))
+        return true;
+    if (llvm::isa<llvm::ConstantInt>(c) || llvm::isa<llvm::ConstantFP>(c)) {
+        uint64_t size = dl.getTypeStoreSize(c->getType());
+        llvm::APInt value = llvm::isa<llvm::ConstantInt>(c)
+                                ? llvm::cast<llvm::ConstantInt>(c)->getValue()
+                                : llvm::cast<llvm::ConstantFP>(c)->getValueAPF().bitcastToAPInt();
+        value = value.zext(size * 8);
+        for (uint64_t i = 0; i < size; ++i)
+            bytes[offset + i] = (uint8_t)value.extractBitsAsZExtValue(8, i * 8);
+        return true;
+    }
+    if (const llvm::ConstantDataSequential *cds = llvm::dyn_cast<llvm::ConstantDataSequential>(c)) {
+        uint64_t eltSize = dl.getTypeAllocSize(cds->getElementType());
+        for (unsigned i = 0; i < cds->getNumElements(); ++i)
+            if (!lConstantBytes(cds->getElementAsConstant(i), offset + i * eltSize, dl, bytes))
+                return false;
+        return true;
+    }
+    if (llvm::isa<llvm::ConstantArray>(c) || llvm::isa<llvm::ConstantVector>(c)) {
+        llvm::Type *eltType = llvm::isa<llvm::ConstantArray>(c) ? c->getType()->getArrayElementType()
+                                                                 : c->getType()->getScalarType();
+        if (eltType->isIntegerTy(1) && c->getType()->isVectorTy())
+            return false;
+        uint64_t eltSize = dl.getTypeAllocSize(eltType);
+        for (unsigned i = 0; i < c->getNumOperands(); ++i)
+            if (!lConstantBytes(llvm::cast<llvm::Constant>(c->getOperand(i)), offset + i * eltSize, dl, bytes))
+                return false;
+        return true;
+    }
+    if (const llvm::ConstantStruct *cs = llvm::dyn_cast<llvm::ConstantStruct>(c)) {
+        const llvm::StructLayout *sl = dl.getStructLayout(cs->getType());
+        for (unsigned i = 0; i < cs->getNumOperands(); ++i)
+            if (!lConstantBytes(cs->getOperand(i), offset + sl->getElementOffset(i), dl, bytes))
+                return false;
+        return true;
+    }
+    return false;
+}
+
+InlineCppWriter::InlineCppWriter(const llvm::DataLayout &dataLayout) : dl(dataLayout) {}
+
+void InlineCppWriter::fail(const std::string &what) {
+    if (error.empty())
+        error = what;
+}
+
+std::string InlineCppWriter::scalarType(llvm::Type *type, bool isSigned) {
+    if (type->isIntegerTy(1))
+        return "bool";
+    if (type->isIntegerTy(8) || type->isIntegerTy(16) || type->isIntegerTy(32) || type->isIntegerTy(64))
+        return std::string(isSigned ? "int" : "uint") + std::to_string(type->getIntegerBitWidth()) + "_t";
+    if (type->isFloatTy())
+        return "float";
+    if (type->isDoubleTy())
+        return "double";
+    if (type->isPointerTy())
+        return "uint8_t *";
+    return "";
+}
+
+std::string InlineCppWriter::vectorType(unsigned count, char kind, unsigned bits) {
+    std::string name = "__ispc_v" + std::to_string(count) + "_" + kind + std::to_string(bits);
+    if (typedefs.find(name) == typedefs.end()) {
+        std::string elt = kind == 'f' ? (bits == 32 ? "float" : "double")
+                                      : std::string(kind == 's' ? "int" : "uint") + std::to_string(bits) + "_t";
+        typedefs[name] = "typedef " + elt + " " + name + " __attribute__((vector_size(" +
+                         std::to_string(count * bits / 8) + ")));\n";
+    }
+    return name;
+}
+
+std::string InlineCppWriter::typeOf(llvm::Type *type, bool isSigned) {
+    if (!type->isVectorTy()) {
+        std::string name = scalarType(type, isSigned);
+        if (name.empty())
+            fail("type " + lTypeString(type) + " isn't supported");
+        return name;
+    }
+    unsigned count = lLaneCount(type);
+    llvm::Type *elt = type->getScalarType();
+    // The host compiler needs vectors of a power of two size.
+    if (!llvm::isa<llvm::FixedVectorType>(type) || count < 2 || !llvm::isPowerOf2_32(count)) {
+        fail("vector type " + lTypeString(type) + " isn't supported");
+        return "";
+    }
+    if (elt->isIntegerTy(1))
+        return vectorType(count, 's', 8);
+    if (elt->isIntegerTy(8) || elt->isIntegerTy(16) || elt->isIntegerTy(32) || elt->isIntegerTy(64))
+        return vectorType(count, isSigned ? 's' : 'u', elt->getIntegerBitWidth());
+    if (elt->isFloatTy() || elt->isDoubleTy())
+        return vectorType(count, 'f', elt->getPrimitiveSizeInBits());
+    fail("vector type " + lTypeString(type) + " isn't supported");
+    return "";
+}
+
+std::string InlineCppWriter::elementType(llvm::Type *type, bool isSigned) {
+    if (lIsMask(type))
+        return "int8_t";
+    return typeOf(type->getScalarType(), isSigned);
+}
+
+std::string InlineCppWriter::splat(llvm::Type *type, const char *value) {
+    std::string str = typeOf(type) + "{";
+    for (unsigned i = 0; i < lLaneCount(type); ++i)
+        str += std::string(i ? ", " : "") + value;
+    return str + "}";
+}
+
+std::string InlineCppWriter::signedValue(const llvm::Value *value) {
+    llvm::Type *type = value->getType();
+    if (!type->isIntOrIntVectorTy() || type->getScalarType()->isIntegerTy(1))
+        return expr(value);
+    return "(" + typeOf(type, true) + ")(" + expr(value) + ")";
+}
+
+std::string InlineCppWriter::expr(const llvm::Value *value) {
+    auto iter = names.find(value);
+    if (iter != names.end())
+        return iter->second;
+    if (llvm::isa<llvm::Constant>(value))
+        return constantExpr(value);
+    fail("value isn't defined before its use");
+    return "";
+}
+
+std::string InlineCppWriter::scalarConstant(const llvm::Value *value, bool inMask) {
+    llvm::Type *type = value->getType();
+    if (const llvm::ConstantInt *ci = llvm::dyn_cast<llvm::ConstantInt>(value)) {
+        if (type->isIntegerTy(1))
+            return inMask ? (ci->isZero() ? "0" : "-1") : (ci->isZero() ? "false" : "true");
+        return "(" + typeOf(type) + ")" + std::to_string(ci->getZExtValue()) + (type->isIntegerTy(64) ? "ull" : "u");
+    }
+    if (const llvm::ConstantFP *cfp = llvm::dyn_cast<llvm::ConstantFP>(value)) {
+        const llvm::APFloat &apf = cfp->getValueAPF();
+        if (!type->isFloatTy() && !type->isDoubleTy()) {
+            fail("type " + lTypeString(type) + " isn't supported");
+            return "";
+        }
+        // Nine and seventeen significant digits give back the same float and double, and NaNs keep their
+        // payload through their bits.
+        if (apf.isNaN() || apf.isInfinity()) {
+            std::string bits = std::to_string(apf.bitcastToAPInt().getZExtValue());
+            return type->isFloatTy() ? "__ispc_bitcast<float>((uint32_t)" + bits + "u)"
+                                     : "__ispc_bitcast<double>((uint64_t)" + bits + "ull)";
+        }
+        char buf[64];
+        if (type->isFloatTy())
+            snprintf(buf, sizeof(buf), "%.8ef", (double)apf.convertToFloat());
+        else
+            snprintf(buf, sizeof(buf), "%.16e", apf.convertToDouble());
+        return buf;
+    }
+    if (llvm::isa<llvm::UndefValue>(value)) {
+        if (inMask)
+            return "0";
+        if (type->isIntegerTy(1))
+            return "false";
+        return "(" + typeOf(type) + ")0";
+    }
+    fail("constant of type " + lTypeString(type) + " isn't supported");
+    return "";
+}
+
+std::string InlineCppWriter::constantExpr(const llvm::Value *value) {
+    llvm::Type *type = value->getType();
+    if (const llvm::GlobalVariable *gv = llvm::dyn_cast<llvm::GlobalVariable>(value))
+        return globalExpr(gv);
+    if (llvm::isa<llvm::GlobalValue>(value)) {
+        fail("address of function \"" + value->getName().str() + "\" is used");
+        return "";
+    }
+    if (llvm::isa<llvm::ConstantPointerNull>(value))
+        return "(uint8_t *)0";
+    if (const llvm::ConstantExpr *ce = llvm::dyn_cast<llvm::ConstantExpr>(value)) {
+        if (ce->getOpcode() == llvm::Instruction::BitCast && type->isPointerTy())
+            return expr(ce->getOperand(0));
+        if (ce->getOpcode() == llvm::Instruction::GetElementPtr && type->isPointerTy()) {
+            const llvm::GEPOperator *gep = llvm::cast<llvm::GEPOperator>(ce);
+            llvm::APInt offset(dl.getIndexTypeSizeInBits(type), 0);
+            if (gep->accumulateConstantOffset(dl, offset))
+                return "(" + expr(gep->getPointerOperand()) + " + " + std::to_string(offset.getSExtValue()) + ")";
+        }
+        fail("constant expression " + std::string(ce->getOpcodeName()) + " isn't supported");
+        return "";
+    }
+    if (!type->isVectorTy())
+        return scalarConstant(value, false);
+
+    std::string vt = typeOf(type);
+    if (llvm::isa<llvm::ConstantAggregateZero>(value) || llvm::isa<llvm::UndefValue>(value))
+        return vt + "{}";
+    const llvm::Constant *c = llvm::cast<llvm::Constant>(value);
+    std::string str = vt + "{";
+    for (unsigned i = 0; i < lLaneCount(type); ++i) {
+        const llvm::Constant *elt = c->getAggregateElement(i);
+        if (elt == nullptr) {
+            fail("vector constant isn't supported");
+            return "";
+        }
+        str += (i ? ", " : "") + scalarConstant(elt, lIsMask(type));
+    }
+    return str + "}";
+}
+
+std::string InlineCppWriter::globalExpr(const llvm::GlobalVariable *global) {
+    auto iter = names.find(global);
+    if (iter != names.end())
+        return iter->second;
+    // Only a constant is the same in the copy of the table that each caller gets.
+    if (!global->isConstant() || !global->hasDefinitiveInitializer()) {
+        fail("global variable \"" + global->getName().str() + "\" is used");
+        return "";
+    }
+    const llvm::Constant *init = global->getInitializer();
+    uint64_t size = dl.getTypeAllocSize(init->getType());
+    std::vector<uint8_t> bytes(size, 0);
+    if (!lConstantBytes(init, 0, dl, bytes)) {
+        fail("initializer of global variable \"" + global->getName().str() + "\" isn't supported");
+        return "";
+    }
+    std::string name = "g" + std::to_string(globalNames.size());
+    globalNames[global] = name;
+    globals += "    alignas(" + std::to_string(dl.getPreferredAlign(global).value()) + ") static const uint8_t " +
+               name + "[" + std::to_string(size ? size : 1) + "] = {";
+    for (uint64_t i = 0; i < size; ++i)
+        globals += (i ? (i % 16 ? ", " : ",\n        ") : "") + std::to_string(bytes[i]);
+    globals += "};\n";
+    return names[global] = "((uint8_t *)" + name + ")";
+}
+
+std::string InlineCppWriter::phiCopies(const llvm::BasicBlock *from, const llvm::BasicBlock *to) {
+    std::string copies;
+    for (const llvm::PHINode &phi : to->phis())
+        copies += names[&phi] + "_in = " + expr(phi.getIncomingValueForBlock(from)) + "; ";
+    return copies;
+}
+
+std::string InlineCppWriter::branchTo(const llvm::BasicBlock *from, const llvm::BasicBlock *to) {
+    return "{ " + phiCopies(from, to) + "goto " + labels[to] + "; }";
+}
+
+void InlineCppWriter::emitCast(const llvm::Instruction *inst, const std::string &dst) {
+    const llvm::Value *src = inst->getOperand(0);
+    llvm::Type *srcType = src->getType(), *type = inst->getType();
+    std::string x = expr(src), t = typeOf(type);
+    const unsigned op = inst->getOpcode();
+
+    if (op == llvm::Instruction::AddrSpaceCast) {
+        fail("address space casts aren't supported");
+    } else if (srcType->isVectorTy() && srcType->getScalarType()->isPointerTy()) {
+        fail("vectors of pointers aren't supported");
+    } else if (op == llvm::Instruction::PtrToInt) {
+        body += "    " + dst + " = (" + t + ")(uintptr_t)(" + x + ");\n";
+    } else if (op == llvm::Instruction::IntToPtr) {
+        body += "    " + dst + " = (uint8_t *)(uintptr_t)(" + x + ");\n";
+    } else if (op == llvm::Instruction::BitCast) {
+        if (type->isPointerTy())
+            body += "    " + dst + " = " + x + ";\n";
+        else if (lIsMask(srcType) && !type->isVectorTy())
+            body += "    " + dst + " = __ispc_mask_to_bits<" + t + ">(" + x + ");\n";
+        else if (lIsMask(type) && !srcType->isVectorTy())
+            body += "    " + dst + " = __ispc_bits_to_mask<" + t + ">(" + x + ");\n";
+        else if (lIsMask(srcType) || lIsMask(type))
+            fail("bitcast of a mask to a vector isn't supported");
+        else if (srcType->isVectorTy() && type->isVectorTy())
+            body += "    " + dst + " = (" + t + ")(" + x + ");\n";
+        else
+            body += "    " + dst + " = __ispc_bitcast<" + t + ">(" + x + ");\n";
+    } else if (!type->isVectorTy()) {
+        const bool fromBool = srcType->isIntegerTy(1);
+        if (op == llvm::Instruction::Trunc && type->isIntegerTy(1))
+            body += "    " + dst + " = ((" + x + ") & 1) != 0;\n";
+        else if (op == llvm::Instruction::SExt && fromBool)
+            body += "    " + dst + " = (" + t + ")(0u - (" + t + ")(" + x + "));\n";
+        else if (op == llvm::Instruction::SIToFP && fromBool)
+            body += "    " + dst + " = (" + t + ")((" + x + ") ? -1 : 0);\n";
+        else if (op == llvm::Instruction::SExt || op == llvm::Instruction::SIToFP)
+            body += "    " + dst + " = (" + t + ")(" + signedValue(src) + ");\n";
+        else if (op == llvm::Instruction::FPToSI && !type->isIntegerTy(1))
+            body += "    " + dst + " = (" + t + ")(" + typeOf(type, true) + ")(" + x + ");\n";
+        else if (op == llvm::Instruction::FPToSI)
+            fail("conversion of floating point values to i1 isn't supported");
+        else
+            body += "    " + dst + " = (" + t + ")(" + x + ");\n";
+    } else if (lIsMask(srcType)) {
+        // The lanes of a mask are 0 or -1, so the negation gives the zero extension.
+        if (op == llvm::Instruction::ZExt)
+            body += "    " + dst + " = (" + t + ")(-__builtin_convertvector(" + x + ", " + typeOf(type, true) + "));\n";
+        else if (op == llvm::Instruction::SExt)
+            body += "    " + dst + " = (" + t + ")__builtin_convertvector(" + x + ", " + typeOf(type, true) + ");\n";
+        else if (op == llvm::Instruction::UIToFP)
+            body += "    " + dst + " = __builtin_convertvector(-(" + x + "), " + t + ");\n";
+        else if (op == llvm::Instruction::SIToFP)
+            body += "    " + dst + " = __builtin_convertvector(" + x + ", " + t + ");\n";
+        else
+            fail(std::string(inst->getOpcodeName()) + " of a mask isn't supported");
+    } else if (lIsMask(type)) {
+        if (op == llvm::Instruction::Trunc)
+            body += "    " + dst + " = __builtin_convertvector(((" + x + ") & " + splat(srcType, "1") + ") != " +
+                    splat(srcType, "0") + ", " + t + ");\n";
+        else
+            fail(std::string(inst->getOpcodeName()) + " to a mask isn't supported");
+    } else if (op == llvm::Instruction::SExt || op == llvm::Instruction::SIToFP) {
+        body += "    " + dst + " = __builtin_convertvector(" + signedValue(src) + ", " + t + ");\n";
+    } else if (op == llvm::Instruction::FPToSI) {
+        body += "    " + dst + " = (" + t + ")__builtin_convertvector(" + x + ", " + typeOf(type, true) + ");\n";
+    } else {
+        body += "    " + dst + " = __builtin_convertvector(" + x + ", " + t + ");\n";
+    }
+}
+
+void InlineCppWriter::emitCompare(const llvm::Instruction *inst, const std::string &dst) {
+    const llvm::CmpInst *cmp = llvm::cast<llvm::CmpInst>(inst);
+    const llvm::Value *lhs = cmp->getOperand(0), *rhs = cmp->getOperand(1);
+    const bool isVector = inst->getType()->isVectorTy();
+    std::string a = expr(lhs), b = expr(rhs), result;
+    auto binary = [](const std::string &x, const char *op, const std::string &y) {
+        return "(" + x + " " + op + " " + y + ")";
+    };
+    // Comparisons of vectors give lanes of 0 or -1 of the width of their operands.
+    const char *notOp = isVector ? "~" : "!", *orOp = isVector ? "|" : "||", *andOp = isVector ? "&" : "&&";
+
+    switch (cmp->getPredicate()) {
+    case llvm::CmpInst::ICMP_EQ:
+    case llvm::CmpInst::FCMP_OEQ:
+        result = binary(a, "==", b);
+        break;
+    case llvm::CmpInst::ICMP_NE:
+    case llvm::CmpInst::FCMP_UNE:
+        result = binary(a, "!=", b);
+        break;
+    case llvm::CmpInst::ICMP_UGT:
+    case llvm::CmpInst::FCMP_OGT:
+        result = binary(a, ">", b);
+        break;
+    case llvm::CmpInst::ICMP_UGE:
+    case llvm::CmpInst::FCMP_OGE:
+        result = binary(a, ">=", b);
+        break;
+    case llvm::CmpInst::ICMP_ULT:
+    case llvm::CmpInst::FCMP_OLT:
+        result = binary(a, "<", b);
+        break;
+    case llvm::CmpInst::ICMP_ULE:
+    case llvm::CmpInst::FCMP_OLE:
+        result = binary(a, "<=", b);
+        break;
+    case llvm::CmpInst::ICMP_SGT:
+        result = binary(signedValue(lhs), ">", signedValue(rhs));
+        break;
+    case llvm::CmpInst::ICMP_SGE:
+        result = binary(signedValue(lhs), ">=", signedValue(rhs));
+        break;
+    case llvm::CmpInst::ICMP_SLT:
+        result = binary(signedValue(lhs), "<", signedValue(rhs));
+        break;
+    case llvm::CmpInst::ICMP_SLE:
+        result = binary(signedValue(lhs), "<=", signedValue(rhs));
+        break;
+    case llvm::CmpInst::FCMP_ONE:
+        result = binary(binary(a, "<", b), orOp, binary(a, ">", b));
+        break;
+    case llvm::CmpInst::FCMP_ORD:
+        result = binary(binary(a, "==", a), andOp, binary(b, "==", b));
+        break;
+    case llvm::CmpInst::FCMP_UNO:
+        result = binary(binary(a, "!=", a), orOp, binary(b, "!=", b));
+        break;
+    case llvm::CmpInst::FCMP_UEQ:
+        result = notOp + binary(binary(a, "<", b), orOp, binary(a, ">", b));
+        break;
+    case llvm::CmpInst::FCMP_UGT:
+        result = notOp + binary(a, "<=", b);
+        break;
+    case llvm::CmpInst::FCMP_UGE:
+        result = notOp + binary(a, "<", b);
+        break;
+    case llvm::CmpInst::FCMP_ULT:
+        result = notOp + binary(a, ">=", b);
+        break;
+    case llvm::CmpInst::FCMP_ULE:
+        result = notOp + binary(a, ">", b);
+        break;
+    case llvm::CmpInst::FCMP_FALSE:
+        body += "    " + dst + " = " + (isVector ? splat(inst->getType(), "0") : "false") + ";\n";
+        return;
+    case llvm::CmpInst::FCMP_TRUE:
+        body += "    " + dst + " = " + (isVector ? splat(inst->getType(), "-1") : "true") + ";\n";
+        return;
+    default:
+        fail("comparison predicate isn't supported");
+        return;
+    }
+    if (isVector)
+        result = "__builtin_convertvector(" + result + ", " + typeOf(inst->getType()) + ")";
+    body += "    " + dst + " = " + result + ";\n";
+}
+
+/** Returns the expression of an intrinsic applied to scalar arguments of
+    the given type, or an empty string if it isn't handled. */
+std::string InlineCppWriter::laneCall(unsigned id, llvm::Type *type, const std::vector<std::string> &args) {
+    const bool isFloat = type->isFloatTy() || type->isDoubleTy();
+    auto fp = [&](const char *name) {
+        if (!isFloat)
+            return std::string();
+        std::string call = std::string("__builtin_") + name + (type->isFloatTy() ? "f" : "") + "(";
+        for (size_t i = 0; i < args.size(); ++i)
+            call += (i ? ", " : "") + args[i];
+        return call + ")";
+    };
+    if ((!isFloat && !type->isIntegerTy()) || type->isIntegerTy(1))
+        return "";
+    const std::string t = isFloat ? "" : typeOf(type), s = isFloat ? "" : typeOf(type, true);
+    const unsigned bits = type->getPrimitiveSizeInBits();
+    const std::string a = args[0], b = args.size() > 1 ? args[1] : "";
+    const std::string ll = bits == 64 ? "ll" : "";
+    const std::string x = bits == 64 ? a : "(uint32_t)(" + a + ")";
+    switch (id) {
+    case llvm::Intrinsic::sqrt:
+        return fp("sqrt");
+    case llvm::Intrinsic::fabs:
+        return fp("fabs");
+    case llvm::Intrinsic::floor:
+        return fp("floor");
+    case llvm::Intrinsic::ceil:
+        return fp("ceil");
+    case llvm::Intrinsic::trunc:
+        return fp("trunc");
+    case llvm::Intrinsic::round:
+        return fp("round");
+    case llvm::Intrinsic::rint:
+        return fp("rint");
+    case llvm::Intrinsic::nearbyint:
+        return fp("nearbyint");
+    case llvm::Intrinsic::minnum:
+        return fp("fmin");
+    case llvm::Intrinsic::maxnum:
+        return fp("fmax");
+    case llvm::Intrinsic::copysign:
+        return fp("copysign");
+    case llvm::Intrinsic::fma:
+        return fp("fma");
+    case llvm::Intrinsic::smin:
+        return isFloat ? "" : "((" + s + ")(" + a + ") < (" + s + ")(" + b + ") ? " + a + " : " + b + ")";
+    case llvm::Intrinsic::smax:
+        return isFloat ? "" : "((" + s + ")(" + a + ") > (" + s + ")(" + b + ") ? " + a + " : " + b + ")";
+    case llvm::Intrinsic::umin:
+        return isFloat ? "" : "(" + a + " < " + b + " ? " + a + " : " + b + ")";
+    case llvm::Intrinsic::umax:
+        return isFloat ? "" : "(" + a + " > " + b + " ? " + a + " : " + b + ")";
+    case llvm::Intrinsic::abs:
+        return isFloat ? "" : "(" + t + ")((" + s + ")(" + a + ") < 0 ? (" + t + ")0 - " + a + " : " + a + ")";
+    case llvm::Intrinsic::ctpop:
+        return isFloat ? "" : "(" + t + ")__builtin_popcount" + ll + "(" + x + ")";
+    case llvm::Intrinsic::ctlz:
+        return isFloat ? ""
+                       : "(" + t + ")(" + a + " == 0 ? " + std::to_string(bits) + " : __builtin_clz" + ll + "(" + x +
+                             ")" + (bits < 32 ? " - " + std::to_string(32 - bits) : "") + ")";
+    case llvm::Intrinsic::cttz:
+        return isFloat ? ""
+                       : "(" + t + ")(" + a + " == 0 ? " + std::to_string(bits) + " : __builtin_ctz" + ll + "(" + x +
+                             "))";
+    default:
+        return "";
+    }
+}
+
+void InlineCppWriter::emitCall(const llvm::Instruction *inst, const std::string &dst) {
+    const llvm::CallInst *call = llvm::dyn_cast<llvm::CallInst>(inst);
+    const llvm::Function *callee = call ? call->getCalledFunction() : nullptr;
+    if (callee == nullptr) {
+        fail("indirect calls aren't supported");
+        return;
+    }
+    if (llvm::isa<llvm::DbgInfoIntrinsic>(call))
+        return;
+    auto arg = [&](unsigned i) { return expr(call->getArgOperand(i)); };
+    llvm::Type *type = call->getType();
+    const unsigned count = lLaneCount(type);
+    const std::string n = std::to_string(count);
+
+    const llvm::Intrinsic::ID id = callee->getIntrinsicID();
+    switch (id) {
+    case llvm::Intrinsic::lifetime_start:
+    case llvm::Intrinsic::lifetime_end:
+    case llvm::Intrinsic::assume:
+    case llvm::Intrinsic::experimental_noalias_scope_decl:
+    case llvm::Intrinsic::donothing:
+        return;
+    case llvm::Intrinsic::memcpy:
+    case llvm::Intrinsic::memmove:
+        body += std::string("    ") + (id == llvm::Intrinsic::memcpy ? "memcpy(" : "memmove(") + arg(0) + ", " +
+                arg(1) + ", " + arg(2) + ");\n";
+        return;
+    case llvm::Intrinsic::memset:
+        body += "    memset(" + arg(0) + ", (int)" + arg(1) + ", " + arg(2) + ");\n";
+        return;
+    case llvm::Intrinsic::fmuladd:
+        body += "    " + dst + " = " + arg(0) + " * " + arg(1) + " + " + arg(2) + ";\n";
+        return;
+    case llvm::Intrinsic::vector_reduce_add:
+    case llvm::Intrinsic::vector_reduce_mul:
+    case llvm::Intrinsic::vector_reduce_and:
+    case llvm::Intrinsic::vector_reduce_or:
+    case llvm::Intrinsic::vector_reduce_xor:
+    case llvm::Intrinsic::vector_reduce_smax:
+    case llvm::Intrinsic::vector_reduce_smin:
+    case llvm::Intrinsic::vector_reduce_umax:
+    case llvm::Intrinsic::vector_reduce_umin:
+    case llvm::Intrinsic::vector_reduce_fmax:
+    case llvm::Intrinsic::vector_reduce_fmin: {
+        const llvm::Value *vec = call->getArgOperand(0);
+        const std::string v = expr(vec), lanes = std::to_string(lLaneCount(vec->getType()));
+        const std::string lane = lIsMask(vec->getType()) ? "((" + v + ")[i] != 0)" : "(" + v + ")[i]";
+        std::string combined;
+        if (lIsMask(vec->getType())) {
+            // Reductions of i1 are bitwise.
+            if (id == llvm::Intrinsic::vector_reduce_add || id == llvm::Intrinsic::vector_reduce_xor)
+                combined = dst + " ^ " + lane;
+            else if (id == llvm::Intrinsic::vector_reduce_or || id == llvm::Intrinsic::vector_reduce_umax ||
+                     id == llvm::Intrinsic::vector_reduce_smin)
+                combined = dst + " | " + lane;
+            else
+                combined = dst + " & " + lane;
+        } else if (id == llvm::Intrinsic::vector_reduce_fmax || id == llvm::Intrinsic::vector_reduce_fmin) {
+            combined = laneCall(id == llvm::Intrinsic::vector_reduce_fmax ? llvm::Intrinsic::maxnum
+                                                                           : llvm::Intrinsic::minnum,
+                                type, {dst, lane});
+        } else if (id == llvm::Intrinsic::vector_reduce_smax || id == llvm::Intrinsic::vector_reduce_smin ||
+                   id == llvm::Intrinsic::vector_reduce_umax || id == llvm::Intrinsic::vector_reduce_umin) {
+            unsigned minMax = id == llvm::Intrinsic::vector_reduce_smax   ? llvm::Intrinsic::smax
+                              : id == llvm::Intrinsic::vector_reduce_smin ? llvm::Intrinsic::smin
+                              : id == llvm::Intrinsic::vector_reduce_umax ? llvm::Intrinsic::umax
+                                                                          : llvm::Intrinsic::umin;
+            combined = laneCall(minMax, type, {dst, lane});
+        } else {
+            const char *op = id == llvm::Intrinsic::vector_reduce_add   ? " + "
+                             : id == llvm::Intrinsic::vector_reduce_mul ? " * "
+                             : id == llvm::Intrinsic::vector_reduce_and ? " & "
+                             : id == llvm::Intrinsic::vector_reduce_or  ? " | "
+                                                                        : " ^ ";
+            // Narrow operands are promoted to int, where a product may overflow.
+            combined = type->getPrimitiveSizeInBits() < 32
+                           ? "(" + typeOf(type) + ")((uint32_t)" + dst + op + lane + ")"
+                           : dst + op + lane;
+        }
+        if (combined.empty()) {
+            fail("intrinsic \"" + callee->getName().str() + "\" isn't supported");
+            return;
+        }
+        body += "    " + dst + " = " + (lIsMask(vec->getType()) ? "((" + v + ")[0] != 0)" : "(" + v + ")[0]") +
+                ";\n    for (int i = 1; i < " + lanes + "; ++i)\n        " + dst + " = " + combined + ";\n";
+        return;
+    }
+    case llvm::Intrinsic::vector_reduce_fadd:
+    case llvm::Intrinsic::vector_reduce_fmul: {
+        // The lanes are accumulated in order, which is valid with or without reassociation.
+        const llvm::Value *vec = call->getArgOperand(1);
+        body += "    " + dst + " = " + arg(0) + ";\n    for (int i = 0; i < " +
+                std::to_string(lLaneCount(vec->getType())) + "; ++i)\n        " + dst +
+                (id == llvm::Intrinsic::vector_reduce_fadd ? " += (" : " *= (") + expr(vec) + ")[i];\n";
+        return;
+    }
+    case llvm::Intrinsic::masked_load: {
+        const std::string elt = elementType(type);
+        if (lIsMask(type)) {
+            fail("masked load of a mask isn't supported");
+            return;
+        }
+        body += "    " + dst + " = " + arg(3) + ";\n    for (int i = 0; i < " + n + "; ++i)\n        if ((" + arg(2) +
+                ")[i]) { " + elt + " e; memcpy(&e, " + arg(0) + " + i * sizeof(e), sizeof(e)); " + dst +
+                "[i] = e; }\n";
+        return;
+    }
+    case llvm::Intrinsic::masked_store: {
+        llvm::Type *valueType = call->getArgOperand(0)->getType();
+        if (lIsMask(valueType)) {
+            fail("masked store of a mask isn't supported");
+            return;
+        }
+        body += "    for (int i = 0; i < " + std::to_string(lLaneCount(valueType)) + "; ++i)\n        if ((" + arg(3) +
+                ")[i]) { " + elementType(valueType) + " e = (" + arg(0) + ")[i]; memcpy(" + arg(1) +
+                " + i * sizeof(e), &e, sizeof(e)); }\n";
+        return;
+    }
+    case llvm::Intrinsic::not_intrinsic:
+        fail("call of function \"" + callee->getName().str() + "\" isn't inlined");
+        return;
+    default:
+        break;
+    }
+
+    // The sign bits of the lanes select in the x86 mask intrinsics.
+    const std::string name = callee->getName().str();
+    auto signBit = [&](unsigned i) {
+        const llvm::Value *mask = call->getArgOperand(i);
+        std::string sv = vectorType(lLaneCount(mask->getType()), 's', mask->getType()->getScalarSizeInBits());
+        return "((" + sv + ")(" + expr(mask) + "))[i] < 0";
+    };
+    if (name.find("llvm.x86.") == 0 && name.find("movmsk") != std::string::npos) {
+        const llvm::Value *vec = call->getArgOperand(0);
+        std::string sv = vectorType(lLaneCount(vec->getType()), 's', vec->getType()->getScalarSizeInBits());
+        body += "    " + dst + " = __ispc_mask_to_bits<" + typeOf(type) + ">((" + sv + ")(" + expr(vec) + ") < " +
+                sv + "{});\n";
+    } else if (name.find("llvm.x86.") == 0 && name.find(".maskload.") != std::string::npos) {
+        body += "    " + dst + " = " + typeOf(type) + "{};\n    for (int i = 0; i < " + n + "; ++i)\n        if (" +
+                signBit(1) + ") { " + elementType(type) + " e; memcpy(&e, " + arg(0) +
+                " + i * sizeof(e), sizeof(e)); " + dst + "[i] = e; }\n";
+    } else if (name.find("llvm.x86.") == 0 && name.find(".maskstore.") != std::string::npos) {
+        llvm::Type *valueType = call->getArgOperand(2)->getType();
+        body += "    for (int i = 0; i < " + std::to_string(lLaneCount(valueType)) + "; ++i)\n        if (" +
+                signBit(1) + ") { " + elementType(valueType) + " e = (" + arg(2) + ")[i]; memcpy(" + arg(0) +
+                " + i * sizeof(e), &e, sizeof(e)); }\n";
+    } else if (name.find("llvm.x86.") == 0 && name.find("blendv") != std::string::npos) {
+        body += "    for (int i = 0; i < " + n + "; ++i)\n        " + dst + "[i] = " + signBit(2) + " ? (" + arg(1) +
+                ")[i] : (" + arg(0) + ")[i];\n";
+    } else if (name.find("llvm.x86.") == 0 && name.find(".gather.") != std::string::npos) {
+        const std::string index = "(int64_t)(" + signedValue(call->getArgOperand(2)) + ")[i]";
+        body += "    " + dst + " = " + arg(0) + ";\n    for (int i = 0; i < " + n + "; ++i)\n        if (" +
+                signBit(3) + ") { " + elementType(type) + " e; memcpy(&e, " + arg(1) + " + " + index + " * " +
+                arg(4) + ", sizeof(e)); " + dst + "[i] = e; }\n";
+    } else if (name.find("llvm.x86.") == 0 && name.find(".hadd.p") != std::string::npos) {
+        // The sums of pairs of lanes of the first and then the second operand, in each 128 bit half
+        const unsigned perHalf = 128 / type->getScalarSizeInBits();
+        std::string lanes;
+        for (unsigned i = 0; i < count; ++i) {
+            const unsigned half = i / perHalf * perHalf, j = i % perHalf;
+            const std::string src = arg(j < perHalf / 2 ? 0 : 1);
+            const unsigned lane = half + 2 * (j % (perHalf / 2));
+            lanes += (i ? ", " : "") + std::string("(") + src + ")[" + std::to_string(lane) + "] + (" + src + ")[" +
+                     std::to_string(lane + 1) + "]";
+        }
+        body += "    " + dst + " = " + typeOf(type) + "{" + lanes + "};\n";
+    } else if (name.find("llvm.x86.") == 0 &&
+               (name.find(".round.ps") != std::string::npos || name.find(".round.pd") != std::string::npos)) {
+        // The two low bits of the immediate select the rounding, the nearest one being rint() in the default mode.
+        const llvm::ConstantInt *mode = llvm::dyn_cast<llvm::ConstantInt>(call->getArgOperand(1));
+        static const unsigned roundings[] = {llvm::Intrinsic::rint, llvm::Intrinsic::floor, llvm::Intrinsic::ceil,
+                                             llvm::Intrinsic::trunc};
+        if (mode == nullptr || (mode->getZExtValue() & 4))
+            fail("rounding mode of \"" + name + "\" isn't supported");
+        else
+            body += "    for (int i = 0; i < " + n + "; ++i)\n        " + dst + "[i] = " +
+                    laneCall(roundings[mode->getZExtValue() & 3], type->getScalarType(), {"(" + arg(0) + ")[i]"}) +
+                    ";\n";
+    } else if (name.find("llvm.x86.") == 0 &&
+               (name.find(".rcp.ps") != std::string::npos || name.find(".rsqrt.ps") != std::string::npos)) {
+        // The exact values are within the error of the approximations.
+        std::string lane = "(" + arg(0) + ")[i]";
+        if (name.find(".rsqrt.") != std::string::npos)
+            lane = laneCall(llvm::Intrinsic::sqrt, type->getScalarType(), {lane});
+        body += "    for (int i = 0; i < " + n + "; ++i)\n        " + dst + "[i] = 1.0f / " + lane + ";\n";
+    } else {
+        std::vector<std::string> args;
+        for (unsigned i = 0; i < call->arg_size(); ++i)
+            args.push_back(type->isVectorTy() && call->getArgOperand(i)->getType()->isVectorTy()
+                               ? "(" + arg(i) + ")[i]"
+                               : arg(i));
+        std::string lane = laneCall(id, type->getScalarType(), args);
+        if (lane.empty() || type->isVoidTy())
+            fail("intrinsic \"" + name + "\" isn't supported");
+        else if (type->isVectorTy())
+            body += "    for (int i = 0; i < " + n + "; ++i)\n        " + dst + "[i] = " + lane + ";\n";
+        else
+            body += "    " + dst + " = " + lane + ";\n";
+    }
+}
+
+void InlineCppWriter::emitInstruction(const llvm::Instruction *inst) {
+    const std::string dst = inst->getType()->isVoidTy() ? "" : names[inst];
+    llvm::Type *type = inst->getType();
+
+    if (const llvm::BinaryOperator *bin = llvm::dyn_cast<llvm::BinaryOperator>(inst)) {
+        const llvm::Value *lhs = bin->getOperand(0), *rhs = bin->getOperand(1);
+        const unsigned op = bin->getOpcode();
+        const bool isSigned =
+            op == llvm::Instruction::SDiv || op == llvm::Instruction::SRem || op == llvm::Instruction::AShr;
+        const char *sym = nullptr;
+        switch (op) {
+        case llvm::Instruction::Add:
+        case llvm::Instruction::FAdd:
+            sym = "+";
+            break;
+        case llvm::Instruction::Sub:
+        case llvm::Instruction::FSub:
+            sym = "-";
+            break;
+        case llvm::Instruction::Mul:
+        case llvm::Instruction::FMul:
+            sym = "*";
+            break;
+        case llvm::Instruction::UDiv:
+        case llvm::Instruction::SDiv:
+        case llvm::Instruction::FDiv:
+            sym = "/";
+            break;
+        case llvm::Instruction::URem:
+        case llvm::Instruction::SRem:
+            sym = "%";
+            break;
+        case llvm::Instruction::Shl:
+            sym = "<<";
+            break;
+        case llvm::Instruction::LShr:
+        case llvm::Instruction::AShr:
+            sym = ">>";
+            break;
+        case llvm::Instruction::And:
+            sym = "&";
+            break;
+        case llvm::Instruction::Or:
+            sym = "|";
+            break;
+        case llvm::Instruction::Xor:
+            sym = "^";
+            break;
+        default:
+            break;
+        }
+        const std::string a = expr(lhs), b = expr(rhs), t = typeOf(type);
+        if (op == llvm::Instruction::FRem) {
+            std::string fmod = type->getScalarType()->isFloatTy() ? "__builtin_fmodf" : "__builtin_fmod";
+            if (type->isVectorTy())
+                body += "    for (int i = 0; i < " + std::to_string(lLaneCount(type)) + "; ++i)\n        " + dst +
+                        "[i] = " + fmod + "((" + a + ")[i], (" + b + ")[i]);\n";
+            else
+                body += "    " + dst + " = " + fmod + "(" + a + ", " + b + ");\n";
+        } else if (sym == nullptr || (type->getScalarType()->isIntegerTy(1) && op != llvm::Instruction::And &&
+                                      op != llvm::Instruction::Or && op != llvm::Instruction::Xor)) {
+            fail(std::string("operator ") + bin->getOpcodeName() + " isn't supported for " + lTypeString(type));
+        } else if (isSigned) {
+            body += "    " + dst + " = (" + t + ")(" + signedValue(lhs) + " " + sym + " " + signedValue(rhs) + ");\n";
+        } else if (!type->isVectorTy() && type->isIntegerTy() && type->getIntegerBitWidth() < 32 &&
+                   !type->isIntegerTy(1)) {
+            // Narrow operands are promoted to int, where a product may overflow.
+            body += "    " + dst + " = (" + t + ")((uint32_t)" + a + " " + sym + " " + b + ");\n";
+        } else {
+            body += "    " + dst + " = " + a + " " + sym + " " + b + ";\n";
+        }
+        return;
+    }
+
+    switch (inst->getOpcode()) {
+    case llvm::Instruction::FNeg:
+        body += "    " + dst + " = -" + expr(inst->getOperand(0)) + ";\n";
+        break;
+    case llvm::Instruction::Freeze:
+        body += "    " + dst + " = " + expr(inst->getOperand(0)) + ";\n";
+        break;
+    case llvm::Instruction::ICmp:
+    case llvm::Instruction::FCmp:
+        emitCompare(inst, dst);
+        break;
+    case llvm::Instruction::Trunc:
+    case llvm::Instruction::ZExt:
+    case llvm::Instruction::SExt:
+    case llvm::Instruction::FPTrunc:
+    case llvm::Instruction::FPExt:
+    case llvm::Instruction::FPToUI:
+    case llvm::Instruction::FPToSI:
+    case llvm::Instruction::UIToFP:
+    case llvm::Instruction::SIToFP:
+    case llvm::Instruction::PtrToInt:
+    case llvm::Instruction::IntToPtr:
+    case llvm::Instruction::BitCast:
+    case llvm::Instruction::AddrSpaceCast:
+        emitCast(inst, dst);
+        break;
+    case llvm::Instruction::Select: {
+        const llvm::Value *cond = inst->getOperand(0);
+        const std::string c = expr(cond), a = expr(inst->getOperand(1)), b = expr(inst->getOperand(2));
+        if (!cond->getType()->isVectorTy()) {
+            body += "    " + dst + " = " + c + " ? " + a + " : " + b + ";\n";
+            break;
+        }
+        // Blend the bits with the mask widened to the lanes of the values.
+        std::string bits = lIsMask(type) ? typeOf(type) : vectorType(lLaneCount(type), 'u',
+                                                                      type->getScalarSizeInBits());
+        std::string m = lIsMask(type) ? c : "(" + bits + ")__builtin_convertvector(" + c + ", " +
+                                                 vectorType(lLaneCount(type), 's', type->getScalarSizeInBits()) +
+                                                 ")";
+        body += "    " + dst + " = (" + typeOf(type) + ")(((" + bits + ")(" + a + ") & " + m + ") | ((" + bits +
+                ")(" + b + ") & ~" + m + "));\n";
+        break;
+    }
+    case llvm::Instruction::ExtractElement: {
+        const llvm::Value *vec = inst->getOperand(0);
+        std::string lane = "(" + expr(vec) + ")[" + expr(inst->getOperand(1)) + "]";
+        body += "    " + dst + " = " + (lIsMask(vec->getType()) ? lane + " != 0" : lane) + ";\n";
+        break;
+    }
+    case llvm::Instruction::InsertElement: {
+        std::string elt = expr(inst->getOperand(1));
+        body += "    " + dst + " = " + expr(inst->getOperand(0)) + ";\n    " + dst + "[" + expr(inst->getOperand(2)) +
+                "] = " + (lIsMask(type) ? "(" + elt + ") ? -1 : 0" : elt) + ";\n";
+        break;
+    }
+    case llvm::Instruction::ShuffleVector: {
+        const llvm::ShuffleVectorInst *shuf = llvm::cast<llvm::ShuffleVectorInst>(inst);
+        const int count = (int)lLaneCount(shuf->getOperand(0)->getType());
+        const std::string a = expr(shuf->getOperand(0)), b = expr(shuf->getOperand(1));
+        std::string lanes;
+        int i = 0;
+        for (int idx : shuf->getShuffleMask()) {
+            lanes += i++ ? ", " : "";
+            if (idx < 0)
+                lanes += "0";
+            else if (idx < count)
+                lanes += "(" + a + ")[" + std::to_string(idx) + "]";
+            else
+                lanes += "(" + b + ")[" + std::to_string(idx - count) + "]";
+        }
+        body += "    " + dst + " = " + typeOf(type) + "{" + lanes + "};\n";
+        break;
+    }
+    case llvm::Instruction::GetElementPtr: {
+        const llvm::GetElementPtrInst *gep = llvm::cast<llvm::GetElementPtrInst>(inst);
+        if (type->isVectorTy()) {
+            fail("vectors of pointers aren't supported");
+            break;
+        }
+        int64_t offset = 0;
+        std::string address = expr(gep->getPointerOperand());
+        for (auto iter = llvm::gep_type_begin(gep), end = llvm::gep_type_end(gep); iter != end; ++iter) {
+            const llvm::Value *index = iter.getOperand();
+            if (llvm::StructType *st = iter.getStructTypeOrNull()) {
+                unsigned field = (unsigned)llvm::cast<llvm::ConstantInt>(index)->getZExtValue();
+                offset += dl.getStructLayout(st)->getElementOffset(field);
+                continue;
+            }
+            int64_t size = (int64_t)dl.getTypeAllocSize(iter.getIndexedType());
+            if (const llvm::ConstantInt *ci = llvm::dyn_cast<llvm::ConstantInt>(index))
+                offset += ci->getSExtValue() * size;
+            else
+                address += " + (int64_t)" + signedValue(index) + " * " + std::to_string(size);
+        }
+        if (offset != 0)
+            address += " + " + std::to_string(offset);
+        body += "    " + dst + " = " + address + ";\n";
+        break;
+    }
+    case llvm::Instruction::Load: {
+        const llvm::LoadInst *load = llvm::cast<llvm::LoadInst>(inst);
+        if (!load->isSimple())
+            fail("volatile and atomic loads aren't supported");
+        else if (lIsMask(type))
+            fail("load of a mask isn't supported");
+        else if (type->isIntegerTy(1))
+            body += "    { uint8_t b; memcpy(&b, " + expr(load->getPointerOperand()) + ", 1); " + dst +
+                    " = b & 1; }\n";
+        else
+            body += "    memcpy(&" + dst + ", " + expr(load->getPointerOperand()) + ", sizeof(" + dst + "));\n";
+        break;
+    }
+    case llvm::Instruction::Store: {
+        const llvm::StoreInst *store = llvm::cast<llvm::StoreInst>(inst);
+        llvm::Type *valueType = store->getValueOperand()->getType();
+        if (!store->isSimple())
+            fail("volatile and atomic stores aren't supported");
+        else if (lIsMask(valueType))
+            fail("store of a mask isn't supported");
+        else
+            body += "    { " + (valueType->isIntegerTy(1) ? std::string("uint8_t") : typeOf(valueType)) +
+                    " s = " + expr(store->getValueOperand()) + "; memcpy(" + expr(store->getPointerOperand()) +
+                    ", &s, sizeof(s)); }\n";
+        break;
+    }
+    case llvm::Instruction::Alloca:
+        // Declared with the other variables
+        break;
+    case llvm::Instruction::Call:
+        emitCall(inst, dst);
+        break;
+    case llvm::Instruction::Br: {
+        const llvm::BranchInst *br = llvm::cast<llvm::BranchInst>(inst);
+        if (br->isUnconditional())
+            body += "    " + branchTo(inst->getParent(), br->getSuccessor(0)) + "\n";
+        else
+            body += "    if (" + expr(br->getCondition()) + ") " + branchTo(inst->getParent(), br->getSuccessor(0)) +
+                    " else " + branchTo(inst->getParent(), br->getSuccessor(1)) + "\n";
+        break;
+    }
+    case llvm::Instruction::Switch: {
+        const llvm::SwitchInst *sw = llvm::cast<llvm::SwitchInst>(inst);
+        body += "    switch (" + expr(sw->getCondition()) + ") {\n";
+        for (auto &c : sw->cases())
+            body += "    case " + std::to_string(c.getCaseValue()->getZExtValue()) + "ull: " +
+                    branchTo(inst->getParent(), c.getCaseSuccessor()) + "\n";
+        body += "    default: " + branchTo(inst->getParent(), sw->getDefaultDest()) + "\n    }\n";
+        break;
+    }
+    case llvm::Instruction::Ret: {
+        const llvm::ReturnInst *ret = llvm::cast<llvm::ReturnInst>(inst);
+        if (ret->getReturnValue() == nullptr)
+            body += "    return;\n";
+        else
+            body += "    return (" + retType + ")(" + expr(ret->getReturnValue()) + ");\n";
+        break;
+    }
+    case llvm::Instruction::Unreachable:
+        body += "    __builtin_unreachable();\n";
+        break;
+    default:
+        fail(std::string("instruction ") + inst->getOpcodeName() + " isn't supported");
+        break;
+    }
+}
+
+bool InlineCppWriter::AddFunction(const llvm::Function *func, const std::string &signature,
+                                  const std::vector<std::string> &args, const std::string &returnType) {
+    names.clear();
+    labels.clear();
+    globalNames.clear();
+    globals.clear();
+    body.clear();
+    error.clear();
+    retType = returnType;
+
+    std::string decls;
+    if (args.size() != func->arg_size())
+        fail("arguments don't match the declaration");
+    for (const llvm::Argument &arg : func->args()) {
+        std::string name = "a" + std::to_string(arg.getArgNo());
+        names[&arg] = name;
+        if (!arg.use_empty() && arg.getArgNo() < args.size()) {
+            std::string t = typeOf(arg.getType());
+            decls += "    " + t + " " + name + " = (" + t + ")(" + args[arg.getArgNo()] + ");\n";
+        }
+    }
+
+    // All variables are declared first, so that no goto jumps over a declaration.
+    int values = 0;
+    for (const llvm::BasicBlock &bb : *func) {
+        if (&bb != &func->getEntryBlock() && llvm::pred_empty(&bb))
+            continue;
+        if (&bb != &func->getEntryBlock())
+            labels[&bb] = "bb" + std::to_string(labels.size());
+        for (const llvm::Instruction &inst : bb) {
+            if (inst.getType()->isVoidTy())
+                continue;
+            std::string name = "v" + std::to_string(values++);
+            names[&inst] = name;
+            if (const llvm::AllocaInst *alloca = llvm::dyn_cast<llvm::AllocaInst>(&inst)) {
+                const llvm::ConstantInt *count = llvm::dyn_cast<llvm::ConstantInt>(alloca->getArraySize());
+                if (&bb != &func->getEntryBlock() || count == nullptr) {
+                    fail("dynamic allocas aren't supported");
+                    continue;
+                }
+                uint64_t size = dl.getTypeAllocSize(alloca->getAllocatedType()) * count->getZExtValue();
+                decls += "    alignas(" + std::to_string(alloca->getAlign().value()) + ") uint8_t " + name + "_buf[" +
+                         std::to_string(size ? size : 1) + "];\n    uint8_t *" + name + " = " + name + "_buf;\n";
+                continue;
+            }
+            std::string t = typeOf(inst.getType());
+            decls += "    " + t + " " + name + ";\n";
+            if (llvm::isa<llvm::PHINode>(inst))
+                decls += "    " + t + " " + name + "_in;\n";
+        }
+    }
+
+    for (const llvm::BasicBlock &bb : *func) {
+        if (&bb != &func->getEntryBlock() && llvm::pred_empty(&bb))
+            continue;
+        if (&bb != &func->getEntryBlock())
+            body += labels[&bb] + ":\n";
+        for (const llvm::Instruction &inst : bb) {
+            if (llvm::isa<llvm::PHINode>(inst))
+                body += "    " + names[&inst] + " = " + names[&inst] + "_in;\n";
+            else
+                emitInstruction(&inst);
+        }
+    }
+
+    if (!error.empty()) {
+        Error(SourcePos(), "Function \"%s\" can't be written to the inline header: %s.", func->getName().str().c_str(),
+              error.c_str());
+        return false;
+    }
+    functions += "\nstatic inline " + signature + " {\n" + globals + decls + body + "}\n";
+    return true;
+}
+
+std::string InlineCppWriter::GetDefinitions() const {
+    std::string defs = lHelpers;
+    for (const auto &td : typedefs)
+        defs += td.second;
+    return defs + functions;
+}
@@ -0,0 +1,111 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/** @file inline_header.h
+    @brief Writer of the functions of the module as inline C++ functions, so
+           that small exported functions can be inlined into the host code.
+*/
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class BasicBlock;
+class DataLayout;
+class Function;
+class GlobalVariable;
+class Instruction;
+class Type;
+class Value;
+} // namespace llvm
+
+namespace ispc {
+
+/** Translates optimized LLVM functions to C++ built on the vector
+    extensions of GCC and Clang, the varying values being vectors that the
+    host compiler maps to the registers of the target.  Loads and stores go
+    through memcpy(), so the emitted code doesn't depend on the types the
+    application uses for the memory it passes. */
+class InlineCppWriter {
+  public:
+    InlineCppWriter(const llvm::DataLayout &dataLayout);
+
+    /** Appends the definition of the function with the given C++ signature.
+        The args are the C++ expressions that give the value of each of the
+        LLVM arguments, and retType is the C++ type the result is converted
+        to.  Returns false after reporting an error if the function uses
+        something that has no C++ equivalent. */
+    bool AddFunction(const llvm::Function *func, const std::string &signature, const std::vector<std::string> &args,
+                     const std::string &retType);
+
+    /** Returns the helpers, vector types and constant globals used by the
+        functions, followed by the functions. */
+    std::string GetDefinitions() const;
+
+  private:
+    std::string scalarType(llvm::Type *type, bool isSigned = false);
+    std::string vectorType(unsigned count, char kind, unsigned bits);
+    std::string typeOf(llvm::Type *type, bool isSigned = false);
+    std::string elementType(llvm::Type *type, bool isSigned = false);
+    std::string splat(llvm::Type *type, const char *value);
+    std::string signedValue(const llvm::Value *value);
+    std::string expr(const llvm::Value *value);
+    std::string constantExpr(const llvm::Value *value);
+    std::string scalarConstant(const llvm::Value *value, bool inMask);
+    std::string globalExpr(const llvm::GlobalVariable *global);
+    std::string phiCopies(const llvm::BasicBlock *from, const llvm::BasicBlock *to);
+    std::string branchTo(const llvm::BasicBlock *from, const llvm::BasicBlock *to);
+    void emitInstruction(const llvm::Instruction *inst);
+    void emitCast(const llvm::Instruction *inst, const std::string &dst);
+    void emitCompare(const llvm::Instruction *inst, const std::string &dst);
+    void emitCall(const llvm::Instruction *inst, const std::string &dst);
+    std::string laneCall(unsigned id, llvm::Type *type, const std::vector<std::string> &args);
+    void fail(const std::string &what);
+
+    const llvm::DataLayout &dl;
+    std::map<std::string, std::string> typedefs;
+    std::map<const llvm::GlobalVariable *, std::string> globalNames;
+    std::string globals, functions;
+
+    // State of the function being written
+    std::map<const llvm::Value *, std::string> names;
+    std::map<const llvm::BasicBlock *, std::string> labels;
+    std::string body;
+    std::string retType;
+    std::string error;
+};
+
+} // namespace ispc
@@ -64,6 +64,7 @@
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
 #include <llvm/Support/CodeGen.h>
+#include <llvm/Support/CommandLine.h>
 #include <llvm/Support/Host.h>
 #if ISPC_LLVM_VERSION >= ISPC_LLVM_14_0
 #include <llvm/MC/TargetRegistry.h>
@@ -76,8 +77,8 @@
 
 using namespace ispc;
 
-Globals *ispc::g;
-Module *ispc::m;
+thread_local Globals *ispc::g;
+thread_local Module *ispc::m;
 
 ///////////////////////////////////////////////////////////////////////////
 // Target
@@ -258,6 +259,12 @@ static const bool lIsTargetValidforArch(ISPCTarget target, Arch arch) {
     } else if (target == ISPCTarget::neon_i32x4 || target == ISPCTarget::neon_i32x8) {
         if (arch != Arch::arm && arch != Arch::aarch64)
             ret = false;
+    } else if (ISPCTargetIsSve(target)) {
+        if (arch != Arch::aarch64)
+            ret = false;
+    } else if (ISPCTargetIsRvv(target)) {
+        if (arch != Arch::riscv64)
+            ret = false;
     } else if (ISPCTargetIsGen(target)) {
         if (arch != Arch::xe32 && arch != Arch::xe64)
             ret = false;
@@ -355,6 +362,10 @@ typedef enum {
     CPU_CortexA53,
     CPU_CortexA57,
 
+    // Arm CPUs with SVE: Neoverse V1 (256-bit vectors) and A64FX (512-bit vectors).
+    CPU_NeoverseV1,
+    CPU_A64FX,
+
     // Apple CPUs.
     CPU_AppleA7,
     CPU_AppleA10,
@@ -363,6 +374,10 @@ typedef enum {
     CPU_AppleA13,
     CPU_AppleA14,
 #endif
+#ifdef ISPC_RISCV_ENABLED
+    // Generic 64-bit RISC-V core (RV64GC).
+    CPU_GenericRV64,
+#endif
 #ifdef ISPC_XE_ENABLED
     GPU_SKL,
     GPU_TGLLP,
@@ -416,6 +431,8 @@ std::map<DeviceType, std::set<std::string>> CPUFeatures = {
     {CPU_CortexA35, {}},
     {CPU_CortexA53, {}},
     {CPU_CortexA57, {}},
+    {CPU_NeoverseV1, {}},
+    {CPU_A64FX, {}},
     {CPU_AppleA7, {}},
     {CPU_AppleA10, {}},
     {CPU_AppleA11, {}},
@@ -423,6 +440,9 @@ std::map<DeviceType, std::set<std::string>> CPUFeatures = {
     {CPU_AppleA13, {}},
     {CPU_AppleA14, {}},
 #endif
+#ifdef ISPC_RISCV_ENABLED
+    {CPU_GenericRV64, {}},
+#endif
 #ifdef ISPC_XE_ENABLED
     {GPU_SKL, {}},
     {GPU_TGLLP, {}},
@@ -524,6 +544,8 @@ class AllCPUs {
         names[CPU_CortexA35].push_back("cortex-a35");
         names[CPU_CortexA53].push_back("cortex-a53");
         names[CPU_CortexA57].push_back("cortex-a57");
+        names[CPU_NeoverseV1].push_back("neoverse-v1");
+        names[CPU_A64FX].push_back("a64fx");
 
         names[CPU_AppleA7].push_back("apple-a7");
         names[CPU_AppleA10].push_back("apple-a10");
@@ -533,6 +555,10 @@ class AllCPUs {
         names[CPU_AppleA14].push_back("apple-a14");
 #endif
 
+#ifdef ISPC_RISCV_ENABLED
+        names[CPU_GenericRV64].push_back("generic-rv64");
+#endif
+
 #ifdef ISPC_XE_ENABLED
         names[GPU_SKL].push_back("skl");
         names[GPU_TGLLP].push_back("tgllp");
@@ -614,6 +640,8 @@ class AllCPUs {
         compat[CPU_CortexA35] = Set(CPU_CortexA35, CPU_None);
         compat[CPU_CortexA53] = Set(CPU_CortexA53, CPU_None);
         compat[CPU_CortexA57] = Set(CPU_CortexA57, CPU_None);
+        compat[CPU_NeoverseV1] = Set(CPU_NeoverseV1, CPU_None);
+        compat[CPU_A64FX] = Set(CPU_A64FX, CPU_None);
         compat[CPU_AppleA7] = Set(CPU_AppleA7, CPU_None);
         compat[CPU_AppleA10] = Set(CPU_AppleA10, CPU_None);
         compat[CPU_AppleA11] = Set(CPU_AppleA11, CPU_None);
@@ -622,6 +650,10 @@ class AllCPUs {
         compat[CPU_AppleA14] = Set(CPU_AppleA14, CPU_None);
 #endif
 
+#ifdef ISPC_RISCV_ENABLED
+        compat[CPU_GenericRV64] = Set(CPU_GenericRV64, CPU_None);
+#endif
+
 #ifdef ISPC_XE_ENABLED
         compat[GPU_SKL] = Set(GPU_SKL, CPU_None);
         compat[GPU_TGLLP] = Set(GPU_TGLLP, GPU_SKL, CPU_None);
@@ -675,9 +707,10 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, bool pic, boo
       m_isa(SSE2), m_arch(Arch::none), m_is32Bit(true), m_cpu(""), m_attributes(""), m_tf_attributes(NULL),
       m_nativeVectorWidth(-1), m_nativeVectorAlignment(-1), m_dataTypeWidth(-1), m_vectorWidth(-1), m_generatePIC(pic),
       m_maskingIsFree(false), m_maskBitCount(-1), m_hasHalfConverts(false), m_hasHalfFullSupport(false),
-      m_hasRand(false), m_hasGather(false), m_hasScatter(false), m_hasTranscendentals(false), m_hasTrigonometry(false),
-      m_hasRsqrtd(false), m_hasRcpd(false), m_hasVecPrefetch(false), m_hasSaturatingArithmetic(false),
-      m_hasFp16Support(false), m_hasFp64Support(true), m_warnings(0) {
+      m_hasRand(false), m_hasGather(false), m_hasSlowGather(false), m_hasScatter(false), m_hasTranscendentals(false),
+      m_hasTrigonometry(false), m_hasRsqrtd(false), m_hasRcpd(false), m_hasVecPrefetch(false),
+      m_hasSaturatingArithmetic(false), m_hasFp16Support(false), m_hasFp64Support(true), m_warnings(0),
+      m_variantHasWidthSuffix(false) {
     DeviceType CPUID = CPU_None, CPUfromISA = CPU_None;
     AllCPUs a;
     std::string featuresString;
@@ -723,6 +756,18 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, bool pic, boo
         case CPU_AppleA14:
             m_ispc_target = ISPCTarget::neon_i32x4;
             break;
+        case CPU_NeoverseV1:
+            m_ispc_target = ISPCTarget::sve_i32x8;
+            break;
+        case CPU_A64FX:
+            m_ispc_target = ISPCTarget::sve_i32x16;
+            break;
+#endif
+
+#ifdef ISPC_RISCV_ENABLED
+        case CPU_GenericRV64:
+            m_ispc_target = ISPCTarget::rvv_i32x4;
+            break;
 #endif
 
 #ifdef ISPC_XE_ENABLED
@@ -811,6 +856,13 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, bool pic, boo
 #else
             arch = Arch::aarch64;
 #endif
+        } else if (ISPCTargetIsSve(m_ispc_target)) {
+            arch = Arch::aarch64;
+        } else
+#endif
+#ifdef ISPC_RISCV_ENABLED
+            if (ISPCTargetIsRvv(m_ispc_target)) {
+            arch = Arch::riscv64;
         } else
 #endif
 #if ISPC_XE_ENABLED
@@ -861,7 +913,7 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, bool pic, boo
     }
 
     // FP16 support for Xe and Arm. For x86 set is individually for appropriate targets.
-    if (ISPCTargetIsGen(m_ispc_target) || ISPCTargetIsNeon(m_ispc_target)) {
+    if (ISPCTargetIsGen(m_ispc_target) || ISPCTargetIsNeon(m_ispc_target) || ISPCTargetIsSve(m_ispc_target)) {
         m_hasFp16Support = true;
     }
 
@@ -1127,6 +1179,7 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, bool pic, boo
         this->m_funcAttributes.push_back(std::make_pair("min-legal-vector-width", "256"));
         break;
     case ISPCTarget::avx512skx_x16:
+    case ISPCTarget::avx512skx_ymm_x16:
         this->m_isa = Target::SKX_AVX512;
         this->m_nativeVectorWidth = 16;
         this->m_nativeVectorAlignment = 64;
@@ -1142,7 +1195,8 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, bool pic, boo
         this->m_hasRsqrtd = this->m_hasRcpd = true;
         this->m_hasVecPrefetch = false;
         CPUfromISA = CPU_SKX;
-        if (g->opt.disableZMM) {
+        // The ymm variant keeps the gang size and AVX-512 masking, but limits vectors to 256 bits.
+        if (g->opt.disableZMM || m_ispc_target == ISPCTarget::avx512skx_ymm_x16) {
             this->m_funcAttributes.push_back(std::make_pair("prefer-vector-width", "256"));
             this->m_funcAttributes.push_back(std::make_pair("min-legal-vector-width", "256"));
         } else {
@@ -1236,6 +1290,7 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, bool pic, boo
         this->m_funcAttributes.push_back(std::make_pair("min-legal-vector-width", "256"));
         break;
     case ISPCTarget::avx512spr_x16:
+    case ISPCTarget::avx512spr_ymm_x16:
         this->m_isa = Target::SPR_AVX512;
         this->m_nativeVectorWidth = 16;
         this->m_nativeVectorAlignment = 64;
@@ -1253,7 +1308,7 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, bool pic, boo
         this->m_hasVecPrefetch = false;
         this->m_hasFp16Support = true;
         CPUfromISA = CPU_SPR;
-        if (g->opt.disableZMM) {
+        if (g->opt.disableZMM || m_ispc_target == ISPCTarget::avx512spr_ymm_x16) {
             this->m_funcAttributes.push_back(std::make_pair("prefer-vector-width", "256"));
             this->m_funcAttributes.push_back(std::make_pair("min-legal-vector-width", "256"));
         } else {
@@ -1303,6 +1358,7 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, bool pic, boo
     case ISPCTarget::avx512spr_x4:
     case ISPCTarget::avx512spr_x8:
     case ISPCTarget::avx512spr_x16:
+    case ISPCTarget::avx512spr_ymm_x16:
     case ISPCTarget::avx512spr_x32:
     case ISPCTarget::avx512spr_x64:
         unsupported_target = true;
@@ -1360,16 +1416,79 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, bool pic, boo
         this->m_maskingIsFree = (arch == Arch::aarch64);
         this->m_maskBitCount = 32;
         break;
+    // SVE targets use fixed-length SVE code generation: the vector width is
+    // known at compile time and the code runs on any implementation with at
+    // least that many vector bits. The mask is a vector of i1, which maps to
+    // SVE predicate registers.
+    case ISPCTarget::sve_i32x8:
+        this->m_isa = Target::SVE;
+        this->m_nativeVectorWidth = 8;
+        this->m_nativeVectorAlignment = 32;
+        this->m_dataTypeWidth = 32;
+        this->m_vectorWidth = 8;
+        this->m_hasHalfConverts = true;
+        this->m_maskingIsFree = true;
+        this->m_maskBitCount = 1;
+        this->m_hasGather = this->m_hasScatter = true;
+        break;
+    case ISPCTarget::sve_i32x16:
+        this->m_isa = Target::SVE;
+        this->m_nativeVectorWidth = 16;
+        this->m_nativeVectorAlignment = 64;
+        this->m_dataTypeWidth = 32;
+        this->m_vectorWidth = 16;
+        this->m_hasHalfConverts = true;
+        this->m_maskingIsFree = true;
+        this->m_maskBitCount = 1;
+        this->m_hasGather = this->m_hasScatter = true;
+        break;
 #else
     case ISPCTarget::neon_i8x16:
     case ISPCTarget::neon_i16x8:
     case ISPCTarget::neon_i32x4:
     case ISPCTarget::neon_i32x8:
+    case ISPCTarget::sve_i32x8:
+    case ISPCTarget::sve_i32x16:
+        unsupported_target = true;
+        break;
+#endif
+#ifdef ISPC_RISCV_ENABLED
+    // RVV targets use fixed-length code generation as well, assuming VLEN of
+    // at least 128 bits: rvv-i32x4 fills one vector register and rvv-i32x8 a
+    // group of two (LMUL=2). The mask is a vector of i1 held in v0.
+    case ISPCTarget::rvv_i32x4:
+        this->m_isa = Target::RVV;
+        this->m_nativeVectorWidth = 4;
+        this->m_nativeVectorAlignment = 16;
+        this->m_dataTypeWidth = 32;
+        this->m_vectorWidth = 4;
+        this->m_hasHalfConverts = true;
+        this->m_maskingIsFree = true;
+        this->m_maskBitCount = 1;
+        this->m_hasGather = this->m_hasScatter = true;
+        CPUfromISA = CPU_GenericRV64;
+        break;
+    case ISPCTarget::rvv_i32x8:
+        this->m_isa = Target::RVV;
+        this->m_nativeVectorWidth = 8;
+        this->m_nativeVectorAlignment = 32;
+        this->m_dataTypeWidth = 32;
+        this->m_vectorWidth = 8;
+        this->m_hasHalfConverts = true;
+        this->m_maskingIsFree = true;
+        this->m_maskBitCount = 1;
+        this->m_hasGather = this->m_hasScatter = true;
+        CPUfromISA = CPU_GenericRV64;
+        break;
+#else
+    case ISPCTarget::rvv_i32x4:
+    case ISPCTarget::rvv_i32x8:
         unsupported_target = true;
         break;
 #endif
 #ifdef ISPC_WASM_ENABLED
     case ISPCTarget::wasm_i32x4:
+    case ISPCTarget::wasm_relaxed_i32x4:
         this->m_isa = Target::WASM;
         this->m_nativeVectorWidth = 4;
         this->m_nativeVectorAlignment = 16;
@@ -1387,8 +1506,30 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, bool pic, boo
         this->m_hasGather = false;
         this->m_hasVecPrefetch = false;
         break;
+    case ISPCTarget::wasm_i32x8:
+    case ISPCTarget::wasm_relaxed_i32x8:
+        this->m_isa = Target::WASM;
+        this->m_nativeVectorWidth = 8;
+        this->m_nativeVectorAlignment = 16;
+        this->m_dataTypeWidth = 32;
+        this->m_vectorWidth = 8;
+        this->m_hasHalfConverts = false;
+        this->m_hasHalfFullSupport = true;
+        this->m_maskingIsFree = false;
+        this->m_maskBitCount = 32;
+        this->m_hasTranscendentals = false;
+        this->m_hasTrigonometry = false;
+        this->m_hasRcpd = false;
+        this->m_hasRsqrtd = false;
+        this->m_hasScatter = false;
+        this->m_hasGather = false;
+        this->m_hasVecPrefetch = false;
+        break;
 #else
     case ISPCTarget::wasm_i32x4:
+    case ISPCTarget::wasm_relaxed_i32x4:
+    case ISPCTarget::wasm_i32x8:
+    case ISPCTarget::wasm_relaxed_i32x8:
         unsupported_target = true;
         break;
 #endif
@@ -1588,8 +1729,16 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, bool pic, boo
             UNREACHABLE();
         }
     }
+    if ((CPUID == CPU_None) && ISPCTargetIsSve(m_ispc_target)) {
+        CPUID = (m_ispc_target == ISPCTarget::sve_i32x16) ? CPU_A64FX : CPU_NeoverseV1;
+    }
 #endif
 
+    // The GDS mitigations make the gathers of Skylake through Tiger Lake
+    // slower than loading each lane separately.
+    m_hasSlowGather = m_hasGather && (CPUID == CPU_Skylake || CPUID == CPU_SKX || CPUID == CPU_ICL ||
+                                      CPUID == CPU_ICX || CPUID == CPU_TGL);
+
     if (CPUID == CPU_None) {
         cpu = a.GetDefaultNameFromType(CPUfromISA).c_str();
     } else {
@@ -1639,13 +1788,39 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, bool pic, boo
             }
             featuresString = "+neon,+fp16";
         } else if (arch == Arch::aarch64) {
+            std::string sveFeature = ISPCTargetIsSve(m_ispc_target) ? ",+sve" : "";
             if (g->target_os == TargetOS::custom_linux) {
                 this->m_funcAttributes.push_back(
-                    std::make_pair("target-features", "+aes,+crc,+crypto,+fp-armv8,+neon,+sha2"));
+                    std::make_pair("target-features", "+aes,+crc,+crypto,+fp-armv8,+neon,+sha2" + sveFeature));
             } else {
-                this->m_funcAttributes.push_back(std::make_pair("target-features", "+neon"));
+                this->m_funcAttributes.push_back(std::make_pair("target-features", "+neon" + sveFeature));
+            }
+            featuresString = "+neon" + sveFeature;
+        }
+#endif
+#ifdef ISPC_RISCV_ENABLED
+        if (arch == Arch::riscv64) {
+            // RV64GC with the V extension and the standard hard-float ABI.
+            featuresString = "+m,+a,+f,+d,+c,+v";
+            this->m_funcAttributes.push_back(std::make_pair("target-features", featuresString));
+            options.MCOptions.ABIName = "lp64d";
+            // Older LLVM versions ignore vscale_range on RISC-V and need the minimal
+            // VLEN to be passed as a backend option to lower fixed-length vectors.
+            static bool rvvOptionsParsed = false;
+            if (!rvvOptionsParsed) {
+                const char *args[] = {"ispc (LLVM option parsing)", "-riscv-v-vector-bits-min=128", nullptr};
+                llvm::cl::ParseCommandLineOptions(2, args);
+                rvvOptionsParsed = true;
             }
-            featuresString = "+neon";
+        }
+#endif
+
+#ifdef ISPC_WASM_ENABLED
+        if (arch == Arch::wasm32) {
+            bool relaxed = m_ispc_target == ISPCTarget::wasm_relaxed_i32x4 ||
+                           m_ispc_target == ISPCTarget::wasm_relaxed_i32x8;
+            featuresString = relaxed ? "+simd128,+relaxed-simd" : "+simd128";
+            this->m_funcAttributes.push_back(std::make_pair("target-features", featuresString));
         }
 #endif
 
@@ -1710,8 +1885,17 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, bool pic, boo
         llvm::AttrBuilder *fattrBuilder = new llvm::AttrBuilder();
 #endif
 #ifdef ISPC_ARM_ENABLED
-        if (m_isa == Target::NEON)
+        if (m_isa == Target::NEON || m_isa == Target::SVE)
             fattrBuilder->addAttribute("target-cpu", this->m_cpu);
+        // Fixed-length SVE code generation needs the minimal vector length,
+        // expressed in 128-bit granules. 16 is the architectural maximum.
+        if (m_isa == Target::SVE)
+            fattrBuilder->addVScaleRangeAttr(m_nativeVectorAlignment / 16, 16);
+#endif
+#ifdef ISPC_RISCV_ENABLED
+        // vscale is VLEN / 64 on RISC-V; VLEN is at least 128 and at most 65536 bits.
+        if (m_isa == Target::RVV)
+            fattrBuilder->addVScaleRangeAttr(2, 1024);
 #endif
         for (auto const &f_attr : m_funcAttributes)
             fattrBuilder->addAttribute(f_attr.first, f_attr.second);
@@ -1767,6 +1951,11 @@ bool Target::checkIntrinsticSupport(llvm::StringRef name, SourcePos pos) {
             return false;
         }
         // TODO: Check 'CPUFeatures'.
+    } else if (name.consume_front("riscv.") == true) {
+        if (m_arch != Arch::riscv64) {
+            Error(pos, "LLVM intrinsic \"%s\" supported only on \"riscv64\" target architecture.", name.data());
+            return false;
+        }
     } else if (name.consume_front("wasm.") == true) {
         // TODO: Add Condition in future if relevant.
         // For now, returning 'true'.
@@ -1824,6 +2013,8 @@ std::string Target::GetTripleString() const {
             triple.setArchName("armv7");
         } else if (m_arch == Arch::aarch64) {
             triple.setArchName("aarch64");
+        } else if (m_arch == Arch::riscv64) {
+            triple.setArchName("riscv64");
         } else if (m_arch == Arch::xe32) {
             triple.setArchName("spir");
         } else if (m_arch == Arch::xe64) {
@@ -1842,8 +2033,8 @@ std::string Target::GetTripleString() const {
 #endif
         triple.setVendor(llvm::Triple::VendorType::UnknownVendor);
         triple.setOS(llvm::Triple::OSType::Linux);
-        if (m_arch == Arch::x86 || m_arch == Arch::x86_64 || m_arch == Arch::aarch64 || m_arch == Arch::xe32 ||
-            m_arch == Arch::xe64) {
+        if (m_arch == Arch::x86 || m_arch == Arch::x86_64 || m_arch == Arch::aarch64 || m_arch == Arch::riscv64 ||
+            m_arch == Arch::xe32 || m_arch == Arch::xe64) {
             triple.setEnvironment(llvm::Triple::EnvironmentType::GNU);
         } else if (m_arch == Arch::arm) {
             triple.setEnvironment(llvm::Triple::EnvironmentType::GNUEABIHF);
@@ -1955,6 +2146,12 @@ const char *Target::ISAToString(ISA isa) {
 #ifdef ISPC_ARM_ENABLED
     case Target::NEON:
         return "neon";
+    case Target::SVE:
+        return "sve";
+#endif
+#ifdef ISPC_RISCV_ENABLED
+    case Target::RVV:
+        return "rvv";
 #endif
 #ifdef ISPC_WASM_ENABLED
     case Target::WASM:
@@ -2000,6 +2197,12 @@ const char *Target::ISAToTargetString(ISA isa) {
 #ifdef ISPC_ARM_ENABLED
     case Target::NEON:
         return "neon-i32x4";
+    case Target::SVE:
+        return "sve-i32x8";
+#endif
+#ifdef ISPC_RISCV_ENABLED
+    case Target::RVV:
+        return "rvv-i32x4";
 #endif
 #ifdef ISPC_WASM_ENABLED
     case Target::WASM:
@@ -2037,6 +2240,14 @@ const char *Target::ISAToTargetString(ISA isa) {
 
 const char *Target::GetISATargetString() const { return ISAToTargetString(m_isa); }
 
+std::string Target::GetVariantString() const {
+    std::string variant{GetISAString()};
+    if (m_variantHasWidthSuffix) {
+        variant += "_x" + std::to_string(m_vectorWidth);
+    }
+    return variant;
+}
+
 llvm::Value *Target::SizeOf(llvm::Type *type, llvm::BasicBlock *insertAtEnd) {
     uint64_t byteSize = getDataLayout()->getTypeStoreSize(type);
     if (m_is32Bit || g->opt.force32BitAddressing)
@@ -2178,6 +2389,19 @@ bool Target::hasXePrefetch() const {
     }
     return false;
 }
+
+bool Target::hasXeBlock2D() const { return getXePlatform() == XePlatform::xe_hpc; }
+
+bool Target::hasXeDPAS() const {
+    switch (getXePlatform()) {
+    case XePlatform::xe_hpg:
+        return m_vectorWidth == 8;
+    case XePlatform::xe_hpc:
+        return m_vectorWidth == 16;
+    default:
+        return false;
+    }
+}
 #endif
 
 ///////////////////////////////////////////////////////////////////////////
@@ -2189,6 +2413,9 @@ Opt::Opt() {
     fastMaskedVload = false;
     force32BitAddressing = true;
     unrollLoops = true;
+    autoPrefetchDistance = 0;
+    loopVersioning = false;
+    profileGenerate = false;
     disableAsserts = false;
     disableFMA = false;
     forceAlignedMemory = false;
@@ -2196,6 +2423,7 @@ Opt::Opt() {
     disableHandlePseudoMemoryOps = false;
     disableBlendedMaskedStores = false;
     disableCoherentControlFlow = false;
+    autoCoherentControlFlow = false;
     disableUniformControlFlow = false;
     disableGatherScatterOptimizations = false;
     disableMaskedStoreToStore = false;
@@ -2204,10 +2432,15 @@ Opt::Opt() {
     disableCoalescing = false;
     disableZMM = false;
     resetFTZ_DAZ = false;
+    gatherStrategy = GatherStrategy::Auto;
+    disableTargetMerging = false;
+    disableLoopFusion = false;
+    disableUniformHoisting = false;
 #ifdef ISPC_XE_ENABLED
     disableXeGatherCoalescing = false;
     thresholdForXeGatherCoalescing = 0;
     buildLLVMLoadsOnXeGatherCoalescing = false;
+    disableXeBlock2D = false;
     enableForeachInsideVarying = false;
     emitXeHardwareMask = false;
     enableXeUnsafeMaskedLoad = false;
@@ -2217,6 +2450,35 @@ Opt::Opt() {
 ///////////////////////////////////////////////////////////////////////////
 // Globals
 
+llvm::LLVMContext *Globals::CreateLLVMContext() const {
+    llvm::LLVMContext *newCtx = new llvm::LLVMContext;
+
+// Opaque pointers mode is supported starting from LLVM 14,
+// became default in LLVM 15
+#ifdef ISPC_OPAQUE_PTR_MODE
+#if ISPC_LLVM_VERSION >= ISPC_LLVM_15_0
+// Do nothing, opaque pointers mode is default
+#elif ISPC_LLVM_VERSION == ISPC_LLVM_14_0
+    // Explicitly enable opaque pointers mode for LLVM 14.0
+    newCtx->setOpaquePointers(true);
+#else
+    FATAL("Opaque pointers mode is not supported with this LLVM version!");
+#endif
+#else
+#if ISPC_LLVM_VERSION >= ISPC_LLVM_15_0
+    // Explicitly disable opaque pointers starting LLVM 15.0
+    newCtx->setOpaquePointers(false);
+#endif
+#endif
+
+
+    // Inherit the user-visible settings from the global context, if it's already there.
+    if (ctx != nullptr) {
+        newCtx->setDiscardValueNames(ctx->shouldDiscardValueNames());
+    }
+    return newCtx;
+}
+
 Globals::Globals() {
     target_registry = TargetLibRegistry::getTargetLibRegistry();
 
@@ -2230,8 +2492,13 @@ Globals::Globals() {
     debugPrint = false;
     astDump = Globals::ASTDumpKind::None;
     dumpFile = false;
+    printPassStats = false;
+    reportCost = false;
+    saveOptRecord = false;
+    optRecordFormat = "yaml";
     printTarget = false;
     NoOmitFramePointer = false;
+    customAllocator = false;
     debugIR = -1;
     disableWarnings = false;
     warningsAsErrors = false;
@@ -2240,42 +2507,38 @@ Globals::Globals() {
     disableLineWrap = false;
     emitPerfWarnings = true;
     emitInstrumentation = false;
+    emitPerfCounters = false;
+    asyncPrint = false;
     noPragmaOnce = false;
+    emitSoAHelpers = false;
+    emitLTO = false;
     generateDebuggingSymbols = false;
+    debugLineTablesOnly = false;
     generateDWARFVersion = 3;
     enableFuzzTest = false;
     enableLLVMIntrinsics = false;
+    lazyBuiltins = false;
     fuzzTestSeed = -1;
     mangleFunctionsWithTarget = false;
     isMultiTargetCompilation = false;
+    parallelTargetCompile = false;
+    dispatchOnce = false;
+    flushDenormals = false;
+    codegenThreads = 1;
     errorLimit = -1;
 
     enableTimeTrace = false;
     // set default granularity to 500.
     timeTraceGranularity = 500;
     target = NULL;
-    ctx = new llvm::LLVMContext;
-
-// Opaque pointers mode is supported starting from LLVM 14,
-// became default in LLVM 15
-#ifdef ISPC_OPAQUE_PTR_MODE
-#if ISPC_LLVM_VERSION >= ISPC_LLVM_15_0
-// Do nothing, opaque pointers mode is default
-#elif ISPC_LLVM_VERSION == ISPC_LLVM_14_0
-    // Explicitly enable opaque pointers mode for LLVM 14.0
-    ctx->setOpaquePointers(true);
-#else
-    FATAL("Opaque pointers mode is not supported with this LLVM version!");
-#endif
-#else
-#if ISPC_LLVM_VERSION >= ISPC_LLVM_15_0
-    // Explicitly disable opaque pointers starting LLVM 15.0
-    ctx->setOpaquePointers(false);
-#endif
-#endif
+    ctx = nullptr;
+    ctx = CreateLLVMContext();
 
 #ifdef ISPC_XE_ENABLED
     stackMemSize = 0;
+    xeKernelReport = false;
+    xeAutoWidth = false;
+    xeKernelsSpill = false;
 #endif
 
 #ifdef ISPC_HOST_IS_WINDOWS
@@ -2354,5 +2617,17 @@ BookKeeper &BookKeeper::in() {
     return instance;
 }
 
-// Traverse all bookkeeped objects and call delete for every one.
-void BookKeeper::freeAll() { BookKeeper::in().freeOne<Traceable>(); }
+void *BookKeeper::allocatePersistent(size_t size) {
+    void *p = ::operator new(size);
+    persistent.push_back(static_cast<Traceable *>(p));
+    return p;
+}
+
+// Traverse all bookkeeped objects and call destructor for every one, then
+// release the memory of the arena.
+void BookKeeper::freeAll() {
+    for (Traceable *p : BookKeeper::in().persistent)
+        p->ResetCaches();
+    BookKeeper::in().freeOne<Traceable>();
+    BookKeeper::in().arena.Reset();
+}
@@ -51,6 +51,7 @@
 #define ISPC_HOST_IS_APPLE
 #endif
 
+#include <cstddef>
 #include <map>
 #include <set>
 #include <stdint.h>
@@ -63,6 +64,7 @@
 #include <llvm/ADT/APFloat.h>
 #endif
 #include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Allocator.h>
 
 /** @def ISPC_MAX_NVEC maximum vector size of any of the compliation
     targets.
@@ -108,18 +110,22 @@ class ExprList;
 class Function;
 class FunctionTemplate;
 class FunctionType;
+struct LaunchHints;
 class Module;
+struct ParallelReduction;
 class PointerType;
 class Stmt;
 class Symbol;
 class SymbolTable;
+class TemplateArg;
 class TemplateInstantiation;
+class TemplateParam;
 class TemplateParms;
 class TemplateSymbol;
 class Type;
 struct VariableDeclaration;
 
-enum StorageClass { SC_NONE, SC_EXTERN, SC_STATIC, SC_TYPEDEF, SC_EXTERN_C, SC_EXTERN_SYCL };
+enum StorageClass { SC_NONE, SC_EXTERN, SC_STATIC, SC_TYPEDEF, SC_EXTERN_C, SC_EXTERN_SYCL, SC_SHARED };
 
 // Enumerant for address spaces.
 enum class AddressSpace {
@@ -207,6 +213,10 @@ class Target {
         SPR_AVX512 = 6,
 #ifdef ISPC_ARM_ENABLED
         NEON,
+        SVE,
+#endif
+#ifdef ISPC_RISCV_ENABLED
+        RVV,
 #endif
 #ifdef ISPC_WASM_ENABLED
         WASM,
@@ -262,6 +272,15 @@ class Target {
         This may be used for Target initialization. */
     const char *GetISATargetString() const;
 
+    /** Returns a string like "avx512skx" or, when several vector widths of
+        the same ISA are compiled together, "avx512skx_x16". It is used to
+        name the target-specific variants of exported functions and the
+        per-target output files in multi-target compilation. */
+    std::string GetVariantString() const;
+
+    /** Requests that the vector width is appended to the variant string. */
+    void setVariantHasWidthSuffix(bool value) { m_variantHasWidthSuffix = value; }
+
     /** Returns the size of the given type */
     llvm::Value *SizeOf(llvm::Type *type, llvm::BasicBlock *insertAtEnd);
 
@@ -307,6 +326,13 @@ class Target {
     XePlatform getXePlatform() const;
     uint32_t getXeGrfSize() const;
     bool hasXePrefetch() const;
+
+    /** Returns true if the Xe platform has 2D block load and store messages. */
+    bool hasXeBlock2D() const;
+
+    /** Returns true if the Xe platform has DPAS instructions with an
+        execution size equal to the gang size. */
+    bool hasXeDPAS() const;
 #endif
 
     Arch getArch() const { return m_arch; }
@@ -337,6 +363,8 @@ class Target {
 
     bool hasGather() const { return m_hasGather; }
 
+    bool hasSlowGather() const { return m_hasSlowGather; }
+
     bool hasScatter() const { return m_hasScatter; }
 
     bool hasTranscendentals() const { return m_hasTranscendentals; }
@@ -449,6 +477,11 @@ class Target {
     /** Indicates whether the target has a native gather instruction */
     bool m_hasGather;
 
+    /** Indicates whether the native gather instructions of the CPU given
+        with --cpu are slower than scalar loads, as with the microcode
+        mitigations of the GDS ("Downfall") vulnerability. */
+    bool m_hasSlowGather;
+
     /** Indicates whether the target has a native scatter instruction */
     bool m_hasScatter;
 
@@ -479,6 +512,9 @@ class Target {
 
     /** A bitset of PerfWarningType values indicating the warnings that are relevant for the target. */
     PerfWarningTypeUnderlyingType m_warnings;
+
+    /** Indicates whether the vector width is a part of the variant string. */
+    bool m_variantHasWidthSuffix;
 };
 
 /** @brief Structure that collects optimization options
@@ -508,6 +544,29 @@ struct Opt {
         it will make sense. */
     bool unrollLoops;
 
+    /** Number of loop iterations ahead that software prefetches are
+        inserted for strided loads and gathers in loops; zero (the default)
+        disables automatic prefetching. */
+    int autoPrefetchDistance;
+
+    /** Indicates whether innermost loops should be versioned on a runtime
+        check that the arrays they access are aligned and don't overlap,
+        with a fast version of the loop that takes advantage of that.
+        This is false by default. */
+    bool loopVersioning;
+
+    /** Indicates whether the generated code should be instrumented to
+        collect execution counts for profile-guided optimization. */
+    bool profileGenerate;
+
+    /** File the instrumented code writes its raw profile to; the
+        profiling runtime's default is used if empty. */
+    std::string profileGenerateFile;
+
+    /** Indexed profile (.profdata) with execution counts that guide
+        optimization, or empty if none is used. */
+    std::string profileUseFile;
+
     /** Indicates if addressing math will be done with 32-bit math, even on
         64-bit systems.  (This is generally noticably more efficient,
         though at the cost of addressing >2GB).
@@ -555,6 +614,12 @@ struct Opt {
         of coherent control flow. */
     bool disableCoherentControlFlow;
 
+    /** If enabled, varying "if" statements and loops whose bodies are
+        estimated to be expensive enough are compiled like their coherent
+        counterparts ("cif", "cfor", etc.), with a runtime check for the
+        mask being all on and a separate copy of the code for that case. */
+    bool autoCoherentControlFlow;
+
     /** Disables uniform control flow optimizations (e.g. this changes an
         "if" statement with a uniform condition to have a varying
         condition).  This is likely only useful for measuring the impact of
@@ -597,6 +662,24 @@ struct Opt {
         upon return to "host" code.*/
     bool resetFTZ_DAZ;
 
+    /** Whether gathers use the native gather instructions of the target or
+        are emulated with a scalar load for each lane.  With Auto, they're
+        emulated when the --cpu has slow gather instructions. */
+    enum class GatherStrategy { Auto, Native, Emulated };
+    GatherStrategy gatherStrategy;
+
+    /** Disables calling the exported functions of a lower ISA instead of
+        identical ones of higher ISAs in multi-target compilation. */
+    bool disableTargetMerging;
+
+    /** Disables fusing adjacent "foreach" loops over the same range into
+        a single loop. */
+    bool disableLoopFusion;
+
+    /** Disables computing the invariant uniform expressions of loops before
+        the loops, and the repeated ones of functions once, in the AST. */
+    bool disableUniformHoisting;
+
 #ifdef ISPC_XE_ENABLED
     /** Disables optimization that coalesce gathers on Xe. This is
         likely only useful for measuring the impact of this optimization */
@@ -612,6 +695,10 @@ struct Opt {
         vectorized llvm loads instead of block ld intrinsics. */
     bool buildLLVMLoadsOnXeGatherCoalescing;
 
+    /** Disables lowering of gathers and scatters accessing 2D tiles of
+        memory into 2D block loads and stores on Xe. */
+    bool disableXeBlock2D;
+
     /** Enables experimental support of foreach statement inside varying CF.
         Current implementation brings performance degradation due to ineffective
         implementation of unmasked.*/
@@ -641,6 +728,10 @@ struct Opt {
 struct Globals {
     Globals();
 
+    /** Creates a new LLVMContext configured the same way as the global one
+        (pointers mode, value names discarding). The caller owns it. */
+    llvm::LLVMContext *CreateLLVMContext() const;
+
     /** TargetRegistry holding all stdlib bitcode. */
     TargetLibRegistry *target_registry;
 
@@ -698,6 +789,10 @@ struct Globals {
     /** When \c true, LLVM won't omit frame pointer. */
     bool NoOmitFramePointer;
 
+    /** When \c true, "new" and "delete" call ISPCMalloc() and ISPCFree()
+        provided by the application instead of the C library. */
+    bool customAllocator;
+
     /** Indicates which stages of optimization we want to dump. */
     std::set<int> debug_stages;
 
@@ -707,6 +802,27 @@ struct Globals {
     /** Store the path to directory for IR file dumps. */
     std::string dumpFilePath;
 
+    /** Whether to print statistics of optimization phases. */
+    bool printPassStats;
+
+    /** File to append statistics of optimization phases to, stderr is used if empty. */
+    std::string passStatsFile;
+
+    /** Whether to print the estimated cost of the loops of the optimized code. */
+    bool reportCost;
+
+    /** File to append the cost report to, stderr is used if empty. */
+    std::string costReportFile;
+
+    /** Whether to write optimization remarks of ISPC passes to a file. */
+    bool saveOptRecord;
+
+    /** File to write optimization remarks to. */
+    std::string optRecordFile;
+
+    /** Format of the optimization remarks file, "yaml" or "bitstream". */
+    std::string optRecordFormat;
+
     /** Indicates after which optimization we want to generate
         DebugIR information. */
     int debugIR;
@@ -741,6 +857,20 @@ struct Globals {
         manual.) */
     bool emitInstrumentation;
 
+    /** Indicates whether exported functions should call
+        ISPCPerfCountersBegin() on entry and ISPCPerfCountersEnd() on exit,
+        so that the runtime can read hardware performance counters around
+        them. (See "Measuring Exported Functions With Hardware Performance
+        Counters" in the performance guide.) */
+    bool emitPerfCounters;
+
+    /** Indicates whether print statements should call ISPCPrint(), which
+        buffers the values printed and formats them on another thread,
+        instead of __do_print(), and whether failing assertions should call
+        ISPCPrintFlush() first. (See "Output Functions" in the user's
+        manual.) */
+    bool asyncPrint;
+
 #ifdef ISPC_XE_ENABLED
     /** Arguments to pass to Vector Compiler backend for offline
     compilation to L0 binary */
@@ -748,14 +878,43 @@ struct Globals {
 
     /* Stateless stack memory size in VC backend */
     unsigned int stackMemSize;
+
+    /** Whether to print the register usage of the kernels of L0 binaries. */
+    bool xeKernelReport;
+
+    /** File to append the kernel report to, stderr is used if empty. */
+    std::string xeKernelReportFile;
+
+    /** Whether to compile for the narrower variant of the Xe target if the
+        kernels spill registers at the requested width. */
+    bool xeAutoWidth;
+
+    /** Set if registers are spilled by any kernel of the last L0 binary. */
+    bool xeKernelsSpill;
 #endif
 
     bool noPragmaOnce;
 
+    /** Indicates whether the header includes C++ templates for the SoA
+        layouts of the structs in it. */
+    bool emitSoAHelpers;
+
+    /** File to write the C++ header with wrappers of the exported functions
+        to, none is written if empty. */
+    std::string cppHeaderFile;
+
+    /** Indicates whether the bitcode output is meant for ThinLTO with the
+        host code, so it carries a module summary. */
+    bool emitLTO;
+
     /** Indicates whether ispc should generate debugging symbols for the
         program in its output. */
     bool generateDebuggingSymbols;
 
+    /** Indicates whether the debugging symbols are limited to line tables,
+        skipping the debug information for types and variables. */
+    bool debugLineTablesOnly;
+
     /** Require generation of DWARF of certain version (2, 3, 4). For
         default version, this field is set to 0. */
     // Hint: to verify dwarf version in the object file, run on Linux:
@@ -776,6 +935,10 @@ struct Globals {
     /* If enabled, allows the user to directly call LLVM intrinsics. */
     bool enableLLVMIntrinsics;
 
+    /** If true, builtins libraries are loaded lazily and only functions
+        referenced by the program are linked into the module. */
+    bool lazyBuiltins;
+
     /** Seed for random number generator used for fuzz testing. */
     int fuzzTestSeed;
 
@@ -809,9 +972,34 @@ struct Globals {
     /* If true, we are compiling for more than one target. */
     bool isMultiTargetCompilation;
 
+    /* When true, code generation for a target in multi-target compilation
+       runs in a separate thread, while the next target is being compiled.
+       Each target gets its own LLVMContext in this mode. */
+    bool parallelTargetCompile;
+
+    /* When true, the dispatch functions of multi-target compilation select
+       the target-specific variant only once: they are emitted as GNU ifuncs
+       on ELF targets and jump through a function pointer which is set on
+       the first call elsewhere. */
+    bool dispatchOnce;
+
+    /* When true (--denormals=flush), the functions called by the
+       application set the flush-to-zero and denormals-are-zero modes of
+       the CPU on entry and restore them on return, unless they're declared
+       with __declspec(denormals(preserve)). */
+    bool flushDenormals;
+
+    /* Number of threads for code generation of object file. When greater
+       than one, the module is split into this number of partitions, which
+       are code generated in parallel and linked into one object file. */
+    int codegenThreads;
+
     /* Number of errors to show in ISPC. */
     int errorLimit;
 
+    /* Directory of the compilation cache. Empty if caching is disabled. */
+    std::string cacheDir;
+
     /* When true, enable compile time tracing. */
     bool enableTimeTrace;
 
@@ -849,17 +1037,54 @@ enum {
     COST_ASSERT = 8,
 
     CHECK_MASK_AT_FUNCTION_START_COST = 16,
+    AUTO_COHERENT_CONTROL_FLOW_COST = 16,
     PREDICATE_SAFE_IF_STATEMENT_COST = 6,
     // For Xe target we want to avoid branches as much as possible
     // so we use increased cost here
     PREDICATE_SAFE_SHORT_CIRC_XE_STATEMENT_COST = 10,
 };
 
-extern Globals *g;
-extern Module *m;
+/** The state of the compilation running on the current thread: the
+    options and the target in g and the module being compiled in m.  They
+    are thread local, so compilations on different threads don't see each
+    other's state; a thread other than the one running main() has no state
+    until it sets up a CompilationScope. */
+extern thread_local Globals *g;
+extern thread_local Module *m;
+
+/** Sets up the state of a new compilation on the current thread, with the
+    default options in g and no module in m, and restores the previous state
+    of the thread when destroyed.  Note that the objects of the BookKeeper,
+    the parser and the lexer are still shared by all of the threads, so
+    compilations still have to be serialized by the caller. */
+class CompilationScope {
+  public:
+    CompilationScope() : savedGlobals(g), savedModule(m) {
+        g = new Globals;
+        m = nullptr;
+    }
+    ~CompilationScope() {
+        delete g;
+        g = savedGlobals;
+        m = savedModule;
+    }
+    CompilationScope(CompilationScope const &) = delete;
+    void operator=(CompilationScope const &) = delete;
+
+  private:
+    Globals *savedGlobals;
+    Module *savedModule;
+};
+
+class Traceable;
 
 // Singleton object for bookkeeping heap objects to destroy them later to
-// avoid memory leak.
+// avoid memory leak. The objects are allocated from the arena, which is
+// cheaper than allocating each of them on the heap and keeps the objects
+// created together (e.g. AST of a function) close to each other in memory.
+// The objects that live as long as the process (the predefined types) are
+// allocated on the heap instead and survive freeAll(), so that the process
+// can run several compilations (e.g. with the ispc_jit library).
 class BookKeeper {
   private:
     BookKeeper() {}
@@ -872,11 +1097,15 @@ class BookKeeper {
 
     template <typename T> void freeOne() {
         std::vector<T *> &v = getStorage<T>();
+        // The memory belongs to the arena, so only destructors are called.
         for (auto e : v)
-            delete e;
+            e->~T();
         v.clear();
     }
 
+    llvm::BumpPtrAllocator arena;
+    std::vector<Traceable *> persistent;
+
   public:
     static BookKeeper &in();
     BookKeeper(BookKeeper const &) = delete;
@@ -888,14 +1117,34 @@ class BookKeeper {
         return p;
     }
 
-    // Free all bookkeeped objects.
+    // Allocate memory for a bookkeeped object from the arena.
+    void *allocate(size_t size) { return arena.Allocate(size, alignof(std::max_align_t)); }
+
+    // Allocate memory for an object that lives as long as the process.
+    void *allocatePersistent(size_t size);
+
+    // Free all bookkeeped objects and release the memory of the arena.
     void freeAll();
 };
 
 // Base class to inherit for objects needed to be bookkeeped.
 class Traceable {
   public:
-    void *operator new(size_t size) { return BookKeeper::in().add(static_cast<Traceable *>(::operator new(size))); }
+    void *operator new(size_t size) {
+        return BookKeeper::in().add(static_cast<Traceable *>(BookKeeper::in().allocate(size)));
+    }
+    // The memory is released all at once by BookKeeper::freeAll().
+    void operator delete(void *) {}
+
+    // Objects created with "new (Traceable::Persistent) T(...)" live as long
+    // as the process and aren't freed by BookKeeper::freeAll().
+    enum PersistentTag { Persistent };
+    void *operator new(size_t size, PersistentTag) { return BookKeeper::in().allocatePersistent(size); }
+    void operator delete(void *, PersistentTag) {}
+
+    // Drops the references that a persistent object keeps to the objects of
+    // a compilation, before BookKeeper::freeAll() frees them.
+    virtual void ResetCaches() const {}
     virtual ~Traceable() = default;
 };
 } // namespace ispc
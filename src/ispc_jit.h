@@ -0,0 +1,127 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/** @file ispc_jit.h
+    @brief C interface of the ispc_jit library, which compiles ispc source
+           code in the process of the application and returns pointers to
+           the compiled functions.
+
+    A compilation is self-contained: the source is parsed, optimized and
+    compiled to machine code for a single CPU target of the host, and the
+    result is kept alive by the returned ISPCJIT handle.  Compilations are
+    serialized, as the compiler keeps its state in global variables, but
+    any thread may call these functions.  Diagnostics are printed to the
+    standard error stream, as they are by the ispc executable.
+
+    The generated code resolves calls to external functions, such as the
+    ISPCLaunch(), ISPCSync() and ISPCAlloc() functions of the task system,
+    against the symbols of the process, so they have to be exported by the
+    application (e.g. linked with -rdynamic) or by a loaded shared library.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ISPCJIT_T *ISPCJIT;
+
+/** A uniform parameter of a function that is replaced with a constant
+    before the code is optimized, so that the function is specialized for
+    the value: branches and loops that depend on it are folded and
+    unrolled, and divisions by it become multiplications.  The parameter
+    stays in the signature of the function, but its argument is ignored. */
+typedef struct {
+    /** Name of the function, all of the overloads with the parameter are specialized. */
+    const char *function;
+    /** Name of the parameter. */
+    const char *parameter;
+    /** Non-zero if the parameter has a floating-point type and floatValue
+        is used, intValue is used for integer and bool parameters. */
+    int isFloat;
+    int64_t intValue;
+    double floatValue;
+} ISPCJITBinding;
+
+/** Options of a compilation, ispcJITOptionsInit() sets them to the defaults
+    of the ispc executable: the best target of the host CPU and -O2. */
+typedef struct {
+    /** Target ISA and width, e.g. "avx2-i32x8", or NULL for the host default. */
+    const char *target;
+    /** Target CPU, e.g. "skx", or NULL for the host CPU. */
+    const char *cpu;
+    /** Optimization level: 0, 1 or 2 for -O0, -O1 and -O2. */
+    int optLevel;
+    /** Non-zero to enable --opt=fast-math. */
+    int fastMath;
+    /** Preprocessor definitions as given to -D, e.g. "N=8". */
+    const char *const *defines;
+    int numDefines;
+    /** Directories to search #include files in, as given to -I. */
+    const char *const *includePaths;
+    int numIncludePaths;
+    /** Parameters to bind to constants. */
+    const ISPCJITBinding *bindings;
+    int numBindings;
+} ISPCJITOptions;
+
+void ispcJITOptionsInit(ISPCJITOptions *options);
+
+/** Compiles the given ispc source code.  options may be NULL, which
+    selects the defaults.  Returns NULL if the compilation fails.
+
+    The compiled code is cached, keyed by the source and the options,
+    including the values of the bound parameters, and the cached code is
+    returned when the same source is compiled with the same options again.
+    Each returned handle has to be released with ispcJITRelease(). */
+ISPCJIT ispcCompileToJIT(const char *source, const ISPCJITOptions *options);
+
+/** Returns the address of the exported or extern "C" function or global
+    variable with the given name, or NULL if there is no such symbol. */
+void *ispcJITLookup(ISPCJIT jit, const char *name);
+
+/** Releases the handle; pointers returned by ispcJITLookup() are not valid
+    after the last handle of the code is released and the code is removed from
+    the cache. */
+void ispcJITRelease(ISPCJIT jit);
+
+/** Removes all of the compiled code from the cache; the code is freed when
+    its handles are released. */
+void ispcJITClearCache(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,300 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/** @file jit.cpp
+    @brief Implementation of the ispc_jit library (ispc_jit.h), which compiles
+           ispc source code in memory and runs it with LLVM ORC.
+*/
+
+#include "ispc_jit.h"
+#include "ispc.h"
+#include "module.h"
+#include "target_enums.h"
+#include "util.h"
+
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Target/TargetMachine.h>
+
+using namespace ispc;
+
+struct ISPCJIT_T {
+    std::unique_ptr<llvm::orc::LLJIT> jit;
+    // References of the handles returned to the application and of the cache.
+    int refCount{1};
+};
+
+// The state of a compilation in g and m is local to the thread, but the
+// parser and the bookkeeped objects are not, so compilations of all of the
+// threads are serialized by this mutex, which also guards the cache.
+static std::mutex lJITMutex;
+
+// Compiled code by the key of its source and options.
+static std::unordered_map<std::string, ISPCJIT> lJITCache;
+
+// The key covers all of the options that affect the generated code.
+static std::string lCacheKey(const char *source, const ISPCJITOptions &options) {
+    std::string key;
+    auto add = [&key](const std::string &value) {
+        key += value;
+        key += '\0';
+    };
+    add(options.target ? options.target : "");
+    add(options.cpu ? options.cpu : "");
+    add(std::to_string(options.optLevel));
+    add(std::to_string(options.fastMath != 0));
+    for (int i = 0; i < options.numDefines; ++i) {
+        add(std::string("-D") + options.defines[i]);
+    }
+    for (int i = 0; i < options.numIncludePaths; ++i) {
+        add(std::string("-I") + options.includePaths[i]);
+    }
+    for (int i = 0; i < options.numBindings; ++i) {
+        const ISPCJITBinding &binding = options.bindings[i];
+        char value[64];
+        if (binding.isFloat) {
+            // Hexadecimal representation of the value is exact.
+            snprintf(value, sizeof(value), "%a", binding.floatValue);
+        } else {
+            snprintf(value, sizeof(value), "%lld", (long long)binding.intValue);
+        }
+        add(std::string(binding.function) + "(" + binding.parameter + ")=" + value);
+    }
+    key += source;
+    return key;
+}
+
+static void lRelease(ISPCJIT jit) {
+    if (--jit->refCount == 0) {
+        delete jit;
+    }
+}
+
+static void lInitializeJIT() {
+    static std::once_flag initialized;
+    std::call_once(initialized, [] {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+        llvm::InitializeNativeTargetAsmParser();
+    });
+}
+
+static void lSetOptions(const ISPCJITOptions &options) {
+    g->opt.level = options.optLevel > 0 ? 1 : 0;
+    g->opt.disableCoherentControlFlow = options.optLevel == 1;
+    g->codegenOptLevel =
+        options.optLevel > 0 ? Globals::CodegenOptLevel::Aggressive : Globals::CodegenOptLevel::None;
+    g->opt.fastMath = options.fastMath != 0;
+    for (int i = 0; i < options.numDefines; ++i) {
+        g->cppArgs.push_back(std::string("-D") + options.defines[i]);
+    }
+    for (int i = 0; i < options.numIncludePaths; ++i) {
+        g->includePath.push_back(options.includePaths[i]);
+    }
+    g->calling_conv = CallingConv::defaultcall;
+    // Only the builtins that are used are materialized, which is most of the
+    // time of a small compilation otherwise.
+    g->lazyBuiltins = true;
+}
+
+static std::unique_ptr<llvm::orc::LLJIT> lCreateJIT(llvm::TargetMachine *TM) {
+    llvm::orc::JITTargetMachineBuilder JTMB(TM->getTargetTriple());
+    JTMB.setCPU(TM->getTargetCPU().str());
+    llvm::SmallVector<llvm::StringRef, 16> features;
+    TM->getTargetFeatureString().split(features, ",", -1, false);
+    for (llvm::StringRef feature : features) {
+        JTMB.getFeatures().AddFeature(feature);
+    }
+    JTMB.setRelocationModel(llvm::Reloc::PIC_);
+    JTMB.setCodeGenOptLevel(TM->getOptLevel());
+
+    auto jit = llvm::orc::LLJITBuilder().setJITTargetMachineBuilder(std::move(JTMB)).create();
+    if (!jit) {
+        Error(SourcePos(), "Cannot create JIT: %s.", llvm::toString(jit.takeError()).c_str());
+        return nullptr;
+    }
+    // Calls to the task system, the C library and the like are resolved
+    // against the symbols of the process.
+    auto generator = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        (*jit)->getDataLayout().getGlobalPrefix());
+    if (!generator) {
+        Error(SourcePos(), "Cannot resolve symbols of the process: %s.",
+              llvm::toString(generator.takeError()).c_str());
+        return nullptr;
+    }
+    (*jit)->getMainJITDylib().addGenerator(std::move(*generator));
+    return std::move(*jit);
+}
+
+// Compiles the source with the current globals and adds the optimized module
+// to a new JIT, which also takes the ownership of the context of the module.
+static ISPCJIT lCompile(const char *source, const ISPCJITOptions &options, std::unique_ptr<llvm::LLVMContext> ctx) {
+    ISPCTarget target = ISPCTarget::none;
+    if (options.target != nullptr) {
+        target = ParseISPCTarget(options.target);
+        if (target == ISPCTarget::error) {
+            Error(SourcePos(), "Incorrect target: %s.  Choices are: %s.", options.target,
+                  g->target_registry->getSupportedTargets().c_str());
+            return nullptr;
+        }
+        if (ISPCTargetIsGen(target) || ISPCTargetIsWasm(target)) {
+            Error(SourcePos(), "Target %s is not supported by the JIT, only CPU targets of the host are.",
+                  options.target);
+            return nullptr;
+        }
+    }
+    g->target = new Target(Arch::none, options.cpu, target, true, false);
+    std::unique_ptr<Target> targetOwner(g->target);
+    if (!g->target->isValid()) {
+        return nullptr;
+    }
+
+    std::unique_ptr<llvm::Module> module;
+    m = new Module("<jit>", source);
+    for (int i = 0; i < options.numBindings; ++i) {
+        const ISPCJITBinding &binding = options.bindings[i];
+        m->parameterBindings.push_back(
+            {binding.function, binding.parameter, binding.isFloat != 0, binding.intValue, binding.floatValue});
+    }
+    if (m->CompileFile() == 0) {
+        module.reset(m->module);
+        m->module = nullptr;
+    }
+    delete m;
+    m = nullptr;
+    if (!module) {
+        return nullptr;
+    }
+
+    std::unique_ptr<llvm::orc::LLJIT> jit = lCreateJIT(g->target->GetTargetMachine());
+    if (!jit) {
+        return nullptr;
+    }
+    llvm::orc::ThreadSafeModule TSM(std::move(module), llvm::orc::ThreadSafeContext(std::move(ctx)));
+    if (llvm::Error err = jit->addIRModule(std::move(TSM))) {
+        Error(SourcePos(), "Cannot add module to JIT: %s.", llvm::toString(std::move(err)).c_str());
+        return nullptr;
+    }
+    return new ISPCJIT_T{std::move(jit)};
+}
+
+void ispcJITOptionsInit(ISPCJITOptions *options) {
+    *options = ISPCJITOptions{};
+    options->optLevel = 2;
+}
+
+ISPCJIT ispcCompileToJIT(const char *source, const ISPCJITOptions *options) {
+    ISPCJITOptions defaults;
+    ispcJITOptionsInit(&defaults);
+    if (options == nullptr) {
+        options = &defaults;
+    }
+    if (source == nullptr) {
+        return nullptr;
+    }
+
+    for (int i = 0; i < options->numBindings; ++i) {
+        if (options->bindings[i].function == nullptr || options->bindings[i].parameter == nullptr) {
+            return nullptr;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(lJITMutex);
+    std::string key = lCacheKey(source, *options);
+    auto cached = lJITCache.find(key);
+    if (cached != lJITCache.end()) {
+        cached->second->refCount++;
+        return cached->second;
+    }
+    lInitializeJIT();
+
+    ISPCJIT result = nullptr;
+    {
+        CompilationScope scope;
+        // The context is owned by the JIT together with the module compiled in it.
+        std::unique_ptr<llvm::LLVMContext> ctx(g->ctx);
+        lSetOptions(*options);
+
+        result = lCompile(source, *options, std::move(ctx));
+
+        // Free all bookkeeped objects.
+        BookKeeper::in().freeAll();
+    }
+    if (result != nullptr) {
+        result->refCount++;
+        lJITCache[key] = result;
+    }
+    return result;
+}
+
+void *ispcJITLookup(ISPCJIT jit, const char *name) {
+    if (jit == nullptr || name == nullptr) {
+        return nullptr;
+    }
+    auto symbol = jit->jit->lookup(name);
+    if (!symbol) {
+        llvm::consumeError(symbol.takeError());
+        return nullptr;
+    }
+#if ISPC_LLVM_VERSION >= ISPC_LLVM_15_0
+    return symbol->toPtr<void *>();
+#else
+    return reinterpret_cast<void *>(symbol->getAddress());
+#endif
+}
+
+void ispcJITRelease(ISPCJIT jit) {
+    if (jit == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(lJITMutex);
+    lRelease(jit);
+}
+
+void ispcJITClearCache() {
+    std::lock_guard<std::mutex> lock(lJITMutex);
+    for (auto &entry : lJITCache) {
+        lRelease(entry.second);
+    }
+    lJITCache.clear();
+}
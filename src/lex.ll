@@ -52,6 +52,7 @@ static void lCppComment(SourcePos *);
 static void lNextValidChar(SourcePos *, char const*&);
 static void lPragmaIgnoreWarning(SourcePos *, std::string);
 static void lPragmaUnroll(YYSTYPE *, SourcePos *, std::string, bool);
+static void lPragmaNontemporal(YYSTYPE *, SourcePos *, std::string);
 static bool lConsumePragma(YYSTYPE *, SourcePos *);
 static void lHandleCppHash(SourcePos *);
 static void lStringConst(YYSTYPE *, SourcePos *);
@@ -75,11 +76,11 @@ static int allTokens[] = {
   TOKEN_CONST, TOKEN_CONTINUE, TOKEN_DEFAULT, TOKEN_DO,
   TOKEN_DELETE, TOKEN_DOUBLE, TOKEN_ELSE, TOKEN_ENUM,
   TOKEN_EXPORT, TOKEN_EXTERN, TOKEN_FALSE, TOKEN_FLOAT, TOKEN_FLOAT16, TOKEN_FOR,
-  TOKEN_FOREACH, TOKEN_FOREACH_ACTIVE, TOKEN_FOREACH_TILED,
+  TOKEN_FOREACH, TOKEN_FOREACH_ACTIVE, TOKEN_FOREACH_DYNAMIC, TOKEN_FOREACH_TILED,
   TOKEN_FOREACH_UNIQUE, TOKEN_GOTO, TOKEN_IF, TOKEN_IN, TOKEN_INLINE,
   TOKEN_INT, TOKEN_INT8, TOKEN_INT16, TOKEN_INT, TOKEN_INT64, TOKEN_LAUNCH,
   TOKEN_UINT, TOKEN_UINT8, TOKEN_UINT16, TOKEN_UINT64,
-  TOKEN_NEW, TOKEN_NULL, TOKEN_PRINT, TOKEN_RETURN, TOKEN_SOA, TOKEN_SIGNED,
+  TOKEN_NEW, TOKEN_NULL, TOKEN_PARALLEL_FOREACH, TOKEN_PRINT, TOKEN_RETURN, TOKEN_SHARED, TOKEN_SOA, TOKEN_SIGNED,
   TOKEN_SIZEOF, TOKEN_ALLOCA, TOKEN_STATIC, TOKEN_STRUCT, TOKEN_SWITCH, TOKEN_SYNC,
   TOKEN_TASK, TOKEN_TEMPLATE, TOKEN_TRUE, TOKEN_TYPEDEF, TOKEN_TYPENAME,
   TOKEN_UNIFORM, TOKEN_UNMASKED, TOKEN_UNSIGNED, TOKEN_VARYING, TOKEN_VOID, TOKEN_WHILE,
@@ -94,7 +95,7 @@ static int allTokens[] = {
   TOKEN_MUL_ASSIGN, TOKEN_DIV_ASSIGN, TOKEN_MOD_ASSIGN, TOKEN_ADD_ASSIGN,
   TOKEN_SUB_ASSIGN, TOKEN_LEFT_ASSIGN, TOKEN_RIGHT_ASSIGN, TOKEN_AND_ASSIGN,
   TOKEN_XOR_ASSIGN, TOKEN_OR_ASSIGN, TOKEN_PTR_OP, TOKEN_NOINLINE, TOKEN_VECTORCALL,
-  TOKEN_REGCALL, TOKEN_INVOKE_SYCL,
+  TOKEN_REGCALL, TOKEN_INVOKE_SYCL, TOKEN_RESTRICT,
   ';', '{', '}', ',', ':', '=', '(', ')', '[', ']', '.', '&', '!', '~', '-',
   '+', '*', '/', '%', '<', '>', '^', '|', '?',
 };
@@ -127,6 +128,7 @@ void ParserInit() {
     tokenToName[TOKEN_FOR] = "for";
     tokenToName[TOKEN_FOREACH] = "foreach";
     tokenToName[TOKEN_FOREACH_ACTIVE] = "foreach_active";
+    tokenToName[TOKEN_FOREACH_DYNAMIC] = "foreach_dynamic";
     tokenToName[TOKEN_FOREACH_TILED] = "foreach_tiled";
     tokenToName[TOKEN_FOREACH_UNIQUE] = "foreach_unique";
     tokenToName[TOKEN_GOTO] = "goto";
@@ -136,6 +138,7 @@ void ParserInit() {
     tokenToName[TOKEN_NOINLINE] = "noinline";
     tokenToName[TOKEN_VECTORCALL] = "__vectorcall";
     tokenToName[TOKEN_REGCALL] = "__regcall";
+    tokenToName[TOKEN_RESTRICT] = "restrict";
     tokenToName[TOKEN_INT] = "int";
     tokenToName[TOKEN_UINT] = "uint";
     tokenToName[TOKEN_INT8] = "int8";
@@ -149,8 +152,10 @@ void ParserInit() {
     tokenToName[TOKEN_INVOKE_SYCL] = "invoke_sycl";
     tokenToName[TOKEN_NEW] = "new";
     tokenToName[TOKEN_NULL] = "NULL";
+    tokenToName[TOKEN_PARALLEL_FOREACH] = "parallel_foreach";
     tokenToName[TOKEN_PRINT] = "print";
     tokenToName[TOKEN_RETURN] = "return";
+    tokenToName[TOKEN_SHARED] = "shared";
     tokenToName[TOKEN_SOA] = "soa";
     tokenToName[TOKEN_SIGNED] = "signed";
     tokenToName[TOKEN_SIZEOF] = "sizeof";
@@ -255,6 +260,7 @@ void ParserInit() {
     tokenNameRemap["TOKEN_FOR"] = "\'for\'";
     tokenNameRemap["TOKEN_FOREACH"] = "\'foreach\'";
     tokenNameRemap["TOKEN_FOREACH_ACTIVE"] = "\'foreach_active\'";
+    tokenNameRemap["TOKEN_FOREACH_DYNAMIC"] = "\'foreach_dynamic\'";
     tokenNameRemap["TOKEN_FOREACH_TILED"] = "\'foreach_tiled\'";
     tokenNameRemap["TOKEN_FOREACH_UNIQUE"] = "\'foreach_unique\'";
     tokenNameRemap["TOKEN_GOTO"] = "\'goto\'";
@@ -265,6 +271,7 @@ void ParserInit() {
     tokenNameRemap["TOKEN_NOINLINE"] = "\'noinline\'";
     tokenNameRemap["TOKEN_VECTORCALL"] = "\'__vectorcall\'";
     tokenNameRemap["TOKEN_REGCALL"] = "\'__regcall\'";
+    tokenNameRemap["TOKEN_RESTRICT"] = "\'restrict\'";
     tokenNameRemap["TOKEN_INT"] = "\'int\'";
     tokenNameRemap["TOKEN_UINT"] = "\'uint\'";
     tokenNameRemap["TOKEN_INT8"] = "\'int8\'";
@@ -278,8 +285,10 @@ void ParserInit() {
     tokenNameRemap["TOKEN_INVOKE_SYCL"] = "\'invoke_sycl\'";
     tokenNameRemap["TOKEN_NEW"] = "\'new\'";
     tokenNameRemap["TOKEN_NULL"] = "\'NULL\'";
+    tokenNameRemap["TOKEN_PARALLEL_FOREACH"] = "\'parallel_foreach\'";
     tokenNameRemap["TOKEN_PRINT"] = "\'print\'";
     tokenNameRemap["TOKEN_RETURN"] = "\'return\'";
+    tokenNameRemap["TOKEN_SHARED"] = "\'shared\'";
     tokenNameRemap["TOKEN_SOA"] = "\'soa\'";
     tokenNameRemap["TOKEN_SIGNED"] = "\'signed\'";
     tokenNameRemap["TOKEN_SIZEOF"] = "\'sizeof\'";
@@ -431,6 +440,7 @@ float { RT; return TOKEN_FLOAT; }
 for { RT; return TOKEN_FOR; }
 foreach { RT; return TOKEN_FOREACH; }
 foreach_active { RT; return TOKEN_FOREACH_ACTIVE; }
+foreach_dynamic { RT; return TOKEN_FOREACH_DYNAMIC; }
 foreach_tiled { RT; return TOKEN_FOREACH_TILED; }
 foreach_unique { RT; return TOKEN_FOREACH_UNIQUE; }
 float16 { RT; return TOKEN_FLOAT16; }
@@ -441,6 +451,7 @@ inline { RT; return TOKEN_INLINE; }
 noinline { RT; return TOKEN_NOINLINE; }
 __vectorcall { RT; return TOKEN_VECTORCALL; }
 __regcall { RT; return TOKEN_REGCALL; }
+restrict { RT; return TOKEN_RESTRICT; }
 int { RT; return TOKEN_INT; }
 uint { RT; return TOKEN_UINT; }
 int8 { RT; return TOKEN_INT8; }
@@ -455,8 +466,10 @@ launch { RT; return TOKEN_LAUNCH; }
 invoke_sycl { RT; return TOKEN_INVOKE_SYCL; }
 new { RT; return TOKEN_NEW; }
 NULL { RT; return TOKEN_NULL; }
+parallel_foreach { RT; return TOKEN_PARALLEL_FOREACH; }
 print { RT; return TOKEN_PRINT; }
 return { RT; return TOKEN_RETURN; }
+shared { RT; return TOKEN_SHARED; }
 soa { RT; return TOKEN_SOA; }
 signed { RT; return TOKEN_SIGNED; }
 sizeof { RT; return TOKEN_SIZEOF; }
@@ -878,6 +891,115 @@ static void lPragmaUnroll(YYSTYPE *yylval, SourcePos *pos, std::string fromUserR
     pos->last_column = 1;
 }
 
+/** Handle pragma directive to use non-temporal stores in a loop.
+*/
+static void lPragmaNontemporal(YYSTYPE *yylval, SourcePos *pos, std::string fromUserReq) {
+    const char *currChar = fromUserReq.data();
+    yylval->pragmaAttributes = new PragmaAttributes();
+    yylval->pragmaAttributes->aType = PragmaAttributes::AttributeType::pragmanontemporal;
+
+    lNextValidChar(pos, currChar);
+
+    pos->last_column = 1;
+    pos->last_line++;
+    if (*currChar != '\n') {
+        Warning(*pos, "extra tokens at end of '#pragma nontemporal'.");
+    }
+}
+
+/** Handle pragma directive to iterate a foreach loop in cache-sized
+    blocks: "tile(N0, N1, ...)", with one block size per dimension.
+*/
+static void lPragmaTile(YYSTYPE *yylval, SourcePos *pos, std::string fromUserReq) {
+    const char *currChar = fromUserReq.data();
+    yylval->pragmaAttributes = new PragmaAttributes();
+    yylval->pragmaAttributes->aType = PragmaAttributes::AttributeType::pragmatile;
+
+    lNextValidChar(pos, currChar);
+    if (*currChar != '(') {
+        Error(*pos, "'#pragma tile' : expected '(' followed by the tile sizes.");
+        pos->last_column = 1;
+        pos->last_line++;
+        return;
+    }
+    currChar++;
+    ++pos->last_column;
+
+    while (true) {
+        lNextValidChar(pos, currChar);
+        char *endPtr = NULL;
+        long tile = strtol(currChar, &endPtr, 0);
+        if (endPtr == currChar || tile <= 0) {
+            Error(*pos, "'#pragma tile()' invalid tile size; must be a positive integer.");
+            break;
+        }
+        yylval->pragmaAttributes->tiles.push_back((int)tile);
+        pos->last_column += endPtr - currChar;
+        currChar = endPtr;
+        lNextValidChar(pos, currChar);
+        if (*currChar == ',') {
+            currChar++;
+            ++pos->last_column;
+            continue;
+        }
+        if (*currChar == ')') {
+            currChar++;
+            ++pos->last_column;
+            lNextValidChar(pos, currChar);
+            if (*currChar != '\n')
+                Warning(*pos, "extra tokens at end of '#pragma tile'.");
+        } else
+            Error(*pos, "Incomplete '#pragma tile()' : expected ')'.");
+        break;
+    }
+    pos->last_column = 1;
+    pos->last_line++;
+}
+
+/** Handle pragma directives that take a positive count for a foreach
+    loop: "width(N)", the number of elements processed in each iteration,
+    and "interleave(N)", the number of groups of program instances of a
+    foreach_dynamic loop that run in turn.
+*/
+static void lPragmaCount(YYSTYPE *yylval, SourcePos *pos, std::string fromUserReq, const char *name,
+                         PragmaAttributes::AttributeType aType) {
+    const char *currChar = fromUserReq.data();
+    yylval->pragmaAttributes = new PragmaAttributes();
+    yylval->pragmaAttributes->aType = aType;
+
+    lNextValidChar(pos, currChar);
+    bool popPar = false;
+    if (*currChar == '(') {
+        popPar = true;
+        currChar++;
+        ++pos->last_column;
+    }
+
+    char *endPtr = NULL;
+    long count = strtol(currChar, &endPtr, 0);
+    if (endPtr == currChar || count <= 0) {
+        Error(*pos, "'#pragma %s()' invalid value; must be a positive integer.", name);
+        count = 0;
+    }
+    pos->last_column += endPtr - currChar;
+    lNextValidChar(pos, const_cast<const char*&>(endPtr));
+
+    if (popPar == true) {
+        if (*endPtr == ')') {
+            ++pos->last_column;
+            endPtr++;
+            lNextValidChar(pos, const_cast<const char*&>(endPtr));
+        }
+        else {
+            Error(*pos, "Incomplete '#pragma %s()' : expected ')'.", name);
+        }
+    }
+
+    yylval->pragmaAttributes->count = (int)count;
+    pos->last_line++;
+    pos->last_column = 1;
+}
+
 /** Handle pragma directive to ignore warning.
 */
 static void
@@ -959,7 +1081,8 @@ static bool lConsumePragma(YYSTYPE *yylval, SourcePos *pos) {
         c = yyinput();
     }
     userReq += c;
-    std::string loopUnroll("unroll"), loopNounroll("nounroll"), ignoreWarning("ignore warning");
+    std::string loopUnroll("unroll"), loopNounroll("nounroll"), loopNontemporal("nontemporal"),
+        loopTile("tile"), loopWidth("width"), loopInterleave("interleave"), ignoreWarning("ignore warning");
     if (loopUnroll == userReq.substr(0, loopUnroll.size())) {
         pos->last_column += loopUnroll.size();
         lPragmaUnroll(yylval, pos, userReq.erase(0, loopUnroll.size()), false);
@@ -970,6 +1093,28 @@ static bool lConsumePragma(YYSTYPE *yylval, SourcePos *pos) {
         lPragmaUnroll(yylval, pos, userReq.erase(0, loopNounroll.size()), true);
         return true;
     }
+    else if (loopNontemporal == userReq.substr(0, loopNontemporal.size())) {
+        pos->last_column += loopNontemporal.size();
+        lPragmaNontemporal(yylval, pos, userReq.erase(0, loopNontemporal.size()));
+        return true;
+    }
+    else if (loopTile == userReq.substr(0, loopTile.size())) {
+        pos->last_column += loopTile.size();
+        lPragmaTile(yylval, pos, userReq.erase(0, loopTile.size()));
+        return true;
+    }
+    else if (loopWidth == userReq.substr(0, loopWidth.size())) {
+        pos->last_column += loopWidth.size();
+        lPragmaCount(yylval, pos, userReq.erase(0, loopWidth.size()), "width",
+                     PragmaAttributes::AttributeType::pragmawidth);
+        return true;
+    }
+    else if (loopInterleave == userReq.substr(0, loopInterleave.size())) {
+        pos->last_column += loopInterleave.size();
+        lPragmaCount(yylval, pos, userReq.erase(0, loopInterleave.size()), "interleave",
+                     PragmaAttributes::AttributeType::pragmainterleave);
+        return true;
+    }
     else if (ignoreWarning == userReq.substr(0, ignoreWarning.size())) {
         pos->last_column += ignoreWarning.size();
         lPragmaIgnoreWarning(pos, userReq.erase(0, ignoreWarning.size()));
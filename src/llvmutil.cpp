@@ -46,6 +46,7 @@
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/Module.h>
+#include <llvm/Support/KnownBits.h>
 
 #ifdef ISPC_XE_ENABLED
 #include <llvm/GenXIntrinsics/GenXIntrinsics.h>
@@ -786,8 +787,15 @@ static bool lVectorValuesAllEqual(llvm::Value *v, int vectorLength, std::vector<
     in is required to have the same value in all elements (so that we can
     just check the first element to be a multiple of the given value.)
  */
+static bool lIsExactMultipleOperand(llvm::Value *op, int baseValue, int vectorLength,
+                                    std::vector<llvm::PHINode *> &seenPhis);
+
 static bool lIsExactMultiple(llvm::Value *val, int baseValue, int vectorLength,
                              std::vector<llvm::PHINode *> &seenPhis) {
+    // Everything is a multiple of one (and of a zero alignment requirement).
+    if (baseValue <= 1)
+        return true;
+
     if (llvm::isa<llvm::VectorType>(val->getType()) == false) {
         // If we've worked down to a constant int, then the moment of truth
         // has arrived...
@@ -836,11 +844,52 @@ static bool lIsExactMultiple(llvm::Value *val, int baseValue, int vectorLength,
         bool be1 = lIsExactMultiple(op1, baseValue, vectorLength, seenPhis);
         return (be0 && be1);
     }
-    // FIXME: mul? casts? ... ?
+    if (bop != NULL && (bop->getOpcode() == llvm::Instruction::Mul || bop->getOpcode() == llvm::Instruction::Shl)) {
+        // A product is a multiple if either factor is; this is how the
+        // counters of loops over blocks of SOA data usually come in, as
+        // (block number * soa width).
+        llvm::Value *op0 = bop->getOperand(0);
+        llvm::Value *op1 = bop->getOperand(1);
+        if (lIsExactMultipleOperand(op0, baseValue, vectorLength, seenPhis))
+            return true;
+        if (bop->getOpcode() == llvm::Instruction::Mul)
+            return lIsExactMultipleOperand(op1, baseValue, vectorLength, seenPhis);
+        llvm::Value *shift = op1;
+        if (llvm::ConstantDataVector *cv = llvm::dyn_cast<llvm::ConstantDataVector>(op1))
+            shift = cv->getSplatValue();
+        llvm::ConstantInt *ci = llvm::dyn_cast_or_null<llvm::ConstantInt>(shift);
+        return ci != NULL && ci->getZExtValue() < 63 && ((1LL << ci->getZExtValue()) % baseValue) == 0;
+    }
+
+    llvm::CastInst *cast = llvm::dyn_cast<llvm::CastInst>(val);
+    if (cast != NULL && (cast->getOpcode() == llvm::Instruction::SExt || cast->getOpcode() == llvm::Instruction::ZExt))
+        return lIsExactMultiple(cast->getOperand(0), baseValue, vectorLength, seenPhis);
+
+    // Last, see if LLVM knows that enough of the low bits are zero, as it
+    // does for values that have been rounded down with a mask, for
+    // example.
+    llvm::Instruction *inst = llvm::dyn_cast<llvm::Instruction>(val);
+    if (inst != NULL && inst->getParent() != NULL && (baseValue & (baseValue - 1)) == 0) {
+        const llvm::DataLayout &dl = inst->getModule()->getDataLayout();
+        llvm::KnownBits known = llvm::computeKnownBits(val, dl);
+        return (1LL << known.countMinTrailingZeros()) % baseValue == 0;
+    }
 
     return false;
 }
 
+/** lIsExactMultiple() for an operand of an all-equal vector value, which
+    may itself not have the same value in all of the elements. */
+static bool lIsExactMultipleOperand(llvm::Value *op, int baseValue, int vectorLength,
+                                    std::vector<llvm::PHINode *> &seenPhis) {
+    if (llvm::isa<llvm::VectorType>(op->getType())) {
+        std::vector<llvm::PHINode *> seenPhisEqual;
+        if (lVectorValuesAllEqual(op, vectorLength, seenPhisEqual) == false)
+            return false;
+    }
+    return lIsExactMultiple(op, baseValue, vectorLength, seenPhis);
+}
+
 /** Returns the next power of two greater than or equal to the given
     value. */
 static int lRoundUpPow2(int v) {
@@ -922,8 +971,12 @@ static bool lAllDivBaseEqual(llvm::Value *val, int64_t baseValue, int vectorLeng
         //   baseValue.
 
         int64_t addConstants[ISPC_MAX_NVEC];
-        if (LLVMExtractVectorInts(op1, addConstants, &nElts) == false)
-            return false;
+        if (LLVMExtractVectorInts(op1, addConstants, &nElts) == false) {
+            // The constants may come first, as in <0,1,2,3...> + %smear.
+            std::swap(op0, op1);
+            if (LLVMExtractVectorInts(op1, addConstants, &nElts) == false)
+                return false;
+        }
         Assert(nElts == vectorLength);
 
         // Do all of them give the same value when divided by baseValue?
@@ -967,6 +1020,13 @@ static bool lAllDivBaseEqual(llvm::Value *val, int64_t baseValue, int vectorLeng
         std::vector<llvm::PHINode *> seenPhisEEM;
         return lIsExactMultiple(op0, requiredAlignment, vectorLength, seenPhisEEM);
     }
+
+    // Widening the index doesn't change the quotients; this comes up with
+    // 32-bit indices into SOA arrays on 64-bit targets.
+    llvm::CastInst *cast = llvm::dyn_cast<llvm::CastInst>(val);
+    if (cast != NULL && (cast->getOpcode() == llvm::Instruction::SExt || cast->getOpcode() == llvm::Instruction::ZExt))
+        return lAllDivBaseEqual(cast->getOperand(0), baseValue, vectorLength, seenPhis, canAdd);
+
     // TODO: could handle mul by a vector of equal constant integer values
     // and the like here and adjust the 'baseValue' value when it evenly
     // divides, but unclear if it's worthwhile...
@@ -35,8 +35,10 @@
     @brief main() entrypoint implementation for ispc
 */
 
+#include "builtins.h"
 #include "ispc.h"
 #include "module.h"
+#include "server.h"
 #include "target_registry.h"
 #include "type.h"
 #include "util.h"
@@ -90,24 +92,41 @@ static void lPrintVersion() {
     printf("                          \t\taddressing calculations are done by default, even\n");
     printf("                          \t\ton 64-bit target architectures.)\n");
     printf("    [--arch={%s}]\t\tSelect target architecture\n", g->target_registry->getSupportedArchs().c_str());
+    printf("    [--async-print]\t\t\tBuffer print statements and format them on another thread with ISPCPrint()\n");
+    printf("    [--auto-prefetch=<n>]\t\tInsert software prefetches <n> loop iterations ahead of strided accesses\n");
+    printf("    [--cache-dir=<dir>]\t\tReuse outputs of identical single-target compilations stored in <dir>\n");
 #ifndef ISPC_HOST_IS_WINDOWS
     printf("    [--colored-output]\t\tAlways use terminal colors in error/warning messages\n");
 #endif
+    printf("    [--codegen-threads=<n>]\t\tSplit code generation of object file between <n> threads\n");
+    printf("    [--connect=<socket>]\t\tSend compilation to the compile server listening on <socket>\n");
+    printf("    [--cpp-header-outfile=<name>]\tOutput filename for C++ header with wrappers of exported functions\n");
     printf("    [--cpu=<type>]\t\t\tAn alias for [--device=<type>] switch\n");
+    printf("    [--custom-allocator]\t\tImplement \"new\" and \"delete\" with ISPCMalloc() and ISPCFree() provided by "
+           "the application\n");
     printf("    [-D<foo>]\t\t\t\t#define given value when running preprocessor\n");
+    printf("    [--denormals=<mode>]\t\tHandling of denormal floating-point values by exported and task "
+           "functions\n");
+    printf("        flush\t\t\t\tFlush them to zero (FTZ/DAZ) while the functions run\n");
+    printf("        preserve\t\t\tLeave the floating-point mode of the caller unchanged (default)\n");
     printf("    [--dev-stub <filename>]\t\tEmit device-side offload stub functions to file\n");
     printf("    ");
     char cpuHelp[2048];
     snprintf(cpuHelp, sizeof(cpuHelp), "[--device=<type>]\t\t\tSelect target device\n<type>={%s}\n",
              Target::SupportedCPUs().c_str());
     PrintWithWordBreaks(cpuHelp, 16, TerminalWidth(), stdout);
+    printf("    [--dispatch-once]\t\t\tResolve the target of dispatch functions on the first call only (GNU ifunc "
+           "on ELF) in multi-target compilation\n");
     printf("    [--dllexport]\t\t\tMake non-static functions DLL exported.  Windows target only\n");
     printf("    [--dwarf-version={2,3,4}]\t\tGenerate source-level debug information with given DWARF version "
            "(triggers -g).  Ignored for Windows target\n");
     printf("    [-E]\t\t\t\tRun only the preprocessor\n");
     printf("    [--emit-asm]\t\t\tGenerate assembly language file as output\n");
+    printf("    [--emit-inline-header]\t\tWrite the exported functions as inline C++ functions to the output "
+           "header\n");
     printf("    [--emit-llvm]\t\t\tEmit LLVM bitcode file as output\n");
     printf("    [--emit-llvm-text]\t\t\tEmit LLVM bitcode file as output in textual form\n");
+    printf("    [--emit-lto]\t\t\tEmit LLVM bitcode with a ThinLTO summary to link with clang-compiled code\n");
     printf("    [--emit-obj]\t\t\tGenerate object file file as output (default)\n");
 #ifdef ISPC_XE_ENABLED
     printf("    [--emit-spirv]\t\t\tGenerate SPIR-V file as output\n");
@@ -121,13 +140,16 @@ static void lPrintVersion() {
     printf("    [--error-limit=<value>]\t\tLimit maximum number of errors emitting by ISPC to <value>\n");
     printf("    [--force-alignment=<value>]\t\tForce alignment in memory allocations routine to be <value>\n");
     printf("    [-g]\t\t\t\tGenerate source-level debug information\n");
+    printf("    [-gline-tables-only]\t\tGenerate debug information for line tables only\n");
     printf("    [--help]\t\t\t\tPrint help\n");
     printf("    [--help-dev]\t\t\tPrint help for developer options\n");
     printf("    [--host-stub <filename>]\t\tEmit host-side offload stub functions to file\n");
     printf("    [-h <name>/--header-outfile=<name>]\tOutput filename for header\n");
+    printf("    [--header-soa-helpers]\t\tEmit C++ helpers for SoA layouts of structs to header\n");
     printf("    [-I <path>]\t\t\t\tAdd <path> to #include file search path\n");
     printf("    [--ignore-preprocessor-errors]\tSuppress errors from the preprocessor\n");
-    printf("    [--instrument]\t\t\tEmit instrumentation to gather performance data\n");
+    printf("    [--instrument[=<type>]]\t\tEmit instrumentation to gather performance data\n");
+    printf("        perfcounters\t\t\tRead hardware performance counters around exported functions\n");
     printf("    [--math-lib=<option>]\t\tSelect math library\n");
     printf("        default\t\t\t\tUse ispc's built-in math functions\n");
     printf("        fast\t\t\t\tUse high-performance but lower-accuracy math functions\n");
@@ -149,6 +171,8 @@ static void lPrintVersion() {
     printf("        -O1\t\t\t\tOptimization for size.\n");
     printf("        -O2/O3\t\t\t\tOptimization for speed.\n");
     printf("    [--opt=<option>]\t\t\tSet optimization option\n");
+    printf("        auto-coherent-control-flow\tCheck for \"all on\" mask in expensive varying if statements and "
+           "loops\n");
     printf("        disable-assertions\t\tRemove assertion statements from final code.\n");
     printf("        disable-fma\t\t\tDisable 'fused multiply-add' instructions (on targets that support them)\n");
     printf("        disable-loop-unroll\t\tDisable loop unrolling.\n");
@@ -161,9 +185,24 @@ static void lPrintVersion() {
     printf("        fast-masked-vload\t\tFaster masked vector loads on SSE (may go past end of array)\n");
     printf("        fast-math\t\t\tPerform non-IEEE-compliant optimizations of numeric expressions\n");
     printf("        force-aligned-memory\t\tAlways issue \"aligned\" vector load and store instructions\n");
+    printf("        gather-strategy=<s>\t\tUse native gather instructions or emulate gathers with scalar loads. "
+           "<s>={auto,native,emulated}, auto emulates them when --cpu has slow gathers\n");
+    printf("        loop-versioning\t\t\tVersion loops on a runtime check for aligned, non-overlapping arrays\n");
     printf("        reset-ftz-daz\t\t\tReset FTZ/DAZ flags on ISPC extern function entrance / restore on return\n");
+    printf("    [--opt-record-format=<f>]\t\tFormat of the optimization record file.  <f>={yaml,bitstream}\n");
+    printf("    [--parallel-targets]\t\tOverlap code generation of a target with compilation of the next one in "
+           "multi-target compilation\n");
     printf("    [--pic]\t\t\t\tGenerate position-independent code.  Ignored for Windows target\n");
+    printf("    [--profile-generate[=<path>]]\tInstrument code to write execution counts for profile-guided "
+           "optimization to <path>\n");
+    printf("    [--profile-use=<path>]\t\tUse execution counts from the given .profdata file to guide optimization\n");
     printf("    [--quiet]\t\t\t\tSuppress all output\n");
+    printf("    [--report-cost[=<file>]]\t\tPrint instruction counts and estimated cycles per iteration of loops "
+           "as JSON to stderr, or append them to <file> if specified\n");
+    printf("    [--save-opt-record[=<file>]]\tWrite optimization remarks of ISPC passes to <file>, by default "
+           "based on output filename\n");
+    printf("    [--server=<socket>]\t\tRun compile server listening on <socket>, builtins for [--target] are "
+           "preloaded\n");
     printf("    [--support-matrix]\t\t\tPrint full matrix of supported targets, architectures and OSes\n");
     printf("    ");
     char targetHelp[2048];
@@ -179,6 +218,8 @@ static void lPrintVersion() {
     printf("    [--time-trace]\t\t\tTurn on time profiler. Generates JSON file based on output filename.\n");
     printf("    [--time-trace-granularity=<value>]\tMinimum time granularity (in microseconds) traced by time "
            "profiler.\n");
+    printf("    [--regcall]\t\t\t\tPass varying arguments and return values of calls between ispc functions in "
+           "registers (x86 only)\n");
     printf("    [--vectorcall/--no-vectorcall]\tEnable/disable vectorcall calling convention on Windows (x64 only). "
            "Disabled by default\n");
     printf("    [--version]\t\t\t\tPrint ispc version\n");
@@ -192,6 +233,8 @@ static void lPrintVersion() {
     printf("        intel\t\t\t\tEmit Intel-style assembly\n");
     printf("        att\t\t\t\tEmit AT&T-style assembly\n");
 #ifdef ISPC_XE_ENABLED
+    printf("    [--xe-auto-width]\t\t\tRecompile for the narrower Xe target when the kernels spill registers\n");
+    printf("    [--xe-kernel-report[=<file>]]\tPrint register usage of the compiled Xe kernels as JSON\n");
     printf("    [--xe-stack-mem-size=<value>\t\tSet size of stateless stack memory in VC backend.\n");
 #endif
     printf("    [@<filename>]\t\t\tRead additional arguments from the given file\n");
@@ -208,6 +251,8 @@ static void lPrintVersion() {
 #ifdef ISPC_XE_ENABLED
     printf("    [--emit-spirv]\t\t\tEmit SPIR-V file as output\n");
 #endif
+    printf("    [--fuse-kernels=<f>:<k1>,<k2>...]\tDefine kernel <f> running kernels <k1>, <k2>... in sequence\n");
+    printf("    [-O0/-O(1/2/3)]\t\t\tOptimize across the linked files. Default behavior is to only link them.\n");
     printf("    [-o <name>/--outfile=<name>]\tOutput filename (may be \"-\" for standard output)\n");
     printf("    <files to link or \"-\" for stdin>\n");
     printf("\nExamples:\n");
@@ -232,17 +277,22 @@ static void lPrintVersion() {
            "current directory, or to <path> if specified\n");
     printf("    [--fuzz-seed=<value>]\t\tSeed value for RNG for fuzz testing\n");
     printf("    [--fuzz-test]\t\t\tRandomly perturb program input to test error conditions\n");
+    printf("    [--lazy-builtins]\t\t\tLink only the builtins referenced by the program\n");
     printf("    [--off-phase=<value>]\t\tSwitch off optimization phases. --off-phase=first,210:220,300,305,310:last\n");
     printf("    [--opt=<option>]\t\t\tSet optimization option\n");
     printf("        disable-all-on-optimizations\t\tDisable optimizations that take advantage of \"all on\" mask\n");
     printf("        disable-blended-masked-stores\t\tScalarize masked stores on SSE (vs. using vblendps)\n");
     printf("        disable-blending-removal\t\tDisable eliminating blend at same scope\n");
-    printf("        disable-coalescing\t\t\tDisable gather coalescing\n");
+    printf("        disable-coalescing\t\t\tDisable gather and scatter coalescing\n");
     printf("        disable-coherent-control-flow\t\tDisable coherent control flow optimizations\n");
     printf("        disable-gather-scatter-flattening\tDisable flattening when all lanes are on\n");
     printf("        disable-gather-scatter-optimizations\tDisable improvements to gather/scatter\n");
     printf("        disable-handle-pseudo-memory-ops\tLeave __pseudo_* calls for gather/scatter/etc. in final IR\n");
+    printf("        disable-loop-fusion\t\t\tDisable fusion of adjacent \"foreach\" loops over the same range\n");
+    printf("        disable-target-merging\t\tKeep identical exported functions of each target in multi-target "
+           "compilation\n");
     printf("        disable-uniform-control-flow\t\tDisable uniform control flow optimizations\n");
+    printf("        disable-uniform-hoisting\t\tDisable computing invariant uniform expressions once\n");
     printf("        disable-uniform-memory-optimizations\tDisable uniform-based coherent memory access\n");
 #ifdef ISPC_XE_ENABLED
     printf("        disable-xe-gather-coalescing\t\tDisable Xe gather coalescing\n");
@@ -250,8 +300,11 @@ static void lPrintVersion() {
            "Xe gather coalescing.\n");
     printf("        build-llvm-loads-on-xe-gather-coalescing\t\tExperimental: build standard llvm loads on "
            "Xe gather coalescing.\n");
+    printf("        disable-xe-block2d\t\t\tDisable lowering of 2D tile accesses to Xe 2D block loads/stores\n");
     printf("        enable-xe-unsafe-masked-load\t\tEnable Xe unsafe masked load\n");
 #endif
+    printf("    [--print-pass-stats[=<file>]]\tPrint time and IR size of optimization phases as JSON to "
+           "stderr, or append them to <file> if specified\n");
     printf("    [--print-target]\t\t\tPrint target's information\n");
     printf("    [--yydebug]\t\t\t\tPrint debugging information during parsing\n");
     exit(ret);
@@ -480,7 +533,11 @@ static int ParsingPhaseName(char *stage, ArgErrors &errorHandler) {
 // which might trigger a different default behavior.
 enum class BooleanOptValue { none, enabled, disabled };
 
-static void setCallingConv(BooleanOptValue vectorCall, Arch arch) {
+static void setCallingConv(BooleanOptValue vectorCall, bool regCall, Arch arch) {
+    if (regCall) {
+        g->calling_conv = CallingConv::x86_regcall;
+        return;
+    }
     // Restrict vectorcall to just x86_64 - vectorcall for x86 not supported yet.
     if (g->target_os == TargetOS::windows && vectorCall == BooleanOptValue::enabled &&
         // Arch is not properly set yet, we assume none is x86_64.
@@ -567,14 +624,8 @@ static void lParseInclude(const char *path) {
 
 extern int yydebug;
 
-int main(int Argc, char *Argv[]) {
-    std::vector<char *> argv;
-    lGetAllArgs(Argc, Argv, argv);
-    int argc = argv.size();
-
-    llvm::sys::AddSignalHandler(lSignal, NULL);
-
-    // initialize available LLVM targets
+/** Initializes the LLVM targets enabled in the build. */
+static void lInitializeLLVMTargets() {
 #ifdef ISPC_X86_ENABLED
     LLVMInitializeX86TargetInfo();
     LLVMInitializeX86Target();
@@ -600,6 +651,15 @@ int main(int Argc, char *Argv[]) {
     LLVMInitializeAArch64TargetMC();
 #endif
 
+#ifdef ISPC_RISCV_ENABLED
+    LLVMInitializeRISCVTargetInfo();
+    LLVMInitializeRISCVTarget();
+    LLVMInitializeRISCVAsmPrinter();
+    LLVMInitializeRISCVAsmParser();
+    LLVMInitializeRISCVDisassembler();
+    LLVMInitializeRISCVTargetMC();
+#endif
+
 #ifdef ISPC_WASM_ENABLED
     LLVMInitializeWebAssemblyAsmParser();
     LLVMInitializeWebAssemblyAsmPrinter();
@@ -608,6 +668,37 @@ int main(int Argc, char *Argv[]) {
     LLVMInitializeWebAssemblyTargetInfo();
     LLVMInitializeWebAssemblyTargetMC();
 #endif
+}
+
+/** The context of the compile server, which holds the preloaded builtins.
+    It is used by all compilations served by the server. */
+#ifdef ISPC_XE_ENABLED
+// Xe target with the same platform and half the SIMD width, or ISPCTarget::none.
+static ISPCTarget lNarrowXeTarget(const std::vector<ISPCTarget> &targets) {
+    if (targets.size() != 1) {
+        return ISPCTarget::none;
+    }
+    switch (targets[0]) {
+    case ISPCTarget::gen9_x16:
+        return ISPCTarget::gen9_x8;
+    case ISPCTarget::xelp_x16:
+        return ISPCTarget::xelp_x8;
+    case ISPCTarget::xehpg_x16:
+        return ISPCTarget::xehpg_x8;
+    case ISPCTarget::xehpc_x32:
+        return ISPCTarget::xehpc_x16;
+    default:
+        return ISPCTarget::none;
+    }
+}
+#endif
+
+static llvm::LLVMContext *lServerContext = nullptr;
+
+/** Parses the command line and runs the compilation, returns the exit code. */
+static int lCompile(std::vector<char *> &argv) {
+    int argc = argv.size();
+
     char *file = NULL;
     const char *headerFileName = NULL;
     const char *outFileName = NULL;
@@ -615,11 +706,18 @@ int main(int Argc, char *Argv[]) {
     const char *depsTargetName = NULL;
     const char *hostStubFileName = NULL;
     const char *devStubFileName = NULL;
+    const char *serverSocket = NULL;
 
     std::vector<std::string> linkFileNames;
     // Initiailize globals early so that we can set various option values
     // as we're parsing below
     g = new Globals;
+    if (lServerContext != nullptr) {
+        // Compilation served by the compile server uses the context with the
+        // preloaded builtins.
+        delete g->ctx;
+        g->ctx = lServerContext;
+    }
 
     Module::OutputType ot = Module::Object;
     Module::OutputFlags flags = Module::NoFlags;
@@ -627,6 +725,7 @@ int main(int Argc, char *Argv[]) {
     std::vector<ISPCTarget> targets;
     const char *cpu = NULL, *intelAsmSyntax = NULL;
     BooleanOptValue vectorCall = BooleanOptValue::none;
+    bool regCall = false;
     BooleanOptValue discardValueNames = BooleanOptValue::none;
 
     ArgErrors errorHandler;
@@ -636,6 +735,8 @@ int main(int Argc, char *Argv[]) {
     if (argc > 1 && !strncmp(argv[1], "link", 4)) {
         // Use bitcode format by default
         ot = Module::Bitcode;
+        int linkOptLevel = 0;
+        std::vector<std::string> fusedKernels;
 
         if (argc < 2) {
             // Not sufficient number of arguments
@@ -660,6 +761,13 @@ int main(int Argc, char *Argv[]) {
                 ot = Module::Bitcode;
             } else if (!strcmp(argv[i], "--emit-llvm-text")) {
                 ot = Module::BitcodeText;
+            } else if (!strncmp(argv[i], "--fuse-kernels=", 15)) {
+                fusedKernels.push_back(argv[i] + strlen("--fuse-kernels="));
+            } else if (!strcmp(argv[i], "-O0")) {
+                linkOptLevel = 0;
+            } else if (!strcmp(argv[i], "-O") || !strcmp(argv[i], "-O1") || !strcmp(argv[i], "-O2") ||
+                       !strcmp(argv[i], "-O3")) {
+                linkOptLevel = 1;
             } else if (argv[i][0] == '-') {
                 errorHandler.AddError("Unknown option \"%s\".", argv[i]);
             } else {
@@ -681,7 +789,7 @@ int main(int Argc, char *Argv[]) {
                                  "be issued, but no output will be generated.");
         }
 
-        return Module::LinkAndOutput(linkFileNames, ot, outFileName);
+        return Module::LinkAndOutput(linkFileNames, ot, outFileName, linkOptLevel, fusedKernels);
     }
 
     for (int i = 1; i < argc; ++i) {
@@ -759,6 +867,14 @@ int main(int Argc, char *Argv[]) {
             discardValueNames = BooleanOptValue::enabled;
         else if (!strcmp(argv[i], "--no-discard-value-names"))
             discardValueNames = BooleanOptValue::disabled;
+        else if (!strcmp(argv[i], "--dispatch-once"))
+            g->dispatchOnce = true;
+        else if (!strcmp(argv[i], "--denormals=flush"))
+            g->flushDenormals = true;
+        else if (!strcmp(argv[i], "--denormals=preserve"))
+            g->flushDenormals = false;
+        else if (!strncmp(argv[i], "--denormals=", 12))
+            errorHandler.AddError("Unknown --denormals mode \"%s\", expected \"flush\" or \"preserve\".", argv[i] + 12);
         else if (!strcmp(argv[i], "--dllexport"))
             g->dllExport = true;
         else if (!strncmp(argv[i], "--dwarf-version=", 16)) {
@@ -775,12 +891,25 @@ int main(int Argc, char *Argv[]) {
             g->printTarget = true;
         else if (!strcmp(argv[i], "--no-omit-frame-pointer"))
             g->NoOmitFramePointer = true;
+        else if (!strcmp(argv[i], "--custom-allocator"))
+            g->customAllocator = true;
         else if (!strcmp(argv[i], "--instrument"))
             g->emitInstrumentation = true;
+        else if (!strcmp(argv[i], "--instrument=perfcounters"))
+            g->emitPerfCounters = true;
+        else if (!strncmp(argv[i], "--instrument=", 13))
+            errorHandler.AddError("Unsupported value for --instrument, supported values are: perfcounters");
+        else if (!strcmp(argv[i], "--async-print"))
+            g->asyncPrint = true;
         else if (!strcmp(argv[i], "--no-pragma-once"))
             g->noPragmaOnce = true;
+        else if (!strcmp(argv[i], "--header-soa-helpers"))
+            g->emitSoAHelpers = true;
         else if (!strcmp(argv[i], "-g")) {
             g->generateDebuggingSymbols = true;
+        } else if (!strcmp(argv[i], "-gline-tables-only")) {
+            g->generateDebuggingSymbols = true;
+            g->debugLineTablesOnly = true;
         } else if (!strcmp(argv[i], "-E")) {
             g->onlyCPP = true;
             ot = Module::CPPStub;
@@ -790,7 +919,12 @@ int main(int Argc, char *Argv[]) {
             ot = Module::Bitcode;
         else if (!strcmp(argv[i], "--emit-llvm-text"))
             ot = Module::BitcodeText;
-        else if (!strcmp(argv[i], "--emit-obj"))
+        else if (!strcmp(argv[i], "--emit-inline-header"))
+            ot = Module::InlineHeader;
+        else if (!strcmp(argv[i], "--emit-lto")) {
+            ot = Module::Bitcode;
+            g->emitLTO = true;
+        } else if (!strcmp(argv[i], "--emit-obj"))
             ot = Module::Object;
 #ifdef ISPC_XE_ENABLED
         else if (!strcmp(argv[i], "--emit-spirv"))
@@ -843,6 +977,8 @@ int main(int Argc, char *Argv[]) {
             vectorCall = BooleanOptValue::disabled;
         } else if (!strcmp(argv[i], "--vectorcall")) {
             vectorCall = BooleanOptValue::enabled;
+        } else if (!strcmp(argv[i], "--regcall")) {
+            regCall = true;
         } else if (!strncmp(argv[i], "--math-lib=", 11)) {
             const char *lib = argv[i] + 11;
             if (!strcmp(lib, "default"))
@@ -862,6 +998,8 @@ int main(int Argc, char *Argv[]) {
                 g->opt.fastMath = true;
             else if (!strcmp(opt, "fast-masked-vload"))
                 g->opt.fastMaskedVload = true;
+            else if (!strcmp(opt, "auto-coherent-control-flow"))
+                g->opt.autoCoherentControlFlow = true;
             else if (!strcmp(opt, "disable-assertions"))
                 g->opt.disableAsserts = true;
             else if (!strcmp(opt, "disable-loop-unroll"))
@@ -872,6 +1010,14 @@ int main(int Argc, char *Argv[]) {
                 g->opt.disableZMM = true;
             else if (!strcmp(opt, "force-aligned-memory"))
                 g->opt.forceAlignedMemory = true;
+            else if (!strcmp(opt, "gather-strategy=auto"))
+                g->opt.gatherStrategy = Opt::GatherStrategy::Auto;
+            else if (!strcmp(opt, "gather-strategy=native"))
+                g->opt.gatherStrategy = Opt::GatherStrategy::Native;
+            else if (!strcmp(opt, "gather-strategy=emulated"))
+                g->opt.gatherStrategy = Opt::GatherStrategy::Emulated;
+            else if (!strcmp(opt, "loop-versioning"))
+                g->opt.loopVersioning = true;
             else if (!strcmp(opt, "reset-ftz-daz"))
                 g->opt.resetFTZ_DAZ = true;
 
@@ -897,6 +1043,12 @@ int main(int Argc, char *Argv[]) {
                 g->opt.disableGatherScatterFlattening = true;
             else if (!strcmp(opt, "disable-uniform-memory-optimizations"))
                 g->opt.disableUniformMemoryOptimizations = true;
+            else if (!strcmp(opt, "disable-loop-fusion"))
+                g->opt.disableLoopFusion = true;
+            else if (!strcmp(opt, "disable-uniform-hoisting"))
+                g->opt.disableUniformHoisting = true;
+            else if (!strcmp(opt, "disable-target-merging"))
+                g->opt.disableTargetMerging = true;
 #ifdef ISPC_XE_ENABLED
             else if (!strcmp(opt, "disable-xe-gather-coalescing"))
                 g->opt.disableXeGatherCoalescing = true;
@@ -904,6 +1056,8 @@ int main(int Argc, char *Argv[]) {
                 g->opt.thresholdForXeGatherCoalescing = atoi(opt + 37);
             else if (!strcmp(opt, "build-llvm-loads-on-xe-gather-coalescing"))
                 g->opt.buildLLVMLoadsOnXeGatherCoalescing = true;
+            else if (!strcmp(opt, "disable-xe-block2d"))
+                g->opt.disableXeBlock2D = true;
             else if (!strcmp(opt, "emit-xe-hardware-mask"))
                 g->opt.emitXeHardwareMask = true;
             else if (!strcmp(opt, "enable-xe-foreach-varying"))
@@ -916,6 +1070,39 @@ int main(int Argc, char *Argv[]) {
             }
         } else if (!strncmp(argv[i], "--force-alignment=", 18)) {
             g->forceAlignment = atoi(argv[i] + 18);
+        } else if (!strncmp(argv[i], "--cache-dir=", 12)) {
+            g->cacheDir = argv[i] + 12;
+        } else if (!strcmp(argv[i], "--lazy-builtins")) {
+            g->lazyBuiltins = true;
+        } else if (!strncmp(argv[i], "--report-cost=", 14)) {
+            g->reportCost = true;
+            g->costReportFile = ParsePath(argv[i] + strlen("--report-cost="), errorHandler);
+        } else if (!strcmp(argv[i], "--report-cost")) {
+            g->reportCost = true;
+        } else if (!strncmp(argv[i], "--save-opt-record=", 18)) {
+            g->saveOptRecord = true;
+            g->optRecordFile = ParsePath(argv[i] + strlen("--save-opt-record="), errorHandler);
+        } else if (!strcmp(argv[i], "--save-opt-record")) {
+            g->saveOptRecord = true;
+        } else if (!strncmp(argv[i], "--opt-record-format=", 20)) {
+            g->optRecordFormat = argv[i] + 20;
+            if (g->optRecordFormat != "yaml" && g->optRecordFormat != "bitstream") {
+                errorHandler.AddError("Invalid value for --opt-record-format: \"%s\".", argv[i] + 20);
+            }
+        } else if (!strcmp(argv[i], "--parallel-targets")) {
+            g->parallelTargetCompile = true;
+        } else if (!strncmp(argv[i], "--server=", 9)) {
+            serverSocket = argv[i] + 9;
+        } else if (!strncmp(argv[i], "--auto-prefetch=", 16)) {
+            g->opt.autoPrefetchDistance = atoi(argv[i] + 16);
+            if (g->opt.autoPrefetchDistance < 1) {
+                errorHandler.AddError("Invalid value for --auto-prefetch: \"%s\".", argv[i] + 16);
+            }
+        } else if (!strncmp(argv[i], "--codegen-threads=", 18)) {
+            g->codegenThreads = atoi(argv[i] + 18);
+            if (g->codegenThreads < 1) {
+                errorHandler.AddError("Invalid value for --codegen-threads: \"%s\".", argv[i] + 18);
+            }
         } else if (!strcmp(argv[i], "--time-trace")) {
             g->enableTimeTrace = true;
         } else if (!strncmp(argv[i], "--time-trace-granularity=", 25)) {
@@ -953,6 +1140,8 @@ int main(int Argc, char *Argv[]) {
             }
         } else if (!strncmp(argv[i], "--header-outfile=", 17)) {
             headerFileName = argv[i] + strlen("--header-outfile=");
+        } else if (!strncmp(argv[i], "--cpp-header-outfile=", 21)) {
+            g->cppHeaderFile = ParsePath(argv[i] + strlen("--cpp-header-outfile="), errorHandler);
         } else if (!strcmp(argv[i], "-O0")) {
             g->opt.level = 0;
             g->codegenOptLevel = Globals::CodegenOptLevel::None;
@@ -970,6 +1159,17 @@ int main(int Argc, char *Argv[]) {
             g->runCPP = false;
         else if (!strcmp(argv[i], "--pic"))
             flags |= Module::GeneratePIC;
+        else if (!strncmp(argv[i], "--profile-generate=", 19)) {
+            g->opt.profileGenerate = true;
+            g->opt.profileGenerateFile = ParsePath(argv[i] + strlen("--profile-generate="), errorHandler);
+        } else if (!strcmp(argv[i], "--profile-generate"))
+            g->opt.profileGenerate = true;
+        else if (!strncmp(argv[i], "--profile-use=", 14)) {
+            g->opt.profileUseFile = ParsePath(argv[i] + strlen("--profile-use="), errorHandler);
+            if (!llvm::sys::fs::exists(g->opt.profileUseFile)) {
+                errorHandler.AddError("Profile file \"%s\" does not exist.", g->opt.profileUseFile.c_str());
+            }
+        }
 #ifndef ISPC_IS_HOST_WINDOWS
         else if (!strcmp(argv[i], "--colored-output"))
             g->forceColoredOutput = true;
@@ -1023,6 +1223,11 @@ int main(int Argc, char *Argv[]) {
             g->dumpFilePath = ParsePath(argv[i] + strlen("--dump-file="), errorHandler);
         } else if (strncmp(argv[i], "--dump-file", 11) == 0) {
             g->dumpFile = true;
+        } else if (strncmp(argv[i], "--print-pass-stats=", 19) == 0) {
+            g->printPassStats = true;
+            g->passStatsFile = ParsePath(argv[i] + strlen("--print-pass-stats="), errorHandler);
+        } else if (!strcmp(argv[i], "--print-pass-stats")) {
+            g->printPassStats = true;
         }
 
         else if (strncmp(argv[i], "--off-phase=", 12) == 0) {
@@ -1033,6 +1238,13 @@ int main(int Argc, char *Argv[]) {
         } else if (!strncmp(argv[i], "--xe-stack-mem-size=", 20)) {
             unsigned int memSize = atoi(argv[i] + 20);
             g->stackMemSize = memSize;
+        } else if (!strcmp(argv[i], "--xe-auto-width")) {
+            g->xeAutoWidth = true;
+        } else if (!strncmp(argv[i], "--xe-kernel-report=", 19)) {
+            g->xeKernelReport = true;
+            g->xeKernelReportFile = ParsePath(argv[i] + strlen("--xe-kernel-report="), errorHandler);
+        } else if (!strcmp(argv[i], "--xe-kernel-report")) {
+            g->xeKernelReport = true;
 #endif
         } else if (!strcmp(argv[i], "-v") || !strcmp(argv[i], "--version")) {
             lPrintVersion();
@@ -1050,10 +1262,37 @@ int main(int Argc, char *Argv[]) {
         }
     }
 
+    if (g->opt.profileGenerate && !g->opt.profileUseFile.empty()) {
+        errorHandler.AddError("--profile-generate and --profile-use can't be used together.");
+    } else if ((g->opt.profileGenerate || !g->opt.profileUseFile.empty()) && g->opt.level == 0) {
+        errorHandler.AddWarning("Profile-guided optimization options are ignored with -O0.");
+    }
+
     // Emit accumulted errors and warnings, if any.
     // All the rest of errors and warnigns will be processed in regullar way.
     errorHandler.Emit();
 
+    if (serverSocket != NULL) {
+        if (lServerContext != nullptr) {
+            Error(SourcePos(), "--server can't be used for compilation served by the compile server.");
+            return 1;
+        }
+        // Preload the builtins of the targets, so the compilations served by
+        // the server copy them instead of parsing.
+        if (targets.empty()) {
+            targets.push_back(ISPCTarget::none);
+        }
+        for (auto target : targets) {
+            g->target = new Target(arch, cpu, target, 0 != (flags & Module::GeneratePIC), false);
+            if (!g->target->isValid()) {
+                return 1;
+            }
+            PreloadBitcodeLibs();
+        }
+        lServerContext = g->ctx;
+        return RunCompileServer(serverSocket, lCompile);
+    }
+
     if (file == NULL) {
         Error(SourcePos(), "No input file were specified. To read text from stdin use \"-\" as file name.");
         exit(1);
@@ -1154,6 +1393,19 @@ int main(int Argc, char *Argv[]) {
                              "be issued, but no output will be generated.");
     }
 
+    if (!g->cppHeaderFile.empty() && headerFileName == NULL) {
+        Error(SourcePos(), "--cpp-header-outfile requires a header file name (-h) for the header it includes.");
+        return 1;
+    }
+
+    if (g->saveOptRecord && g->optRecordFile.empty()) {
+        if (outFileName == NULL || !strcmp(outFileName, "-")) {
+            Error(SourcePos(), "--save-opt-record requires a file name when no output file is specified.");
+            return 1;
+        }
+        g->optRecordFile = std::string(outFileName) + ".opt." + g->optRecordFormat;
+    }
+
     if (g->target_os == TargetOS::windows && (flags & Module::GeneratePIC) != 0) {
         Warning(SourcePos(), "--pic switch for Windows target will be ignored.");
     }
@@ -1170,9 +1422,66 @@ int main(int Argc, char *Argv[]) {
                              "options will be ignored.");
     }
 
+    if (regCall) {
+        if (vectorCall == BooleanOptValue::enabled) {
+            Error(SourcePos(), "--regcall and --vectorcall can't be used together.");
+            return 1;
+        }
+        // Arch is properly set later, default means x86_64.
+        bool isX86 = arch == Arch::x86_64 || arch == Arch::x86 || arch == Arch::none;
+        for (auto target : targets) {
+            isX86 = isX86 && (target == ISPCTarget::none || ISPCTargetIsX86(target));
+        }
+        if (!isX86) {
+            Warning(SourcePos(), "--regcall is supported only for x86 targets, so it will be ignored.");
+            regCall = false;
+        }
+    }
+
     if (targets.size() > 1)
         g->isMultiTargetCompilation = true;
 
+    if (g->emitLTO) {
+        if (ot != Module::Bitcode) {
+            Error(SourcePos(), "--emit-lto can't be combined with other output types.");
+            return 1;
+        }
+        // The host code has to call the target code directly to inline it, the dispatch function is opaque.
+        if (g->isMultiTargetCompilation) {
+            Error(SourcePos(), "--emit-lto is supported for a single target only.");
+            return 1;
+        }
+        for (auto target : targets) {
+            if (ISPCTargetIsGen(target)) {
+                Error(SourcePos(), "--emit-lto is not supported for Xe targets.");
+                return 1;
+            }
+        }
+    }
+
+    if (ot == Module::InlineHeader) {
+        // The header is the code of one target, which the application compiles for its own.
+        if (g->isMultiTargetCompilation) {
+            Error(SourcePos(), "--emit-inline-header is supported for a single target only.");
+            return 1;
+        }
+        for (auto target : targets) {
+            if (ISPCTargetIsGen(target)) {
+                Error(SourcePos(), "--emit-inline-header is not supported for Xe targets.");
+                return 1;
+            }
+        }
+    }
+
+    if (g->customAllocator) {
+        for (auto target : targets) {
+            if (ISPCTargetIsGen(target)) {
+                Warning(SourcePos(), "--custom-allocator is ignored for Xe targets.");
+                break;
+            }
+        }
+    }
+
     if ((ot == Module::Asm) && (intelAsmSyntax != NULL)) {
         std::vector<const char *> Args(3);
         Args[0] = "ispc (LLVM option parsing)";
@@ -1185,8 +1494,8 @@ int main(int Argc, char *Argv[]) {
     }
 
     for (auto target : targets) {
-        if (target == ISPCTarget::wasm_i32x4) {
-            Assert(targets.size() == 1 && "wasm32 supports only one target: i32x4");
+        if (ISPCTargetIsWasm(target)) {
+            Assert(targets.size() == 1 && "multi-target is not supported for wasm32 targets.");
             arch = Arch::wasm32;
             g->target_os = TargetOS::web;
         }
@@ -1203,7 +1512,7 @@ int main(int Argc, char *Argv[]) {
     }
 
     // This needs to happen after the TargetOS is decided.
-    setCallingConv(vectorCall, arch);
+    setCallingConv(vectorCall, regCall, arch);
     if (g->enableTimeTrace) {
         llvm::timeTraceProfilerInitialize(g->timeTraceGranularity, "ispc");
     }
@@ -1212,6 +1521,21 @@ int main(int Argc, char *Argv[]) {
         llvm::TimeTraceScope TimeScope("ExecuteCompiler");
         ret = Module::CompileAndOutput(file, arch, cpu, targets, flags, ot, outFileName, headerFileName, depsFileName,
                                        depsTargetName, hostStubFileName, devStubFileName);
+#ifdef ISPC_XE_ENABLED
+        // Kernels which spill at the wide SIMD width are usually faster at the narrow one, which
+        // has twice as many registers per lane. The narrow target is compiled then instead.
+        ISPCTarget narrowTarget = lNarrowXeTarget(targets);
+        // The source is read once more, so it can't come from stdin.
+        if (ret == 0 && g->xeAutoWidth && g->xeKernelsSpill && narrowTarget != ISPCTarget::none &&
+            ot == Module::ZEBIN && strcmp(file, "-")) {
+            Warning(SourcePos(), "Kernels spill registers for target \"%s\", recompiling for \"%s\".",
+                    ISPCTargetToString(targets[0]).c_str(), ISPCTargetToString(narrowTarget).c_str());
+            g->xeKernelsSpill = false;
+            std::vector<ISPCTarget> narrowTargets{narrowTarget};
+            ret = Module::CompileAndOutput(file, arch, cpu, narrowTargets, flags, ot, outFileName, headerFileName,
+                                           depsFileName, depsTargetName, hostStubFileName, devStubFileName);
+        }
+#endif
     }
 
     if (g->enableTimeTrace) {
@@ -1227,3 +1551,30 @@ int main(int Argc, char *Argv[]) {
 
     return ret;
 }
+
+int main(int Argc, char *Argv[]) {
+    std::vector<char *> argv;
+    lGetAllArgs(Argc, Argv, argv);
+
+    // The client only forwards the command line to the compile server, so
+    // it's done before any initialization.
+    for (auto arg = argv.begin() + 1; arg != argv.end(); ++arg) {
+        if (!strncmp(*arg, "--connect=", 10)) {
+            const char *socketPath = *arg + 10;
+            argv.erase(arg);
+            int ret = 0;
+            if (RunCompileClient(socketPath, argv, ret)) {
+                return ret;
+            }
+            // The server is not running, so compile in this process.
+            break;
+        }
+    }
+
+    llvm::sys::AddSignalHandler(lSignal, NULL);
+
+    // initialize available LLVM targets
+    lInitializeLLVMTargets();
+
+    return lCompile(argv);
+}
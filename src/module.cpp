@@ -41,9 +41,11 @@
 #include "ctx.h"
 #include "expr.h"
 #include "func.h"
+#include "inline_header.h"
 #include "ispc_version.h"
 #include "llvmutil.h"
 #include "opt.h"
+#include "opt/OptRemarks.h"
 #include "stmt.h"
 #include "sym.h"
 #include "type.h"
@@ -53,6 +55,8 @@
 #include <ctype.h>
 #include <fcntl.h>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <iostream>
 #include <set>
 #include <sstream>
@@ -78,11 +82,19 @@
 #include <clang/Lex/ModuleLoader.h>
 #include <clang/Lex/Preprocessor.h>
 #include <clang/Lex/PreprocessorOptions.h>
+#include <llvm/ADT/ScopeExit.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Analysis/ModuleSummaryAnalysis.h>
+#include <llvm/Analysis/ProfileSummaryInfo.h>
 #include <llvm/Analysis/TargetTransformInfo.h>
+#include <llvm/Bitcode/BitcodeReader.h>
 #include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/CodeGen/ParallelCG.h>
 #include <llvm/IR/CFG.h>
 #include <llvm/IR/DataLayout.h>
+#include <llvm/IR/DebugInfo.h>
 #include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/IRPrintingPasses.h>
 #include <llvm/IR/InstIterator.h>
 #include <llvm/IR/Instructions.h>
@@ -90,22 +102,35 @@
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/LegacyPassManager.h>
 #include <llvm/IR/Module.h>
+#include <llvm/IR/Operator.h>
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/IRReader/IRReader.h>
 #include <llvm/Linker/Linker.h>
+#include <llvm/Object/ObjectFile.h>
 #include <llvm/PassRegistry.h>
 #include <llvm/Support/CommandLine.h>
 #include <llvm/Support/DynamicLibrary.h>
 #include <llvm/Support/FileUtilities.h>
 #include <llvm/Support/FormattedStream.h>
 #include <llvm/Support/Host.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Program.h>
+#if ISPC_LLVM_VERSION >= ISPC_LLVM_14_0
+#include <llvm/MC/TargetRegistry.h>
+#else
+#include <llvm/Support/TargetRegistry.h>
+#endif
+#include <llvm/Support/SHA1.h>
 #include <llvm/Support/SourceMgr.h>
 #include <llvm/Support/ToolOutputFile.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/Target/TargetOptions.h>
 #include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/Utils/Cloning.h>
 #include <llvm/Transforms/Utils/ValueMapper.h>
 
 #ifdef ISPC_XE_ENABLED
@@ -205,7 +230,7 @@ static void lStripUnusedDebugInfo(llvm::Module *module) { return; }
 ///////////////////////////////////////////////////////////////////////////
 // Module
 
-Module::Module(const char *fn) : filename(fn) {
+Module::Module(const char *fn, const char *src) : filename(fn), source(src) {
     // It's a hack to do this here, but it must be done after the target
     // information has been set (so e.g. the vector width is known...)  In
     // particular, if we're compiling to multiple targets with different
@@ -263,17 +288,24 @@ Module::Module(const char *fn) : filename(fn) {
             // The kernel name is one of these read symbols. ISPC produces namespace
             // for example "ispc::simple_ispc". Matching the breakpoint location
             // "simple_ispc" with the symbol name fails if module language is C and not C++.
-            diCompileUnit =
-                diBuilder->createCompileUnit(llvm::dwarf::DW_LANG_C_plus_plus,          /* lang */
-                                             srcFile,                                   /* filename */
-                                             ispcVersion.c_str(),                       /* producer */
-                                             g->opt.level > 0 /* is optimized */, "-g", /* command line args */
-                                             0 /* run time version */);
+            diCompileUnit = diBuilder->createCompileUnit(
+                llvm::dwarf::DW_LANG_C_plus_plus,                         /* lang */
+                srcFile,                                                  /* filename */
+                ispcVersion.c_str(),                                      /* producer */
+                g->opt.level > 0,                                         /* is optimized */
+                g->debugLineTablesOnly ? "-gline-tables-only" : "-g",     /* command line args */
+                0,                                                        /* run time version */
+                "",                                                       /* split name */
+                g->debugLineTablesOnly ? llvm::DICompileUnit::LineTablesOnly
+                                       : llvm::DICompileUnit::FullDebug); /* emission kind */
         }
     }
 }
 
 Module::~Module() {
+    // Code generation may still be running in the background, it has to be
+    // finished before the llvm::Module goes away.
+    waitForBackend();
     if (symbolTable)
         delete symbolTable;
     if (ast)
@@ -284,18 +316,248 @@ Module::~Module() {
         delete diBuilder;
 }
 
+///////////////////////////////////////////////////////////////////////////
+// Function cache
+
+static std::string lGetCompileOptions();
+static bool lHasSideOutputs();
+
+/** Returns true if the optimized code of the exported and extern functions
+    is kept in the "functions" directory of the compilation cache.  Debug
+    info describes the whole module, so it can't be cached per function.
+    The reports of the optimization would miss the cached functions. */
+static bool lUseFunctionCache() {
+    return !g->cacheDir.empty() && !g->enableFuzzTest && !g->generateDebuggingSymbols && !g->target->isXeTarget() &&
+           !lHasSideOutputs();
+}
+
+static std::string lGetFunctionCacheFile(const std::string &key) {
+    llvm::SmallString<256> path(g->cacheDir);
+    llvm::sys::path::append(path, "functions", key + ".bc");
+    return std::string(path.str());
+}
+
+/** Adds the functions and global variables that are referenced by the
+    given user, directly or through constant expressions, to the list. */
+static void lAddReferencedGlobals(const llvm::User *user, std::vector<const llvm::GlobalValue *> &refs,
+                                  std::set<const llvm::Value *> &visited) {
+    for (const llvm::Use &op : user->operands()) {
+        const llvm::Value *value = op.get();
+        if (!llvm::isa<llvm::Constant>(value) || !visited.insert(value).second)
+            continue;
+        if (const llvm::GlobalValue *gv = llvm::dyn_cast<llvm::GlobalValue>(value))
+            refs.push_back(gv);
+        else
+            lAddReferencedGlobals(llvm::cast<llvm::User>(value), refs, visited);
+    }
+}
+
+/** Removes the declarations that nothing refers to from the module. */
+static void lRemoveUnusedDeclarations(llvm::Module *module) {
+    for (auto it = module->global_begin(); it != module->global_end();) {
+        llvm::GlobalVariable &var = *it++;
+        if (var.isDeclaration() && var.use_empty())
+            var.eraseFromParent();
+    }
+    for (auto it = module->begin(); it != module->end();) {
+        llvm::Function &func = *it++;
+        if (func.isDeclaration() && func.use_empty())
+            func.eraseFromParent();
+    }
+}
+
+static std::vector<const llvm::GlobalValue *> lGetReferencedGlobals(const llvm::Function &func) {
+    std::vector<const llvm::GlobalValue *> refs;
+    std::set<const llvm::Value *> visited;
+    for (const llvm::Instruction &inst : llvm::instructions(func))
+        lAddReferencedGlobals(&inst, refs, visited);
+    return refs;
+}
+
+/** Returns the key of the function in the function cache.  It covers the
+    unoptimized code of the function and of everything it references
+    transitively, together with the compilation options, so it changes
+    whenever the code the function is optimized with changes. */
+static std::string lGetFunctionCacheKey(const llvm::Module *module, const llvm::Function *func,
+                                        const std::string &options) {
+    std::set<const llvm::GlobalValue *> closure{func};
+    std::vector<const llvm::GlobalValue *> worklist{func};
+    while (!worklist.empty()) {
+        const llvm::GlobalValue *gv = worklist.back();
+        worklist.pop_back();
+        std::vector<const llvm::GlobalValue *> refs;
+        std::set<const llvm::Value *> visited;
+        if (const llvm::Function *f = llvm::dyn_cast<llvm::Function>(gv))
+            refs = lGetReferencedGlobals(*f);
+        else if (const llvm::GlobalVariable *var = llvm::dyn_cast<llvm::GlobalVariable>(gv))
+            lAddReferencedGlobals(var, refs, visited);
+        for (const llvm::GlobalValue *ref : refs) {
+            if (!ref->isDeclaration() && closure.insert(ref).second)
+                worklist.push_back(ref);
+        }
+    }
+
+    // The closure is cloned into a module of its own, so that it is printed
+    // with its attributes and metadata, independently of the rest of the
+    // module.
+    llvm::ValueToValueMapTy vmap;
+    std::unique_ptr<llvm::Module> clone =
+        llvm::CloneModule(*module, vmap, [&](const llvm::GlobalValue *gv) { return closure.count(gv) != 0; });
+    lRemoveUnusedDeclarations(clone.get());
+    clone->setModuleIdentifier("");
+    clone->setSourceFileName("");
+    std::string ir;
+    llvm::raw_string_ostream os(ir);
+    clone->print(os, nullptr);
+
+    llvm::SHA1 hasher;
+    hasher.update(options);
+    hasher.update(func->getName());
+    hasher.update(os.str());
+    return llvm::toHex(hasher.final(), true);
+}
+
+/** Looks the exported and extern functions of the module up in the
+    function cache before the module is optimized.  The bodies of the
+    functions that are found are deleted, so that they aren't optimized
+    again, and the cached ones are returned to be linked in after the
+    optimization.  The keys of the other functions are returned to store
+    them once they are optimized.  Only the functions that aren't called
+    from the module are cached, so that the callers are optimized the
+    same way whether the callee comes from the cache or not. */
+static void lRestoreCachedFunctions(llvm::Module *module, std::map<std::string, std::string> &missedKeys,
+                                    std::map<std::string, std::unique_ptr<llvm::Module>> &cached) {
+    llvm::TimeTraceScope TimeScope("RestoreCachedFunctions");
+    std::string options = lGetCompileOptions();
+    std::vector<std::pair<llvm::Function *, std::string>> keys;
+    for (llvm::Function &func : *module) {
+        if (func.isDeclaration() || func.hasLocalLinkage() || func.hasAvailableExternallyLinkage() ||
+            !func.use_empty())
+            continue;
+        keys.push_back({&func, lGetFunctionCacheKey(module, &func, options)});
+    }
+
+    for (const auto &entry : keys) {
+        llvm::Function *func = entry.first;
+        llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
+            llvm::MemoryBuffer::getFile(lGetFunctionCacheFile(entry.second));
+        if (!buffer) {
+            missedKeys[func->getName().str()] = entry.second;
+            continue;
+        }
+        llvm::Expected<std::unique_ptr<llvm::Module>> cachedModule =
+            llvm::parseBitcodeFile((*buffer)->getMemBufferRef(), *g->ctx);
+        if (!cachedModule) {
+            llvm::consumeError(cachedModule.takeError());
+            missedKeys[func->getName().str()] = entry.second;
+            continue;
+        }
+        if (g->debugPrint) {
+            printf("\nRestored function %s from function cache\n", func->getName().str().c_str());
+        }
+        func->deleteBody();
+        cached[func->getName().str()] = std::move(*cachedModule);
+    }
+}
+
+/** Stores the optimized functions that were missed in the function cache,
+    unless they refer to internal symbols of the module, and then links the
+    ones restored from the cache into the optimized module. */
+static void lStoreAndLinkCachedFunctions(llvm::Module *module, SymbolTable *symbolTable,
+                                         const std::map<std::string, std::string> &missedKeys,
+                                         std::map<std::string, std::unique_ptr<llvm::Module>> &cached) {
+    llvm::TimeTraceScope TimeScope("StoreCachedFunctions");
+    for (const auto &entry : missedKeys) {
+        llvm::Function *func = module->getFunction(entry.first);
+        if (func == nullptr || func->isDeclaration())
+            continue;
+        std::vector<const llvm::GlobalValue *> refs = lGetReferencedGlobals(*func);
+        if (std::any_of(refs.begin(), refs.end(), [](const llvm::GlobalValue *gv) { return gv->hasLocalLinkage(); }))
+            continue;
+
+        llvm::ValueToValueMapTy vmap;
+        std::unique_ptr<llvm::Module> extracted =
+            llvm::CloneModule(*module, vmap, [&](const llvm::GlobalValue *gv) { return gv == func; });
+        lRemoveUnusedDeclarations(extracted.get());
+
+        // Write to a temporary file first, so that concurrent compilations
+        // never read a partial entry.
+        std::string file = lGetFunctionCacheFile(entry.second);
+        llvm::SmallString<256> tmpFile;
+        int fd = -1;
+        if (llvm::sys::fs::create_directories(llvm::sys::path::parent_path(file)) ||
+            llvm::sys::fs::createUniqueFile(file + ".%%%%%%.tmp", fd, tmpFile))
+            continue;
+        {
+            llvm::raw_fd_ostream os(fd, true);
+            llvm::WriteBitcodeToFile(*extracted, os);
+        }
+        if (llvm::sys::fs::rename(tmpFile, file))
+            llvm::sys::fs::remove(tmpFile);
+    }
+
+    if (cached.empty())
+        return;
+
+    // The linker replaces the declarations of the restored functions with
+    // new definitions, so the symbols referring to them are updated after it.
+    auto isRestored = [&](const llvm::Function *func) { return func && cached.count(func->getName().str()); };
+    std::vector<Symbol *> symbols;
+    symbolTable->GetMatchingFunctions(
+        [&](const Symbol *sym) { return isRestored(sym->function) || isRestored(sym->exportedFunction); }, &symbols);
+    std::vector<std::pair<std::string, std::string>> symbolNames;
+    for (const Symbol *sym : symbols) {
+        symbolNames.push_back({sym->function ? sym->function->getName().str() : "",
+                               sym->exportedFunction ? sym->exportedFunction->getName().str() : ""});
+    }
+
+    for (auto &entry : cached) {
+        if (llvm::Linker::linkModules(*module, std::move(entry.second)))
+            Error(SourcePos(), "Failed to link function \"%s\" from the function cache.", entry.first.c_str());
+    }
+    cached.clear();
+
+    for (unsigned int i = 0; i < symbols.size(); ++i) {
+        if (!symbolNames[i].first.empty())
+            symbols[i]->function = module->getFunction(symbolNames[i].first);
+        if (!symbolNames[i].second.empty())
+            symbols[i]->exportedFunction = module->getFunction(symbolNames[i].second);
+    }
+}
+
 extern FILE *yyin;
 extern int yyparse();
 typedef struct yy_buffer_state *YY_BUFFER_STATE;
 extern void yy_switch_to_buffer(YY_BUFFER_STATE);
 extern YY_BUFFER_STATE yy_scan_string(const char *);
+extern YY_BUFFER_STATE yy_scan_buffer(char *, size_t);
 extern YY_BUFFER_STATE yy_create_buffer(FILE *, int);
 extern void yy_delete_buffer(YY_BUFFER_STATE);
 extern void ParserInit();
 
+/** Add the denormal-fp-math attributes to the functions that set the FTZ and
+    DAZ modes on entry, which FunctionEmitContext::SetFunctionFTZ_DAZFlags()
+    marks, so that code generation can rely on denormals being flushed.  With
+    --denormals=flush, all ISPC code runs in this mode.  The attributes are
+    only added after optimization, as the inliner doesn't inline functions
+    with the default mode into ones with a different mode. */
+static void lMarkDenormalFlushingFunctions(llvm::Module *module) {
+    for (llvm::Function &f : *module) {
+        if (f.isDeclaration())
+            continue;
+        bool marked = f.hasFnAttribute("ispc-flush-denormals");
+        if (!marked && !g->flushDenormals)
+            continue;
+        if (marked)
+            f.removeFnAttr("ispc-flush-denormals");
+        f.addFnAttr("denormal-fp-math", "preserve-sign,preserve-sign");
+        f.addFnAttr("denormal-fp-math-f32", "preserve-sign,preserve-sign");
+    }
+}
+
 int Module::CompileFile() {
     llvm::TimeTraceScope CompileFileTimeScope(
-        "CompileFile", llvm::StringRef(filename + ("_" + std::string(g->target->GetISAString()))));
+        "CompileFile", llvm::StringRef(filename + ("_" + g->target->GetVariantString())));
     ParserInit();
 
     // FIXME: it'd be nice to do this in the Module constructor, but this
@@ -311,7 +573,7 @@ int Module::CompileFile() {
 
     if (runPreprocessor) {
         llvm::TimeTraceScope TimeScope("Frontend parser");
-        if (!IsStdin(filename)) {
+        if (source == nullptr && !IsStdin(filename)) {
             // Try to open the file first, since otherwise we crash in the
             // preprocessor if the file doesn't exist.
             FILE *f = fopen(filename, "r");
@@ -322,43 +584,54 @@ int Module::CompileFile() {
             fclose(f);
         }
 
-        // If the CPP stream has been initialized, we have unexpected behavior.
-        if (bufferCPP) {
-            perror(filename);
-            return 1;
+        // The CPP stream may have been initialized already by the compilation
+        // cache lookup, otherwise run the preprocessor now.
+        if (!bufferCPP) {
+            bufferCPP.reset(new CPPBuffer{});
+            // The output is about as large as the source, so allocate it up
+            // front instead of growing it for large sources.
+            uint64_t sourceSize = 0;
+            if (source == nullptr && !IsStdin(filename) && !llvm::sys::fs::file_size(filename, sourceSize))
+                bufferCPP->str.reserve(sourceSize);
+            numCPPErrors = execPreprocessor(!IsStdin(filename) ? filename : "-", bufferCPP->os.get());
         }
-
-        // Replace the CPP stream with a newly allocated one.
-        bufferCPP.reset(new CPPBuffer{});
-
-        const int numErrors = execPreprocessor(!IsStdin(filename) ? filename : "-", bufferCPP->os.get());
-        errorCount += (g->ignoreCPPErrors) ? 0 : numErrors;
+        errorCount += (g->ignoreCPPErrors) ? 0 : numCPPErrors;
 
         if (g->onlyCPP) {
             return errorCount; // Return early
         }
 
-        YY_BUFFER_STATE strbuf = yy_scan_string(bufferCPP->str.c_str());
+        // Scan the preprocessed source in place, rather than having flex copy
+        // it.  Flex requires the buffer to end with two NUL characters.
+        std::string &cppOutput = bufferCPP->os->str();
+        cppOutput.append(2, '\0');
+        YY_BUFFER_STATE strbuf = yy_scan_buffer(&cppOutput[0], cppOutput.size());
         yyparse();
         yy_delete_buffer(strbuf);
         clearCPPBuffer();
     } else {
         llvm::TimeTraceScope TimeScope("Frontend parser");
-        // No preprocessor, just open up the file if it's not stdin..
-        FILE *f = NULL;
-        if (IsStdin(filename)) {
-            f = stdin;
+        // No preprocessor, just open up the file if it's not stdin or use the given source.
+        if (source != nullptr) {
+            YY_BUFFER_STATE strbuf = yy_scan_string(source);
+            yyparse();
+            yy_delete_buffer(strbuf);
         } else {
-            f = fopen(filename, "r");
-            if (f == NULL) {
-                perror(filename);
-                return 1;
+            FILE *f = NULL;
+            if (IsStdin(filename)) {
+                f = stdin;
+            } else {
+                f = fopen(filename, "r");
+                if (f == NULL) {
+                    perror(filename);
+                    return 1;
+                }
             }
+            yyin = f;
+            yy_switch_to_buffer(yy_create_buffer(yyin, 4096));
+            yyparse();
+            fclose(f);
         }
-        yyin = f;
-        yy_switch_to_buffer(yy_create_buffer(yyin, 4096));
-        yyparse();
-        fclose(f);
     }
 
     ast->Print(g->astDump);
@@ -372,13 +645,100 @@ int Module::CompileFile() {
 
     if (diBuilder)
         diBuilder->finalize();
+
+    if (errorCount == 0 && !lazyBuiltins.empty()) {
+        llvm::TimeTraceScope TimeScope("LinkLazyBuiltins");
+        LinkLazyBuiltins(module, lazyBuiltins);
+        // Linked definitions come without the attributes set above.
+        for (llvm::Function &f : *module) {
+            if (f.isDeclaration())
+                continue;
+            if (g->NoOmitFramePointer)
+                f.addFnAttr("no-frame-pointer-elim", "true");
+            g->target->markFuncWithTargetAttr(&f);
+        }
+    }
+
+    if (errorCount == 0 && !parameterBindings.empty())
+        bindParameters();
+
     llvm::TimeTraceScope TimeScope("Optimize");
-    if (errorCount == 0)
+    if (errorCount == 0) {
+        // With a compilation cache, the functions that haven't changed since
+        // they were last optimized are reused from the function cache.
+        std::map<std::string, std::string> missedKeys;
+        std::map<std::string, std::unique_ptr<llvm::Module>> cachedFunctions;
+        bool useFunctionCache = lUseFunctionCache();
+        if (useFunctionCache)
+            lRestoreCachedFunctions(module, missedKeys, cachedFunctions);
         Optimize(module, g->opt.level);
+        if (useFunctionCache)
+            lStoreAndLinkCachedFunctions(module, symbolTable, missedKeys, cachedFunctions);
+        lMarkDenormalFlushingFunctions(module);
+    }
 
     return errorCount;
 }
 
+void Module::bindParameters() {
+    for (const ParameterBinding &binding : parameterBindings) {
+        std::vector<Symbol *> matches;
+        if (!symbolTable->LookupFunction(binding.function.c_str(), &matches)) {
+            Error(SourcePos(), "Can't bind parameter \"%s\" of unknown function \"%s\".", binding.parameter.c_str(),
+                  binding.function.c_str());
+            continue;
+        }
+        bool found = false;
+        // All of the overloads with the parameter are specialized.
+        for (Symbol *sym : matches) {
+            const FunctionType *ftype = CastType<FunctionType>(sym->type);
+            int index = -1;
+            for (int i = 0; i < ftype->GetNumParameters(); ++i) {
+                if (ftype->GetParameterName(i) == binding.parameter) {
+                    index = i;
+                }
+            }
+            if (index == -1) {
+                continue;
+            }
+            found = true;
+            const Type *type = ftype->GetParameterType(index);
+            if (ftype->isTask) {
+                Error(sym->pos, "Can't bind parameter \"%s\" of task function \"%s\".", binding.parameter.c_str(),
+                      binding.function.c_str());
+                continue;
+            }
+            if (CastType<AtomicType>(type) == nullptr || !type->IsUniformType() ||
+                !(type->IsNumericType() || type->IsBoolType())) {
+                Error(sym->pos, "Only uniform numeric and bool parameters can be bound to constants, \"%s\" is \"%s\".",
+                      binding.parameter.c_str(), type->GetString().c_str());
+                continue;
+            }
+            if (type->IsFloatType() != binding.isFloat) {
+                Error(sym->pos, "Parameter \"%s\" of type \"%s\" is bound to %s value.", binding.parameter.c_str(),
+                      type->GetString().c_str(), binding.isFloat ? "a floating-point" : "an integer");
+                continue;
+            }
+            // Both the version of the function called from ispc code and the
+            // one called from the application are specialized.
+            for (llvm::Function *function : {sym->function, sym->exportedFunction}) {
+                if (function == nullptr || function->isDeclaration()) {
+                    continue;
+                }
+                llvm::Argument *arg = function->getArg(index);
+                llvm::Constant *value =
+                    binding.isFloat ? llvm::ConstantFP::get(arg->getType(), binding.floatValue)
+                                    : llvm::ConstantInt::get(arg->getType(), binding.intValue, !type->IsUnsignedType());
+                arg->replaceAllUsesWith(value);
+            }
+        }
+        if (!found) {
+            Error(SourcePos(), "Function \"%s\" has no parameter \"%s\" to bind.", binding.function.c_str(),
+                  binding.parameter.c_str());
+        }
+    }
+}
+
 Symbol *Module::AddLLVMIntrinsicDecl(const std::string &name, ExprList *args, SourcePos pos) {
     if (g->enableLLVMIntrinsics == false) {
         Error(SourcePos(), "Calling LLVM intrinsics from ISPC source code is an experimental feature,"
@@ -475,6 +835,11 @@ void Module::AddGlobalVariable(const std::string &name, const Type *type, Expr *
         return;
     }
 
+    if (storageClass == SC_SHARED) {
+        Error(pos, "\"shared\" qualifier can only be used for variables declared in \"task\" functions.");
+        return;
+    }
+
     if (type->IsVoidType()) {
         Error(pos, "\"void\" type global variable is illegal.");
         return;
@@ -762,6 +1127,11 @@ void Module::AddFunctionDeclaration(const std::string &name, const FunctionType
                                     bool isRegCall, SourcePos pos) {
     Assert(functionType != NULL);
 
+    if (storageClass == SC_SHARED) {
+        Error(pos, "\"shared\" qualifier can only be used for variables declared in \"task\" functions.");
+        return;
+    }
+
     // If a global variable with the same name has already been declared
     // issue an error.
     if (symbolTable->LookupVariable(name.c_str()) != NULL) {
@@ -1115,15 +1485,18 @@ void Module::AddFunctionTemplateDefinition(const TemplateParms *templateParmList
     // template definition, not declaration.
     // This actually a hack, which addresses lack of expressiveness of AST, which doesn't represent pure declaration,
     // only definitions.
+    // The template parameters are updated as well, as the symbols of non-type template parameters, which are used
+    // in the body, are the ones from the definition.
     sym->pos = code->pos;
     sym->type = ftype;
+    sym->templateParms = templateParmList;
 
     ast->AddFunctionTemplate(sym, code);
 }
 
 void Module::AddFunctionTemplateInstantiation(const std::string &name,
-                                              const std::vector<std::pair<const Type *, SourcePos>> &types,
-                                              const FunctionType *ftype, SourcePos pos) {
+                                              const std::vector<TemplateArg> &types, const FunctionType *ftype,
+                                              SourcePos pos) {
     std::vector<TemplateSymbol *> matches;
     bool found = symbolTable->LookupFunctionTemplate(name, &matches);
 
@@ -1133,10 +1506,11 @@ void Module::AddFunctionTemplateInstantiation(const std::string &name,
         //
         // template <typename T> void foo(T t);
         // foo<int>(1); // T is assumed to be "varying int" here.
-        std::vector<std::pair<const Type *, SourcePos>> normTypes(types);
+        std::vector<TemplateArg> normTypes(types);
         for (auto &arg : normTypes) {
-            if (arg.first->GetVariability() == Variability::Unbound) {
-                arg.first = arg.first->GetAsVaryingType();
+            arg.SetAsVaryingType();
+            if (!arg.FoldConstant()) {
+                return;
             }
         }
 
@@ -1148,6 +1522,15 @@ void Module::AddFunctionTemplateInstantiation(const std::string &name,
                 continue;
             }
 
+            // Kinds of template arguments must match the kinds of template parameters.
+            bool kindsMatch = true;
+            for (int i = 0; kindsMatch && i < normTypes.size(); i++) {
+                kindsMatch = normTypes[i].IsType() == (*templateSymbol->templateParms)[i]->IsTypeParam();
+            }
+            if (!kindsMatch) {
+                continue;
+            }
+
             // Number of function parameters must match.
             if (!ftype || !templateSymbol->type ||
                 ftype->GetNumParameters() != templateSymbol->type->GetNumParameters()) {
@@ -1172,7 +1555,12 @@ void Module::AddFunctionTemplateInstantiation(const std::string &name,
         }
 
         if (templ) {
-            templ->AddInstantiation(normTypes);
+            // The same explicit instantiation may appear several times, e.g.
+            // in a header included by several files, or after the template
+            // was already instantiated by a call.
+            if (templ->LookupInstantiation(normTypes) == nullptr) {
+                templ->AddInstantiation(normTypes);
+            }
         } else {
             Error(pos, "No matching function template found for instantiation.");
         }
@@ -1224,7 +1612,8 @@ bool Module::writeOutput(OutputType outputType, OutputFlags flags, const char *o
                     fileType = "assembly";
                 break;
             case Bitcode:
-                if (strcasecmp(suffix, "bc"))
+                // Bitcode for LTO usually takes the place of an object file.
+                if (strcasecmp(suffix, "bc") && (!g->emitLTO || (strcasecmp(suffix, "o") && strcasecmp(suffix, "obj"))))
                     fileType = "LLVM bitcode";
                 break;
             case BitcodeText:
@@ -1261,6 +1650,10 @@ bool Module::writeOutput(OutputType outputType, OutputFlags flags, const char *o
                     strcasecmp(suffix, "cxx") && strcasecmp(suffix, "cpp"))
                     fileType = "host-side offload stub";
                 break;
+            case InlineHeader:
+                if (strcasecmp(suffix, "h") && strcasecmp(suffix, "hh") && strcasecmp(suffix, "hpp"))
+                    fileType = "inline header";
+                break;
             case CPPStub:
                 if (strcasecmp(suffix, "ispi") && strcasecmp(suffix, "i"))
                     fileType = "preprocessed stub";
@@ -1287,6 +1680,8 @@ bool Module::writeOutput(OutputType outputType, OutputFlags flags, const char *o
         return writeHostStub(outFileName);
     else if (outputType == DevStub)
         return writeDevStub(outFileName);
+    else if (outputType == InlineHeader)
+        return writeInlineHeader(outFileName);
     else if ((outputType == Bitcode) || (outputType == BitcodeText))
         return writeBitcode(module, outFileName, outputType);
 #ifdef ISPC_XE_ENABLED
@@ -1322,7 +1717,13 @@ bool Module::writeBitcode(llvm::Module *module, const char *outFileName, OutputT
     }
 
     llvm::raw_fd_ostream fos(fd, (fd != 1), false);
-    if (outputType == Bitcode)
+    if (outputType == Bitcode && g->emitLTO) {
+        // The summary is what makes the linker treat the bitcode as a ThinLTO module and import the functions
+        // of it into the modules of the host code calling them.
+        llvm::ProfileSummaryInfo PSI(*module);
+        llvm::ModuleSummaryIndex index = llvm::buildModuleSummaryIndex(*module, nullptr, &PSI);
+        llvm::WriteBitcodeToFile(*module, fos, false, &index);
+    } else if (outputType == Bitcode)
         llvm::WriteBitcodeToFile(*module, fos);
     else if (outputType == BitcodeText)
         module->print(fos, nullptr);
@@ -1411,6 +1812,168 @@ static void saveOutput(uint32_t numOutputs, uint8_t **dataOutputs, uint64_t *len
     oclocRes.assign(binRef.begin(), binRef.end());
 }
 
+// Register usage of a kernel as seen by the VC backend.
+struct XeKernelInfo {
+    std::string name;
+    int simdSize = 0;
+    int grfCount = 0;
+    int spillSize = 0;
+    int privateSize = 0;
+};
+
+static int lZeInfoInt(llvm::StringRef value) {
+    int result = 0;
+    value.trim().getAsInteger(10, result);
+    return result;
+}
+
+// Extract per-kernel register usage from the ".ze_info" section of a zebin.
+// The section is YAML, but its layout is fixed enough to be read line by line:
+// every kernel starts with "- name:" at the upper level and its scratch buffers
+// are listed under "per_thread_memory_buffers".
+static std::vector<XeKernelInfo> lParseZeInfo(llvm::StringRef zeInfo) {
+    std::vector<XeKernelInfo> kernels;
+    bool inKernels = false, inBuffers = false;
+    // The keys of a buffer entry may come in any order, so it is accounted once complete.
+    llvm::StringRef bufferUsage;
+    int bufferSize = 0;
+    auto flushBuffer = [&]() {
+        if (bufferSize > 0 && !kernels.empty()) {
+            if (bufferUsage == "spill_fill_space") {
+                kernels.back().spillSize += bufferSize;
+            } else {
+                kernels.back().privateSize += bufferSize;
+            }
+        }
+        bufferUsage = llvm::StringRef();
+        bufferSize = 0;
+    };
+    llvm::SmallVector<llvm::StringRef, 64> lines;
+    zeInfo.split(lines, '\n');
+    for (llvm::StringRef line : lines) {
+        size_t indent = line.find_first_not_of(' ');
+        llvm::StringRef text = line.trim();
+        if (text.empty() || text.startswith("#")) {
+            continue;
+        }
+        if (indent == 0) {
+            flushBuffer();
+            inKernels = text == "kernels:";
+            inBuffers = false;
+            continue;
+        }
+        if (!inKernels) {
+            continue;
+        }
+        if (text.startswith("- name:")) {
+            flushBuffer();
+            kernels.push_back(XeKernelInfo());
+            kernels.back().name = text.drop_front(strlen("- name:")).trim().str();
+            inBuffers = false;
+            continue;
+        }
+        if (kernels.empty()) {
+            continue;
+        }
+        if (text == "per_thread_memory_buffers:") {
+            inBuffers = true;
+            continue;
+        }
+        if (text.endswith(":")) {
+            flushBuffer();
+            inBuffers = false;
+            continue;
+        }
+        if (inBuffers && text.startswith("- ")) {
+            flushBuffer();
+        }
+        llvm::StringRef key, value;
+        std::tie(key, value) = text.ltrim("- ").split(':');
+        key = key.trim();
+        value = value.trim();
+        if (inBuffers) {
+            if (key == "size") {
+                bufferSize = lZeInfoInt(value);
+            } else if (key == "usage") {
+                bufferUsage = value;
+            }
+        } else if (key == "simd_size") {
+            kernels.back().simdSize = lZeInfoInt(value);
+        } else if (key == "grf_count") {
+            kernels.back().grfCount = lZeInfoInt(value);
+        }
+    }
+    flushBuffer();
+    return kernels;
+}
+
+// Number of hardware threads which may be resident per EU with the given register file size.
+static int lXeThreadsPerEU(int grfCount) {
+    switch (g->target->getXePlatform()) {
+    case Target::XePlatform::gen9:
+    case Target::XePlatform::xe_lp:
+        return 7;
+    default:
+        return grfCount > 128 ? 4 : 8;
+    }
+}
+
+// Warn about the kernels which spill registers and print the register report when requested.
+static void lReportXeKernels(const std::vector<char> &zebin) {
+    llvm::StringRef binary(zebin.data(), zebin.size());
+    auto object = llvm::object::ObjectFile::createObjectFile(llvm::MemoryBufferRef(binary, "zebin"));
+    if (!object) {
+        llvm::consumeError(object.takeError());
+        return;
+    }
+    std::vector<XeKernelInfo> kernels;
+    for (const llvm::object::SectionRef &section : (*object)->sections()) {
+        llvm::Expected<llvm::StringRef> name = section.getName();
+        if (!name || *name != ".ze_info") {
+            if (!name) {
+                llvm::consumeError(name.takeError());
+            }
+            continue;
+        }
+        llvm::Expected<llvm::StringRef> contents = section.getContents();
+        if (!contents) {
+            llvm::consumeError(contents.takeError());
+            return;
+        }
+        kernels = lParseZeInfo(*contents);
+    }
+
+    for (const XeKernelInfo &kernel : kernels) {
+        if (kernel.spillSize > 0) {
+            g->xeKernelsSpill = true;
+            PerformanceWarning(SourcePos(), "Kernel \"%s\" spills %d bytes of registers at SIMD%d.",
+                               kernel.name.c_str(), kernel.spillSize, kernel.simdSize);
+        }
+    }
+    if (!g->xeKernelReport) {
+        return;
+    }
+    PrintReport(g->xeKernelReportFile, "Xe kernel report", [&](llvm::raw_ostream &os) {
+        llvm::json::OStream J(os);
+        J.object([&] {
+            J.attribute("target", ISPCTargetToString(g->target->getISPCTarget()));
+            J.attributeArray("kernels", [&] {
+                for (const XeKernelInfo &kernel : kernels) {
+                    J.object([&] {
+                        J.attribute("kernel", kernel.name);
+                        J.attribute("simd", kernel.simdSize);
+                        J.attribute("grf", kernel.grfCount);
+                        J.attribute("spill", kernel.spillSize);
+                        J.attribute("private", kernel.privateSize);
+                        J.attribute("threadsPerEU", lXeThreadsPerEU(kernel.grfCount));
+                    });
+                }
+            });
+        });
+        os << "\n";
+    });
+}
+
 bool Module::writeZEBin(llvm::Module *module, const char *outFileName) {
     std::stringstream translatedStream;
     bool success = translateToSPIRV(module, translatedStream);
@@ -1502,6 +2065,7 @@ bool Module::writeZEBin(llvm::Module *module, const char *outFileName) {
         Error(SourcePos(), "Call to oclocFreeOutput failed \n");
         return false;
     }
+    lReportXeKernels(oclocRes);
 
     if (!strcmp(outFileName, "-")) {
         std::cout.write(oclocRes.data(), oclocRes.size());
@@ -1513,28 +2077,155 @@ bool Module::writeZEBin(llvm::Module *module, const char *outFileName) {
 }
 #endif // ISPC_XE_ENABLED
 
-bool Module::writeObjectFileOrAssembly(OutputType outputType, const char *outFileName) {
-    llvm::TargetMachine *targetMachine = g->target->GetTargetMachine();
-    return writeObjectFileOrAssembly(targetMachine, module, outputType, outFileName);
-}
-
-bool Module::writeObjectFileOrAssembly(llvm::TargetMachine *targetMachine, llvm::Module *module, OutputType outputType,
-                                       const char *outFileName) {
+/** Opens the output file for object file or assembly output. Returns NULL
+    and reports an error if the file can't be opened. */
+static std::shared_ptr<llvm::ToolOutputFile> lOpenObjectFileOrAssembly(Module::OutputType outputType,
+                                                                       const char *outFileName) {
     // Figure out if we're generating object file or assembly output, and
     // set binary output for object files
-    llvm::CodeGenFileType fileType = (outputType == Object) ? llvm::CGFT_ObjectFile : llvm::CGFT_AssemblyFile;
-    bool binary = (fileType == llvm::CGFT_ObjectFile);
-
+    bool binary = (outputType == Module::Object);
     llvm::sys::fs::OpenFlags flags = binary ? llvm::sys::fs::OF_None : llvm::sys::fs::OF_Text;
 
     std::error_code error;
 
-    std::unique_ptr<llvm::ToolOutputFile> of(new llvm::ToolOutputFile(outFileName, error, flags));
+    std::shared_ptr<llvm::ToolOutputFile> of(new llvm::ToolOutputFile(outFileName, error, flags));
 
     if (error) {
         Error(SourcePos(), "Cannot open output file \"%s\".\n", outFileName);
+        return nullptr;
+    }
+    return of;
+}
+
+/** Returns the linker that combines the object files generated on several
+    threads (--codegen-threads) into one, or an empty string if the code
+    generation has to run on a single thread. The host "ld -r" is only used
+    for ELF objects of the host architecture, which it is known to handle;
+    the code for other targets is generated on a single thread from the
+    whole module in memory. */
+static std::string lGetPartitionLinker(const llvm::TargetMachine *targetMachine, Module::OutputType outputType) {
+    if (g->codegenThreads <= 1 || outputType != Module::Object) {
+        return "";
+    }
+    const llvm::Triple &triple = targetMachine->getTargetTriple();
+    llvm::Triple hostTriple(llvm::sys::getProcessTriple());
+    if (!triple.isOSBinFormatELF() || !hostTriple.isOSBinFormatELF() || triple.getArch() != hostTriple.getArch()) {
+        Warning(SourcePos(),
+                "Host linker can't combine object files for target \"%s\", --codegen-threads is ignored.",
+                triple.str().c_str());
+        return "";
+    }
+    static llvm::ErrorOr<std::string> linker = llvm::sys::findProgramByName("ld");
+    if (!linker) {
+        Warning(SourcePos(), "Linker \"ld\" is not found, --codegen-threads is ignored.");
+        return "";
+    }
+    return *linker;
+}
+
+/** Creates a copy of the target machine, so code generation can run on
+    several threads at once. */
+static std::unique_ptr<llvm::TargetMachine> lCloneTargetMachine(const llvm::TargetMachine *targetMachine) {
+    return std::unique_ptr<llvm::TargetMachine>(targetMachine->getTarget().createTargetMachine(
+        targetMachine->getTargetTriple().str(), targetMachine->getTargetCPU(),
+        targetMachine->getTargetFeatureString(), targetMachine->Options, targetMachine->getRelocationModel(),
+        targetMachine->getCodeModel(), targetMachine->getOptLevel()));
+}
+
+/** Splits the module into the given number of partitions, generates object
+    files for them on separate threads and combines them into a single
+    relocatable object file with the linker. Returns false and sets the
+    message if any of these steps fails, nothing is written to the output
+    stream in this case. A temporary file that can't be removed is also
+    reported in the message, but doesn't make it fail. */
+static bool lEmitObjectFileParallel(llvm::TargetMachine *targetMachine, llvm::Module *module, int threads,
+                                    const std::string &linker, llvm::raw_pwrite_stream &os, std::string &message) {
+    std::vector<std::string> files;
+    auto removeFiles = llvm::make_scope_exit([&files, &message]() {
+        for (const std::string &file : files) {
+            std::error_code error = llvm::sys::fs::remove(file);
+            if (error && message.empty()) {
+                message = "Can't remove temporary file \"" + file + "\": " + error.message();
+            }
+        }
+    });
+
+    std::vector<std::unique_ptr<llvm::raw_fd_ostream>> partStreams;
+    std::vector<llvm::raw_pwrite_stream *> partStreamPtrs;
+    for (int i = 0; i < threads; ++i) {
+        int fd = -1;
+        llvm::SmallString<128> path;
+        if (std::error_code error = llvm::sys::fs::createTemporaryFile("ispc-codegen", "o", fd, path)) {
+            message = "Can't create temporary file: " + error.message();
+            return false;
+        }
+        files.push_back(path.str().str());
+        partStreams.push_back(std::make_unique<llvm::raw_fd_ostream>(fd, /* shouldClose */ true));
+        partStreamPtrs.push_back(partStreams.back().get());
+    }
+    llvm::SmallString<128> linkedPath;
+    if (std::error_code error = llvm::sys::fs::createTemporaryFile("ispc-codegen", "o", linkedPath)) {
+        message = "Can't create temporary file: " + error.message();
+        return false;
+    }
+    files.push_back(linkedPath.str().str());
+
+    // Every partition is code generated in its own LLVMContext, so the
+    // module itself is only read on this thread. Local symbols stay in the
+    // same partition as their users, so they are not turned into global
+    // symbols and the linked object has the same set of global symbols
+    // (exported functions, dispatch functions) as the one generated at once.
+    llvm::splitCodeGen(
+        *module, partStreamPtrs, {}, [targetMachine]() { return lCloneTargetMachine(targetMachine); },
+        llvm::CGFT_ObjectFile, /* PreserveLocals */ true);
+    for (int i = 0; i < threads; ++i) {
+        partStreams[i]->close();
+        if (partStreams[i]->has_error()) {
+            message = "Can't write temporary file \"" + files[i] + "\": " + partStreams[i]->error().message();
+            partStreams[i]->clear_error();
+            return false;
+        }
+    }
+
+    std::vector<llvm::StringRef> args = {linker, "-r", "-o", linkedPath.str()};
+    for (int i = 0; i < threads; ++i) {
+        args.push_back(files[i]);
+    }
+    std::string linkerError;
+    if (llvm::sys::ExecuteAndWait(linker, args, /* Env */ {}, /* Redirects */ {}, 0, 0, &linkerError) != 0) {
+        message = "\"" + linker + " -r\" failed" + (linkerError.empty() ? "" : ": " + linkerError);
+        return false;
+    }
+
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> linked = llvm::MemoryBuffer::getFile(linkedPath);
+    if (!linked) {
+        message = "Can't read temporary file \"" + files.back() + "\": " + linked.getError().message();
         return false;
     }
+    os << (*linked)->getBuffer();
+    return true;
+}
+
+/** Runs LLVM code generation for the module, writing the result to the
+    already opened output file. If the linker is given, the code generation
+    of object file is split between the given number of threads. This
+    function doesn't use any global ispc state, so it may be called from a
+    thread other than the main one; instead of reporting a warning, it
+    returns its message, or an empty string if there is none. */
+static std::string lEmitObjectFileOrAssembly(llvm::TargetMachine *targetMachine, llvm::Module *module,
+                                             Module::OutputType outputType, llvm::ToolOutputFile *of, int threads,
+                                             const std::string &linker) {
+    std::string message;
+    if (outputType == Module::Object && threads > 1 && !linker.empty()) {
+        if (lEmitObjectFileParallel(targetMachine, module, threads, linker, of->os(), message)) {
+            of->keep();
+            return message;
+        }
+        // Fall back to the code generation on a single thread.
+        message += ", --codegen-threads is ignored.";
+    }
+
+    llvm::CodeGenFileType fileType = (outputType == Module::Object) ? llvm::CGFT_ObjectFile : llvm::CGFT_AssemblyFile;
 
     llvm::legacy::PassManager pm;
 
@@ -1552,6 +2243,51 @@ bool Module::writeObjectFileOrAssembly(llvm::TargetMachine *targetMachine, llvm:
         // Success; tell tool_output_file to keep the final output file.
         of->keep();
     }
+    return message;
+}
+
+bool Module::writeObjectFileOrAssembly(OutputType outputType, const char *outFileName) {
+    llvm::TargetMachine *targetMachine = g->target->GetTargetMachine();
+    if (!g->parallelTargetCompile || !g->isMultiTargetCompilation) {
+        return writeObjectFileOrAssembly(targetMachine, module, outputType, outFileName);
+    }
+
+    // The output file is opened here, so the errors are reported in the main
+    // thread. The code generation itself doesn't touch any ispc state, so it
+    // is safe to run it in the background while the next target is compiled.
+    std::shared_ptr<llvm::ToolOutputFile> of = lOpenObjectFileOrAssembly(outputType, outFileName);
+    if (!of) {
+        return false;
+    }
+    llvm::Module *llvmModule = module;
+    int threads = g->codegenThreads;
+    std::string linker = lGetPartitionLinker(targetMachine, outputType);
+    backendJob = std::async(std::launch::async, [targetMachine, llvmModule, outputType, of, threads, linker]() {
+        return lEmitObjectFileOrAssembly(targetMachine, llvmModule, outputType, of.get(), threads, linker);
+    });
+    return true;
+}
+
+void Module::waitForBackend() {
+    if (backendJob.valid()) {
+        std::string message = backendJob.get();
+        if (!message.empty()) {
+            Warning(SourcePos(), "%s", message.c_str());
+        }
+    }
+}
+
+bool Module::writeObjectFileOrAssembly(llvm::TargetMachine *targetMachine, llvm::Module *module, OutputType outputType,
+                                       const char *outFileName) {
+    std::shared_ptr<llvm::ToolOutputFile> of = lOpenObjectFileOrAssembly(outputType, outFileName);
+    if (!of) {
+        return false;
+    }
+    std::string message = lEmitObjectFileOrAssembly(targetMachine, module, outputType, of.get(), g->codegenThreads,
+                                                    lGetPartitionLinker(targetMachine, outputType));
+    if (!message.empty()) {
+        Warning(SourcePos(), "%s", message.c_str());
+    }
     return true;
 }
 
@@ -1686,44 +2422,300 @@ static void lEmitStructDecls(std::vector<const StructType *> &structTypes, FILE
         lEmitStructDecl(structTypes[i], &emittedStructs, file, emitUnifs);
 }
 
-/** Emit C declarations of enumerator types to the generated header file.
+/** C++ templates that describe the layouts of soa<W> types and an array
+    container in this layout, which are emitted once for all headers.
  */
-static void lEmitEnumDecls(const std::vector<const EnumType *> &enumTypes, FILE *file) {
-    if (enumTypes.size() == 0)
-        return;
+static const char *lSoAHelpers = R"(
+#ifdef __cplusplus
+#ifndef __ISPC_SOA_HELPERS__
+#define __ISPC_SOA_HELPERS__
+// In-memory layout of soa<W> T, in which each uniform value of T is an array
+// of W values.  The layouts of structs are specialized for each of them.
+template <typename T, int W> struct SoALayout {
+    typedef T Type[W];
+    static void load(const Type &soa, int i, T &aos) { aos = soa[i]; }
+    static void store(Type &soa, int i, const T &aos) { soa[i] = aos; }
+};
 
-    fprintf(file, "///////////////////////////////////////////////////////////////////////////\n");
-    fprintf(file, "// Enumerator types with external visibility from ispc code\n");
-    fprintf(file, "///////////////////////////////////////////////////////////////////////////\n\n");
+template <typename T, size_t N, int W> struct SoALayout<T[N], W> {
+    typedef typename SoALayout<T, W>::Type Type[N];
+    static void load(const Type &soa, int i, T (&aos)[N]) {
+        for (size_t j = 0; j < N; ++j)
+            SoALayout<T, W>::load(soa[j], i, aos[j]);
+    }
+    static void store(Type &soa, int i, const T (&aos)[N]) {
+        for (size_t j = 0; j < N; ++j)
+            SoALayout<T, W>::store(soa[j], i, aos[j]);
+    }
+};
 
-    for (unsigned int i = 0; i < enumTypes.size(); ++i) {
-        fprintf(file, "#ifndef __ISPC_ENUM_%s__\n", enumTypes[i]->GetEnumName().c_str());
-        fprintf(file, "#define __ISPC_ENUM_%s__\n", enumTypes[i]->GetEnumName().c_str());
-        std::string declaration = enumTypes[i]->GetCDeclaration("");
-        fprintf(file, "%s {\n", declaration.c_str());
+// Convert count elements from an array of structures to an array of soa<W>
+// structures that holds at least (count + W - 1) / W of them, and back.
+template <int W, typename T> void aosToSoa(const T *aos, size_t count, typename SoALayout<T, W>::Type *soa) {
+    for (size_t i = 0; i < count; ++i)
+        SoALayout<T, W>::store(soa[i / W], int(i % W), aos[i]);
+}
 
-        // Print the individual enumerators
-        for (int j = 0; j < enumTypes[i]->GetEnumeratorCount(); ++j) {
-            const Symbol *e = enumTypes[i]->GetEnumerator(j);
-            Assert(e->constValue != NULL);
-            unsigned int enumValue[1];
-            int count = e->constValue->GetValues(enumValue);
-            Assert(count == 1);
+template <int W, typename T> void soaToAos(const typename SoALayout<T, W>::Type *soa, size_t count, T *aos) {
+    for (size_t i = 0; i < count; ++i)
+        SoALayout<T, W>::load(soa[i / W], int(i % W), aos[i]);
+}
 
-            // Always print an initializer to set the value.  We could be
-            // 'clever' here and detect whether the implicit value given by
-            // one plus the previous enumerator value (or zero, for the
-            // first enumerator) is the same as the value stored with the
-            // enumerator, though that doesn't seem worth the trouble...
-            fprintf(file, "    %s = %d%c\n", e->name.c_str(), enumValue[0],
-                    (j < enumTypes[i]->GetEnumeratorCount() - 1) ? ',' : ' ');
+// Array of elements of type T in the layout of soa<W> T, whose data() is
+// passed to ispc functions that take a pointer to soa<W> T.  The blocks of W
+// elements are aligned to Align bytes and the last one is padded with zeros.
+template <typename T, int W, size_t Align = 64> class SoAArray {
+  public:
+    typedef typename SoALayout<T, W>::Type Block;
+    typedef T value_type;
+
+    class Reference {
+      public:
+        Reference(Block *blocks, size_t index) : m_blocks(blocks), m_index(index) {}
+        operator T() const {
+            T value;
+            SoALayout<T, W>::load(m_blocks[m_index / W], int(m_index % W), value);
+            return value;
         }
-        fprintf(file, "};\n");
-        fprintf(file, "#endif\n\n");
+        Reference &operator=(const T &value) {
+            SoALayout<T, W>::store(m_blocks[m_index / W], int(m_index % W), value);
+            return *this;
+        }
+        Reference &operator=(const Reference &other) { return *this = T(other); }
+
+      private:
+        Block *m_blocks;
+        size_t m_index;
+    };
+
+    template <typename A, typename R> class Iterator {
+      public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef void pointer;
+        typedef R reference;
+
+        Iterator(A *array, size_t index) : m_array(array), m_index(index) {}
+        R operator*() const { return (*m_array)[m_index]; }
+        R operator[](difference_type n) const { return (*m_array)[m_index + n]; }
+        Iterator &operator++() { ++m_index; return *this; }
+        Iterator operator++(int) { Iterator it = *this; ++m_index; return it; }
+        Iterator &operator--() { --m_index; return *this; }
+        Iterator operator--(int) { Iterator it = *this; --m_index; return it; }
+        Iterator &operator+=(difference_type n) { m_index += n; return *this; }
+        Iterator &operator-=(difference_type n) { m_index -= n; return *this; }
+        Iterator operator+(difference_type n) const { return Iterator(m_array, m_index + n); }
+        Iterator operator-(difference_type n) const { return Iterator(m_array, m_index - n); }
+        difference_type operator-(const Iterator &other) const {
+            return difference_type(m_index) - difference_type(other.m_index);
+        }
+        bool operator==(const Iterator &other) const { return m_index == other.m_index; }
+        bool operator!=(const Iterator &other) const { return m_index != other.m_index; }
+        bool operator<(const Iterator &other) const { return m_index < other.m_index; }
+        bool operator>(const Iterator &other) const { return m_index > other.m_index; }
+        bool operator<=(const Iterator &other) const { return m_index <= other.m_index; }
+        bool operator>=(const Iterator &other) const { return m_index >= other.m_index; }
+
+      private:
+        A *m_array;
+        size_t m_index;
+    };
+    typedef Iterator<SoAArray, Reference> iterator;
+    typedef Iterator<const SoAArray, T> const_iterator;
+
+    SoAArray() { resize(0); }
+    explicit SoAArray(size_t size) { resize(size); }
+    SoAArray(const T *aos, size_t count) { assign(aos, count); }
+    SoAArray(SoAArray &&other) : m_size(other.m_size), m_memory(other.m_memory), m_blocks(other.m_blocks) {
+        other.m_size = 0;
+        other.m_memory = nullptr;
+        other.m_blocks = nullptr;
     }
-}
-
-/** Print declarations of VectorTypes used in 'export'ed parts of the
+    SoAArray &operator=(SoAArray &&other) {
+        std::swap(m_size, other.m_size);
+        std::swap(m_memory, other.m_memory);
+        std::swap(m_blocks, other.m_blocks);
+        return *this;
+    }
+    SoAArray(const SoAArray &) = delete;
+    SoAArray &operator=(const SoAArray &) = delete;
+    ~SoAArray() { std::free(m_memory); }
+
+    size_t size() const { return m_size; }
+    size_t blockCount() const { return (m_size + W - 1) / W; }
+    Block *data() { return m_blocks; }
+    const Block *data() const { return m_blocks; }
+
+    // The elements added by growing the array are zero.
+    void resize(size_t size) {
+        const size_t blocks = (size + W - 1) / W;
+        void *memory = std::calloc(blocks * sizeof(Block) + Align, 1);
+        if (memory == nullptr)
+            throw std::bad_alloc();
+        Block *aligned = (Block *)(((uintptr_t)memory + Align - 1) & ~(uintptr_t)(Align - 1));
+        for (size_t i = 0; i < size && i < m_size; ++i) {
+            T value;
+            SoALayout<T, W>::load(m_blocks[i / W], int(i % W), value);
+            SoALayout<T, W>::store(aligned[i / W], int(i % W), value);
+        }
+        std::free(m_memory);
+        m_size = size;
+        m_memory = memory;
+        m_blocks = aligned;
+    }
+
+    void assign(const T *aos, size_t count) {
+        resize(0);
+        resize(count);
+        aosToSoa<W>(aos, count, m_blocks);
+    }
+    void copyTo(T *aos) const { soaToAos<W>(m_blocks, m_size, aos); }
+
+    Reference operator[](size_t i) { return Reference(m_blocks, i); }
+    T operator[](size_t i) const {
+        T value;
+        SoALayout<T, W>::load(m_blocks[i / W], int(i % W), value);
+        return value;
+    }
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, m_size); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, m_size); }
+
+  private:
+    size_t m_size{0};
+    void *m_memory{nullptr};
+    Block *m_blocks{nullptr};
+};
+#endif // __ISPC_SOA_HELPERS__
+#endif // __cplusplus
+)";
+
+/** Returns true if the type can be a member of a struct that has soa applied
+    to it, i.e. it has no rate qualifier and isn't a reference or a short
+    vector, all of which the SoA helpers don't lay out.
+ */
+static bool lIsSoACompatible(const Type *type) {
+    if (type->IsVaryingType() || type->GetSOAWidth() > 0 || CastType<ReferenceType>(type) != NULL ||
+        CastType<VectorType>(type) != NULL)
+        return false;
+    if (const ArrayType *at = CastType<ArrayType>(type))
+        return lIsSoACompatible(at->GetElementType());
+    if (const StructType *st = CastType<StructType>(type)) {
+        for (int i = 0; i < st->GetElementCount(); ++i)
+            if (!lIsSoACompatible(st->GetElementType(i)))
+                return false;
+    }
+    return true;
+}
+
+/** Emit the specialization of SoALayout for a struct, after the ones of the
+    structs it contains.  All members have the layout of their type in
+    soa<W>, so the layout matches the one ispc uses for soa<W> of the struct.
+ */
+static void lEmitSoALayout(const StructType *st, std::vector<const StructType *> *emittedStructs, FILE *file) {
+    for (int i = 0; i < (int)emittedStructs->size(); ++i)
+        if (Type::EqualIgnoringConst(st, (*emittedStructs)[i]))
+            return;
+
+    for (int i = 0; i < st->GetElementCount(); ++i) {
+        const StructType *elementStructType = lGetElementStructType(st->GetElementType(i));
+        if (elementStructType != NULL)
+            lEmitSoALayout(elementStructType, emittedStructs, file);
+    }
+    emittedStructs->push_back(st);
+
+    std::string cName = st->GetCStructName();
+    const char *name = cName.c_str();
+    fprintf(file, "#ifndef __ISPC_SOA_LAYOUT_%s__\n", name);
+    fprintf(file, "#define __ISPC_SOA_LAYOUT_%s__\n", name);
+    fprintf(file, "template <int W> struct SoALayout<%s, W> {\n", name);
+    fprintf(file, "    struct Type {\n");
+    for (int i = 0; i < st->GetElementCount(); ++i) {
+        const char *member = st->GetElementName(i).c_str();
+        fprintf(file, "        typename SoALayout<decltype(%s::%s), W>::Type %s;\n", name, member, member);
+    }
+    fprintf(file, "    };\n");
+    const char *ops[] = {"load", "store"};
+    for (const char *op : ops) {
+        bool isLoad = op == ops[0];
+        fprintf(file, "    static void %s(%sType &soa, int i, %s%s &aos) {\n", op, isLoad ? "const " : "",
+                isLoad ? "" : "const ", name);
+        for (int i = 0; i < st->GetElementCount(); ++i) {
+            const char *member = st->GetElementName(i).c_str();
+            fprintf(file, "        SoALayout<decltype(%s::%s), W>::%s(soa.%s, i, aos.%s);\n", name, member, op, member,
+                    member);
+        }
+        fprintf(file, "    }\n");
+    }
+    fprintf(file, "};\n");
+    fprintf(file, "#endif\n\n");
+}
+
+/** Emit the SoA helpers for the structs of the header whose members can all
+    be laid out in soa<W>.
+ */
+static void lEmitSoAHelpers(const std::vector<const StructType *> &structTypes, FILE *file) {
+    std::vector<const StructType *> emittedStructs;
+
+    fprintf(file, "%s", lSoAHelpers);
+    fprintf(file, "\n#ifdef __cplusplus\n");
+    for (unsigned int i = 0; i < structTypes.size(); ++i)
+        if (structTypes[i]->GetSOAWidth() == 0 && lIsSoACompatible(structTypes[i]))
+            lEmitSoALayout(structTypes[i], &emittedStructs, file);
+    // The soa<W> structs that exported functions take have the same layout,
+    // so the data of a SoAArray can be cast to pointers to them.
+    for (unsigned int i = 0; i < structTypes.size(); ++i) {
+        const StructType *st = structTypes[i];
+        if (st->GetSOAWidth() > 0 && lIsSoACompatible(st->GetAsUniformType())) {
+            std::string name = st->GetCStructName();
+            fprintf(file, "static_assert(sizeof(SoALayout<%s, %d>::Type) == sizeof(%s_SOA%d), \"soa<%d> %s\");\n",
+                    name.c_str(), st->GetSOAWidth(), name.c_str(), st->GetSOAWidth(), st->GetSOAWidth(), name.c_str());
+        }
+    }
+    fprintf(file, "#endif // __cplusplus\n");
+}
+
+/** Emit C declarations of enumerator types to the generated header file.
+ */
+static void lEmitEnumDecls(const std::vector<const EnumType *> &enumTypes, FILE *file) {
+    if (enumTypes.size() == 0)
+        return;
+
+    fprintf(file, "///////////////////////////////////////////////////////////////////////////\n");
+    fprintf(file, "// Enumerator types with external visibility from ispc code\n");
+    fprintf(file, "///////////////////////////////////////////////////////////////////////////\n\n");
+
+    for (unsigned int i = 0; i < enumTypes.size(); ++i) {
+        fprintf(file, "#ifndef __ISPC_ENUM_%s__\n", enumTypes[i]->GetEnumName().c_str());
+        fprintf(file, "#define __ISPC_ENUM_%s__\n", enumTypes[i]->GetEnumName().c_str());
+        std::string declaration = enumTypes[i]->GetCDeclaration("");
+        fprintf(file, "%s {\n", declaration.c_str());
+
+        // Print the individual enumerators
+        for (int j = 0; j < enumTypes[i]->GetEnumeratorCount(); ++j) {
+            const Symbol *e = enumTypes[i]->GetEnumerator(j);
+            Assert(e->constValue != NULL);
+            unsigned int enumValue[1];
+            int count = e->constValue->GetValues(enumValue);
+            Assert(count == 1);
+
+            // Always print an initializer to set the value.  We could be
+            // 'clever' here and detect whether the implicit value given by
+            // one plus the previous enumerator value (or zero, for the
+            // first enumerator) is the same as the value stored with the
+            // enumerator, though that doesn't seem worth the trouble...
+            fprintf(file, "    %s = %d%c\n", e->name.c_str(), enumValue[0],
+                    (j < enumTypes[i]->GetEnumeratorCount() - 1) ? ',' : ' ');
+        }
+        fprintf(file, "};\n");
+        fprintf(file, "#endif\n\n");
+    }
+}
+
+/** Print declarations of VectorTypes used in 'export'ed parts of the
     program in the header file.
  */
 static void lEmitVectorTypedefs(const std::vector<const VectorType *> &types, FILE *file) {
@@ -1839,7 +2831,7 @@ static void lGetExportedParamTypes(const std::vector<Symbol *> &funcs,
 }
 
 static void lPrintFunctionDeclarations(FILE *file, const std::vector<Symbol *> &funcs, bool useExternC = 1,
-                                       bool rewriteForDispatch = false) {
+                                       bool rewriteForDispatch = false, const std::string &nameSuffix = "") {
     if (useExternC)
         fprintf(file, "#if defined(__cplusplus) && (! defined(__ISPC_NO_EXTERN_C) || !__ISPC_NO_EXTERN_C )\nextern "
                       "\"C\" {\n#endif // __cplusplus\n");
@@ -1848,7 +2840,7 @@ static void lPrintFunctionDeclarations(FILE *file, const std::vector<Symbol *> &
         const FunctionType *ftype = CastType<FunctionType>(funcs[i]->type);
         Assert(ftype);
         std::string decl;
-        std::string fname = funcs[i]->name;
+        std::string fname = funcs[i]->name + nameSuffix;
         if (g->calling_conv == CallingConv::x86_vectorcall) {
             fname = "__vectorcall " + fname;
         }
@@ -2269,17 +3261,10 @@ bool Module::writeHostStub(const char *fn) {
     return true;
 }
 
-bool Module::writeHeader(const char *fn) {
-    FILE *f = fopen(fn, "w");
-    if (!f) {
-        perror("fopen");
-        return false;
-    }
-    fprintf(f, "//\n// %s\n// (Header automatically generated by the ispc compiler.)\n", fn);
-    fprintf(f, "// DO NOT EDIT THIS FILE.\n//\n\n");
-
-    // Create a nice guard string from the filename, turning any
-    // non-number/letter characters into underbars
+/** Create a nice guard string from the filename, turning any
+    non-number/letter characters into underbars.
+ */
+static std::string lGetHeaderGuard(const char *fn) {
     std::string guard = "ISPC_";
     const char *p = fn;
     while (*p) {
@@ -2291,6 +3276,19 @@ bool Module::writeHeader(const char *fn) {
             guard += "_";
         ++p;
     }
+    return guard;
+}
+
+bool Module::writeHeader(const char *fn) {
+    FILE *f = fopen(fn, "w");
+    if (!f) {
+        perror("fopen");
+        return false;
+    }
+    fprintf(f, "//\n// %s\n// (Header automatically generated by the ispc compiler.)\n", fn);
+    fprintf(f, "// DO NOT EDIT THIS FILE.\n//\n\n");
+
+    std::string guard = lGetHeaderGuard(fn);
 
     if (g->noPragmaOnce)
         fprintf(f, "#ifndef %s\n#define %s\n\n", guard.c_str(), guard.c_str());
@@ -2298,6 +3296,10 @@ bool Module::writeHeader(const char *fn) {
         fprintf(f, "#pragma once\n");
 
     fprintf(f, "#include <stdint.h>\n\n");
+    if (g->emitSoAHelpers) {
+        fprintf(f, "#ifdef __cplusplus\n#include <cstddef>\n#include <cstdlib>\n#include <iterator>\n#include <new>\n"
+                   "#include <utility>\n#endif // __cplusplus\n\n");
+    }
 
     if (g->emitInstrumentation) {
         fprintf(f, "#define ISPC_INSTRUMENTATION 1\n");
@@ -2308,6 +3310,25 @@ bool Module::writeHeader(const char *fn) {
                    "extern C */\n#endif // __cplusplus\n");
     }
 
+    if (g->emitPerfCounters) {
+        fprintf(f, "#define ISPC_PERFCOUNTERS 1\n");
+        fprintf(f, "#if defined(__cplusplus) && (! defined(__ISPC_NO_EXTERN_C) || !__ISPC_NO_EXTERN_C )\nextern \"C\" "
+                   "{\n#endif // __cplusplus\n");
+        fprintf(f, "  void ISPCPerfCountersBegin(const char *function);\n");
+        fprintf(f, "  void ISPCPerfCountersEnd(const char *function);\n");
+        fprintf(f, "#if defined(__cplusplus) && (! defined(__ISPC_NO_EXTERN_C) || !__ISPC_NO_EXTERN_C )\n} /* end "
+                   "extern C */\n#endif // __cplusplus\n");
+    }
+
+    if (g->asyncPrint) {
+        fprintf(f, "#define ISPC_ASYNC_PRINT 1\n");
+        fprintf(f, "#if defined(__cplusplus) && (! defined(__ISPC_NO_EXTERN_C) || !__ISPC_NO_EXTERN_C )\nextern \"C\" "
+                   "{\n#endif // __cplusplus\n");
+        fprintf(f, "  void ISPCPrintFlush();\n");
+        fprintf(f, "#if defined(__cplusplus) && (! defined(__ISPC_NO_EXTERN_C) || !__ISPC_NO_EXTERN_C )\n} /* end "
+                   "extern C */\n#endif // __cplusplus\n");
+    }
+
     // end namespace
     fprintf(f, "\n");
     fprintf(f, "\n#ifdef __cplusplus\nnamespace ispc { /* namespace */\n#endif // __cplusplus\n");
@@ -2341,7 +3362,16 @@ bool Module::writeHeader(const char *fn) {
     // And print them
     lEmitVectorTypedefs(exportedVectorTypes, f);
     lEmitEnumDecls(exportedEnumTypes, f);
+    if (g->emitSoAHelpers) {
+        // The helpers convert from the structs that soa<W> is applied to, so
+        // they are declared along with their soa<W> variants.
+        for (int i = 0, n = (int)exportedStructTypes.size(); i < n; ++i)
+            if (exportedStructTypes[i]->GetSOAWidth() > 0)
+                exportedStructTypes.push_back(exportedStructTypes[i]->GetAsUniformType());
+    }
     lEmitStructDecls(exportedStructTypes, f);
+    if (g->emitSoAHelpers)
+        lEmitSoAHelpers(exportedStructTypes, f);
 
     // emit function declarations for exported stuff...
     if (exportedFuncs.size() > 0) {
@@ -2373,6 +3403,273 @@ bool Module::writeHeader(const char *fn) {
     return true;
 }
 
+bool Module::writeInlineHeader(const char *fn) {
+    std::vector<Symbol *> exportedFuncs;
+    m->symbolTable->GetMatchingFunctions(lIsExported, &exportedFuncs);
+
+    // Translate the functions first, so that no file is left behind if one of them can't be.
+    InlineCppWriter writer(module->getDataLayout());
+    bool success = true;
+    for (Symbol *sym : exportedFuncs) {
+        const FunctionType *ftype = CastType<FunctionType>(sym->type);
+        Assert(ftype);
+        llvm::Function *func = module->getFunction(sym->name);
+        if (func == NULL || func->isDeclaration()) {
+            Error(sym->pos, "Exported function \"%s\" isn't defined in this file.", sym->name.c_str());
+            success = false;
+            continue;
+        }
+        const Type *returnType = ftype->GetReturnType();
+        std::string params;
+        std::vector<std::string> args;
+        for (int i = 0; i < ftype->GetNumParameters(); ++i) {
+            const Type *type = ftype->GetParameterType(i);
+            std::string name = ftype->GetParameterName(i);
+            if (name.empty())
+                name = "__ispc_arg" + std::to_string(i);
+            // Same conversion of pointers to arrays as in the declarations of the C header.
+            const PointerType *pt = CastType<PointerType>(type);
+            if (pt != NULL && CastType<ArrayType>(pt->GetBaseType()) != NULL)
+                type = new ArrayType(pt->GetBaseType(), 0);
+            if (CastType<StructType>(type) != NULL || CastType<VectorType>(type) != NULL) {
+                Error(ftype->GetParameterSourcePos(i),
+                      "Parameters of struct and short vector types passed by value aren't supported "
+                      "in the inline header.");
+                success = false;
+            }
+            params += (i ? ", " : "") + type->GetCDeclaration(name);
+            args.push_back(IsReferenceType(type) ? "&" + name : name);
+        }
+        if (CastType<StructType>(returnType) != NULL || CastType<VectorType>(returnType) != NULL) {
+            Error(sym->pos, "Return values of struct and short vector types aren't supported in the inline header.");
+            success = false;
+            continue;
+        }
+        std::string retType = returnType->GetCDeclaration("");
+        if (success && !writer.AddFunction(func, retType + " " + sym->name + "(" + params + ")", args, retType))
+            success = false;
+    }
+    if (!success)
+        return false;
+
+    FILE *f = fopen(fn, "w");
+    if (!f) {
+        perror("fopen");
+        return false;
+    }
+    fprintf(f, "//\n// %s\n// (Inline header automatically generated by the ispc compiler.)\n", fn);
+    fprintf(f, "// DO NOT EDIT THIS FILE.\n//\n\n");
+
+    std::string guard = lGetHeaderGuard(fn);
+    if (g->noPragmaOnce)
+        fprintf(f, "#ifndef %s\n#define %s\n\n", guard.c_str(), guard.c_str());
+    else
+        fprintf(f, "#pragma once\n");
+
+    // The functions use the vector extensions of GCC and Clang.
+    fprintf(f, "#ifndef __cplusplus\n#error \"The ispc inline header needs C++.\"\n#endif // __cplusplus\n\n");
+    fprintf(f, "#include <stdint.h>\n#include <string.h>\n\n");
+    fprintf(f, "namespace ispc { /* namespace */\n");
+
+    std::vector<const StructType *> exportedStructTypes;
+    std::vector<const EnumType *> exportedEnumTypes;
+    std::vector<const VectorType *> exportedVectorTypes;
+    lGetExportedParamTypes(exportedFuncs, &exportedStructTypes, &exportedEnumTypes, &exportedVectorTypes);
+    lEmitVectorTypedefs(exportedVectorTypes, f);
+    lEmitEnumDecls(exportedEnumTypes, f);
+    lEmitStructDecls(exportedStructTypes, f);
+
+    fprintf(f, "\n%s", writer.GetDefinitions().c_str());
+    fprintf(f, "\n} /* namespace */\n");
+
+    if (g->noPragmaOnce)
+        fprintf(f, "\n#endif // %s\n", guard.c_str());
+
+    fclose(f);
+    return true;
+}
+
+/** The view that the C++ wrappers take in place of pointers, which is
+    emitted once for all C++ headers.
+ */
+static const char *lCppSpan = R"(
+#ifndef __ISPC_SPAN__
+#define __ISPC_SPAN__
+// View of a contiguous sequence of elements, which is made from a pointer,
+// an array or a container with data() and size() like std::vector, std::array
+// or std::span.  Only its data() is passed to the ispc functions.
+template <typename T> class Span {
+  public:
+    typedef T element_type;
+
+    Span() {}
+    Span(std::nullptr_t) {}
+    Span(T *data) : m_data(data) {}
+    Span(T *data, size_t size) : m_data(data), m_size(size) {}
+    template <size_t N> Span(T (&array)[N]) : m_data(array), m_size(N) {}
+    template <typename C, typename = typename std::enable_if<
+                              !std::is_same<typename std::decay<C>::type, Span>::value &&
+                              std::is_convertible<decltype(std::declval<C &>().data()), T *>::value>::type>
+    Span(C &&container) : m_data(container.data()), m_size(container.size()) {}
+
+    T *data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    T &operator[](size_t i) const { return m_data[i]; }
+    T *begin() const { return m_data; }
+    T *end() const { return m_data + m_size; }
+
+  private:
+    T *m_data{nullptr};
+    size_t m_size{0};
+};
+#endif // __ISPC_SPAN__
+)";
+
+/** Returns the condition on the predefined macros of the C++ compiler under
+    which the host code can only run on CPUs that support the ISA, or NULL if
+    there is none.  It's conservative, e.g. sse4 requires SSE4.2.
+ */
+static const char *lHostISACondition(Target::ISA isa) {
+    switch (isa) {
+    case Target::SSE2:
+        return "defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)";
+    case Target::SSE4:
+        return "defined(__SSE4_2__) || defined(__AVX__)";
+    case Target::AVX:
+        return "defined(__AVX__)";
+    case Target::AVX2:
+        return "defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))";
+    case Target::KNL_AVX512:
+        return "defined(__AVX512F__) && defined(__AVX512ER__) && defined(__AVX512PF__)";
+    case Target::SKX_AVX512:
+        return "defined(__AVX512F__) && defined(__AVX512VL__) && defined(__AVX512BW__) && defined(__AVX512DQ__)";
+    case Target::SPR_AVX512:
+        return "defined(__AVX512FP16__) && defined(__AMX_TILE__)";
+    default:
+        return NULL;
+    }
+}
+
+/** Returns true if the parameter is passed to the C++ wrapper as a Span of
+    the pointed to type, which is the case for pointers to uniform data.
+ */
+static bool lIsSpanParameter(const Type *type) {
+    const PointerType *pt = CastType<PointerType>(type);
+    if (pt == NULL || !pt->IsUniformType() || pt->IsSlice())
+        return false;
+    const Type *baseType = pt->GetBaseType();
+    return !baseType->IsVaryingType() && !baseType->IsVoidType() && CastType<ArrayType>(baseType) == NULL &&
+           CastType<FunctionType>(baseType) == NULL;
+}
+
+/** Emit the inline C++ wrapper of an exported function, which calls the
+    function with the given name.
+ */
+static void lEmitCppWrapper(FILE *file, const Symbol *sym, const std::string &callee, bool forDispatch) {
+    const FunctionType *ftype = CastType<FunctionType>(sym->type);
+    Assert(ftype);
+    std::string params, args;
+    for (int i = 0; i < ftype->GetNumParameters(); ++i) {
+        const Type *type = ftype->GetParameterType(i);
+        std::string name = ftype->GetParameterName(i);
+        if (name.empty())
+            name = "arg" + std::to_string(i);
+        if (i > 0) {
+            params += ", ";
+            args += ", ";
+        }
+        const PointerType *pt = CastType<PointerType>(type);
+        if (lIsSpanParameter(type)) {
+            params += "Span<" + pt->GetBaseType()->GetCDeclaration("") + "> " + name;
+            args += name + ".data()";
+            continue;
+        }
+        // The other parameters are declared as in the C header.
+        if (pt != NULL && CastType<ArrayType>(pt->GetBaseType()) != NULL)
+            type = new ArrayType(pt->GetBaseType(), 0);
+        if (forDispatch && pt != NULL && pt->GetBaseType()->IsVaryingType())
+            type = PointerType::Void;
+        params += type->GetCDeclaration(name);
+        args += name;
+    }
+    fprintf(file, "inline %s %s(%s) { return %s(%s); }\n", ftype->GetReturnType()->GetCDeclaration("").c_str(),
+            sym->name.c_str(), params.c_str(), callee.c_str(), args.c_str());
+}
+
+bool Module::writeCppHeader(const char *fn, const char *headerFileName,
+                            const std::vector<std::pair<Target::ISA, std::string>> &variants) {
+    FILE *f = fopen(fn, "w");
+    if (!f) {
+        perror("fopen");
+        return false;
+    }
+    fprintf(f, "//\n// %s\n// (Header automatically generated by the ispc compiler.)\n", fn);
+    fprintf(f, "// DO NOT EDIT THIS FILE.\n//\n\n");
+
+    std::string guard = lGetHeaderGuard(fn);
+    if (g->noPragmaOnce)
+        fprintf(f, "#ifndef %s\n#define %s\n\n", guard.c_str(), guard.c_str());
+    else
+        fprintf(f, "#pragma once\n");
+
+    // The C header is included by its name if both headers are in the same
+    // directory.
+    std::string include = headerFileName;
+    if (llvm::sys::path::parent_path(fn) == llvm::sys::path::parent_path(headerFileName))
+        include = llvm::sys::path::filename(headerFileName).str();
+    fprintf(f, "#include \"%s\"\n\n", include.c_str());
+    fprintf(f, "#include <cstddef>\n#include <type_traits>\n#include <utility>\n\n");
+
+    fprintf(f, "namespace ispc { /* namespace */\n");
+    fprintf(f, "%s", lCppSpan);
+
+    std::vector<Symbol *> exportedFuncs;
+    m->symbolTable->GetMatchingFunctions(lIsExported, &exportedFuncs);
+
+    fprintf(f, "\nnamespace cpp { /* namespace */\n");
+    if (variants.empty()) {
+        for (auto sym : exportedFuncs)
+            lEmitCppWrapper(f, sym, "::ispc::" + sym->name, false);
+    } else {
+        // When the host code is compiled for one of the ISAs, the wrappers
+        // call the variant of the function for it directly instead of the
+        // dispatch function, unless ISPC_NO_DIRECT_CALLS is defined.  The
+        // variants are tried from the most capable ISA down.
+        std::vector<std::pair<Target::ISA, std::string>> direct;
+        for (const auto &variant : variants)
+            if (lHostISACondition(variant.first) != NULL)
+                direct.push_back(variant);
+        std::sort(direct.begin(), direct.end(),
+                  [](const std::pair<Target::ISA, std::string> &a, const std::pair<Target::ISA, std::string> &b) {
+                      return a.first > b.first;
+                  });
+        for (size_t i = 0; i < direct.size(); ++i) {
+            fprintf(f, "#%s !defined(ISPC_NO_DIRECT_CALLS) && (%s)\n", i == 0 ? "if" : "elif",
+                    lHostISACondition(direct[i].first));
+            std::string suffix = "_" + direct[i].second;
+            lPrintFunctionDeclarations(f, exportedFuncs, true, true, suffix);
+            for (auto sym : exportedFuncs)
+                lEmitCppWrapper(f, sym, "::ispc::cpp::" + sym->name + suffix, true);
+        }
+        // Otherwise the dispatch function selects the variant at run time.
+        if (!direct.empty())
+            fprintf(f, "#else\n");
+        for (auto sym : exportedFuncs)
+            lEmitCppWrapper(f, sym, "::ispc::" + sym->name, true);
+        if (!direct.empty())
+            fprintf(f, "#endif\n");
+    }
+    fprintf(f, "} /* namespace */\n");
+    fprintf(f, "} /* namespace */\n");
+
+    if (g->noPragmaOnce)
+        fprintf(f, "\n#endif // %s\n", guard.c_str());
+
+    fclose(f);
+    return true;
+}
+
 struct ispc::DispatchHeaderInfo {
     bool EmitUnifs;
     bool EmitFuncs;
@@ -2392,19 +3689,7 @@ bool Module::writeDispatchHeader(DispatchHeaderInfo *DHI) {
         fprintf(f, "//\n// %s\n// (Header automatically generated by the ispc compiler.)\n", DHI->fn);
         fprintf(f, "// DO NOT EDIT THIS FILE.\n//\n\n");
     }
-    // Create a nice guard string from the filename, turning any
-    // non-number/letter characters into underbars
-    std::string guard = "ISPC_";
-    const char *p = DHI->fn;
-    while (*p) {
-        if (isdigit(*p))
-            guard += *p;
-        else if (isalpha(*p))
-            guard += toupper(*p);
-        else
-            guard += "_";
-        ++p;
-    }
+    std::string guard = lGetHeaderGuard(DHI->fn);
     if (DHI->EmitFrontMatter) {
         if (g->noPragmaOnce)
             fprintf(f, "#ifndef %s\n#define %s\n\n", guard.c_str(), guard.c_str());
@@ -2422,6 +3707,25 @@ bool Module::writeDispatchHeader(DispatchHeaderInfo *DHI) {
                        "extern C */\n#endif // __cplusplus\n");
         }
 
+        if (g->emitPerfCounters) {
+            fprintf(f, "#define ISPC_PERFCOUNTERS 1\n");
+            fprintf(f, "#if defined(__cplusplus) && (! defined(__ISPC_NO_EXTERN_C) || !__ISPC_NO_EXTERN_C )\nextern "
+                       "\"C\" {\n#endif // __cplusplus\n");
+            fprintf(f, "  void ISPCPerfCountersBegin(const char *function);\n");
+            fprintf(f, "  void ISPCPerfCountersEnd(const char *function);\n");
+            fprintf(f, "#if defined(__cplusplus) && (! defined(__ISPC_NO_EXTERN_C) || !__ISPC_NO_EXTERN_C )\n} /* end "
+                       "extern C */\n#endif // __cplusplus\n");
+        }
+
+        if (g->asyncPrint) {
+            fprintf(f, "#define ISPC_ASYNC_PRINT 1\n");
+            fprintf(f, "#if defined(__cplusplus) && (! defined(__ISPC_NO_EXTERN_C) || !__ISPC_NO_EXTERN_C )\nextern "
+                       "\"C\" {\n#endif // __cplusplus\n");
+            fprintf(f, "  void ISPCPrintFlush();\n");
+            fprintf(f, "#if defined(__cplusplus) && (! defined(__ISPC_NO_EXTERN_C) || !__ISPC_NO_EXTERN_C )\n} /* end "
+                       "extern C */\n#endif // __cplusplus\n");
+        }
+
         // end namespace
         fprintf(f, "\n");
         fprintf(f, "\n#ifdef __cplusplus\nnamespace ispc { /* namespace */\n#endif // __cplusplus\n\n");
@@ -2682,7 +3986,9 @@ static void lSetPreprocessorOptions(const std::shared_ptr<clang::PreprocessorOpt
 static void lSetLangOptions(clang::LangOptions *opts) { opts->LineComment = 1; }
 
 int Module::execPreprocessor(const char *infilename, llvm::raw_string_ostream *ostream) const {
-    clang::FrontendInputFile inputFile(infilename, clang::InputKind());
+    clang::FrontendInputFile inputFile =
+        source != nullptr ? clang::FrontendInputFile(llvm::MemoryBufferRef(source, infilename), clang::InputKind())
+                          : clang::FrontendInputFile(infilename, clang::InputKind());
     llvm::raw_fd_ostream stderrRaw(2, false);
 
     // Create Diagnostic engine
@@ -2772,46 +4078,242 @@ static std::string lGetTargetFileName(const char *outFileName, const std::string
 
 static bool lSymbolIsExported(const Symbol *s) { return s->exportedFunction != NULL; }
 
-// Small structure to hold pointers to the various different versions of a
-// llvm::Function that were compiled for different compilation target ISAs.
+// Small structure to hold the names and types of the various different
+// versions of a llvm::Function that were compiled for different compilation
+// target ISAs.  Only these are kept, rather than the llvm::Functions, so that
+// the module of each target can be freed once its outputs are written.
 struct FunctionTargetVariants {
     FunctionTargetVariants() {
         for (int i = 0; i < Target::NUM_ISAS; ++i) {
-            func[i] = NULL;
+            funcTypes[i] = NULL;
             FTs[i] = NULL;
+            hasFloatMath[i] = false;
+            sharedISA[i] = -1;
         }
     }
-    // The func array is indexed with the Target::ISA enumerant.  Some
-    // values may be NULL, indicating that the original function wasn't
-    // compiled to the corresponding target ISA.
-    llvm::Function *func[Target::NUM_ISAS];
+    void Set(Target::ISA isa, const llvm::Function *func, const FunctionType *ft);
+    // The arrays are indexed with the Target::ISA enumerant.  Some types
+    // may be NULL, indicating that the original function wasn't compiled to
+    // the corresponding target ISA.  When an ISA was compiled with several
+    // vector widths, they hold the variant of the target that was listed
+    // first on the command line.
+    std::string funcNames[Target::NUM_ISAS];
+    llvm::FunctionType *funcTypes[Target::NUM_ISAS];
     const FunctionType *FTs[Target::NUM_ISAS];
+
+    // All variants of the ISAs that were compiled with several vector
+    // widths, in the order of the targets on the command line.  These may
+    // be selected at runtime with the ISPC_DISPATCH_TARGET environment
+    // variable.
+    struct WidthVariant {
+        ISPCTarget target;
+        Target::ISA isa;
+        std::string funcName;
+        const FunctionType *FT;
+    };
+    std::vector<WidthVariant> widthVariants;
+
+    // The IR of the variants, as compared by lShareIdenticalExportedFunctions(),
+    // which is empty for the variants that can't be shared.  When the variant
+    // of an ISA is identical to the one of a lower ISA, sharedISA holds the
+    // lower one, which the dispatch function calls instead.
+    std::string fingerprints[Target::NUM_ISAS];
+    bool hasFloatMath[Target::NUM_ISAS];
+    int sharedISA[Target::NUM_ISAS];
 };
 
+/** Adds the global variables that the value refers to, directly or through
+    constant expressions and the initializers of internal globals, to the
+    given list.  Returns false if it refers to a function defined in the
+    module, whose code may differ between the targets. */
+static bool lCollectReferencedGlobals(const llvm::Value *value, std::set<const llvm::Value *> &visited,
+                                      std::vector<const llvm::GlobalVariable *> &globals) {
+    if (!llvm::isa<llvm::Constant>(value) || !visited.insert(value).second)
+        return true;
+    if (const llvm::Function *f = llvm::dyn_cast<llvm::Function>(value))
+        return f->isDeclaration();
+    if (const llvm::GlobalVariable *gv = llvm::dyn_cast<llvm::GlobalVariable>(value)) {
+        globals.push_back(gv);
+        return !gv->hasLocalLinkage() || !gv->hasInitializer() ||
+               lCollectReferencedGlobals(gv->getInitializer(), visited, globals);
+    }
+    for (const llvm::Use &op : llvm::cast<llvm::Constant>(value)->operands())
+        if (!lCollectReferencedGlobals(op.get(), visited, globals))
+            return false;
+    return true;
+}
+
+/** Returns the IR of the body of an exported function in a form that can be
+    compared across the modules of the targets, or an empty string if the
+    function can't be shared with other targets: if it calls functions
+    defined in the module, whose code would differ, or intrinsics that are
+    lowered differently depending on the ISA.  The definitions of the
+    internal globals that it refers to are included, as their initializers,
+    e.g. tables computed from programCount, may depend on the target. */
+static std::string lExportedFunctionFingerprint(const llvm::Function *func, bool *hasFloatMath) {
+    *hasFloatMath = false;
+    if (func->isDeclaration() || g->generateDebuggingSymbols)
+        return "";
+    std::set<const llvm::Value *> visited;
+    std::vector<const llvm::GlobalVariable *> globals;
+    for (const llvm::BasicBlock &bb : *func) {
+        for (const llvm::Instruction &inst : bb) {
+            if (llvm::isa<llvm::FPMathOperator>(&inst))
+                *hasFloatMath = true;
+            const llvm::CallBase *call = llvm::dyn_cast<llvm::CallBase>(&inst);
+            for (const llvm::Use &op : inst.operands())
+                if ((call == NULL || &op != &call->getCalledOperandUse()) &&
+                    !lCollectReferencedGlobals(op.get(), visited, globals))
+                    return "";
+            if (call == NULL)
+                continue;
+            const llvm::Function *callee = call->getCalledFunction();
+            if (callee == NULL)
+                return "";
+            if (callee->isIntrinsic()) {
+                switch (callee->getIntrinsicID()) {
+                case llvm::Intrinsic::assume:
+                case llvm::Intrinsic::lifetime_start:
+                case llvm::Intrinsic::lifetime_end:
+                    break;
+                default:
+                    // Intrinsics of a specific ISA are supported by the
+                    // higher ones.
+                    if (!callee->getName().startswith("llvm.x86."))
+                        return "";
+                }
+            } else if (!callee->isDeclaration())
+                return "";
+        }
+    }
+
+    std::string ir;
+    llvm::raw_string_ostream os(ir);
+    func->getFunctionType()->print(os);
+    os << " " << func->getCallingConv() << "\n";
+    for (const llvm::BasicBlock &bb : *func)
+        bb.print(os);
+    for (const llvm::GlobalVariable *gv : globals)
+        if (gv->hasLocalLinkage())
+            gv->print(os);
+    os.flush();
+
+    // Attribute groups and metadata are numbered per module, so the numbers
+    // are dropped.
+    std::string fingerprint;
+    fingerprint.reserve(ir.size());
+    for (size_t i = 0; i < ir.size(); ++i) {
+        fingerprint += ir[i];
+        if (ir[i] == '#' || ir[i] == '!')
+            while (i + 1 < ir.size() && isdigit((unsigned char)ir[i + 1]))
+                ++i;
+    }
+    return fingerprint;
+}
+
+void FunctionTargetVariants::Set(Target::ISA isa, const llvm::Function *func, const FunctionType *ft) {
+    funcNames[isa] = func->getName().str();
+    funcTypes[isa] = func->getFunctionType();
+    FTs[isa] = ft;
+    fingerprints[isa] = lExportedFunctionFingerprint(func, &hasFloatMath[isa]);
+}
+
 // Given the symbol table for a module, return a map from function names to
 // FunctionTargetVariants for each function that was defined with the
 // 'export' qualifier in ispc.
-static void lGetExportedFunctions(SymbolTable *symbolTable, std::map<std::string, FunctionTargetVariants> &functions) {
+static void lGetExportedFunctions(SymbolTable *symbolTable, std::map<std::string, FunctionTargetVariants> &functions,
+                                  bool isWidthVariant) {
     std::vector<Symbol *> syms;
     symbolTable->GetMatchingFunctions(lSymbolIsExported, &syms);
     for (unsigned int i = 0; i < syms.size(); ++i) {
         FunctionTargetVariants &ftv = functions[syms[i]->name];
-        ftv.func[g->target->getISA()] = syms[i]->exportedFunction;
-        ftv.FTs[g->target->getISA()] = CastType<FunctionType>(syms[i]->type);
+        const FunctionType *ft = CastType<FunctionType>(syms[i]->type);
+        if (ftv.funcTypes[g->target->getISA()] == NULL)
+            ftv.Set(g->target->getISA(), syms[i]->exportedFunction, ft);
+        if (isWidthVariant) {
+            ftv.widthVariants.push_back(
+                {g->target->getISPCTarget(), g->target->getISA(), syms[i]->exportedFunction->getName().str(), ft});
+        }
     }
 }
 
-static llvm::FunctionType *lGetVaryingDispatchType(FunctionTargetVariants &funcs) {
-    llvm::Type *ptrToInt8Ty = llvm::Type::getInt8PtrTy(*g->ctx);
-    llvm::FunctionType *resultFuncTy = NULL;
+/** Returns the type equivalent to the given one in the given context. When
+    targets are compiled in parallel, each target has its own LLVMContext,
+    while the dispatch function must be built with types of the dispatch
+    module context. */
+static llvm::Type *lCloneTypeToContext(llvm::Type *type, llvm::LLVMContext &ctx) {
+    if (&type->getContext() == &ctx) {
+        return type;
+    }
+
+    switch (type->getTypeID()) {
+    case llvm::Type::VoidTyID:
+        return llvm::Type::getVoidTy(ctx);
+    case llvm::Type::HalfTyID:
+        return llvm::Type::getHalfTy(ctx);
+    case llvm::Type::FloatTyID:
+        return llvm::Type::getFloatTy(ctx);
+    case llvm::Type::DoubleTyID:
+        return llvm::Type::getDoubleTy(ctx);
+    case llvm::Type::IntegerTyID:
+        return llvm::IntegerType::get(ctx, type->getIntegerBitWidth());
+    case llvm::Type::FixedVectorTyID: {
+        llvm::FixedVectorType *vt = llvm::cast<llvm::FixedVectorType>(type);
+        return llvm::FixedVectorType::get(lCloneTypeToContext(vt->getElementType(), ctx), vt->getNumElements());
+    }
+    case llvm::Type::ArrayTyID:
+        return llvm::ArrayType::get(lCloneTypeToContext(type->getArrayElementType(), ctx),
+                                    type->getArrayNumElements());
+    case llvm::Type::PointerTyID: {
+        llvm::PointerType *pt = llvm::cast<llvm::PointerType>(type);
+#ifdef ISPC_OPAQUE_PTR_MODE
+        return llvm::PointerType::get(ctx, pt->getAddressSpace());
+#else
+        return llvm::PointerType::get(lCloneTypeToContext(pt->PTR_ELT_TYPE(), ctx), pt->getAddressSpace());
+#endif
+    }
+    case llvm::Type::StructTyID: {
+        llvm::StructType *st = llvm::cast<llvm::StructType>(type);
+        llvm::SmallVector<llvm::Type *, 8> elements;
+        if (st->isLiteral()) {
+            for (llvm::Type *elt : st->elements()) {
+                elements.push_back(lCloneTypeToContext(elt, ctx));
+            }
+            return llvm::StructType::get(ctx, elements, st->isPacked());
+        }
+        llvm::StructType *result = llvm::StructType::getTypeByName(ctx, st->getName());
+        if (result != NULL) {
+            return result;
+        }
+        // Create the named struct before cloning its elements, as they may
+        // refer to the struct itself.
+        result = llvm::StructType::create(ctx, st->getName());
+        if (!st->isOpaque()) {
+            for (llvm::Type *elt : st->elements()) {
+                elements.push_back(lCloneTypeToContext(elt, ctx));
+            }
+            result->setBody(elements, st->isPacked());
+        }
+        return result;
+    }
+    default:
+        FATAL("Unexpected type in lCloneTypeToContext");
+        return NULL;
+    }
+}
+
+static llvm::FunctionType *lGetVaryingDispatchType(FunctionTargetVariants &funcs) {
+    llvm::Type *ptrToInt8Ty = llvm::Type::getInt8PtrTy(*g->ctx);
+    llvm::FunctionType *resultFuncTy = NULL;
 
     for (int i = 0; i < Target::NUM_ISAS; ++i) {
-        if (funcs.func[i] == NULL) {
+        if (funcs.funcTypes[i] == NULL) {
             continue;
         } else {
             bool foundVarying = false;
             const FunctionType *ft = funcs.FTs[i];
-            resultFuncTy = funcs.func[i]->getFunctionType();
+            resultFuncTy =
+                llvm::cast<llvm::FunctionType>(lCloneTypeToContext(funcs.funcTypes[i], *g->ctx));
 
             int numArgs = ft->GetNumParameters();
             llvm::SmallVector<llvm::Type *, 8> ftype;
@@ -2845,11 +4347,188 @@ static llvm::FunctionType *lGetVaryingDispatchType(FunctionTargetVariants &funcs
     return resultFuncTy;
 }
 
+// Emit the call from the dispatch function to the given target-specific
+// variant at the end of the given basic block and return its result.
+static void lEmitDispatchCall(llvm::Function *dispatchFunc, llvm::FunctionType *calleeType, llvm::Value *callee,
+                              llvm::BasicBlock *callBBlock) {
+    // Just pass through all of the args from the dispatch function to
+    // the target-specific function.
+    std::vector<llvm::Value *> args;
+    llvm::Function::arg_iterator argIter = dispatchFunc->arg_begin();
+    for (unsigned int i = 0; argIter != dispatchFunc->arg_end(); ++argIter, ++i) {
+        // Check to see if we rewrote any types in the dispatch function.
+        // If so, create bitcasts for the appropriate pointer types.
+        if (argIter->getType() == calleeType->getParamType(i)) {
+            args.push_back(&*argIter);
+        } else {
+            llvm::CastInst *argCast = llvm::CastInst::CreatePointerCast(&*argIter, calleeType->getParamType(i),
+                                                                        "dpatch_arg_bitcast", callBBlock);
+            args.push_back(argCast);
+        }
+    }
+    // Calling convention is the same for all dispatched functions.
+    if (dispatchFunc->getReturnType()->isVoidTy()) {
+        llvm::CallInst *callInst = llvm::CallInst::Create(calleeType, callee, args, "", callBBlock);
+        callInst->setCallingConv(dispatchFunc->getCallingConv());
+        callInst->setTailCall();
+        llvm::ReturnInst::Create(*g->ctx, callBBlock);
+    } else {
+        llvm::CallInst *callInst = llvm::CallInst::Create(calleeType, callee, args, "ret_value", callBBlock);
+        callInst->setCallingConv(dispatchFunc->getCallingConv());
+        callInst->setTailCall();
+        llvm::ReturnInst::Create(*g->ctx, callInst, callBBlock);
+    }
+}
+
+/** Whether the code of the exported functions compiled for one x86 ISA can
+    be run instead of the code of a higher one.  KNL isn't a subset of the
+    later AVX-512 ISAs, and floating-point code isn't shared between the
+    ISAs with and without FMA, since multiplies and adds are contracted
+    on the ones that have it. */
+static bool lCanShareISAs(Target::ISA lower, Target::ISA higher, bool hasFloatMath) {
+    if (lower >= higher || higher > Target::SPR_AVX512 || lower == Target::KNL_AVX512 ||
+        higher == Target::KNL_AVX512)
+        return false;
+    if (hasFloatMath && !g->opt.disableFMA && (lower >= Target::AVX2) != (higher >= Target::AVX2))
+        return false;
+    return true;
+}
+
+/** Replace the exported functions of the module of the given ISA that are
+    identical to the ones of a lower ISA compiled before with calls to
+    those, and record that the dispatch functions call the lower variant
+    directly.  This keeps a single copy of the code in multi-target builds;
+    the functions of the ISA are kept as the C++ wrappers call them. */
+static void lShareIdenticalExportedFunctions(llvm::Module *module,
+                                             std::map<std::string, FunctionTargetVariants> &functions,
+                                             Target::ISA isa) {
+    if (g->opt.disableTargetMerging)
+        return;
+    for (auto &entry : functions) {
+        FunctionTargetVariants &ftv = entry.second;
+        llvm::Function *func = module->getFunction(ftv.funcNames[isa]);
+        if (ftv.fingerprints[isa].empty() || ftv.sharedISA[isa] != -1 || func == NULL || func->isDeclaration())
+            continue;
+        for (int lower = 0; lower < isa; ++lower) {
+            if (ftv.fingerprints[lower] != ftv.fingerprints[isa] || ftv.sharedISA[lower] != -1 ||
+                !lCanShareISAs((Target::ISA)lower, isa, ftv.hasFloatMath[isa]))
+                continue;
+            func->deleteBody();
+            llvm::Function *lowerFunc = module->getFunction(ftv.funcNames[lower]);
+            if (lowerFunc == NULL) {
+                lowerFunc = llvm::Function::Create(func->getFunctionType(), llvm::GlobalValue::ExternalLinkage,
+                                                   ftv.funcNames[lower], module);
+                lowerFunc->setCallingConv(func->getCallingConv());
+            }
+            llvm::BasicBlock *bblock = llvm::BasicBlock::Create(*g->ctx, "entry", func);
+            lEmitDispatchCall(func, func->getFunctionType(), lowerFunc, bblock);
+            ftv.sharedISA[isa] = lower;
+            break;
+        }
+    }
+}
+
+/** Emit the code that checks to see which vector ISAs the system the code
+    is running on supports and selects the best available variant that was
+    generated at compile time.  The code is emitted into the given function
+    starting at the end of the given basic block; emitSelected() is called
+    to emit the handling of the selected variant in a new basic block.
+    Returns the basic block that is reached if no variant can run on the
+    system; it's up to the caller to terminate it.
+*/
+static llvm::BasicBlock *
+lEmitDispatchSelection(llvm::Module *module, llvm::Function *setISAFunc, llvm::Value *systemBestISAPtr,
+                       llvm::Function *setTargetFunc, llvm::Value *dispatchTargetPtr, FunctionTargetVariants &funcs,
+                       llvm::Function *targetFuncs[], const std::vector<llvm::Function *> &widthFuncs,
+                       llvm::Function *func, llvm::BasicBlock *bblock,
+                       const std::function<void(llvm::Function *, llvm::BasicBlock *)> &emitSelected) {
+    // Start by calling out to the function that determines the system's
+    // ISA and sets __system_best_isa, if it hasn't been set yet.
+    llvm::CallInst::Create(setISAFunc, "", bblock);
+
+    // Now we can load the system's ISA enumerant
+    llvm::Value *systemISA = new llvm::LoadInst(LLVMTypes::Int32Type, systemBestISAPtr, "system_isa", bblock);
+
+    // If the user requested one of the width variants explicitly, select
+    // it as long as the system supports its ISA.
+    if (setTargetFunc != NULL && !funcs.widthVariants.empty()) {
+        llvm::CallInst::Create(setTargetFunc, "", bblock);
+        llvm::Value *dispatchTarget =
+            new llvm::LoadInst(LLVMTypes::Int32Type, dispatchTargetPtr, "dispatch_target", bblock);
+
+        for (unsigned int i = 0; i < funcs.widthVariants.size(); ++i) {
+            const FunctionTargetVariants::WidthVariant &variant = funcs.widthVariants[i];
+            llvm::Value *isRequested =
+                llvm::CmpInst::Create(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_EQ, dispatchTarget,
+                                      LLVMInt32(static_cast<int32_t>(variant.target)), "target_requested", bblock);
+            llvm::Value *isaOk = llvm::CmpInst::Create(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SGE, systemISA,
+                                                       LLVMInt32(variant.isa), "isa_ok", bblock);
+            llvm::Value *ok = llvm::BinaryOperator::Create(llvm::Instruction::And, isRequested, isaOk, "ok", bblock);
+            llvm::BasicBlock *callBBlock = llvm::BasicBlock::Create(*g->ctx, "do_call", func);
+            llvm::BasicBlock *nextBBlock = llvm::BasicBlock::Create(*g->ctx, "next_try", func);
+            llvm::BranchInst::Create(callBBlock, nextBBlock, ok, bblock);
+
+            emitSelected(widthFuncs[i], callBBlock);
+            bblock = nextBBlock;
+        }
+    }
+
+    // Now emit code that works backwards though the available variants of
+    // the function.  We'll select the first one we find that will run
+    // successfully on the system the code is running on.  In working
+    // through the candidate ISAs here backward, we're taking advantage of
+    // the expectation that they are ordered in the Target::ISA enumerant
+    // from least to most capable.
+    for (int i = Target::NUM_ISAS - 1; i >= 0; --i) {
+        if (targetFuncs[i] == NULL)
+            continue;
+
+        // Emit code to see if the system can run the current candidate
+        // variant successfully--"is the system's ISA enumerant value >=
+        // the enumerant value of the current candidate?"
+
+        llvm::Value *ok = llvm::CmpInst::Create(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SGE, systemISA,
+                                                LLVMInt32(i), "isa_ok", bblock);
+        llvm::BasicBlock *callBBlock = llvm::BasicBlock::Create(*g->ctx, "do_call", func);
+        llvm::BasicBlock *nextBBlock = llvm::BasicBlock::Create(*g->ctx, "next_try", func);
+        llvm::BranchInst::Create(callBBlock, nextBBlock, ok, bblock);
+
+        emitSelected(targetFuncs[i], callBBlock);
+
+        // Otherwise we'll go on to the next candidate and see about that
+        // one...
+        bblock = nextBBlock;
+    }
+
+    // We couldn't find a match that the current system was capable of
+    // running.  We'll call abort(); this is a bit of a blunt hammer--it
+    // might be preferable to call a user-supplied callback--ISPCError(...)
+    // or some such, but we don't want to start imposing too much of a
+    // runtime library requirement either...
+    llvm::Function *abortFunc = module->getFunction("abort");
+    Assert(abortFunc);
+    llvm::CallInst::Create(abortFunc, "", bblock);
+    return bblock;
+}
+
+// GNU ifuncs are supported by the ELF toolchains of these systems.
+static bool lTargetOSSupportsIFunc(TargetOS os) {
+    return os == TargetOS::linux || os == TargetOS::custom_linux || os == TargetOS::freebsd;
+}
+
 /** Create the dispatch function for an exported ispc function.
     This function checks to see which vector ISAs the system the
     code is running on supports and calls out to the best available
     variant that was generated at compile time.
 
+    With --dispatch-once, the selection is moved to a resolver function
+    that runs once.  On ELF targets the dispatch function is then a GNU
+    ifunc, so the dynamic loader binds calls directly to the selected
+    variant.  Elsewhere, or when some ISA was compiled with several vector
+    widths, the dispatch function jumps through a function
+    pointer, which initially points to a stub that calls the resolver,
+    stores its result in the pointer and calls the selected variant.
+
     @param module      Module in which to create the dispatch function.
     @param setISAFunc  Pointer to the __set_system_isa() function defined
                        in builtins-dispatch.ll (which is linked into the
@@ -2858,11 +4537,19 @@ static llvm::FunctionType *lGetVaryingDispatchType(FunctionTargetVariants &funcs
                              variable, which holds a value of the Target::ISA
                              enumerant giving the most capable ISA that the
                              system supports.
+    @param setTargetFunc  Pointer to the __set_dispatch_target() function,
+                          or NULL if no ISA was compiled with several
+                          vector widths.
+    @param dispatchTargetPtr  Pointer to the module-local
+                              __system_dispatch_target variable, which
+                              holds the ISPCTarget enumerant requested with
+                              ISPC_DISPATCH_TARGET.
     @param name        Name of the function for which we're generating a
                        dispatch function
     @param funcs       Target-specific variants of the exported function.
 */
 static void lCreateDispatchFunction(llvm::Module *module, llvm::Function *setISAFunc, llvm::Value *systemBestISAPtr,
+                                    llvm::Function *setTargetFunc, llvm::Value *dispatchTargetPtr,
                                     const std::string &name, FunctionTargetVariants &funcs) {
     // The llvm::Function pointers in funcs are pointers to functions in
     // different llvm::Modules, so we can't call them directly.  Therefore,
@@ -2882,10 +4569,13 @@ static void lCreateDispatchFunction(llvm::Module *module, llvm::Function *setISA
     // around.
     unsigned int callingConv = llvm::CallingConv::C;
     for (int i = 0; i < Target::NUM_ISAS; ++i) {
-        if (funcs.func[i]) {
+        if (funcs.funcTypes[i] && funcs.sharedISA[i] != -1) {
+            // Identical to the variant of a lower ISA, which is called instead.
+            targetFuncs[i] = targetFuncs[funcs.sharedISA[i]];
+        } else if (funcs.funcTypes[i]) {
 
             targetFuncs[i] =
-                llvm::Function::Create(ftype, llvm::GlobalValue::ExternalLinkage, funcs.func[i]->getName(), module);
+                llvm::Function::Create(ftype, llvm::GlobalValue::ExternalLinkage, funcs.funcNames[i], module);
             // Calling convention should be the same for all dispatched functions
             callingConv = funcs.FTs[i]->GetCallingConv();
             targetFuncs[i]->setCallingConv(callingConv);
@@ -2894,6 +4584,17 @@ static void lCreateDispatchFunction(llvm::Module *module, llvm::Function *setISA
             targetFuncs[i] = NULL;
     }
 
+    std::vector<llvm::Function *> widthFuncs;
+    for (const FunctionTargetVariants::WidthVariant &variant : funcs.widthVariants) {
+        // The default variant of the ISA has already been declared above.
+        llvm::Function *targetFunc = module->getFunction(variant.funcName);
+        if (targetFunc == NULL) {
+            targetFunc = llvm::Function::Create(ftype, llvm::GlobalValue::ExternalLinkage, variant.funcName, module);
+            targetFunc->setCallingConv(callingConv);
+        }
+        widthFuncs.push_back(targetFunc);
+    }
+
     bool voidReturn = ftype->getReturnType()->isVoidTy();
 
     std::string functionName = name;
@@ -2901,6 +4602,60 @@ static void lCreateDispatchFunction(llvm::Module *module, llvm::Function *setISA
         g->target->markFuncNameWithRegCallPrefix(functionName);
     }
 
+    if (g->dispatchOnce) {
+        // The resolver returns the variant to call.
+        llvm::PointerType *funcPtrType = llvm::PointerType::get(ftype, 0);
+        llvm::Function *resolverFunc =
+            llvm::Function::Create(llvm::FunctionType::get(funcPtrType, false), llvm::GlobalValue::InternalLinkage,
+                                   name + ".resolver", module);
+        llvm::BasicBlock *bblock = llvm::BasicBlock::Create(*g->ctx, "entry", resolverFunc);
+        bblock = lEmitDispatchSelection(module, setISAFunc, systemBestISAPtr, setTargetFunc, dispatchTargetPtr, funcs,
+                                        targetFuncs, widthFuncs, resolverFunc, bblock,
+                                        [&](llvm::Function *targetFunc, llvm::BasicBlock *callBBlock) {
+                                            llvm::ReturnInst::Create(
+                                                *g->ctx, llvm::ConstantExpr::getPointerCast(targetFunc, funcPtrType),
+                                                callBBlock);
+                                        });
+        llvm::ReturnInst::Create(*g->ctx, llvm::ConstantPointerNull::get(funcPtrType), bblock);
+
+        // The resolver of an ifunc may run before the relocations of other
+        // libraries are processed, so it can't read ISPC_DISPATCH_TARGET
+        // with getenv().
+        if (lTargetOSSupportsIFunc(g->target_os) && setTargetFunc == NULL) {
+            llvm::GlobalIFunc::create(ftype, 0, llvm::GlobalValue::ExternalLinkage, functionName, resolverFunc,
+                                      module);
+            return;
+        }
+
+        // The dispatch function and the stub that patches the function
+        // pointer on the first call.
+        llvm::Function *dispatchFunc =
+            llvm::Function::Create(ftype, llvm::GlobalValue::ExternalLinkage, functionName.c_str(), module);
+        dispatchFunc->setCallingConv(callingConv);
+        if ((g->target_os == TargetOS::windows) && (g->dllExport)) {
+            dispatchFunc->setDLLStorageClass(llvm::GlobalValue::DLLExportStorageClass);
+        }
+        llvm::Function *initFunc =
+            llvm::Function::Create(ftype, llvm::GlobalValue::InternalLinkage, name + ".init", module);
+        initFunc->setCallingConv(callingConv);
+        llvm::GlobalVariable *funcPtr =
+            new llvm::GlobalVariable(*module, funcPtrType, false, llvm::GlobalValue::InternalLinkage,
+                                     llvm::ConstantExpr::getPointerCast(initFunc, funcPtrType), name + ".ptr");
+        llvm::Align ptrAlign = module->getDataLayout().getABITypeAlign(funcPtrType);
+
+        bblock = llvm::BasicBlock::Create(*g->ctx, "entry", initFunc);
+        llvm::Value *resolved = llvm::CallInst::Create(resolverFunc, "resolved", bblock);
+        new llvm::StoreInst(resolved, funcPtr, false, ptrAlign, llvm::AtomicOrdering::Monotonic,
+                            llvm::SyncScope::System, bblock);
+        lEmitDispatchCall(initFunc, ftype, resolved, bblock);
+
+        bblock = llvm::BasicBlock::Create(*g->ctx, "entry", dispatchFunc);
+        llvm::Value *selected = new llvm::LoadInst(funcPtrType, funcPtr, "selected", false, ptrAlign,
+                                                   llvm::AtomicOrdering::Monotonic, llvm::SyncScope::System, bblock);
+        lEmitDispatchCall(dispatchFunc, ftype, selected, bblock);
+        return;
+    }
+
     // Now we can emit the definition of the dispatch function..
     llvm::Function *dispatchFunc =
         llvm::Function::Create(ftype, llvm::GlobalValue::ExternalLinkage, functionName.c_str(), module);
@@ -2911,74 +4666,12 @@ static void lCreateDispatchFunction(llvm::Module *module, llvm::Function *setISA
         dispatchFunc->setDLLStorageClass(llvm::GlobalValue::DLLExportStorageClass);
     }
     llvm::BasicBlock *bblock = llvm::BasicBlock::Create(*g->ctx, "entry", dispatchFunc);
-
-    // Start by calling out to the function that determines the system's
-    // ISA and sets __system_best_isa, if it hasn't been set yet.
-    llvm::CallInst::Create(setISAFunc, "", bblock);
-
-    // Now we can load the system's ISA enumerant
-    llvm::Value *systemISA = new llvm::LoadInst(LLVMTypes::Int32Type, systemBestISAPtr, "system_isa", bblock);
-
-    // Now emit code that works backwards though the available variants of
-    // the function.  We'll call out to the first one we find that will run
-    // successfully on the system the code is running on.  In working
-    // through the candidate ISAs here backward, we're taking advantage of
-    // the expectation that they are ordered in the Target::ISA enumerant
-    // from least to most capable.
-    for (int i = Target::NUM_ISAS - 1; i >= 0; --i) {
-        if (targetFuncs[i] == NULL)
-            continue;
-
-        // Emit code to see if the system can run the current candidate
-        // variant successfully--"is the system's ISA enumerant value >=
-        // the enumerant value of the current candidate?"
-
-        llvm::Value *ok = llvm::CmpInst::Create(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SGE, systemISA,
-                                                LLVMInt32(i), "isa_ok", bblock);
-        llvm::BasicBlock *callBBlock = llvm::BasicBlock::Create(*g->ctx, "do_call", dispatchFunc);
-        llvm::BasicBlock *nextBBlock = llvm::BasicBlock::Create(*g->ctx, "next_try", dispatchFunc);
-        llvm::BranchInst::Create(callBBlock, nextBBlock, ok, bblock);
-
-        // Emit the code to make the call call in callBBlock.
-        // Just pass through all of the args from the dispatch function to
-        // the target-specific function.
-        std::vector<llvm::Value *> args;
-        llvm::Function::arg_iterator argIter = dispatchFunc->arg_begin();
-        llvm::Function::arg_iterator targsIter = targetFuncs[i]->arg_begin();
-        for (; argIter != dispatchFunc->arg_end(); ++argIter, ++targsIter) {
-            // Check to see if we rewrote any types in the dispatch function.
-            // If so, create bitcasts for the appropriate pointer types.
-            if (argIter->getType() == targsIter->getType()) {
-                args.push_back(&*argIter);
-            } else {
-                llvm::CastInst *argCast = llvm::CastInst::CreatePointerCast(&*argIter, targsIter->getType(),
-                                                                            "dpatch_arg_bitcast", callBBlock);
-                args.push_back(argCast);
-            }
-        }
-        if (voidReturn) {
-            llvm::CallInst *callInst = llvm::CallInst::Create(targetFuncs[i], args, "", callBBlock);
-            callInst->setCallingConv(targetFuncs[i]->getCallingConv());
-            llvm::ReturnInst::Create(*g->ctx, callBBlock);
-        } else {
-            llvm::CallInst *callInst = llvm::CallInst::Create(targetFuncs[i], args, "ret_value", callBBlock);
-            callInst->setCallingConv(targetFuncs[i]->getCallingConv());
-            llvm::ReturnInst::Create(*g->ctx, callInst, callBBlock);
-        }
-
-        // Otherwise we'll go on to the next candidate and see about that
-        // one...
-        bblock = nextBBlock;
-    }
-
-    // We couldn't find a match that the current system was capable of
-    // running.  We'll call abort(); this is a bit of a blunt hammer--it
-    // might be preferable to call a user-supplied callback--ISPCError(...)
-    // or some such, but we don't want to start imposing too much of a
-    // runtime library requirement either...
-    llvm::Function *abortFunc = module->getFunction("abort");
-    Assert(abortFunc);
-    llvm::CallInst::Create(abortFunc, "", bblock);
+    bblock = lEmitDispatchSelection(module, setISAFunc, systemBestISAPtr, setTargetFunc, dispatchTargetPtr, funcs,
+                                    targetFuncs, widthFuncs, dispatchFunc, bblock,
+                                    [&](llvm::Function *targetFunc, llvm::BasicBlock *callBBlock) {
+                                        lEmitDispatchCall(dispatchFunc, targetFunc->getFunctionType(), targetFunc,
+                                                          callBBlock);
+                                    });
 
     // Return an undef value from the function here; we won't get to this
     // point at runtime, but LLVM needs all of the basic blocks to be
@@ -3008,23 +4701,100 @@ static llvm::Module *lInitDispatchModule() {
     return module;
 }
 
+/** Create the __set_dispatch_target() function for the dispatch module.
+    On the first call, it reads the ISPC_DISPATCH_TARGET environment
+    variable and stores the ISPCTarget enumerant of the matching width
+    variant in __system_dispatch_target, or -2 if the variable is not set
+    or doesn't name one of the given targets.
+*/
+static llvm::Function *lCreateSetDispatchTargetFunction(llvm::Module *module, llvm::GlobalVariable *dispatchTargetPtr,
+                                                        const std::vector<ISPCTarget> &widthTargets) {
+    llvm::Type *ptrToInt8Ty = llvm::Type::getInt8PtrTy(*g->ctx);
+    llvm::FunctionCallee getenvFunc = module->getOrInsertFunction("getenv", ptrToInt8Ty, ptrToInt8Ty);
+    llvm::FunctionCallee strcmpFunc =
+        module->getOrInsertFunction("strcmp", LLVMTypes::Int32Type, ptrToInt8Ty, ptrToInt8Ty);
+
+    auto getString = [&](const std::string &str, const char *name) -> llvm::Constant * {
+        llvm::Constant *init = llvm::ConstantDataArray::getString(*g->ctx, str);
+        llvm::GlobalVariable *gv = new llvm::GlobalVariable(*module, init->getType(), true,
+                                                            llvm::GlobalValue::PrivateLinkage, init, name);
+        gv->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+        return llvm::ConstantExpr::getPointerCast(gv, ptrToInt8Ty);
+    };
+
+    llvm::FunctionType *ftype = llvm::FunctionType::get(LLVMTypes::VoidType, false);
+    llvm::Function *func =
+        llvm::Function::Create(ftype, llvm::GlobalValue::InternalLinkage, "__set_dispatch_target", module);
+    llvm::BasicBlock *bblock = llvm::BasicBlock::Create(*g->ctx, "entry", func);
+    llvm::BasicBlock *initBBlock = llvm::BasicBlock::Create(*g->ctx, "init", func);
+    llvm::BasicBlock *unknownBBlock = llvm::BasicBlock::Create(*g->ctx, "unknown", func);
+    llvm::BasicBlock *doneBBlock = llvm::BasicBlock::Create(*g->ctx, "done", func);
+
+    // Only look at the environment once.
+    llvm::Value *target = new llvm::LoadInst(LLVMTypes::Int32Type, dispatchTargetPtr, "target", bblock);
+    llvm::Value *isUnset = llvm::CmpInst::Create(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_EQ, target,
+                                                 LLVMInt32(-1), "is_unset", bblock);
+    llvm::BranchInst::Create(initBBlock, doneBBlock, isUnset, bblock);
+
+    llvm::Value *env = llvm::CallInst::Create(getenvFunc, {getString("ISPC_DISPATCH_TARGET", "__dispatch_env")},
+                                              "env", initBBlock);
+    llvm::Value *null = llvm::ConstantPointerNull::get(llvm::cast<llvm::PointerType>(ptrToInt8Ty));
+    llvm::Value *isNull =
+        llvm::CmpInst::Create(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_EQ, env, null, "is_null", initBBlock);
+    bblock = llvm::BasicBlock::Create(*g->ctx, "check", func);
+    llvm::BranchInst::Create(unknownBBlock, bblock, isNull, initBBlock);
+
+    for (unsigned int i = 0; i < widthTargets.size(); ++i) {
+        llvm::Value *name = getString(ISPCTargetToString(widthTargets[i]), "__dispatch_target_name");
+        llvm::Value *cmp = llvm::CallInst::Create(strcmpFunc, {env, name}, "cmp", bblock);
+        llvm::Value *match = llvm::CmpInst::Create(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_EQ, cmp,
+                                                   LLVMInt32(0), "match", bblock);
+        llvm::BasicBlock *foundBBlock = llvm::BasicBlock::Create(*g->ctx, "found", func);
+        llvm::BasicBlock *nextBBlock = (i == widthTargets.size() - 1)
+                                           ? unknownBBlock
+                                           : llvm::BasicBlock::Create(*g->ctx, "check", func);
+        llvm::BranchInst::Create(foundBBlock, nextBBlock, match, bblock);
+
+        new llvm::StoreInst(LLVMInt32(static_cast<int32_t>(widthTargets[i])), dispatchTargetPtr, foundBBlock);
+        llvm::BranchInst::Create(doneBBlock, foundBBlock);
+        bblock = nextBBlock;
+    }
+
+    new llvm::StoreInst(LLVMInt32(-2), dispatchTargetPtr, unknownBBlock);
+    llvm::BranchInst::Create(doneBBlock, unknownBBlock);
+    llvm::ReturnInst::Create(*g->ctx, doneBBlock);
+
+    return func;
+}
+
 // Complete the creation of a dispatch module.
 // Given a map that holds the mapping from each of the 'export'ed functions
 // in the ispc program to the target-specific variants of the function,
 // create a llvm::Module that has a dispatch function for each exported
 // function that checks the system's capabilities and picks the most
 // appropriate compiled variant of the function.
-static void lEmitDispatchModule(llvm::Module *module, std::map<std::string, FunctionTargetVariants> &functions) {
+static void lEmitDispatchModule(llvm::Module *module, std::map<std::string, FunctionTargetVariants> &functions,
+                                const std::vector<ISPCTarget> &widthTargets) {
     // Get pointers to things we need below
     llvm::Function *setFunc = module->getFunction("__set_system_isa");
     Assert(setFunc != NULL);
     llvm::Value *systemBestISAPtr = module->getGlobalVariable("__system_best_isa", true);
     Assert(systemBestISAPtr != NULL);
 
+    llvm::GlobalVariable *dispatchTargetPtr = NULL;
+    llvm::Function *setTargetFunc = NULL;
+    if (!widthTargets.empty()) {
+        dispatchTargetPtr = new llvm::GlobalVariable(*module, LLVMTypes::Int32Type, false,
+                                                     llvm::GlobalValue::InternalLinkage, LLVMInt32(-1),
+                                                     "__system_dispatch_target");
+        setTargetFunc = lCreateSetDispatchTargetFunction(module, dispatchTargetPtr, widthTargets);
+    }
+
     // For each exported function, create the dispatch function
     std::map<std::string, FunctionTargetVariants>::iterator iter;
     for (iter = functions.begin(); iter != functions.end(); ++iter)
-        lCreateDispatchFunction(module, setFunc, systemBestISAPtr, iter->first, iter->second);
+        lCreateDispatchFunction(module, setFunc, systemBestISAPtr, setTargetFunc, dispatchTargetPtr, iter->first,
+                                iter->second);
 
     // Do some rudimentary cleanup of the final result and make sure that
     // the module is all ok.
@@ -3053,11 +4823,33 @@ static bool lCompatibleTypes(llvm::Type *Ty1, llvm::Type *Ty2) {
         case llvm::Type::StructTyID: {
             llvm::StructType *STy1 = llvm::dyn_cast<llvm::StructType>(Ty1);
             llvm::StructType *STy2 = llvm::dyn_cast<llvm::StructType>(Ty2);
-            return STy1 && STy2 && STy1->isLayoutIdentical(STy2);
+            if (&Ty1->getContext() == &Ty2->getContext())
+                return STy1 && STy2 && STy1->isLayoutIdentical(STy2);
+            // Types from different contexts (parallel target compilation)
+            // have to be compared element by element.
+            if (!STy1 || !STy2 || STy1->isPacked() != STy2->isPacked() ||
+                STy1->getNumElements() != STy2->getNumElements())
+                return false;
+            for (unsigned j = 0; j < STy1->getNumElements(); ++j)
+                if (!lCompatibleTypes(STy1->getElementType(j), STy2->getElementType(j)))
+                    return false;
+            return true;
         }
+        case llvm::Type::IntegerTyID:
+            return Ty1->getIntegerBitWidth() == Ty2->getIntegerBitWidth();
+        case llvm::Type::FixedVectorTyID:
+            if (llvm::cast<llvm::FixedVectorType>(Ty1)->getNumElements() !=
+                llvm::cast<llvm::FixedVectorType>(Ty2)->getNumElements())
+                return false;
+            Ty1 = Ty1->getScalarType();
+            Ty2 = Ty2->getScalarType();
+            break;
         default:
             // Pointers for compatible simple types are assumed equal
-            return Ty1 == Ty2;
+            if (&Ty1->getContext() == &Ty2->getContext())
+                return Ty1 == Ty2;
+            // In different contexts, the rest of types are defined by type ID.
+            return true;
         }
     return false;
 }
@@ -3114,10 +4906,460 @@ static void lExtractOrCheckGlobals(llvm::Module *msrc, llvm::Module *mdst, bool
     }
 }
 
+/** Compile the exported functions declared with
+    __declspec(target_clones(...)) for the additional targets, and link the
+    clones into the given module along with dispatch functions that pick the
+    best variant at runtime.  Like in multi-target compilation, the ISA is
+    appended to the names of the variants, including the ones compiled for
+    the target of the module.  Returns false if an error was issued.
+*/
+static bool lCompileTargetClones(Module *mainModule, const char *srcFile, Arch arch, bool pic) {
+    // Find the exported functions that are cloned and all of the targets
+    // they are cloned for.
+    std::vector<Symbol *> syms;
+    mainModule->symbolTable->GetMatchingFunctions(lSymbolIsExported, &syms);
+    std::map<std::string, std::vector<ISPCTarget>> clonedFunctions;
+    std::vector<ISPCTarget> cloneTargets;
+    for (Symbol *sym : syms) {
+        const FunctionType *ft = CastType<FunctionType>(sym->type);
+        if (ft->targetClones.empty())
+            continue;
+        if (!ISPCTargetIsX86(g->target->getISPCTarget()) || IsStdin(srcFile)) {
+            Error(sym->pos, "\"target_clones\" is only supported for x86 targets when compiling a file.");
+            return false;
+        }
+        clonedFunctions[sym->name] = ft->targetClones;
+        for (ISPCTarget target : ft->targetClones) {
+            if (std::find(cloneTargets.begin(), cloneTargets.end(), target) == cloneTargets.end())
+                cloneTargets.push_back(target);
+        }
+    }
+    if (cloneTargets.empty())
+        return true;
+
+    Target *mainTarget = g->target;
+    std::map<std::string, FunctionTargetVariants> exportedFunctions;
+    for (Symbol *sym : syms) {
+        if (clonedFunctions.find(sym->name) == clonedFunctions.end())
+            continue;
+        llvm::Function *func = sym->exportedFunction;
+        func->setName(func->getName() + "_" + mainTarget->GetISAString());
+        exportedFunctions[sym->name].Set(mainTarget->getISA(), func, CastType<FunctionType>(sym->type));
+    }
+
+    // Compile the whole file again for each of the clone targets, but only
+    // keep the cloned functions.  Warnings were already reported for the
+    // main target.
+    std::vector<std::unique_ptr<llvm::Module>> cloneModules;
+    std::set<Target::ISA> isas{mainTarget->getISA()};
+    bool success = true;
+    bool disableWarnings = g->disableWarnings;
+    for (ISPCTarget cloneTarget : cloneTargets) {
+        g->target = new Target(arch, NULL, cloneTarget, pic, false);
+        if (!g->target->isValid()) {
+            success = false;
+            break;
+        }
+        if (!ISPCTargetIsX86(cloneTarget) || !isas.insert(g->target->getISA()).second) {
+            Error(SourcePos(), "Can't clone functions for target \"%s\": only x86 targets with distinct ISAs are "
+                               "supported in \"target_clones\".", ISPCTargetToString(cloneTarget).c_str());
+            success = false;
+            break;
+        }
+
+        g->mangleFunctionsWithTarget = true;
+        g->disableWarnings = true;
+        m = new Module(srcFile);
+        const int compileResult = m->CompileFile();
+        g->mangleFunctionsWithTarget = false;
+        g->disableWarnings = disableWarnings;
+        if (compileResult != 0 || m->errorCount != 0) {
+            mainModule->errorCount += m->errorCount;
+            success = false;
+            break;
+        }
+
+        // Global variables are defined in the main module.
+        lExtractOrCheckGlobals(m->module, mainModule->module, true);
+
+        std::set<llvm::Function *> cloned;
+        std::vector<Symbol *> cloneSyms;
+        m->symbolTable->GetMatchingFunctions(lSymbolIsExported, &cloneSyms);
+        for (Symbol *sym : cloneSyms) {
+            auto iter = clonedFunctions.find(sym->name);
+            if (iter == clonedFunctions.end() ||
+                std::find(iter->second.begin(), iter->second.end(), cloneTarget) == iter->second.end())
+                continue;
+            cloned.insert(sym->exportedFunction);
+            FunctionTargetVariants &ftv = exportedFunctions[sym->name];
+            ftv.Set(g->target->getISA(), sym->exportedFunction, CastType<FunctionType>(sym->type));
+        }
+
+        // Drop everything else.  The code is generated with the target
+        // machine of the main target, so the functions that are left need
+        // to carry the CPU and features of the clone target.
+        llvm::TargetMachine *targetMachine = g->target->GetTargetMachine();
+        for (llvm::Function &f : *m->module) {
+            if (f.isDeclaration())
+                continue;
+            if (!f.hasLocalLinkage() && cloned.find(&f) == cloned.end())
+                f.setLinkage(llvm::GlobalValue::InternalLinkage);
+            f.addFnAttr("target-cpu", targetMachine->getTargetCPU());
+            f.addFnAttr("target-features", targetMachine->getTargetFeatureString());
+        }
+        llvm::legacy::PassManager optPM;
+        optPM.add(llvm::createGlobalDCEPass());
+        optPM.run(*m->module);
+
+        for (llvm::GlobalVariable &gv : m->module->globals()) {
+            if (gv.hasLocalLinkage() && !gv.isConstant() && !gv.getName().startswith("__")) {
+                Warning(SourcePos(), "Static variable \"%s\" isn't shared between the clones of functions "
+                                     "declared with \"target_clones\".", gv.getName().str().c_str());
+            }
+        }
+
+        cloneModules.emplace_back(m->module);
+        m->module = NULL;
+        delete m;
+        delete g->target;
+    }
+
+    g->target = mainTarget;
+    m = mainModule;
+    InitLLVMUtil(g->ctx, *g->target);
+    if (!success)
+        return false;
+
+    llvm::Module *dispatchModule = lInitDispatchModule();
+    lEmitDispatchModule(dispatchModule, exportedFunctions, {});
+
+    for (auto &cloneModule : cloneModules) {
+        if (llvm::Linker::linkModules(*mainModule->module, std::move(cloneModule))) {
+            Error(SourcePos(), "Failed to link the functions declared with \"target_clones\".");
+            return false;
+        }
+    }
+    if (llvm::Linker::linkModules(*mainModule->module, std::unique_ptr<llvm::Module>(dispatchModule))) {
+        Error(SourcePos(), "Failed to link the dispatch functions for \"target_clones\".");
+        return false;
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////
+// Compilation cache
+
+/** Returns true if the compilation writes outputs besides the compiled
+    files, e.g. reports and dumps of the optimization, which aren't written
+    when the compiled files are restored from the cache. */
+static bool lHasSideOutputs() {
+    if (g->saveOptRecord || g->reportCost || g->printPassStats || g->opt.profileGenerate || g->enableTimeTrace ||
+        g->astDump != Globals::ASTDumpKind::None || g->dumpFile || g->debugIR != -1 || !g->debug_stages.empty()) {
+        return true;
+    }
+#ifdef ISPC_XE_ENABLED
+    if (g->xeKernelReport) {
+        return true;
+    }
+#endif
+    return false;
+}
+
+/** Returns the files to be stored in (or restored from) the compilation
+    cache, paired with their names in the cache entry. Returns an empty list
+    if the compilation can't be cached. */
+static CompileCacheFiles lGetCompileCacheFiles(const char *outFileName, const char *headerFileName,
+                                               const char *hostStubFileName, const char *devStubFileName) {
+    CompileCacheFiles files;
+    if (g->cacheDir.empty() || !g->runCPP || g->onlyCPP || g->enableFuzzTest || lHasSideOutputs()) {
+        return files;
+    }
+#ifdef ISPC_XE_ENABLED
+    // The result of automatic width selection depends on the compilation itself.
+    if (g->xeAutoWidth) {
+        return files;
+    }
+#endif
+
+    const std::pair<const char *, const char *> outputs[] = {
+        {"output", outFileName},
+        {"header", headerFileName},
+        {"cpp_header", g->cppHeaderFile.empty() ? NULL : g->cppHeaderFile.c_str()},
+        {"host_stub", hostStubFileName},
+        {"dev_stub", devStubFileName}};
+    for (const auto &output : outputs) {
+        if (output.second == NULL) {
+            continue;
+        }
+        // Output to stdout can't be restored from the cache.
+        if (!strcmp(output.second, "-")) {
+            return CompileCacheFiles();
+        }
+        files.push_back(output);
+    }
+    return files;
+}
+
+/** Returns the description of everything besides the source that affects
+    the compiled code: compiler version, target and compilation options. */
+static std::string lGetCompileOptions() {
+    std::string options;
+    llvm::raw_string_ostream os(options);
+    os << ISPC_VERSION_STRING << "\n";
+    os << g->target->GetTripleString() << " " << ISPCTargetToString(g->target->getISPCTarget()) << " "
+       << g->target->getCPU() << " " << g->target->getGeneratePIC() << "\n";
+    os << (int)g->target_os << " " << (int)g->calling_conv << " " << (int)g->mathLib << " " << (int)g->codegenOptLevel
+       << " " << g->includeStdlib << " " << g->generateDebuggingSymbols << " " << g->debugLineTablesOnly << " "
+       << g->generateDWARFVersion << " " << g->NoOmitFramePointer << " " << g->emitInstrumentation << " "
+       << g->emitPerfCounters << " " << g->asyncPrint << " " << g->enableLLVMIntrinsics << " " << g->forceAlignment
+       << " " << g->dllExport << " " << g->mangleFunctionsWithTarget << " " << g->ctx->shouldDiscardValueNames()
+       << " " << g->emitLTO << " " << g->customAllocator << " " << g->flushDenormals << " " << g->noPragmaOnce
+       << " " << g->emitSoAHelpers << " " << g->dispatchOnce << "\n";
+    // Debug info refers to the compilation directory.
+    if (g->generateDebuggingSymbols) {
+        os << g->currentDirectory << "\n";
+    }
+
+    const Opt &opt = g->opt;
+    os << opt.level << " " << opt.fastMath << " " << opt.fastMaskedVload << " " << opt.unrollLoops << " "
+       << opt.force32BitAddressing << " " << opt.disableAsserts << " " << opt.disableFMA << " "
+       << opt.forceAlignedMemory << " " << opt.disableMaskAllOnOptimizations << " "
+       << opt.disableHandlePseudoMemoryOps << " " << opt.disableBlendedMaskedStores << " "
+       << opt.disableCoherentControlFlow << " " << opt.disableUniformControlFlow << " "
+       << opt.disableGatherScatterOptimizations << " " << opt.disableMaskedStoreToStore << " "
+       << opt.disableGatherScatterFlattening << " " << opt.disableUniformMemoryOptimizations << " "
+       << opt.disableCoalescing << " " << opt.disableZMM << " " << opt.resetFTZ_DAZ << " "
+       << (int)opt.gatherStrategy << " " << opt.disableTargetMerging << " " << opt.disableLoopFusion << " "
+       << opt.disableUniformHoisting << "\n";
+    os << opt.autoPrefetchDistance << " " << opt.loopVersioning << " " << opt.autoCoherentControlFlow << "\n";
+    os << opt.profileGenerate << " " << opt.profileGenerateFile << " " << opt.profileUseFile << "\n";
+    // The profile may be updated under the same name.
+    if (!opt.profileUseFile.empty()) {
+        llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> profile = llvm::MemoryBuffer::getFile(opt.profileUseFile);
+        if (profile) {
+            llvm::SHA1 hasher;
+            hasher.update((*profile)->getBuffer());
+            os << llvm::toHex(hasher.final(), true) << "\n";
+        }
+    }
+#ifdef ISPC_XE_ENABLED
+    os << opt.disableXeGatherCoalescing << " " << opt.thresholdForXeGatherCoalescing << " "
+       << opt.buildLLVMLoadsOnXeGatherCoalescing << " " << opt.enableForeachInsideVarying << " "
+       << opt.emitXeHardwareMask << " " << opt.enableXeUnsafeMaskedLoad << " " << opt.disableXeBlock2D << " "
+       << g->stackMemSize << "\n";
+    os << g->vcOpts << "\n";
+#endif
+    return os.str();
+}
+
+/** Returns the key of the compilation cache entry for the given preprocessed
+    source.  Besides the source, the key covers the set of outputs and the
+    compilation options. */
+static std::string lGetCompileCacheKey(const std::string &source, Module::OutputType outputType,
+                                       Module::OutputFlags flags, const CompileCacheFiles &files) {
+    std::string outputs;
+    llvm::raw_string_ostream os(outputs);
+    for (const auto &file : files) {
+        os << file.first << " ";
+    }
+    os << (int)outputType << " " << (int)flags << "\n";
+
+    llvm::SHA1 hasher;
+    hasher.update(os.str());
+    hasher.update(lGetCompileOptions());
+    hasher.update(source);
+    return llvm::toHex(hasher.final(), true);
+}
+
+static std::string lGetCompileCacheEntry(const std::string &key) {
+    llvm::SmallString<256> path(g->cacheDir);
+    llvm::sys::path::append(path, key);
+    return std::string(path.str());
+}
+
+/** Registers the files referenced by the line markers of the preprocessed
+    source, the same way the lexer does.  This is needed for dependencies
+    output, when the source isn't parsed because of a cache hit. */
+static void lRegisterDependencies(const std::string &source) {
+    std::istringstream is(source);
+    std::string line;
+    while (std::getline(is, line)) {
+        // Line markers are either '# 1234 "foo.c"' or '#line 1234 "foo.c"'.
+        size_t pos = 0;
+        if (!line.compare(0, 2, "# "))
+            pos = 2;
+        else if (!line.compare(0, 6, "#line "))
+            pos = 6;
+        else
+            continue;
+        if (pos >= line.size() || !isdigit(line[pos]))
+            continue;
+
+        size_t begin = line.find('"', pos);
+        size_t end = (begin != std::string::npos) ? line.find('"', begin + 1) : std::string::npos;
+        if (end != std::string::npos)
+            RegisterDependency(line.substr(begin + 1, end - begin - 1));
+    }
+}
+
+bool Module::restoreFromCompileCache(OutputType outputType, OutputFlags flags, const CompileCacheFiles &files,
+                                     std::string &key) {
+    llvm::TimeTraceScope TimeScope("CompileCache");
+    if (!IsStdin(filename)) {
+        // Missing source is reported by CompileFile().
+        FILE *f = fopen(filename, "r");
+        if (!f) {
+            return false;
+        }
+        fclose(f);
+    }
+
+    // The preprocessed source is kept in the CPP stream, so CompileFile()
+    // doesn't run the preprocessor again on a cache miss.
+    bufferCPP.reset(new CPPBuffer{});
+    numCPPErrors = execPreprocessor(!IsStdin(filename) ? filename : "-", bufferCPP->os.get());
+    if (numCPPErrors > 0 && !g->ignoreCPPErrors) {
+        return false;
+    }
+
+    key = lGetCompileCacheKey(bufferCPP->str, outputType, flags, files);
+    std::string entry = lGetCompileCacheEntry(key);
+    for (const auto &file : files) {
+        llvm::SmallString<256> cached(entry);
+        llvm::sys::path::append(cached, file.first);
+        if (!llvm::sys::fs::exists(cached)) {
+            return false;
+        }
+    }
+    for (const auto &file : files) {
+        llvm::SmallString<256> cached(entry);
+        llvm::sys::path::append(cached, file.first);
+        // On failure, fall back to the regular compilation, which reports
+        // the problems with output files.
+        if (llvm::sys::fs::copy_file(cached, file.second)) {
+            return false;
+        }
+    }
+    if (g->debugPrint) {
+        printf("\nRestored outputs from compilation cache entry %s\n", entry.c_str());
+    }
+
+    lRegisterDependencies(bufferCPP->str);
+    clearCPPBuffer();
+    return true;
+}
+
+int Module::scanDependencies() {
+    llvm::TimeTraceScope TimeScope("ScanDependencies");
+    if (source == nullptr && !IsStdin(filename)) {
+        FILE *f = fopen(filename, "r");
+        if (!f) {
+            perror(filename);
+            return 1;
+        }
+        fclose(f);
+    }
+
+    bufferCPP.reset(new CPPBuffer{});
+    numCPPErrors = execPreprocessor(!IsStdin(filename) ? filename : "-", bufferCPP->os.get());
+    lRegisterDependencies(bufferCPP->str);
+    clearCPPBuffer();
+    return g->ignoreCPPErrors ? 0 : numCPPErrors;
+}
+
+/** Returns the target of the make rule with the dependencies: the name
+    given with -MT, or else the output file or an object file named after
+    the source. */
+static std::string lGetDepsTargetName(const char *depsTargetName, const char *outFileName, const char *srcFile) {
+    std::string targetName;
+    if (depsTargetName)
+        targetName = depsTargetName;
+    else if (outFileName)
+        targetName = outFileName;
+    else if (!IsStdin(srcFile)) {
+        targetName = srcFile;
+        size_t dot = targetName.find_last_of('.');
+        if (dot != std::string::npos)
+            targetName.erase(dot, std::string::npos);
+        targetName.append(".o");
+    } else
+        targetName = "a.out";
+    return targetName;
+}
+
+/** Stores the output files of a successful compilation in the compilation
+    cache.  The entry is populated in a temporary directory first and then
+    renamed, so concurrent compilations never see a partial entry.  Failing
+    to store the entry is not an error. */
+static void lStoreToCompileCache(const std::string &key, const CompileCacheFiles &files) {
+    std::string entry = lGetCompileCacheEntry(key);
+    if (llvm::sys::fs::exists(entry)) {
+        return;
+    }
+
+    llvm::SmallString<256> tmpEntry;
+    if (llvm::sys::fs::create_directories(g->cacheDir) ||
+        llvm::sys::fs::createUniqueDirectory(entry + ".tmp", tmpEntry)) {
+        if (g->debugPrint) {
+            printf("\nCannot create compilation cache entry in %s\n", g->cacheDir.c_str());
+        }
+        return;
+    }
+
+    bool success = true;
+    for (const auto &file : files) {
+        llvm::SmallString<256> cached(tmpEntry);
+        llvm::sys::path::append(cached, file.first);
+        if (llvm::sys::fs::copy_file(file.second, cached)) {
+            success = false;
+            break;
+        }
+    }
+    // Renaming fails if another compilation has stored the same entry meanwhile.
+    if (!success || llvm::sys::fs::rename(tmpEntry, entry)) {
+        llvm::sys::fs::remove_directories(tmpEntry);
+        return;
+    }
+    if (g->debugPrint) {
+        printf("\nStored outputs to compilation cache entry %s\n", entry.c_str());
+    }
+}
+
 int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, std::vector<ISPCTarget> targets,
                              OutputFlags outputFlags, OutputType outputType, const char *outFileName,
                              const char *headerFileName, const char *depsFileName, const char *depsTargetName,
                              const char *hostStubFileName, const char *devStubFileName) {
+    // When nothing but the dependencies is requested, only the preprocessor
+    // runs, once for each target, since they may include different files.
+    bool depsRequested = depsFileName != NULL || (outputFlags & Module::OutputDepsToStdout);
+    if (depsRequested && outFileName == NULL && headerFileName == NULL && hostStubFileName == NULL &&
+        devStubFileName == NULL && g->cppHeaderFile.empty() && !g->saveOptRecord && g->runCPP && !g->onlyCPP) {
+        std::vector<ISPCTarget> scanTargets = targets;
+        if (scanTargets.empty())
+            scanTargets.push_back(ISPCTarget::none);
+
+        int errorCount = 0;
+        for (unsigned int i = 0; i < scanTargets.size(); ++i) {
+            g->target = new Target(arch, cpu, scanTargets[i], 0 != (outputFlags & GeneratePIC), g->printTarget);
+            if (!g->target->isValid())
+                return 1;
+
+            m = new Module(srcFile);
+            errorCount += m->scanDependencies();
+            if (errorCount == 0 && i == scanTargets.size() - 1) {
+                std::string targetName = lGetDepsTargetName(depsTargetName, outFileName, srcFile);
+                if (!m->writeOutput(Module::Deps, outputFlags, depsFileName, targetName.c_str(), srcFile))
+                    errorCount = 1;
+            }
+
+            delete m;
+            m = NULL;
+            delete g->target;
+            g->target = NULL;
+        }
+        return errorCount > 0;
+    }
+
     if (targets.size() == 0 || targets.size() == 1) {
         // We're only compiling to a single target
         // TODO something wrong here
@@ -3130,7 +5372,25 @@ int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, st
             return 1;
 
         m = new Module(srcFile);
-        const int compileResult = m->CompileFile();
+
+        // On a compilation cache hit, the outputs are restored from the
+        // cache and only the dependencies are written below.
+        CompileCacheFiles cacheFiles =
+            lGetCompileCacheFiles(outFileName, headerFileName, hostStubFileName, devStubFileName);
+        std::string cacheKey;
+        const bool cacheHit =
+            !cacheFiles.empty() && m->restoreFromCompileCache(outputType, outputFlags, cacheFiles, cacheKey);
+        int compileResult = 0;
+        if (!cacheHit) {
+            std::unique_ptr<OptRecordFile> optRecord;
+            if (g->saveOptRecord) {
+                optRecord = std::make_unique<OptRecordFile>(*g->ctx, g->optRecordFile);
+            }
+            compileResult = m->CompileFile();
+            if (compileResult == 0 && !lCompileTargetClones(m, srcFile, arch, 0 != (outputFlags & GeneratePIC))) {
+                compileResult = 1;
+            }
+        }
 
         llvm::TimeTraceScope TimeScope("Backend");
 
@@ -3151,35 +5411,28 @@ int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, st
                 return 1;
             }
 #endif
-            if (outFileName != NULL)
+            if (outFileName != NULL && !cacheHit)
                 if (!m->writeOutput(outputType, outputFlags, outFileName))
                     return 1;
-            if (headerFileName != NULL)
+            if (headerFileName != NULL && !cacheHit)
                 if (!m->writeOutput(Module::Header, outputFlags, headerFileName))
                     return 1;
+            if (!g->cppHeaderFile.empty() && !cacheHit)
+                if (!m->writeCppHeader(g->cppHeaderFile.c_str(), headerFileName, {}))
+                    return 1;
             if (depsFileName != NULL || (outputFlags & Module::OutputDepsToStdout)) {
-                std::string targetName;
-                if (depsTargetName)
-                    targetName = depsTargetName;
-                else if (outFileName)
-                    targetName = outFileName;
-                else if (!IsStdin(srcFile)) {
-                    targetName = srcFile;
-                    size_t dot = targetName.find_last_of('.');
-                    if (dot != std::string::npos)
-                        targetName.erase(dot, std::string::npos);
-                    targetName.append(".o");
-                } else
-                    targetName = "a.out";
+                std::string targetName = lGetDepsTargetName(depsTargetName, outFileName, srcFile);
                 if (!m->writeOutput(Module::Deps, outputFlags, depsFileName, targetName.c_str(), srcFile))
                     return 1;
             }
-            if (hostStubFileName != NULL)
+            if (hostStubFileName != NULL && !cacheHit)
                 if (!m->writeOutput(Module::HostStub, outputFlags, hostStubFileName))
                     return 1;
-            if (devStubFileName != NULL)
+            if (devStubFileName != NULL && !cacheHit)
                 if (!m->writeOutput(Module::DevStub, outputFlags, devStubFileName))
                     return 1;
+            if (!cacheHit && !cacheKey.empty() && m->errorCount == 0)
+                lStoreToCompileCache(cacheKey, cacheFiles);
         } else {
             ++m->errorCount;
         }
@@ -3204,6 +5457,15 @@ int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, st
             return 1;
         }
 
+        // The dispatch code selects a target using x86 CPUID, so there is nothing
+        // to dispatch between on RISC-V.
+        for (auto target : targets) {
+            if (ISPCTargetIsRvv(target)) {
+                Error(SourcePos(), "Multi-target compilation isn't supported for RVV targets.");
+                return 1;
+            }
+        }
+
         // The user supplied multiple targets
         Assert(targets.size() > 1);
 
@@ -3221,6 +5483,35 @@ int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, st
         for (int i = 0; i < Target::NUM_ISAS; ++i)
             targetMachines[i] = NULL;
 
+        // Several vector widths of the same ISA may be compiled together
+        // (e.g. avx512skx-x8 and avx512skx-x16).  Their variants are told
+        // apart by the vector width appended to the function and file
+        // names, so find out upfront which ISAs need that.
+        int isaTargetCount[Target::NUM_ISAS] = {0};
+        {
+            std::set<std::pair<Target::ISA, int>> isaWidths;
+            std::map<Target::ISA, std::string> isaCPUs;
+            for (auto target : targets) {
+                Target isaTarget(arch, cpu, target, 0 != (outputFlags & GeneratePIC), false);
+                if (!isaTarget.isValid())
+                    return 1;
+                // Issue an error if we'd compile to the same variant of
+                // this target ISA twice or for different CPUs.  (It doesn't
+                // make sense to compile to both avx2-i32x16 and avx2-i16x16
+                // or to sse4.1-i32x4 and sse4.2-i32x8, for example.)
+                auto isaCPU = isaCPUs.insert({isaTarget.getISA(), isaTarget.getCPU()}).first;
+                if (!isaWidths.insert({isaTarget.getISA(), isaTarget.getVectorWidth()}).second ||
+                    isaCPU->second != isaTarget.getCPU()) {
+                    Error(SourcePos(), "Can't compile to multiple variants of %s target!\n", isaTarget.GetISAString());
+                    return 1;
+                }
+                ++isaTargetCount[isaTarget.getISA()];
+            }
+        }
+        std::vector<ISPCTarget> widthTargets;
+        // The first variant of each ISA, which the C++ wrappers call directly
+        std::vector<std::pair<Target::ISA, std::string>> cppVariants;
+
         llvm::Module *dispatchModule = NULL;
 
         std::map<std::string, FunctionTargetVariants> exportedFunctions;
@@ -3246,24 +5537,59 @@ int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, st
             DHI.EmitBackMatter = false;
         }
 
-        std::vector<Module *> modules(targets.size());
+        // When targets are compiled in parallel, code generation for each
+        // target runs in background and uses the target's own LLVMContext.
+        // The first target (and the dispatch module) use the global context.
+        llvm::LLVMContext *globalCtx = g->ctx;
+        std::vector<std::unique_ptr<llvm::LLVMContext>> targetContexts;
+
+        std::vector<Module *> modules;
+        modules.reserve(targets.size());
+
+        // Background code generation must not outlive the contexts, including
+        // the early exits on errors.
+        struct BackendJobsGuard {
+            std::vector<Module *> &modules;
+            llvm::LLVMContext *globalCtx;
+            ~BackendJobsGuard() {
+                for (auto module : modules) {
+                    if (module) {
+                        module->waitForBackend();
+                    }
+                }
+                g->ctx = globalCtx;
+            }
+        } backendJobsGuard{modules, globalCtx};
+
         for (unsigned int i = 0; i < targets.size(); ++i) {
+            if (g->parallelTargetCompile && i > 0) {
+                targetContexts.emplace_back(g->CreateLLVMContext());
+                g->ctx = targetContexts.back().get();
+            }
             g->target = new Target(arch, cpu, targets[i], 0 != (outputFlags & GeneratePIC), g->printTarget);
             if (!g->target->isValid())
                 return 1;
 
-            // Issue an error if we've already compiled to a variant of
-            // this target ISA.  (It doesn't make sense to compile to both
-            // avx and avx-x2, for example.)
-            if (targetMachines[g->target->getISA()] != NULL) {
-                Error(SourcePos(), "Can't compile to multiple variants of %s target!\n", g->target->GetISAString());
-                return 1;
+            bool isWidthVariant = isaTargetCount[g->target->getISA()] > 1;
+            if (isWidthVariant) {
+                g->target->setVariantHasWidthSuffix(true);
+                widthTargets.push_back(g->target->getISPCTarget());
             }
-            targetMachines[g->target->getISA()] = g->target->GetTargetMachine();
+            if (targetMachines[g->target->getISA()] == NULL)
+                targetMachines[g->target->getISA()] = g->target->GetTargetMachine();
 
             m = new Module(srcFile);
             modules.push_back(m);
-            const int compileResult = m->CompileFile();
+            int compileResult = 0;
+            {
+                // Each target writes its own optimization record file.
+                std::unique_ptr<OptRecordFile> optRecord;
+                if (g->saveOptRecord) {
+                    optRecord = std::make_unique<OptRecordFile>(
+                        *g->ctx, lGetTargetFileName(g->optRecordFile.c_str(), g->target->GetVariantString()));
+                }
+                compileResult = m->CompileFile();
+            }
 
             llvm::TimeTraceScope TimeScope("Backend");
 
@@ -3278,11 +5604,17 @@ int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, st
                 // Grab pointers to the exported functions from the module we
                 // just compiled, for use in generating the dispatch function
                 // later.
-                lGetExportedFunctions(m->symbolTable, exportedFunctions);
+                lGetExportedFunctions(m->symbolTable, exportedFunctions, isWidthVariant);
+                lShareIdenticalExportedFunctions(m->module, exportedFunctions, g->target->getISA());
+                if (std::none_of(cppVariants.begin(), cppVariants.end(),
+                                 [](const std::pair<Target::ISA, std::string> &variant) {
+                                     return variant.first == g->target->getISA();
+                                 }))
+                    cppVariants.push_back({g->target->getISA(), g->target->GetVariantString()});
 
                 if (outFileName != NULL) {
                     std::string targetOutFileName;
-                    std::string isaName{g->target->GetISAString()};
+                    std::string isaName{g->target->GetVariantString()};
                     targetOutFileName = lGetTargetFileName(outFileName, isaName);
                     if (!m->writeOutput(outputType, outputFlags, targetOutFileName.c_str())) {
                         return 1;
@@ -3305,8 +5637,7 @@ int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, st
                     DHI.EmitBackMatter = true;
                 }
 
-                const char *isaName;
-                isaName = g->target->GetISAString();
+                std::string isaName{g->target->GetVariantString()};
                 std::string targetHeaderFileName = lGetTargetFileName(headerFileName, isaName);
                 // write out a header w/o target name for the first target only
                 if (!m->writeOutput(Module::Header, outputFlags, headerFileName, nullptr, nullptr, &DHI)) {
@@ -3323,9 +5654,15 @@ int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, st
             delete g->target;
             g->target = NULL;
 
-            // Important: Don't delete the llvm::Module *m here; we need to
-            // keep it around so the llvm::Functions *s stay valid for when
-            // we generate the dispatch module's functions...
+            // Only the names and types of the exported functions are needed
+            // for the dispatch module, so the module of the target is freed
+            // here.  It's kept if its code is still being generated in the
+            // background, and the last one is used for the outputs below.
+            if (!g->parallelTargetCompile && i != targets.size() - 1) {
+                modules.back() = NULL;
+                delete m;
+                m = NULL;
+            }
         }
 
         // Find the first non-NULL target machine from the targets we
@@ -3345,17 +5682,30 @@ int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, st
         Assert(firstTarget != ISPCTarget::none);
         Assert(firstTargetMachine != NULL);
 
+        // The dispatch module lives in the global context, so switch back to it
+        // and make sure all background code generation has finished.
+        g->ctx = globalCtx;
+        for (auto module : modules) {
+            if (module) {
+                module->waitForBackend();
+            }
+        }
+
         g->target = new Target(arch, cpu, firstTarget, 0 != (outputFlags & GeneratePIC), false);
         if (!g->target->isValid()) {
             return 1;
         }
+        if (g->parallelTargetCompile) {
+            // LLVMTypes are still bound to the context of the last target.
+            InitLLVMUtil(g->ctx, *g->target);
+        }
 
         if (dispatchModule == NULL) {
             Error(SourcePos(), "Failed to create dispatch module.\n");
             return 1;
         }
 
-        lEmitDispatchModule(dispatchModule, exportedFunctions);
+        lEmitDispatchModule(dispatchModule, exportedFunctions, widthTargets);
 
         if (outFileName != NULL) {
             switch (outputType) {
@@ -3380,20 +5730,12 @@ int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, st
             }
         }
 
+        if (!g->cppHeaderFile.empty())
+            if (!m->writeCppHeader(g->cppHeaderFile.c_str(), headerFileName, cppVariants))
+                return 1;
+
         if (depsFileName != NULL || (outputFlags & Module::OutputDepsToStdout)) {
-            std::string targetName;
-            if (depsTargetName)
-                targetName = depsTargetName;
-            else if (outFileName)
-                targetName = outFileName;
-            else if (!IsStdin(srcFile)) {
-                targetName = srcFile;
-                size_t dot = targetName.find_last_of('.');
-                if (dot != std::string::npos)
-                    targetName.erase(dot, std::string::npos);
-                targetName.append(".o");
-            } else
-                targetName = "a.out";
+            std::string targetName = lGetDepsTargetName(depsTargetName, outFileName, srcFile);
             if (!m->writeOutput(Module::Deps, outputFlags, depsFileName, targetName.c_str(), srcFile))
                 return 1;
         }
@@ -3401,6 +5743,8 @@ int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, st
         for (auto module : modules) {
             delete module;
         }
+        modules.clear();
+        targetContexts.clear();
 
         delete g->target;
         g->target = NULL;
@@ -3408,7 +5752,83 @@ int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, st
     }
 }
 
-int Module::LinkAndOutput(std::vector<std::string> linkFiles, OutputType outputType, const char *outFileName) {
+// Define the kernels requested with --fuse-kernels. A fused kernel runs the given kernels one after another
+// with its own arguments, each program instance of a kernel is followed by the same one of the next kernel.
+// Once they are inlined, the values stored to memory by a kernel can be forwarded to the loads of the next one.
+static bool lFuseKernels(llvm::Module *module, const std::vector<std::string> &fusedKernels) {
+    for (const std::string &fusion : fusedKernels) {
+        llvm::StringRef fusedName, kernelList;
+        std::tie(fusedName, kernelList) = llvm::StringRef(fusion).split(':');
+        llvm::SmallVector<llvm::StringRef, 4> kernelNames;
+        kernelList.split(kernelNames, ',', -1, false);
+        if (fusedName.empty() || kernelNames.size() < 2) {
+            Error(SourcePos(), "Expected \"<fused>:<kernel>,<kernel>...\" for --fuse-kernels, found \"%s\".",
+                  fusion.c_str());
+            return false;
+        }
+        if (module->getNamedValue(fusedName)) {
+            Error(SourcePos(), "Fused kernel \"%s\" is already defined in the linked files.", fusedName.str().c_str());
+            return false;
+        }
+
+        std::vector<llvm::Function *> kernels;
+        for (llvm::StringRef kernelName : kernelNames) {
+            llvm::Function *kernel = module->getFunction(kernelName);
+            if (kernel == nullptr || kernel->isDeclaration()) {
+                Error(SourcePos(), "Kernel \"%s\" to fuse is not defined in the linked files.",
+                      kernelName.str().c_str());
+                return false;
+            }
+            if (!kernel->getReturnType()->isVoidTy() || kernel->isVarArg()) {
+                Error(SourcePos(), "Function \"%s\" is not a kernel and can't be fused.", kernelName.str().c_str());
+                return false;
+            }
+            // All kernels get the arguments of the fused one.
+            if (!kernels.empty() && kernel->getFunctionType() != kernels[0]->getFunctionType()) {
+                Error(SourcePos(), "Kernels \"%s\" and \"%s\" have different parameters and can't be fused.",
+                      kernels[0]->getName().str().c_str(), kernelName.str().c_str());
+                return false;
+            }
+            kernels.push_back(kernel);
+        }
+
+        llvm::Function *first = kernels[0];
+        llvm::Function *fused =
+            llvm::Function::Create(first->getFunctionType(), llvm::GlobalValue::ExternalLinkage, fusedName, module);
+        // Calling convention, attributes and DLL storage make it a kernel of the same kind as the fused ones.
+        fused->copyAttributesFrom(first);
+        std::vector<llvm::Value *> args;
+        for (llvm::Argument &arg : fused->args()) {
+            arg.setName(first->getArg(arg.getArgNo())->getName());
+            args.push_back(&arg);
+        }
+        llvm::IRBuilder<> builder(llvm::BasicBlock::Create(*g->ctx, "entry", fused));
+        std::vector<llvm::CallInst *> calls;
+        for (llvm::Function *kernel : kernels) {
+            llvm::CallInst *call = builder.CreateCall(kernel, args);
+            call->setCallingConv(kernel->getCallingConv());
+            calls.push_back(call);
+        }
+        builder.CreateRetVoid();
+
+        // Kernels can't call each other, so they are always inlined.
+        for (llvm::CallInst *call : calls) {
+            llvm::Function *kernel = call->getCalledFunction();
+            llvm::InlineFunctionInfo IFI;
+            if (!llvm::InlineFunction(*call, IFI).isSuccess()) {
+                Error(SourcePos(), "Kernel \"%s\" can't be inlined into fused kernel \"%s\".",
+                      kernel->getName().str().c_str(), fusedName.str().c_str());
+                return false;
+            }
+        }
+        // The fused kernel has no source location of its own.
+        llvm::stripDebugInfo(*fused);
+    }
+    return true;
+}
+
+int Module::LinkAndOutput(std::vector<std::string> linkFiles, OutputType outputType, const char *outFileName,
+                          int optLevel, const std::vector<std::string> &fusedKernels) {
     auto llvmLink = std::make_unique<llvm::Module>("llvm-link", *g->ctx);
     llvm::Linker linker(*llvmLink);
     for (const auto &file : linkFiles) {
@@ -3434,6 +5854,10 @@ int Module::LinkAndOutput(std::vector<std::string> linkFiles, OutputType outputT
         }
         inputStream.close();
     }
+    if (!lFuseKernels(llvmLink.get(), fusedKernels))
+        return 1;
+    if (optLevel > 0 && (linkFiles.size() > 1 || !fusedKernels.empty()))
+        OptimizeLinked(llvmLink.get());
     if (outFileName != NULL) {
         if ((outputType == Bitcode) || (outputType == BitcodeText))
             writeBitcode(llvmLink.get(), outFileName, outputType);
@@ -45,6 +45,9 @@
 
 #include <llvm/Support/TimeProfiler.h>
 
+#include <future>
+#include <tuple>
+
 #ifdef ISPC_XE_ENABLED
 #include <unordered_map>
 #endif
@@ -57,6 +60,10 @@ namespace ispc {
 
 struct DispatchHeaderInfo;
 
+/** Output files of the compilation, which are stored in the compilation
+    cache, paired with their names inside the cache entry. */
+typedef std::vector<std::pair<const char *, const char *>> CompileCacheFiles;
+
 #ifdef ISPC_XE_ENABLED
 // Derived from ocloc_api.h
 using invokePtr = int (*)(unsigned, const char **, const uint32_t, const uint8_t **, const uint64_t *, const char **,
@@ -68,8 +75,10 @@ using freeOutputPtr = int (*)(uint32_t *, uint8_t ***, uint64_t **, char ***);
 class Module {
   public:
     /** The name of the source file being compiled should be passed as the
-        module name. */
-    Module(const char *filename);
+        module name.  If source is non-NULL, it is compiled instead of the
+        contents of the file, and the file name is used only in diagnostics
+        and debug information. */
+    Module(const char *filename, const char *source = nullptr);
 
     ~Module();
 
@@ -107,8 +116,7 @@ class Module {
     void AddFunctionTemplateDefinition(const TemplateParms *templateParmList, const std::string &name,
                                        const FunctionType *ftype, Stmt *code);
 
-    void AddFunctionTemplateInstantiation(const std::string &name,
-                                          const std::vector<std::pair<const Type *, SourcePos>> &types,
+    void AddFunctionTemplateInstantiation(const std::string &name, const std::vector<TemplateArg> &types,
                                           const FunctionType *ftype, SourcePos pos);
 
     /** Adds the given type to the set of types that have their definitions
@@ -122,17 +130,20 @@ class Module {
     /** After a source file has been compiled, output can be generated in a
         number of different formats. */
     enum OutputType {
-        Asm,         /** Generate text assembly language output */
-        Bitcode,     /** Generate LLVM IR bitcode output */
-        BitcodeText, /** Generate LLVM IR Text output */
-        Object,      /** Generate a native object file */
-        Header,      /** Generate a C/C++ header file with
-                         declarations of 'export'ed functions, global
-                         variables, and the types used by them. */
-        Deps,        /** generate dependencies */
-        DevStub,     /** generate device-side offload stubs */
-        HostStub,    /** generate host-side offload stubs */
-        CPPStub,     /** generate preprocessed stubs (-E mode) */
+        Asm,          /** Generate text assembly language output */
+        Bitcode,      /** Generate LLVM IR bitcode output */
+        BitcodeText,  /** Generate LLVM IR Text output */
+        Object,       /** Generate a native object file */
+        Header,       /** Generate a C/C++ header file with
+                          declarations of 'export'ed functions, global
+                          variables, and the types used by them. */
+        Deps,         /** generate dependencies */
+        DevStub,      /** generate device-side offload stubs */
+        HostStub,     /** generate host-side offload stubs */
+        CPPStub,      /** generate preprocessed stubs (-E mode) */
+        InlineHeader, /** Generate a C++ header with the definitions of
+                          the 'export'ed functions, which the compiler
+                          of the application can inline. */
 #ifdef ISPC_XE_ENABLED
         ZEBIN, /** generate L0 binary file */
         SPIRV, /** generate spir-v file */
@@ -177,7 +188,24 @@ class Module {
                                 OutputFlags outputFlags, OutputType outputType, const char *outFileName,
                                 const char *headerFileName, const char *depsFileName, const char *depsTargetName,
                                 const char *hostStubFileName, const char *devStubFileName);
-    static int LinkAndOutput(std::vector<std::string> linkFiles, OutputType outputType, const char *outFileName);
+    /** Link the given files. Each of fusedKernels is "<fused>:<kernel>,<kernel>..." and defines a kernel
+        "<fused>" which runs the given kernels one after another with its arguments. */
+    static int LinkAndOutput(std::vector<std::string> linkFiles, OutputType outputType, const char *outFileName,
+                             int optLevel, const std::vector<std::string> &fusedKernels = {});
+
+    /** Uniform parameter of a function that is replaced with a constant
+        before optimization, so that the function is specialized for the
+        value (see ispc_jit.h). */
+    struct ParameterBinding {
+        std::string function;
+        std::string parameter;
+        bool isFloat{false};
+        int64_t intValue{0};
+        double floatValue{0};
+    };
+
+    /** Parameters to bind to constants in CompileFile(). */
+    std::vector<ParameterBinding> parameterBindings;
 
     /** Total number of errors encountered during compilation. */
     int errorCount{0};
@@ -204,8 +232,36 @@ class Module {
         is handled by lMangleStructName() below. */
     std::map<std::string, llvm::StructType *> structTypeMap;
 
+    /** Debug type cache.  Struct and enum types get a distinct debug type
+        node each time one is created, so they are created once per Module
+        and shared by all of the variables of the type. */
+    std::map<const Type *, llvm::DIType *> diTypeMap;
+
+    /** Overload resolution cache.  The function that a call resolves to
+        only depends on the candidate functions and on the types of the
+        arguments (and whether they may be NULL or are constant), so
+        FunctionSymbolExpr::ResolveOverloads() looks calls up here before
+        computing the cost of each candidate. */
+    struct OverloadResolutionKey {
+        std::vector<Symbol *> candidates;
+        std::vector<const Type *> argTypes;
+        std::vector<bool> argCouldBeNULL, argIsConstant;
+
+        bool operator<(const OverloadResolutionKey &other) const {
+            return std::tie(argTypes, candidates, argCouldBeNULL, argIsConstant) <
+                   std::tie(other.argTypes, other.candidates, other.argCouldBeNULL, other.argIsConstant);
+        }
+    };
+    std::map<OverloadResolutionKey, Symbol *> overloadResolutionCache;
+
+    /** Builtins libraries loaded lazily (--lazy-builtins).  Only
+        declarations of their functions are in the module, until the needed
+        definitions are linked in by LinkLazyBuiltins() after IR generation. */
+    std::vector<std::unique_ptr<llvm::Module>> lazyBuiltins;
+
   private:
     const char *filename{nullptr};
+    const char *source{nullptr};
     AST *ast{nullptr};
 
     // Definition and member object capturing preprocessing stream during Module lifetime.
@@ -218,8 +274,20 @@ class Module {
 
     std::unique_ptr<CPPBuffer> bufferCPP{nullptr};
 
+    /** Number of diagnostic errors reported by the preprocessor. */
+    int numCPPErrors{0};
+
     std::vector<std::pair<const Type *, SourcePos>> exportedTypes;
 
+    /** Code generation job running in the background, when targets of
+        multi-target compilation are compiled in parallel.  Its result is
+        the message of the warning to report, if it's not empty. */
+    std::future<std::string> backendJob;
+
+    /** Waits for the background code generation job, if there is one, and
+        reports its warning. */
+    void waitForBackend();
+
     /** Write the corresponding output type to the given file.  Returns
         true on success, false if there has been an error.  The given
         filename may be NULL, indicating that output should go to standard
@@ -228,9 +296,17 @@ class Module {
                      const char *sourceFileName = NULL, DispatchHeaderInfo *DHI = 0);
     bool writeHeader(const char *filename);
     bool writeDispatchHeader(DispatchHeaderInfo *DHI);
+    /** Write the C++ header with inline wrappers of the exported functions,
+        which includes the C header.  In multi-target compilation, the
+        variants are the ISAs and the suffixes of their functions. */
+    bool writeCppHeader(const char *filename, const char *headerFileName,
+                        const std::vector<std::pair<Target::ISA, std::string>> &variants);
     bool writeDeps(const char *filename, bool generateMakeRule, const char *targetName = NULL,
                    const char *srcFilename = NULL);
     bool writeDevStub(const char *filename);
+    /** Write the exported functions as inline C++ functions that are
+        translated from their optimized code. */
+    bool writeInlineHeader(const char *filename);
     bool writeHostStub(const char *filename);
     bool writeCPPStub(const char *outFileName);
     bool writeObjectFileOrAssembly(OutputType outputType, const char *filename);
@@ -249,8 +325,24 @@ class Module {
         Returns the number of diagnostic errors encountered. */
     int execPreprocessor(const char *infilename, llvm::raw_string_ostream *ostream) const;
 
+    /** Looks up the module in the compilation cache (--cache-dir).  On a hit,
+        the cached outputs are copied to the given files and true is returned.
+        Otherwise, returns false and sets the key, under which the outputs are
+        to be stored. */
+    bool restoreFromCompileCache(OutputType outputType, OutputFlags flags, const CompileCacheFiles &files,
+                                 std::string &key);
+
+    /** Runs only the preprocessor on the source file and registers the
+        files it includes, when nothing but the dependencies is requested.
+        Returns the number of errors. */
+    int scanDependencies();
+
     /** Helper function to clean internal CPP buffer. **/
     void clearCPPBuffer();
+
+    /** Replaces the uses of the parameters given in parameterBindings with
+        the constants they are bound to. */
+    void bindParameters();
 };
 
 inline Module::OutputFlags &operator|=(Module::OutputFlags &lhs, const __underlying_type(Module::OutputFlags) rhs) {
@@ -39,7 +39,9 @@
 #include "ctx.h"
 #include "llvmutil.h"
 #include "module.h"
+#include "opt/CostReport.h"
 #include "opt/ISPCPasses.h"
+#include "opt/PassStats.h"
 #include "sym.h"
 #include "util.h"
 
@@ -51,26 +53,63 @@
 
 #include <llvm/ADT/SmallSet.h>
 #include <llvm/ADT/Triple.h>
+#include <llvm/Analysis/AliasAnalysis.h>
 #include <llvm/Analysis/BasicAliasAnalysis.h>
+#include <llvm/Analysis/CGSCCPassManager.h>
 #include <llvm/Analysis/ConstantFolding.h>
-#include <llvm/Analysis/Passes.h>
+#include <llvm/Analysis/LoopAnalysisManager.h>
 #include <llvm/Analysis/TargetLibraryInfo.h>
 #include <llvm/Analysis/TargetTransformInfo.h>
 #include <llvm/Analysis/TypeBasedAliasAnalysis.h>
 #include <llvm/BinaryFormat/Dwarf.h>
 #include <llvm/IR/DataLayout.h>
 #include <llvm/IR/LegacyPassManager.h>
-#include <llvm/PassRegistry.h>
+#include <llvm/IR/PassManager.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/FileSystem.h>
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/Target/TargetOptions.h>
+#include <llvm/Transforms/IPO/ArgumentPromotion.h>
+#include <llvm/Transforms/IPO/ConstantMerge.h>
+#include <llvm/Transforms/IPO/DeadArgumentElimination.h>
+#include <llvm/Transforms/IPO/FunctionAttrs.h>
+#include <llvm/Transforms/IPO/GlobalDCE.h>
+#include <llvm/Transforms/IPO/GlobalOpt.h>
+#include <llvm/Transforms/IPO/Inliner.h>
+#include <llvm/Transforms/IPO/Internalize.h>
+#include <llvm/Transforms/IPO/SCCP.h>
+#include <llvm/Transforms/IPO/StripDeadPrototypes.h>
 #include <llvm/Transforms/InstCombine/InstCombine.h>
-#include <llvm/Transforms/Instrumentation.h>
-#include <llvm/Transforms/Scalar.h>
+#include <llvm/Transforms/Instrumentation/InstrProfiling.h>
+#include <llvm/Transforms/Instrumentation/PGOInstrumentation.h>
+#include <llvm/Transforms/Scalar/ADCE.h>
+#include <llvm/Transforms/Scalar/AlignmentFromAssumptions.h>
+#include <llvm/Transforms/Scalar/CorrelatedValuePropagation.h>
+#include <llvm/Transforms/Scalar/DCE.h>
+#include <llvm/Transforms/Scalar/DeadStoreElimination.h>
+#include <llvm/Transforms/Scalar/EarlyCSE.h>
 #include <llvm/Transforms/Scalar/GVN.h>
+#include <llvm/Transforms/Scalar/IndVarSimplify.h>
 #include <llvm/Transforms/Scalar/InstSimplifyPass.h>
-#if ISPC_LLVM_VERSION >= ISPC_LLVM_15_0
+#include <llvm/Transforms/Scalar/JumpThreading.h>
+#include <llvm/Transforms/Scalar/LICM.h>
+#include <llvm/Transforms/Scalar/LoopDeletion.h>
+#include <llvm/Transforms/Scalar/LoopIdiomRecognize.h>
+#include <llvm/Transforms/Scalar/LoopPassManager.h>
+#include <llvm/Transforms/Scalar/LoopRotation.h>
+#include <llvm/Transforms/Scalar/LoopUnrollPass.h>
+#include <llvm/Transforms/Scalar/LowerExpectIntrinsic.h>
+#include <llvm/Transforms/Scalar/LowerMatrixIntrinsics.h>
+#include <llvm/Transforms/Scalar/MemCpyOptimizer.h>
+#include <llvm/Transforms/Scalar/Reassociate.h>
+#include <llvm/Transforms/Scalar/SCCP.h>
+#include <llvm/Transforms/Scalar/SROA.h>
 #include <llvm/Transforms/Scalar/SimpleLoopUnswitch.h>
-#endif
+#include <llvm/Transforms/Scalar/SimplifyCFG.h>
+#include <llvm/Transforms/Scalar/TailRecursionElimination.h>
+#include <llvm/Transforms/Utils/Mem2Reg.h>
+#include <llvm/Transforms/Vectorize/LoadStoreVectorizer.h>
 
 #ifdef ISPC_HOST_IS_LINUX
 #include <alloca.h>
@@ -87,70 +126,278 @@
 
 using namespace ispc;
 
+// GVN and SROA passes got "Pass" suffix in LLVM 14.0.
+#if ISPC_LLVM_VERSION < ISPC_LLVM_14_0
+using GVNPass = llvm::GVN;
+using SROAPass = llvm::SROA;
+#else
+using llvm::GVNPass;
+using llvm::SROAPass;
+#endif
+
+static SROAPass lCreateSROAPass() {
+#if ISPC_LLVM_VERSION >= ISPC_LLVM_16_0
+    // Starting LLVM 16.0 SROA may modify CFG, keep the behavior of the earlier versions.
+    return SROAPass(llvm::SROAOptions::PreserveCFG);
+#else
+    return SROAPass();
+#endif
+}
+
+#ifdef ISPC_XE_ENABLED
 ///////////////////////////////////////////////////////////////////////////
-// This is a wrap over class llvm::PassManager. This duplicates PassManager function run()
-//   and change PassManager function add by adding some checks and debug passes.
+// Runs a legacy module pass that doesn't have a new pass manager version
+//   (e.g. GenXSPIRVWriterAdaptor) as a part of the new pass manager pipeline.
+class LegacyModulePassWrapper : public llvm::PassInfoMixin<LegacyModulePassWrapper> {
+  public:
+    explicit LegacyModulePassWrapper(llvm::Pass *P) : pass(P) {}
+
+    static llvm::StringRef name() { return "Legacy pass wrapper"; }
+    llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &MAM) {
+        llvm::legacy::PassManager PM;
+        // Legacy pass manager takes the ownership of the pass.
+        PM.add(pass.release());
+        return PM.run(M) ? llvm::PreservedAnalyses::none() : llvm::PreservedAnalyses::all();
+    }
+
+  private:
+    std::unique_ptr<llvm::Pass> pass;
+};
+#endif
+
+///////////////////////////////////////////////////////////////////////////
+// This is a wrap over class llvm::ModulePassManager of the new pass manager.
+//   Consecutive function passes are grouped into one function pass manager (and
+//   consecutive loop passes into one loop pass manager), so every function goes through
+//   the whole group at once and the analyses cached by the analysis managers are reused
+//   until some pass reports that it doesn't preserve them.
 //   This wrap can control:
 //   - If we want to switch off optimization with given number.
 //   - If we want to dump LLVM IR after optimization with given number.
 //   - If we want to generate LLVM IR debug for gdb after optimization with given number.
-class DebugPassManager {
+//   - If we want to collect statistics (time, IR size) of every optimization (--print-pass-stats).
+class DebugModulePassManager {
   public:
-    DebugPassManager() : number(0) {}
-    void add(llvm::Pass *P, int stage);
-    bool run(llvm::Module &M) { return PM.run(M); }
-    llvm::legacy::PassManager &getPM() { return PM; }
+    DebugModulePassManager(llvm::Module &M, llvm::TargetMachine *TM, PassStatsCollector *stats);
+    template <typename T> void addModulePass(T &&P, int stage = -1);
+    template <typename T> void addCGSCCPass(T &&P, int stage = -1);
+    template <typename T> void addFunctionPass(T &&P, int stage = -1);
+    template <typename T> void addLoopPass(T &&P, int stage = -1, bool useMemorySSA = false);
+    void run();
 
   private:
-    llvm::legacy::PassManager PM;
-    int number;
+    bool takeStage(int stage);
+    void addDumpPass(llvm::StringRef passName);
+    template <typename IRUnitT, typename T>
+    void addToPassManager(llvm::PassManager<IRUnitT> &PM, T &&P, llvm::StringRef passName);
+    void commitLoopPassManager();
+    void commitFunctionPassManager();
+
+    llvm::Module &M;
+    // Analysis managers must be declared in this order so that they are destroyed
+    // in the correct order due to inter-analysis-manager references.
+    llvm::LoopAnalysisManager LAM;
+    llvm::FunctionAnalysisManager FAM;
+    llvm::CGSCCAnalysisManager CGAM;
+    llvm::ModuleAnalysisManager MAM;
+    llvm::PassBuilder PB;
+    llvm::ModulePassManager MPM;
+    std::unique_ptr<llvm::FunctionPassManager> FPM;
+    std::unique_ptr<llvm::LoopPassManager> LPM;
+    bool LPMUsesMemorySSA{false};
+    // Statistics are collected only if it is not null.
+    PassStatsCollector *stats;
+    // Index of the statistics phase of the loop pass manager.
+    int LPMStatsIndex{-1};
+    int number{0};
 };
 
-void DebugPassManager::add(llvm::Pass *P, int stage = -1) {
-    // taking number of optimization
+DebugModulePassManager::DebugModulePassManager(llvm::Module &M, llvm::TargetMachine *TM, PassStatsCollector *stats)
+    : M(M), PB(TM), stats(stats) {
+    // Register alias analyses explicitly before PassBuilder registers the default ones.
+    FAM.registerPass([] {
+        llvm::AAManager AA;
+        AA.registerFunctionAnalysis<llvm::BasicAA>();
+        AA.registerFunctionAnalysis<llvm::TypeBasedAA>();
+        return AA;
+    });
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+}
+
+// Returns the name of the pass without "llvm::" prefix, which is a part of the name
+// of the LLVM passes in some LLVM versions.
+template <typename T> static llvm::StringRef lGetPassName(const T &P) {
+    llvm::StringRef name = P.name();
+    name.consume_front("llvm::");
+    return name;
+}
+
+// Takes number of the next optimization and returns true if it is not switched off.
+bool DebugModulePassManager::takeStage(int stage) {
     if (stage == -1) {
         number++;
     } else {
         number = stage;
     }
-    if (g->off_stages.find(number) == g->off_stages.end()) {
-        // adding optimization (not switched off)
-        PM.add(P);
-        if (g->debug_stages.find(number) != g->debug_stages.end()) {
-            // adding dump of LLVM IR after optimization
-            if (g->dumpFile) {
-                PM.add(CreateDebugPassFile(number, P->getPassName(), g->dumpFilePath));
-            } else {
-                char buf[100];
-                snprintf(buf, sizeof(buf), "\n\n*****LLVM IR after phase %d: %s*****\n\n", number,
-                         P->getPassName().data());
-                PM.add(CreateDebugPass(buf));
-            }
-        }
+    return g->off_stages.find(number) == g->off_stages.end();
+}
+
+void DebugModulePassManager::addDumpPass(llvm::StringRef passName) {
+    if (g->debug_stages.find(number) == g->debug_stages.end()) {
+        return;
+    }
+    // Dump passes work on the whole module, so the pending function passes are committed first.
+    commitFunctionPassManager();
+    if (g->dumpFile) {
+        DebugPassFile dumpPass(number, passName, g->dumpFilePath);
+        // The module is not modified until run(), so this is the IR going into the pipeline.
+        dumpPass.runInitialization(M);
+        MPM.addPass(std::move(dumpPass));
+    } else {
+        char buf[100];
+        snprintf(buf, sizeof(buf), "\n\n*****LLVM IR after phase %d: %s*****\n\n", number, passName.str().c_str());
+        MPM.addPass(DebugPass(buf));
+    }
+}
+
+// Adds the pass to the pass manager, wrapping it to collect statistics if they are requested.
+template <typename IRUnitT, typename T>
+void DebugModulePassManager::addToPassManager(llvm::PassManager<IRUnitT> &PM, T &&P, llvm::StringRef passName) {
+    if (stats == nullptr) {
+        PM.addPass(std::forward<T>(P));
+        return;
+    }
+    PM.addPass(PassStatsWrapper<IRUnitT, std::remove_reference_t<T>>(std::forward<T>(P), stats,
+                                                                     stats->addPhase(number, passName)));
+}
+
+void DebugModulePassManager::commitLoopPassManager() {
+    if (!LPM) {
+        return;
+    }
+    if (!FPM) {
+        FPM = std::make_unique<llvm::FunctionPassManager>();
+    }
+    auto loopAdaptor = llvm::createFunctionToLoopPassAdaptor(std::move(*LPM), LPMUsesMemorySSA);
+    if (stats != nullptr) {
+        FPM->addPass(
+            PassStatsWrapper<llvm::Function, decltype(loopAdaptor)>(std::move(loopAdaptor), stats, LPMStatsIndex));
+    } else {
+        FPM->addPass(std::move(loopAdaptor));
+    }
+    LPM.reset();
+}
+
+void DebugModulePassManager::commitFunctionPassManager() {
+    commitLoopPassManager();
+    if (!FPM) {
+        return;
+    }
+    MPM.addPass(llvm::createModuleToFunctionPassAdaptor(std::move(*FPM)));
+    FPM.reset();
+}
+
+template <typename T> void DebugModulePassManager::addModulePass(T &&P, int stage) {
+    if (!takeStage(stage)) {
+        return;
+    }
+    commitFunctionPassManager();
+    llvm::StringRef passName = lGetPassName(P);
+    addToPassManager(MPM, std::forward<T>(P), passName);
+    addDumpPass(passName);
+}
+
+template <typename T> void DebugModulePassManager::addCGSCCPass(T &&P, int stage) {
+    if (!takeStage(stage)) {
+        return;
     }
+    commitFunctionPassManager();
+    llvm::StringRef passName = lGetPassName(P);
+    addToPassManager(MPM, llvm::createModuleToPostOrderCGSCCPassAdaptor(std::forward<T>(P)), passName);
+    addDumpPass(passName);
+}
+
+template <typename T> void DebugModulePassManager::addFunctionPass(T &&P, int stage) {
+    if (!takeStage(stage)) {
+        return;
+    }
+    commitLoopPassManager();
+    if (!FPM) {
+        FPM = std::make_unique<llvm::FunctionPassManager>();
+    }
+    llvm::StringRef passName = lGetPassName(P);
+    addToPassManager(*FPM, std::forward<T>(P), passName);
+    addDumpPass(passName);
+}
+
+template <typename T> void DebugModulePassManager::addLoopPass(T &&P, int stage, bool useMemorySSA) {
+    if (!takeStage(stage)) {
+        return;
+    }
+    if (LPM && LPMUsesMemorySSA != useMemorySSA) {
+        commitLoopPassManager();
+    }
+    if (!LPM) {
+        LPM = std::make_unique<llvm::LoopPassManager>();
+        LPMUsesMemorySSA = useMemorySSA;
+    }
+    llvm::StringRef passName = lGetPassName(P);
+    LPM->addPass(std::forward<T>(P));
+    if (stats != nullptr) {
+        // Every loop pass gets its own loop pass manager to have separate statistics.
+        LPMStatsIndex = stats->addPhase(number, passName);
+        commitLoopPassManager();
+    }
+    addDumpPass(passName);
+}
+
+void DebugModulePassManager::run() {
+    commitFunctionPassManager();
+    MPM.run(M, MAM);
 }
 ///////////////////////////////////////////////////////////////////////////
 
+void ispc::PrintReport(const std::string &file, const char *what,
+                       llvm::function_ref<void(llvm::raw_ostream &)> print) {
+    if (file.empty()) {
+        print(llvm::errs());
+        return;
+    }
+    std::error_code EC;
+    llvm::raw_fd_ostream os(file, EC, llvm::sys::fs::OF_Append | llvm::sys::fs::OF_Text);
+    if (EC) {
+        Error(SourcePos(), "Cannot open file \"%s\" for %s: %s.", file.c_str(), what, EC.message().c_str());
+        return;
+    }
+    // Print the report with a single write, files may be shared between several compilations.
+    std::string buffer;
+    llvm::raw_string_ostream bufferStream(buffer);
+    print(bufferStream);
+    os << bufferStream.str();
+}
+
 void ispc::Optimize(llvm::Module *module, int optLevel) {
     if (g->debugPrint) {
         printf("*** Code going into optimization ***\n");
         module->print(llvm::errs(), nullptr);
     }
-    DebugPassManager optPM;
+    // Target machine provides TargetTransformInfo, Xe targets use the default one.
+    llvm::TargetMachine *targetMachine = g->target->isXeTarget() ? nullptr : g->target->GetTargetMachine();
+    PassStatsCollector stats;
+    DebugModulePassManager optPM(*module, targetMachine, g->printPassStats ? &stats : nullptr);
 
     if (g->enableLLVMIntrinsics) {
         // Required for matrix intrinsics. This needs to happen before VerifierPass.
         // TODO : Limit pass to only when llvm.matrix.* intrinsics are used.
-        optPM.add(llvm::createLowerMatrixIntrinsicsPass()); // llvm.matrix
+        optPM.addFunctionPass(llvm::LowerMatrixIntrinsicsPass()); // llvm.matrix
     }
-    optPM.add(llvm::createVerifierPass(), 0);
+    optPM.addModulePass(llvm::VerifierPass(), 0);
 
-    optPM.add(new llvm::TargetLibraryInfoWrapperPass(llvm::Triple(module->getTargetTriple())));
-    if (!g->target->isXeTarget()) {
-        llvm::TargetMachine *targetMachine = g->target->GetTargetMachine();
-        optPM.getPM().add(createTargetTransformInfoWrapperPass(targetMachine->getTargetIRAnalysis()));
-    }
-    optPM.add(llvm::createIndVarSimplifyPass());
+    optPM.addLoopPass(llvm::IndVarSimplifyPass());
 
     llvm::SimplifyCFGOptions simplifyCFGopt;
     simplifyCFGopt.HoistCommonInsts = true;
@@ -164,223 +411,231 @@ void ispc::Optimize(llvm::Module *module, int optLevel) {
         // mem2reg affects several acos/asin tests with O0 on Gen9,
         // seems like a problem with VC BE.
         if (g->target->isXeTarget()) {
-            optPM.add(llvm::createPromoteMemoryToRegisterPass());
+            optPM.addFunctionPass(llvm::PromotePass());
         }
 #endif
-        optPM.add(CreateImproveMemoryOpsPass(), 100);
+        optPM.addFunctionPass(ImproveMemoryOpsPass(), 100);
 
         if (g->opt.disableHandlePseudoMemoryOps == false)
-            optPM.add(CreateReplacePseudoMemoryOpsPass());
-
-        optPM.add(CreateIntrinsicsOptPass(), 102);
-        optPM.add(CreateIsCompileTimeConstantPass(true));
-        optPM.add(llvm::createFunctionInliningPass());
-        optPM.add(CreateMakeInternalFuncsStaticPass());
-        optPM.add(llvm::createCFGSimplificationPass(simplifyCFGopt));
-        optPM.add(llvm::createGlobalDCEPass());
+            optPM.addFunctionPass(ReplacePseudoMemoryOpsPass());
+
+        optPM.addFunctionPass(IntrinsicsOpt(), 102);
+        optPM.addFunctionPass(IsCompileTimeConstantPass(true));
+        optPM.addModulePass(llvm::ModuleInlinerWrapperPass());
+        optPM.addModulePass(MakeInternalFuncsStaticPass());
+        optPM.addFunctionPass(llvm::SimplifyCFGPass(simplifyCFGopt));
+        optPM.addModulePass(llvm::GlobalDCEPass());
 #ifdef ISPC_XE_ENABLED
         if (g->target->isXeTarget()) {
-            optPM.add(llvm::createPromoteMemoryToRegisterPass());
+            optPM.addFunctionPass(llvm::PromotePass());
             // This pass is needed for correct prints work
-            optPM.add(llvm::createSROAPass());
-            optPM.add(CreateReplaceLLVMIntrinsics());
-            optPM.add(CreateCheckIRForXeTarget());
-            optPM.add(CreateMangleOpenCLBuiltins());
+            optPM.addFunctionPass(lCreateSROAPass());
+            optPM.addFunctionPass(ReplaceLLVMIntrinsics());
+            optPM.addFunctionPass(CheckIRForXeTarget());
+            optPM.addFunctionPass(MangleOpenCLBuiltins());
             // This pass is required to prepare LLVM IR for open source SPIR-V translator
-            optPM.add(
-                llvm::createGenXSPIRVWriterAdaptorPass(true /*RewriteTypes*/, false /*RewriteSingleElementVectors*/));
-            optPM.add(llvm::createGlobalDCEPass());
+            optPM.addModulePass(LegacyModulePassWrapper(
+                llvm::createGenXSPIRVWriterAdaptorPass(true /*RewriteTypes*/, false /*RewriteSingleElementVectors*/)));
+            optPM.addModulePass(llvm::GlobalDCEPass());
         }
 #endif
     } else {
-        llvm::PassRegistry *registry = llvm::PassRegistry::getPassRegistry();
-        llvm::initializeCore(*registry);
-        llvm::initializeScalarOpts(*registry);
-        llvm::initializeIPO(*registry);
-        llvm::initializeAnalysis(*registry);
-        llvm::initializeTransformUtils(*registry);
-        llvm::initializeInstCombine(*registry);
-        llvm::initializeInstrumentation(*registry);
-        llvm::initializeTarget(*registry);
-
-        optPM.add(llvm::createGlobalDCEPass(), 184);
-
-        // Setup to use LLVM default AliasAnalysis
-        // Ideally, we want call:
-        //    llvm::PassManagerBuilder pm_Builder;
-        //    pm_Builder.OptLevel = optLevel;
-        //    pm_Builder.addInitialAliasAnalysisPasses(optPM);
-        // but the addInitialAliasAnalysisPasses() is a private function
-        // so we explicitly enable them here.
-        // Need to keep sync with future LLVM change
-        // An alternative is to call populateFunctionPassManager()
-        optPM.add(llvm::createTypeBasedAAWrapperPass(), 190);
-        optPM.add(llvm::createBasicAAWrapperPass());
-        optPM.add(llvm::createCFGSimplificationPass(simplifyCFGopt));
-
-        optPM.add(llvm::createSROAPass());
-
-        optPM.add(llvm::createEarlyCSEPass());
-        optPM.add(llvm::createLowerExpectIntrinsicPass());
+        optPM.addModulePass(llvm::GlobalDCEPass(), 184);
+
+        // Alias analyses (TypeBasedAA and BasicAA) are registered in the
+        // function analysis manager of DebugModulePassManager.
+        optPM.addFunctionPass(llvm::SimplifyCFGPass(simplifyCFGopt), 190);
+
+        optPM.addFunctionPass(lCreateSROAPass());
+
+        optPM.addFunctionPass(llvm::EarlyCSEPass());
+        optPM.addFunctionPass(llvm::LowerExpectIntrinsicPass());
 
         // Early optimizations to try to reduce the total amount of code to
         // work with if we can
-        optPM.add(llvm::createReassociatePass(), 200);
-        optPM.add(llvm::createInstSimplifyLegacyPass());
-        optPM.add(llvm::createDeadCodeEliminationPass());
-        optPM.add(llvm::createCFGSimplificationPass(simplifyCFGopt));
+        optPM.addFunctionPass(llvm::ReassociatePass(), 200);
+        optPM.addFunctionPass(llvm::InstSimplifyPass());
+        optPM.addFunctionPass(llvm::DCEPass());
+        optPM.addFunctionPass(llvm::SimplifyCFGPass(simplifyCFGopt));
 
-        optPM.add(llvm::createPromoteMemoryToRegisterPass());
-        optPM.add(llvm::createAggressiveDCEPass());
+        optPM.addFunctionPass(llvm::PromotePass());
+        optPM.addFunctionPass(llvm::ADCEPass());
 
         if (g->opt.disableGatherScatterOptimizations == false && g->target->getVectorWidth() > 1) {
-            optPM.add(llvm::createInstructionCombiningPass(), 210);
-            optPM.add(CreateImproveMemoryOpsPass());
+            optPM.addFunctionPass(llvm::InstCombinePass(), 210);
+            optPM.addFunctionPass(ImproveMemoryOpsPass());
         }
         if (!g->opt.disableMaskAllOnOptimizations) {
-            optPM.add(CreateIntrinsicsOptPass(), 215);
-            optPM.add(CreateInstructionSimplifyPass());
+            optPM.addFunctionPass(IntrinsicsOpt(), 215);
+            optPM.addFunctionPass(InstructionSimplifyPass());
         }
-        optPM.add(llvm::createDeadCodeEliminationPass(), 220);
+        optPM.addFunctionPass(llvm::DCEPass(), 220);
 
         // On to more serious optimizations
-        optPM.add(llvm::createSROAPass());
-        optPM.add(llvm::createInstructionCombiningPass());
-        optPM.add(llvm::createCFGSimplificationPass(simplifyCFGopt));
-        optPM.add(llvm::createPromoteMemoryToRegisterPass());
-        optPM.add(llvm::createGlobalOptimizerPass());
-        optPM.add(llvm::createReassociatePass());
-        optPM.add(llvm::createIPSCCPPass());
-
-        optPM.add(CreateReplaceStdlibShiftPass(), 229);
-
-        optPM.add(llvm::createDeadArgEliminationPass(), 230);
-        optPM.add(llvm::createInstructionCombiningPass());
-        optPM.add(llvm::createCFGSimplificationPass(simplifyCFGopt));
-        optPM.add(llvm::createPruneEHPass());
-        optPM.add(llvm::createPostOrderFunctionAttrsLegacyPass());
-        optPM.add(llvm::createReversePostOrderFunctionAttrsPass());
+        optPM.addFunctionPass(lCreateSROAPass());
+        optPM.addFunctionPass(llvm::InstCombinePass());
+        optPM.addFunctionPass(llvm::SimplifyCFGPass(simplifyCFGopt));
+        optPM.addFunctionPass(llvm::PromotePass());
+        optPM.addModulePass(llvm::GlobalOptPass());
+        optPM.addFunctionPass(llvm::ReassociatePass());
+        optPM.addModulePass(llvm::IPSCCPPass());
+
+        // Profile-guided optimization: counters are inserted, or execution
+        // counts are attached as branch weights and function entry counts,
+        // on the IR before the main inliner runs.  The CFG at this point
+        // must be the same when generating and using the profile.
+        if (!g->target->isXeTarget()) {
+            if (g->opt.profileGenerate) {
+                optPM.addModulePass(llvm::PGOInstrumentationGen());
+            } else if (!g->opt.profileUseFile.empty()) {
+                optPM.addModulePass(llvm::PGOInstrumentationUse(g->opt.profileUseFile));
+            }
+        }
+
+        // Runs before the stdlib reduce_add() calls are inlined.
+        optPM.addFunctionPass(HoistReductionsPass());
+        optPM.addFunctionPass(ReplaceStdlibShiftPass(), 229);
+
+        optPM.addModulePass(llvm::DeadArgumentEliminationPass(), 230);
+        optPM.addFunctionPass(llvm::InstCombinePass());
+        optPM.addFunctionPass(llvm::SimplifyCFGPass(simplifyCFGopt));
+        // There is no PruneEH pass in the new pass manager, nounwind inference
+        // is done by PostOrderFunctionAttrs and dead invokes are cleaned up by SimplifyCFG.
+        optPM.addCGSCCPass(llvm::PostOrderFunctionAttrsPass());
+        optPM.addModulePass(llvm::ReversePostOrderFunctionAttrsPass());
 
         // Next inline pass will remove functions, saved by __keep_funcs_live
-        optPM.add(llvm::createFunctionInliningPass());
-        optPM.add(llvm::createInstSimplifyLegacyPass());
-        optPM.add(llvm::createDeadCodeEliminationPass());
-        optPM.add(llvm::createCFGSimplificationPass(simplifyCFGopt));
-
-#if ISPC_LLVM_VERSION < ISPC_LLVM_15_0
-        // Starting LLVM 15.0 this pass is supported with new pass manager only (217e857)
-        // TODO: switch ISPC to new pass manager: https://github.com/ispc/ispc/issues/2359
-        optPM.add(llvm::createArgumentPromotionPass());
-#endif
+        optPM.addModulePass(llvm::ModuleInlinerWrapperPass());
+        optPM.addFunctionPass(llvm::InstSimplifyPass());
+        optPM.addFunctionPass(llvm::DCEPass());
+        optPM.addFunctionPass(llvm::SimplifyCFGPass(simplifyCFGopt));
+
+        optPM.addCGSCCPass(llvm::ArgumentPromotionPass());
 
-        optPM.add(llvm::createAggressiveDCEPass());
-        optPM.add(llvm::createInstructionCombiningPass(), 241);
-        optPM.add(llvm::createJumpThreadingPass());
-        optPM.add(llvm::createCFGSimplificationPass(simplifyCFGopt));
+        optPM.addFunctionPass(llvm::ADCEPass());
+        optPM.addFunctionPass(llvm::InstCombinePass(), 241);
+        optPM.addFunctionPass(llvm::JumpThreadingPass());
+        optPM.addFunctionPass(llvm::SimplifyCFGPass(simplifyCFGopt));
 
-        optPM.add(llvm::createSROAPass());
+        optPM.addFunctionPass(lCreateSROAPass());
 
-        optPM.add(llvm::createInstructionCombiningPass());
+        optPM.addFunctionPass(llvm::InstCombinePass());
 #ifdef ISPC_XE_ENABLED
         if (g->target->isXeTarget()) {
             // Inline
-            optPM.add(llvm::createCorrelatedValuePropagationPass());
-            optPM.add(llvm::createInstructionCombiningPass());
-            optPM.add(llvm::createGlobalDCEPass());
-            optPM.add(llvm::createInstructionCombiningPass());
-            optPM.add(llvm::createEarlyCSEPass());
-            optPM.add(llvm::createDeadCodeEliminationPass());
+            optPM.addFunctionPass(llvm::CorrelatedValuePropagationPass());
+            optPM.addFunctionPass(llvm::InstCombinePass());
+            optPM.addModulePass(llvm::GlobalDCEPass());
+            optPM.addFunctionPass(llvm::InstCombinePass());
+            optPM.addFunctionPass(llvm::EarlyCSEPass());
+            optPM.addFunctionPass(llvm::DCEPass());
         }
 #endif
-        optPM.add(llvm::createTailCallEliminationPass());
+        optPM.addFunctionPass(llvm::TailCallElimPass());
 
         if (!g->opt.disableMaskAllOnOptimizations) {
-            optPM.add(CreateIntrinsicsOptPass(), 250);
-            optPM.add(CreateInstructionSimplifyPass());
+            optPM.addFunctionPass(IntrinsicsOpt(), 250);
+            optPM.addFunctionPass(InstructionSimplifyPass());
         }
 
         if (g->opt.disableGatherScatterOptimizations == false && g->target->getVectorWidth() > 1) {
-            optPM.add(llvm::createInstructionCombiningPass(), 255);
-            optPM.add(CreateImproveMemoryOpsPass());
+            optPM.addFunctionPass(llvm::InstCombinePass(), 255);
+            optPM.addFunctionPass(ImproveMemoryOpsPass());
 
             if (g->opt.disableCoalescing == false) {
                 // It is important to run this here to make it easier to
                 // finding matching gathers we can coalesce..
-                optPM.add(llvm::createEarlyCSEPass(), 260);
-                optPM.add(CreateGatherCoalescePass());
+                optPM.addFunctionPass(llvm::EarlyCSEPass(), 260);
+                optPM.addFunctionPass(GatherCoalescePass());
+                optPM.addFunctionPass(ScatterCoalescePass());
             }
         }
 
-        optPM.add(llvm::createFunctionInliningPass(), 265);
-        optPM.add(llvm::createInstSimplifyLegacyPass());
-        optPM.add(CreateIntrinsicsOptPass());
-        optPM.add(CreateInstructionSimplifyPass());
+        optPM.addModulePass(llvm::ModuleInlinerWrapperPass(), 265);
+        optPM.addFunctionPass(llvm::InstSimplifyPass());
+        optPM.addFunctionPass(IntrinsicsOpt());
+        optPM.addFunctionPass(InstructionSimplifyPass());
+
+        // Prefetch insertion needs the gathers still in their factored
+        // form, which exposes the uniform part of their addresses.
+        if (g->opt.autoPrefetchDistance > 0 && !g->target->isXeTarget()) {
+            optPM.addFunctionPass(AutoPrefetchPass(g->opt.autoPrefetchDistance));
+        }
 
         if (g->opt.disableGatherScatterOptimizations == false && g->target->getVectorWidth() > 1) {
-            optPM.add(llvm::createInstructionCombiningPass(), 270);
-            optPM.add(CreateImproveMemoryOpsPass());
+            optPM.addFunctionPass(llvm::InstCombinePass(), 270);
+            optPM.addFunctionPass(ImproveMemoryOpsPass());
         }
 
-        optPM.add(llvm::createIPSCCPPass(), 275);
-        optPM.add(llvm::createDeadArgEliminationPass());
-        optPM.add(llvm::createAggressiveDCEPass());
-        optPM.add(llvm::createInstructionCombiningPass());
-        optPM.add(llvm::createCFGSimplificationPass(simplifyCFGopt));
+        optPM.addModulePass(llvm::IPSCCPPass(), 275);
+        optPM.addModulePass(llvm::DeadArgumentEliminationPass());
+        optPM.addFunctionPass(llvm::ADCEPass());
+        optPM.addFunctionPass(llvm::InstCombinePass());
+        optPM.addFunctionPass(llvm::SimplifyCFGPass(simplifyCFGopt));
 
-        if (g->opt.disableHandlePseudoMemoryOps == false) {
-            optPM.add(CreateReplacePseudoMemoryOpsPass(), 280);
+#ifdef ISPC_XE_ENABLED
+        // The tile accesses are recognized in the offsets of the gathers and
+        // scatters, before they are lowered to the per-lane accesses.
+        if (g->target->isXeTarget() && g->target->hasXeBlock2D() && !g->opt.disableXeBlock2D &&
+            g->opt.disableGatherScatterOptimizations == false && g->target->getVectorWidth() > 1) {
+            optPM.addFunctionPass(XeBlock2DMemoryOps());
         }
-        optPM.add(CreateIntrinsicsOptPass(), 281);
-        optPM.add(CreateInstructionSimplifyPass());
-
-        optPM.add(llvm::createFunctionInliningPass());
-#if ISPC_LLVM_VERSION < ISPC_LLVM_15_0
-        // Starting LLVM 15.0 this pass is supported with new pass manager only (217e857)
-        // TODO: switch ISPC to new pass manager: https://github.com/ispc/ispc/issues/2359
-        optPM.add(llvm::createArgumentPromotionPass());
 #endif
 
-        optPM.add(llvm::createSROAPass());
-
-        optPM.add(llvm::createInstructionCombiningPass());
-        optPM.add(CreateInstructionSimplifyPass());
-        optPM.add(llvm::createCFGSimplificationPass(simplifyCFGopt));
-        optPM.add(llvm::createReassociatePass());
-        optPM.add(llvm::createLoopRotatePass());
-        optPM.add(llvm::createLICMPass());
-        // Loop unswitch pass was removed in LLVM 15.0 (fb4113).
-        // Recommended replacement: createSimpleLoopUnswitchLegacyPass
-#if ISPC_LLVM_VERSION < ISPC_LLVM_15_0
-        optPM.add(llvm::createLoopUnswitchPass(false));
-#else
-        optPM.add(llvm::createSimpleLoopUnswitchLegacyPass(false));
-#endif
-        optPM.add(llvm::createInstructionCombiningPass());
-        optPM.add(CreateInstructionSimplifyPass());
-        optPM.add(llvm::createIndVarSimplifyPass());
+        if (g->opt.disableHandlePseudoMemoryOps == false) {
+            optPM.addFunctionPass(ReplacePseudoMemoryOpsPass(), 280);
+        }
+        optPM.addFunctionPass(IntrinsicsOpt(), 281);
+        optPM.addFunctionPass(InstructionSimplifyPass());
+
+        optPM.addModulePass(llvm::ModuleInlinerWrapperPass());
+        optPM.addCGSCCPass(llvm::ArgumentPromotionPass());
+
+        optPM.addFunctionPass(lCreateSROAPass());
+
+        optPM.addFunctionPass(llvm::InstCombinePass());
+        optPM.addFunctionPass(InstructionSimplifyPass());
+        optPM.addFunctionPass(llvm::SimplifyCFGPass(simplifyCFGopt));
+        optPM.addFunctionPass(llvm::ReassociatePass());
+        // LoopRotate, LICM and SimpleLoopUnswitch share one loop pass manager with MemorySSA.
+        optPM.addLoopPass(llvm::LoopRotatePass(), -1, true);
+        optPM.addLoopPass(llvm::LICMPass(), -1, true);
+        optPM.addLoopPass(llvm::SimpleLoopUnswitchPass(false), -1, true);
+        optPM.addFunctionPass(llvm::InstCombinePass());
+        optPM.addFunctionPass(InstructionSimplifyPass());
+        optPM.addLoopPass(llvm::IndVarSimplifyPass());
         // Currently CM does not support memset/memcpy
         // so this pass is temporary disabled for Xe.
         if (!g->target->isXeTarget()) {
-            optPM.add(llvm::createLoopIdiomPass());
+            optPM.addLoopPass(llvm::LoopIdiomRecognizePass());
+        }
+        optPM.addLoopPass(llvm::LoopDeletionPass());
+        if (!g->target->isXeTarget()) {
+            optPM.addFunctionPass(LoopInvariantDivisionPass());
+        }
+        if (g->opt.loopVersioning && !g->target->isXeTarget()) {
+            optPM.addFunctionPass(LoopVersioningPass(g->target->getNativeVectorAlignment()));
         }
-        optPM.add(llvm::createLoopDeletionPass());
         if (g->opt.unrollLoops) {
-            optPM.add(llvm::createLoopUnrollPass(), 300);
+            optPM.addFunctionPass(llvm::LoopUnrollPass(), 300);
         }
-        optPM.add(llvm::createGVNPass(), 301);
+        optPM.addFunctionPass(GVNPass(), 301);
 
-        optPM.add(CreateIsCompileTimeConstantPass(true));
-        optPM.add(CreateIntrinsicsOptPass());
-        optPM.add(CreateInstructionSimplifyPass());
+        optPM.addFunctionPass(IsCompileTimeConstantPass(true));
+        optPM.addFunctionPass(IntrinsicsOpt());
+        optPM.addFunctionPass(InstructionSimplifyPass());
+        // All of the memory operations are regular loads and stores by now, raise their
+        // alignment to the one given by assume_aligned().
+        optPM.addFunctionPass(llvm::AlignmentFromAssumptionsPass());
 
 #ifdef ISPC_XE_ENABLED
         if (g->target->isXeTarget() && g->opt.disableGatherScatterOptimizations == false &&
             g->target->getVectorWidth() > 1) {
             if (!g->opt.disableXeGatherCoalescing) {
-                optPM.add(CreateXeGatherCoalescingPass(), 321);
+                optPM.addFunctionPass(XeGatherCoalescing(), 321);
 
                 // Try the llvm provided load/store vectorizer
-                optPM.add(llvm::createLoadStoreVectorizerPass(), 325);
+                optPM.addFunctionPass(llvm::LoadStoreVectorizerPass(), 325);
             }
         }
 #endif
@@ -388,48 +643,88 @@ void ispc::Optimize(llvm::Module *module, int optLevel) {
         // Currently CM does not support memset/memcpy
         // so this pass is temporary disabled for Xe.
         if (!g->target->isXeTarget()) {
-            optPM.add(llvm::createMemCpyOptPass());
+            optPM.addFunctionPass(llvm::MemCpyOptPass());
         }
-        optPM.add(llvm::createSCCPPass());
-        optPM.add(llvm::createInstructionCombiningPass());
-        optPM.add(CreateInstructionSimplifyPass());
-        optPM.add(llvm::createJumpThreadingPass());
-        optPM.add(llvm::createCorrelatedValuePropagationPass());
-        optPM.add(llvm::createDeadStoreEliminationPass());
-        optPM.add(llvm::createAggressiveDCEPass());
-        optPM.add(llvm::createCFGSimplificationPass(simplifyCFGopt));
-        optPM.add(llvm::createInstructionCombiningPass());
-        optPM.add(CreateInstructionSimplifyPass());
+        optPM.addFunctionPass(llvm::SCCPPass());
+        optPM.addFunctionPass(llvm::InstCombinePass());
+        optPM.addFunctionPass(InstructionSimplifyPass());
+        optPM.addFunctionPass(llvm::JumpThreadingPass());
+        optPM.addFunctionPass(llvm::CorrelatedValuePropagationPass());
+        optPM.addFunctionPass(llvm::DSEPass());
+        optPM.addFunctionPass(llvm::ADCEPass());
+        optPM.addFunctionPass(llvm::SimplifyCFGPass(simplifyCFGopt));
+        optPM.addFunctionPass(llvm::InstCombinePass());
+        optPM.addFunctionPass(InstructionSimplifyPass());
 #ifdef ISPC_XE_ENABLED
         if (g->target->isXeTarget()) {
-            optPM.add(CreateReplaceLLVMIntrinsics());
+            optPM.addFunctionPass(ReplaceLLVMIntrinsics());
         }
 #endif
-        optPM.add(CreatePeepholePass());
-        optPM.add(llvm::createFunctionInliningPass());
-        optPM.add(llvm::createAggressiveDCEPass());
-        optPM.add(llvm::createStripDeadPrototypesPass());
-        optPM.add(CreateMakeInternalFuncsStaticPass());
-        optPM.add(llvm::createGlobalDCEPass());
-        optPM.add(llvm::createConstantMergePass());
+        optPM.addFunctionPass(PeepholePass());
+        optPM.addModulePass(llvm::ModuleInlinerWrapperPass());
+        optPM.addFunctionPass(llvm::ADCEPass());
+        optPM.addModulePass(llvm::StripDeadPrototypesPass());
+        optPM.addModulePass(MakeInternalFuncsStaticPass());
+        optPM.addModulePass(llvm::GlobalDCEPass());
+        optPM.addModulePass(llvm::ConstantMergePass());
+        if (g->opt.profileGenerate && !g->target->isXeTarget()) {
+            // Lower the counter increments inserted by PGOInstrumentationGen
+            // to updates of the counter globals used by the profiling runtime.
+            llvm::InstrProfOptions profOptions;
+            profOptions.InstrProfileOutput = g->opt.profileGenerateFile;
+            optPM.addModulePass(llvm::InstrProfiling(profOptions));
+        }
 #ifdef ISPC_XE_ENABLED
         if (g->target->isXeTarget()) {
-            optPM.add(CreateCheckIRForXeTarget());
-            optPM.add(CreateMangleOpenCLBuiltins());
+            optPM.addFunctionPass(CheckIRForXeTarget());
+            optPM.addFunctionPass(MangleOpenCLBuiltins());
             // This pass is required to prepare LLVM IR for open source SPIR-V translator
-            optPM.add(
-                llvm::createGenXSPIRVWriterAdaptorPass(true /*RewriteTypes*/, false /*RewriteSingleElementVectors*/));
+            optPM.addModulePass(LegacyModulePassWrapper(
+                llvm::createGenXSPIRVWriterAdaptorPass(true /*RewriteTypes*/, false /*RewriteSingleElementVectors*/)));
         }
 #endif
     }
 
     // Finish up by making sure we didn't mess anything up in the IR along
     // the way.
-    optPM.add(llvm::createVerifierPass(), LAST_OPT_NUMBER);
-    optPM.run(*module);
+    optPM.addModulePass(llvm::VerifierPass(), LAST_OPT_NUMBER);
+    optPM.run();
+
+    if (g->printPassStats) {
+        PrintReport(g->passStatsFile, "pass statistics", [&](llvm::raw_ostream &os) { stats.print(os, *module); });
+    }
+    if (g->reportCost) {
+        PrintReport(g->costReportFile, "cost report",
+                     [&](llvm::raw_ostream &os) { PrintCostReport(os, *module, targetMachine); });
+    }
 
     if (g->debugPrint) {
         printf("\n*****\nFINAL OUTPUT\n*****\n");
         module->print(llvm::errs(), nullptr);
     }
 }
+
+void ispc::OptimizeLinked(llvm::Module *module) {
+    // The modules are already optimized for their targets, so this is only the part of the pipeline that
+    // benefits from seeing all of them. The target machine isn't known in link mode.
+    DebugModulePassManager optPM(*module, nullptr, nullptr);
+    optPM.addModulePass(llvm::VerifierPass(), 0);
+    // Only the exported functions and the global variables are called or used by the application, everything
+    // else has an ispc mangled name. Making those local lets them be removed once inlined into all callers.
+    optPM.addModulePass(llvm::InternalizePass(
+        [](const llvm::GlobalValue &GV) { return GV.getName().find("___") == llvm::StringRef::npos; }));
+    optPM.addModulePass(llvm::IPSCCPPass());
+    optPM.addModulePass(llvm::GlobalOptPass());
+    optPM.addModulePass(llvm::ModuleInlinerWrapperPass());
+    optPM.addFunctionPass(lCreateSROAPass());
+    optPM.addFunctionPass(llvm::EarlyCSEPass());
+    // Forward the values stored by a kernel to the loads of the next one in fused kernels.
+    optPM.addFunctionPass(GVNPass());
+    optPM.addFunctionPass(llvm::DSEPass());
+    optPM.addFunctionPass(llvm::InstCombinePass());
+    optPM.addFunctionPass(llvm::SimplifyCFGPass());
+    optPM.addModulePass(llvm::IPSCCPPass());
+    optPM.addModulePass(llvm::GlobalDCEPass());
+    optPM.addModulePass(llvm::VerifierPass(), LAST_OPT_NUMBER);
+    optPM.run();
+}
@@ -39,6 +39,12 @@
 
 #include "ispc.h"
 
+#include <llvm/ADT/STLExtras.h>
+
+namespace llvm {
+class raw_ostream;
+}
+
 namespace ispc {
 
 /** Optimize the functions in the given module, applying the specified
@@ -47,4 +53,14 @@ namespace ispc {
     corresponds to full optimization.
 */
 void Optimize(llvm::Module *module, int optLevel);
+
+/** Optimize the module linked from several ispc modules across them:
+    the functions are inlined into their callers from the other modules,
+    and the ones that aren't exported are removed once they are unused.
+*/
+void OptimizeLinked(llvm::Module *module);
+
+/** Prints a report to stderr or appends it to the given file; "what" names
+    the report in the error issued if the file can't be opened. */
+void PrintReport(const std::string &file, const char *what, llvm::function_ref<void(llvm::raw_ostream &)> print);
 } // namespace ispc
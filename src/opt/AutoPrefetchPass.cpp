@@ -0,0 +1,225 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "AutoPrefetchPass.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include <llvm/Analysis/ScalarEvolutionExpressions.h>
+#include <llvm/Analysis/VectorUtils.h>
+
+namespace ispc {
+
+/** Prefetches are issued at the granularity of this many bytes. */
+static const int64_t lCacheLineSize = 64;
+
+/** An address stream that is already being prefetched in a loop: the
+    address (as an integer SCEV) accessed in the current iteration and the
+    number of bytes it advances by on each iteration. */
+struct PrefetchStream {
+    PrefetchStream(const llvm::SCEV *a, int64_t s) : addr(a), stride(s) {}
+
+    const llvm::SCEV *addr;
+    int64_t stride;
+};
+
+/** If the given SCEV is an affine recurrence of the loop L with a constant
+    step, return that step; otherwise return 0. */
+static int64_t lGetConstantStep(const llvm::SCEV *s, llvm::Loop *L, llvm::ScalarEvolution &SE) {
+    const llvm::SCEVAddRecExpr *addRec = llvm::dyn_cast<llvm::SCEVAddRecExpr>(s);
+    if (addRec == NULL || addRec->getLoop() != L || !addRec->isAffine())
+        return 0;
+
+    const llvm::SCEVConstant *step = llvm::dyn_cast<llvm::SCEVConstant>(addRec->getStepRecurrence(SE));
+    if (step == NULL || step->getAPInt().getBitWidth() > 64)
+        return 0;
+    return step->getAPInt().getSExtValue();
+}
+
+/** Returns true if an access to addr with the given stride falls into a
+    cache line that one of the streams already prefetches. */
+static bool lIsCovered(const std::vector<PrefetchStream> &streams, const llvm::SCEV *addr, int64_t stride,
+                       llvm::ScalarEvolution &SE) {
+    for (const PrefetchStream &stream : streams) {
+        if (stream.stride != stride || stream.addr->getType() != addr->getType())
+            continue;
+        const llvm::SCEVConstant *delta = llvm::dyn_cast<llvm::SCEVConstant>(SE.getMinusSCEV(addr, stream.addr));
+        if (delta != NULL && std::abs(delta->getAPInt().getSExtValue()) < lCacheLineSize)
+            return true;
+    }
+    return false;
+}
+
+/** Emit a read prefetch of ptr + offset bytes before insertBefore. */
+static void lEmitPrefetch(llvm::Value *ptr, int64_t offset, llvm::Instruction *insertBefore) {
+    llvm::Value *addr = new llvm::BitCastInst(ptr, LLVMTypes::VoidPointerType, "prefetch_base", insertBefore);
+    addr = LLVMGEPInst(addr, LLVMTypes::Int8Type, LLVMInt64(offset), "prefetch_addr", insertBefore);
+
+    llvm::Function *prefetchFunc =
+        llvm::Intrinsic::getDeclaration(m->module, llvm::Intrinsic::prefetch, {LLVMTypes::VoidPointerType});
+    // read access, high temporal locality (i.e. into L1), data cache
+    llvm::Value *args[] = {addr, LLVMInt32(0), LLVMInt32(3), LLVMInt32(1)};
+    llvm::CallInst::Create(prefetchFunc, args, "", insertBefore);
+}
+
+/** Returns true if the call is one of the factored gathers that
+    ImproveMemoryOps produces, e.g.
+    __pseudo_gather_factored_base_offsets32_i32(i8 *base, <WIDTH x i32> varyingOffsets,
+                                                i32 scale, <WIDTH x i32> constOffsets, <WIDTH x MASK> mask) */
+static bool lIsFactoredGather(llvm::CallInst *callInst) {
+    llvm::Function *func = callInst->getCalledFunction();
+    return func != NULL && func->getName().startswith("__pseudo_gather_factored_base_offsets");
+}
+
+bool AutoPrefetchPass::prefetchLoop(llvm::Loop *L, llvm::ScalarEvolution &SE) {
+    std::vector<PrefetchStream> streams;
+    bool modifiedAny = false;
+
+    for (llvm::BasicBlock *BB : L->blocks()) {
+        // Note: prefetches are inserted before the instruction being
+        // processed, so the iterator is moved forward first.
+        for (llvm::BasicBlock::iterator iter = BB->begin(), e = BB->end(); iter != e;) {
+            llvm::Instruction *inst = &*(iter++);
+
+            if (llvm::LoadInst *load = llvm::dyn_cast<llvm::LoadInst>(inst)) {
+                llvm::Value *ptr = load->getPointerOperand();
+                if (!load->isSimple() || ptr->getType()->getPointerAddressSpace() != 0)
+                    continue;
+
+                const llvm::SCEV *ptrSCEV = SE.getSCEV(ptr);
+                int64_t stride = lGetConstantStep(ptrSCEV, L, SE);
+                if (stride == 0)
+                    continue;
+
+                llvm::Type *intPtrType = SE.getEffectiveSCEVType(ptr->getType());
+                const llvm::SCEV *addr = SE.getPtrToIntExpr(ptrSCEV, intPtrType);
+                if (llvm::isa<llvm::SCEVCouldNotCompute>(addr) || lIsCovered(streams, addr, stride, SE))
+                    continue;
+
+                streams.push_back(PrefetchStream(addr, stride));
+                lEmitPrefetch(ptr, stride * distance, load);
+                modifiedAny = true;
+                continue;
+            }
+
+            llvm::CallInst *callInst = llvm::dyn_cast<llvm::CallInst>(inst);
+            if (callInst == NULL || !lIsFactoredGather(callInst))
+                continue;
+
+            llvm::Value *base = callInst->getArgOperand(0);
+            llvm::Value *variable = llvm::getSplatValue(callInst->getArgOperand(1));
+            llvm::ConstantInt *scaleValue = llvm::dyn_cast<llvm::ConstantInt>(callInst->getArgOperand(2));
+            int64_t constOffsets[ISPC_MAX_NVEC];
+            int nElts;
+            if (variable == NULL || scaleValue == NULL || base->getType()->getPointerAddressSpace() != 0 ||
+                !LLVMExtractVectorInts(callInst->getArgOperand(3), constOffsets, &nElts))
+                continue;
+
+            // All lanes access base + variable * scale + constOffsets[lane],
+            // where only the uniform variable part changes from one
+            // iteration to the next.
+            int64_t scale = scaleValue->getSExtValue();
+            const llvm::SCEV *variableSCEV = SE.getSCEV(variable);
+            int64_t stride = lGetConstantStep(variableSCEV, L, SE) * scale;
+            if (stride == 0)
+                continue;
+
+            llvm::Type *intPtrType = SE.getEffectiveSCEVType(base->getType());
+            const llvm::SCEV *baseSCEV = SE.getPtrToIntExpr(SE.getSCEV(base), intPtrType);
+            if (llvm::isa<llvm::SCEVCouldNotCompute>(baseSCEV))
+                continue;
+            const llvm::SCEV *laneBase = SE.getAddExpr(
+                baseSCEV, SE.getMulExpr(SE.getTruncateOrSignExtend(variableSCEV, intPtrType),
+                                        SE.getConstant(intPtrType, scale, true /* signed */)));
+
+            // Prefetch one address per distinct cache line touched by
+            // the lanes.
+            std::sort(constOffsets, constOffsets + nElts);
+            llvm::Value *lanePtr = NULL;
+            for (int i = 0; i < nElts; ++i) {
+                const llvm::SCEV *addr =
+                    SE.getAddExpr(laneBase, SE.getConstant(intPtrType, constOffsets[i], true /* signed */));
+                if (lIsCovered(streams, addr, stride, SE))
+                    continue;
+
+                if (lanePtr == NULL) {
+                    llvm::Value *offset = llvm::BinaryOperator::Create(
+                        llvm::Instruction::Mul, variable, llvm::ConstantInt::get(variable->getType(), scale),
+                        "prefetch_offset", callInst);
+                    lanePtr = LLVMGEPInst(base, LLVMTypes::Int8Type, offset, "prefetch_lane_base", callInst);
+                }
+                streams.push_back(PrefetchStream(addr, stride));
+                lEmitPrefetch(lanePtr, constOffsets[i] + stride * distance, callInst);
+                modifiedAny = true;
+            }
+        }
+    }
+
+    if (modifiedAny) {
+        Debug(SourcePos(), "Inserted prefetches for %d address streams in loop %s.", (int)streams.size(),
+              L->getHeader()->getName().str().c_str());
+    }
+    return modifiedAny;
+}
+
+bool AutoPrefetchPass::runOnFunction(llvm::Function &F, llvm::LoopInfo &LI, llvm::ScalarEvolution &SE) {
+    llvm::TimeTraceScope FuncScope("AutoPrefetchPass::runOnFunction", F.getName());
+
+    bool modifiedAny = false;
+    for (llvm::Loop *L : LI.getLoopsInPreorder()) {
+        // Only innermost loops are prefetched; prefetches in outer loops
+        // would only cover the first iterations of the inner ones.
+        if (L->isInnermost())
+            modifiedAny |= prefetchLoop(L, SE);
+    }
+
+    return modifiedAny;
+}
+
+llvm::PreservedAnalyses AutoPrefetchPass::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("AutoPrefetchPass::run", F.getName());
+    llvm::LoopInfo &LI = FAM.getResult<llvm::LoopAnalysis>(F);
+    llvm::ScalarEvolution &SE = FAM.getResult<llvm::ScalarEvolutionAnalysis>(F);
+    bool modifiedAny = runOnFunction(F, LI, SE);
+    if (!modifiedAny) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
+
+} // namespace ispc
@@ -0,0 +1,76 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "ISPCPass.h"
+
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/Analysis/ScalarEvolution.h>
+
+namespace ispc {
+
+// This pass inserts software prefetches for memory accesses in innermost
+// loops (e.g. the body of a foreach loop, or a uniform for loop stepping
+// over programIndex) whose addresses advance by a constant stride on each
+// loop iteration.  Two kinds of accesses are considered:
+//
+//  - Loads (scalar or vector) from a pointer that scalar evolution can
+//    describe as an affine recurrence of the loop.
+//
+//  - Gathers with a uniform variable offset that is an affine recurrence
+//    of the loop; the constant per-lane offsets of the gather give the
+//    cache lines to prefetch for a single iteration.
+//
+// For each such access stream a prefetch of the address the access will
+// use "distance" iterations later is inserted right before the access.
+// Accesses that fall into a cache line that is already prefetched for the
+// same stream are skipped.  Gathers with non-uniform offsets (e.g. the
+// x[col[j]] accesses of a sparse matrix-vector product) aren't prefetched;
+// the index loads feeding them are regular strided loads, though, and are.
+
+class AutoPrefetchPass : public llvm::PassInfoMixin<AutoPrefetchPass> {
+  public:
+    explicit AutoPrefetchPass(int distance) : distance(distance) {}
+
+    static llvm::StringRef name() { return "Auto Prefetch"; }
+    llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+
+  private:
+    bool runOnFunction(llvm::Function &F, llvm::LoopInfo &LI, llvm::ScalarEvolution &SE);
+    bool prefetchLoop(llvm::Loop *L, llvm::ScalarEvolution &SE);
+    // Number of loop iterations ahead to prefetch.
+    int distance;
+};
+
+} // namespace ispc
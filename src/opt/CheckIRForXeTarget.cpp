@@ -37,8 +37,6 @@
 
 namespace ispc {
 
-char CheckIRForXeTarget::ID = 0;
-
 bool CheckIRForXeTarget::checkAndFixIRForXe(llvm::BasicBlock &bb) {
     DEBUG_START_BB("CheckIRForXeTarget");
     bool modifiedAny = false;
@@ -106,7 +104,18 @@ bool CheckIRForXeTarget::runOnFunction(llvm::Function &F) {
     return modifiedAny;
 }
 
-llvm::Pass *CreateCheckIRForXeTarget() { return new CheckIRForXeTarget(); }
+llvm::PreservedAnalyses CheckIRForXeTarget::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("CheckIRForXeTarget::run", F.getName());
+    bool modifiedAny = runOnFunction(F);
+    if (!modifiedAny) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
 
 } // namespace ispc
 
@@ -0,0 +1,180 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CostReport.h"
+
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Target/TargetMachine.h>
+
+namespace ispc {
+
+namespace {
+
+enum class CostKind { Other, Gather, Scatter, MaskedLoad, MaskedStore, Blend };
+
+// Memory operations are recognized both as generic LLVM intrinsics, as target
+// intrinsics and as calls to the builtins of the targets that are not inlined.
+CostKind lGetCostKind(const llvm::Instruction &I) {
+    if (I.getOpcode() == llvm::Instruction::Select) {
+        return I.getType()->isVectorTy() ? CostKind::Blend : CostKind::Other;
+    }
+    const llvm::CallInst *CI = llvm::dyn_cast<llvm::CallInst>(&I);
+    if (CI == nullptr || CI->getCalledFunction() == nullptr) {
+        return CostKind::Other;
+    }
+    llvm::StringRef callee = CI->getCalledFunction()->getName();
+    if (callee.startswith("llvm.masked.gather") || callee.startswith("__gather") ||
+        (callee.startswith("llvm.x86.") && callee.contains("gather"))) {
+        return CostKind::Gather;
+    }
+    if (callee.startswith("llvm.masked.scatter") || callee.startswith("__scatter") ||
+        (callee.startswith("llvm.x86.") && callee.contains("scatter"))) {
+        return CostKind::Scatter;
+    }
+    if (callee.startswith("llvm.masked.load") || callee.startswith("__masked_load") ||
+        (callee.startswith("llvm.x86.") && callee.contains("maskload"))) {
+        return CostKind::MaskedLoad;
+    }
+    if (callee.startswith("llvm.masked.store") || callee.startswith("__masked_store") ||
+        (callee.startswith("llvm.x86.") && callee.contains("maskstore"))) {
+        return CostKind::MaskedStore;
+    }
+    if (callee.startswith("llvm.x86.") && callee.contains("blendv")) {
+        return CostKind::Blend;
+    }
+    return CostKind::Other;
+}
+
+void lAttributes(llvm::json::OStream &J, const CodeCost &cost) {
+    J.attribute("instructions", static_cast<int64_t>(cost.instructions));
+    J.attribute("cycles", static_cast<int64_t>(cost.cycles));
+    J.attribute("gathers", static_cast<int64_t>(cost.gathers));
+    J.attribute("scatters", static_cast<int64_t>(cost.scatters));
+    J.attribute("masked_loads", static_cast<int64_t>(cost.maskedLoads));
+    J.attribute("masked_stores", static_cast<int64_t>(cost.maskedStores));
+    J.attribute("blends", static_cast<int64_t>(cost.blends));
+}
+
+void lPrintLoop(llvm::json::OStream &J, const llvm::Loop &L, const llvm::LoopInfo &LI,
+                const llvm::TargetTransformInfo &TTI) {
+    CodeCost cost;
+    for (const llvm::BasicBlock *BB : L.blocks()) {
+        // Blocks of inner loops are reported with them.
+        if (LI.getLoopFor(BB) != &L) {
+            continue;
+        }
+        for (const llvm::Instruction &I : *BB) {
+            cost.add(I, TTI);
+        }
+    }
+    J.object([&] {
+        J.attribute("depth", L.getLoopDepth());
+        llvm::DebugLoc loc = L.getStartLoc();
+        if (loc) {
+            J.attribute("line", loc.getLine());
+        }
+        lAttributes(J, cost);
+    });
+    for (const llvm::Loop *subLoop : L) {
+        lPrintLoop(J, *subLoop, LI, TTI);
+    }
+}
+
+} // namespace
+
+void CodeCost::add(const llvm::Instruction &I, const llvm::TargetTransformInfo &TTI) {
+    instructions++;
+    llvm::InstructionCost cost = TTI.getInstructionCost(&I, llvm::TargetTransformInfo::TCK_RecipThroughput);
+    if (cost.isValid()) {
+        cycles += *cost.getValue();
+    }
+    switch (lGetCostKind(I)) {
+    case CostKind::Gather:
+        gathers++;
+        break;
+    case CostKind::Scatter:
+        scatters++;
+        break;
+    case CostKind::MaskedLoad:
+        maskedLoads++;
+        break;
+    case CostKind::MaskedStore:
+        maskedStores++;
+        break;
+    case CostKind::Blend:
+        blends++;
+        break;
+    case CostKind::Other:
+        break;
+    }
+}
+
+void PrintCostReport(llvm::raw_ostream &os, llvm::Module &M, llvm::TargetMachine *TM) {
+    llvm::json::OStream J(os);
+    J.object([&] {
+        J.attribute("module", M.getSourceFileName());
+        J.attribute("target", ISPCTargetToString(g->target->getISPCTarget()));
+        J.attributeArray("functions", [&] {
+            for (llvm::Function &F : M) {
+                if (F.isDeclaration()) {
+                    continue;
+                }
+                // Xe targets have no target machine here, the default cost model is used for them then.
+                llvm::TargetTransformInfo TTI =
+                    TM ? TM->getTargetTransformInfo(F) : llvm::TargetTransformInfo(M.getDataLayout());
+                llvm::DominatorTree DT(F);
+                llvm::LoopInfo LI(DT);
+                CodeCost cost;
+                for (const llvm::BasicBlock &BB : F) {
+                    for (const llvm::Instruction &I : BB) {
+                        cost.add(I, TTI);
+                    }
+                }
+                J.object([&] {
+                    J.attribute("function", F.getName());
+                    lAttributes(J, cost);
+                    J.attributeArray("loops", [&] {
+                        for (const llvm::Loop *L : LI) {
+                            lPrintLoop(J, *L, LI, TTI);
+                        }
+                    });
+                });
+            }
+        });
+    });
+    os << "\n";
+}
+
+} // namespace ispc
@@ -0,0 +1,71 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/** @file CostReport.h
+    @brief Static estimate of the cost of loops of the optimized code (--report-cost).
+*/
+
+#pragma once
+
+#include "ISPCPass.h"
+
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/Analysis/TargetTransformInfo.h>
+
+namespace ispc {
+
+/** Counts of the instructions of a piece of code that are expensive in
+    SIMD code, and the sum of their reciprocal throughput estimated by
+    TargetTransformInfo, i.e. the number of cycles it takes to issue them
+    when they are executed once each.
+ */
+struct CodeCost {
+    uint64_t instructions{0};
+    uint64_t cycles{0};
+    uint64_t gathers{0};
+    uint64_t scatters{0};
+    uint64_t maskedLoads{0};
+    uint64_t maskedStores{0};
+    uint64_t blends{0};
+
+    void add(const llvm::Instruction &I, const llvm::TargetTransformInfo &TTI);
+};
+
+/** Prints the estimated cost of every function of the module and of each
+    of its loops as a single line JSON object. The cycles of a loop are the
+    cost of one iteration of its body excluding inner loops, counting all
+    of the blocks of the body, i.e. all of the paths through it.
+ */
+void PrintCostReport(llvm::raw_ostream &os, llvm::Module &M, llvm::TargetMachine *TM);
+
+} // namespace ispc
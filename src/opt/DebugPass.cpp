@@ -35,19 +35,13 @@
 
 namespace ispc {
 
-char DebugPass::ID = 0;
-
-bool DebugPass::runOnModule(llvm::Module &module) {
+llvm::PreservedAnalyses DebugPass::run(llvm::Module &module, llvm::ModuleAnalysisManager &MAM) {
     fprintf(stderr, "%s", str_output);
     fflush(stderr);
     module.print(llvm::errs(), nullptr);
-    return true;
+    return llvm::PreservedAnalyses::all();
 }
 
-llvm::Pass *CreateDebugPass(char *output) { return new DebugPass(output); }
-
-char DebugPassFile::ID = 0;
-
 /**
  * Strips all non-alphanumeric characters from given string.
  */
@@ -58,9 +52,9 @@ static std::string lSanitize(std::string in) {
     return in;
 }
 
-void DebugPassFile::run(llvm::Module &module, bool init) {
+void DebugPassFile::dump(llvm::Module &module, bool init) {
     std::ostringstream oss;
-    oss << (init ? "init_" : "ir_") << pnum << "_" << lSanitize(std::string{pname}) << ".ll";
+    oss << (init ? "init_" : "ir_") << pnum << "_" << lSanitize(pname) << ".ll";
 
     const std::string pathFile{oss.str()};
 
@@ -85,18 +79,11 @@ void DebugPassFile::run(llvm::Module &module, bool init) {
     module.print(OS, 0);
 }
 
-bool DebugPassFile::runOnModule(llvm::Module &module) {
-    run(module, false);
-    return true;
+llvm::PreservedAnalyses DebugPassFile::run(llvm::Module &module, llvm::ModuleAnalysisManager &MAM) {
+    dump(module, false);
+    return llvm::PreservedAnalyses::all();
 }
 
-bool DebugPassFile::doInitialization(llvm::Module &module) {
-    run(module, true);
-    return true;
-}
-
-llvm::Pass *CreateDebugPassFile(int number, llvm::StringRef name, std::string dir) {
-    return new DebugPassFile(number, name, dir);
-}
+void DebugPassFile::runInitialization(llvm::Module &module) { dump(module, true); }
 
 } // namespace ispc
@@ -32,11 +32,10 @@
 */
 
 #include "GatherCoalescePass.h"
+#include "OptRemarks.h"
 
 namespace ispc {
 
-char GatherCoalescePass::ID = 0;
-
 /** Representation of a memory load that the gather coalescing code has
     decided to generate.
  */
@@ -58,8 +57,8 @@ struct CoalescedLoadOp {
     /** Value loaded from memory for this load op */
     llvm::Value *load;
 
-    /** For 2-wide loads (i.e. 64-bit loads), these store the lower and
-        upper 32 bits of the result, respectively. */
+    /** For 2-wide loads, these store the lower and upper elements of the
+        result, respectively. */
     llvm::Value *element0, *element1;
 };
 
@@ -161,9 +160,10 @@ static bool lVectorLoadIsEfficient(std::set<int64_t>::iterator iter, std::set<in
     loaded into memory, determine a reasonable set of load operations that
     gets all of the corresponding values in memory (ideally, including as
     many as possible wider vector loads rather than scalar loads).  Return
-    a CoalescedLoadOp for each one in the *loads array.
+    a CoalescedLoadOp for each one in the *loads array.  No load wider
+    than maxWidth elements is generated.
  */
-static void lSelectLoads(const std::vector<int64_t> &loadOffsets, std::vector<CoalescedLoadOp> *loads) {
+static void lSelectLoads(const std::vector<int64_t> &loadOffsets, int maxWidth, std::vector<CoalescedLoadOp> *loads) {
     // First, get a sorted set of unique offsets to load from.
     std::set<int64_t> allOffsets;
     for (unsigned int i = 0; i < loadOffsets.size(); ++i)
@@ -180,22 +180,20 @@ static void lSelectLoads(const std::vector<int64_t> &loadOffsets, std::vector<Co
     // will cover loads at subsequent offsets as well.
     iter = allOffsets.begin();
     while (iter != allOffsets.end()) {
-        // Consider vector loads of width of each of the elements of
-        // spanSizes[], in order.
-        int vectorWidths[] = {8, 4, 2};
-        int nVectorWidths = sizeof(vectorWidths) / sizeof(vectorWidths[0]);
+        // Consider vector loads of each power-of-two width from maxWidth
+        // down to 2, in order.
         bool gotOne = false;
-        for (int i = 0; i < nVectorWidths; ++i) {
-            // See if a load of vector with width vectorWidths[i] would be
+        for (int vectorWidth = maxWidth; vectorWidth >= 2; vectorWidth /= 2) {
+            // See if a load of vector with width vectorWidth would be
             // effective (i.e. would cover a reasonable number of the
             // offsets that need to be loaded from).
             std::set<int64_t>::iterator newIter;
-            if (lVectorLoadIsEfficient(iter, allOffsets.end(), &newIter, vectorWidths[i])) {
+            if (lVectorLoadIsEfficient(iter, allOffsets.end(), &newIter, vectorWidth)) {
                 // Yes: create the corresponding coalesced load and update
                 // the iterator to the returned iterator; doing so skips
                 // over the additional offsets that are taken care of by
                 // this load.
-                loads->push_back(CoalescedLoadOp(*iter, vectorWidths[i]));
+                loads->push_back(CoalescedLoadOp(*iter, vectorWidth));
                 iter = newIter;
                 gotOne = true;
                 break;
@@ -293,81 +291,84 @@ static llvm::Value *lGEPAndLoad(llvm::Value *basePtr, llvm::Type *baseType, int6
 
 /* Having decided that we're doing to emit a series of loads, as encoded in
    the loadOps array, this function emits the corresponding load
-   instructions.
+   instructions.  eltType is the integer type of the individual elements
+   being gathered.
  */
 static void lEmitLoads(llvm::Value *basePtr, llvm::Type *baseType, std::vector<CoalescedLoadOp> &loadOps,
-                       int elementSize, llvm::Instruction *insertBefore) {
+                       llvm::Type *eltType, llvm::Instruction *insertBefore) {
     Debug(SourcePos(), "Coalesce doing %d loads.", (int)loadOps.size());
+    const int eltBits = eltType->getPrimitiveSizeInBits();
+    const int elementSize = eltBits / 8;
     for (int i = 0; i < (int)loadOps.size(); ++i) {
         Debug(SourcePos(), "Load #%d @ %" PRId64 ", %d items", i, loadOps[i].start, loadOps[i].count);
 
         // basePtr is an i8 *, so the offset from it should be in terms of
-        // bytes, not underlying i32 elements.
+        // bytes, not underlying elements.
         int64_t start = loadOps[i].start * elementSize;
 
-        int align = 4;
+        int align = elementSize;
         switch (loadOps[i].count) {
         case 1:
-            // Single 32-bit scalar load
-            loadOps[i].load = lGEPAndLoad(basePtr, baseType, start, align, insertBefore, LLVMTypes::Int32Type);
+            // Single scalar load
+            loadOps[i].load = lGEPAndLoad(basePtr, baseType, start, align, insertBefore, eltType);
             break;
         case 2: {
-            // Emit 2 x i32 loads as i64 loads and then break the result
-            // into two 32-bit parts.
-            loadOps[i].load = lGEPAndLoad(basePtr, baseType, start, align, insertBefore, LLVMTypes::Int64Type);
-            // element0 = (int32)value;
-            loadOps[i].element0 =
-                new llvm::TruncInst(loadOps[i].load, LLVMTypes::Int32Type, "load64_elt0", insertBefore);
-            // element1 = (int32)(value >> 32)
-            llvm::Value *shift = llvm::BinaryOperator::Create(llvm::Instruction::LShr, loadOps[i].load, LLVMInt64(32),
-                                                              "load64_shift", insertBefore);
-            loadOps[i].element1 = new llvm::TruncInst(shift, LLVMTypes::Int32Type, "load64_elt1", insertBefore);
-            break;
-        }
-        case 4: {
-            // 4-wide vector load
-            if (g->opt.forceAlignedMemory) {
-                align = g->target->getNativeVectorAlignment();
+            if (eltBits == 64) {
+                // There's no 128-bit scalar type to load through, so do a
+                // 2-wide vector load and extract the two elements.
+                llvm::VectorType *vt = LLVMVECTOR::get(eltType, 2);
+                loadOps[i].load = lGEPAndLoad(basePtr, baseType, start, align, insertBefore, vt);
+                loadOps[i].element0 =
+                    llvm::ExtractElementInst::Create(loadOps[i].load, LLVMInt32(0), "load2_elt0", insertBefore);
+                loadOps[i].element1 =
+                    llvm::ExtractElementInst::Create(loadOps[i].load, LLVMInt32(1), "load2_elt1", insertBefore);
+                break;
             }
-            llvm::VectorType *vt = LLVMVECTOR::get(LLVMTypes::Int32Type, 4);
-            loadOps[i].load = lGEPAndLoad(basePtr, baseType, start, align, insertBefore, vt);
+            // Emit 2 x iN loads as i(2N) loads and then break the result
+            // into two N-bit parts.
+            llvm::Type *wideType = llvm::IntegerType::get(*g->ctx, 2 * eltBits);
+            loadOps[i].load = lGEPAndLoad(basePtr, baseType, start, align, insertBefore, wideType);
+            // element0 = (intN)value;
+            loadOps[i].element0 = new llvm::TruncInst(loadOps[i].load, eltType, "load2_elt0", insertBefore);
+            // element1 = (intN)(value >> N)
+            llvm::Value *shift =
+                llvm::BinaryOperator::Create(llvm::Instruction::LShr, loadOps[i].load,
+                                             llvm::ConstantInt::get(wideType, eltBits), "load2_shift", insertBefore);
+            loadOps[i].element1 = new llvm::TruncInst(shift, eltType, "load2_elt1", insertBefore);
             break;
         }
-        case 8: {
-            // 8-wide vector load
+        default: {
+            // 4-wide or wider vector load
+            Assert(loadOps[i].count >= 4 && (loadOps[i].count % 4) == 0);
             if (g->opt.forceAlignedMemory) {
                 align = g->target->getNativeVectorAlignment();
             }
-            llvm::VectorType *vt = LLVMVECTOR::get(LLVMTypes::Int32Type, 8);
+            llvm::VectorType *vt = LLVMVECTOR::get(eltType, loadOps[i].count);
             loadOps[i].load = lGEPAndLoad(basePtr, baseType, start, align, insertBefore, vt);
             break;
         }
-        default:
-            FATAL("Unexpected load count in lEmitLoads()");
         }
     }
 }
 
-/** Convert any loads of 8-wide vectors into two 4-wide vectors
-    (logically).  This allows the assembly code below to always operate on
-    4-wide vectors, which leads to better code.  Returns a new vector of
-    load operations.
+/** Convert any loads of vectors wider than 4 elements into multiple
+    4-wide vectors (logically).  This allows the assembly code below to
+    always operate on 4-wide vectors, which leads to better code.  Returns
+    a new vector of load operations.
  */
-static std::vector<CoalescedLoadOp> lSplit8WideLoads(const std::vector<CoalescedLoadOp> &loadOps,
-                                                     llvm::Instruction *insertBefore) {
+static std::vector<CoalescedLoadOp> lSplitWideLoads(const std::vector<CoalescedLoadOp> &loadOps,
+                                                    llvm::Instruction *insertBefore) {
     std::vector<CoalescedLoadOp> ret;
     for (unsigned int i = 0; i < loadOps.size(); ++i) {
-        if (loadOps[i].count == 8) {
+        if (loadOps[i].count > 4) {
             // Create fake CoalescedLOadOps, where the load llvm::Value is
-            // actually a shuffle that pulls either the first 4 or the last
-            // 4 values out of the original 8-wide loaded value.
-            int32_t shuf[2][4] = {{0, 1, 2, 3}, {4, 5, 6, 7}};
-
-            ret.push_back(CoalescedLoadOp(loadOps[i].start, 4));
-            ret.back().load = LLVMShuffleVectors(loadOps[i].load, loadOps[i].load, shuf[0], 4, insertBefore);
-
-            ret.push_back(CoalescedLoadOp(loadOps[i].start + 4, 4));
-            ret.back().load = LLVMShuffleVectors(loadOps[i].load, loadOps[i].load, shuf[1], 4, insertBefore);
+            // actually a shuffle that pulls a consecutive group of 4
+            // values out of the original wide loaded value.
+            for (int chunk = 0; chunk < loadOps[i].count; chunk += 4) {
+                int32_t shuf[4] = {chunk, chunk + 1, chunk + 2, chunk + 3};
+                ret.push_back(CoalescedLoadOp(loadOps[i].start + chunk, 4));
+                ret.back().load = LLVMShuffleVectors(loadOps[i].load, loadOps[i].load, shuf, 4, insertBefore);
+            }
         } else
             ret.push_back(loadOps[i]);
     }
@@ -375,7 +376,7 @@ static std::vector<CoalescedLoadOp> lSplit8WideLoads(const std::vector<Coalesced
     return ret;
 }
 
-/** Given a 1-wide load of a 32-bit value, merge its value into the result
+/** Given a 1-wide load of a single element, merge its value into the result
     vector for any and all elements for which it applies.
  */
 static llvm::Value *lApplyLoad1(llvm::Value *result, const CoalescedLoadOp &load, const int64_t offsets[4], bool set[4],
@@ -400,32 +401,35 @@ static llvm::Value *lApplyLoad1(llvm::Value *result, const CoalescedLoadOp &load
 /** Similarly, incorporate the values from a 2-wide load into any vector
     elements that they apply to. */
 static llvm::Value *lApplyLoad2(llvm::Value *result, const CoalescedLoadOp &load, const int64_t offsets[4], bool set[4],
-                                llvm::Instruction *insertBefore) {
+                                llvm::Type *eltType, llvm::Instruction *insertBefore) {
+    const int eltBits = eltType->getPrimitiveSizeInBits();
     int elt = 0;
     while (elt < 4) {
-        // First, try to do a 64-bit-wide insert into the result vector.
+        // First, try to do a double-width insert into the result vector.
         // We can do this when we're currently at an even element, when the
         // current and next element have consecutive values, and where the
-        // original 64-bit load is at the offset needed by the current
-        // element.
-        if ((elt & 1) == 0 && offsets[elt] + 1 == offsets[elt + 1] && offsets[elt] == load.start) {
+        // original double-width load is at the offset needed by the current
+        // element.  64-bit elements were loaded as a 2-wide vector, so
+        // they always go through the element-wise path below.
+        if (eltBits < 64 && (elt & 1) == 0 && offsets[elt] + 1 == offsets[elt + 1] && offsets[elt] == load.start) {
             Debug(SourcePos(),
                   "Load 2 @ %" PRId64 " matches for elements #%d,%d "
                   "(values %" PRId64 ",%" PRId64 ")",
                   load.start, elt, elt + 1, offsets[elt], offsets[elt + 1]);
             Assert(set[elt] == false && ((elt < 3) && set[elt + 1] == false));
 
-            // In this case, we bitcast from a 4xi32 to a 2xi64 vector
-            llvm::Type *vec2x64Type = LLVMVECTOR::get(LLVMTypes::Int64Type, 2);
-            result = new llvm::BitCastInst(result, vec2x64Type, "to2x64", insertBefore);
+            // In this case, we bitcast from a 4xiN to a 2xi(2N) vector
+            llvm::Type *vec2xWideType = LLVMVECTOR::get(load.load->getType(), 2);
+            result = new llvm::BitCastInst(result, vec2xWideType, "to2xwide", insertBefore);
 
-            // And now we can insert the 64-bit wide value into the
+            // And now we can insert the double-width value into the
             // appropriate elment
-            result = llvm::InsertElementInst::Create(result, load.load, LLVMInt32(elt / 2), "insert64", insertBefore);
+            result =
+                llvm::InsertElementInst::Create(result, load.load, LLVMInt32(elt / 2), "insert_wide", insertBefore);
 
-            // And back to 4xi32.
-            llvm::Type *vec4x32Type = LLVMVECTOR::get(LLVMTypes::Int32Type, 4);
-            result = new llvm::BitCastInst(result, vec4x32Type, "to4x32", insertBefore);
+            // And back to 4xiN.
+            llvm::Type *vec4xEltType = LLVMVECTOR::get(eltType, 4);
+            result = new llvm::BitCastInst(result, vec4xEltType, "to4xelt", insertBefore);
 
             set[elt] = true;
             if (elt < 3) {
@@ -439,7 +443,7 @@ static llvm::Value *lApplyLoad2(llvm::Value *result, const CoalescedLoadOp &load
                   "Load 2 @ %" PRId64 " matches for element #%d "
                   "(value %" PRId64 ")",
                   load.start, elt, offsets[elt]);
-            // Otherwise, insert one of the 32-bit pieces into an element
+            // Otherwise, insert one of the element-sized pieces into an element
             // of the final vector
             Assert(set[elt] == false);
             llvm::Value *toInsert = (offsets[elt] == load.start) ? load.element0 : load.element1;
@@ -498,8 +502,8 @@ static llvm::Value *lApplyLoad4(llvm::Value *result, const CoalescedLoadOp &load
     for the four elements of the result.
 */
 static llvm::Value *lAssemble4Vector(const std::vector<CoalescedLoadOp> &loadOps, const int64_t offsets[4],
-                                     llvm::Instruction *insertBefore) {
-    llvm::Type *returnType = LLVMVECTOR::get(LLVMTypes::Int32Type, 4);
+                                     llvm::Type *eltType, llvm::Instruction *insertBefore) {
+    llvm::Type *returnType = LLVMVECTOR::get(eltType, 4);
     llvm::Value *result = llvm::UndefValue::get(returnType);
 
     Debug(SourcePos(), "Starting search for loads [%" PRId64 " %" PRId64 " %" PRId64 " %" PRId64 "].", offsets[0],
@@ -519,7 +523,7 @@ static llvm::Value *lAssemble4Vector(const std::vector<CoalescedLoadOp> &loadOps
             result = lApplyLoad1(result, li, offsets, set, insertBefore);
             break;
         case 2:
-            result = lApplyLoad2(result, li, offsets, set, insertBefore);
+            result = lApplyLoad2(result, li, offsets, set, eltType, insertBefore);
             break;
         case 4:
             result = lApplyLoad4(result, li, offsets, set, insertBefore);
@@ -604,7 +608,8 @@ static llvm::Value *lApplyLoad4s(llvm::Value *result, const std::vector<Coalesce
 }
 
 static llvm::Value *lApplyLoad12s(llvm::Value *result, const std::vector<CoalescedLoadOp> &loadOps,
-                                  const int64_t offsets[4], bool set[4], llvm::Instruction *insertBefore) {
+                                  const int64_t offsets[4], bool set[4], llvm::Type *eltType,
+                                  llvm::Instruction *insertBefore) {
     // Loop over all of the loads and check each one to see if it provides
     // a value that's applicable to the result
     for (int load = 0; load < (int)loadOps.size(); ++load) {
@@ -614,7 +619,7 @@ static llvm::Value *lApplyLoad12s(llvm::Value *result, const std::vector<Coalesc
         if (loadop.count == 1)
             result = lApplyLoad1(result, loadop, offsets, set, insertBefore);
         else if (loadop.count == 2)
-            result = lApplyLoad2(result, loadop, offsets, set, insertBefore);
+            result = lApplyLoad2(result, loadop, offsets, set, eltType, insertBefore);
     }
     return result;
 }
@@ -626,8 +631,8 @@ static llvm::Value *lApplyLoad12s(llvm::Value *result, const std::vector<Coalesc
     for the four elements of the result.
 */
 static llvm::Value *lAssemble4Vector(const std::vector<CoalescedLoadOp> &loadOps, const int64_t offsets[4],
-                                     llvm::Instruction *insertBefore) {
-    llvm::Type *returnType = LLVMVECTOR::get(LLVMTypes::Int32Type, 4);
+                                     llvm::Type *eltType, llvm::Instruction *insertBefore) {
+    llvm::Type *returnType = LLVMVECTOR::get(eltType, 4);
     llvm::Value *result = llvm::UndefValue::get(returnType);
 
     Debug(SourcePos(), "Starting search for loads [%" PRId64 " %" PRId64 " %" PRId64 " %" PRId64 "].", offsets[0],
@@ -638,7 +643,7 @@ static llvm::Value *lAssemble4Vector(const std::vector<CoalescedLoadOp> &loadOps
     bool set[4] = {false, false, false, false};
 
     result = lApplyLoad4s(result, loadOps, offsets, set, insertBefore);
-    result = lApplyLoad12s(result, loadOps, offsets, set, insertBefore);
+    result = lApplyLoad12s(result, loadOps, offsets, set, eltType, insertBefore);
 
     Debug(SourcePos(), "Done with search for loads [%" PRId64 " %" PRId64 " %" PRId64 " %" PRId64 "].", offsets[0],
           offsets[1], offsets[2], offsets[3]);
@@ -655,39 +660,32 @@ static llvm::Value *lAssemble4Vector(const std::vector<CoalescedLoadOp> &loadOps
     result vector.
  */
 static void lAssembleResultVectors(const std::vector<CoalescedLoadOp> &loadOps,
-                                   const std::vector<int64_t> &constOffsets, std::vector<llvm::Value *> &results,
-                                   llvm::Instruction *insertBefore) {
+                                   const std::vector<int64_t> &constOffsets, llvm::Type *eltType,
+                                   std::vector<llvm::Value *> &results, llvm::Instruction *insertBefore) {
     // We work on 4-wide chunks of the final values, even when we're
-    // computing 8-wide or 16-wide vectors.  This gives better code from
-    // LLVM's SSE/AVX code generators.
+    // computing 8-wide or wider vectors.  This gives better code from
+    // LLVM's SSE/AVX/NEON code generators.
     Assert((constOffsets.size() % 4) == 0);
     std::vector<llvm::Value *> vec4s;
     for (int i = 0; i < (int)constOffsets.size(); i += 4)
-        vec4s.push_back(lAssemble4Vector(loadOps, &constOffsets[i], insertBefore));
+        vec4s.push_back(lAssemble4Vector(loadOps, &constOffsets[i], eltType, insertBefore));
 
-    // And now concatenate 1, 2, or 4 of the 4-wide vectors computed above
-    // into 4, 8, or 16-wide final result vectors.
-    int numGathers = constOffsets.size() / g->target->getVectorWidth();
+    // And now concatenate the 4-wide vectors computed above pairwise until
+    // we have final result vectors of the target's width.
+    int width = g->target->getVectorWidth();
+    if (width < 4 || (width & (width - 1)) != 0)
+        FATAL("Unhandled vector width in lAssembleResultVectors()");
+    int numGathers = constOffsets.size() / width;
     for (int i = 0; i < numGathers; ++i) {
-        llvm::Value *result = NULL;
-        switch (g->target->getVectorWidth()) {
-        case 4:
-            result = vec4s[i];
-            break;
-        case 8:
-            result = LLVMConcatVectors(vec4s[2 * i], vec4s[2 * i + 1], insertBefore);
-            break;
-        case 16: {
-            llvm::Value *v1 = LLVMConcatVectors(vec4s[4 * i], vec4s[4 * i + 1], insertBefore);
-            llvm::Value *v2 = LLVMConcatVectors(vec4s[4 * i + 2], vec4s[4 * i + 3], insertBefore);
-            result = LLVMConcatVectors(v1, v2, insertBefore);
-            break;
-        }
-        default:
-            FATAL("Unhandled vector width in lAssembleResultVectors()");
+        std::vector<llvm::Value *> parts(vec4s.begin() + i * (width / 4), vec4s.begin() + (i + 1) * (width / 4));
+        while (parts.size() > 1) {
+            std::vector<llvm::Value *> joined;
+            for (int j = 0; j < (int)parts.size(); j += 2)
+                joined.push_back(LLVMConcatVectors(parts[j], parts[j + 1], insertBefore));
+            parts.swap(joined);
         }
 
-        results.push_back(result);
+        results.push_back(parts[0]);
     }
 }
 
@@ -719,9 +717,10 @@ static llvm::Value *lComputeBasePtr(llvm::CallInst *gatherInst, llvm::Type *base
     offsets, but we'll transform them into offsets in terms of the size of
     the base scalar type being gathered.  (e.g. for an i32 gather, we might
     have offsets like <0,4,16,20>, which would be transformed to <0,1,4,5>
-    here.)
+    here.)  Returns false if some offset isn't a multiple of the element
+    size, in which case the gathers can't be coalesced.
  */
-static void lExtractConstOffsets(const std::vector<llvm::CallInst *> &coalesceGroup, int elementSize,
+static bool lExtractConstOffsets(const std::vector<llvm::CallInst *> &coalesceGroup, int elementSize,
                                  std::vector<int64_t> *constOffsets) {
     int width = g->target->getVectorWidth();
     *constOffsets = std::vector<int64_t>(coalesceGroup.size() * width, 0);
@@ -734,8 +733,12 @@ static void lExtractConstOffsets(const std::vector<llvm::CallInst *> &coalesceGr
         Assert(ok && nElts == width);
     }
 
-    for (int i = 0; i < (int)constOffsets->size(); ++i)
+    for (int i = 0; i < (int)constOffsets->size(); ++i) {
+        if (((*constOffsets)[i] % elementSize) != 0)
+            return false;
         (*constOffsets)[i] /= elementSize;
+    }
+    return true;
 }
 
 /** Actually do the coalescing.  We have a set of gathers all accessing
@@ -751,46 +754,58 @@ static void lExtractConstOffsets(const std::vector<llvm::CallInst *> &coalesceGr
 static bool lCoalesceGathers(const std::vector<llvm::CallInst *> &coalesceGroup, llvm::Type *baseType) {
     llvm::Instruction *insertBefore = coalesceGroup[0];
 
-    // First, compute the shared base pointer for all of the gathers
-    llvm::Value *basePtr = lComputeBasePtr(coalesceGroup[0], baseType, insertBefore);
-
-    int elementSize = 0;
-    if (coalesceGroup[0]->getType() == LLVMTypes::Int32VectorType ||
-        coalesceGroup[0]->getType() == LLVMTypes::FloatVectorType)
-        elementSize = 4;
-    else if (coalesceGroup[0]->getType() == LLVMTypes::Int64VectorType ||
-             coalesceGroup[0]->getType() == LLVMTypes::DoubleVectorType)
-        elementSize = 8;
+    // All of the loading and shuffling is done on integer elements of the
+    // gathered type's size; floating-point results are bitcast back at the
+    // end.
+    llvm::Type *gatherType = coalesceGroup[0]->getType();
+    llvm::Type *eltType = NULL;
+    if (gatherType == LLVMTypes::Int8VectorType)
+        eltType = LLVMTypes::Int8Type;
+    else if (gatherType == LLVMTypes::Int16VectorType || gatherType == LLVMTypes::Float16VectorType)
+        eltType = LLVMTypes::Int16Type;
+    else if (gatherType == LLVMTypes::Int32VectorType || gatherType == LLVMTypes::FloatVectorType)
+        eltType = LLVMTypes::Int32Type;
+    else if (gatherType == LLVMTypes::Int64VectorType || gatherType == LLVMTypes::DoubleVectorType)
+        eltType = LLVMTypes::Int64Type;
     else
         FATAL("Unexpected gather type in lCoalesceGathers");
+    int elementSize = eltType->getPrimitiveSizeInBits() / 8;
+
+    // Vector loads are limited to 32 bytes; e.g. 8 x i32 or 32 x i8.
+    const int maxLoadWidth = 32 / elementSize;
 
     // Extract the constant offsets from the gathers into the constOffsets
     // vector: the first vectorWidth elements will be those for the first
     // gather, the next vectorWidth those for the next gather, and so
     // forth.
     std::vector<int64_t> constOffsets;
-    lExtractConstOffsets(coalesceGroup, elementSize, &constOffsets);
+    if (!lExtractConstOffsets(coalesceGroup, elementSize, &constOffsets))
+        return false;
+
+    // Compute the shared base pointer for all of the gathers
+    llvm::Value *basePtr = lComputeBasePtr(coalesceGroup[0], baseType, insertBefore);
 
     // Determine a set of loads to perform to get all of the values we need
     // loaded.
     std::vector<CoalescedLoadOp> loadOps;
-    lSelectLoads(constOffsets, &loadOps);
+    lSelectLoads(constOffsets, maxLoadWidth, &loadOps);
 
     lCoalescePerfInfo(coalesceGroup, loadOps);
 
     // Actually emit load instructions for them
-    lEmitLoads(basePtr, baseType, loadOps, elementSize, insertBefore);
+    lEmitLoads(basePtr, baseType, loadOps, eltType, insertBefore);
 
-    // Now, for any loads that give us <8 x i32> vectors, split their
-    // values into two <4 x i32> vectors; it turns out that LLVM gives us
-    // better code on AVX when we assemble the pieces from 4-wide vectors.
-    loadOps = lSplit8WideLoads(loadOps, insertBefore);
+    // Now, for any loads that give us vectors wider than 4 elements (e.g.
+    // <8 x i32>), split their values into 4-wide vectors; it turns out that
+    // LLVM gives us better code on AVX when we assemble the pieces from
+    // 4-wide vectors.
+    loadOps = lSplitWideLoads(loadOps, insertBefore);
 
     // Given all of these chunks of values, shuffle together a vector that
     // gives us each result value; the i'th element of results[] gives the
     // result for the i'th gather in coalesceGroup.
     std::vector<llvm::Value *> results;
-    lAssembleResultVectors(loadOps, constOffsets, results, insertBefore);
+    lAssembleResultVectors(loadOps, constOffsets, eltType, results, insertBefore);
 
     // Finally, replace each of the original gathers with the instruction
     // that gives the value from the coalescing process.
@@ -850,10 +865,20 @@ bool GatherCoalescePass::coalesceGathersFactored(llvm::BasicBlock &bb) {
     DEBUG_START_BB("GatherCoalescePass");
 
     llvm::Function *gatherFuncs[] = {
+        m->module->getFunction("__pseudo_gather_factored_base_offsets32_i8"),
+        m->module->getFunction("__pseudo_gather_factored_base_offsets32_i16"),
+        m->module->getFunction("__pseudo_gather_factored_base_offsets32_half"),
         m->module->getFunction("__pseudo_gather_factored_base_offsets32_i32"),
         m->module->getFunction("__pseudo_gather_factored_base_offsets32_float"),
+        m->module->getFunction("__pseudo_gather_factored_base_offsets32_i64"),
+        m->module->getFunction("__pseudo_gather_factored_base_offsets32_double"),
+        m->module->getFunction("__pseudo_gather_factored_base_offsets64_i8"),
+        m->module->getFunction("__pseudo_gather_factored_base_offsets64_i16"),
+        m->module->getFunction("__pseudo_gather_factored_base_offsets64_half"),
         m->module->getFunction("__pseudo_gather_factored_base_offsets64_i32"),
         m->module->getFunction("__pseudo_gather_factored_base_offsets64_float"),
+        m->module->getFunction("__pseudo_gather_factored_base_offsets64_i64"),
+        m->module->getFunction("__pseudo_gather_factored_base_offsets64_double"),
     };
     int nGatherFuncs = sizeof(gatherFuncs) / sizeof(gatherFuncs[0]);
 
@@ -864,7 +889,7 @@ bool GatherCoalescePass::coalesceGathersFactored(llvm::BasicBlock &bb) {
     for (llvm::BasicBlock::iterator iter = bb.begin(), e = bb.end(); iter != e;) {
         llvm::BasicBlock::iterator curIter = iter++;
         // Iterate over all of the instructions and look for calls to
-        // __pseudo_gather_factored_base_offsets{32,64}_{i32,float} calls.
+        // __pseudo_gather_factored_base_offsets{32,64}_* calls.
         llvm::CallInst *callInst = llvm::dyn_cast<llvm::CallInst>(&*curIter);
         if (callInst == NULL)
             continue;
@@ -902,11 +927,17 @@ bool GatherCoalescePass::coalesceGathersFactored(llvm::BasicBlock &bb) {
         // Then and only then do we have a common base pointer with all
         // offsets from that constants (in which case we can potentially
         // coalesce).
-        if (GetMaskStatusFromValue(mask) != MaskStatus::all_on)
+        if (GetMaskStatusFromValue(mask) != MaskStatus::all_on) {
+            EmitOptRemark(OptRemarkKind::Missed, "GatherCoalescePass", "MaskNotAllOn", callInst,
+                          "gather not coalesced: mask is not known to be all on");
             continue;
+        }
 
-        if (!LLVMVectorValuesAllEqual(variableOffsets))
+        if (!LLVMVectorValuesAllEqual(variableOffsets)) {
+            EmitOptRemark(OptRemarkKind::Missed, "GatherCoalescePass", "VaryingOffsets", callInst,
+                          "gather not coalesced: variable offsets differ across program instances");
             continue;
+        }
 
         // coalesceGroup stores the set of gathers that we're going to try to
         // coalesce over
@@ -986,6 +1017,10 @@ bool GatherCoalescePass::coalesceGathersFactored(llvm::BasicBlock &bb) {
         // into something more efficient than the original set of gathers.
         if (lCoalesceGathers(coalesceGroup, baseType)) {
             modifiedAny = true;
+        } else {
+            EmitOptRemark(OptRemarkKind::Missed, "GatherCoalescePass", "NotCoalesced", callInst,
+                          "group of %d gather(s) not coalesced: constant offsets don't form coalescable loads",
+                          (int)coalesceGroup.size());
         }
     }
     DEBUG_END_BB("GatherCoalescePass");
@@ -1004,6 +1039,17 @@ bool GatherCoalescePass::runOnFunction(llvm::Function &F) {
     return modifiedAny;
 }
 
-llvm::Pass *CreateGatherCoalescePass() { return new GatherCoalescePass; }
+llvm::PreservedAnalyses GatherCoalescePass::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("GatherCoalescePass::run", F.getName());
+    bool modifiedAny = runOnFunction(F);
+    if (!modifiedAny) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
 
 } // namespace ispc
@@ -38,12 +38,12 @@
 namespace ispc {
 
 // This pass implements two optimizations to improve the performance of
-// gathers; currently only gathers of 32-bit values where it can be
-// determined at compile time that the mask is all on are supported, though
-// both of those limitations may be generalized in the future.
+// gathers; currently only gathers of 8, 16, 32 and 64-bit values where it
+// can be determined at compile time that the mask is all on are supported,
+// though the latter limitation may be generalized in the future.
 //
 //  First, for any single gather, see if it's worthwhile to break it into
-//  any of scalar, 2-wide (i.e. 64-bit), 4-wide, or 8-wide loads.  Further,
+//  any of scalar, 2-wide, or wider vector loads of up to 32 bytes.  Further,
 //  we generate code that shuffles these loads around.  Doing fewer, larger
 //  loads in this manner, when possible, can be more efficient.
 //
@@ -56,21 +56,19 @@ namespace ispc {
 //  in this case, we're often able to generate wide vector loads and
 //  appropriate shuffles automatically.
 
-class GatherCoalescePass : public llvm::FunctionPass {
+class GatherCoalescePass : public llvm::PassInfoMixin<GatherCoalescePass> {
   public:
-    static char ID;
-    explicit GatherCoalescePass() : FunctionPass(ID) {}
+    explicit GatherCoalescePass() {}
 
-    llvm::StringRef getPassName() const override { return "Gather Coalescing"; }
-    bool runOnFunction(llvm::Function &F) override;
+    static llvm::StringRef name() { return "Gather Coalescing"; }
+    llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
 
   private:
+    bool runOnFunction(llvm::Function &F);
     // Type of base pointer element type (the 1st argument of the intrinsic) is i8
     // e.g. @__pseudo_gather_factored_base_offsets32_i32(i8 *, <WIDTH x i32>, i32, <WIDTH x i32>, <WIDTH x MASK>)
     llvm::Type *baseType{LLVMTypes::Int8Type};
     bool coalesceGathersFactored(llvm::BasicBlock &BB);
 };
 
-llvm::Pass *CreateGatherCoalescePass();
-
 } // namespace ispc
\ No newline at end of file
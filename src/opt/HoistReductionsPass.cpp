@@ -0,0 +1,244 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "HoistReductionsPass.h"
+#include "OptRemarks.h"
+
+#include <llvm/IR/IRBuilder.h>
+
+namespace ispc {
+
+/** A reduce_add() overload of the standard library along with the builtin
+    that reduces an already masked vector. */
+struct ReduceAddInfo {
+    const char *stdlibName;
+    const char *builtinName;
+    bool isFloatingPoint;
+};
+
+static const ReduceAddInfo lReduceAdds[] = {
+    {"reduce_add___vyh", "__reduce_add_half", true},  {"reduce_add___vyf", "__reduce_add_float", true},
+    {"reduce_add___vyd", "__reduce_add_double", true}, {"reduce_add___vyI", "__reduce_add_int64", false},
+    {"reduce_add___vyU", "__reduce_add_int64", false},
+};
+
+/** One step of the accumulation in the loop: add = prev + call, where call
+    is a reduce_add() of a varying value.  vecAdd is the corresponding
+    addition to the varying accumulator. */
+struct ReductionStep {
+    llvm::BinaryOperator *add;
+    llvm::CallInst *call;
+    llvm::Value *vecAdd;
+};
+
+/** If the value is a call of one of the reduce_add() functions handled,
+    return the description of the function. */
+static const ReduceAddInfo *lGetReduceAdd(llvm::Value *v) {
+    llvm::CallInst *call = llvm::dyn_cast<llvm::CallInst>(v);
+    if (call == NULL || call->getCalledFunction() == NULL || call->arg_size() != 2)
+        return NULL;
+
+    std::string suffix = g->mangleFunctionsWithTarget ? "_" + g->target->GetVariantString() : "";
+    for (const ReduceAddInfo &info : lReduceAdds) {
+        if (call->getCalledFunction()->getName() == std::string(info.stdlibName) + suffix)
+            return &info;
+    }
+    return NULL;
+}
+
+/** Return the only user of the value in the loop, or NULL if there are
+    none or several of them. */
+static llvm::Instruction *lGetOnlyUserInLoop(llvm::Value *v, llvm::Loop *L) {
+    llvm::Instruction *result = NULL;
+    for (llvm::User *user : v->users()) {
+        llvm::Instruction *inst = llvm::cast<llvm::Instruction>(user);
+        if (!L->contains(inst))
+            continue;
+        if (result != NULL)
+            return NULL;
+        result = inst;
+    }
+    return result;
+}
+
+/** Replace the uses of the uniform value out of the loop with the sum of
+    the initial value and the reduction of the given varying accumulator. */
+static void lReplaceUsesOutOfLoop(llvm::Value *value, llvm::Value *vecValue, llvm::Value *init,
+                                  llvm::Function *reduceFunc, bool isFloatingPoint, llvm::Loop *L) {
+    std::vector<llvm::Use *> outOfLoopUses;
+    for (llvm::Use &use : value->uses()) {
+        if (!L->contains(llvm::cast<llvm::Instruction>(use.getUser())))
+            outOfLoopUses.push_back(&use);
+    }
+
+    for (llvm::Use *use : outOfLoopUses) {
+        llvm::Instruction *insertBefore = llvm::cast<llvm::Instruction>(use->getUser());
+        if (llvm::PHINode *phi = llvm::dyn_cast<llvm::PHINode>(insertBefore))
+            insertBefore = phi->getIncomingBlock(*use)->getTerminator();
+
+        llvm::IRBuilder<> builder(insertBefore);
+        llvm::Value *total = builder.CreateCall(reduceFunc, {vecValue}, "reduce_total");
+        llvm::Value *result = isFloatingPoint ? builder.CreateFAdd(init, total, value->getName() + "_hoisted")
+                                              : builder.CreateAdd(init, total, value->getName() + "_hoisted");
+        use->set(result);
+    }
+}
+
+// Find the uniform accumulators of the loop that are only updated by
+// adding reduce_add() results to them, once per iteration, and accumulate
+// the masked varying values instead.
+bool HoistReductionsPass::hoistReductions(llvm::Loop *L) {
+    llvm::BasicBlock *header = L->getHeader();
+    llvm::BasicBlock *preheader = L->getLoopPreheader();
+    llvm::BasicBlock *latch = L->getLoopLatch();
+    if (preheader == NULL || latch == NULL)
+        return false;
+
+    // The accumulators are collected first, since the loop header gets new
+    // phis and the transformed accumulators are removed.
+    std::vector<llvm::PHINode *> accumulators;
+    for (llvm::PHINode &phi : header->phis()) {
+        if (phi.getNumIncomingValues() == 2 && !phi.getType()->isVectorTy())
+            accumulators.push_back(&phi);
+    }
+
+    bool modifiedAny = false;
+    for (llvm::PHINode *acc : accumulators) {
+        llvm::Value *init = acc->getIncomingValueForBlock(preheader);
+        llvm::Value *next = acc->getIncomingValueForBlock(latch);
+
+        // Follow the chain of additions from the phi to the value for the
+        // next iteration.  Each value of the chain is only used by the next
+        // addition in the loop, so that it's done once per iteration and
+        // the partial sums aren't needed there.
+        std::vector<ReductionStep> steps;
+        const ReduceAddInfo *info = NULL;
+        llvm::Value *cur = acc;
+        bool matched = true;
+        while (cur != next) {
+            llvm::BinaryOperator *add = llvm::dyn_cast_or_null<llvm::BinaryOperator>(lGetOnlyUserInLoop(cur, L));
+            if (add == NULL ||
+                (add->getOpcode() != llvm::Instruction::FAdd && add->getOpcode() != llvm::Instruction::Add)) {
+                matched = false;
+                break;
+            }
+            llvm::Value *other = add->getOperand(0) == cur ? add->getOperand(1) : add->getOperand(0);
+            const ReduceAddInfo *stepInfo = lGetReduceAdd(other);
+            if (stepInfo == NULL || (info != NULL && stepInfo->isFloatingPoint != info->isFloatingPoint) ||
+                !other->hasOneUse() || other->getType() != acc->getType()) {
+                matched = false;
+                break;
+            }
+            info = stepInfo;
+            steps.push_back({add, llvm::cast<llvm::CallInst>(other), NULL});
+            cur = add;
+        }
+        if (!matched || steps.empty() || lGetOnlyUserInLoop(next, L) != acc)
+            continue;
+
+        llvm::Function *reduceFunc = m->module->getFunction(info->builtinName);
+        if (reduceFunc == NULL || reduceFunc->getReturnType() != acc->getType())
+            continue;
+
+        if (info->isFloatingPoint && !g->opt.fastMath) {
+            EmitOptRemark(OptRemarkKind::Missed, "HoistReductions", "NeedsFastMath", steps[0].call,
+                          "reduce_add() not hoisted out of the loop: floating-point reduction is only reassociated "
+                          "with --opt=fast-math");
+            continue;
+        }
+
+        // Accumulate the values of the active program instances in a
+        // varying accumulator.
+        llvm::Type *vecType = steps[0].call->getArgOperand(0)->getType();
+        llvm::Constant *zero = llvm::Constant::getNullValue(vecType);
+        llvm::PHINode *vecAcc = llvm::PHINode::Create(vecType, 2, acc->getName() + "_varying", &header->front());
+        vecAcc->addIncoming(zero, preheader);
+        llvm::Value *vecCur = vecAcc;
+        for (ReductionStep &step : steps) {
+            llvm::IRBuilder<> builder(step.add);
+            llvm::Value *value = step.call->getArgOperand(0);
+            llvm::Value *mask = step.call->getArgOperand(1);
+            if (!mask->getType()->getScalarType()->isIntegerTy(1))
+                mask = builder.CreateICmpNE(mask, llvm::Constant::getNullValue(mask->getType()), "active");
+            value = builder.CreateSelect(mask, value, zero, "masked");
+            vecCur = info->isFloatingPoint ? builder.CreateFAdd(vecCur, value, "reduce_sum")
+                                           : builder.CreateAdd(vecCur, value, "reduce_sum");
+            step.vecAdd = vecCur;
+        }
+        vecAcc->addIncoming(vecCur, latch);
+
+        // Compute the uniform sums where they're used after the loop.
+        lReplaceUsesOutOfLoop(acc, vecAcc, init, reduceFunc, info->isFloatingPoint, L);
+        for (ReductionStep &step : steps)
+            lReplaceUsesOutOfLoop(step.add, step.vecAdd, init, reduceFunc, info->isFloatingPoint, L);
+
+        EmitOptRemark(OptRemarkKind::Passed, "HoistReductions", "Hoisted", steps[0].call,
+                      "%d reduce_add() call(s) hoisted out of the loop", (int)steps.size());
+
+        // The uniform accumulator is not updated in the loop anymore.
+        for (auto it = steps.rbegin(); it != steps.rend(); ++it) {
+            llvm::Value *prev = it->add->getOperand(0) == it->call ? it->add->getOperand(1) : it->add->getOperand(0);
+            it->add->replaceAllUsesWith(prev);
+            it->add->eraseFromParent();
+            it->call->eraseFromParent();
+        }
+        acc->replaceAllUsesWith(init);
+        acc->eraseFromParent();
+        modifiedAny = true;
+    }
+    return modifiedAny;
+}
+
+bool HoistReductionsPass::runOnFunction(llvm::Function &F, llvm::LoopInfo &LI) {
+    llvm::TimeTraceScope FuncScope("HoistReductionsPass::runOnFunction", F.getName());
+    bool modifiedAny = false;
+    for (llvm::Loop *L : LI.getLoopsInPreorder())
+        modifiedAny |= hoistReductions(L);
+    return modifiedAny;
+}
+
+llvm::PreservedAnalyses HoistReductionsPass::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("HoistReductionsPass::run", F.getName());
+    llvm::LoopInfo &LI = FAM.getResult<llvm::LoopAnalysis>(F);
+    bool modifiedAny = runOnFunction(F, LI);
+    if (!modifiedAny) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
+
+} // namespace ispc
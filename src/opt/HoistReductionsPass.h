@@ -0,0 +1,72 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "ISPCPass.h"
+
+#include <llvm/Analysis/LoopInfo.h>
+
+namespace ispc {
+
+// This pass moves horizontal reductions done with reduce_add() on every
+// iteration of a loop into a uniform accumulator out of the loop.  Code
+// like
+//
+//     uniform float sum = 0;
+//     foreach (i = 0 ... count)
+//         sum += reduce_add(a[i] * b[i]);
+//
+// reduces across the gang on each iteration.  Instead, the values of the
+// active program instances are summed into a varying accumulator in the
+// loop and the accumulator is reduced once where the uniform sum is used
+// after the loop.  The pass runs before inlining, while the calls to the
+// standard library reduce_add() functions can still be recognized.
+//
+// Integer (64-bit) sums are computed exactly the same way in both forms.
+// Floating-point sums are reassociated by the transformation, so they're
+// only transformed with --opt=fast-math.
+
+class HoistReductionsPass : public llvm::PassInfoMixin<HoistReductionsPass> {
+  public:
+    explicit HoistReductionsPass() {}
+
+    static llvm::StringRef name() { return "Hoist Horizontal Reductions"; }
+    llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+
+  private:
+    bool runOnFunction(llvm::Function &F, llvm::LoopInfo &LI);
+    bool hoistReductions(llvm::Loop *L);
+};
+
+} // namespace ispc
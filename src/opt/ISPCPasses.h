@@ -37,17 +37,23 @@
 
 #pragma once
 
+#include "AutoPrefetchPass.h"
 #include "CheckIRForXeTarget.h"
 #include "DebugPass.h"
 #include "GatherCoalescePass.h"
+#include "HoistReductionsPass.h"
 #include "ImproveMemoryOps.h"
 #include "InstructionSimplify.h"
 #include "IntrinsicsOptPass.h"
 #include "IsCompileTimeConstant.h"
+#include "LoopInvariantDivisionPass.h"
+#include "LoopVersioningPass.h"
 #include "MakeInternalFuncsStatic.h"
 #include "MangleOpenCLBuiltins.h"
 #include "PeepholePass.h"
 #include "ReplacePseudoMemoryOps.h"
 #include "ReplaceStdlibShiftPass.h"
+#include "ScatterCoalescePass.h"
+#include "XeBlock2DMemoryOps.h"
 #include "XeGatherCoalescePass.h"
 #include "XeReplaceLLVMIntrinsics.h"
\ No newline at end of file
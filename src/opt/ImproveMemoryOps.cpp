@@ -32,10 +32,12 @@
 */
 
 #include "ImproveMemoryOps.h"
+#include "OptRemarks.h"
 
-namespace ispc {
+#include <llvm/Analysis/Loads.h>
+#include <llvm/Analysis/ValueTracking.h>
 
-char ImproveMemoryOpsPass::ID = 0;
+namespace ispc {
 
 /** Check to make sure that this value is actually a pointer in the end.
     We need to make sure that given an expression like vec(offset) +
@@ -1348,6 +1350,86 @@ static llvm::Constant *lGetOffsetScaleVec(llvm::Value *offsetScale, llvm::Type *
     return llvm::ConstantVector::get(scales);
 }
 
+/** Gathers from a small constant table, with at most twice as many entries
+    as there are program instances, are done as lookups in the table held in
+    registers. Each lookup is written as the extracts of the lanes with the
+    indices of the gather, which LLVM turns to vpermps/vpermd/vpermpd on AVX2
+    and AVX-512; for tables with more entries than the gang size, both halves
+    are looked up and the result is selected by the index. The values
+    returned for the lanes which are off are arbitrary. */
+static llvm::Instruction *lGatherToTableShuffle(llvm::CallInst *callInst, llvm::Value *base,
+                                                llvm::Value *fullOffsets, llvm::Type *scalarType,
+                                                const SourcePos &pos) {
+    if (g->target->getISA() < Target::AVX2 || g->target->getISA() > Target::SPR_AVX512)
+        return nullptr;
+
+    const int width = g->target->getVectorWidth();
+    const int elementSize = (int)scalarType->getPrimitiveSizeInBits() / 8;
+    // The permutes exist for 32- and 64-bit elements, and the table has to
+    // fit in a single register for the lookup to be a single instruction.
+    if (elementSize < 4 || width * elementSize > g->target->getNativeVectorWidth() * 4)
+        return nullptr;
+
+    llvm::GlobalVariable *table = llvm::dyn_cast<llvm::GlobalVariable>(base->stripPointerCasts());
+    if (table == nullptr || !table->isConstant() || !table->hasDefinitiveInitializer())
+        return nullptr;
+    llvm::ArrayType *tableType = llvm::dyn_cast<llvm::ArrayType>(table->getValueType());
+    if (tableType == nullptr || tableType->getElementType() != scalarType ||
+        tableType->getNumElements() > 2 * (uint64_t)width)
+        return nullptr;
+
+    const int numEntries = (int)tableType->getNumElements();
+    const int numHalves = numEntries > width ? 2 : 1;
+    llvm::Constant *init = table->getInitializer();
+    llvm::SmallVector<llvm::Constant *, 64> entries[2];
+    for (int i = 0; i < numHalves * width; ++i) {
+        llvm::Constant *entry =
+            i < numEntries ? init->getAggregateElement(i) : llvm::Constant::getNullValue(scalarType);
+        if (entry == nullptr)
+            return nullptr;
+        entries[i / width].push_back(entry);
+    }
+
+    // Index of the entry in the table, and in its half of the table
+    bool is64 = fullOffsets->getType() == LLVMTypes::Int64VectorType;
+    int shift = elementSize == 4 ? 2 : 3;
+    llvm::Value *index = llvm::BinaryOperator::Create(llvm::Instruction::LShr, fullOffsets,
+                                                      is64 ? LLVMInt64Vector(shift) : LLVMInt32Vector(shift),
+                                                      "table_index", callInst);
+    if (is64)
+        index = new llvm::TruncInst(index, LLVMTypes::Int32VectorType, "table_index32", callInst);
+    llvm::Value *halfIndex = llvm::BinaryOperator::Create(llvm::Instruction::And, index, LLVMInt32Vector(width - 1),
+                                                          "table_half_index", callInst);
+
+    llvm::Value *lookups[2];
+    for (int h = 0; h < numHalves; ++h) {
+        llvm::Constant *half = llvm::ConstantVector::get(entries[h]);
+        llvm::Value *lookup = llvm::UndefValue::get(callInst->getType());
+        for (int i = 0; i < width; ++i) {
+            llvm::Value *laneIndex = llvm::ExtractElementInst::Create(halfIndex, LLVMInt32(i), "lane_index", callInst);
+            llvm::Value *entry = llvm::ExtractElementInst::Create(half, laneIndex, "table_entry", callInst);
+            lookup = llvm::InsertElementInst::Create(lookup, entry, LLVMInt32(i), "table_lookup", callInst);
+        }
+        lookups[h] = lookup;
+    }
+
+    llvm::Value *result = lookups[0];
+    if (numHalves == 2) {
+        llvm::Value *inHigh = new llvm::ICmpInst(callInst, llvm::CmpInst::ICMP_UGE, index, LLVMInt32Vector(width),
+                                                 "table_in_high_half");
+        result = llvm::SelectInst::Create(inHigh, lookups[1], lookups[0], callInst->getName(), callInst);
+    }
+
+    Debug(pos, "Transformed gather from a constant table with %d entries to a lookup in registers!", numEntries);
+    EmitOptRemark(OptRemarkKind::Passed, "ImproveMemoryOps", "GatherToTableLookup", callInst,
+                  "gather from a constant table with %d entries done as a lookup in registers", numEntries);
+    llvm::Instruction *resultInst = llvm::cast<llvm::Instruction>(result);
+    LLVMCopyMetadata(resultInst, callInst);
+    callInst->replaceAllUsesWith(resultInst);
+    callInst->eraseFromParent();
+    return resultInst;
+}
+
 /** After earlier optimization passes have run, we are sometimes able to
     determine that gathers/scatters are actually accessing memory in a more
     regular fashion and then change the operation to something simpler and
@@ -1634,6 +1716,15 @@ static llvm::Instruction *lGSToLoadStore(llvm::CallInst *callInst) {
             llvm::ReplaceInstWithInst(callInst, newCall);
             return newCall;
         }
+        if (gatherInfo != NULL) {
+            if (llvm::Instruction *lookup = lGatherToTableShuffle(callInst, base, fullOffsets, scalarType, pos))
+                return lookup;
+            EmitOptRemark(OptRemarkKind::Missed, "ImproveMemoryOps", "GatherKept", callInst,
+                          "gather kept: offsets are neither uniform nor linear with stride %d", step);
+        } else {
+            EmitOptRemark(OptRemarkKind::Missed, "ImproveMemoryOps", "ScatterKept", callInst,
+                          "scatter kept: offsets are neither uniform nor linear with stride %d", step);
+        }
         return nullptr;
     }
 }
@@ -1838,6 +1929,17 @@ static llvm::Value *lImproveMaskedStore(llvm::CallInst *callInst) {
         }
         if (store != NULL) {
             LLVMCopyMetadata(store, callInst);
+            // Stores marked by '#pragma nontemporal' that end up as a
+            // full-vector store to memory other than the stack are emitted
+            // as streaming stores.
+            if (store->getMetadata("ISPC-Nontemporal") != NULL) {
+                store->setMetadata("ISPC-Nontemporal", NULL);
+                if (llvm::isa<llvm::StoreInst>(store) && llvm::isa<llvm::VectorType>(rvalueType) &&
+                    !llvm::isa<llvm::AllocaInst>(llvm::getUnderlyingObject(lvalue))) {
+                    llvm::MDNode *N = llvm::MDNode::get(*g->ctx, llvm::ConstantAsMetadata::get(LLVMInt32(1)));
+                    store->setMetadata(llvm::LLVMContext::MD_nontemporal, N);
+                }
+            }
             llvm::ReplaceInstWithInst(callInst, store);
             return store;
         }
@@ -1855,9 +1957,25 @@ static llvm::Value *lImproveMaskedStore(llvm::CallInst *callInst) {
         }
 #endif
     }
+    if (maskStatus != MaskStatus::all_on) {
+        EmitOptRemark(OptRemarkKind::Missed, "ImproveMemoryOps", "MaskedStoreKept", callInst,
+                      "masked store kept: mask is not known to be all on or all off");
+    }
     return nullptr;
 }
 
+/** Creates a regular vector load of the value of the masked load call from
+    the given pointer, which is inserted before the call. */
+static llvm::Instruction *lCreateVectorLoad(llvm::CallInst *callInst, llvm::Value *ptr, int align) {
+    llvm::Type *ptrType = llvm::PointerType::get(callInst->getType(), 0);
+    ptr = new llvm::BitCastInst(ptr, ptrType, "ptr_cast_for_load", callInst);
+    Assert(llvm::isa<llvm::PointerType>(ptr->getType()));
+    return new llvm::LoadInst(
+        callInst->getType(), ptr, callInst->getName(), false /* not volatile */,
+        llvm::MaybeAlign(g->opt.forceAlignedMemory ? g->target->getNativeVectorAlignment() : align).valueOrOne(),
+        (llvm::Instruction *)NULL);
+}
+
 static llvm::Value *lImproveMaskedLoad(llvm::CallInst *callInst, llvm::BasicBlock::iterator iter) {
     struct MLInfo {
         MLInfo(const char *name, const int a) : align(a) {
@@ -1929,20 +2047,24 @@ static llvm::Value *lImproveMaskedLoad(llvm::CallInst *callInst, llvm::BasicBloc
                    (g->target->isXeTarget() && GetAddressSpace(ptr) == AddressSpace::ispc_default))
 #endif
         {
-            llvm::Type *ptrType = llvm::PointerType::get(callInst->getType(), 0);
-            ptr = new llvm::BitCastInst(ptr, ptrType, "ptr_cast_for_load", callInst);
-            Assert(llvm::isa<llvm::PointerType>(ptr->getType()));
-            load = new llvm::LoadInst(
-                callInst->getType(), ptr, callInst->getName(), false /* not volatile */,
-                llvm::MaybeAlign(g->opt.forceAlignedMemory ? g->target->getNativeVectorAlignment() : info->align)
-                    .valueOrOne(),
-                (llvm::Instruction *)NULL);
+            load = lCreateVectorLoad(callInst, ptr, info->align);
         }
         if (load != NULL) {
             LLVMCopyMetadata(load, callInst);
             llvm::ReplaceInstWithInst(callInst, load);
             return load;
         }
+    } else if (!g->target->isXeTarget() &&
+               llvm::isDereferenceableAndAlignedPointer(ptr, callInst->getType(), llvm::Align(info->align),
+                                                        callInst->getModule()->getDataLayout(), callInst)) {
+        // The memory of the whole vector is known to be dereferenceable,
+        // e.g. it is in a local or global array of known size, so a regular
+        // vector load is safe even though some lanes are off.  The values
+        // that a masked load returns for these lanes are undefined anyway.
+        llvm::Instruction *load = lCreateVectorLoad(callInst, ptr, info->align);
+        LLVMCopyMetadata(load, callInst);
+        llvm::ReplaceInstWithInst(callInst, load);
+        return load;
     }
     return nullptr;
 }
@@ -2001,6 +2123,17 @@ bool ImproveMemoryOpsPass::runOnFunction(llvm::Function &F) {
     return modifiedAny;
 }
 
-llvm::Pass *CreateImproveMemoryOpsPass() { return new ImproveMemoryOpsPass; }
+llvm::PreservedAnalyses ImproveMemoryOpsPass::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("ImproveMemoryOpsPass::run", F.getName());
+    bool modifiedAny = runOnFunction(F);
+    if (!modifiedAny) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
 
 } // namespace ispc
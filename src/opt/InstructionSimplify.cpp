@@ -35,8 +35,6 @@
 
 namespace ispc {
 
-char InstructionSimplifyPass::ID = 0;
-
 static llvm::Value *lSimplifyBoolVec(llvm::Value *value) {
     llvm::TruncInst *trunc = llvm::dyn_cast<llvm::TruncInst>(value);
     if (trunc != NULL) {
@@ -163,6 +161,17 @@ bool InstructionSimplifyPass::runOnFunction(llvm::Function &F) {
     return modifiedAny;
 }
 
-llvm::Pass *CreateInstructionSimplifyPass() { return new InstructionSimplifyPass; }
+llvm::PreservedAnalyses InstructionSimplifyPass::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("InstructionSimplifyPass::run", F.getName());
+    bool modifiedAny = runOnFunction(F);
+    if (!modifiedAny) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
 
 } // namespace ispc
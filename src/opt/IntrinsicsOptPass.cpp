@@ -35,8 +35,6 @@
 
 namespace ispc {
 
-char IntrinsicsOpt::ID = 0;
-
 bool IntrinsicsOpt::optimizeIntrinsics(llvm::BasicBlock &bb) {
     DEBUG_START_BB("IntrinsicsOpt");
 
@@ -217,13 +215,96 @@ bool IntrinsicsOpt::optimizeIntrinsics(llvm::BasicBlock &bb) {
     return modifiedAny;
 }
 
-bool IntrinsicsOpt::runOnFunction(llvm::Function &F) {
+/** Returns the mask that the given condition of an llvm.assume requires
+    to be "all on", as all() does, or NULL if it isn't such a test. */
+llvm::Value *IntrinsicsOpt::assumedAllOnMask(llvm::Value *cond) {
+    llvm::ICmpInst *cmp = llvm::dyn_cast<llvm::ICmpInst>(cond);
+    if (cmp == NULL || cmp->getPredicate() != llvm::ICmpInst::ICMP_EQ)
+        return NULL;
+    llvm::ConstantInt *bits = llvm::dyn_cast<llvm::ConstantInt>(cmp->getOperand(1));
+    if (bits == NULL)
+        return NULL;
+
+    llvm::Value *mask = NULL;
+    llvm::CallInst *call = llvm::dyn_cast<llvm::CallInst>(cmp->getOperand(0));
+    llvm::BitCastInst *cast = llvm::dyn_cast<llvm::BitCastInst>(cmp->getOperand(0));
+    if (call != NULL && call->getCalledFunction() != NULL && matchesMaskInstruction(call->getCalledFunction())) {
+        // MOVMSK of the mask has to have the bits of all of the lanes set.
+        mask = call->getArgOperand(0);
+        llvm::FixedVectorType *vt = llvm::dyn_cast<llvm::FixedVectorType>(mask->getType());
+        if (vt == NULL || vt->getNumElements() >= 64 ||
+            bits->getZExtValue() != ((uint64_t(1) << vt->getNumElements()) - 1))
+            return NULL;
+    } else if (cast != NULL && cast->getSrcTy()->isVectorTy() && cast->getSrcTy()->getScalarType()->isIntegerTy(1)) {
+        // An i1 mask bitcast to an integer has to be all ones.
+        mask = cast->getOperand(0);
+        if (bits->isMinusOne() == false)
+            return NULL;
+    } else
+        return NULL;
+
+    if (llvm::BitCastInst *maskCast = llvm::dyn_cast<llvm::BitCastInst>(mask))
+        mask = maskCast->getOperand(0);
+    return mask;
+}
+
+/** Replaces the uses of the masks that llvm.assume calls require to be
+    "all on" with a constant "all on" mask, where the assumption is known
+    to hold.  Given assume(all(v)) in code running with the mask m, all()
+    tests (v | !m), and in that case (v & m) is m as well. */
+bool IntrinsicsOpt::propagateMaskAssumptions(llvm::Function &F, llvm::DominatorTree &DT) {
+    bool modifiedAny = false;
+    for (llvm::BasicBlock &BB : F) {
+        for (llvm::Instruction &inst : BB) {
+            llvm::IntrinsicInst *assume = llvm::dyn_cast<llvm::IntrinsicInst>(&inst);
+            if (assume == NULL || assume->getIntrinsicID() != llvm::Intrinsic::assume)
+                continue;
+            llvm::Value *mask = assumedAllOnMask(assume->getArgOperand(0));
+            if (mask == NULL || llvm::isa<llvm::Constant>(mask))
+                continue;
+
+            llvm::Constant *allOn = llvm::Constant::getAllOnesValue(mask->getType());
+            for (llvm::Use &use : llvm::make_early_inc_range(mask->uses())) {
+                if (DT.dominates(assume, use)) {
+                    use.set(allOn);
+                    modifiedAny = true;
+                }
+            }
+
+            using namespace llvm::PatternMatch;
+            llvm::Value *v = NULL, *execMask = NULL;
+            llvm::ICmpInst::Predicate pred;
+            if (!match(mask, m_c_Or(m_Value(v), m_Not(m_Value(execMask)))) &&
+                !(match(mask, m_c_Or(m_Value(v), m_SExt(m_ICmp(pred, m_Value(execMask), m_Zero())))) &&
+                  pred == llvm::ICmpInst::ICMP_EQ))
+                continue;
+            for (llvm::User *user : llvm::make_early_inc_range(v->users())) {
+                llvm::Instruction *andInst = llvm::dyn_cast<llvm::Instruction>(user);
+                if (andInst != NULL && match(andInst, m_c_And(m_Specific(v), m_Specific(execMask))) &&
+                    DT.dominates(assume, andInst)) {
+                    andInst->replaceAllUsesWith(execMask);
+                    modifiedAny = true;
+                }
+            }
+        }
+    }
+    return modifiedAny;
+}
+
+bool IntrinsicsOpt::runOnFunction(llvm::Function &F, llvm::DominatorTree &DT) {
 
     llvm::TimeTraceScope FuncScope("IntrinsicsOpt::runOnFunction", F.getName());
     bool modifiedAny = false;
     for (llvm::BasicBlock &BB : F) {
         modifiedAny |= optimizeIntrinsics(BB);
     }
+    // The mask instructions have been found by now.
+    if (propagateMaskAssumptions(F, DT)) {
+        modifiedAny = true;
+        for (llvm::BasicBlock &BB : F) {
+            optimizeIntrinsics(BB);
+        }
+    }
     return modifiedAny;
 }
 
@@ -245,6 +326,18 @@ IntrinsicsOpt::BlendInstruction *IntrinsicsOpt::matchingBlendInstruction(llvm::F
     return NULL;
 }
 
-llvm::Pass *CreateIntrinsicsOptPass() { return new IntrinsicsOpt; }
+llvm::PreservedAnalyses IntrinsicsOpt::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("IntrinsicsOpt::run", F.getName());
+    llvm::DominatorTree &DT = FAM.getResult<llvm::DominatorTreeAnalysis>(F);
+    bool modifiedAny = runOnFunction(F, DT);
+    if (!modifiedAny) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
 
 } // namespace ispc
@@ -35,27 +35,33 @@
 
 #include "ISPCPass.h"
 
+#include <llvm/IR/Dominators.h>
+
 namespace ispc {
 /** This is a relatively simple optimization pass that does a few small
     optimizations that LLVM's x86 optimizer doesn't currently handle.
     (Specifically, MOVMSK of a constant can be replaced with the
     corresponding constant value, BLENDVPS and AVX masked load/store with
     either an 'all on' or 'all off' masks can be replaced with simpler
-    operations.
+    operations.)  Masks that an assume() of all() tells to be 'all on' are
+    also replaced with that constant where the assumption holds, so that
+    the masked operations that use them can be simplified as well.
 
     @todo The better thing to do would be to submit a patch to LLVM to get
     these; they're presumably pretty simple patterns to match.
 */
-class IntrinsicsOpt : public llvm::FunctionPass {
+class IntrinsicsOpt : public llvm::PassInfoMixin<IntrinsicsOpt> {
   public:
-    static char ID;
-    explicit IntrinsicsOpt() : FunctionPass(ID){};
+    explicit IntrinsicsOpt() {};
 
-    llvm::StringRef getPassName() const override { return "Intrinsics Cleanup Optimization"; }
-    bool runOnFunction(llvm::Function &F) override;
+    static llvm::StringRef name() { return "Intrinsics Cleanup Optimization"; }
+    llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
 
   private:
+    bool runOnFunction(llvm::Function &F, llvm::DominatorTree &DT);
     bool optimizeIntrinsics(llvm::BasicBlock &BB);
+    bool propagateMaskAssumptions(llvm::Function &F, llvm::DominatorTree &DT);
+    llvm::Value *assumedAllOnMask(llvm::Value *cond);
 
     struct MaskInstruction {
         MaskInstruction(llvm::Function *f) { function = f; }
@@ -89,6 +95,4 @@ class IntrinsicsOpt : public llvm::FunctionPass {
     BlendInstruction *matchingBlendInstruction(llvm::Function *function);
 };
 
-llvm::Pass *CreateIntrinsicsOptPass();
-
 } // namespace ispc
\ No newline at end of file
@@ -35,8 +35,6 @@
 
 namespace ispc {
 
-char IsCompileTimeConstantPass::ID = 0;
-
 bool IsCompileTimeConstantPass::lowerCompileTimeConstant(llvm::BasicBlock &bb) {
     DEBUG_START_BB("IsCompileTimeConstantPass");
 
@@ -112,6 +110,17 @@ bool IsCompileTimeConstantPass::runOnFunction(llvm::Function &F) {
     return modifiedAny;
 }
 
-llvm::Pass *CreateIsCompileTimeConstantPass(bool isLastTry) { return new IsCompileTimeConstantPass(isLastTry); }
+llvm::PreservedAnalyses IsCompileTimeConstantPass::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("IsCompileTimeConstantPass::run", F.getName());
+    bool modifiedAny = runOnFunction(F);
+    if (!modifiedAny) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
 
 } // namespace ispc
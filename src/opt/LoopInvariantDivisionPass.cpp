@@ -0,0 +1,229 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "LoopInvariantDivisionPass.h"
+#include "OptRemarks.h"
+
+#include <llvm/Analysis/VectorUtils.h>
+#include <llvm/IR/IRBuilder.h>
+
+#include <map>
+#include <tuple>
+
+namespace ispc {
+
+/** The values the divisions in a loop by the same divisor share, computed
+    in the loop preheader.  All of them are vectors. */
+struct DivisionMagic {
+    // Zero-extended to twice the element width, for the high multiply.
+    llvm::Value *multiplier;
+    llvm::Value *shift1;
+    llvm::Value *shift2;
+    // All bits set for negative divisors of signed divisions.
+    llvm::Value *divisorSign;
+    llvm::Value *divisor;
+};
+
+/** Returns true if the given division is of a vector of integers of a
+    handled width by a splat of a non-constant uniform value. */
+static bool lIsDivisionByUniform(llvm::Instruction *inst) {
+    llvm::BinaryOperator *bop = llvm::dyn_cast<llvm::BinaryOperator>(inst);
+    if (bop == NULL)
+        return false;
+    switch (bop->getOpcode()) {
+    case llvm::Instruction::UDiv:
+    case llvm::Instruction::SDiv:
+    case llvm::Instruction::URem:
+    case llvm::Instruction::SRem:
+        break;
+    default:
+        return false;
+    }
+
+    llvm::VectorType *vecType = llvm::dyn_cast<llvm::VectorType>(bop->getType());
+    if (vecType == NULL)
+        return false;
+    llvm::Type *eltType = vecType->getElementType();
+    if (!eltType->isIntegerTy(32) &&
+        !(eltType->isIntegerTy(64) && !g->target->is32Bit() && g->target_os != TargetOS::windows))
+        return false;
+
+    llvm::Value *divisor = llvm::getSplatValue(bop->getOperand(1));
+    return divisor != NULL && !llvm::isa<llvm::Constant>(divisor);
+}
+
+/** Compute the magic multiplier and the shifts for the (absolute value of
+    the) divisor before the given instruction. */
+static DivisionMagic lComputeMagic(llvm::Value *divisor, bool isSigned, llvm::VectorType *vecType,
+                                   llvm::Instruction *insertBefore) {
+    llvm::IRBuilder<> builder(insertBefore);
+    llvm::Type *type = divisor->getType();
+    const unsigned bits = type->getIntegerBitWidth();
+    llvm::Type *wideType = llvm::IntegerType::get(type->getContext(), 2 * bits);
+    llvm::ElementCount count = vecType->getElementCount();
+
+    DivisionMagic magic;
+    magic.divisor = builder.CreateVectorSplat(count, divisor, "divisor");
+    magic.divisorSign = NULL;
+    llvm::Value *absDivisor = divisor;
+    if (isSigned) {
+        llvm::Value *sign = builder.CreateAShr(divisor, bits - 1, "divisor_sign");
+        absDivisor = builder.CreateSub(builder.CreateXor(divisor, sign), sign, "divisor_abs");
+        magic.divisorSign = builder.CreateVectorSplat(count, sign, "divisor_sign");
+    }
+
+    // The division by zero is undefined; the magic numbers are computed for
+    // a divisor of one then, so that the preheader doesn't trap when the
+    // divisions in the loop aren't executed.
+    llvm::Value *one = llvm::ConstantInt::get(type, 1);
+    llvm::Value *d =
+        builder.CreateSelect(builder.CreateICmpEQ(absDivisor, llvm::ConstantInt::get(type, 0)), one, absDivisor);
+
+    // l = ceil(log2(d)), m = floor(2^N * (2^l - d) / d) + 1
+    llvm::Function *ctlz =
+        llvm::Intrinsic::getDeclaration(insertBefore->getModule(), llvm::Intrinsic::ctlz, {type});
+    llvm::Value *log =
+        builder.CreateSub(llvm::ConstantInt::get(type, bits), builder.CreateCall(ctlz, {builder.CreateSub(d, one),
+                                                                                          builder.getFalse()}));
+    llvm::Value *wideDivisor = builder.CreateZExt(d, wideType);
+    llvm::Value *pow = builder.CreateShl(llvm::ConstantInt::get(wideType, 1), builder.CreateZExt(log, wideType));
+    llvm::Value *numerator = builder.CreateShl(builder.CreateSub(pow, wideDivisor), bits);
+    llvm::Value *multiplier =
+        builder.CreateAdd(builder.CreateUDiv(numerator, wideDivisor), llvm::ConstantInt::get(wideType, 1));
+    multiplier = builder.CreateZExt(builder.CreateTrunc(multiplier, type), wideType);
+    magic.multiplier = builder.CreateVectorSplat(count, multiplier, "div_multiplier");
+
+    // shift1 = min(l, 1), shift2 = max(l - 1, 0)
+    llvm::Value *logIsZero = builder.CreateICmpEQ(log, llvm::ConstantInt::get(type, 0));
+    llvm::Value *shift1 = builder.CreateSelect(logIsZero, llvm::ConstantInt::get(type, 0), one);
+    llvm::Value *shift2 = builder.CreateSelect(logIsZero, llvm::ConstantInt::get(type, 0), builder.CreateSub(log, one));
+    magic.shift1 = builder.CreateVectorSplat(count, shift1, "div_shift1");
+    magic.shift2 = builder.CreateVectorSplat(count, shift2, "div_shift2");
+    return magic;
+}
+
+/** Replace the division or remainder with the multiply and shifts. */
+static void lReplaceDivision(llvm::BinaryOperator *div, const DivisionMagic &magic) {
+    const bool isSigned = div->getOpcode() == llvm::Instruction::SDiv || div->getOpcode() == llvm::Instruction::SRem;
+    const bool isRemainder = div->getOpcode() == llvm::Instruction::URem || div->getOpcode() == llvm::Instruction::SRem;
+    llvm::VectorType *vecType = llvm::cast<llvm::VectorType>(div->getType());
+    const unsigned bits = vecType->getScalarSizeInBits();
+    llvm::VectorType *wideVecType = llvm::VectorType::get(
+        llvm::IntegerType::get(div->getContext(), 2 * bits), vecType->getElementCount());
+
+    llvm::IRBuilder<> builder(div);
+    llvm::Value *n = div->getOperand(0);
+    llvm::Value *absN = n;
+    llvm::Value *quotientSign = NULL;
+    if (isSigned) {
+        llvm::Value *sign = builder.CreateAShr(n, bits - 1, "num_sign");
+        absN = builder.CreateSub(builder.CreateXor(n, sign), sign, "num_abs");
+        quotientSign = builder.CreateXor(sign, magic.divisorSign, "quot_sign");
+    }
+
+    // t = mulhi(m, n), q = (t + ((n - t) >> shift1)) >> shift2
+    llvm::Value *t = builder.CreateMul(builder.CreateZExt(absN, wideVecType), magic.multiplier);
+    t = builder.CreateTrunc(builder.CreateLShr(t, bits), vecType, "mulhi");
+    llvm::Value *q = builder.CreateLShr(builder.CreateSub(absN, t), magic.shift1);
+    q = builder.CreateLShr(builder.CreateAdd(t, q), magic.shift2, "quot");
+    if (isSigned)
+        q = builder.CreateSub(builder.CreateXor(q, quotientSign), quotientSign, "quot");
+
+    llvm::Value *result = q;
+    if (isRemainder)
+        result = builder.CreateSub(n, builder.CreateMul(q, magic.divisor), "rem");
+    result->takeName(div);
+    div->replaceAllUsesWith(result);
+    div->eraseFromParent();
+}
+
+bool LoopInvariantDivisionPass::runOnFunction(llvm::Function &F, llvm::LoopInfo &LI) {
+    llvm::TimeTraceScope FuncScope("LoopInvariantDivisionPass::runOnFunction", F.getName());
+
+    // The divisions are collected first, since they are replaced.
+    std::vector<llvm::BinaryOperator *> divisions;
+    for (llvm::BasicBlock &BB : F) {
+        llvm::Loop *L = LI.getLoopFor(&BB);
+        if (L == NULL)
+            continue;
+        for (llvm::Instruction &inst : BB) {
+            if (lIsDivisionByUniform(&inst) && L->isLoopInvariant(llvm::getSplatValue(inst.getOperand(1))))
+                divisions.push_back(llvm::cast<llvm::BinaryOperator>(&inst));
+        }
+    }
+
+    // The magic numbers are shared by the divisions by the same divisor and
+    // computed before the outermost loop the divisor is invariant in.
+    std::map<std::tuple<llvm::Loop *, llvm::Value *, bool>, DivisionMagic> magics;
+    bool modifiedAny = false;
+    for (llvm::BinaryOperator *div : divisions) {
+        llvm::Value *divisor = llvm::getSplatValue(div->getOperand(1));
+        llvm::Loop *L = LI.getLoopFor(div->getParent());
+        if (L->getLoopPreheader() == NULL)
+            continue;
+        while (L->getParentLoop() != NULL && L->getParentLoop()->isLoopInvariant(divisor) &&
+               L->getParentLoop()->getLoopPreheader() != NULL)
+            L = L->getParentLoop();
+
+        const bool isSigned = div->getOpcode() == llvm::Instruction::SDiv || div->getOpcode() == llvm::Instruction::SRem;
+        auto key = std::make_tuple(L, divisor, isSigned);
+        auto it = magics.find(key);
+        if (it == magics.end()) {
+            DivisionMagic magic = lComputeMagic(divisor, isSigned, llvm::cast<llvm::VectorType>(div->getType()),
+                                                L->getLoopPreheader()->getTerminator());
+            it = magics.insert({key, magic}).first;
+        }
+
+        EmitOptRemark(OptRemarkKind::Passed, "LoopInvariantDivision", "DivisionStrengthReduced", div,
+                      "division by loop invariant uniform value replaced with multiplication");
+        lReplaceDivision(div, it->second);
+        modifiedAny = true;
+    }
+    return modifiedAny;
+}
+
+llvm::PreservedAnalyses LoopInvariantDivisionPass::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("LoopInvariantDivisionPass::run", F.getName());
+    llvm::LoopInfo &LI = FAM.getResult<llvm::LoopAnalysis>(F);
+    bool modifiedAny = runOnFunction(F, LI);
+    if (!modifiedAny) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
+
+} // namespace ispc
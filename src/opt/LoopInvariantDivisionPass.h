@@ -0,0 +1,69 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "ISPCPass.h"
+
+#include <llvm/Analysis/LoopInfo.h>
+
+namespace ispc {
+
+// This pass strength-reduces divisions and remainders of varying int32
+// and int64 values by a uniform divisor that is invariant in a loop, like
+// "hash % tableSize" in the body of a foreach loop.  There are no vector
+// integer division instructions on the CPU targets, so such divisions are
+// otherwise done one program instance at a time.
+//
+// The magic number and shifts of the round-up method (Granlund and
+// Montgomery, "Division by Invariant Integers using Multiplication") are
+// computed from the divisor in the loop preheader, and the divisions in
+// the loop are replaced with a high multiply, an add and shifts, which
+// work for any divisor.  Signed divisions divide the absolute values and
+// fix up the sign of the quotient; remainders are computed from the
+// quotients.  The 64-bit variant needs 128-bit multiplies and a 128-bit
+// division in the preheader, so it's only used on 64-bit targets other
+// than Windows, where the latter is available from the compiler runtime.
+
+class LoopInvariantDivisionPass : public llvm::PassInfoMixin<LoopInvariantDivisionPass> {
+  public:
+    explicit LoopInvariantDivisionPass() {}
+
+    static llvm::StringRef name() { return "Strength-reduce Loop Invariant Division"; }
+    llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+
+  private:
+    bool runOnFunction(llvm::Function &F, llvm::LoopInfo &LI);
+};
+
+} // namespace ispc
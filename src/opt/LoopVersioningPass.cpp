@@ -0,0 +1,377 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "LoopVersioningPass.h"
+
+#include <llvm/Analysis/ScalarEvolutionExpressions.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/Transforms/Utils/BasicBlockUtils.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/LoopUtils.h>
+#include <llvm/Transforms/Utils/ScalarEvolutionExpander.h>
+
+namespace ispc {
+
+/** Maximum number of pairs of arrays checked for overlap before entering
+    a loop; beyond that, only the alignment is versioned on. */
+static const int lMaxOverlapChecks = 8;
+
+/** A load or store in the loop whose address is an affine recurrence of
+    the loop with a constant step. */
+struct VersionedAccess {
+    llvm::Instruction *inst;
+    // Address accessed in the first iteration, as an integer SCEV.
+    const llvm::SCEV *start;
+    // Number of bytes the address advances by on each iteration.
+    int64_t stride;
+    // Number of bytes accessed.
+    uint64_t size;
+    bool isStore;
+};
+
+/** A group of accesses to the same array, i.e. whose addresses differ
+    by compile-time constants.  low and high bound the bytes the group
+    accesses over all iterations of the loop. */
+struct AccessGroup {
+    const llvm::SCEV *low, *high;
+    bool hasStore;
+    std::vector<llvm::Instruction *> members;
+    std::vector<int> noAliasGroups;
+};
+
+/** If the difference a - b is a compile-time constant, store it in delta
+    and return true. */
+static bool lConstantDelta(const llvm::SCEV *a, const llvm::SCEV *b, llvm::ScalarEvolution &SE, int64_t *delta) {
+    const llvm::SCEVConstant *diff = llvm::dyn_cast<llvm::SCEVConstant>(SE.getMinusSCEV(a, b));
+    if (diff == NULL || diff->getAPInt().getBitWidth() > 64)
+        return false;
+    *delta = diff->getAPInt().getSExtValue();
+    return true;
+}
+
+/** Add the range [low, high) accessed by the given instruction to the
+    group of accesses to the same array, or start a new group for it. */
+static void lAddToGroup(std::vector<AccessGroup> &groups, const VersionedAccess &access, const llvm::SCEV *low,
+                        const llvm::SCEV *high, llvm::ScalarEvolution &SE) {
+    for (AccessGroup &group : groups) {
+        int64_t lowDelta, highDelta;
+        if (!lConstantDelta(low, group.low, SE, &lowDelta) || !lConstantDelta(high, group.high, SE, &highDelta))
+            continue;
+        if (lowDelta < 0)
+            group.low = low;
+        if (highDelta > 0)
+            group.high = high;
+        group.hasStore |= access.isStore;
+        group.members.push_back(access.inst);
+        return;
+    }
+
+    AccessGroup group;
+    group.low = low;
+    group.high = high;
+    group.hasStore = access.isStore;
+    group.members.push_back(access.inst);
+    groups.push_back(group);
+}
+
+/** Returns true if the address of one of the given starting addresses is
+    aligned whenever start is, so that start doesn't need its own check. */
+static bool lAlignmentIsChecked(const std::vector<const llvm::SCEV *> &checked, const llvm::SCEV *start,
+                                int alignment, llvm::ScalarEvolution &SE) {
+    for (const llvm::SCEV *s : checked) {
+        int64_t delta;
+        if (lConstantDelta(start, s, SE, &delta) && (delta % alignment) == 0)
+            return true;
+    }
+    return false;
+}
+
+/** Append the given scope to the scope list metadata of kind kind of the
+    instruction. */
+static void lAddScope(llvm::Instruction *inst, unsigned kind, llvm::MDNode *scope) {
+    llvm::MDNode *scopeList = llvm::MDNode::get(inst->getContext(), scope);
+    inst->setMetadata(kind, llvm::MDNode::concatenate(inst->getMetadata(kind), scopeList));
+}
+
+bool LoopVersioningPass::versionLoop(llvm::Loop *L, llvm::LoopInfo &LI, llvm::DominatorTree &DT,
+                                     llvm::ScalarEvolution &SE) {
+    llvm::BasicBlock *exitBB = L->getExitBlock();
+    if (!L->isLoopSimplifyForm() || exitBB == NULL)
+        return false;
+
+    const llvm::DataLayout &DL = L->getHeader()->getModule()->getDataLayout();
+    std::vector<VersionedAccess> accesses;
+    for (llvm::BasicBlock *BB : L->blocks()) {
+        for (llvm::Instruction &inst : *BB) {
+            llvm::Value *ptr = NULL;
+            llvm::Type *type = NULL;
+            if (llvm::LoadInst *load = llvm::dyn_cast<llvm::LoadInst>(&inst)) {
+                if (!load->isSimple())
+                    continue;
+                ptr = load->getPointerOperand();
+                type = load->getType();
+            } else if (llvm::StoreInst *store = llvm::dyn_cast<llvm::StoreInst>(&inst)) {
+                if (!store->isSimple())
+                    continue;
+                ptr = store->getPointerOperand();
+                type = store->getValueOperand()->getType();
+            } else
+                continue;
+
+            if (ptr->getType()->getPointerAddressSpace() != 0)
+                continue;
+            const llvm::SCEVAddRecExpr *addRec = llvm::dyn_cast<llvm::SCEVAddRecExpr>(SE.getSCEV(ptr));
+            if (addRec == NULL || addRec->getLoop() != L || !addRec->isAffine())
+                continue;
+            const llvm::SCEVConstant *step = llvm::dyn_cast<llvm::SCEVConstant>(addRec->getStepRecurrence(SE));
+            if (step == NULL || step->getAPInt().getBitWidth() > 64)
+                continue;
+
+            llvm::Type *intPtrType = SE.getEffectiveSCEVType(ptr->getType());
+            const llvm::SCEV *start = SE.getPtrToIntExpr(addRec->getStart(), intPtrType);
+            if (llvm::isa<llvm::SCEVCouldNotCompute>(start))
+                continue;
+
+            VersionedAccess access;
+            access.inst = &inst;
+            access.start = start;
+            access.stride = step->getAPInt().getSExtValue();
+            access.size = DL.getTypeStoreSize(type);
+            access.isStore = llvm::isa<llvm::StoreInst>(inst);
+            accesses.push_back(access);
+        }
+    }
+
+    // Vector accesses that are unaligned now but would be aligned in all
+    // iterations if their first one is.
+    std::vector<llvm::Instruction *> alignInsts;
+    std::vector<const llvm::SCEV *> alignStarts;
+    for (const VersionedAccess &access : accesses) {
+        llvm::Align currentAlign = llvm::isa<llvm::LoadInst>(access.inst)
+                                       ? llvm::cast<llvm::LoadInst>(access.inst)->getAlign()
+                                       : llvm::cast<llvm::StoreInst>(access.inst)->getAlign();
+        bool isVector = llvm::isa<llvm::StoreInst>(access.inst)
+                            ? llvm::cast<llvm::StoreInst>(access.inst)->getValueOperand()->getType()->isVectorTy()
+                            : access.inst->getType()->isVectorTy();
+        if (!isVector || currentAlign.value() >= (uint64_t)alignment || (access.size % alignment) != 0 ||
+            (access.stride % alignment) != 0)
+            continue;
+
+        alignInsts.push_back(access.inst);
+        if (!lAlignmentIsChecked(alignStarts, access.start, alignment, SE))
+            alignStarts.push_back(access.start);
+    }
+
+    // Group the accesses by array; that's only possible if the number of
+    // iterations can be computed when entering the loop.
+    std::vector<AccessGroup> groups;
+    const llvm::SCEV *backedgeCount = SE.getBackedgeTakenCount(L);
+    if (!llvm::isa<llvm::SCEVCouldNotCompute>(backedgeCount)) {
+        for (const VersionedAccess &access : accesses) {
+            if (access.stride <= 0)
+                continue;
+            // The last iteration accesses start + backedgeCount * stride.
+            llvm::Type *intPtrType = access.start->getType();
+            const llvm::SCEV *last = SE.getAddExpr(
+                access.start, SE.getMulExpr(SE.getTruncateOrZeroExtend(backedgeCount, intPtrType),
+                                            SE.getConstant(intPtrType, access.stride)));
+            const llvm::SCEV *high = SE.getAddExpr(last, SE.getConstant(intPtrType, access.size));
+            lAddToGroup(groups, access, access.start, high, SE);
+        }
+    }
+
+    // Pairs of groups that need to be checked for overlap.
+    std::vector<std::pair<int, int>> overlapChecks;
+    for (int i = 0; i < (int)groups.size(); ++i) {
+        for (int j = i + 1; j < (int)groups.size(); ++j) {
+            if ((groups[i].hasStore || groups[j].hasStore) && groups[i].low->getType() == groups[j].low->getType())
+                overlapChecks.push_back(std::make_pair(i, j));
+        }
+    }
+    if ((int)overlapChecks.size() > lMaxOverlapChecks)
+        overlapChecks.clear();
+
+    if (alignStarts.empty() && overlapChecks.empty())
+        return false;
+
+    if (!L->isLCSSAForm(DT))
+        llvm::formLCSSA(*L, DT, &LI, &SE);
+
+    // Emit the checks in the preheader; the result is true if the fast
+    // version of the loop can't be used.
+    llvm::BasicBlock *checkBB = L->getLoopPreheader();
+    llvm::Instruction *insertBefore = checkBB->getTerminator();
+    llvm::SCEVExpander expander(SE, DL, "lver");
+    llvm::Value *useFallback = NULL;
+
+    if (!alignStarts.empty()) {
+        // The starting addresses are or'ed together, so that a single
+        // test of the low bits checks them all.
+        llvm::Value *addrBits = NULL;
+        for (const llvm::SCEV *start : alignStarts) {
+            llvm::Value *addr = expander.expandCodeFor(start, start->getType(), insertBefore);
+            addrBits = addrBits == NULL ? addr
+                                        : llvm::BinaryOperator::Create(llvm::Instruction::Or, addrBits, addr,
+                                                                       "lver_addr_bits", insertBefore);
+        }
+        llvm::Value *lowBits =
+            llvm::BinaryOperator::Create(llvm::Instruction::And, addrBits,
+                                         llvm::ConstantInt::get(addrBits->getType(), alignment - 1), "lver_low_bits",
+                                         insertBefore);
+        useFallback = new llvm::ICmpInst(insertBefore, llvm::ICmpInst::ICMP_NE, lowBits,
+                                         llvm::ConstantInt::get(addrBits->getType(), 0), "lver_misaligned");
+    }
+
+    for (const std::pair<int, int> &check : overlapChecks) {
+        AccessGroup &a = groups[check.first], &b = groups[check.second];
+        llvm::Type *intPtrType = a.low->getType();
+        llvm::Value *lowA = expander.expandCodeFor(a.low, intPtrType, insertBefore);
+        llvm::Value *highA = expander.expandCodeFor(a.high, intPtrType, insertBefore);
+        llvm::Value *lowB = expander.expandCodeFor(b.low, intPtrType, insertBefore);
+        llvm::Value *highB = expander.expandCodeFor(b.high, intPtrType, insertBefore);
+        // [lowA, highA) and [lowB, highB) overlap if lowA < highB and lowB < highA.
+        llvm::Value *aBeforeEndB =
+            new llvm::ICmpInst(insertBefore, llvm::ICmpInst::ICMP_ULT, lowA, highB, "lver_a_before_end_b");
+        llvm::Value *bBeforeEndA =
+            new llvm::ICmpInst(insertBefore, llvm::ICmpInst::ICMP_ULT, lowB, highA, "lver_b_before_end_a");
+        llvm::Value *overlap = llvm::BinaryOperator::Create(llvm::Instruction::And, aBeforeEndB, bBeforeEndA,
+                                                            "lver_overlap", insertBefore);
+        useFallback = useFallback == NULL ? overlap
+                                          : llvm::BinaryOperator::Create(llvm::Instruction::Or, useFallback, overlap,
+                                                                         "lver_use_fallback", insertBefore);
+        a.noAliasGroups.push_back(check.second);
+        b.noAliasGroups.push_back(check.first);
+    }
+
+    // Clone the loop, including a new empty preheader, for the fallback
+    // version; the original loop becomes the fast one.
+    llvm::BasicBlock *preheader = llvm::SplitBlock(checkBB, insertBefore, &DT, &LI, NULL,
+                                                   L->getHeader()->getName() + ".lver.ph");
+    llvm::ValueToValueMapTy VMap;
+    llvm::SmallVector<llvm::BasicBlock *, 8> fallbackBlocks;
+    llvm::Loop *fallback =
+        llvm::cloneLoopWithPreheader(preheader, checkBB, L, VMap, ".lver.orig", &LI, &DT, fallbackBlocks);
+    llvm::remapInstructionsInBlocks(fallbackBlocks, VMap);
+
+    llvm::Instruction *checkTerm = checkBB->getTerminator();
+    llvm::BranchInst::Create(fallback->getLoopPreheader(), preheader, useFallback, checkTerm);
+    checkTerm->eraseFromParent();
+    checkBB->setName(L->getHeader()->getName() + ".lver.check");
+
+    // The values live out of the loop (which are all used by LCSSA phis
+    // in the exit block) now also come from the fallback loop.
+    for (llvm::PHINode &phi : exitBB->phis()) {
+        unsigned numIncoming = phi.getNumIncomingValues();
+        for (unsigned i = 0; i < numIncoming; ++i) {
+            llvm::BasicBlock *incomingBB = phi.getIncomingBlock(i);
+            if (!L->contains(incomingBB))
+                continue;
+            llvm::Value *value = phi.getIncomingValue(i);
+            llvm::ValueToValueMapTy::iterator mapped = VMap.find(value);
+            if (mapped != VMap.end())
+                value = mapped->second;
+            phi.addIncoming(value, llvm::cast<llvm::BasicBlock>(VMap[incomingBB]));
+        }
+        SE.forgetValue(&phi);
+    }
+    DT.changeImmediateDominator(exitBB, checkBB);
+    SE.forgetLoop(L);
+
+    // Finally, mark up the accesses in the fast loop.
+    for (llvm::Instruction *inst : alignInsts) {
+        if (llvm::LoadInst *load = llvm::dyn_cast<llvm::LoadInst>(inst))
+            load->setAlignment(llvm::Align(alignment));
+        else
+            llvm::cast<llvm::StoreInst>(inst)->setAlignment(llvm::Align(alignment));
+    }
+
+    if (!overlapChecks.empty()) {
+        llvm::MDBuilder mdBuilder(L->getHeader()->getContext());
+        llvm::MDNode *domain = mdBuilder.createAnonymousAliasScopeDomain("ISPCLoopVersioning");
+        std::vector<llvm::MDNode *> scopes;
+        for (size_t i = 0; i < groups.size(); ++i)
+            scopes.push_back(mdBuilder.createAnonymousAliasScope(domain));
+
+        for (size_t i = 0; i < groups.size(); ++i) {
+            if (groups[i].noAliasGroups.empty())
+                continue;
+            for (llvm::Instruction *inst : groups[i].members) {
+                lAddScope(inst, llvm::LLVMContext::MD_alias_scope, scopes[i]);
+                for (int other : groups[i].noAliasGroups)
+                    lAddScope(inst, llvm::LLVMContext::MD_noalias, scopes[other]);
+            }
+        }
+    }
+
+    Debug(SourcePos(), "Versioned loop %s on %d alignment and %d overlap checks.",
+          L->getHeader()->getName().str().c_str(), (int)alignStarts.size(), (int)overlapChecks.size());
+    return true;
+}
+
+bool LoopVersioningPass::runOnFunction(llvm::Function &F, llvm::LoopInfo &LI, llvm::DominatorTree &DT,
+                                       llvm::ScalarEvolution &SE) {
+    llvm::TimeTraceScope FuncScope("LoopVersioningPass::runOnFunction", F.getName());
+
+    // The loops are collected first, since versioning adds new ones.
+    std::vector<llvm::Loop *> innermostLoops;
+    for (llvm::Loop *L : LI.getLoopsInPreorder()) {
+        if (L->isInnermost())
+            innermostLoops.push_back(L);
+    }
+
+    bool modifiedAny = false;
+    for (llvm::Loop *L : innermostLoops)
+        modifiedAny |= versionLoop(L, LI, DT, SE);
+
+    return modifiedAny;
+}
+
+llvm::PreservedAnalyses LoopVersioningPass::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("LoopVersioningPass::run", F.getName());
+    llvm::LoopInfo &LI = FAM.getResult<llvm::LoopAnalysis>(F);
+    llvm::DominatorTree &DT = FAM.getResult<llvm::DominatorTreeAnalysis>(F);
+    llvm::ScalarEvolution &SE = FAM.getResult<llvm::ScalarEvolutionAnalysis>(F);
+    bool modifiedAny = runOnFunction(F, LI, DT, SE);
+    if (!modifiedAny) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    // The loop and dominator tree analyses are kept up to date.
+    llvm::PreservedAnalyses PA;
+    PA.preserve<llvm::LoopAnalysis>();
+    PA.preserve<llvm::DominatorTreeAnalysis>();
+    return PA;
+}
+
+} // namespace ispc
@@ -0,0 +1,81 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "ISPCPass.h"
+
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/Analysis/ScalarEvolution.h>
+#include <llvm/IR/Dominators.h>
+
+namespace ispc {
+
+// This pass versions innermost loops (e.g. the full-vector body of a
+// foreach loop) on a runtime check of the arrays they access.  The
+// arrays passed to exported functions are usually aligned and don't
+// overlap, but the compiler can't assume either in general, so the memory
+// operations in the loop are issued as unaligned and may alias each
+// other.
+//
+// For each loop, the vector loads and stores whose addresses are affine
+// recurrences of the loop are collected and two conditions are checked
+// in the loop preheader:
+//
+//  - The starting addresses of the accesses are aligned to the native
+//    vector alignment of the target (the per-iteration strides being
+//    multiples of it is checked at compile time).
+//
+//  - The address ranges covered by the accesses to different arrays over
+//    the whole loop don't overlap if at least one of them is stored to.
+//
+// If both hold, a copy of the loop where the accesses are marked as
+// aligned and as not aliasing each other (via scoped noalias metadata) is
+// executed; otherwise the original loop is.  The pass only runs with
+// --opt=loop-versioning, since it duplicates the versioned loops.
+
+class LoopVersioningPass : public llvm::PassInfoMixin<LoopVersioningPass> {
+  public:
+    explicit LoopVersioningPass(int alignment) : alignment(alignment) {}
+
+    static llvm::StringRef name() { return "Loop Versioning"; }
+    llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+
+  private:
+    bool runOnFunction(llvm::Function &F, llvm::LoopInfo &LI, llvm::DominatorTree &DT, llvm::ScalarEvolution &SE);
+    bool versionLoop(llvm::Loop *L, llvm::LoopInfo &LI, llvm::DominatorTree &DT, llvm::ScalarEvolution &SE);
+    // Alignment in bytes the accesses in the fast version of the loop get.
+    int alignment;
+};
+
+} // namespace ispc
@@ -35,8 +35,6 @@
 
 namespace ispc {
 
-char MakeInternalFuncsStaticPass::ID = 0;
-
 bool MakeInternalFuncsStaticPass::runOnModule(llvm::Module &module) {
     const char *names[] = {
         "__avg_up_uint8",
@@ -125,6 +123,8 @@ bool MakeInternalFuncsStaticPass::runOnModule(llvm::Module &module) {
         "__masked_store_blend_half",
         "__masked_store_blend_float",
         "__masked_store_blend_double",
+        "__muladd_varying_float",
+        "__muladd_varying_double",
         "__scatter_factored_base_offsets32_i8",
         "__scatter_factored_base_offsets32_i16",
         "__scatter_factored_base_offsets32_i32",
@@ -213,6 +213,18 @@ bool MakeInternalFuncsStaticPass::runOnModule(llvm::Module &module) {
     return modifiedAny;
 }
 
-llvm::Pass *CreateMakeInternalFuncsStaticPass() { return new MakeInternalFuncsStaticPass; }
+llvm::PreservedAnalyses MakeInternalFuncsStaticPass::run(llvm::Module &module, llvm::ModuleAnalysisManager &MAM) {
+    llvm::TimeTraceScope FuncScope("MakeInternalFuncsStaticPass::run", module.getName());
+    bool modifiedAny = runOnModule(module);
+    if (!modifiedAny) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    // Only linkage is changed, so the CFG of every function stays intact.
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
 
 } // namespace ispc
\ No newline at end of file
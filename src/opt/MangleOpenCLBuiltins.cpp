@@ -37,8 +37,6 @@
 
 namespace ispc {
 
-char MangleOpenCLBuiltins::ID = 0;
-
 static std::string mangleMathOCLBuiltin(const llvm::Function &func) {
     Assert(func.getName().startswith("__spirv_ocl") && "wrong argument: ocl builtin is expected");
     std::string mangledName;
@@ -149,7 +147,18 @@ bool MangleOpenCLBuiltins::runOnFunction(llvm::Function &F) {
     return modifiedAny;
 }
 
-llvm::Pass *CreateMangleOpenCLBuiltins() { return new MangleOpenCLBuiltins(); }
+llvm::PreservedAnalyses MangleOpenCLBuiltins::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("MangleOpenCLBuiltins::run", F.getName());
+    bool modifiedAny = runOnFunction(F);
+    if (!modifiedAny) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
 
 } // namespace ispc
 
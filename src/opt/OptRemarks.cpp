@@ -0,0 +1,106 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "OptRemarks.h"
+
+#include <stdarg.h>
+
+#include <llvm/IR/DiagnosticInfo.h>
+#include <llvm/IR/LLVMRemarkStreamer.h>
+#include <llvm/Remarks/RemarkStreamer.h>
+
+namespace ispc {
+
+void EmitOptRemark(OptRemarkKind kind, const char *pass, const char *name, const llvm::Instruction *inst,
+                   const char *fmt, ...) {
+    if (inst->getContext().getLLVMRemarkStreamer() == nullptr) {
+        return;
+    }
+
+    char message[1024];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(message, sizeof(message), fmt, args);
+    va_end(args);
+
+    auto emit = [&](llvm::DiagnosticInfoIROptimization &remark) {
+        SourcePos pos;
+        if (!inst->getDebugLoc() && LLVMGetSourcePosFromMetadata(inst, &pos)) {
+            std::string loc = std::string(pos.name) + ":" + std::to_string(pos.first_line) + ":" +
+                              std::to_string(pos.first_column);
+            remark << llvm::DiagnosticInfoOptimizationBase::Argument("ISPCLoc", loc) << ": ";
+        }
+        remark << message;
+        inst->getContext().diagnose(remark);
+    };
+
+    switch (kind) {
+    case OptRemarkKind::Passed: {
+        llvm::OptimizationRemark remark(pass, name, inst);
+        emit(remark);
+        break;
+    }
+    case OptRemarkKind::Missed: {
+        llvm::OptimizationRemarkMissed remark(pass, name, inst);
+        emit(remark);
+        break;
+    }
+    case OptRemarkKind::Analysis: {
+        llvm::OptimizationRemarkAnalysis remark(pass, name, inst);
+        emit(remark);
+        break;
+    }
+    }
+}
+
+OptRecordFile::OptRecordFile(llvm::LLVMContext &ctx, const std::string &fileName) : ctx(ctx) {
+    auto result = llvm::setupLLVMOptimizationRemarks(ctx, fileName, "", g->optRecordFormat, false);
+    if (!result) {
+        Error(SourcePos(), "Can't open optimization record file \"%s\": %s", fileName.c_str(),
+              llvm::toString(result.takeError()).c_str());
+        return;
+    }
+    file = std::move(*result);
+}
+
+OptRecordFile::~OptRecordFile() {
+    if (!file) {
+        return;
+    }
+    // The remark streamers write to the file, so they go away first.
+    ctx.setLLVMRemarkStreamer(nullptr);
+    ctx.setMainRemarkStreamer(nullptr);
+    file->keep();
+}
+
+} // namespace ispc
@@ -0,0 +1,74 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/** @file OptRemarks.h
+    @brief Optimization remarks of ISPC passes (--save-opt-record).
+*/
+
+#pragma once
+
+#include "ISPCPass.h"
+
+#include <memory>
+#include <string>
+
+#include <llvm/Support/ToolOutputFile.h>
+
+namespace ispc {
+
+enum class OptRemarkKind { Passed, Missed, Analysis };
+
+/** Emits an LLVM optimization remark about the instruction on behalf of the
+    given pass.  The message is given printf-style.  Remarks are only built
+    when an optimization record file is open (see OptRecordFile); they get
+    the source position of the instruction when debug information is
+    generated and an "ISPCLoc" argument with the position from ISPC metadata
+    otherwise.  The pass and remark names must be string literals.
+ */
+void EmitOptRemark(OptRemarkKind kind, const char *pass, const char *name, const llvm::Instruction *inst,
+                   const char *fmt, ...);
+
+/** Writes the optimization remarks emitted in the given context during its
+    lifetime to the given file, in the format set by --opt-record-format.
+ */
+class OptRecordFile {
+  public:
+    OptRecordFile(llvm::LLVMContext &ctx, const std::string &fileName);
+    ~OptRecordFile();
+
+  private:
+    llvm::LLVMContext &ctx;
+    std::unique_ptr<llvm::ToolOutputFile> file;
+};
+
+} // namespace ispc
@@ -0,0 +1,110 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "PassStats.h"
+
+namespace ispc {
+
+IRSize GetIRSize(const llvm::Function &F) {
+    IRSize size;
+    for (const llvm::BasicBlock &BB : F) {
+        size.instructions += BB.size();
+        for (const llvm::Instruction &I : BB) {
+            const llvm::CallInst *CI = llvm::dyn_cast<llvm::CallInst>(&I);
+            if (CI == nullptr || CI->getCalledFunction() == nullptr) {
+                continue;
+            }
+            llvm::StringRef callee = CI->getCalledFunction()->getName();
+            if (callee.startswith("__pseudo_gather")) {
+                size.pseudoGathers++;
+            } else if (callee.startswith("__pseudo_scatter")) {
+                size.pseudoScatters++;
+            }
+        }
+    }
+    return size;
+}
+
+IRSize GetIRSize(const llvm::Module &M) {
+    IRSize size;
+    for (const llvm::Function &F : M) {
+        IRSize fsize = GetIRSize(F);
+        size.instructions += fsize.instructions;
+        size.pseudoGathers += fsize.pseudoGathers;
+        size.pseudoScatters += fsize.pseudoScatters;
+    }
+    return size;
+}
+
+int PassStatsCollector::addPhase(int number, llvm::StringRef pass) {
+    phases.emplace_back(number, pass);
+    return phases.size() - 1;
+}
+
+void PassStatsCollector::record(int index, const IRSize &before, const IRSize &after,
+                                std::chrono::steady_clock::duration time) {
+    PhaseStats &phase = phases[index];
+    phase.runs++;
+    phase.seconds += std::chrono::duration<double>(time).count();
+    phase.before.instructions += before.instructions;
+    phase.before.pseudoGathers += before.pseudoGathers;
+    phase.before.pseudoScatters += before.pseudoScatters;
+    phase.after.instructions += after.instructions;
+    phase.after.pseudoGathers += after.pseudoGathers;
+    phase.after.pseudoScatters += after.pseudoScatters;
+}
+
+void PassStatsCollector::print(llvm::raw_ostream &os, const llvm::Module &M) const {
+    llvm::json::OStream J(os);
+    J.object([&] {
+        J.attribute("module", M.getSourceFileName());
+        J.attribute("target", ISPCTargetToString(g->target->getISPCTarget()));
+        J.attributeArray("phases", [&] {
+            for (const PhaseStats &phase : phases) {
+                J.object([&] {
+                    J.attribute("phase", phase.number);
+                    J.attribute("pass", phase.pass);
+                    J.attribute("runs", phase.runs);
+                    J.attribute("time_ms", phase.seconds * 1000.0);
+                    J.attribute("instructions_before", static_cast<int64_t>(phase.before.instructions));
+                    J.attribute("instructions_after", static_cast<int64_t>(phase.after.instructions));
+                    J.attribute("pseudo_gathers", static_cast<int64_t>(phase.after.pseudoGathers));
+                    J.attribute("pseudo_scatters", static_cast<int64_t>(phase.after.pseudoScatters));
+                });
+            }
+        });
+    });
+    os << "\n";
+}
+
+} // namespace ispc
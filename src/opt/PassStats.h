@@ -0,0 +1,125 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/** @file PassStats.h
+    @brief Collection of per-phase optimization statistics (--print-pass-stats).
+*/
+
+#pragma once
+
+#include "ISPCPass.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <llvm/Support/JSON.h>
+
+namespace ispc {
+
+/** Size of a piece of IR: the number of instructions and the number of
+    __pseudo_gather and __pseudo_scatter calls that are still left in it.
+ */
+struct IRSize {
+    uint64_t instructions{0};
+    uint64_t pseudoGathers{0};
+    uint64_t pseudoScatters{0};
+};
+
+IRSize GetIRSize(const llvm::Function &F);
+IRSize GetIRSize(const llvm::Module &M);
+
+/** Statistics of a single optimization phase. When a phase is run several
+    times (for example, a function pass is run for every function of the
+    module), the numbers are accumulated over all of the runs.
+ */
+struct PhaseStats {
+    PhaseStats(int number, llvm::StringRef pass) : number(number), pass(pass.str()) {}
+
+    int number;
+    std::string pass;
+    unsigned runs{0};
+    double seconds{0};
+    IRSize before;
+    IRSize after;
+};
+
+/** This class collects statistics of the phases added to the optimization
+    pipeline and prints them in JSON format.
+ */
+class PassStatsCollector {
+  public:
+    /** Adds a new phase and returns its index to be used in record(). */
+    int addPhase(int number, llvm::StringRef pass);
+    void record(int index, const IRSize &before, const IRSize &after, std::chrono::steady_clock::duration time);
+
+    /** Prints statistics of the module as a single line JSON object, so
+        statistics of several compilations may be appended to one file. */
+    void print(llvm::raw_ostream &os, const llvm::Module &M) const;
+
+  private:
+    std::vector<PhaseStats> phases;
+};
+
+/** This is a wrap over optimization pass of IR unit IRUnitT (llvm::Module or
+    llvm::Function). It measures the wall time of the pass and the IR size before
+    and after it and adds them to the statistics of the corresponding phase.
+ */
+template <typename IRUnitT, typename PassT>
+class PassStatsWrapper : public llvm::PassInfoMixin<PassStatsWrapper<IRUnitT, PassT>> {
+  public:
+    explicit PassStatsWrapper(PassT &&P, PassStatsCollector *C, int index)
+        : pass(std::move(P)), collector(C), index(index) {}
+
+    static llvm::StringRef name() { return PassT::name(); }
+    static bool isRequired() { return isPassRequired<PassT>(0); }
+    llvm::PreservedAnalyses run(IRUnitT &IR, llvm::AnalysisManager<IRUnitT> &AM) {
+        IRSize before = GetIRSize(IR);
+        auto start = std::chrono::steady_clock::now();
+        llvm::PreservedAnalyses PA = pass.run(IR, AM);
+        auto time = std::chrono::steady_clock::now() - start;
+        collector->record(index, before, GetIRSize(IR), time);
+        return PA;
+    }
+
+  private:
+    // Wrapped pass is skipped (e.g. for optnone functions) in the same cases as the original one.
+    template <typename T> static auto isPassRequired(int) -> decltype(T::isRequired()) { return T::isRequired(); }
+    template <typename T> static bool isPassRequired(...) { return false; }
+
+    PassT pass;
+    PassStatsCollector *collector;
+    int index;
+};
+
+} // namespace ispc
@@ -35,8 +35,6 @@
 
 namespace ispc {
 
-char PeepholePass::ID = 0;
-
 using namespace llvm::PatternMatch;
 
 template <typename Op_t, unsigned Opcode> struct CastClassTypes_match {
@@ -170,8 +168,40 @@ static llvm::Instruction *lGetBinaryIntrinsic(const char *name, llvm::Value *opa
         return NULL;
 }
 
+static llvm::Instruction *lGetTernaryIntrinsic(const char *name, llvm::Value *opa, llvm::Value *opb,
+                                               llvm::Value *opc) {
+    // Unlike the __avg_* ones, these builtins are optional and are only
+    // provided by the targets which have a faster sequence for them.
+    llvm::Function *func = m->module->getFunction(name);
+    if (func == NULL || func->getFunctionType()->getParamType(0) != opa->getType())
+        return NULL;
+
+    if (lHasIntrinsicInDefinition(func))
+        return LLVMCallInst(func, opa, opb, opc, name);
+    else
+        return NULL;
+}
+
 //////////////////////////////////////////////////
 
+static llvm::Instruction *lMatchMulAdd(llvm::Value *inst) {
+    // a * b + c, when the target provides a fused multiply-add builtin and
+    // FP contraction is allowed.
+    if (g->opt.disableFMA)
+        return NULL;
+
+    llvm::Value *opa, *opb, *opc;
+    if (match(inst, m_CombineOr(m_c_FAdd(m_OneUse(m_FMul(m_Value(opa), m_Value(opb))), m_Value(opc)),
+                                m_Intrinsic<llvm::Intrinsic::fmuladd>(m_Value(opa), m_Value(opb), m_Value(opc))))) {
+        llvm::Type *type = inst->getType();
+        if (type == LLVMTypes::FloatVectorType)
+            return lGetTernaryIntrinsic("__muladd_varying_float", opa, opb, opc);
+        if (type == LLVMTypes::DoubleVectorType)
+            return lGetTernaryIntrinsic("__muladd_varying_double", opa, opb, opc);
+    }
+    return NULL;
+}
+
 static llvm::Instruction *lMatchAvgUpUInt8(llvm::Value *inst) {
     // (unsigned int8)(((unsigned int16)a + (unsigned int16)b + 1)/2)
     llvm::Value *opa, *opb;
@@ -299,6 +329,8 @@ bool PeepholePass::matchAndReplace(llvm::BasicBlock &bb) {
             builtinCall = lMatchAvgDownInt8(inst);
         if (!builtinCall)
             builtinCall = lMatchAvgDownInt16(inst);
+        if (!builtinCall)
+            builtinCall = lMatchMulAdd(inst);
         if (builtinCall != NULL) {
             llvm::ReplaceInstWithInst(inst, builtinCall);
             modifiedAny = true;
@@ -320,6 +352,17 @@ bool PeepholePass::runOnFunction(llvm::Function &F) {
     return modifiedAny;
 }
 
-llvm::Pass *CreatePeepholePass() { return new PeepholePass; }
+llvm::PreservedAnalyses PeepholePass::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("PeepholePass::run", F.getName());
+    bool modifiedAny = runOnFunction(F);
+    if (!modifiedAny) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
 
 } // namespace ispc
\ No newline at end of file
@@ -39,18 +39,16 @@ namespace ispc {
 
 // PeepholePass
 
-class PeepholePass : public llvm::FunctionPass {
+class PeepholePass : public llvm::PassInfoMixin<PeepholePass> {
   public:
-    static char ID;
-    explicit PeepholePass() : FunctionPass(ID){};
+    explicit PeepholePass() {};
 
-    llvm::StringRef getPassName() const override { return "Peephole Optimizations"; }
-    bool runOnFunction(llvm::Function &F) override;
+    static llvm::StringRef name() { return "Peephole Optimizations"; }
+    llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
 
   private:
+    bool runOnFunction(llvm::Function &F);
     bool matchAndReplace(llvm::BasicBlock &BB);
 };
 
-llvm::Pass *CreatePeepholePass();
-
 } // namespace ispc
\ No newline at end of file
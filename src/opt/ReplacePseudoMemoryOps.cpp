@@ -33,9 +33,9 @@
 
 #include "ReplacePseudoMemoryOps.h"
 
-namespace ispc {
+#include <llvm/IR/IRBuilder.h>
 
-char ReplacePseudoMemoryOpsPass::ID = 0;
+namespace ispc {
 
 /** This routine attempts to determine if the given pointer in lvalue is
     pointing to stack-allocated memory.  It's conservative in that it
@@ -119,6 +119,81 @@ static bool lReplacePseudoMaskedStore(llvm::CallInst *callInst) {
     return true;
 }
 
+/** Whether the gathers of 32 and 64-bit values that the target has native
+    gather instructions for are emulated with lEmulateGather(), following
+    --opt=gather-strategy. */
+static bool lEmulateGathers() {
+    if (!g->target->hasGather())
+        return false;
+    switch (g->opt.gatherStrategy) {
+    case Opt::GatherStrategy::Native:
+        return false;
+    case Opt::GatherStrategy::Emulated:
+        return true;
+    default:
+        return g->target->hasSlowGather();
+    }
+}
+
+/** Replace a call to a __pseudo_gather32/64_* or __pseudo_gather_base_offsets*
+    function with a scalar load for each lane, whose values are inserted into
+    the result.  The lanes that are off load from a stack slot instead, so
+    that no branches are needed; their values are undefined, as they are with
+    the gather functions.  The factored forms are only used by the targets
+    without native gathers, whose builtins already emulate them. */
+static bool lEmulateGather(llvm::CallInst *callInst) {
+    llvm::StringRef name = callInst->getCalledFunction()->getName();
+    llvm::Value *base = NULL, *scale = NULL, *offsets = NULL, *mask = NULL;
+    if (name.startswith("__pseudo_gather32_") || name.startswith("__pseudo_gather64_")) {
+        offsets = callInst->getArgOperand(0);
+        mask = callInst->getArgOperand(1);
+    } else if (name.startswith("__pseudo_gather_base_offsets")) {
+        base = callInst->getArgOperand(0);
+        scale = callInst->getArgOperand(1);
+        offsets = callInst->getArgOperand(2);
+        mask = callInst->getArgOperand(3);
+    } else
+        return false;
+
+    llvm::FixedVectorType *vt = llvm::dyn_cast<llvm::FixedVectorType>(callInst->getType());
+    Assert(vt != NULL);
+    llvm::Type *eltType = vt->getElementType();
+    const int eltBits = eltType->getPrimitiveSizeInBits();
+    if (eltBits != 32 && eltBits != 64)
+        return false;
+    llvm::Type *eltPtrType = llvm::PointerType::get(eltType, 0);
+
+    llvm::Function *func = callInst->getParent()->getParent();
+    llvm::IRBuilder<> entryBuilder(&*func->getEntryBlock().getFirstInsertionPt());
+    llvm::Value *offLanePtr = entryBuilder.CreateAlloca(eltType, NULL, "gather_off_lane");
+
+    llvm::IRBuilder<> builder(callInst);
+    llvm::Value *scale64 = scale != NULL ? builder.CreateSExt(scale, LLVMTypes::Int64Type, "gather_scale") : NULL;
+    llvm::Value *result = llvm::UndefValue::get(vt);
+    for (int i = 0; i < (int)vt->getNumElements(); ++i) {
+        llvm::Value *offset = builder.CreateExtractElement(offsets, LLVMInt32(i), "gather_offset");
+        llvm::Value *ptr = NULL;
+        if (base == NULL)
+            ptr = builder.CreateIntToPtr(offset, eltPtrType, "gather_lane_ptr");
+        else {
+            offset = builder.CreateMul(builder.CreateSExt(offset, LLVMTypes::Int64Type), scale64, "gather_offset");
+            ptr = builder.CreateGEP(LLVMTypes::Int8Type, base, offset, "gather_lane_addr");
+            ptr = builder.CreatePointerCast(ptr, eltPtrType, "gather_lane_ptr");
+        }
+        llvm::Value *on = builder.CreateExtractElement(mask, LLVMInt32(i), "gather_lane_mask");
+        if (!on->getType()->isIntegerTy(1))
+            on = builder.CreateICmpNE(on, llvm::Constant::getNullValue(on->getType()), "gather_lane_on");
+        ptr = builder.CreateSelect(on, ptr, offLanePtr, "gather_load_ptr");
+        llvm::Value *value = builder.CreateAlignedLoad(eltType, ptr, llvm::MaybeAlign(1), "gather_load");
+        result = builder.CreateInsertElement(result, value, LLVMInt32(i), "gather_result");
+    }
+
+    LLVMCopyMetadata(result, callInst);
+    callInst->replaceAllUsesWith(result);
+    callInst->eraseFromParent();
+    return true;
+}
+
 static bool lReplacePseudoGS(llvm::CallInst *callInst) {
     struct LowerGSInfo {
         LowerGSInfo(const char *pName, const char *aName, bool ig, bool ip) : isGather(ig), isPrefetch(ip) {
@@ -289,7 +364,6 @@ static bool lReplacePseudoGS(llvm::CallInst *callInst) {
     SourcePos pos;
     bool gotPosition = LLVMGetSourcePosFromMetadata(callInst, &pos);
 
-    callInst->setCalledFunction(info->actualFunc);
     // Check for alloca and if not alloca - generate __gather and change arguments
     if (gotPosition && (g->target->getVectorWidth() > 1) && (g->opt.level > 0)) {
         if (info->isGather)
@@ -297,6 +371,9 @@ static bool lReplacePseudoGS(llvm::CallInst *callInst) {
         else if (!info->isPrefetch)
             PerformanceWarning(pos, "Scatter required to store value.");
     }
+    if (info->isGather && lEmulateGathers() && lEmulateGather(callInst))
+        return true;
+    callInst->setCalledFunction(info->actualFunc);
     return true;
 }
 
@@ -334,6 +411,17 @@ bool ReplacePseudoMemoryOpsPass::runOnFunction(llvm::Function &F) {
     return modifiedAny;
 }
 
-llvm::Pass *CreateReplacePseudoMemoryOpsPass() { return new ReplacePseudoMemoryOpsPass; }
+llvm::PreservedAnalyses ReplacePseudoMemoryOpsPass::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("ReplacePseudoMemoryOpsPass::run", F.getName());
+    bool modifiedAny = runOnFunction(F);
+    if (!modifiedAny) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
 
 } // namespace ispc
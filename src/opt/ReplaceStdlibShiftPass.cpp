@@ -35,8 +35,6 @@
 
 namespace ispc {
 
-char ReplaceStdlibShiftPass::ID = 0;
-
 /** Given an llvm::Value known to be an integer, return its value as
     an int64_t.
 */
@@ -116,6 +114,17 @@ bool ReplaceStdlibShiftPass::runOnFunction(llvm::Function &F) {
     return modifiedAny;
 }
 
-llvm::Pass *CreateReplaceStdlibShiftPass() { return new ReplaceStdlibShiftPass(); }
+llvm::PreservedAnalyses ReplaceStdlibShiftPass::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("ReplaceStdlibShiftPass::run", F.getName());
+    bool modifiedAny = runOnFunction(F);
+    if (!modifiedAny) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
 
 } // namespace ispc
\ No newline at end of file
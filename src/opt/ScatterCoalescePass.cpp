@@ -0,0 +1,409 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "ScatterCoalescePass.h"
+
+#include <algorithm>
+
+#include <llvm/Analysis/MemoryLocation.h>
+
+namespace ispc {
+
+/** Representation of a memory store that the scatter coalescing code has
+    decided to generate.
+ */
+struct CoalescedStoreOp {
+    CoalescedStoreOp(int64_t s, int c) : start(s), count(c) {}
+
+    /** Starting offset of the store from the common base pointer (in terms
+        of numbers of items of the underlying element type--*not* in terms
+        of bytes). */
+    int64_t start;
+
+    /** Number of elements to store at this location */
+    int count;
+};
+
+/** The scatter of the group (index in the group) and its lane, providing
+    the value to be written to an element of memory. */
+struct ScatterSource {
+    int scatter;
+    int lane;
+};
+
+/** Given the elements written by a group of scatters, split each run of
+    consecutive elements into stores of the widest possible widths (powers
+    of two up to maxWidth), and return a CoalescedStoreOp for each one in
+    the *stores array.
+ */
+static void lSelectStores(const std::map<int64_t, ScatterSource> &elements, int maxWidth,
+                          std::vector<CoalescedStoreOp> *stores) {
+    auto iter = elements.begin();
+    while (iter != elements.end()) {
+        // Find the length of the run of consecutive elements starting here.
+        int64_t start = iter->first;
+        int runLength = 0;
+        while (iter != elements.end() && iter->first == start + runLength) {
+            ++runLength;
+            ++iter;
+        }
+
+        while (runLength > 0) {
+            int width = maxWidth;
+            while (width > runLength) {
+                width /= 2;
+            }
+            Debug(SourcePos(), "Store of %d elements @ %" PRId64 ".", width, start);
+            stores->push_back(CoalescedStoreOp(start, width));
+            start += width;
+            runLength -= width;
+        }
+    }
+}
+
+/** Print a performance message with the details of the result of
+    coalescing over a group of scatters. */
+static void lCoalescePerfInfo(const std::vector<llvm::CallInst *> &coalesceGroup,
+                              const std::vector<CoalescedStoreOp> &storeOps) {
+    if (g->opt.level == 0) {
+        return;
+    }
+
+    SourcePos pos;
+    LLVMGetSourcePosFromMetadata(coalesceGroup[0], &pos);
+
+    // Count how many stores of each size there were.
+    std::map<int, int> storeOpsCount;
+    for (const CoalescedStoreOp &op : storeOps) {
+        ++storeOpsCount[op.count];
+    }
+
+    std::string storeOpsInfo;
+    for (auto iter = storeOpsCount.begin(); iter != storeOpsCount.end(); ++iter) {
+        if (iter != storeOpsCount.begin()) {
+            storeOpsInfo += ", ";
+        }
+        storeOpsInfo += std::to_string(iter->second) + " x " + std::to_string(iter->first) + "-wide";
+    }
+
+    if (coalesceGroup.size() == 1) {
+        PerformanceWarning(pos, "Coalesced scatter into %d store%s (%s).", (int)storeOps.size(),
+                           (storeOps.size() > 1) ? "s" : "", storeOpsInfo.c_str());
+    } else {
+        PerformanceWarning(pos, "Coalesced %d scatters starting here into %d store%s (%s).",
+                           (int)coalesceGroup.size(), (int)storeOps.size(), (storeOps.size() > 1) ? "s" : "",
+                           storeOpsInfo.c_str());
+    }
+}
+
+/** Given a call to a scatter function, extract the base pointer, the
+    2/4/8 scale, and the first varying offsets value to use them to compute
+    that scalar base pointer that is shared by all of the scatters in the
+    group.  (Thus, this base pointer plus the constant offsets term for
+    each scatter gives the set of addresses to use for each scatter.)
+ */
+static llvm::Value *lComputeBasePtr(llvm::CallInst *scatterInst, llvm::Type *baseType,
+                                    llvm::Instruction *insertBefore) {
+    llvm::Value *basePtr = scatterInst->getArgOperand(0);
+    llvm::Value *variableOffsets = scatterInst->getArgOperand(1);
+    llvm::Value *offsetScale = scatterInst->getArgOperand(2);
+    // All of the variable offsets values are the same, so extract the
+    // first value and use that as a scalar.
+    llvm::Value *variable = LLVMExtractFirstVectorElement(variableOffsets);
+    Assert(variable != NULL);
+    if (variable->getType() == LLVMTypes::Int64Type)
+        offsetScale = new llvm::ZExtInst(offsetScale, LLVMTypes::Int64Type, "scale_to64", insertBefore);
+    llvm::Value *offset =
+        llvm::BinaryOperator::Create(llvm::Instruction::Mul, variable, offsetScale, "offset", insertBefore);
+
+    return LLVMGEPInst(basePtr, baseType, offset, "new_base", insertBefore);
+}
+
+/** Actually do the coalescing.  We have a set of scatters all writing to
+    addresses of the form:
+
+    (ptr + {1,2,4,8} * varyingOffset) + constOffset, a.k.a.
+    basePtr + constOffset
+
+    where varyingOffset actually has the same value across all of the SIMD
+    lanes and where the part in parenthesis has the same value for all of
+    the scatters in the group.  Returns false, leaving the scatters as they
+    are, if the elements written are too sparse to benefit from it.
+ */
+static bool lCoalesceScatters(const std::vector<llvm::CallInst *> &coalesceGroup, llvm::Type *baseType) {
+    llvm::Value *values = coalesceGroup[0]->getArgOperand(4);
+    llvm::FixedVectorType *valueType = llvm::cast<llvm::FixedVectorType>(values->getType());
+    llvm::Type *elementType = valueType->getElementType();
+    int elementSize = (int)(elementType->getPrimitiveSizeInBits() / 8);
+    int width = g->target->getVectorWidth();
+
+    // Collect the elements written by the group.  Later scatters overwrite
+    // the elements written by the earlier ones, as do the later lanes of the
+    // same scatter.
+    std::map<int64_t, ScatterSource> elements;
+    for (int i = 0; i < (int)coalesceGroup.size(); ++i) {
+        std::vector<int64_t> offsets(width);
+        int nElts = 0;
+        bool ok = LLVMExtractVectorInts(coalesceGroup[i]->getArgOperand(3), offsets.data(), &nElts);
+        Assert(ok && nElts == width);
+        for (int lane = 0; lane < width; ++lane) {
+            if (offsets[lane] % elementSize != 0) {
+                // Unaligned elements may partially overlap.
+                return false;
+            }
+            elements[offsets[lane] / elementSize] = ScatterSource{i, lane};
+        }
+    }
+
+    // Stores wider than the native vector aren't expected to be any better
+    // than native ones.
+    int maxWidth = std::max(1, g->target->getNativeVectorWidth() * 4 / elementSize);
+    std::vector<CoalescedStoreOp> storeOps;
+    lSelectStores(elements, maxWidth, &storeOps);
+    if (std::none_of(storeOps.begin(), storeOps.end(), [](const CoalescedStoreOp &op) { return op.count > 1; })) {
+        // Scalar stores only, it's what the scatter is turned into anyway.
+        return false;
+    }
+
+    lCoalescePerfInfo(coalesceGroup, storeOps);
+
+    // The stores are emitted in place of the last scatter, where all of the
+    // scattered values are available.
+    llvm::Instruction *insertBefore = coalesceGroup.back();
+    llvm::Value *basePtr = lComputeBasePtr(coalesceGroup[0], baseType, insertBefore);
+
+    for (const CoalescedStoreOp &op : storeOps) {
+        llvm::Type *storeType = elementType;
+        llvm::Value *value = NULL;
+        if (op.count == 1) {
+            const ScatterSource &src = elements[op.start];
+            value = llvm::ExtractElementInst::Create(coalesceGroup[src.scatter]->getArgOperand(4), LLVMInt32(src.lane),
+                                                     "scatter_elt", insertBefore);
+        } else {
+            // Assemble the vector element by element, later optimizations
+            // turn this into shuffles of the scattered vectors.
+            storeType = LLVMVECTOR::get(elementType, op.count);
+            value = llvm::UndefValue::get(storeType);
+            for (int i = 0; i < op.count; ++i) {
+                const ScatterSource &src = elements[op.start + i];
+                llvm::Value *elt = llvm::ExtractElementInst::Create(coalesceGroup[src.scatter]->getArgOperand(4),
+                                                                    LLVMInt32(src.lane), "scatter_elt", insertBefore);
+                value = llvm::InsertElementInst::Create(value, elt, LLVMInt32(i), "scatter_vec", insertBefore);
+            }
+        }
+
+        int align = elementSize;
+        if (op.count > 1 && g->opt.forceAlignedMemory) {
+            align = g->target->getNativeVectorAlignment();
+        }
+        llvm::Value *ptr = LLVMGEPInst(basePtr, baseType, LLVMInt64(op.start * elementSize), "new_base", insertBefore);
+        ptr = new llvm::BitCastInst(ptr, llvm::PointerType::get(storeType, 0), "ptr_cast", insertBefore);
+        llvm::StoreInst *store = new llvm::StoreInst(value, ptr, false /* not volatile */,
+                                                     llvm::MaybeAlign(align).valueOrOne(), insertBefore);
+        LLVMCopyMetadata(store, coalesceGroup[0]);
+    }
+
+    for (llvm::CallInst *scatter : coalesceGroup) {
+        scatter->eraseFromParent();
+    }
+    return true;
+}
+
+/** Returns true if the constant offsets of the scatter are known at
+    compile time. */
+static bool lHasConstantOffsets(llvm::CallInst *scatterInst) {
+    std::vector<int64_t> offsets(g->target->getVectorWidth());
+    int nElts = 0;
+    return LLVMExtractVectorInts(scatterInst->getArgOperand(3), offsets.data(), &nElts) &&
+           nElts == g->target->getVectorWidth();
+}
+
+/** Returns the pointer, which memory the given instruction may read or
+    write (with unknown offset from the pointer), or NULL if either the
+    instruction doesn't access memory or it's not known what it accesses.
+    *unknown is set in the latter case. */
+static llvm::Value *lGetAccessedPointer(llvm::Instruction *inst, bool *unknown) {
+    *unknown = false;
+    if (llvm::LoadInst *load = llvm::dyn_cast<llvm::LoadInst>(inst)) {
+        if (load->isSimple())
+            return load->getPointerOperand();
+    } else if (llvm::StoreInst *store = llvm::dyn_cast<llvm::StoreInst>(inst)) {
+        if (store->isSimple())
+            return store->getPointerOperand();
+    } else if (llvm::CallInst *call = llvm::dyn_cast<llvm::CallInst>(inst)) {
+        llvm::Function *calledFunc = call->getCalledFunction();
+        if (calledFunc != NULL && calledFunc->doesNotAccessMemory())
+            return NULL;
+        // Pseudo gathers only read from their base pointer.
+        if (calledFunc != NULL && calledFunc->onlyReadsMemory() && calledFunc->getName().startswith("__pseudo_gather"))
+            return call->getArgOperand(0);
+    } else if (!inst->mayReadOrWriteMemory()) {
+        return NULL;
+    }
+    *unknown = true;
+    return NULL;
+}
+
+bool ScatterCoalescePass::coalesceScattersFactored(llvm::BasicBlock &bb, llvm::AAResults &AA) {
+    DEBUG_START_BB("ScatterCoalescePass");
+
+    llvm::Function *scatterFuncs[] = {
+        m->module->getFunction("__pseudo_scatter_factored_base_offsets32_i32"),
+        m->module->getFunction("__pseudo_scatter_factored_base_offsets32_float"),
+        m->module->getFunction("__pseudo_scatter_factored_base_offsets32_i64"),
+        m->module->getFunction("__pseudo_scatter_factored_base_offsets32_double"),
+        m->module->getFunction("__pseudo_scatter_factored_base_offsets64_i32"),
+        m->module->getFunction("__pseudo_scatter_factored_base_offsets64_float"),
+        m->module->getFunction("__pseudo_scatter_factored_base_offsets64_i64"),
+        m->module->getFunction("__pseudo_scatter_factored_base_offsets64_double"),
+    };
+    int nScatterFuncs = sizeof(scatterFuncs) / sizeof(scatterFuncs[0]);
+
+    bool modifiedAny = false;
+
+    // Note: we do modify instruction list during the traversal, so the
+    // iterator is moved forward (past all of the scatters of the group)
+    // before the instruction is processed.
+    for (llvm::BasicBlock::iterator iter = bb.begin(), e = bb.end(); iter != e;) {
+        llvm::BasicBlock::iterator curIter = iter++;
+        llvm::CallInst *callInst = llvm::dyn_cast<llvm::CallInst>(&*curIter);
+        if (callInst == NULL)
+            continue;
+
+        llvm::Function *calledFunc = callInst->getCalledFunction();
+        if (calledFunc == NULL)
+            continue;
+
+        int i;
+        for (i = 0; i < nScatterFuncs; ++i)
+            if (scatterFuncs[i] != NULL && calledFunc == scatterFuncs[i])
+                break;
+        if (i == nScatterFuncs)
+            // Doesn't match any of the types of scatters we care about
+            continue;
+
+        SourcePos pos;
+        LLVMGetSourcePosFromMetadata(callInst, &pos);
+        Debug(pos, "Checking for coalescable scatters starting here...");
+
+        llvm::Value *base = callInst->getArgOperand(0);
+        llvm::Value *variableOffsets = callInst->getArgOperand(1);
+        llvm::Value *offsetScale = callInst->getArgOperand(2);
+        llvm::Value *mask = callInst->getArgOperand(5);
+
+        // The same conditions as for gather coalescing: mask all on, the
+        // variable offsets are uniform and the constant offsets are
+        // actually constant.
+        if (GetMaskStatusFromValue(mask) != MaskStatus::all_on)
+            continue;
+
+        if (!LLVMVectorValuesAllEqual(variableOffsets))
+            continue;
+
+        if (!lHasConstantOffsets(callInst))
+            continue;
+
+        // Any offset from the base may be written by the scatters.
+        llvm::MemoryLocation scatterLoc = llvm::MemoryLocation::getBeforeOrAfter(base);
+
+        std::vector<llvm::CallInst *> coalesceGroup;
+        coalesceGroup.push_back(callInst);
+
+        // The scatters are moved down to the last one of the group, so look
+        // further only while the instructions in between can't access the
+        // memory written by the scatters.
+        llvm::BasicBlock::iterator fwdIter = curIter;
+        ++fwdIter;
+        for (; fwdIter != bb.end() && coalesceGroup.size() < 4; ++fwdIter) {
+            llvm::CallInst *fwdCall = llvm::dyn_cast<llvm::CallInst>(&*fwdIter);
+            if (fwdCall != NULL && fwdCall->getCalledFunction() == calledFunc && base == fwdCall->getArgOperand(0) &&
+                variableOffsets == fwdCall->getArgOperand(1) && offsetScale == fwdCall->getArgOperand(2) &&
+                mask == fwdCall->getArgOperand(5) && lHasConstantOffsets(fwdCall)) {
+                SourcePos fwdPos;
+                LLVMGetSourcePosFromMetadata(fwdCall, &fwdPos);
+                Debug(fwdPos, "This scatter can be coalesced.");
+                coalesceGroup.push_back(fwdCall);
+                continue;
+            }
+
+            bool unknown = false;
+            llvm::Value *ptr = lGetAccessedPointer(&*fwdIter, &unknown);
+            if (unknown || (ptr != NULL && !AA.isNoAlias(scatterLoc, llvm::MemoryLocation::getBeforeOrAfter(ptr)))) {
+                break;
+            }
+        }
+
+        Debug(pos, "Done with checking for matching scatters");
+
+        // Don't visit the scatters of the group again, they are either
+        // replaced or left as they are.
+        while (iter != e && std::find(coalesceGroup.begin(), coalesceGroup.end(), &*iter) != coalesceGroup.end()) {
+            ++iter;
+        }
+
+        if (lCoalesceScatters(coalesceGroup, baseType)) {
+            modifiedAny = true;
+        }
+    }
+    DEBUG_END_BB("ScatterCoalescePass");
+
+    return modifiedAny;
+}
+
+bool ScatterCoalescePass::runOnFunction(llvm::Function &F, llvm::AAResults &AA) {
+    llvm::TimeTraceScope FuncScope("ScatterCoalescePass::runOnFunction", F.getName());
+
+    bool modifiedAny = false;
+    for (llvm::BasicBlock &BB : F) {
+        modifiedAny |= coalesceScattersFactored(BB, AA);
+    }
+
+    return modifiedAny;
+}
+
+llvm::PreservedAnalyses ScatterCoalescePass::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("ScatterCoalescePass::run", F.getName());
+    llvm::AAResults &AA = FAM.getResult<llvm::AAManager>(F);
+    bool modifiedAny = runOnFunction(F, AA);
+    if (!modifiedAny) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
+
+} // namespace ispc
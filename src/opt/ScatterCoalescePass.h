@@ -0,0 +1,73 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include "ISPCPass.h"
+
+#include <llvm/Analysis/AliasAnalysis.h>
+
+namespace ispc {
+
+// This pass is the counterpart of GatherCoalescePass for scatters.  It
+// looks for groups of scatters with all-on mask in a basic block, which
+// write to compile-time constant offsets from a common base pointer (as
+// happens for writes of AOS data in a foreach loop, e.g. "pts[i].x = ...;
+// pts[i].y = ...;").  The elements written by the group are collected and
+// each run of consecutive elements is written with as few vector stores as
+// possible, with the stored vectors assembled from the scattered values.
+// Elements that aren't written by the scatters are never written, so the
+// memory outside of the scattered locations is left untouched.
+//
+// The scatters are replaced with the stores at the position of the last
+// scatter of the group, so the group only extends over instructions that
+// can't access the scattered memory, which is checked with alias analysis.
+
+class ScatterCoalescePass : public llvm::PassInfoMixin<ScatterCoalescePass> {
+  public:
+    explicit ScatterCoalescePass() {}
+
+    static llvm::StringRef name() { return "Scatter Coalescing"; }
+    llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+
+  private:
+    bool runOnFunction(llvm::Function &F, llvm::AAResults &AA);
+    // Type of base pointer element type (the 1st argument of the intrinsic) is i8
+    // e.g. @__pseudo_scatter_factored_base_offsets32_i32(i8 *, <WIDTH x i32>, i32, <WIDTH x i32>, <WIDTH x i32>,
+    //                                                    <WIDTH x MASK>)
+    llvm::Type *baseType{LLVMTypes::Int8Type};
+    bool coalesceScattersFactored(llvm::BasicBlock &BB, llvm::AAResults &AA);
+};
+
+} // namespace ispc
@@ -0,0 +1,331 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "XeBlock2DMemoryOps.h"
+#include "OptRemarks.h"
+
+#include <llvm/Analysis/VectorUtils.h>
+#include <llvm/IR/IRBuilder.h>
+
+#ifdef ISPC_XE_ENABLED
+
+namespace ispc {
+
+// Hardware limits of the 2D block messages: the width of a block in bytes,
+// the surface pitch and the alignment of the surface base address and pitch.
+static const int64_t BLOCK2D_MIN_WIDTH = 4;
+static const int64_t BLOCK2D_MAX_WIDTH = 64;
+static const int64_t BLOCK2D_MIN_PITCH = 64;
+static const int64_t BLOCK2D_MAX_PITCH = 1 << 24;
+static const int64_t BLOCK2D_BASE_ALIGN = 64;
+static const int64_t BLOCK2D_PITCH_ALIGN = 16;
+
+/** Offsets of a gather or scatter written as a linear form of a uniform row
+    pitch: offset[i] = u + Row[i] * Pitch + Col[i], where u is the same for
+    all lanes.  Pitch is null if no lane-dependent term is multiplied by a
+    value that isn't a compile-time constant.
+ */
+struct TileOffsets {
+    llvm::Value *Pitch;
+    llvm::SmallVector<int64_t, ISPC_MAX_NVEC> Row;
+    llvm::SmallVector<int64_t, ISPC_MAX_NVEC> Col;
+
+    TileOffsets(int N) : Pitch(nullptr), Row(N, 0), Col(N, 0) {}
+};
+
+static bool lAnalyseTileOffsets(llvm::Value *V, TileOffsets &T) {
+    int N = (int)T.Col.size();
+    if (llvm::isa<llvm::ConstantAggregateZero>(V) || llvm::isa<llvm::ConstantDataVector>(V)) {
+        int64_t Elts[ISPC_MAX_NVEC];
+        int NElts = 0;
+        if (!LLVMExtractVectorInts(V, Elts, &NElts) || NElts != N)
+            return false;
+        for (int i = 0; i < N; ++i)
+            T.Col[i] = Elts[i];
+        return true;
+    }
+
+    // A value that is the same in all lanes only contributes to u.
+    if (llvm::getSplatValue(V) != nullptr)
+        return true;
+
+    if (auto *Cast = llvm::dyn_cast<llvm::CastInst>(V)) {
+        if (Cast->getOpcode() == llvm::Instruction::SExt || Cast->getOpcode() == llvm::Instruction::ZExt)
+            return lAnalyseTileOffsets(Cast->getOperand(0), T);
+        return false;
+    }
+
+    auto *BOp = llvm::dyn_cast<llvm::BinaryOperator>(V);
+    if (BOp == nullptr)
+        return false;
+    llvm::Value *Op0 = BOp->getOperand(0), *Op1 = BOp->getOperand(1);
+
+    if (BOp->getOpcode() == llvm::Instruction::Add || BOp->getOpcode() == llvm::Instruction::Sub ||
+        IsOrEquivalentToAdd(BOp)) {
+        TileOffsets T0(N), T1(N);
+        if (!lAnalyseTileOffsets(Op0, T0) || !lAnalyseTileOffsets(Op1, T1))
+            return false;
+        if (T0.Pitch != nullptr && T1.Pitch != nullptr && T0.Pitch != T1.Pitch)
+            return false;
+        int64_t Sign = BOp->getOpcode() == llvm::Instruction::Sub ? -1 : 1;
+        T.Pitch = T0.Pitch != nullptr ? T0.Pitch : T1.Pitch;
+        for (int i = 0; i < N; ++i) {
+            T.Row[i] = T0.Row[i] + Sign * T1.Row[i];
+            T.Col[i] = T0.Col[i] + Sign * T1.Col[i];
+        }
+        return true;
+    }
+
+    if (BOp->getOpcode() == llvm::Instruction::Shl) {
+        llvm::ConstantInt *Amount = llvm::dyn_cast_or_null<llvm::ConstantInt>(llvm::getSplatValue(Op1));
+        if (Amount == nullptr || Amount->getZExtValue() >= 32 || !lAnalyseTileOffsets(Op0, T))
+            return false;
+        for (int i = 0; i < N; ++i) {
+            T.Row[i] <<= Amount->getZExtValue();
+            T.Col[i] <<= Amount->getZExtValue();
+        }
+        return true;
+    }
+
+    if (BOp->getOpcode() == llvm::Instruction::Mul) {
+        // One of the factors has to be the same in all lanes.
+        llvm::Value *Factor = llvm::getSplatValue(Op1), *Other = Op0;
+        if (Factor == nullptr) {
+            Factor = llvm::getSplatValue(Op0);
+            Other = Op1;
+        }
+        if (Factor == nullptr || !lAnalyseTileOffsets(Other, T))
+            return false;
+        if (auto *Scale = llvm::dyn_cast<llvm::ConstantInt>(Factor)) {
+            for (int i = 0; i < N; ++i) {
+                T.Row[i] *= Scale->getSExtValue();
+                T.Col[i] *= Scale->getSExtValue();
+            }
+            return true;
+        }
+        // The row index multiplied by the uniform pitch.
+        if (T.Pitch != nullptr)
+            return false;
+        T.Pitch = Factor;
+        T.Row = T.Col;
+        std::fill(T.Col.begin(), T.Col.end(), 0);
+        return true;
+    }
+
+    return false;
+}
+
+/** Checks that the lanes access rows of Width consecutive elements, the row
+    of each lane being given by its index divided by Width, and returns the
+    distance between the rows in bytes in RowStride.  It is a multiplier of
+    T.Pitch if there is one and a constant otherwise.
+ */
+static bool lMatchTile(const TileOffsets &T, int64_t Scale, int64_t EltSize, int &Width, int64_t &RowStride) {
+    int N = (int)T.Col.size();
+    auto ColBytes = [&](int i) { return Scale * (T.Col[i] - T.Col[0]); };
+    auto RowBytes = [&](int i) { return Scale * (T.Row[i] - T.Row[0]); };
+
+    Width = 1;
+    while (Width < N && ColBytes(Width) == Width * EltSize && RowBytes(Width) == 0)
+        ++Width;
+    // Accesses to consecutive elements are handled by the regular memory
+    // optimizations.
+    if (Width == N || (Width & (Width - 1)) != 0 || Width * EltSize < BLOCK2D_MIN_WIDTH ||
+        Width * EltSize > BLOCK2D_MAX_WIDTH)
+        return false;
+
+    RowStride = T.Pitch != nullptr ? RowBytes(Width) : ColBytes(Width);
+    if (RowStride <= 0 || (T.Pitch == nullptr && RowStride < Width * EltSize))
+        return false;
+    for (int i = 0; i < N; ++i) {
+        int64_t Col = (i % Width) * EltSize;
+        int64_t Row = (i / Width) * RowStride;
+        if (T.Pitch != nullptr ? (ColBytes(i) != Col || RowBytes(i) != Row)
+                               : (ColBytes(i) != Col + Row || RowBytes(i) != 0))
+            return false;
+    }
+    return true;
+}
+
+// Data size encoding of the LSC messages.
+static uint8_t lLSCDataSize(int64_t EltSize) {
+    switch (EltSize) {
+    case 1:
+        return 1;
+    case 2:
+        return 2;
+    case 4:
+        return 3;
+    default:
+        Assert(EltSize == 8);
+        return 4;
+    }
+}
+
+/** Replaces the given __pseudo_gather_base_offsets* or
+    __pseudo_scatter_base_offsets* call with a 2D block load or store if its
+    lanes access a tile of memory.  Returns true if it was replaced. */
+static bool lLowerToBlock2D(llvm::CallInst *CI, bool IsStore) {
+    llvm::ConstantInt *ScaleVal = llvm::dyn_cast<llvm::ConstantInt>(CI->getArgOperand(1));
+    llvm::Value *Offsets = CI->getArgOperand(2);
+    llvm::Value *Mask = CI->getArgOperand(IsStore ? 4 : 3);
+    llvm::Type *DataTy = IsStore ? CI->getArgOperand(3)->getType() : CI->getType();
+    int N = g->target->getVectorWidth();
+
+    // The block messages have a single predicate for all of the lanes.
+    if (ScaleVal == nullptr || ScaleVal->getSExtValue() <= 0 ||
+        GetMaskStatusFromValue(Mask, N) != MaskStatus::all_on)
+        return false;
+
+    TileOffsets T(N);
+    int Width = 0;
+    int64_t RowStride = 0;
+    int64_t EltSize = DataTy->getScalarSizeInBits() / 8;
+    if (!lAnalyseTileOffsets(Offsets, T) || !lMatchTile(T, ScaleVal->getSExtValue(), EltSize, Width, RowStride))
+        return false;
+    int Height = N / Width;
+
+    // Address of the element of the first lane and the row pitch in bytes.
+    llvm::IRBuilder<> Builder(CI);
+    llvm::Value *Offset0 = Builder.CreateSExt(Builder.CreateExtractElement(Offsets, (uint64_t)0), LLVMTypes::Int64Type);
+    llvm::Value *Addr = Builder.CreateAdd(Builder.CreatePtrToInt(CI->getArgOperand(0), LLVMTypes::Int64Type),
+                                          Builder.CreateMul(Offset0, LLVMInt64(ScaleVal->getSExtValue())),
+                                          "block2d_addr");
+    llvm::Value *Pitch = LLVMInt64(RowStride);
+    if (T.Pitch != nullptr)
+        Pitch = Builder.CreateMul(Builder.CreateSExt(T.Pitch, LLVMTypes::Int64Type), Pitch, "block2d_pitch");
+
+    // The surface starts at the aligned address below the first element and
+    // spans the rows of the tile, each of them being one pitch wide.
+    llvm::Value *Misalignment = Builder.CreateAnd(Addr, LLVMInt64(BLOCK2D_BASE_ALIGN - 1));
+    llvm::Value *Base = Builder.CreateSub(Addr, Misalignment, "block2d_base");
+    llvm::Value *InRange = Builder.CreateAnd(Builder.CreateICmpSGE(Pitch, LLVMInt64(BLOCK2D_MIN_PITCH)),
+                                             Builder.CreateICmpSLT(Pitch, LLVMInt64(BLOCK2D_MAX_PITCH)));
+    llvm::Value *PitchAligned =
+        Builder.CreateICmpEQ(Builder.CreateAnd(Pitch, LLVMInt64(BLOCK2D_PITCH_ALIGN - 1)), LLVMInt64(0));
+    llvm::Value *EltAligned = Builder.CreateICmpEQ(Builder.CreateAnd(Addr, LLVMInt64(EltSize - 1)), LLVMInt64(0));
+    llvm::Value *RowFits =
+        Builder.CreateICmpSLE(Builder.CreateAdd(Misalignment, LLVMInt64(Width * EltSize)), Pitch);
+    llvm::Value *CanUseBlock =
+        Builder.CreateAnd(Builder.CreateAnd(InRange, PitchAligned), Builder.CreateAnd(EltAligned, RowFits),
+                          "block2d_legal");
+
+    llvm::Instruction *ThenTerm = nullptr, *ElseTerm = nullptr;
+    llvm::SplitBlockAndInsertIfThenElse(CanUseBlock, CI, &ThenTerm, &ElseTerm);
+    CI->moveBefore(ElseTerm);
+
+    Builder.SetInsertPoint(ThenTerm);
+    llvm::Value *PitchMinusOne = Builder.CreateTrunc(Builder.CreateSub(Pitch, LLVMInt64(1)), LLVMTypes::Int32Type);
+    llvm::Value *StartX =
+        Builder.CreateTrunc(Builder.CreateUDiv(Misalignment, LLVMInt64(EltSize)), LLVMTypes::Int32Type);
+    llvm::SmallVector<llvm::Value *, 16> Args = {LLVMTrue,
+                                                 LLVMInt8(0),
+                                                 LLVMInt8(0),
+                                                 LLVMInt8(lLSCDataSize(EltSize)),
+                                                 LLVMInt8(1),
+                                                 LLVMInt8(1),
+                                                 LLVMInt16(Width),
+                                                 LLVMInt16(Height),
+                                                 LLVMInt8(0),
+                                                 Base,
+                                                 PitchMinusOne,
+                                                 LLVMInt32(Height - 1),
+                                                 PitchMinusOne,
+                                                 StartX,
+                                                 LLVMInt32(0)};
+    llvm::Value *Block = nullptr;
+    if (IsStore) {
+        Args.push_back(CI->getArgOperand(3));
+        llvm::Function *Fn =
+            llvm::GenXIntrinsic::getGenXDeclaration(m->module, llvm::GenXIntrinsic::genx_lsc_store2d_stateless,
+                                                    {LLVMTypes::Int1Type, LLVMTypes::Int64Type, DataTy});
+        Builder.CreateCall(Fn, Args);
+    } else {
+        llvm::Function *Fn =
+            llvm::GenXIntrinsic::getGenXDeclaration(m->module, llvm::GenXIntrinsic::genx_lsc_load2d_stateless,
+                                                    {DataTy, LLVMTypes::Int1Type, LLVMTypes::Int64Type});
+        Block = Builder.CreateCall(Fn, Args, "block2d_ld");
+    }
+
+    if (!IsStore) {
+        llvm::BasicBlock *Tail = ThenTerm->getSuccessor(0);
+        llvm::PHINode *Phi = llvm::PHINode::Create(DataTy, 2, "block2d_res", &*Tail->begin());
+        CI->replaceAllUsesWith(Phi);
+        Phi->addIncoming(Block, ThenTerm->getParent());
+        Phi->addIncoming(CI, ElseTerm->getParent());
+    }
+
+    EmitOptRemark(OptRemarkKind::Passed, "XeBlock2DMemoryOps", IsStore ? "Block2DStore" : "Block2DLoad", CI,
+                  "%s of a %dx%d tile replaced with a 2D block %s", IsStore ? "scatter" : "gather", Width, Height,
+                  IsStore ? "store" : "load");
+    return true;
+}
+
+bool XeBlock2DMemoryOps::runOnFunction(llvm::Function &F) {
+    llvm::TimeTraceScope FuncScope("XeBlock2DMemoryOps::runOnFunction", F.getName());
+    // Collect the candidates first as lowering them splits the blocks.
+    std::vector<std::pair<llvm::CallInst *, bool>> Candidates;
+    for (llvm::BasicBlock &BB : F) {
+        for (llvm::Instruction &Inst : BB) {
+            llvm::CallInst *CI = llvm::dyn_cast<llvm::CallInst>(&Inst);
+            llvm::Function *Callee = CI != nullptr ? CI->getCalledFunction() : nullptr;
+            if (Callee == nullptr)
+                continue;
+            if (Callee->getName().startswith("__pseudo_gather_base_offsets"))
+                Candidates.push_back({CI, false});
+            else if (Callee->getName().startswith("__pseudo_scatter_base_offsets"))
+                Candidates.push_back({CI, true});
+        }
+    }
+
+    bool modifiedAny = false;
+    for (auto &Candidate : Candidates)
+        modifiedAny |= lLowerToBlock2D(Candidate.first, Candidate.second);
+    return modifiedAny;
+}
+
+llvm::PreservedAnalyses XeBlock2DMemoryOps::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("XeBlock2DMemoryOps::run", F.getName());
+    bool modifiedAny = runOnFunction(F);
+    if (!modifiedAny) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    // The control flow is changed by the checks of the block access legality.
+    return llvm::PreservedAnalyses::none();
+}
+
+} // namespace ispc
+
+#endif
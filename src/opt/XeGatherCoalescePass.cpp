@@ -485,8 +485,6 @@ llvm::Value *MemoryCoalescing::extractValueFromBlock(const MemoryCoalescing::Blo
     }
 }
 
-char XeGatherCoalescing::ID = 0;
-
 void XeGatherCoalescing::runOnBasicBlock(llvm::BasicBlock &bb) {
     DEBUG_START_BB("XeGatherCoalescing");
     runOnBasicBlockImpl(bb);
@@ -657,7 +655,18 @@ llvm::Value *XeGatherCoalescing::getPointer(llvm::Instruction *Inst) const {
     return nullptr;
 }
 
-llvm::Pass *CreateXeGatherCoalescingPass() { return new XeGatherCoalescing; }
+llvm::PreservedAnalyses XeGatherCoalescing::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("XeGatherCoalescing::run", F.getName());
+    bool modifiedAny = runOnFunction(F);
+    if (!modifiedAny) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
 
 } // namespace ispc
 
@@ -77,7 +77,7 @@ namespace ispc {
  * directly, but can be used by several coalescing implementations.
  * Such helpers contains some general stuff.
  */
-class MemoryCoalescing : public llvm::FunctionPass {
+class MemoryCoalescing {
   protected:
     typedef int64_t OffsetT;
     typedef llvm::SmallVector<OffsetT, 16> OffsetsVecT;
@@ -228,10 +228,10 @@ class MemoryCoalescing : public llvm::FunctionPass {
 
   protected:
     // Initialization
-    MemoryCoalescing(char &ID, MemType OptType, AddressSpace AddrSpace)
-        : FunctionPass(ID), AddrSpace(AddrSpace), OptType(OptType) {}
+    MemoryCoalescing(MemType OptType, AddressSpace AddrSpace) : AddrSpace(AddrSpace), OptType(OptType) {}
+    virtual ~MemoryCoalescing() {}
     // Optimization runner
-    bool runOnFunction(llvm::Function &Fn) override;
+    bool runOnFunction(llvm::Function &Fn);
 
     /* ------ Handlers ------ */
     // Methods in this block are interface for different coalescing types.
@@ -283,7 +283,7 @@ class MemoryCoalescing : public llvm::FunctionPass {
     unsigned getScalarTypeSize(llvm::Type *Ty) const;
 };
 
-class XeGatherCoalescing : public MemoryCoalescing {
+class XeGatherCoalescing : public MemoryCoalescing, public llvm::PassInfoMixin<XeGatherCoalescing> {
   private:
     bool isOptimizationTarget(llvm::Instruction *Inst) const;
     llvm::Value *getPointer(llvm::Instruction *Inst) const;
@@ -296,15 +296,13 @@ class XeGatherCoalescing : public MemoryCoalescing {
     bool isConstOffsetPseudoGather(llvm::CallInst *CI) const;
 
   public:
-    static char ID;
     explicit XeGatherCoalescing()
-        : MemoryCoalescing(ID, MemoryCoalescing::MemType::OPT_LOAD, AddressSpace::ispc_global) {}
+        : MemoryCoalescing(MemoryCoalescing::MemType::OPT_LOAD, AddressSpace::ispc_global) {}
 
-    llvm::StringRef getPassName() const { return "Xe Gather Coalescing"; }
+    static llvm::StringRef name() { return "Xe Gather Coalescing"; }
+    llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
 };
 
-llvm::Pass *CreateXeGatherCoalescingPass();
-
 } // namespace ispc
 
 #endif
@@ -69,7 +69,8 @@
 struct ForeachDimension;
 
 struct PragmaAttributes {
-    enum class AttributeType { none, pragmaloop, pragmawarning };
+    enum class AttributeType { none, pragmaloop, pragmanontemporal, pragmawarning, pragmatile, pragmawidth,
+                               pragmainterleave };
     PragmaAttributes() {
         aType = AttributeType::none;
         unrollType =  Globals::pragmaUnrollType::none;
@@ -78,9 +79,10 @@ struct PragmaAttributes {
     AttributeType aType;
     Globals::pragmaUnrollType unrollType;
     int count;
+    std::vector<int> tiles;
 };
 
-typedef std::pair<Declarator *, std::vector<std::pair<const Type *, SourcePos>>*> SimpleTemplateIDType;
+typedef std::pair<Declarator *, std::vector<TemplateArg> *> SimpleTemplateIDType;
 
 }
 
@@ -126,6 +128,12 @@ static void lAddThreadIndexCountToSymbolTable(SourcePos pos);
 static std::string lGetAlternates(std::vector<std::string> &alternates);
 static const char *lGetStorageClassString(StorageClass sc);
 static bool lGetConstantInt(Expr *expr, int *value, SourcePos pos, const char *usage);
+static LaunchHints *lGetLaunchHints(const std::vector<std::pair<std::string, SourcePos> > &hints);
+static Expr *lCreateLaunchExpr(ExprList *launchCount, LaunchHints *hints, Expr *func, ExprList *args,
+                               SourcePos pos);
+static std::vector<ParallelReduction *> *lCreateReductions(const std::string &clause, int op,
+                                                          const std::string *funcName, Expr *identity,
+                                                          const std::vector<Symbol *> &syms, SourcePos pos);
 static EnumType *lCreateEnumType(const char *name, std::vector<Symbol *> *enums,
                                  SourcePos pos);
 static void lFinalizeEnumeratorSymbols(std::vector<Symbol *> &enums,
@@ -135,10 +143,10 @@ static const char *lBuiltinTokens[] = {
     "assert", "bool", "break", "case", "cdo",
     "cfor", "cif", "cwhile", "const", "continue", "default",
     "do", "delete", "double", "else", "enum", "export", "extern", "false",
-    "float16", "float", "for", "foreach", "foreach_active", "foreach_tiled",
+    "float16", "float", "for", "foreach", "foreach_active", "foreach_dynamic", "foreach_tiled",
     "foreach_unique", "goto", "if", "in", "inline",
     "int", "int8", "int16", "int32", "int64", "invoke_sycl", "launch", "new", "NULL",
-    "print", "return", "signed", "sizeof", "static", "struct", "switch",
+    "parallel_foreach", "print", "return", "shared", "signed", "sizeof", "static", "struct", "switch",
     "sync", "task", "true", "typedef", "uniform", "unmasked", "unsigned",
     "varying", "void", "while", NULL
 };
@@ -192,10 +200,13 @@ struct ForeachDimension {
     std::pair<std::string, SourcePos> *declspecPair;
     std::vector<std::pair<std::string, SourcePos> > *declspecList;
     PragmaAttributes *pragmaAttributes;
-    const TemplateTypeParmType *templateParm;
+    const TemplateParam *templateParm;
+    std::vector<TemplateArg> *templateArgList;
     TemplateParms *templateParmList;
     TemplateSymbol *functionTemplateSym;
     SimpleTemplateIDType *simpleTemplateID;
+    LaunchHints *launchHints;
+    std::vector<ParallelReduction *> *parallelReductionList;
 }
 
 
@@ -216,15 +227,15 @@ struct ForeachDimension {
 %token TOKEN_SIZEOF TOKEN_NEW TOKEN_DELETE TOKEN_IN TOKEN_INTRINSIC_CALL TOKEN_ALLOCA
 
 %token TOKEN_EXTERN TOKEN_EXPORT TOKEN_STATIC TOKEN_INLINE TOKEN_NOINLINE TOKEN_VECTORCALL TOKEN_REGCALL TOKEN_TASK TOKEN_DECLSPEC
-%token TOKEN_UNIFORM TOKEN_VARYING TOKEN_TYPEDEF TOKEN_SOA TOKEN_UNMASKED
+%token TOKEN_UNIFORM TOKEN_VARYING TOKEN_TYPEDEF TOKEN_SOA TOKEN_SHARED TOKEN_UNMASKED
 %token TOKEN_INT TOKEN_SIGNED TOKEN_UNSIGNED TOKEN_FLOAT16 TOKEN_FLOAT TOKEN_DOUBLE
-%token TOKEN_INT8 TOKEN_INT16 TOKEN_INT64 TOKEN_CONST TOKEN_VOID TOKEN_BOOL
+%token TOKEN_INT8 TOKEN_INT16 TOKEN_INT64 TOKEN_CONST TOKEN_RESTRICT TOKEN_VOID TOKEN_BOOL
 %token TOKEN_UINT8 TOKEN_UINT16 TOKEN_UINT TOKEN_UINT64
 %token TOKEN_ENUM TOKEN_STRUCT TOKEN_TRUE TOKEN_FALSE
 
 %token TOKEN_CASE TOKEN_DEFAULT TOKEN_IF TOKEN_ELSE TOKEN_SWITCH
 %token TOKEN_WHILE TOKEN_DO TOKEN_LAUNCH TOKEN_FOREACH TOKEN_FOREACH_TILED
-%token TOKEN_FOREACH_UNIQUE TOKEN_FOREACH_ACTIVE TOKEN_DOTDOTDOT
+%token TOKEN_FOREACH_UNIQUE TOKEN_FOREACH_ACTIVE TOKEN_FOREACH_DYNAMIC TOKEN_PARALLEL_FOREACH TOKEN_DOTDOTDOT
 %token TOKEN_FOR TOKEN_GOTO TOKEN_CONTINUE TOKEN_BREAK TOKEN_RETURN
 %token TOKEN_CIF TOKEN_CDO TOKEN_CFOR TOKEN_CWHILE
 %token TOKEN_SYNC TOKEN_PRINT TOKEN_ASSERT TOKEN_INVOKE_SYCL
@@ -238,7 +249,9 @@ struct ForeachDimension {
 %type <expr> logical_and_expression logical_or_expression new_expression
 %type <expr> conditional_expression assignment_expression expression
 %type <expr> initializer constant_expression for_test
-%type <exprList> argument_expression_list initializer_list
+%type <exprList> argument_expression_list initializer_list launch_count
+%type <launchHints> launch_hints
+%type <parallelReductionList> parallel_reduction parallel_reduction_list parallel_foreach_reductions
 
 %type <stmt> attributed_statement labeled_statement compound_statement for_init_statement statement
 %type <stmt> expression_statement selection_statement iteration_statement
@@ -258,6 +271,7 @@ struct ForeachDimension {
 
 %type <symbolList> enumerator_list
 %type <symbol> enumerator foreach_identifier foreach_active_identifier
+%type <symbolList> parallel_reduction_vars
 %type <enumType> enum_specifier
 
 %type <type> specifier_qualifier_list struct_or_union_specifier
@@ -271,21 +285,21 @@ struct ForeachDimension {
 %type <storageClass> storage_class_specifier
 %type <declSpecs> declaration_specifiers
 
-%type <stringVal> string_constant intrinsic_name
+%type <stringVal> string_constant intrinsic_name declspec_string_list
 %type <constCharPtr> struct_or_union_name enum_identifier goto_identifier
 %type <constCharPtr> foreach_unique_identifier
 
-%type <intVal> int_constant soa_width_specifier rate_qualified_new
+%type <intVal> int_constant soa_width_specifier rate_qualified_new parallel_reduction_op
 
 %type <pragmaAttributes> pragma
 %type <foreachDimension> foreach_dimension_specifier
 %type <foreachDimensionList> foreach_dimension_list
 
-%type <declspecPair> declspec_item
-%type <declspecList> declspec_specifier declspec_list
+%type <declspecPair> declspec_item launch_hint
+%type <declspecList> declspec_specifier declspec_list launch_hint_list
 
 %type <constCharPtr> template_identifier
-%type <typeList> template_argument_list
+%type <templateArgList> template_argument_list
 %type <simpleTemplateID> simple_template_id
 %type <templateParm> template_type_parameter template_int_parameter template_parameter
 %type <templateParmList> template_parameter_list template_head
@@ -402,66 +416,18 @@ launch_expression
           Expr *launchCount[3] = {oneExpr, oneExpr, oneExpr};
           $$ = new FunctionCallExpr($2, new ExprList(Union(@3,@4)), Union(@2, @4), true, launchCount);
        }
-
-    | TOKEN_LAUNCH '[' assignment_expression ']' postfix_expression '(' argument_expression_list ')'
-      { 
-          ConstExpr *oneExpr = new ConstExpr(AtomicType::UniformInt32, (int32_t)1, @5);
-          Expr *launchCount[3] = {$3, oneExpr, oneExpr};
-          $$ = new FunctionCallExpr($5, $7, Union(@5,@8), true, launchCount);
-      }
-    | TOKEN_LAUNCH '[' assignment_expression ']' postfix_expression '(' ')'
-      { 
-          ConstExpr *oneExpr = new ConstExpr(AtomicType::UniformInt32, (int32_t)1, @5);
-          Expr *launchCount[3] = {$3, oneExpr, oneExpr};
-          $$ = new FunctionCallExpr($5, new ExprList(Union(@5,@6)), Union(@5,@7), true, launchCount);
-      }
-
-    | TOKEN_LAUNCH '[' assignment_expression ',' assignment_expression ']' postfix_expression '(' argument_expression_list ')'
-      { 
-          ConstExpr *oneExpr = new ConstExpr(AtomicType::UniformInt32, (int32_t)1, @7);
-          Expr *launchCount[3] = {$3, $5, oneExpr};
-          $$ = new FunctionCallExpr($7, $9, Union(@7,@10), true, launchCount);
-      }
-    | TOKEN_LAUNCH '[' assignment_expression ',' assignment_expression ']' postfix_expression '(' ')'
-      { 
-          ConstExpr *oneExpr = new ConstExpr(AtomicType::UniformInt32, (int32_t)1, @7);
-          Expr *launchCount[3] = {$3, $5, oneExpr};
-          $$ = new FunctionCallExpr($7, new ExprList(Union(@7,@8)), Union(@7,@9), true, launchCount);
-      }
-    | TOKEN_LAUNCH '[' assignment_expression ']' '[' assignment_expression ']' postfix_expression '(' argument_expression_list ')'
-      { 
-          ConstExpr *oneExpr = new ConstExpr(AtomicType::UniformInt32, (int32_t)1, @8);
-          Expr *launchCount[3] = {$6, $3, oneExpr};
-          $$ = new FunctionCallExpr($8, $10, Union(@8,@11), true, launchCount);
-      }
-    | TOKEN_LAUNCH '[' assignment_expression ']' '[' assignment_expression ']' postfix_expression '(' ')'
-      { 
-          ConstExpr *oneExpr = new ConstExpr(AtomicType::UniformInt32, (int32_t)1, @8);
-          Expr *launchCount[3] = {$6, $3, oneExpr};
-          $$ = new FunctionCallExpr($8, new ExprList(Union(@8,@9)), Union(@8,@10), true, launchCount);
-      }
-
-    | TOKEN_LAUNCH '[' assignment_expression ',' assignment_expression ',' assignment_expression ']' postfix_expression '(' argument_expression_list ')'
-      { 
-          Expr *launchCount[3] = {$3, $5, $7};
-          $$ = new FunctionCallExpr($9, $11, Union(@9,@12), true, launchCount);
-      }
-    | TOKEN_LAUNCH '[' assignment_expression ',' assignment_expression ',' assignment_expression ']' postfix_expression '(' ')'
-      { 
-          Expr *launchCount[3] = {$3, $5, $7};
-          $$ = new FunctionCallExpr($9, new ExprList(Union(@9,@10)), Union(@9,@11), true, launchCount);
-      }
-    | TOKEN_LAUNCH '[' assignment_expression ']' '[' assignment_expression ']' '[' assignment_expression ']' postfix_expression '(' argument_expression_list ')'
-      { 
-          Expr *launchCount[3] = {$9, $6, $3};
-          $$ = new FunctionCallExpr($11, $13, Union(@11,@14), true, launchCount);
-      }
-    | TOKEN_LAUNCH '[' assignment_expression ']' '[' assignment_expression ']' '[' assignment_expression ']' postfix_expression '(' ')'
-      { 
-          Expr *launchCount[3] = {$9, $6, $3};
-          $$ = new FunctionCallExpr($11, new ExprList(Union(@11,@12)), Union(@11,@13), true, launchCount);
-      }
-
+    | TOKEN_LAUNCH launch_count postfix_expression '(' argument_expression_list ')'
+      { $$ = lCreateLaunchExpr($2, NULL, $3, $5, Union(@3, @6)); }
+    | TOKEN_LAUNCH launch_count postfix_expression '(' ')'
+      { $$ = lCreateLaunchExpr($2, NULL, $3, new ExprList(Union(@4, @5)), Union(@3, @5)); }
+    | TOKEN_LAUNCH launch_hints postfix_expression '(' argument_expression_list ')'
+      { $$ = lCreateLaunchExpr(NULL, $2, $3, $5, Union(@3, @6)); }
+    | TOKEN_LAUNCH launch_hints postfix_expression '(' ')'
+      { $$ = lCreateLaunchExpr(NULL, $2, $3, new ExprList(Union(@4, @5)), Union(@3, @5)); }
+    | TOKEN_LAUNCH launch_count launch_hints postfix_expression '(' argument_expression_list ')'
+      { $$ = lCreateLaunchExpr($2, $3, $4, $6, Union(@4, @7)); }
+    | TOKEN_LAUNCH launch_count launch_hints postfix_expression '(' ')'
+      { $$ = lCreateLaunchExpr($2, $3, $4, new ExprList(Union(@5, @6)), Union(@4, @6)); }
 
     | TOKEN_LAUNCH '<' postfix_expression '(' argument_expression_list ')' '>'
        {
@@ -475,18 +441,111 @@ launch_expression
                 "around function call expression.");
           $$ = NULL;
        }
-    | TOKEN_LAUNCH '[' assignment_expression ']' '<' postfix_expression '(' argument_expression_list ')' '>'
+    | TOKEN_LAUNCH launch_count '<' postfix_expression '(' argument_expression_list ')' '>'
        {
-          Error(Union(@5, @10), "\"launch\" expressions no longer take '<' '>' "
+          Error(Union(@3, @8), "\"launch\" expressions no longer take '<' '>' "
                 "around function call expression.");
           $$ = NULL;
        }
-    | TOKEN_LAUNCH '[' assignment_expression ']' '<' postfix_expression '(' ')' '>'
+    | TOKEN_LAUNCH launch_count '<' postfix_expression '(' ')' '>'
        {
-          Error(Union(@5, @9), "\"launch\" expressions no longer take '<' '>' "
+          Error(Union(@3, @7), "\"launch\" expressions no longer take '<' '>' "
                 "around function call expression.");
           $$ = NULL;
        }
+    | launch_expression TOKEN_IDENTIFIER '(' argument_expression_list ')'
+       {
+          // "after" isn't a keyword, so that it remains usable as an
+          // identifier elsewhere.
+          FunctionCallExpr *fce = llvm::dyn_cast_or_null<FunctionCallExpr>($1);
+          $$ = NULL;
+          if (*$<stringVal>2 != "after")
+              Error(@2, "Expected \"after\" clause following \"launch\" "
+                    "expression, found \"%s\".", $<stringVal>2->c_str());
+          else if (fce != NULL && fce->launchAfter != NULL)
+              Error(Union(@2, @5), "Multiple \"after\" clauses provided for "
+                    "\"launch\" expression.");
+          else if (fce != NULL) {
+              fce->launchAfter = $4;
+              $$ = fce;
+          }
+       }
+    ;
+
+/* The numbers of tasks of a launch, in the order of the task index
+   dimensions 0, 1 and 2. */
+launch_count
+    : '[' assignment_expression ']'
+      {
+          ConstExpr *oneExpr = new ConstExpr(AtomicType::UniformInt32, (int32_t)1, @1);
+          $$ = new ExprList($2, @1);
+          $$->exprs.push_back(oneExpr);
+          $$->exprs.push_back(oneExpr);
+      }
+    | '[' assignment_expression ',' assignment_expression ']'
+      {
+          ConstExpr *oneExpr = new ConstExpr(AtomicType::UniformInt32, (int32_t)1, @1);
+          $$ = new ExprList($2, @1);
+          $$->exprs.push_back($4);
+          $$->exprs.push_back(oneExpr);
+      }
+    | '[' assignment_expression ']' '[' assignment_expression ']'
+      {
+          ConstExpr *oneExpr = new ConstExpr(AtomicType::UniformInt32, (int32_t)1, @1);
+          $$ = new ExprList($5, @1);
+          $$->exprs.push_back($2);
+          $$->exprs.push_back(oneExpr);
+      }
+    | '[' assignment_expression ',' assignment_expression ',' assignment_expression ']'
+      {
+          $$ = new ExprList($2, @1);
+          $$->exprs.push_back($4);
+          $$->exprs.push_back($6);
+      }
+    | '[' assignment_expression ']' '[' assignment_expression ']' '[' assignment_expression ']'
+      {
+          $$ = new ExprList($8, @1);
+          $$->exprs.push_back($5);
+          $$->exprs.push_back($2);
+      }
+    ;
+
+launch_hint
+    : TOKEN_IDENTIFIER '=' TOKEN_IDENTIFIER
+    {
+        std::pair<std::string, SourcePos> *p = new std::pair<std::string, SourcePos>;
+        p->first = *$<stringVal>1 + "=" + *$<stringVal>3;
+        p->second = Union(@1, @3);
+        $$ = p;
+    }
+    | TOKEN_IDENTIFIER '=' int_constant
+    {
+        std::pair<std::string, SourcePos> *p = new std::pair<std::string, SourcePos>;
+        p->first = *$<stringVal>1 + "=" + std::to_string((int64_t)$3);
+        p->second = Union(@1, @3);
+        $$ = p;
+    }
+    ;
+
+launch_hint_list
+    : launch_hint
+    {
+        $$ = new std::vector<std::pair<std::string, SourcePos> >;
+        $$->push_back(*$1);
+    }
+    | launch_hint_list ',' launch_hint
+    {
+        if ($1 != NULL)
+            $1->push_back(*$3);
+        $$ = $1;
+    }
+    ;
+
+launch_hints
+    : '<' launch_hint_list '>'
+    {
+        $$ = lGetLaunchHints(*$2);
+    }
     ;
 
 invoke_sycl_expression
@@ -558,7 +617,7 @@ funcall_expression
           const std::string name = $1->first->name;
           m->symbolTable->LookupFunctionTemplate(name, &funcTempls);
           if (funcTempls.size() > 0) {
-              std::vector<std::pair<const Type *, SourcePos>> *templArgs = $1->second;
+              std::vector<TemplateArg> *templArgs = $1->second;
               Assert(templArgs);
               functionSymbolExpr = new FunctionSymbolExpr(name.c_str(), funcTempls, *templArgs, @1);
               $$ = new FunctionCallExpr(functionSymbolExpr, new ExprList(Union(@1,@2)), Union(@1,@3));
@@ -575,7 +634,7 @@ funcall_expression
           const std::string name = $1->first->name;
           m->symbolTable->LookupFunctionTemplate(name, &funcTempls);
           if (funcTempls.size() > 0) {
-              std::vector<std::pair<const Type *, SourcePos>> *templArgs = $1->second;
+              std::vector<TemplateArg> *templArgs = $1->second;
               Assert(templArgs);
               functionSymbolExpr = new FunctionSymbolExpr(name.c_str(), funcTempls, *templArgs, @1);
               $$ = new FunctionCallExpr(functionSymbolExpr, $3, Union(@1,@4));
@@ -878,6 +937,32 @@ declspec_item
         p->second = @1;
         $$ = p;
     }
+    | TOKEN_IDENTIFIER '(' declspec_string_list ')'
+    {
+        std::pair<std::string, SourcePos> *p = new std::pair<std::string, SourcePos>;
+        p->first = *$<stringVal>1 + "(" + *$3 + ")";
+        p->second = Union(@1, @4);
+        $$ = p;
+    }
+    | TOKEN_IDENTIFIER '(' TOKEN_IDENTIFIER ')'
+    {
+        std::pair<std::string, SourcePos> *p = new std::pair<std::string, SourcePos>;
+        p->first = *$<stringVal>1 + "(" + *$<stringVal>3 + ")";
+        p->second = Union(@1, @4);
+        $$ = p;
+    }
+    ;
+
+declspec_string_list
+    : TOKEN_STRING_LITERAL
+    {
+        $$ = new std::string(*$<stringVal>1);
+    }
+    | declspec_string_list ',' TOKEN_STRING_LITERAL
+    {
+        *$1 += "," + *$<stringVal>3;
+        $$ = $1;
+    }
     ;
 
 declspec_list
@@ -1031,6 +1116,7 @@ storage_class_specifier
     | TOKEN_EXTERN TOKEN_STRING_C_LITERAL  { $$ = SC_EXTERN_C; }
     | TOKEN_EXTERN TOKEN_STRING_SYCL_LITERAL  { $$ = SC_EXTERN_SYCL; }
     | TOKEN_STATIC { $$ = SC_STATIC; }
+    | TOKEN_SHARED { $$ = SC_SHARED; }
     ;
 
 type_specifier
@@ -1231,6 +1317,16 @@ specifier_qualifier_list
             }
             else if ($1 == TYPEQUAL_CONST)
                 $$ = $2->GetAsConstType();
+            else if ($1 == TYPEQUAL_RESTRICT) {
+                const PointerType *pt = CastType<PointerType>($2);
+                if (pt == NULL) {
+                    Error(@1, "\"restrict\" qualifier is illegal with non-pointer type \"%s\".",
+                          $2->ResolveUnboundVariability(Variability::Varying)->GetString().c_str());
+                    $$ = $2;
+                }
+                else
+                    $$ = pt->GetAsRestrictType();
+            }
             else if ($1 == TYPEQUAL_SIGNED) {
                 if ($2->IsIntType() == false) {
                     Error(@1, "Can't apply \"signed\" qualifier to \"%s\" type.",
@@ -1412,6 +1508,7 @@ enumerator
 
 type_qualifier
     : TOKEN_CONST         { $$ = TYPEQUAL_CONST; }
+    | TOKEN_RESTRICT      { $$ = TYPEQUAL_RESTRICT; }
     | TOKEN_UNIFORM       { $$ = TYPEQUAL_UNIFORM; }
     | TOKEN_VARYING       { $$ = TYPEQUAL_VARYING; }
     | TOKEN_TASK          { $$ = TYPEQUAL_TASK; }
@@ -1819,6 +1916,18 @@ attributed_statement
             std::pair<Globals::pragmaUnrollType, int> unrollVal = std::pair<Globals::pragmaUnrollType, int>($1->unrollType, $1->count);
             $2->SetLoopAttribute(unrollVal);
         }
+        else if (($1->aType == PragmaAttributes::AttributeType::pragmanontemporal) && ($2 != NULL)) {
+            $2->SetNontemporal();
+        }
+        else if (($1->aType == PragmaAttributes::AttributeType::pragmatile) && ($2 != NULL)) {
+            $2->SetCacheTiles($1->tiles);
+        }
+        else if (($1->aType == PragmaAttributes::AttributeType::pragmawidth) && ($2 != NULL)) {
+            $2->SetGangWidth($1->count);
+        }
+        else if (($1->aType == PragmaAttributes::AttributeType::pragmainterleave) && ($2 != NULL)) {
+            $2->SetInterleave($1->count);
+        }
         $$ = $2;
     }
     | statement
@@ -1941,6 +2050,72 @@ foreach_tiled_scope
     : TOKEN_FOREACH_TILED { m->symbolTable->PushScope(); }
     ;
 
+foreach_dynamic_scope
+    : TOKEN_FOREACH_DYNAMIC { m->symbolTable->PushScope(); }
+    ;
+
+parallel_foreach_scope
+    : TOKEN_PARALLEL_FOREACH { m->symbolTable->PushScope(); }
+    ;
+
+parallel_reduction_op
+    : '+' { $$ = ParallelReduction::Add; }
+    | '*' { $$ = ParallelReduction::Mul; }
+    | '&' { $$ = ParallelReduction::BitAnd; }
+    | '|' { $$ = ParallelReduction::BitOr; }
+    | '^' { $$ = ParallelReduction::BitXor; }
+    ;
+
+parallel_reduction_vars
+    : TOKEN_IDENTIFIER
+      {
+          $$ = new std::vector<Symbol *>;
+          Symbol *s = m->symbolTable->LookupVariable($<stringVal>1->c_str());
+          if (s == NULL)
+              Error(@1, "Undeclared symbol \"%s\" in \"reduce\" clause.", $<stringVal>1->c_str());
+          else
+              $$->push_back(s);
+      }
+    | parallel_reduction_vars ',' TOKEN_IDENTIFIER
+      {
+          Symbol *s = m->symbolTable->LookupVariable($<stringVal>3->c_str());
+          if (s == NULL)
+              Error(@3, "Undeclared symbol \"%s\" in \"reduce\" clause.", $<stringVal>3->c_str());
+          else
+              $1->push_back(s);
+          $$ = $1;
+      }
+    ;
+
+parallel_reduction
+    : TOKEN_IDENTIFIER '(' parallel_reduction_op ':' parallel_reduction_vars ')'
+      { $$ = lCreateReductions(*$<stringVal>1, $3, NULL, NULL, *$5, Union(@1, @6)); }
+    | TOKEN_IDENTIFIER '(' TOKEN_IDENTIFIER ':' parallel_reduction_vars ')'
+      {
+          $$ = lCreateReductions(*$<stringVal>1, ParallelReduction::Function, $<stringVal>3, NULL, *$5,
+                                 Union(@1, @6));
+      }
+    | TOKEN_IDENTIFIER '(' TOKEN_IDENTIFIER ',' conditional_expression ':' parallel_reduction_vars ')'
+      {
+          $$ = lCreateReductions(*$<stringVal>1, ParallelReduction::Function, $<stringVal>3, $5, *$7,
+                                 Union(@1, @8));
+      }
+    ;
+
+parallel_reduction_list
+    : parallel_reduction
+    | parallel_reduction_list parallel_reduction
+      {
+          $1->insert($1->end(), $2->begin(), $2->end());
+          $$ = $1;
+      }
+    ;
+
+parallel_foreach_reductions
+    : /* empty */ { $$ = new std::vector<ParallelReduction *>; }
+    | ';' parallel_reduction_list { $$ = $2; }
+    ;
+
 foreach_identifier
     : TOKEN_IDENTIFIER
     {
@@ -2098,6 +2273,67 @@ iteration_statement
          $$ = new ForeachStmt(syms, begins, ends, $6, true, @1);
          m->symbolTable->PopScope();
      }
+    | foreach_dynamic_scope '(' foreach_dimension_list ')'
+     {
+         std::vector<ForeachDimension *> *dims = $3;
+         if (dims == NULL) {
+             AssertPos(@3, m->errorCount > 0);
+             dims = new std::vector<ForeachDimension *>;
+         }
+         for (unsigned int i = 0; i < dims->size(); ++i)
+             m->symbolTable->AddVariable((*dims)[i]->sym);
+     }
+     attributed_statement
+     {
+         std::vector<ForeachDimension *> *dims = $3;
+         if (dims == NULL) {
+             AssertPos(@3, m->errorCount > 0);
+             dims = new std::vector<ForeachDimension *>;
+         }
+
+         std::vector<Symbol *> syms;
+         std::vector<Expr *> begins, ends;
+         for (unsigned int i = 0; i < dims->size(); ++i) {
+             syms.push_back((*dims)[i]->sym);
+             begins.push_back((*dims)[i]->beginExpr);
+             ends.push_back((*dims)[i]->endExpr);
+         }
+         ForeachStmt *fs = new ForeachStmt(syms, begins, ends, $6, false, @1);
+         fs->isDynamic = true;
+         $$ = fs;
+         m->symbolTable->PopScope();
+     }
+    | parallel_foreach_scope '(' foreach_dimension_list parallel_foreach_reductions ')'
+     {
+         std::vector<ForeachDimension *> *dims = $3;
+         if (dims == NULL) {
+             AssertPos(@3, m->errorCount > 0);
+             dims = new std::vector<ForeachDimension *>;
+         }
+         for (unsigned int i = 0; i < dims->size(); ++i)
+             m->symbolTable->AddVariable((*dims)[i]->sym);
+     }
+     attributed_statement
+     {
+         std::vector<ForeachDimension *> *dims = $3;
+         if (dims == NULL) {
+             AssertPos(@3, m->errorCount > 0);
+             dims = new std::vector<ForeachDimension *>;
+         }
+
+         std::vector<Symbol *> syms;
+         std::vector<Expr *> begins, ends;
+         for (unsigned int i = 0; i < dims->size(); ++i) {
+             syms.push_back((*dims)[i]->sym);
+             begins.push_back((*dims)[i]->beginExpr);
+             ends.push_back((*dims)[i]->endExpr);
+         }
+         ForeachStmt *fs = new ForeachStmt(syms, begins, ends, $7, false, @1);
+         fs->isParallel = true;
+         fs->reductions = *$4;
+         $$ = fs;
+         m->symbolTable->PopScope();
+     }
     | foreach_active_scope '(' foreach_active_identifier ')'
      {
          if ($3 != NULL)
@@ -2250,22 +2486,32 @@ func(...)
 template_type_parameter
     : TOKEN_TYPENAME TOKEN_IDENTIFIER
       {
-          $$ = new TemplateTypeParmType(*$<stringVal>2, Variability::VarType::Unbound, false, Union(@1, @2));
+          $$ = new TemplateParam(new TemplateTypeParmType(*$<stringVal>2, Variability::VarType::Unbound, false,
+                                                          Union(@1, @2)));
       }
     | TOKEN_TYPENAME TOKEN_IDENTIFIER '=' type_specifier
       {
-          $$ = new TemplateTypeParmType(*$<stringVal>2, Variability::VarType::Unbound, false, Union(@1, @2));
+          $$ = new TemplateParam(new TemplateTypeParmType(*$<stringVal>2, Variability::VarType::Unbound, false,
+                                                          Union(@1, @2)));
           // TODO: implement
           Error(@4, "Default values for template type parameters are not yet supported.");
       }
     ;
 
+ // Non-type template parameters are always uniform int32 constants.
 template_int_parameter
     : TOKEN_INT TOKEN_IDENTIFIER
       {
-          $$ = nullptr;
-          // TODO: implement
-          Error(Union(@1, @2), "Non-type template paramters are not yet supported.");
+          $$ = new TemplateParam(new Symbol(*$<stringVal>2, @2, AtomicType::UniformInt32->GetAsConstType()));
+      }
+    | TOKEN_UNIFORM TOKEN_INT TOKEN_IDENTIFIER
+      {
+          $$ = new TemplateParam(new Symbol(*$<stringVal>3, @3, AtomicType::UniformInt32->GetAsConstType()));
+      }
+    | TOKEN_VARYING TOKEN_INT TOKEN_IDENTIFIER
+      {
+          $$ = new TemplateParam(new Symbol(*$<stringVal>3, @3, AtomicType::UniformInt32->GetAsConstType()));
+          Error(Union(@1, @3), "Non-type template parameters must be \"uniform\".");
       }
     ;
 
@@ -2313,7 +2559,11 @@ template_declaration
           for(size_t i = 0; i < list->GetCount(); i++) {
               std::string name = (*list)[i]->GetName();
               SourcePos pos = (*list)[i]->GetSourcePos();
-              m->AddTypeDef(name, (*list)[i], pos);
+              if ((*list)[i]->IsTypeParam()) {
+                  m->AddTypeDef(name, (*list)[i]->GetTypeParam(), pos);
+              } else {
+                  m->symbolTable->AddVariable((*list)[i]->GetNonTypeParam());
+              }
           }
       }
       declaration_specifiers declarator
@@ -2355,14 +2605,26 @@ template_function_declaration_or_definition
 template_argument_list
     : rate_qualified_type_specifier
       {
-          std::vector<std::pair<const Type *, SourcePos>> *vec = new std::vector<std::pair<const Type *, SourcePos>>;
-          vec->push_back(std::make_pair($1, @1));
+          std::vector<TemplateArg> *vec = new std::vector<TemplateArg>;
+          vec->push_back(TemplateArg($1, @1));
+          $$ = vec;
+      }
+    | additive_expression
+      {
+          std::vector<TemplateArg> *vec = new std::vector<TemplateArg>;
+          vec->push_back(TemplateArg($1, @1));
           $$ = vec;
       }
     | template_argument_list ',' rate_qualified_type_specifier
       {
-          std::vector<std::pair<const Type *, SourcePos>> *vec = (std::vector<std::pair<const Type *, SourcePos>> *) $1;
-          vec->push_back(std::make_pair($3, @3));
+          std::vector<TemplateArg> *vec = (std::vector<TemplateArg> *) $1;
+          vec->push_back(TemplateArg($3, @3));
+          $$ = vec;
+      }
+    | template_argument_list ',' additive_expression
+      {
+          std::vector<TemplateArg> *vec = (std::vector<TemplateArg> *) $1;
+          vec->push_back(TemplateArg($3, @3));
           $$ = vec;
       }
     ;
@@ -2378,7 +2640,7 @@ simple_template_id
           Declarator *d = new Declarator(DK_BASE, @1);
           d->name = $1;
           // Arguments vector
-          std::vector<std::pair<const Type *, SourcePos>> *vec = (std::vector<std::pair<const Type *, SourcePos>> *) $3;
+          std::vector<TemplateArg> *vec = (std::vector<TemplateArg> *) $3;
           // Bundle template ID declarator and type list.
           $$ = new std::pair(d, vec);
       }
@@ -2388,7 +2650,7 @@ simple_template_id
           Declarator *d = new Declarator(DK_BASE, @1);
           d->name = $1;
           // Arguments vector
-          std::vector<std::pair<const Type *, SourcePos>> *vec = new std::vector<std::pair<const Type *, SourcePos>>;
+          std::vector<TemplateArg> *vec = new std::vector<TemplateArg>;
           // Bundle template ID declarator and empty type list.
           $$ = new std::pair(d, vec);
       }
@@ -2738,6 +3000,8 @@ lGetStorageClassString(StorageClass sc) {
         return "extern \"C\"";
     case SC_EXTERN_SYCL:
         return "extern \"SYCL\"";
+    case SC_SHARED:
+        return "shared";
     default:
         Assert(!"logic error in lGetStorageClassString()");
         return "";
@@ -2849,3 +3113,109 @@ lFinalizeEnumeratorSymbols(std::vector<Symbol *> &enums,
         }
     }
 }
+
+
+/** Parses the attributes of a "launch" given between '<' '>', like
+    "grain=16", into the scheduling hints that are passed to the task
+    system. */
+static LaunchHints *
+lGetLaunchHints(const std::vector<std::pair<std::string, SourcePos> > &hints) {
+    LaunchHints *launchHints = new LaunchHints;
+    for (const auto &hint : hints) {
+        const std::string &str = hint.first;
+        size_t equals = str.find('=');
+        std::string name = str.substr(0, equals), value = str.substr(equals + 1);
+        if (name == "grain") {
+            char *end = NULL;
+            long long grain = strtoll(value.c_str(), &end, 10);
+            if (*end != '\0' || grain < 1 || grain > INT32_MAX)
+                Error(hint.second, "Grain of \"launch\" must be a positive integer constant, found \"%s\".",
+                      value.c_str());
+            else
+                launchHints->grain = (int)grain;
+        }
+        else if (name == "affinity") {
+            if (value == "compact")
+                launchHints->affinity = LaunchHints::AffinityCompact;
+            else if (value == "spread")
+                launchHints->affinity = LaunchHints::AffinitySpread;
+            else
+                Error(hint.second, "Expected \"compact\" or \"spread\" for the affinity of \"launch\", "
+                      "found \"%s\".", value.c_str());
+        }
+        else if (name == "priority") {
+            if (value == "low")
+                launchHints->priority = LaunchHints::PriorityLow;
+            else if (value == "normal")
+                launchHints->priority = LaunchHints::PriorityNormal;
+            else if (value == "high")
+                launchHints->priority = LaunchHints::PriorityHigh;
+            else
+                Error(hint.second, "Expected \"low\", \"normal\" or \"high\" for the priority of "
+                      "\"launch\", found \"%s\".", value.c_str());
+        }
+        else
+            Error(hint.second, "Unknown \"launch\" attribute \"%s\"; expected \"grain\", "
+                  "\"affinity\" or \"priority\".", name.c_str());
+    }
+    return launchHints;
+}
+
+
+/** Creates the reductions of a "reduce" clause of a "parallel_foreach"
+    loop with the given operator for each of the given variables.  An
+    operator given by name is "min", "max" or, with the identity value, a
+    function that takes and returns values of the type of the variables. */
+static std::vector<ParallelReduction *> *
+lCreateReductions(const std::string &clause, int op, const std::string *funcName, Expr *identity,
+                  const std::vector<Symbol *> &syms, SourcePos pos) {
+    std::vector<ParallelReduction *> *reductions = new std::vector<ParallelReduction *>;
+    // "reduce" isn't a keyword, so that it remains usable as an identifier
+    // elsewhere.
+    if (clause != "reduce") {
+        Error(pos, "Expected \"reduce\" clause for \"parallel_foreach\" loop, found \"%s\".",
+              clause.c_str());
+        return reductions;
+    }
+
+    std::vector<Symbol *> funs;
+    if (funcName != NULL && identity == NULL && (*funcName == "min" || *funcName == "max")) {
+        op = (*funcName == "min") ? ParallelReduction::Min : ParallelReduction::Max;
+        funcName = NULL;
+    } else if (funcName != NULL) {
+        m->symbolTable->LookupFunction(funcName->c_str(), &funs);
+        if (funs.size() == 0) {
+            Error(pos, "Undeclared function \"%s\" in \"reduce\" clause.", funcName->c_str());
+            return reductions;
+        }
+        if (identity == NULL) {
+            Error(pos, "\"reduce\" clause with function \"%s\" must give the identity value: "
+                  "\"reduce(%s, <identity>: ...)\".", funcName->c_str(), funcName->c_str());
+            return reductions;
+        }
+    }
+
+    for (Symbol *sym : syms) {
+        // Each reduction resolves the overload of the function for its
+        // variable's type.
+        Expr *func = funcName ? new FunctionSymbolExpr(funcName->c_str(), funs, pos) : NULL;
+        reductions->push_back(new ParallelReduction((ParallelReduction::Op)op, sym, func, identity, pos));
+    }
+    return reductions;
+}
+
+
+/** Creates the call of a "launch" expression in brackets with the given
+    numbers of tasks, a single one if launchCount is NULL, and the given
+    scheduling hints, if any. */
+static Expr *
+lCreateLaunchExpr(ExprList *launchCount, LaunchHints *hints, Expr *func, ExprList *args,
+                  SourcePos pos) {
+    Expr *counts[3];
+    for (int i = 0; i < 3; ++i)
+        counts[i] = launchCount ? launchCount->exprs[i] :
+            new ConstExpr(AtomicType::UniformInt32, (int32_t)1, pos);
+    FunctionCallExpr *fce = new FunctionCallExpr(func, args, pos, true, counts);
+    fce->launchHints = hints;
+    return fce;
+}
@@ -0,0 +1,359 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+/** @file server.cpp
+    @brief Implementation of the compile server and its client.
+*/
+
+#include "server.h"
+#include "ispc.h"
+#include "util.h"
+
+#ifndef ISPC_HOST_IS_WINDOWS
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <llvm/Support/Signals.h>
+#endif
+
+using namespace ispc;
+
+#ifndef ISPC_HOST_IS_WINDOWS
+
+// A request starts with this header.  The client's standard input, output
+// and error descriptors are attached to it, and it is followed by the
+// current directory of the client and its arguments, each of them
+// terminated with zero.  The server replies with the 32-bit exit code.
+struct RequestHeader {
+    char magic[4];
+    uint32_t size;
+};
+
+static const char lRequestMagic[4] = {'I', 'S', 'P', 'C'};
+
+// Limits the size of the request to the reasonable value, so a broken
+// client can't make the server allocate arbitrary amount of memory.
+static const uint32_t lMaxRequestSize = 16 * 1024 * 1024;
+
+static bool lWriteAll(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool lReadAll(int fd, char *data, size_t size) {
+    while (size > 0) {
+        ssize_t read_bytes = read(fd, data, size);
+        if (read_bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (read_bytes <= 0) {
+            return false;
+        }
+        data += read_bytes;
+        size -= read_bytes;
+    }
+    return true;
+}
+
+static bool lInitAddress(const char *socketPath, sockaddr_un &addr) {
+    if (strlen(socketPath) >= sizeof(addr.sun_path)) {
+        return false;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath, sizeof(addr.sun_path) - 1);
+    return true;
+}
+
+/** Connects to the socket at the given path, returns the descriptor of the
+    connection or -1 on failure. */
+static int lConnect(const char *socketPath) {
+    sockaddr_un addr;
+    if (!lInitAddress(socketPath, addr)) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Path of the server socket, it is removed when the server is interrupted.
+static char lSocketPath[sizeof(sockaddr_un::sun_path)];
+
+static void lInterruptServer() {
+    unlink(lSocketPath);
+    _exit(1);
+}
+
+/** Checks that the client on the other end of the connection runs as the
+    same user as the server.  The request is compiled in the directory and
+    with the descriptors passed by the client, so the server must not serve
+    anyone else. */
+static bool lPeerIsOwner(int conn) {
+#if defined(__linux__)
+    ucred cred;
+    socklen_t size = sizeof(cred);
+    if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &size) != 0 || size != sizeof(cred)) {
+        return false;
+    }
+    return cred.uid == getuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    if (getpeereid(conn, &uid, &gid) != 0) {
+        return false;
+    }
+    return uid == getuid();
+#endif
+}
+
+/** Receives the request from the connection, compiles it in a separate
+    process and sends back the exit code.  Runs in a process forked from the
+    server for each connection, so the server can accept the next request
+    while this one is compiled. */
+static void lServeRequest(int conn, const CompileFunction &compile) {
+    RequestHeader header;
+    int fds[3] = {-1, -1, -1};
+    char control[CMSG_SPACE(sizeof(fds))];
+    iovec iov = {&header, sizeof(header)};
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(conn, &msg, MSG_WAITALL) != sizeof(header) || memcmp(header.magic, lRequestMagic, 4) != 0 ||
+        header.size > lMaxRequestSize) {
+        return;
+    }
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(sizeof(fds))) {
+        return;
+    }
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+    std::vector<char> request(header.size + 1, '\0');
+    if (!lReadAll(conn, request.data(), header.size)) {
+        return;
+    }
+    // The first string is the current directory of the client, the rest
+    // are the arguments.
+    const char *cwd = request.data();
+    static char programName[] = "ispc";
+    std::vector<char *> argv = {programName};
+    for (size_t pos = strlen(cwd) + 1; pos < header.size; pos += strlen(&request[pos]) + 1) {
+        argv.push_back(&request[pos]);
+    }
+
+    pid_t worker = fork();
+    if (worker == 0) {
+        close(conn);
+        for (int i = 0; i < 3; ++i) {
+            dup2(fds[i], i);
+            close(fds[i]);
+        }
+        if (chdir(cwd) != 0) {
+            fprintf(stderr, "Error: can't change directory to \"%s\": %s\n", cwd, strerror(errno));
+            exit(1);
+        }
+        int ret = compile(argv);
+        fflush(stdout);
+        fflush(stderr);
+        exit(ret);
+    }
+    for (int i = 0; i < 3; ++i) {
+        close(fds[i]);
+    }
+
+    int32_t exitCode = 1;
+    int status = 0;
+    if (worker > 0) {
+        while (waitpid(worker, &status, 0) < 0 && errno == EINTR)
+            ;
+        // Report the crash of the compilation the same way as shell does.
+        exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    }
+    lWriteAll(conn, (const char *)&exitCode, sizeof(exitCode));
+}
+
+int ispc::RunCompileServer(const char *socketPath, const CompileFunction &compile) {
+    sockaddr_un addr;
+    if (!lInitAddress(socketPath, addr)) {
+        Error(SourcePos(), "Compile server socket path \"%s\" is too long.", socketPath);
+        return 1;
+    }
+    int running = lConnect(socketPath);
+    if (running >= 0) {
+        close(running);
+        Error(SourcePos(), "Compile server is already running on \"%s\".", socketPath);
+        return 1;
+    }
+    // Remove the socket left by the server, which was not shut down properly.
+    unlink(socketPath);
+
+    // Only the owner may connect to the socket, so create it with no
+    // permissions for the group and others.
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    mode_t oldMask = umask(077);
+    bool bound = listener >= 0 && bind(listener, (sockaddr *)&addr, sizeof(addr)) == 0;
+    umask(oldMask);
+    if (!bound || chmod(socketPath, 0600) != 0 || listen(listener, SOMAXCONN) != 0) {
+        Error(SourcePos(), "Can't start compile server on \"%s\": %s", socketPath, strerror(errno));
+        return 1;
+    }
+    strncpy(lSocketPath, socketPath, sizeof(lSocketPath) - 1);
+    llvm::sys::SetInterruptFunction(lInterruptServer);
+
+    while (true) {
+        int conn = accept(listener, nullptr, nullptr);
+        // Collect the processes of the requests served so far.
+        while (waitpid(-1, nullptr, WNOHANG) > 0)
+            ;
+        if (conn < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            Error(SourcePos(), "Compile server failed to accept connection: %s", strerror(errno));
+            break;
+        }
+        if (!lPeerIsOwner(conn)) {
+            Warning(SourcePos(), "Compile server rejected connection from another user.");
+            close(conn);
+            continue;
+        }
+        pid_t handler = fork();
+        if (handler == 0) {
+            close(listener);
+            // The socket belongs to the server, it must not be removed if
+            // the compilation is interrupted.
+            llvm::sys::SetInterruptFunction(nullptr);
+            lServeRequest(conn, compile);
+            _exit(0);
+        }
+        close(conn);
+    }
+    close(listener);
+    unlink(socketPath);
+    return 1;
+}
+
+bool ispc::RunCompileClient(const char *socketPath, const std::vector<char *> &argv, int &exitCode) {
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, sizeof(cwd)) == NULL) {
+        return false;
+    }
+    std::string request(cwd, strlen(cwd) + 1);
+    for (size_t i = 1; i < argv.size(); ++i) {
+        request.append(argv[i], strlen(argv[i]) + 1);
+    }
+    if (request.size() > lMaxRequestSize) {
+        return false;
+    }
+
+    int conn = lConnect(socketPath);
+    if (conn < 0) {
+        return false;
+    }
+
+    RequestHeader header;
+    memcpy(header.magic, lRequestMagic, 4);
+    header.size = request.size();
+    int fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    char control[CMSG_SPACE(sizeof(fds))];
+    memset(control, 0, sizeof(control));
+    iovec iov = {&header, sizeof(header)};
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    if (sendmsg(conn, &msg, 0) != sizeof(header) || !lWriteAll(conn, request.data(), request.size())) {
+        close(conn);
+        return false;
+    }
+
+    // The compilation may have already written to the standard streams, so
+    // it can't be repeated locally if the server doesn't reply.
+    int32_t ret = 1;
+    if (!lReadAll(conn, (char *)&ret, sizeof(ret))) {
+        fprintf(stderr, "Error: connection to compile server \"%s\" was lost.\n", socketPath);
+    }
+    close(conn);
+    exitCode = ret;
+    return true;
+}
+
+#else
+
+int ispc::RunCompileServer(const char *socketPath, const CompileFunction &compile) {
+    Error(SourcePos(), "Compile server is not supported on Windows.");
+    return 1;
+}
+
+bool ispc::RunCompileClient(const char *socketPath, const std::vector<char *> &argv, int &exitCode) { return false; }
+
+#endif // ISPC_HOST_IS_WINDOWS
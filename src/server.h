@@ -0,0 +1,69 @@
+/*
+  Copyright (c) 2023, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+/** @file server.h
+    @brief Compile server, which keeps the compiler initialized and serves
+           compilation requests of the clients started with --connect.
+*/
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+namespace ispc {
+
+/** Function running compilation for the given command line and returning
+    its exit code. */
+typedef std::function<int(std::vector<char *> &argv)> CompileFunction;
+
+/** Listens on the local socket at the given path and runs the compile
+    function for each command line received from a client.  Every request is
+    compiled in a process forked from the server, so the state prepared
+    before this call (initialized LLVM targets, preloaded builtins) is shared
+    by all compilations, while the changes made by a compilation are never
+    seen by the next one.  The compilation runs in the current directory of
+    the client and uses its standard input, output and error.  Returns only
+    if the server fails to start or to accept connections.
+ */
+int RunCompileServer(const char *socketPath, const CompileFunction &compile);
+
+/** Sends the command line to the compile server listening on the socket at
+    the given path and waits for the compilation to finish.  Returns false if
+    the request can't be sent (e.g. the server is not running), otherwise
+    returns true and sets the exit code of the compilation.
+ */
+bool RunCompileClient(const char *socketPath, const std::vector<char *> &argv, int &exitCode);
+
+} // namespace ispc
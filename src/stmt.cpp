@@ -48,7 +48,9 @@
 
 #include <algorithm>
 #include <iterator>
+#include <limits>
 #include <map>
+#include <set>
 #include <sstream>
 #include <stdio.h>
 
@@ -56,7 +58,9 @@
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/Instructions.h>
+#include <llvm/IR/Intrinsics.h>
 #include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Metadata.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Type.h>
@@ -74,6 +78,22 @@ void Stmt::SetLoopAttribute(std::pair<Globals::pragmaUnrollType, int> lAttr) {
     Error(pos, "Illegal pragma - expected a loop to follow '#pragma unroll/nounroll'.");
 }
 
+void Stmt::SetNontemporal() {
+    Error(pos, "Illegal pragma - expected a \"foreach\" loop to follow '#pragma nontemporal'.");
+}
+
+void Stmt::SetCacheTiles(const std::vector<int> &tiles) {
+    Error(pos, "Illegal pragma - expected a \"foreach\" loop to follow '#pragma tile'.");
+}
+
+void Stmt::SetGangWidth(int width) {
+    Error(pos, "Illegal pragma - expected a \"foreach\" loop to follow '#pragma width'.");
+}
+
+void Stmt::SetInterleave(int groups) {
+    Error(pos, "Illegal pragma - expected a \"foreach_dynamic\" loop to follow '#pragma interleave'.");
+}
+
 ///////////////////////////////////////////////////////////////////////////
 // ExprStmt
 
@@ -232,6 +252,36 @@ void DeclStmt::EmitCode(FunctionEmitContext *ctx) const {
                 llvmType);
             // Tell the FunctionEmitContext about the variable
             ctx->EmitVariableDebugInfo(sym);
+        } else if (sym->storageClass == SC_SHARED) {
+            // 'shared' variables are shared by the tasks running in the
+            // same workgroup.
+            const FunctionType *ft = ctx->GetFunction()->GetType();
+            if (ft == NULL || !ft->isTask) {
+                Error(sym->pos, "\"shared\" qualifier can only be used for variables declared in \"task\" functions.");
+                continue;
+            }
+            if (initExpr != NULL) {
+                Error(initExpr->pos, "Initializer can't be provided for \"shared\" variable \"%s\".",
+                      sym->name.c_str());
+                continue;
+            }
+
+            if (g->target->isXeTarget()) {
+                // On Xe, they live in the workgroup's shared local memory,
+                // whose size is reported in the kernel's metadata.
+                llvm::GlobalVariable *slm = new llvm::GlobalVariable(
+                    *m->module, llvmType, false, llvm::GlobalValue::InternalLinkage, llvm::UndefValue::get(llvmType),
+                    llvm::Twine("shared.") + llvm::Twine(sym->pos.first_line) + llvm::Twine(".") + sym->name.c_str(),
+                    nullptr, llvm::GlobalVariable::NotThreadLocal, (unsigned)AddressSpace::ispc_local);
+                slm->setAlignment(llvm::MaybeAlign(g->target->getNativeVectorAlignment()));
+                sym->storageInfo = new AddressInfo(slm, llvmType);
+                ctx->AddSharedLocalMemory(g->target->getDataLayout()->getTypeAllocSize(llvmType));
+            } else
+                // On the CPU, each task is a workgroup of its own, so they
+                // are just regular local variables.
+                sym->storageInfo = ctx->AllocaInst(sym->type, sym->name.c_str());
+            sym->parentFunction = ctx->GetFunction();
+            ctx->EmitVariableDebugInfo(sym);
         } else {
             // For non-static variables, allocate storage on the stack
             sym->storageInfo = ctx->AllocaInst(sym->type, sym->name.c_str());
@@ -370,6 +420,15 @@ DeclStmt *DeclStmt::Instantiate(TemplateInstantiation &templInst) const {
 ///////////////////////////////////////////////////////////////////////////
 // IfStmt
 
+/** Returns true if a varying "if" statement or loop that isn't marked as
+    coherent should still check for the mask being all on and run a
+    separate copy of its code for that case, given the estimated cost of
+    that code.  This is only done with --opt=auto-coherent-control-flow. */
+static bool lAutoCoherentCheck(int cost) {
+    return g->opt.autoCoherentControlFlow && !g->opt.disableCoherentControlFlow &&
+           !g->target->getMaskingIsFree() && cost >= AUTO_COHERENT_CONTROL_FLOW_COST;
+}
+
 IfStmt::IfStmt(Expr *t, Stmt *ts, Stmt *fs, bool checkCoherence, SourcePos p)
     : Stmt(p, IfStmtID), test(t), trueStmts(ts), falseStmts(fs),
       doAllCheck(checkCoherence && !g->opt.disableCoherentControlFlow) {}
@@ -566,7 +625,12 @@ void IfStmt::emitMaskedTrueAndFalse(FunctionEmitContext *ctx, llvm::Value *oldMa
  */
 void IfStmt::emitVaryingIf(FunctionEmitContext *ctx, llvm::Value *ltest) const {
     llvm::Value *oldMask = ctx->GetInternalMask();
-    if (doAllCheck) {
+    bool checkAllOn = doAllCheck;
+    if (!checkAllOn && lAutoCoherentCheck(::EstimateCost(trueStmts) + ::EstimateCost(falseStmts))) {
+        Debug(pos, "Treating expensive \"if\" statement as \"cif\".");
+        checkAllOn = true;
+    }
+    if (checkAllOn) {
         // We can't tell if the mask going into the if is all on at the
         // compile time.  Emit code to check for this and then either run
         // the code for the 'all on' or the 'mixed' case depending on the
@@ -869,7 +933,12 @@ void DoStmt::EmitCode(FunctionEmitContext *ctx) const {
         ctx->StartScope();
 
     ctx->AddInstrumentationPoint("do loop body");
-    if (doCoherentCheck && !uniformTest) {
+    bool coherentCheck = doCoherentCheck;
+    if (!coherentCheck && !uniformTest && lAutoCoherentCheck(::EstimateCost(bodyStmts))) {
+        Debug(pos, "Treating expensive \"do\" loop as \"cdo\".");
+        coherentCheck = true;
+    }
+    if (coherentCheck && !uniformTest) {
         // Check to see if the mask is all on
         llvm::BasicBlock *bAllOn = ctx->CreateBasicBlock("do_all_on");
         llvm::BasicBlock *bMixed = ctx->CreateBasicBlock("do_mixed");
@@ -1108,7 +1177,12 @@ void ForStmt::EmitCode(FunctionEmitContext *ctx) const {
     if (!llvm::dyn_cast_or_null<StmtList>(stmts))
         ctx->StartScope();
 
-    if (doCoherentCheck && !uniformTest) {
+    bool coherentCheck = doCoherentCheck;
+    if (!coherentCheck && !uniformTest && lAutoCoherentCheck(::EstimateCost(stmts))) {
+        Debug(pos, "Treating expensive \"for\" loop as \"cfor\".");
+        coherentCheck = true;
+    }
+    if (coherentCheck && !uniformTest) {
         // For 'varying' loops with the coherence check, we start by
         // checking to see if the mask is all on, after it has been updated
         // based on the value of the test.
@@ -1395,10 +1469,985 @@ static void lGetSpans(int dimsLeft, int nDims, int itemsLeft, bool isTiled, int
    to process.
  */
 void ForeachStmt::EmitCode(FunctionEmitContext *ctx) const {
+    if (isParallel && !g->target->isXeTarget())
+        // There are no tasks launched from the device on Xe, where the
+        // loop is run as a regular foreach loop.
+        emitParallelLoops(ctx);
+    else if (isDynamic)
+        emitDynamicLoop(ctx);
+    else if (cacheTiles.empty())
+        emitLoops(ctx, std::vector<llvm::Value *>(), std::vector<llvm::Value *>());
+    else
+        emitCacheBlockedLoops(ctx);
+}
+
+/* Emit code for a foreach statement with '#pragma tile': uniform loops over
+   the blocks of the iteration domain, outermost dimension first, with the
+   regular foreach loops over the current block inside.  Each block is
+   clamped to the end of the domain, so only the last block of each
+   dimension can have extra elements to mask off.
+ */
+void ForeachStmt::emitCacheBlockedLoops(FunctionEmitContext *ctx) const {
+    if (ctx->GetCurrentBasicBlock() == NULL || stmts == NULL)
+        return;
+
+    ctx->SetDebugPos(pos);
+    // This should be caught during typechecking
+    AssertPos(pos, cacheTiles.size() == dimVariables.size());
+    int nDims = (int)dimVariables.size();
+
+    std::vector<llvm::Value *> startVals, endVals;
+    std::vector<AddressInfo *> blockPtrs;
+    for (int i = 0; i < nDims; ++i) {
+        llvm::Value *sv = startExprs[i]->GetValue(ctx);
+        llvm::Value *ev = endExprs[i]->GetValue(ctx);
+        if (sv == NULL || ev == NULL)
+            return;
+        startVals.push_back(sv);
+        endVals.push_back(ev);
+        blockPtrs.push_back(ctx->AllocaInst(LLVMTypes::Int32Type, "block_start"));
+    }
+
+    std::vector<llvm::BasicBlock *> bbInit, bbTest, bbStep;
+    for (int i = 0; i < nDims; ++i) {
+        bbInit.push_back(ctx->CreateBasicBlock("foreach_block_init"));
+        bbTest.push_back(ctx->CreateBasicBlock("foreach_block_test"));
+        bbStep.push_back(ctx->CreateBasicBlock("foreach_block_step"));
+    }
+    llvm::BasicBlock *bbBody = ctx->CreateBasicBlock("foreach_block_body");
+    llvm::BasicBlock *bbExit = ctx->CreateBasicBlock("foreach_block_exit");
+    ctx->BranchInst(bbInit[0]);
+
+    for (int i = 0; i < nDims; ++i) {
+        // foreach_block_init: start this dimension's blocks over
+        ctx->SetCurrentBasicBlock(bbInit[i]);
+        ctx->StoreInst(startVals[i], blockPtrs[i]);
+        ctx->BranchInst(bbTest[i]);
+
+        // foreach_block_test: go to the next dimension, or to the body for
+        // the innermost one, while there are blocks left in this one
+        ctx->SetCurrentBasicBlock(bbTest[i]);
+        llvm::Value *blockStart = ctx->LoadInst(blockPtrs[i]);
+        llvm::Value *haveBlock =
+            ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SLT, blockStart, endVals[i], "have_block");
+        ctx->BranchInst((i < nDims - 1) ? bbInit[i + 1] : bbBody, (i == 0) ? bbExit : bbStep[i - 1], haveBlock);
+
+        // foreach_block_step: advance to the next block of this dimension
+        ctx->SetCurrentBasicBlock(bbStep[i]);
+        blockStart = ctx->LoadInst(blockPtrs[i]);
+        llvm::Value *nextBlock =
+            ctx->BinaryOperator(llvm::Instruction::Add, blockStart, LLVMInt32(cacheTiles[i]), "next_block");
+        ctx->StoreInst(nextBlock, blockPtrs[i]);
+        ctx->BranchInst(bbTest[i]);
+    }
+
+    // foreach_block_body: run the foreach loops over the current block
+    ctx->SetCurrentBasicBlock(bbBody);
+    std::vector<llvm::Value *> blockStarts, blockEnds;
+    for (int i = 0; i < nDims; ++i) {
+        llvm::Value *blockStart = ctx->LoadInst(blockPtrs[i]);
+        llvm::Value *blockEnd =
+            ctx->BinaryOperator(llvm::Instruction::Add, blockStart, LLVMInt32(cacheTiles[i]), "block_end");
+        llvm::Value *pastEnd =
+            ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SGT, blockEnd, endVals[i], "past_end");
+        blockStarts.push_back(blockStart);
+        blockEnds.push_back(ctx->SelectInst(pastEnd, endVals[i], blockEnd, "block_end"));
+    }
+    emitLoops(ctx, blockStarts, blockEnds);
+    if (ctx->GetCurrentBasicBlock())
+        ctx->BranchInst(bbStep[nDims - 1]);
+
+    ctx->SetCurrentBasicBlock(bbExit);
+}
+
+/** The number of tasks that a 'parallel_foreach' loop is split into, as
+    long as there are enough elements to go around. */
+static const int lParallelForeachTasks = 256;
+
+/** The copies of the "reduce" variables of the tasks of a 'parallel_foreach'
+    loop are this many bytes apart, so that they're in different cache
+    lines. */
+static const int lParallelReductionAlign = 64;
+
+ParallelReduction::ParallelReduction(Op o, Symbol *s, Expr *f, Expr *i, SourcePos p)
+    : op(o), sym(s), func(f), identity(i), lhs(NULL), rhs(NULL), combine(NULL), pos(p) {
+    lhs = new Symbol("__reduce_lhs", pos, sym->type);
+    rhs = new Symbol("__reduce_rhs", pos, sym->type);
+    Expr *a = new SymbolExpr(lhs, pos);
+    Expr *b = new SymbolExpr(rhs, pos);
+    switch (op) {
+    case Add:
+        combine = new BinaryExpr(BinaryExpr::Add, a, b, pos);
+        break;
+    case Mul:
+        combine = new BinaryExpr(BinaryExpr::Mul, a, b, pos);
+        break;
+    case BitAnd:
+        combine = new BinaryExpr(BinaryExpr::BitAnd, a, b, pos);
+        break;
+    case BitOr:
+        combine = new BinaryExpr(BinaryExpr::BitOr, a, b, pos);
+        break;
+    case BitXor:
+        combine = new BinaryExpr(BinaryExpr::BitXor, a, b, pos);
+        break;
+    case Min:
+    case Max: {
+        Expr *test = new BinaryExpr(op == Min ? BinaryExpr::Lt : BinaryExpr::Gt, a, b, pos);
+        combine = new SelectExpr(test, new SymbolExpr(lhs, pos), new SymbolExpr(rhs, pos), pos);
+        break;
+    }
+    case Function: {
+        ExprList *args = new ExprList(a, pos);
+        args->exprs.push_back(b);
+        combine = new FunctionCallExpr(func, args, pos);
+        break;
+    }
+    }
+}
+
+ParallelReduction *ParallelReduction::Instantiate(TemplateInstantiation &templInst) const {
+    ParallelReduction *inst = new ParallelReduction(*this);
+    inst->sym = templInst.InstantiateSymbol(sym);
+    inst->func = func ? func->Instantiate(templInst) : nullptr;
+    inst->identity = identity ? identity->Instantiate(templInst) : nullptr;
+    inst->lhs = templInst.InstantiateSymbol(lhs);
+    inst->rhs = templInst.InstantiateSymbol(rhs);
+    inst->combine = combine ? combine->Instantiate(templInst) : nullptr;
+    return inst;
+}
+
+template <typename T> static T lIntegerIdentity(ParallelReduction::Op op) {
+    switch (op) {
+    case ParallelReduction::Mul:
+        return 1;
+    case ParallelReduction::BitAnd:
+        return (T)~(T)0;
+    case ParallelReduction::Min:
+        return std::numeric_limits<T>::max();
+    case ParallelReduction::Max:
+        return std::numeric_limits<T>::min();
+    default:
+        return 0;
+    }
+}
+
+static llvm::APFloat lFloatIdentity(ParallelReduction::Op op, const llvm::fltSemantics &semantics) {
+    if (op == ParallelReduction::Min || op == ParallelReduction::Max)
+        return llvm::APFloat::getInf(semantics, op == ParallelReduction::Max);
+    return llvm::APFloat(semantics, op == ParallelReduction::Mul ? 1 : 0);
+}
+
+/** Returns the identity value of the given "reduce" operator for the given
+    type. */
+static Expr *lReductionIdentity(ParallelReduction::Op op, const AtomicType *type, SourcePos pos) {
+    const Type *ct = type->GetAsUniformType()->GetAsConstType();
+    switch (type->basicType) {
+    case AtomicType::TYPE_BOOL:
+        return new ConstExpr(ct, op == ParallelReduction::Mul || op == ParallelReduction::BitAnd ||
+                                     op == ParallelReduction::Min,
+                             pos);
+    case AtomicType::TYPE_INT8:
+        return new ConstExpr(ct, lIntegerIdentity<int8_t>(op), pos);
+    case AtomicType::TYPE_UINT8:
+        return new ConstExpr(ct, lIntegerIdentity<uint8_t>(op), pos);
+    case AtomicType::TYPE_INT16:
+        return new ConstExpr(ct, lIntegerIdentity<int16_t>(op), pos);
+    case AtomicType::TYPE_UINT16:
+        return new ConstExpr(ct, lIntegerIdentity<uint16_t>(op), pos);
+    case AtomicType::TYPE_INT32:
+        return new ConstExpr(ct, lIntegerIdentity<int32_t>(op), pos);
+    case AtomicType::TYPE_UINT32:
+        return new ConstExpr(ct, lIntegerIdentity<uint32_t>(op), pos);
+    case AtomicType::TYPE_INT64:
+        return new ConstExpr(ct, lIntegerIdentity<int64_t>(op), pos);
+    case AtomicType::TYPE_UINT64:
+        return new ConstExpr(ct, lIntegerIdentity<uint64_t>(op), pos);
+    case AtomicType::TYPE_FLOAT16:
+        return new ConstExpr(ct, lFloatIdentity(op, llvm::APFloat::IEEEhalf()), pos);
+    case AtomicType::TYPE_FLOAT:
+        return new ConstExpr(ct, lFloatIdentity(op, llvm::APFloat::IEEEsingle()), pos);
+    case AtomicType::TYPE_DOUBLE:
+        return new ConstExpr(ct, lFloatIdentity(op, llvm::APFloat::IEEEdouble()), pos);
+    default:
+        Error(pos, "\"reduce\" is illegal with type \"%s\".", type->GetString().c_str());
+        return NULL;
+    }
+}
+
+/** Returns the address of the copy of a "reduce" variable for the task
+    with the given index. */
+static AddressInfo *lReductionCopy(FunctionEmitContext *ctx, const ParallelReduction *r, llvm::Value *copies,
+                                   llvm::Value *index, int copySize) {
+    llvm::Value *offset = ctx->BinaryOperator(llvm::Instruction::Mul, index, LLVMInt32(copySize), "copy_offset");
+    llvm::Value *ptr = llvm::GetElementPtrInst::Create(LLVMTypes::Int8Type, copies, offset, "reduce_copy",
+                                                       ctx->GetCurrentBasicBlock());
+    return new AddressInfo(ptr, r->sym->type);
+}
+
+/** Emits code that stores "dst op src" to dst for a "reduce" operator. */
+static void lEmitReductionCombine(FunctionEmitContext *ctx, const ParallelReduction *r, AddressInfo *dst,
+                                  AddressInfo *src) {
+    r->lhs->storageInfo = dst;
+    r->rhs->storageInfo = src;
+    llvm::Value *value = r->combine->GetValue(ctx);
+    if (value != NULL)
+        ctx->StoreInst(value, dst, r->sym->type);
+}
+
+/** Symbols that the body of a 'parallel_foreach' loop uses and the ones
+    declared by the body itself. */
+struct ParallelCaptureInfo {
+    std::vector<Symbol *> used;
+    std::set<Symbol *> declared;
+};
+
+static bool lParallelCapturePre(ASTNode *node, void *d) {
+    ParallelCaptureInfo *info = (ParallelCaptureInfo *)d;
+    if (SymbolExpr *se = llvm::dyn_cast<SymbolExpr>(node)) {
+        Symbol *sym = se->GetBaseSymbol();
+        if (sym != NULL && std::find(info->used.begin(), info->used.end(), sym) == info->used.end())
+            info->used.push_back(sym);
+    } else if (DeclStmt *ds = llvm::dyn_cast<DeclStmt>(node)) {
+        for (const VariableDeclaration &vd : ds->vars)
+            info->declared.insert(vd.sym);
+    } else if (ForeachStmt *fs = llvm::dyn_cast<ForeachStmt>(node)) {
+        info->declared.insert(fs->dimVariables.begin(), fs->dimVariables.end());
+    } else if (ForeachActiveStmt *fas = llvm::dyn_cast<ForeachActiveStmt>(node)) {
+        info->declared.insert(fas->sym);
+    } else if (ForeachUniqueStmt *fus = llvm::dyn_cast<ForeachUniqueStmt>(node)) {
+        info->declared.insert(fus->sym);
+    }
+    return true;
+}
+
+/* Emit code for a 'parallel_foreach' statement.  The loop is outlined into
+   a task function that takes pointers to the variables of the enclosing
+   function that the body uses, the bounds of the iteration domain and the
+   chunk size.  The outermost dimension is split into chunks, one per task,
+   which are a multiple of the vector width for 1D loops so that only the
+   last chunk has extra elements to mask off.  The tasks are launched and
+   synced right away, so the captured variables outlive them.
+
+   For each "reduce" clause, each task gets its own copy of the variable in
+   a separate cache line.  After the sync, the copies are combined pairwise
+   in log2(number of tasks) rounds, and the result is combined with the
+   variable.
+ */
+void ForeachStmt::emitParallelLoops(FunctionEmitContext *ctx) const {
+    if (ctx->GetCurrentBasicBlock() == NULL || stmts == NULL)
+        return;
+
+    ctx->SetDebugPos(pos);
+    // This should be caught during typechecking
+    AssertPos(pos, startExprs.size() == dimVariables.size() && endExprs.size() == dimVariables.size());
+    int nDims = (int)dimVariables.size();
+
+    std::vector<llvm::Value *> startVals, endVals;
+    for (int i = 0; i < nDims; ++i) {
+        llvm::Value *sv = startExprs[i]->GetValue(ctx);
+        llvm::Value *ev = endExprs[i]->GetValue(ctx);
+        if (sv == NULL || ev == NULL)
+            return;
+        startVals.push_back(sv);
+        endVals.push_back(ev);
+    }
+
+    // Find the variables in the enclosing function's stack frame that the
+    // body uses; globals and constants don't need to be passed along.
+    ParallelCaptureInfo info;
+    info.declared.insert(dimVariables.begin(), dimVariables.end());
+    for (auto r : reductions)
+        info.declared.insert(r->sym);
+    WalkAST(stmts, lParallelCapturePre, NULL, &info);
+    std::vector<Symbol *> captured;
+    for (Symbol *sym : info.used)
+        if (info.declared.find(sym) == info.declared.end() && sym->storageInfo != NULL &&
+            !llvm::isa<llvm::Constant>(sym->storageInfo->getPointer()))
+            captured.push_back(sym);
+
+    // The task takes a pointer to each captured variable, a pointer to the
+    // copies of each "reduce" variable, the start and end of each dimension
+    // and the chunk size.
+    llvm::SmallVector<const Type *, 8> argTypes;
+    llvm::SmallVector<std::string, 8> argNames;
+    llvm::SmallVector<Expr *, 8> argDefaults;
+    llvm::SmallVector<SourcePos, 8> argPos;
+    for (Symbol *sym : captured) {
+        argTypes.push_back(PointerType::Void);
+        argNames.push_back(sym->name);
+    }
+    for (auto r : reductions) {
+        argTypes.push_back(PointerType::Void);
+        argNames.push_back("__reduce_" + r->sym->name);
+    }
+    for (int i = 0; i < nDims; ++i) {
+        argTypes.push_back(AtomicType::UniformInt32);
+        argNames.push_back("__start_" + std::to_string(i));
+    }
+    for (int i = 0; i < nDims; ++i) {
+        argTypes.push_back(AtomicType::UniformInt32);
+        argNames.push_back("__end_" + std::to_string(i));
+    }
+    argTypes.push_back(AtomicType::UniformInt32);
+    argNames.push_back("__chunk");
+    argDefaults.resize(argTypes.size(), NULL);
+    argPos.resize(argTypes.size(), pos);
+    const FunctionType *taskType = new FunctionType(AtomicType::Void, argTypes, argNames, argDefaults, argPos,
+                                                    true /* task */, false, false, false, true /* unmasked */,
+                                                    false, false);
+
+    llvm::Function *taskFunc = llvm::Function::Create(taskType->LLVMFunctionType(g->ctx),
+                                                      llvm::GlobalValue::InternalLinkage, "__parallel_foreach",
+                                                      m->module);
+    taskFunc->setDoesNotThrow();
+    taskFunc->addParamAttr(0, llvm::Attribute::NoAlias);
+    taskFunc->setCallingConv(taskType->GetCallingConv());
+    g->target->markFuncWithTargetAttr(taskFunc);
+
+    // Split the outermost dimension into about lParallelForeachTasks chunks.
+    llvm::Value *extent = ctx->BinaryOperator(llvm::Instruction::Sub, endVals[0], startVals[0], "extent");
+    llvm::Value *isEmpty =
+        ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SLT, extent, LLVMInt32(0), "is_empty");
+    extent = ctx->SelectInst(isEmpty, LLVMInt32(0), extent, "extent");
+    llvm::Value *chunk =
+        ctx->BinaryOperator(llvm::Instruction::Add, extent, LLVMInt32(lParallelForeachTasks - 1), "chunk");
+    chunk = ctx->BinaryOperator(llvm::Instruction::SDiv, chunk, LLVMInt32(lParallelForeachTasks), "chunk");
+    int minChunk = 1;
+    if (nDims == 1) {
+        minChunk = g->target->getVectorWidth();
+        chunk = ctx->BinaryOperator(llvm::Instruction::Add, chunk, LLVMInt32(minChunk - 1), "chunk");
+        chunk = ctx->BinaryOperator(llvm::Instruction::SDiv, chunk, LLVMInt32(minChunk), "chunk");
+        chunk = ctx->BinaryOperator(llvm::Instruction::Mul, chunk, LLVMInt32(minChunk), "chunk");
+    }
+    llvm::Value *isSmall =
+        ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SLT, chunk, LLVMInt32(minChunk), "is_small");
+    chunk = ctx->SelectInst(isSmall, LLVMInt32(minChunk), chunk, "chunk");
+    llvm::Value *nTasks = ctx->BinaryOperator(llvm::Instruction::Add, extent, chunk, "n_tasks");
+    nTasks = ctx->BinaryOperator(llvm::Instruction::Sub, nTasks, LLVMInt32(1), "n_tasks");
+    nTasks = ctx->BinaryOperator(llvm::Instruction::SDiv, nTasks, chunk, "n_tasks");
+
+    // Allocate the copies of the "reduce" variables and set them to the
+    // identity of the operator.  There's always at least one, which the
+    // variable is combined with in the end.
+    std::vector<llvm::Value *> reductionCopies;
+    std::vector<int> copySizes;
+    if (!reductions.empty()) {
+        std::vector<llvm::Value *> identities;
+        for (auto r : reductions) {
+            llvm::Value *identity = r->identity->GetValue(ctx);
+            if (identity == NULL)
+                return;
+            identities.push_back(identity);
+
+            uint64_t size = g->target->getDataLayout()->getTypeAllocSize(r->sym->type->LLVMStorageType(g->ctx));
+            size = (size + lParallelReductionAlign - 1) / lParallelReductionAlign * lParallelReductionAlign;
+            llvm::Type *copiesType = llvm::ArrayType::get(LLVMTypes::Int8Type, size * lParallelForeachTasks);
+            reductionCopies.push_back(
+                ctx->AllocaInst(copiesType, "reduce_copies", lParallelReductionAlign)->getPointer());
+            copySizes.push_back((int)size);
+        }
+
+        llvm::Value *noTasks =
+            ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SLT, nTasks, LLVMInt32(1), "no_tasks");
+        llvm::Value *nCopies = ctx->SelectInst(noTasks, LLVMInt32(1), nTasks, "n_copies");
+        AddressInfo *indexPtr = ctx->AllocaInst(LLVMTypes::Int32Type, "copy_index");
+        ctx->StoreInst(LLVMInt32(0), indexPtr);
+        llvm::BasicBlock *bbInitTest = ctx->CreateBasicBlock("reduce_init_test");
+        llvm::BasicBlock *bbInit = ctx->CreateBasicBlock("reduce_init");
+        llvm::BasicBlock *bbInitDone = ctx->CreateBasicBlock("reduce_init_done");
+        ctx->BranchInst(bbInitTest);
+
+        ctx->SetCurrentBasicBlock(bbInitTest);
+        llvm::Value *index = ctx->LoadInst(indexPtr);
+        llvm::Value *haveCopy =
+            ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SLT, index, nCopies, "have_copy");
+        ctx->BranchInst(bbInit, bbInitDone, haveCopy);
+
+        ctx->SetCurrentBasicBlock(bbInit);
+        for (int i = 0; i < (int)reductions.size(); ++i)
+            ctx->StoreInst(identities[i], lReductionCopy(ctx, reductions[i], reductionCopies[i], index, copySizes[i]),
+                           reductions[i]->sym->type);
+        ctx->StoreInst(ctx->BinaryOperator(llvm::Instruction::Add, index, LLVMInt32(1), "copy_index"), indexPtr);
+        ctx->BranchInst(bbInitTest);
+
+        ctx->SetCurrentBasicBlock(bbInitDone);
+    }
+
+    std::vector<llvm::Value *> argVals;
+    for (Symbol *sym : captured)
+        argVals.push_back(ctx->BitCastInst(sym->storageInfo->getPointer(), LLVMTypes::VoidPointerType));
+    for (llvm::Value *copies : reductionCopies)
+        argVals.push_back(ctx->BitCastInst(copies, LLVMTypes::VoidPointerType));
+    argVals.insert(argVals.end(), startVals.begin(), startVals.end());
+    argVals.insert(argVals.end(), endVals.begin(), endVals.end());
+    argVals.push_back(chunk);
+
+    {
+        // Emit the body of the task.  The captured variables are accessed
+        // through the pointers in the argument structure while it's
+        // emitted, the "reduce" variables through the task's copies, and
+        // they get their storage in this function back after.
+        Symbol *taskSym = new Symbol("__parallel_foreach", pos, taskType, SC_STATIC);
+        taskSym->function = taskFunc;
+        std::vector<Symbol *> taskArgs;
+        Function *taskFunction = new Function(taskSym, NULL, NULL, taskArgs);
+        FunctionEmitContext tctx(taskFunction, taskSym, taskFunc, pos);
+        tctx.SetFunctionMask(LLVMMaskAllOn);
+        tctx.SetDebugPos(pos);
+
+        // The task function's parameters are the pointer to the argument
+        // structure, threadIndex, threadCount and taskIndex, followed by
+        // the rest of the task variables.
+        llvm::Value *structParamPtr = taskFunc->getArg(0);
+        llvm::Value *taskIndex = taskFunc->getArg(3);
+        AddressInfo *stInfo =
+            new AddressInfo(structParamPtr, llvm::StructType::get(*g->ctx, taskType->LLVMFunctionArgTypes(g->ctx)));
+
+        std::vector<AddressInfo *> savedStorage;
+        std::vector<int> savedDepth;
+        for (int i = 0; i < (int)captured.size(); ++i) {
+            Symbol *sym = captured[i];
+            llvm::Value *ptr = tctx.AddElementOffset(stInfo, i, sym->name.c_str());
+            ptr = tctx.LoadInst(new AddressInfo(ptr, LLVMTypes::VoidPointerType), NULL, sym->name.c_str());
+            ptr = tctx.BitCastInst(ptr, sym->storageInfo->getType());
+            savedStorage.push_back(sym->storageInfo);
+            savedDepth.push_back(sym->varyingCFDepth);
+            sym->storageInfo = sym->storageInfo->getISPCType() != NULL
+                                   ? new AddressInfo(ptr, sym->storageInfo->getISPCType())
+                                   : new AddressInfo(ptr, sym->storageInfo->getElementType());
+            sym->varyingCFDepth = 0;
+        }
 
+        int nCaptured = (int)captured.size();
+        for (int i = 0; i < (int)reductions.size(); ++i) {
+            Symbol *sym = reductions[i]->sym;
+            llvm::Value *ptr = tctx.AddElementOffset(stInfo, nCaptured + i, "reduce_copies");
+            ptr = tctx.LoadInst(new AddressInfo(ptr, LLVMTypes::VoidPointerType), NULL, "reduce_copies");
+            savedStorage.push_back(sym->storageInfo);
+            savedDepth.push_back(sym->varyingCFDepth);
+            sym->storageInfo = lReductionCopy(&tctx, reductions[i], ptr, taskIndex, copySizes[i]);
+            sym->varyingCFDepth = 0;
+        }
+
+        int nArgs = nCaptured + (int)reductions.size();
+        std::vector<llvm::Value *> taskStarts, taskEnds;
+        for (int i = 0; i < 2 * nDims + 1; ++i) {
+            llvm::Value *ptr = tctx.AddElementOffset(stInfo, nArgs + i, "bound");
+            llvm::Value *val = tctx.LoadInst(new AddressInfo(ptr, LLVMTypes::Int32Type), NULL, "bound");
+            if (i < nDims)
+                taskStarts.push_back(val);
+            else if (i < 2 * nDims)
+                taskEnds.push_back(val);
+            else
+                chunk = val;
+        }
+
+        // This task runs [start + taskIndex * chunk, start + (taskIndex + 1) * chunk)
+        // of the outermost dimension, clamped to its end.
+        llvm::Value *chunkStart = tctx.BinaryOperator(llvm::Instruction::Mul, taskIndex, chunk, "chunk_start");
+        chunkStart = tctx.BinaryOperator(llvm::Instruction::Add, taskStarts[0], chunkStart, "chunk_start");
+        llvm::Value *chunkEnd = tctx.BinaryOperator(llvm::Instruction::Add, chunkStart, chunk, "chunk_end");
+        llvm::Value *pastEnd =
+            tctx.CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SGT, chunkEnd, taskEnds[0], "past_end");
+        taskStarts[0] = chunkStart;
+        taskEnds[0] = tctx.SelectInst(pastEnd, taskEnds[0], chunkEnd, "chunk_end");
+
+        tctx.InitializeLabelMap(stmts);
+        emitLoops(&tctx, taskStarts, taskEnds);
+        if (tctx.GetCurrentBasicBlock())
+            tctx.ReturnInst();
+
+        for (int i = 0; i < (int)captured.size(); ++i) {
+            captured[i]->storageInfo = savedStorage[i];
+            captured[i]->varyingCFDepth = savedDepth[i];
+        }
+        for (int i = 0; i < (int)reductions.size(); ++i) {
+            reductions[i]->sym->storageInfo = savedStorage[nCaptured + i];
+            reductions[i]->sym->varyingCFDepth = savedDepth[nCaptured + i];
+        }
+    }
+
+    llvm::Value *launchCount[3] = {nTasks, LLVMInt32(1), LLVMInt32(1)};
+    ctx->LaunchInst(taskFunc, argVals, launchCount, taskType);
+    ctx->SyncInst();
+
+    if (reductions.empty())
+        return;
+
+    // Combine the copies of the "reduce" variables pairwise: in the round
+    // with a given stride, copy i gets copy i + stride combined into it,
+    // for each i that is a multiple of twice the stride.
+    AddressInfo *stridePtr = ctx->AllocaInst(LLVMTypes::Int32Type, "reduce_stride");
+    AddressInfo *indexPtr = ctx->AllocaInst(LLVMTypes::Int32Type, "reduce_index");
+    llvm::BasicBlock *bbRoundTest = ctx->CreateBasicBlock("reduce_round_test");
+    llvm::BasicBlock *bbRound = ctx->CreateBasicBlock("reduce_round");
+    llvm::BasicBlock *bbCombineTest = ctx->CreateBasicBlock("reduce_combine_test");
+    llvm::BasicBlock *bbCombine = ctx->CreateBasicBlock("reduce_combine");
+    llvm::BasicBlock *bbRoundStep = ctx->CreateBasicBlock("reduce_round_step");
+    llvm::BasicBlock *bbDone = ctx->CreateBasicBlock("reduce_done");
+    ctx->StoreInst(LLVMInt32(1), stridePtr);
+    ctx->BranchInst(bbRoundTest);
+
+    // reduce_round_test: is there another round?
+    ctx->SetCurrentBasicBlock(bbRoundTest);
+    llvm::Value *stride = ctx->LoadInst(stridePtr);
+    llvm::Value *haveRound =
+        ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SLT, stride, nTasks, "have_round");
+    ctx->BranchInst(bbRound, bbDone, haveRound);
+
+    // reduce_round: start the round with copy 0
+    ctx->SetCurrentBasicBlock(bbRound);
+    ctx->StoreInst(LLVMInt32(0), indexPtr);
+    ctx->BranchInst(bbCombineTest);
+
+    // reduce_combine_test: does copy i have a copy to combine with?
+    ctx->SetCurrentBasicBlock(bbCombineTest);
+    llvm::Value *index = ctx->LoadInst(indexPtr);
+    stride = ctx->LoadInst(stridePtr);
+    llvm::Value *other = ctx->BinaryOperator(llvm::Instruction::Add, index, stride, "reduce_other");
+    llvm::Value *haveOther =
+        ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SLT, other, nTasks, "have_other");
+    ctx->BranchInst(bbCombine, bbRoundStep, haveOther);
+
+    // reduce_combine: combine copy i + stride into copy i
+    ctx->SetCurrentBasicBlock(bbCombine);
+    for (int i = 0; i < (int)reductions.size(); ++i)
+        lEmitReductionCombine(ctx, reductions[i],
+                              lReductionCopy(ctx, reductions[i], reductionCopies[i], index, copySizes[i]),
+                              lReductionCopy(ctx, reductions[i], reductionCopies[i], other, copySizes[i]));
+    llvm::Value *nextIndex = ctx->BinaryOperator(llvm::Instruction::Add, other, stride, "reduce_index");
+    ctx->StoreInst(nextIndex, indexPtr);
+    ctx->BranchInst(bbCombineTest);
+
+    // reduce_round_step: double the stride
+    ctx->SetCurrentBasicBlock(bbRoundStep);
+    llvm::Value *nextStride = ctx->BinaryOperator(llvm::Instruction::Shl, stride, LLVMInt32(1), "reduce_stride");
+    ctx->StoreInst(nextStride, stridePtr);
+    ctx->BranchInst(bbRoundTest);
+
+    // reduce_done: combine copy 0 into the variables
+    ctx->SetCurrentBasicBlock(bbDone);
+    for (int i = 0; i < (int)reductions.size(); ++i)
+        lEmitReductionCombine(ctx, reductions[i], reductions[i]->sym->storageInfo,
+                              lReductionCopy(ctx, reductions[i], reductionCopies[i], LLVMInt32(0), copySizes[i]));
+}
+
+/** Splits the body of a 'foreach_dynamic' loop into the statements before
+    its top-level "for"/"while" loop, that loop, and the statements after
+    it.  Returns NULL if the body doesn't have exactly one such loop. */
+static ForStmt *lSplitDynamicBody(Stmt *body, std::vector<Stmt *> *prologue, std::vector<Stmt *> *epilogue) {
+    std::vector<Stmt *> all;
+    if (StmtList *sl = llvm::dyn_cast_or_null<StmtList>(body))
+        all = sl->stmts;
+    else if (body != NULL)
+        all.push_back(body);
+
+    ForStmt *loop = NULL;
+    for (Stmt *s : all) {
+        ForStmt *fs = llvm::dyn_cast_or_null<ForStmt>(s);
+        if (fs != NULL) {
+            if (loop != NULL)
+                return NULL;
+            loop = fs;
+        } else if (s != NULL)
+            (loop == NULL ? prologue : epilogue)->push_back(s);
+    }
+    return loop;
+}
+
+/** Returns the variables declared by the given top-level statements. */
+static std::vector<Symbol *> lDynamicDeclaredSymbols(const std::vector<Stmt *> &stmts) {
+    std::vector<Symbol *> syms;
+    for (Stmt *s : stmts) {
+        DeclStmt *ds = llvm::dyn_cast_or_null<DeclStmt>(s);
+        if (ds == NULL)
+            continue;
+        for (const VariableDeclaration &vd : ds->vars)
+            if (vd.sym != NULL && vd.sym->type != NULL && vd.sym->storageClass != SC_STATIC &&
+                vd.sym->storageClass != SC_SHARED)
+                syms.push_back(vd.sym);
+    }
+    return syms;
+}
+
+struct DynamicBCCheckInfo {
+    int switchDepth = 0;
+    bool foundError = false;
+};
+
+static bool lDynamicBCPreFunc(ASTNode *node, void *d) {
+    DynamicBCCheckInfo *info = (DynamicBCCheckInfo *)d;
+    if (llvm::isa<ContinueStmt>(node) || (llvm::isa<BreakStmt>(node) && info->switchDepth == 0)) {
+        Error(node->pos, "\"%s\" statement is illegal in \"foreach_dynamic\" outside of its inner loop.",
+              llvm::isa<ContinueStmt>(node) ? "continue" : "break");
+        info->foundError = true;
+        return false;
+    }
+    if (llvm::isa<SwitchStmt>(node))
+        ++info->switchDepth;
+
+    // 'break' and 'continue' in nested loops apply to those loops.
+    return !(llvm::isa<ForStmt>(node) || llvm::isa<DoStmt>(node) || llvm::isa<ForeachStmt>(node) ||
+             llvm::isa<ForeachActiveStmt>(node) || llvm::isa<ForeachUniqueStmt>(node));
+}
+
+static ASTNode *lDynamicBCPostFunc(ASTNode *node, void *d) {
+    if (llvm::isa<SwitchStmt>(node))
+        --((DynamicBCCheckInfo *)d)->switchDepth;
+    return node;
+}
+
+/** Issues an error for each 'break' or 'continue' in the given statement
+    of a 'foreach_dynamic' body outside of its top-level loop, which has
+    no loop for it to apply to.  Returns false if there were any. */
+static bool lCheckDynamicBreakContinue(Stmt *stmt) {
+    DynamicBCCheckInfo info;
+    WalkAST(stmt, lDynamicBCPreFunc, lDynamicBCPostFunc, &info);
+    return !info.foundError;
+}
+
+/* Emit code for a 'foreach_dynamic' loop.  Each program instance is given
+   an element of the range and runs the prologue of the body, the body's
+   top-level loop and then its epilogue for that element.  Rather than
+   waiting for all of the gang's loops to finish, the instances whose loop
+   has ended run the epilogue and are handed the next elements of the
+   range, so that the loop keeps running with as many active instances as
+   possible.  The new elements are handed out in program index order by
+   counting the instances below each one that need work, the same way
+   packed_store_active() compacts the active lanes.
+
+   The prologue's declarations store to all of the lanes, so they are made
+   to fresh storage that is then merged, under the mask of the started
+   instances, into the variables' storage for the rest of the body.
+
+   With '#pragma interleave(k)', there are k groups of program instances,
+   each with its own elements, masks and copies of the variables declared
+   before the loop, and one iteration of each group's loop is run in turn.
+   The iterations of the different groups don't depend on each other, so
+   the loads of one group can be in flight while the others run.
+ */
+void ForeachStmt::emitDynamicLoop(FunctionEmitContext *ctx) const {
+    std::vector<Stmt *> prologue, epilogue;
+    ForStmt *loop = lSplitDynamicBody(stmts, &prologue, &epilogue);
+    if (loop == NULL || ctx->emitXeHardwareMask()) {
+        // Checked with a warning during typechecking.
+        emitLoops(ctx, std::vector<llvm::Value *>(), std::vector<llvm::Value *>());
+        return;
+    }
+    if (ctx->GetCurrentBasicBlock() == NULL)
+        return;
+
+    std::vector<Stmt *> startStmts = prologue;
+    if (loop->init != NULL)
+        startStmts.push_back(loop->init);
+
+    const int nGroups = std::max(interleave, 1);
+    std::vector<llvm::BasicBlock *> bbRefill, bbAssign, bbTest, bbEvalTest, bbRetire, bbCheckRunning, bbLoop,
+        bbContinue, bbBreak, bbIdle;
+    for (int grp = 0; grp < nGroups; ++grp) {
+        bbRefill.push_back(ctx->CreateBasicBlock("foreach_dynamic_refill"));
+        bbAssign.push_back(ctx->CreateBasicBlock("foreach_dynamic_assign"));
+        bbTest.push_back(ctx->CreateBasicBlock("foreach_dynamic_test"));
+        bbEvalTest.push_back(ctx->CreateBasicBlock("foreach_dynamic_eval_test"));
+        bbRetire.push_back(ctx->CreateBasicBlock("foreach_dynamic_retire"));
+        bbCheckRunning.push_back(ctx->CreateBasicBlock("foreach_dynamic_check_running"));
+        bbLoop.push_back(ctx->CreateBasicBlock("foreach_dynamic_loop"));
+        bbContinue.push_back(ctx->CreateBasicBlock("foreach_dynamic_continue"));
+        bbBreak.push_back(ctx->CreateBasicBlock("foreach_dynamic_break"));
+        if (nGroups > 1)
+            bbIdle.push_back(ctx->CreateBasicBlock("foreach_dynamic_idle"));
+    }
+    llvm::BasicBlock *bbExit = ctx->CreateBasicBlock("foreach_dynamic_exit");
+
+    llvm::Value *oldMask = ctx->GetInternalMask();
+    llvm::Value *oldFunctionMask = ctx->GetFunctionMask();
+
+    ctx->SetDebugPos(pos);
+    ctx->StartScope();
+
+    ctx->SetInternalMask(LLVMMaskAllOn);
+    ctx->SetFunctionMask(LLVMMaskAllOn);
+
+    // This should be caught during typechecking
+    AssertPos(pos, dimVariables.size() == 1 && startExprs.size() == 1 && endExprs.size() == 1);
+    llvm::Value *sv = startExprs[0]->GetValue(ctx);
+    llvm::Value *ev = endExprs[0]->GetValue(ctx);
+    if (sv == NULL || ev == NULL)
+        return;
+
+    Symbol *indexVar = dimVariables[0];
+    std::vector<AddressInfo *> indexStorage;
+    for (int grp = 0; grp < nGroups; ++grp)
+        indexStorage.push_back(ctx->AllocaInst(LLVMTypes::Int32VectorType, indexVar->name.c_str()));
+    indexVar->storageInfo = indexStorage[0];
+    indexVar->parentFunction = ctx->GetFunction();
+    ctx->EmitVariableDebugInfo(indexVar);
+
+    // The next element of the range to hand out and, for each group, the
+    // instances that are running the loop, the ones that need a new
+    // element and the ones that left the loop through a 'break' and still
+    // have to run the epilogue.
+    AddressInfo *nextPtr = ctx->AllocaInst(LLVMTypes::Int32Type, "next_index");
+    ctx->StoreInst(sv, nextPtr);
+    std::vector<AddressInfo *> activePtr, needPtr, retirePtr;
+    for (int grp = 0; grp < nGroups; ++grp) {
+        activePtr.push_back(ctx->AllocaInst(LLVMTypes::MaskType, "active_lanes"));
+        ctx->StoreInst(LLVMMaskAllOff, activePtr[grp]);
+        needPtr.push_back(ctx->AllocaInst(LLVMTypes::MaskType, "need_lanes"));
+        ctx->StoreInst(LLVMMaskAllOn, needPtr[grp]);
+        retirePtr.push_back(ctx->AllocaInst(LLVMTypes::MaskType, "retire_lanes"));
+        ctx->StoreInst(LLVMMaskAllOff, retirePtr[grp]);
+    }
+
+    // Storage that persists across refills for the variables declared
+    // before the loop.
+    std::vector<Symbol *> startSyms = lDynamicDeclaredSymbols(startStmts);
+    std::vector<std::vector<AddressInfo *>> startStorage(nGroups);
+    for (int grp = 0; grp < nGroups; ++grp)
+        for (Symbol *sym : startSyms)
+            startStorage[grp].push_back(ctx->AllocaInst(sym->type, sym->name.c_str()));
+
+    ctx->StartForeach(FunctionEmitContext::FOREACH_REGULAR);
+    bool oldNontemporalStores = ctx->GetNontemporalStores();
+    if (isNontemporal)
+        ctx->SetNontemporalStores(true);
+    ctx->BranchInst(bbRefill[0]);
+
+    for (int grp = 0; grp < nGroups; ++grp) {
+        // Each group hands over to the next one after an iteration of its
+        // loop.
+        llvm::BasicBlock *bbNext = bbRefill[(grp + 1) % nGroups];
+        indexVar->storageInfo = indexStorage[grp];
+
+        ///////////////////////////////////////////////////////////////////////
+        // foreach_dynamic_refill: hand out new elements if there are
+        // instances that need them and the range isn't exhausted yet.
+        ctx->SetCurrentBasicBlock(bbRefill[grp]);
+        {
+            llvm::Value *need = ctx->LoadInst(needPtr[grp], NULL, "need");
+            llvm::Value *next = ctx->LoadInst(nextPtr, NULL, "next");
+            llvm::Value *moreItems =
+                ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SLT, next, ev, "more_items");
+            llvm::Value *doAssign = ctx->BinaryOperator(llvm::Instruction::And, ctx->Any(need), moreItems, "do_assign");
+            ctx->BranchInst(bbAssign[grp], bbTest[grp], doAssign);
+        }
+
+        ///////////////////////////////////////////////////////////////////////
+        // foreach_dynamic_assign: each instance that needs an element gets
+        // next + (the number of instances below it that need one), then the
+        // started instances run the code before the loop.
+        ctx->SetCurrentBasicBlock(bbAssign[grp]);
+        {
+            llvm::Value *need = ctx->LoadInst(needPtr[grp], NULL, "need");
+            llvm::Value *next = ctx->LoadInst(nextPtr, NULL, "next");
+            llvm::Value *needBits = ctx->LaneMask(need);
+
+            llvm::Function *ctpop64 =
+                llvm::Intrinsic::getDeclaration(m->module, llvm::Intrinsic::ctpop, LLVMTypes::Int64Type);
+            llvm::Function *ctpopVec =
+                llvm::Intrinsic::getDeclaration(m->module, llvm::Intrinsic::ctpop, LLVMTypes::Int64VectorType);
+
+            // below = (1 << programIndex) - 1
+            llvm::Value *bit = ctx->BinaryOperator(llvm::Instruction::Shl, LLVMInt64Vector((int64_t)1),
+                                                   ctx->ProgramIndexVector(false), "lane_bit");
+            llvm::Value *below =
+                ctx->BinaryOperator(llvm::Instruction::Sub, bit, LLVMInt64Vector((int64_t)1), "below");
+            llvm::Value *needBelow = ctx->BinaryOperator(
+                llvm::Instruction::And, ctx->BroadcastValue(needBits, LLVMTypes::Int64VectorType, "need_bits"), below,
+                "need_below");
+            llvm::Value *prefix = ctx->CallInst(ctpopVec, NULL, needBelow, "prefix");
+            prefix = ctx->TruncInst(prefix, LLVMTypes::Int32VectorType, "prefix32");
+
+            llvm::Value *newIndex = ctx->BinaryOperator(
+                llvm::Instruction::Add, ctx->BroadcastValue(next, LLVMTypes::Int32VectorType, "smear_next"), prefix,
+                "new_index");
+            llvm::Value *needI1 = ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_NE, need, LLVMMaskAllOff,
+                                               "need_i1");
+            llvm::Value *oldIndex = ctx->LoadInst(indexVar->storageInfo, NULL, "old_index");
+            ctx->StoreInst(ctx->SelectInst(needI1, newIndex, oldIndex, "index"), indexVar->storageInfo);
+
+            // next = min(next + popcount(need), end)
+            llvm::Value *nNeed = ctx->CallInst(ctpop64, NULL, needBits, "n_need");
+            nNeed = ctx->TruncInst(nNeed, LLVMTypes::Int32Type, "n_need32");
+            llvm::Value *newNext = ctx->BinaryOperator(llvm::Instruction::Add, next, nNeed, "new_next");
+            llvm::Value *pastEnd =
+                ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SGT, newNext, ev, "past_end");
+            ctx->StoreInst(ctx->SelectInst(pastEnd, ev, newNext, "clamped_next"), nextPtr);
+
+            // The instances that got an element inside the range start
+            // running; the rest stay idle until the loop is done.
+            llvm::Value *inRange = ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SLT, newIndex,
+                                                ctx->BroadcastValue(ev, LLVMTypes::Int32VectorType, "smear_end"),
+                                                "in_range");
+            llvm::Value *started =
+                ctx->BinaryOperator(llvm::Instruction::And, need, ctx->I1VecToBoolVec(inRange), "started");
+            ctx->StoreInst(LLVMMaskAllOff, needPtr[grp]);
+
+            ctx->SetInternalMask(started);
+            ctx->SetBlockEntryMask(started);
+            ctx->AddInstrumentationPoint("foreach_dynamic refill");
+            for (Stmt *s : startStmts)
+                s->EmitCode(ctx);
+            if (ctx->GetCurrentBasicBlock() == NULL)
+                ctx->SetCurrentBasicBlock(ctx->CreateBasicBlock("foreach_dynamic_assign_done"));
+
+            for (unsigned int i = 0; i < startSyms.size(); ++i) {
+                Symbol *sym = startSyms[i];
+                if (sym->storageInfo != NULL)
+                    ctx->StoreInst(ctx->LoadInst(sym->storageInfo, sym->type, sym->name.c_str()),
+                                   startStorage[grp][i]->getPointer(), started, sym->type,
+                                   PointerType::GetUniform(sym->type));
+                sym->storageInfo = startStorage[grp][i];
+            }
+
+            llvm::Value *active = ctx->LoadInst(activePtr[grp], NULL, "active");
+            ctx->StoreInst(ctx->BinaryOperator(llvm::Instruction::Or, active, started, "active|started"),
+                           activePtr[grp]);
+            ctx->BranchInst(bbTest[grp]);
+        }
+
+        ///////////////////////////////////////////////////////////////////////
+        // foreach_dynamic_test: the group is done once none of its
+        // instances is running the loop or still has to run the epilogue.
+        ctx->SetCurrentBasicBlock(bbTest[grp]);
+        {
+            llvm::Value *active = ctx->LoadInst(activePtr[grp], NULL, "active");
+            llvm::Value *retire = ctx->LoadInst(retirePtr[grp], NULL, "retire");
+            llvm::Value *pending = ctx->BinaryOperator(llvm::Instruction::Or, active, retire, "pending");
+            ctx->BranchInst(bbEvalTest[grp], nGroups > 1 ? bbIdle[grp] : bbExit, ctx->Any(pending));
+        }
+
+        ///////////////////////////////////////////////////////////////////////
+        // foreach_dynamic_idle: the range has run out for this group, so
+        // we're done once none of the other groups has work left either.
+        if (nGroups > 1) {
+            ctx->SetCurrentBasicBlock(bbIdle[grp]);
+            llvm::Value *pending = LLVMMaskAllOff;
+            for (int other = 0; other < nGroups; ++other) {
+                if (other == grp)
+                    continue;
+                pending = ctx->BinaryOperator(llvm::Instruction::Or, pending,
+                                              ctx->LoadInst(activePtr[other], NULL, "active"), "pending");
+                pending = ctx->BinaryOperator(llvm::Instruction::Or, pending,
+                                              ctx->LoadInst(retirePtr[other], NULL, "retire"), "pending");
+            }
+            ctx->BranchInst(bbNext, bbExit, ctx->Any(pending));
+        }
+
+        ///////////////////////////////////////////////////////////////////////
+        // foreach_dynamic_eval_test: evaluate the loop test for the running
+        // instances; the ones where it's false leave the loop.
+        ctx->SetCurrentBasicBlock(bbEvalTest[grp]);
+        llvm::Value *running = NULL, *retiring = NULL;
+        {
+            llvm::Value *active = ctx->LoadInst(activePtr[grp], NULL, "active");
+            llvm::Value *retire = ctx->LoadInst(retirePtr[grp], NULL, "retire");
+            ctx->SetInternalMask(active);
+            llvm::Value *ltest = LLVMMaskAllOn;
+            if (loop->test != NULL) {
+                ltest = loop->test->GetValue(ctx);
+                if (ltest == NULL) {
+                    AssertPos(pos, m->errorCount > 0);
+                    ltest = LLVMMaskAllOff;
+                } else if (loop->test->GetType()->IsUniformType())
+                    ltest = ctx->SelectInst(ltest, LLVMMaskAllOn, LLVMMaskAllOff, "uniform_test");
+            }
+            running = ctx->BinaryOperator(llvm::Instruction::And, active, ltest, "running");
+            llvm::Value *ended =
+                ctx->BinaryOperator(llvm::Instruction::And, active, ctx->NotOperator(ltest, "!test"), "ended");
+            retiring = ctx->BinaryOperator(llvm::Instruction::Or, ended, retire, "retiring");
+            ctx->StoreInst(LLVMMaskAllOff, retirePtr[grp]);
+            ctx->StoreInst(running, activePtr[grp]);
+            ctx->StoreInst(retiring, needPtr[grp]);
+            ctx->BranchInst(bbRetire[grp], bbCheckRunning[grp], ctx->Any(retiring));
+        }
+
+        ///////////////////////////////////////////////////////////////////////
+        // foreach_dynamic_retire: the instances that left the loop run the
+        // code after it; they get new elements on the next refill.
+        ctx->SetCurrentBasicBlock(bbRetire[grp]);
+        {
+            ctx->SetInternalMask(retiring);
+            ctx->SetBlockEntryMask(retiring);
+            for (Stmt *s : epilogue)
+                s->EmitCode(ctx);
+            if (ctx->GetCurrentBasicBlock() != NULL)
+                ctx->BranchInst(bbCheckRunning[grp]);
+        }
+
+        ctx->SetCurrentBasicBlock(bbCheckRunning[grp]);
+        ctx->BranchInst(bbLoop[grp], bbNext, ctx->Any(running));
+
+        ///////////////////////////////////////////////////////////////////////
+        // foreach_dynamic_loop: one iteration of the loop body for the
+        // running instances.
+        ctx->SetCurrentBasicBlock(bbLoop[grp]);
+        {
+            ctx->SetInternalMask(running);
+            ctx->StartLoop(bbBreak[grp], bbContinue[grp], false);
+            ctx->SetBlockEntryMask(running);
+            ctx->AddInstrumentationPoint("foreach_dynamic loop body");
+            if (loop->stmts != NULL)
+                loop->stmts->EmitCode(ctx);
+            if (ctx->GetCurrentBasicBlock() != NULL)
+                ctx->BranchInst(bbContinue[grp]);
+        }
+
+        ///////////////////////////////////////////////////////////////////////
+        // foreach_dynamic_continue: bring back the instances that executed
+        // a 'continue' and run the loop step; the ones that executed a
+        // 'break' have to run the epilogue.
+        ctx->SetCurrentBasicBlock(bbContinue[grp]);
+        {
+            ctx->RestoreContinuedLanes();
+            ctx->ClearBreakLanes();
+            if (loop->step != NULL)
+                loop->step->EmitCode(ctx);
+            llvm::Value *stillRunning = ctx->GetInternalMask();
+            llvm::Value *broken = ctx->BinaryOperator(llvm::Instruction::And, running,
+                                                      ctx->NotOperator(stillRunning, "!still_running"), "broken");
+            llvm::Value *retire = ctx->LoadInst(retirePtr[grp], NULL, "retire");
+            ctx->StoreInst(ctx->BinaryOperator(llvm::Instruction::Or, retire, broken, "retire|broken"),
+                           retirePtr[grp]);
+            ctx->StoreInst(stillRunning, activePtr[grp]);
+            ctx->EndLoop();
+            ctx->BranchInst(bbNext);
+        }
+
+        ///////////////////////////////////////////////////////////////////////
+        // foreach_dynamic_break: all of the running instances executed a
+        // 'break'.
+        ctx->SetCurrentBasicBlock(bbBreak[grp]);
+        {
+            llvm::Value *retire = ctx->LoadInst(retirePtr[grp], NULL, "retire");
+            ctx->StoreInst(ctx->BinaryOperator(llvm::Instruction::Or, retire, running, "retire|running"),
+                           retirePtr[grp]);
+            ctx->StoreInst(LLVMMaskAllOff, activePtr[grp]);
+            ctx->BranchInst(bbNext);
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // foreach_dynamic_exit: All done.  Restore the old mask and clean up
+    ctx->SetCurrentBasicBlock(bbExit);
+
+    ctx->SetNontemporalStores(oldNontemporalStores);
+    if (isNontemporal)
+        ctx->NontemporalStoreFence();
+
+    ctx->SetInternalMask(oldMask);
+    ctx->SetFunctionMask(oldFunctionMask);
+
+    ctx->EndForeach();
+    ctx->EndScope();
+}
+
+void ForeachStmt::emitLoops(FunctionEmitContext *ctx, const std::vector<llvm::Value *> &starts,
+                            const std::vector<llvm::Value *> &ends) const {
 #ifdef ISPC_XE_ENABLED
     if (ctx->emitXeHardwareMask()) {
-        EmitCodeForXe(ctx);
+        EmitCodeForXe(ctx, starts, ends);
         return;
     }
 #endif
@@ -1444,8 +2493,8 @@ void ForeachStmt::EmitCode(FunctionEmitContext *ctx) const {
         bbTest.push_back(ctx->CreateBasicBlock("foreach_test"));
 
         // Start and end value for this loop dimension
-        llvm::Value *sv = startExprs[i]->GetValue(ctx);
-        llvm::Value *ev = endExprs[i]->GetValue(ctx);
+        llvm::Value *sv = starts.empty() ? startExprs[i]->GetValue(ctx) : starts[i];
+        llvm::Value *ev = ends.empty() ? endExprs[i]->GetValue(ctx) : ends[i];
         if (sv == NULL || ev == NULL)
             return;
         startVals.push_back(sv);
@@ -1487,6 +2536,9 @@ void ForeachStmt::EmitCode(FunctionEmitContext *ctx) const {
     }
 
     ctx->StartForeach(FunctionEmitContext::FOREACH_REGULAR);
+    bool oldNontemporalStores = ctx->GetNontemporalStores();
+    if (isNontemporal)
+        ctx->SetNontemporalStores(true);
 
     // On to the outermost loop's test
     llvm::Instruction *bbBIOuter = ctx->BranchInst(bbTest[0]);
@@ -1825,6 +2877,12 @@ void ForeachStmt::EmitCode(FunctionEmitContext *ctx) const {
     // foreach_exit: All done.  Restore the old mask and clean up
     ctx->SetCurrentBasicBlock(bbExit);
 
+    // Non-temporal stores are weakly ordered; make them visible before
+    // anything that follows the loop.
+    ctx->SetNontemporalStores(oldNontemporalStores);
+    if (isNontemporal)
+        ctx->NontemporalStoreFence();
+
     ctx->SetInternalMask(oldMask);
     ctx->SetFunctionMask(oldFunctionMask);
 
@@ -1840,8 +2898,15 @@ void ForeachStmt::EmitCode(FunctionEmitContext *ctx) const {
    to process. Handler logic is different from the other targets due to
    Xe Execution Mask usage. We do not need to generate different bodies
    for full and partial masks due to it.
+
+   However, when the extent of each dimension is a multiple of the number of
+   program instances that step through it, all of them pass or fail the loop
+   tests together.  This is checked before running the loops, and then a
+   second copy of them is run, with uniform tests that don't touch the
+   execution mask at all.
 */
-void ForeachStmt::EmitCodeForXe(FunctionEmitContext *ctx) const {
+void ForeachStmt::EmitCodeForXe(FunctionEmitContext *ctx, const std::vector<llvm::Value *> &starts,
+                                const std::vector<llvm::Value *> &ends) const {
     AssertPos(pos, g->target->isXeTarget());
 
     if (ctx->GetCurrentBasicBlock() == NULL || stmts == NULL)
@@ -1862,8 +2927,9 @@ void ForeachStmt::EmitCodeForXe(FunctionEmitContext *ctx) const {
                      " it is not called under varying CF or use \"--opt=enable-xe-foreach-varying\" to enable its "
                      "experimental support.");
     }
-    llvm::BasicBlock *bbBody = ctx->CreateBasicBlock("foreach_body", ctx->GetCurrentBasicBlock());
-    llvm::BasicBlock *bbExit = ctx->CreateBasicBlock("foreach_exit", bbBody);
+    llvm::BasicBlock *bbFull = ctx->CreateBasicBlock("foreach_full", ctx->GetCurrentBasicBlock());
+    llvm::BasicBlock *bbPartial = ctx->CreateBasicBlock("foreach_partial", bbFull);
+    llvm::BasicBlock *bbExit = ctx->CreateBasicBlock("foreach_exit", bbPartial);
 
     ctx->SetDebugPos(pos);
     ctx->StartScope();
@@ -1875,23 +2941,24 @@ void ForeachStmt::EmitCodeForXe(FunctionEmitContext *ctx) const {
     ///////////////////////////////////////////////////////////////////////
     // Setup: compute the number of items we have to work on in each
     // dimension and a number of derived values.
-    std::vector<llvm::BasicBlock *> bbReset, bbTest, bbStep;
     std::vector<llvm::Value *> startVals, endVals;
     std::vector<llvm::Constant *> steps;
     std::vector<int> span(nDims, 0);
     lGetSpans(nDims - 1, nDims, g->target->getVectorWidth(), isTiled, &span[0]);
+    llvm::Value *isFull = LLVMTrue;
     for (int i = 0; i < nDims; ++i) {
-        // Basic blocks that we'll fill in later with the looping logic for
-        // this dimension.
-        bbTest.push_back(ctx->CreateBasicBlock("foreach_test", i == 0 ? ctx->GetCurrentBasicBlock() : bbTest[i - 1]));
-        bbStep.push_back(ctx->CreateBasicBlock("foreach_step", bbBody));
-        bbReset.push_back(ctx->CreateBasicBlock("foreach_reset", bbStep[i]));
-
-        llvm::Value *sv = startExprs[i]->GetValue(ctx);
-        llvm::Value *ev = endExprs[i]->GetValue(ctx);
+        llvm::Value *sv = starts.empty() ? startExprs[i]->GetValue(ctx) : starts[i];
+        llvm::Value *ev = ends.empty() ? endExprs[i]->GetValue(ctx) : ends[i];
         if (sv == NULL || ev == NULL)
             return;
 
+        // Check if the extent of the dimension is a multiple of its span
+        llvm::Value *extent = ctx->BinaryOperator(llvm::Instruction::Sub, ev, sv, "extent");
+        llvm::Value *extra = ctx->BinaryOperator(llvm::Instruction::SRem, extent, LLVMInt32(span[i]), "extra");
+        llvm::Value *noExtra =
+            ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_EQ, extra, LLVMInt32(0), "no_extra");
+        isFull = ctx->BinaryOperator(llvm::Instruction::And, isFull, noExtra, "is_full");
+
         // Store varying start
         sv = ctx->BroadcastValue(sv, LLVMTypes::Int32VectorType, "start_broadcast");
         llvm::Constant *delta = lCalculateDeltaForVaryingCounter(i, nDims, span);
@@ -1916,6 +2983,46 @@ void ForeachStmt::EmitCodeForXe(FunctionEmitContext *ctx) const {
     // Officially start foreach. Emulating uniform for proper continue handlers.
     ctx->StartForeach(FunctionEmitContext::FOREACH_REGULAR, true);
 
+    ctx->BranchInst(bbFull, bbPartial, isFull);
+    ctx->SetCurrentBasicBlock(bbFull);
+    emitXeLoops(ctx, startVals, endVals, steps, true, bbExit);
+    ctx->SetCurrentBasicBlock(bbPartial);
+    emitXeLoops(ctx, startVals, endVals, steps, false, bbExit);
+
+    ///////////////////////////////////////////////////////////////////////////
+    // foreach_exit: All done. Restore the old mask and clean up
+    ctx->SetCurrentBasicBlock(bbExit);
+
+    // Restore execution mask from value that was saved at the beginning
+    if (execMask != NULL) {
+        ctx->XeEndUnmaskedRegion(execMask);
+        ctx->SetInternalMask(oldMask);
+        ctx->SetFunctionMask(oldFunctionMask);
+    }
+
+    ctx->EndForeach();
+    ctx->EndScope();
+}
+
+/* Emit the loops of a foreach statement on Xe, starting from the counters
+   that were initialized by EmitCodeForXe(), and branch to bbExit when they
+   are done.  With uniformTests, the program instances are known to pass or
+   fail each test together, so the test of the first one is used for all. */
+void ForeachStmt::emitXeLoops(FunctionEmitContext *ctx, const std::vector<llvm::Value *> &startVals,
+                              const std::vector<llvm::Value *> &endVals, const std::vector<llvm::Constant *> &steps,
+                              bool uniformTests, llvm::BasicBlock *bbExit) const {
+    int nDims = (int)dimVariables.size();
+    llvm::BasicBlock *bbBody =
+        ctx->CreateBasicBlock(uniformTests ? "foreach_full_body" : "foreach_body", ctx->GetCurrentBasicBlock());
+    std::vector<llvm::BasicBlock *> bbReset, bbTest, bbStep;
+    for (int i = 0; i < nDims; ++i) {
+        // Basic blocks that we'll fill in later with the looping logic for
+        // this dimension.
+        bbTest.push_back(ctx->CreateBasicBlock("foreach_test", i == 0 ? ctx->GetCurrentBasicBlock() : bbTest[i - 1]));
+        bbStep.push_back(ctx->CreateBasicBlock("foreach_step", bbBody));
+        bbReset.push_back(ctx->CreateBasicBlock("foreach_reset", bbStep[i]));
+    }
+
     // Jump to outermost test block
     ctx->BranchInst(bbTest[0]);
 
@@ -1964,6 +3071,8 @@ void ForeachStmt::EmitCodeForXe(FunctionEmitContext *ctx) const {
         ctx->SetCurrentBasicBlock(bbTest[i]);
         llvm::Value *val = ctx->LoadInst(dimVariables[i]->storageInfo, NULL, "val");
         llvm::Value *checkVal = ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SLT, val, endVals[i]);
+        if (uniformTests)
+            checkVal = ctx->ExtractInst(checkVal, 0, "in_range");
         // Target is body for innermost dimension, next dimension test for others
         llvm::BasicBlock *targetBB = (i < nDims - 1) ? bbTest[i + 1] : bbBody;
         // Turn off lanes untill reset is reached
@@ -1979,20 +3088,6 @@ void ForeachStmt::EmitCodeForXe(FunctionEmitContext *ctx) const {
     stmts->EmitCode(ctx);
     AssertPos(pos, ctx->GetCurrentBasicBlock() != NULL);
     ctx->BranchInst(bbStep[nDims - 1]);
-
-    ///////////////////////////////////////////////////////////////////////////
-    // foreach_exit: All done. Restore the old mask and clean up
-    ctx->SetCurrentBasicBlock(bbExit);
-
-    // Restore execution mask from value that was saved at the beginning
-    if (execMask != NULL) {
-        ctx->XeEndUnmaskedRegion(execMask);
-        ctx->SetInternalMask(oldMask);
-        ctx->SetFunctionMask(oldFunctionMask);
-    }
-
-    ctx->EndForeach();
-    ctx->EndScope();
 }
 #endif
 
@@ -2009,6 +3104,11 @@ Stmt *ForeachStmt::TypeCheck() {
             return this;
         }
     }
+    for (auto r : reductions) {
+        if (r->sym && r->sym->type && r->sym->type->IsDependentType()) {
+            return this;
+        }
+    }
 
     bool anyErrors = false;
     for (unsigned int i = 0; i < startExprs.size(); ++i) {
@@ -2050,6 +3150,90 @@ Stmt *ForeachStmt::TypeCheck() {
         anyErrors = true;
     }
 
+    if (!cacheTiles.empty() && cacheTiles.size() != dimVariables.size()) {
+        Error(pos, "'#pragma tile' gives %d tile sizes for \"foreach\" loop with %d dimensions.",
+              (int)cacheTiles.size(), (int)dimVariables.size());
+        anyErrors = true;
+    }
+
+    if (isParallel && !cacheTiles.empty()) {
+        Error(pos, "'#pragma tile' can't be used with \"parallel_foreach\" loops.");
+        anyErrors = true;
+    }
+
+    for (auto r : reductions) {
+        const AtomicType *at = r->sym ? CastType<AtomicType>(r->sym->type) : NULL;
+        if (r->sym == NULL || r->combine == NULL) {
+            AssertPos(pos, m->errorCount > 0);
+            anyErrors = true;
+            continue;
+        }
+        if (at == NULL) {
+            Error(r->pos, "\"reduce\" variable \"%s\" must have an atomic type, found \"%s\".",
+                  r->sym->name.c_str(), r->sym->type->GetString().c_str());
+            anyErrors = true;
+            continue;
+        }
+        if (at->IsConstType()) {
+            Error(r->pos, "\"reduce\" variable \"%s\" can't be \"const\".", r->sym->name.c_str());
+            anyErrors = true;
+            continue;
+        }
+
+        if (r->identity == NULL)
+            r->identity = lReductionIdentity(r->op, at, r->pos);
+        r->identity = TypeConvertExpr(ispc::TypeCheck(r->identity), at, "\"reduce\" identity value");
+        r->combine = TypeConvertExpr(ispc::TypeCheck(r->combine), at, "\"reduce\" operator");
+        anyErrors |= (r->identity == NULL || r->combine == NULL);
+    }
+
+    if (isDynamic) {
+        if (dimVariables.size() != 1) {
+            Error(pos, "\"foreach_dynamic\" loops must have exactly one dimension.");
+            anyErrors = true;
+        }
+        if (!cacheTiles.empty() || gangWidth > 0 || loopAttribute.first != Globals::pragmaUnrollType::none) {
+            Error(pos, "'#pragma tile', '#pragma width' and '#pragma unroll/nounroll' can't be used with "
+                       "\"foreach_dynamic\" loops.");
+            anyErrors = true;
+        }
+
+        std::vector<Stmt *> prologue, epilogue;
+        if (lSplitDynamicBody(stmts, &prologue, &epilogue) == NULL)
+            Warning(pos, "Body of \"foreach_dynamic\" loop doesn't have exactly one top-level \"for\" or "
+                         "\"while\" loop; running it as a regular \"foreach\" loop.");
+        else {
+            prologue.insert(prologue.end(), epilogue.begin(), epilogue.end());
+            for (Stmt *s : prologue)
+                anyErrors |= !lCheckDynamicBreakContinue(s);
+        }
+    }
+
+    if (interleave > 0 && !isDynamic) {
+        Error(pos, "'#pragma interleave' can only be used with \"foreach_dynamic\" loops.");
+        anyErrors = true;
+    }
+
+    if (gangWidth > 0) {
+        // The gang size is fixed by the target, so a wider gang is run as
+        // consecutive native passes by unrolling the loop.
+        int vectorWidth = g->target->getVectorWidth();
+        if (gangWidth < vectorWidth)
+            Warning(pos, "'#pragma width(%d)' is narrower than the gang size of the target (%d); ignoring it.",
+                    gangWidth, vectorWidth);
+        else if (gangWidth % vectorWidth != 0) {
+            Error(pos, "'#pragma width(%d)' must be a multiple of the gang size of the target (%d).", gangWidth,
+                  vectorWidth);
+            anyErrors = true;
+        } else if (loopAttribute.first != Globals::pragmaUnrollType::none) {
+            Error(pos, "'#pragma width' can't be used together with '#pragma unroll/nounroll'.");
+            anyErrors = true;
+        } else if (gangWidth > vectorWidth)
+            loopAttribute =
+                std::pair<Globals::pragmaUnrollType, int>(Globals::pragmaUnrollType::count, gangWidth / vectorWidth);
+        gangWidth = 0;
+    }
+
     return anyErrors ? NULL : this;
 }
 
@@ -2061,6 +3245,38 @@ void ForeachStmt::SetLoopAttribute(std::pair<Globals::pragmaUnrollType, int> lAt
     loopAttribute = lAttr;
 }
 
+void ForeachStmt::SetNontemporal() {
+    if (isNontemporal) {
+        Error(pos, "Multiple '#pragma nontemporal' directives used.");
+    }
+
+    isNontemporal = true;
+}
+
+void ForeachStmt::SetCacheTiles(const std::vector<int> &tiles) {
+    if (!cacheTiles.empty()) {
+        Error(pos, "Multiple '#pragma tile' directives used.");
+    }
+
+    cacheTiles = tiles;
+}
+
+void ForeachStmt::SetGangWidth(int width) {
+    if (gangWidth > 0) {
+        Error(pos, "Multiple '#pragma width' directives used.");
+    }
+
+    gangWidth = width;
+}
+
+void ForeachStmt::SetInterleave(int groups) {
+    if (interleave > 0) {
+        Error(pos, "Multiple '#pragma interleave' directives used.");
+    }
+
+    interleave = groups;
+}
+
 int ForeachStmt::EstimateCost() const { return dimVariables.size() * (COST_UNIFORM_LOOP + COST_SIMPLE_ARITH_LOGIC_OP); }
 
 ForeachStmt *ForeachStmt::Instantiate(TemplateInstantiation &templInst) const {
@@ -2087,12 +3303,20 @@ ForeachStmt *ForeachStmt::Instantiate(TemplateInstantiation &templInst) const {
 
     ForeachStmt *inst = new ForeachStmt(instDimVariables, instStartExprs, instEndExprs, instStmts, isTiled, pos);
     inst->loopAttribute = loopAttribute;
+    inst->isNontemporal = isNontemporal;
+    inst->cacheTiles = cacheTiles;
+    inst->gangWidth = gangWidth;
+    inst->isParallel = isParallel;
+    inst->isDynamic = isDynamic;
+    inst->interleave = interleave;
+    for (auto r : reductions)
+        inst->reductions.push_back(r->Instantiate(templInst));
 
     return inst;
 }
 
 void ForeachStmt::Print(Indent &indent) const {
-    indent.PrintLn("ForeachStmt", pos);
+    indent.PrintLn(isParallel ? "ForeachStmt (parallel)" : (isDynamic ? "ForeachStmt (dynamic)" : "ForeachStmt"), pos);
 
     int totalChildren = dimVariables.size() + (stmts ? 1 : 0);
     indent.pushList(totalChildren);
@@ -2777,6 +4001,48 @@ static bool lSwitchASTPreVisit(ASTNode *node, void *d) {
     return true;
 }
 
+/** Returns true if there is a label for "goto" in the given statement. */
+static bool lHasLabelPreVisit(ASTNode *node, void *d) {
+    if (llvm::dyn_cast<LabeledStmt>(node) != NULL)
+        *(bool *)d = true;
+    return true;
+}
+
+/** A varying "switch" with at least this many "case" labels gets a copy
+    with uniform control flow, which is run when all of the running program
+    instances have the same value of the switch expression. */
+static const int lMinCasesForAllEqualSwitch = 4;
+
+/** Emits code that checks whether all of the running program instances have
+    the same value of the varying switch expression.  Returns an i1 value
+    that is true if so (and some instance is running) and sets *firstValue to
+    the value of the first running instance. */
+static llvm::Value *lSwitchValuesAllEqual(FunctionEmitContext *ctx, llvm::Value *exprValue, llvm::Value **firstValue) {
+    llvm::Value *mask = ctx->GetFullMask();
+    llvm::Value *laneMask = ctx->LaneMask(mask);
+
+    // The bit of the last lane is set, so that the index of the first set
+    // bit is a valid lane index even if the mask is all off.
+    llvm::Value *lastLaneBit = LLVMInt64(1ull << (g->target->getVectorWidth() - 1));
+    llvm::Value *searchBits = ctx->BinaryOperator(llvm::Instruction::Or, laneMask, lastLaneBit, "search_bits");
+    llvm::Function *cttzFunc = m->module->getFunction("__count_trailing_zeros_i64");
+    Assert(cttzFunc != NULL);
+    llvm::Value *firstSet = ctx->CallInst(cttzFunc, NULL, searchBits, "first_set");
+    *firstValue = llvm::ExtractElementInst::Create(exprValue, firstSet, "switch_first_value",
+                                                   ctx->GetCurrentBasicBlock());
+
+    llvm::Value *firstSmear = ctx->SmearUniform(*firstValue, "switch_first_smear");
+    llvm::Value *matchesFirst =
+        ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_EQ, exprValue, firstSmear, "matches_first");
+    matchesFirst = ctx->I1VecToBoolVec(matchesFirst);
+    matchesFirst = ctx->BinaryOperator(llvm::Instruction::And, mask, matchesFirst, "mask&matches_first");
+    llvm::Value *allEqual = ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_EQ,
+                                         ctx->LaneMask(matchesFirst), laneMask, "all_equal");
+    llvm::Value *anyOn =
+        ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_NE, laneMask, LLVMInt64(0), "any_on");
+    return ctx->BinaryOperator(llvm::Instruction::And, allEqual, anyOn, "all_equal&any_on");
+}
+
 void SwitchStmt::EmitCode(FunctionEmitContext *ctx) const {
     if (ctx->GetCurrentBasicBlock() == NULL)
         return;
@@ -2828,6 +4094,42 @@ void SwitchStmt::EmitCode(FunctionEmitContext *ctx) const {
     }
 #endif
 
+    bool hasLabels = false;
+    WalkAST(stmts, lHasLabelPreVisit, NULL, &hasLabels);
+    if (!isUniformCF && !g->opt.disableUniformControlFlow && m->errorCount == 0 &&
+        (int)svi.caseBlocks.size() >= lMinCasesForAllEqualSwitch && !hasLabels && !lHasVaryingBreakOrContinue(stmts)) {
+        // Even if the switch expression is varying, all of the running
+        // program instances often have the same value of it.  Check for
+        // this case and run a copy of the switch with uniform control flow
+        // for it, which jumps straight to the matching label instead of
+        // testing the value against each of the "case" labels.
+        llvm::Value *firstValue = NULL;
+        llvm::Value *allEqual = lSwitchValuesAllEqual(ctx, exprValue, &firstValue);
+        llvm::BasicBlock *bbAllEqual = ctx->CreateBasicBlock("switch_all_equal", ctx->GetCurrentBasicBlock());
+        llvm::BasicBlock *bbAllEqualDone = ctx->CreateBasicBlock("switch_all_equal_done", bbAllEqual);
+        llvm::BasicBlock *bbVarying = ctx->CreateBasicBlock("switch_varying", bbAllEqualDone);
+        ctx->BranchInst(bbAllEqual, bbVarying, allEqual);
+
+        ctx->SetCurrentBasicBlock(bbAllEqual);
+        SwitchVisitInfo allEqualSvi(ctx);
+        WalkAST(stmts, lSwitchASTPreVisit, NULL, &allEqualSvi);
+        allEqualSvi.nextBlock[allEqualSvi.lastBlock] = bbAllEqualDone;
+
+        ctx->StartSwitch(true, bbAllEqualDone, false);
+        ctx->SetBlockEntryMask(ctx->GetFullMask());
+        ctx->SwitchInst(firstValue, allEqualSvi.defaultBlock ? allEqualSvi.defaultBlock : bbAllEqualDone,
+                        allEqualSvi.caseBlocks, allEqualSvi.nextBlock);
+        if (stmts != NULL)
+            stmts->EmitCode(ctx);
+        if (ctx->GetCurrentBasicBlock() != NULL)
+            ctx->BranchInst(bbAllEqualDone);
+        ctx->SetCurrentBasicBlock(bbAllEqualDone);
+        ctx->EndSwitch();
+        ctx->BranchInst(bbDone);
+
+        ctx->SetCurrentBasicBlock(bbVarying);
+    }
+
     ctx->StartSwitch(isUniformCF, bbDone, emulateUniform);
     ctx->SetBlockEntryMask(ctx->GetFullMask());
     ctx->SwitchInst(exprValue, svi.defaultBlock ? svi.defaultBlock : bbDone, svi.caseBlocks, svi.nextBlock);
@@ -3154,6 +4456,282 @@ LabeledStmt *LabeledStmt::Instantiate(TemplateInstantiation &templInst) const {
 ///////////////////////////////////////////////////////////////////////////
 // StmtList
 
+/** A load or a store in the body of a "foreach" loop that is considered for
+    fusion with the loop before or after it. */
+struct FusionAccess {
+    Symbol *base;
+    bool isWrite;
+    /** Whether the access is to memory that a pointer may point to: through
+        a pointer or a reference, or to an element of an array variable. */
+    bool isMemory;
+    /** Whether only the element of the current iteration of the loop is
+        accessed, i.e. every index is the loop's variable. */
+    bool isAligned;
+};
+
+struct FusionInfo {
+    Symbol *dimVar;
+    std::vector<FusionAccess> accesses;
+    std::set<Symbol *> referenced;
+    std::set<Symbol *> declared;
+    bool ok = true;
+};
+
+static bool lIsFusionDimVar(Expr *expr, Symbol *dimVar) {
+    while (TypeCastExpr *tce = llvm::dyn_cast<TypeCastExpr>(expr))
+        expr = tce->expr;
+    SymbolExpr *se = llvm::dyn_cast<SymbolExpr>(expr);
+    return se != NULL && se->GetBaseSymbol() == dimVar;
+}
+
+/** Records the access to the location given by the expression, and marks the
+    loop as not fusible if the symbol it's based on can't be found. */
+static void lAddFusionAccess(Expr *expr, bool isWrite, FusionInfo *info) {
+    FusionAccess access = {NULL, isWrite, false, true};
+    while (expr != NULL && access.base == NULL) {
+        if (MemberExpr *me = llvm::dyn_cast<MemberExpr>(expr)) {
+            if (me->dereferenceExpr) {
+                access.base = me->expr ? me->expr->GetBaseSymbol() : NULL;
+                access.isMemory = true;
+                access.isAligned = false;
+                break;
+            }
+            expr = me->expr;
+        } else if (IndexExpr *ie = llvm::dyn_cast<IndexExpr>(expr)) {
+            const Type *baseType = ie->baseExpr ? ie->baseExpr->GetType() : NULL;
+            if (baseType == NULL || ie->index == NULL)
+                break;
+            access.isAligned &= lIsFusionDimVar(ie->index, info->dimVar);
+            if (CastType<PointerType>(baseType) != NULL) {
+                Expr *base = ie->baseExpr;
+                while (TypeCastExpr *tce = llvm::dyn_cast<TypeCastExpr>(base))
+                    base = tce->expr;
+                if (llvm::isa<SymbolExpr>(base))
+                    access.base = base->GetBaseSymbol();
+                access.isMemory = true;
+                break;
+            }
+            // Pointers to the elements of arrays may be used in the other loop.
+            if (CastType<ArrayType>(baseType) != NULL)
+                access.isMemory = true;
+            expr = ie->baseExpr;
+        } else if (DerefExpr *de = llvm::dyn_cast<DerefExpr>(expr)) {
+            access.base = de->GetBaseSymbol();
+            access.isMemory = true;
+            access.isAligned = false;
+            break;
+        } else if (SymbolExpr *se = llvm::dyn_cast<SymbolExpr>(expr)) {
+            access.base = se->GetBaseSymbol();
+            if (access.base != NULL && CastType<ReferenceType>(access.base->type) != NULL) {
+                access.isMemory = true;
+                access.isAligned = false;
+            }
+            break;
+        } else
+            break;
+    }
+
+    if (access.base == NULL)
+        info->ok = false;
+    else if (isWrite || access.isMemory)
+        info->accesses.push_back(access);
+}
+
+/** Collects the accesses of the body of a "foreach" loop for the dependence
+    check of loop fusion, and rejects the statements and expressions that
+    change the control flow of the loop, have side effects other than
+    stores, or whose accesses can't be followed. */
+static bool lFusionCheckPre(ASTNode *node, void *d) {
+    FusionInfo *info = (FusionInfo *)d;
+    if (!info->ok)
+        return false;
+
+    if (llvm::isa<BreakStmt>(node) || llvm::isa<ContinueStmt>(node) || llvm::isa<ReturnStmt>(node) ||
+        llvm::isa<GotoStmt>(node) || llvm::isa<LabeledStmt>(node) || llvm::isa<PrintStmt>(node) ||
+        llvm::isa<AssertStmt>(node) || llvm::isa<DeleteStmt>(node) || llvm::isa<ForeachStmt>(node) ||
+        llvm::isa<ForeachActiveStmt>(node) || llvm::isa<ForeachUniqueStmt>(node) || llvm::isa<SyncExpr>(node) ||
+        llvm::isa<NewExpr>(node) || llvm::isa<AllocaExpr>(node) || llvm::isa<AddressOfExpr>(node) ||
+        llvm::isa<ReferenceExpr>(node)) {
+        info->ok = false;
+    } else if (DeclStmt *ds = llvm::dyn_cast<DeclStmt>(node)) {
+        for (const VariableDeclaration &vd : ds->vars) {
+            if (vd.sym == NULL || vd.sym->storageClass == SC_STATIC)
+                info->ok = false;
+            else
+                info->declared.insert(vd.sym);
+        }
+    } else if (FunctionCallExpr *fce = llvm::dyn_cast<FunctionCallExpr>(node)) {
+        // Only the standard library functions that return a value and
+        // can't access memory may be called.
+        Symbol *func =
+            (fce->func != NULL && llvm::isa<FunctionSymbolExpr>(fce->func)) ? fce->func->GetBaseSymbol() : NULL;
+        const FunctionType *ft = func ? CastType<FunctionType>(func->type) : NULL;
+        if (fce->isLaunch || ft == NULL || func->pos.name == NULL || strcmp(func->pos.name, "stdlib.ispc") != 0 ||
+            ft->GetReturnType()->IsVoidType())
+            info->ok = false;
+        for (int i = 0; info->ok && i < ft->GetNumParameters(); ++i) {
+            const Type *pt = ft->GetParameterType(i);
+            if (pt == NULL || pt->IsPointerType() || pt->IsReferenceType())
+                info->ok = false;
+        }
+    } else if (AssignExpr *ae = llvm::dyn_cast<AssignExpr>(node)) {
+        lAddFusionAccess(ae->lvalue, true, info);
+    } else if (UnaryExpr *ue = llvm::dyn_cast<UnaryExpr>(node)) {
+        if (ue->op == UnaryExpr::PreInc || ue->op == UnaryExpr::PreDec || ue->op == UnaryExpr::PostInc ||
+            ue->op == UnaryExpr::PostDec)
+            lAddFusionAccess(ue->expr, true, info);
+    } else if (llvm::isa<IndexExpr>(node) || llvm::isa<DerefExpr>(node) ||
+               (llvm::isa<MemberExpr>(node) && llvm::cast<MemberExpr>(node)->dereferenceExpr)) {
+        lAddFusionAccess((Expr *)node, false, info);
+    } else if (SymbolExpr *se = llvm::dyn_cast<SymbolExpr>(node)) {
+        info->referenced.insert(se->GetBaseSymbol());
+    }
+    return info->ok;
+}
+
+/** Returns true if the two bounds of "foreach" loops are the same
+    expression of constants and variables. */
+static bool lSameFusionBound(Expr *a, Expr *b) {
+    if (a == NULL || b == NULL || a->getValueID() != b->getValueID())
+        return false;
+
+    if (ConstExpr *ca = llvm::dyn_cast<ConstExpr>(a)) {
+        ConstExpr *cb = llvm::cast<ConstExpr>(b);
+        int64_t va[ISPC_MAX_NVEC], vb[ISPC_MAX_NVEC];
+        if (!Type::Equal(ca->GetType(), cb->GetType()) || !ca->GetType()->IsIntType())
+            return false;
+        int count = ca->GetValues(va);
+        cb->GetValues(vb);
+        return std::equal(va, va + count, vb);
+    }
+    if (SymbolExpr *sa = llvm::dyn_cast<SymbolExpr>(a))
+        return sa->GetBaseSymbol() == llvm::cast<SymbolExpr>(b)->GetBaseSymbol();
+    if (TypeCastExpr *ta = llvm::dyn_cast<TypeCastExpr>(a)) {
+        TypeCastExpr *tb = llvm::cast<TypeCastExpr>(b);
+        return Type::Equal(ta->type, tb->type) && lSameFusionBound(ta->expr, tb->expr);
+    }
+    if (UnaryExpr *ua = llvm::dyn_cast<UnaryExpr>(a)) {
+        UnaryExpr *ub = llvm::cast<UnaryExpr>(b);
+        return ua->op == ub->op && (ua->op == UnaryExpr::Negate || ua->op == UnaryExpr::BitNot) &&
+               lSameFusionBound(ua->expr, ub->expr);
+    }
+    if (BinaryExpr *ba = llvm::dyn_cast<BinaryExpr>(a)) {
+        BinaryExpr *bb = llvm::cast<BinaryExpr>(b);
+        return ba->op == bb->op && lSameFusionBound(ba->arg0, bb->arg0) && lSameFusionBound(ba->arg1, bb->arg1);
+    }
+    return false;
+}
+
+static bool lIsFusibleLoop(const ForeachStmt *fs) {
+    return fs->dimVariables.size() == 1 && fs->startExprs.size() == 1 && fs->endExprs.size() == 1 &&
+           fs->stmts != NULL && !fs->isParallel && !fs->isDynamic && fs->cacheTiles.empty();
+}
+
+/** Returns true if the memory accessed through the two different symbols
+    can't overlap: one of them is a "restrict" pointer, or both are variables
+    rather than pointers or references. */
+static bool lFusionNoAlias(Symbol *a, Symbol *b) {
+    const PointerType *pa = CastType<PointerType>(a->type), *pb = CastType<PointerType>(b->type);
+    if ((pa != NULL && pa->IsRestrict()) || (pb != NULL && pb->IsRestrict()))
+        return true;
+    return pa == NULL && pb == NULL && !a->type->IsReferenceType() && !b->type->IsReferenceType();
+}
+
+/** Returns true if the variables that one loop writes to, apart from its own
+    locals, aren't used by the other one (or by the bounds of the loops).
+    Variables other than arrays are assumed not to be accessed through
+    pointers in the loops, as their address can't be taken there; the
+    accesses to arrays are checked with the ones through pointers. */
+static bool lFusionVariablesIndependent(const FusionInfo &writer, const FusionInfo &reader,
+                                        const std::set<Symbol *> &bounds) {
+    for (const FusionAccess &access : writer.accesses)
+        if (access.isWrite && !access.isMemory && writer.declared.find(access.base) == writer.declared.end() &&
+            (reader.referenced.find(access.base) != reader.referenced.end() ||
+             bounds.find(access.base) != bounds.end()))
+            return false;
+    return true;
+}
+
+/** Returns true if the "foreach" loop b, which follows the loop a, can be
+    run in the same loop as a: both are 1D loops over the same range with
+    the same attributes, and no iteration of b depends on an iteration of a
+    other than the one for the same element. */
+static bool lCanFuseLoops(ForeachStmt *a, ForeachStmt *b) {
+    if (!lIsFusibleLoop(a) || !lIsFusibleLoop(b) || a->isTiled != b->isTiled || a->isNontemporal != b->isNontemporal ||
+        a->loopAttribute != b->loopAttribute || a->gangWidth != b->gangWidth || a->interleave != b->interleave ||
+        !Type::Equal(a->dimVariables[0]->type, b->dimVariables[0]->type) ||
+        !lSameFusionBound(a->startExprs[0], b->startExprs[0]) || !lSameFusionBound(a->endExprs[0], b->endExprs[0]))
+        return false;
+
+    FusionInfo infoA, infoB, bounds;
+    infoA.dimVar = a->dimVariables[0];
+    infoA.declared.insert(infoA.dimVar);
+    infoB.dimVar = b->dimVariables[0];
+    infoB.declared.insert(infoB.dimVar);
+    WalkAST(a->stmts, lFusionCheckPre, NULL, &infoA);
+    WalkAST(b->stmts, lFusionCheckPre, NULL, &infoB);
+    WalkAST(a->startExprs[0], lFusionCheckPre, NULL, &bounds);
+    WalkAST(a->endExprs[0], lFusionCheckPre, NULL, &bounds);
+    if (!infoA.ok || !infoB.ok || !bounds.ok)
+        return false;
+
+    if (!lFusionVariablesIndependent(infoA, infoB, bounds.referenced) ||
+        !lFusionVariablesIndependent(infoB, infoA, std::set<Symbol *>()))
+        return false;
+
+    for (const FusionAccess &accessA : infoA.accesses) {
+        for (const FusionAccess &accessB : infoB.accesses) {
+            if (!accessA.isMemory || !accessB.isMemory || (!accessA.isWrite && !accessB.isWrite))
+                continue;
+            if (accessA.base == accessB.base) {
+                if (!accessA.isAligned || !accessB.isAligned)
+                    return false;
+            } else if (!lFusionNoAlias(accessA.base, accessB.base))
+                return false;
+        }
+    }
+    return true;
+}
+
+struct FusionRename {
+    Symbol *from, *to;
+};
+
+static ASTNode *lFusionRenamePost(ASTNode *node, void *d) {
+    FusionRename *rename = (FusionRename *)d;
+    SymbolExpr *se = llvm::dyn_cast<SymbolExpr>(node);
+    if (se != NULL && se->GetBaseSymbol() == rename->from)
+        return new SymbolExpr(rename->to, se->pos);
+    return node;
+}
+
+/* Fuses the consecutive "foreach" loops over the same 1D range into a
+   single loop that runs the body of each loop in turn, when the dependence
+   checks above allow it, so that the data stored by the first body is used
+   by the second one while it's in registers, and the loop overhead is paid
+   once. */
+Stmt *StmtList::Optimize() {
+    if (g->opt.level == 0 || g->opt.disableLoopFusion)
+        return this;
+
+    for (unsigned int i = 0; i + 1 < stmts.size();) {
+        ForeachStmt *a = llvm::dyn_cast_or_null<ForeachStmt>(stmts[i]);
+        ForeachStmt *b = llvm::dyn_cast_or_null<ForeachStmt>(stmts[i + 1]);
+        if (a == NULL || b == NULL || !lCanFuseLoops(a, b)) {
+            ++i;
+            continue;
+        }
+
+        FusionRename rename = {b->dimVariables[0], a->dimVariables[0]};
+        StmtList *body = new StmtList(a->stmts->pos);
+        body->Add(a->stmts);
+        body->Add((Stmt *)WalkAST(b->stmts, NULL, lFusionRenamePost, &rename));
+        a->stmts = body;
+        stmts.erase(stmts.begin() + i + 1);
+    }
+    return this;
+}
+
 void StmtList::EmitCode(FunctionEmitContext *ctx) const {
     ctx->StartScope();
     ctx->SetDebugPos(pos);
@@ -3294,6 +4872,12 @@ static ExprWithType lProcessPrintArgType(Expr *expr) {
 static llvm::Function *getPrintImplFunc() {
     Assert(g->target->isXeTarget() == false);
     llvm::Function *printImplFunc = m->module->getFunction("__do_print");
+    if (g->asyncPrint && printImplFunc != NULL) {
+        // ISPCPrint() is provided by the application (e.g. by ispcrt) and takes the same arguments as __do_print().
+        llvm::FunctionCallee asyncPrintFunc =
+            m->module->getOrInsertFunction("ISPCPrint", printImplFunc->getFunctionType());
+        printImplFunc = llvm::dyn_cast<llvm::Function>(asyncPrintFunc.getCallee());
+    }
     return printImplFunc;
 }
 
@@ -3848,7 +5432,33 @@ void AssertStmt::EmitAssertCode(FunctionEmitContext *ctx, const Type *type) cons
     else
 #endif
         args.push_back(ctx->GetFullMask());
-    ctx->CallInst(assertFunc, NULL, args, "");
+
+    if (!g->target->isXeTarget()) {
+        // Only the test of the condition is inline, with the failure path in
+        // a block at the end of the function that's marked as unlikely and
+        // calls the out-of-line, cold __do_assert_fail(), so that passing
+        // assertions don't add register pressure to the code around them.
+        llvm::Function *failFunc = m->module->getFunction("__do_assert_fail");
+        AssertPos(pos, failFunc != NULL);
+        llvm::Value *failed = ctx->NotOperator(exprValue, "assert_failed");
+        if (!isUniform) {
+            failed = ctx->Any(ctx->BinaryOperator(llvm::Instruction::And, failed, args[2], "assert_failed_active"));
+        }
+        llvm::BasicBlock *bbFail = ctx->CreateBasicBlock("assert_fail");
+        llvm::BasicBlock *bbOk = ctx->CreateBasicBlock("assert_ok", ctx->GetCurrentBasicBlock());
+        llvm::Instruction *branch = ctx->BranchInst(bbFail, bbOk, failed);
+        branch->setMetadata(llvm::LLVMContext::MD_prof, llvm::MDBuilder(*g->ctx).createBranchWeights(1, 2000));
+        ctx->SetCurrentBasicBlock(bbFail);
+        if (g->asyncPrint) {
+            // Write what was printed before the assertion message.
+            llvm::FunctionCallee flushFunc = m->module->getOrInsertFunction("ISPCPrintFlush", LLVMTypes::VoidType);
+            ctx->CallInst(flushFunc.getCallee(), NULL, std::vector<llvm::Value *>(), "");
+        }
+        ctx->CallInst(failFunc, NULL, args[0], "");
+        ctx->BranchInst(bbOk);
+        ctx->SetCurrentBasicBlock(bbOk);
+    } else
+        ctx->CallInst(assertFunc, NULL, args, "");
 
     free(errorString);
 }
@@ -3959,7 +5569,9 @@ void DeleteStmt::EmitCode(FunctionEmitContext *ctx) const {
         // __delete_uniform() from the builtins expects.
         exprValue = ctx->BitCastInst(exprValue, LLVMTypes::VoidPointerType, "ptr_to_void");
         llvm::Function *func;
-        if (g->target->is32Bit()) {
+        if (g->customAllocator && !g->target->isXeTarget()) {
+            func = m->module->getFunction("__delete_uniform_custom");
+        } else if (g->target->is32Bit()) {
             func = m->module->getFunction("__delete_uniform_32rt");
         } else {
             func = m->module->getFunction("__delete_uniform_64rt");
@@ -3973,7 +5585,9 @@ void DeleteStmt::EmitCode(FunctionEmitContext *ctx) const {
         // only need to extend to 64-bit values on 32-bit targets before
         // calling it.
         llvm::Function *func;
-        if (g->target->is32Bit()) {
+        if (g->customAllocator && !g->target->isXeTarget()) {
+            func = m->module->getFunction("__delete_varying_custom");
+        } else if (g->target->is32Bit()) {
             func = m->module->getFunction("__delete_varying_32rt");
         } else {
             func = m->module->getFunction("__delete_varying_64rt");
@@ -4020,3 +5634,341 @@ DeleteStmt *DeleteStmt::Instantiate(TemplateInstantiation &templInst) const {
     Expr *instExpr = expr->Instantiate(templInst);
     return new DeleteStmt(instExpr, pos);
 }
+
+///////////////////////////////////////////////////////////////////////////
+// Uniform invariants
+
+/** The local variables and parameters of a function whose values can only
+    change by assignments to them: their address is never taken. */
+struct InvariantSymbols {
+    std::set<Symbol *> locals;
+    std::set<Symbol *> addressTaken;
+    bool ok = true;
+    /** The number of temporaries created for the function. */
+    int temporaries = 0;
+};
+
+static bool lCollectLocalsPre(ASTNode *node, void *d) {
+    InvariantSymbols *symbols = (InvariantSymbols *)d;
+    if (llvm::isa<GotoStmt>(node) || llvm::isa<LabeledStmt>(node)) {
+        // Jumps could skip the initialization of the temporaries.
+        symbols->ok = false;
+    } else if (DeclStmt *ds = llvm::dyn_cast<DeclStmt>(node)) {
+        for (const VariableDeclaration &vd : ds->vars)
+            symbols->locals.insert(vd.sym);
+    } else if (ForeachStmt *fs = llvm::dyn_cast<ForeachStmt>(node)) {
+        symbols->locals.insert(fs->dimVariables.begin(), fs->dimVariables.end());
+    } else if (ForeachActiveStmt *fas = llvm::dyn_cast<ForeachActiveStmt>(node)) {
+        symbols->locals.insert(fas->sym);
+    } else if (ForeachUniqueStmt *fus = llvm::dyn_cast<ForeachUniqueStmt>(node)) {
+        symbols->locals.insert(fus->sym);
+    } else if (AddressOfExpr *ae = llvm::dyn_cast<AddressOfExpr>(node)) {
+        if (ae->expr != NULL)
+            symbols->addressTaken.insert(ae->expr->GetBaseSymbol());
+    } else if (ReferenceExpr *re = llvm::dyn_cast<ReferenceExpr>(node)) {
+        if (re->expr != NULL)
+            symbols->addressTaken.insert(re->expr->GetBaseSymbol());
+    }
+    return symbols->ok;
+}
+
+/** Returns true if two invariant expressions compute the same value. */
+static bool lSameInvariant(const Expr *a, const Expr *b) {
+    if (a->getValueID() != b->getValueID() || !Type::Equal(a->GetType(), b->GetType()))
+        return false;
+
+    if (const ConstExpr *ca = llvm::dyn_cast<ConstExpr>(a)) {
+        llvm::Constant *va = ca->GetConstant(ca->GetType()).first;
+        return va != NULL && va == llvm::cast<ConstExpr>(b)->GetConstant(b->GetType()).first;
+    }
+    if (const SymbolExpr *sa = llvm::dyn_cast<SymbolExpr>(a))
+        return sa->GetBaseSymbol() == llvm::cast<SymbolExpr>(b)->GetBaseSymbol();
+    if (const TypeCastExpr *ta = llvm::dyn_cast<TypeCastExpr>(a))
+        return lSameInvariant(ta->expr, llvm::cast<TypeCastExpr>(b)->expr);
+    if (const UnaryExpr *ua = llvm::dyn_cast<UnaryExpr>(a)) {
+        const UnaryExpr *ub = llvm::cast<UnaryExpr>(b);
+        return ua->op == ub->op && lSameInvariant(ua->expr, ub->expr);
+    }
+    if (const BinaryExpr *ba = llvm::dyn_cast<BinaryExpr>(a)) {
+        const BinaryExpr *bb = llvm::cast<BinaryExpr>(b);
+        return ba->op == bb->op && lSameInvariant(ba->arg0, bb->arg0) && lSameInvariant(ba->arg1, bb->arg1);
+    }
+    if (const SelectExpr *sa = llvm::dyn_cast<SelectExpr>(a)) {
+        const SelectExpr *sb = llvm::cast<SelectExpr>(b);
+        return lSameInvariant(sa->test, sb->test) && lSameInvariant(sa->expr1, sb->expr1) &&
+               lSameInvariant(sa->expr2, sb->expr2);
+    }
+    return false;
+}
+
+/** The uniform expressions of a region of a function, a loop or the whole
+    body, whose value is the same wherever they're evaluated in the region.
+    They are computed once into temporaries before the region. */
+struct InvariantRegion {
+    InvariantSymbols *symbols;
+    /** The variables that the region declares or assigns. */
+    std::set<Symbol *> written;
+    int switchDepth = 0;
+    bool ok = true;
+    /** The invariant expressions, mapped to whether they read a variable. */
+    std::map<const Expr *, bool> invariant;
+    /** The invariant expressions that read variables, in post-order. */
+    std::vector<Expr *> all;
+    /** The ones that aren't part of larger ones. */
+    std::vector<Expr *> largest;
+    std::map<const Expr *, Symbol *> temporaries;
+    std::vector<VariableDeclaration> decls;
+};
+
+/** Records the variables that the region declares or assigns, and marks it
+    as unusable if a "case" label of an enclosing "switch" could jump into
+    it. */
+static bool lInvariantCollectPre(ASTNode *node, void *d) {
+    InvariantRegion *region = (InvariantRegion *)d;
+    if (llvm::isa<SwitchStmt>(node)) {
+        ++region->switchDepth;
+    } else if ((llvm::isa<CaseStmt>(node) || llvm::isa<DefaultStmt>(node)) && region->switchDepth == 0) {
+        region->ok = false;
+    } else if (DeclStmt *ds = llvm::dyn_cast<DeclStmt>(node)) {
+        for (const VariableDeclaration &vd : ds->vars)
+            region->written.insert(vd.sym);
+    } else if (ForeachStmt *fs = llvm::dyn_cast<ForeachStmt>(node)) {
+        region->written.insert(fs->dimVariables.begin(), fs->dimVariables.end());
+    } else if (ForeachActiveStmt *fas = llvm::dyn_cast<ForeachActiveStmt>(node)) {
+        region->written.insert(fas->sym);
+    } else if (ForeachUniqueStmt *fus = llvm::dyn_cast<ForeachUniqueStmt>(node)) {
+        region->written.insert(fus->sym);
+    } else if (AssignExpr *ae = llvm::dyn_cast<AssignExpr>(node)) {
+        if (ae->lvalue != NULL)
+            region->written.insert(ae->lvalue->GetBaseSymbol());
+    } else if (UnaryExpr *ue = llvm::dyn_cast<UnaryExpr>(node)) {
+        if ((ue->op == UnaryExpr::PreInc || ue->op == UnaryExpr::PreDec || ue->op == UnaryExpr::PostInc ||
+             ue->op == UnaryExpr::PostDec) &&
+            ue->expr != NULL)
+            region->written.insert(ue->expr->GetBaseSymbol());
+    }
+    return region->ok;
+}
+
+static ASTNode *lInvariantCollectPost(ASTNode *node, void *d) {
+    if (llvm::isa<SwitchStmt>(node))
+        --((InvariantRegion *)d)->switchDepth;
+    return node;
+}
+
+static void lCollectInvariantRegion(ASTNode *node, InvariantRegion *region) {
+    WalkAST(node, lInvariantCollectPre, lInvariantCollectPost, region);
+}
+
+static bool lIsInvariantOperand(const InvariantRegion *region, const Expr *expr) {
+    return expr != NULL && region->invariant.find(expr) != region->invariant.end();
+}
+
+static bool lReadsVariable(const InvariantRegion *region, const Expr *expr) {
+    return expr != NULL && region->invariant.find(expr)->second;
+}
+
+/** Marks the uniform scalar expressions whose operands are constants or
+    variables that the region doesn't change, and that can't trap when
+    they're evaluated before the region. */
+static ASTNode *lInvariantMarkPost(ASTNode *node, void *d) {
+    InvariantRegion *region = (InvariantRegion *)d;
+    Expr *expr = llvm::dyn_cast<Expr>(node);
+    const Type *type = expr ? expr->GetType() : NULL;
+    if (type == NULL || !type->IsUniformType() ||
+        (CastType<AtomicType>(type) == NULL && CastType<EnumType>(type) == NULL))
+        return node;
+
+    bool isInvariant = false, readsVariable = false;
+    if (llvm::isa<ConstExpr>(expr)) {
+        isInvariant = true;
+    } else if (SymbolExpr *se = llvm::dyn_cast<SymbolExpr>(expr)) {
+        Symbol *sym = se->GetBaseSymbol();
+        isInvariant = readsVariable = sym != NULL && sym->storageClass == SC_NONE &&
+                                      region->symbols->locals.find(sym) != region->symbols->locals.end() &&
+                                      region->symbols->addressTaken.find(sym) == region->symbols->addressTaken.end() &&
+                                      region->written.find(sym) == region->written.end();
+    } else if (TypeCastExpr *tce = llvm::dyn_cast<TypeCastExpr>(expr)) {
+        isInvariant = lIsInvariantOperand(region, tce->expr);
+        readsVariable = isInvariant && lReadsVariable(region, tce->expr);
+    } else if (UnaryExpr *ue = llvm::dyn_cast<UnaryExpr>(expr)) {
+        isInvariant = (ue->op == UnaryExpr::Negate || ue->op == UnaryExpr::LogicalNot || ue->op == UnaryExpr::BitNot) &&
+                      lIsInvariantOperand(region, ue->expr);
+        readsVariable = isInvariant && lReadsVariable(region, ue->expr);
+    } else if (BinaryExpr *be = llvm::dyn_cast<BinaryExpr>(expr)) {
+        // Integer division may trap when the region wouldn't have run it.
+        isInvariant = be->op != BinaryExpr::Comma && lIsInvariantOperand(region, be->arg0) &&
+                      lIsInvariantOperand(region, be->arg1) &&
+                      ((be->op != BinaryExpr::Div && be->op != BinaryExpr::Mod) || type->IsFloatType());
+        readsVariable = isInvariant && (lReadsVariable(region, be->arg0) || lReadsVariable(region, be->arg1));
+    } else if (SelectExpr *se = llvm::dyn_cast<SelectExpr>(expr)) {
+        isInvariant = lIsInvariantOperand(region, se->test) && lIsInvariantOperand(region, se->expr1) &&
+                      lIsInvariantOperand(region, se->expr2);
+        readsVariable = isInvariant && (lReadsVariable(region, se->test) || lReadsVariable(region, se->expr1) ||
+                                        lReadsVariable(region, se->expr2));
+    }
+    if (isInvariant) {
+        region->invariant[expr] = readsVariable;
+        if (readsVariable && !llvm::isa<SymbolExpr>(expr))
+            region->all.push_back(expr);
+    }
+    return node;
+}
+
+static bool lInvariantLargestPre(ASTNode *node, void *d) {
+    InvariantRegion *region = (InvariantRegion *)d;
+    Expr *expr = llvm::dyn_cast<Expr>(node);
+    if (expr == NULL || region->invariant.find(expr) == region->invariant.end())
+        return true;
+    // Constants are folded by Optimize(), and loading a variable costs
+    // as much as loading a temporary.
+    if (region->invariant[expr] && !llvm::isa<SymbolExpr>(expr))
+        region->largest.push_back(expr);
+    return false;
+}
+
+static void lMarkInvariantRegion(ASTNode *node, InvariantRegion *region) {
+    WalkAST(node, NULL, lInvariantMarkPost, region);
+    WalkAST(node, lInvariantLargestPre, NULL, region);
+}
+
+/** Creates a temporary for each distinct expression of the given ones that
+    appears at least minUses times.  Their temporaries are declared in the
+    order of the expressions, so the expressions have to be in post-order
+    when they may contain each other. */
+static void lGroupInvariants(InvariantRegion *region, const std::vector<Expr *> &exprs, unsigned int minUses) {
+    std::vector<std::vector<Expr *>> groups;
+    for (Expr *expr : exprs) {
+        auto group = std::find_if(groups.begin(), groups.end(), [expr](const std::vector<Expr *> &group) {
+            return lSameInvariant(group[0], expr);
+        });
+        if (group == groups.end())
+            groups.push_back({expr});
+        else
+            group->push_back(expr);
+    }
+
+    for (const std::vector<Expr *> &group : groups) {
+        if (group.size() < minUses)
+            continue;
+        Expr *expr = group[0];
+        std::string name = "__uniform_invariant_" + std::to_string(region->symbols->temporaries++);
+        Symbol *sym = new Symbol(name, expr->pos, expr->GetType()->GetAsNonConstType());
+        region->decls.push_back(VariableDeclaration(sym, expr));
+        for (Expr *use : group)
+            region->temporaries[use] = sym;
+    }
+}
+
+static ASTNode *lInvariantReplacePost(ASTNode *node, void *d) {
+    InvariantRegion *region = (InvariantRegion *)d;
+    Expr *expr = llvm::dyn_cast<Expr>(node);
+    auto temporary = expr ? region->temporaries.find(expr) : region->temporaries.end();
+    if (temporary == region->temporaries.end())
+        return node;
+    return new SymbolExpr(temporary->second, expr->pos);
+}
+
+template <typename T> static T *lReplaceInvariants(T *node, InvariantRegion *region) {
+    return (T *)WalkAST(node, NULL, lInvariantReplacePost, region);
+}
+
+/** Returns the statement preceded by the declarations of the temporaries of
+    the region. */
+static Stmt *lWrapInvariants(Stmt *stmt, InvariantRegion *region) {
+    if (region->decls.empty())
+        return stmt;
+    StmtList *list = new StmtList(stmt->pos);
+    list->Add(new DeclStmt(region->decls, stmt->pos));
+    list->Add(stmt);
+    return list;
+}
+
+/** Hoists the invariant uniform expressions of a loop, the ones evaluated
+    in each iteration, out of it.  Inner loops have already been visited,
+    and the temporaries of their invariants are declared in the loop, so
+    the initializers of those are hoisted further when they are invariant
+    here too. */
+static ASTNode *lHoistLoopInvariantsPost(ASTNode *node, void *d) {
+    InvariantRegion region;
+    region.symbols = (InvariantSymbols *)d;
+    if (ForStmt *fs = llvm::dyn_cast<ForStmt>(node)) {
+        lCollectInvariantRegion(fs->init, &region);
+        lCollectInvariantRegion(fs->test, &region);
+        lCollectInvariantRegion(fs->step, &region);
+        lCollectInvariantRegion(fs->stmts, &region);
+        if (!region.ok)
+            return node;
+        lMarkInvariantRegion(fs->test, &region);
+        lMarkInvariantRegion(fs->step, &region);
+        lMarkInvariantRegion(fs->stmts, &region);
+        lGroupInvariants(&region, region.largest, 1);
+        fs->test = lReplaceInvariants(fs->test, &region);
+        fs->step = lReplaceInvariants(fs->step, &region);
+        fs->stmts = lReplaceInvariants(fs->stmts, &region);
+    } else if (DoStmt *ds = llvm::dyn_cast<DoStmt>(node)) {
+        lCollectInvariantRegion(ds->testExpr, &region);
+        lCollectInvariantRegion(ds->bodyStmts, &region);
+        if (!region.ok)
+            return node;
+        lMarkInvariantRegion(ds->testExpr, &region);
+        lMarkInvariantRegion(ds->bodyStmts, &region);
+        lGroupInvariants(&region, region.largest, 1);
+        ds->testExpr = lReplaceInvariants(ds->testExpr, &region);
+        ds->bodyStmts = lReplaceInvariants(ds->bodyStmts, &region);
+    } else if (llvm::isa<ForeachStmt>(node) || llvm::isa<ForeachActiveStmt>(node) ||
+               llvm::isa<ForeachUniqueStmt>(node)) {
+        // Only the body of "foreach" loops is run for each iteration.
+        Stmt **body = NULL;
+        if (ForeachStmt *fs = llvm::dyn_cast<ForeachStmt>(node)) {
+            region.written.insert(fs->dimVariables.begin(), fs->dimVariables.end());
+            body = &fs->stmts;
+        } else if (ForeachActiveStmt *fas = llvm::dyn_cast<ForeachActiveStmt>(node)) {
+            region.written.insert(fas->sym);
+            body = &fas->stmts;
+        } else {
+            ForeachUniqueStmt *fus = llvm::cast<ForeachUniqueStmt>(node);
+            region.written.insert(fus->sym);
+            body = &fus->stmts;
+        }
+        lCollectInvariantRegion(*body, &region);
+        if (!region.ok)
+            return node;
+        lMarkInvariantRegion(*body, &region);
+        lGroupInvariants(&region, region.largest, 1);
+        *body = lReplaceInvariants(*body, &region);
+    } else {
+        return node;
+    }
+    return lWrapInvariants((Stmt *)node, &region);
+}
+
+/* The uniform expressions that ctx.cpp would otherwise emit each time they
+   are evaluated are computed once: the invariant ones of each loop before
+   the loop, and the ones that the body of the function computes several
+   times from parameters it doesn't change, at the start of the function.
+   This only covers arithmetic on uniform scalar variables whose address
+   isn't taken, which nothing but their assignments can change, so no
+   analysis of memory accesses and calls is needed. */
+Stmt *ispc::HoistUniformInvariants(Stmt *code, const std::vector<Symbol *> &args) {
+    if (code == NULL || g->opt.level == 0 || g->opt.disableUniformHoisting || g->generateDebuggingSymbols)
+        return code;
+
+    InvariantSymbols symbols;
+    symbols.locals.insert(args.begin(), args.end());
+    WalkAST(code, lCollectLocalsPre, NULL, &symbols);
+    if (!symbols.ok)
+        return code;
+
+    code = (Stmt *)WalkAST(code, NULL, lHoistLoopInvariantsPost, &symbols);
+
+    InvariantRegion region;
+    region.symbols = &symbols;
+    lCollectInvariantRegion(code, &region);
+    if (!region.ok)
+        return code;
+    lMarkInvariantRegion(code, &region);
+    lGroupInvariants(&region, region.all, 2);
+    code = lReplaceInvariants(code, &region);
+    return lWrapInvariants(code, &region);
+}
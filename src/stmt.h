@@ -68,6 +68,10 @@ class Stmt : public ASTNode {
     virtual Stmt *Instantiate(TemplateInstantiation &templInst) const = 0;
 
     virtual void SetLoopAttribute(std::pair<Globals::pragmaUnrollType, int>);
+    virtual void SetNontemporal();
+    virtual void SetCacheTiles(const std::vector<int> &tiles);
+    virtual void SetGangWidth(int width);
+    virtual void SetInterleave(int groups);
 };
 
 /** @brief Statement representing a single expression */
@@ -251,6 +255,32 @@ class ContinueStmt : public Stmt {
     ContinueStmt *Instantiate(TemplateInstantiation &templInst) const;
 };
 
+/** A "reduce" clause of a 'parallel_foreach' loop for one variable: each
+    task accumulates into its own copy of the variable, which starts out as
+    the identity of the operator, and the copies are combined with the
+    variable after the loop.
+ */
+struct ParallelReduction {
+    enum Op { Add, Mul, BitAnd, BitOr, BitXor, Min, Max, Function };
+
+    ParallelReduction(Op op, Symbol *sym, Expr *func, Expr *identity, SourcePos pos);
+
+    ParallelReduction *Instantiate(TemplateInstantiation &templInst) const;
+
+    Op op;
+    Symbol *sym;
+    /** The function for Function reductions. */
+    Expr *func;
+    /** The value that the copies start with.  It's given for Function
+        reductions and otherwise set from the operator when the loop is
+        type checked. */
+    Expr *identity;
+    /** The combination of the values of lhs and rhs with the operator. */
+    Symbol *lhs, *rhs;
+    Expr *combine;
+    SourcePos pos;
+};
+
 /** @brief Statement implementation for parallel 'foreach' loops.
  */
 class ForeachStmt : public Stmt {
@@ -262,7 +292,8 @@ class ForeachStmt : public Stmt {
     static inline bool classof(ASTNode const *N) { return N->getValueID() == ForeachStmtID; }
 
 #ifdef ISPC_XE_ENABLED
-    void EmitCodeForXe(FunctionEmitContext *ctx) const;
+    void EmitCodeForXe(FunctionEmitContext *ctx, const std::vector<llvm::Value *> &starts,
+                       const std::vector<llvm::Value *> &ends) const;
 #endif
     void EmitCode(FunctionEmitContext *ctx) const;
     void Print(Indent &indent) const;
@@ -271,6 +302,10 @@ class ForeachStmt : public Stmt {
     std::pair<Globals::pragmaUnrollType, int> loopAttribute =
         std::pair<Globals::pragmaUnrollType, int>(Globals::pragmaUnrollType::none, -1);
     void SetLoopAttribute(std::pair<Globals::pragmaUnrollType, int>);
+    void SetNontemporal();
+    void SetCacheTiles(const std::vector<int> &tiles);
+    void SetGangWidth(int width);
+    void SetInterleave(int groups);
     int EstimateCost() const;
     ForeachStmt *Instantiate(TemplateInstantiation &templInst) const;
 
@@ -278,7 +313,46 @@ class ForeachStmt : public Stmt {
     std::vector<Expr *> startExprs;
     std::vector<Expr *> endExprs;
     bool isTiled;
+    /** Set by '#pragma nontemporal': full-vector stores in the loop body
+        are emitted as non-temporal (streaming) stores. */
+    bool isNontemporal = false;
+    /** Set by '#pragma tile': the size of the blocks of the iteration
+        domain, one per dimension, that are run one after the other so that
+        the data they access stays in the cache. */
+    std::vector<int> cacheTiles;
+    /** Set by '#pragma width': the number of elements to process in each
+        iteration, a multiple of the target's gang size.  It's turned into
+        an unroll count of the loop when the loop is type checked. */
+    int gangWidth = 0;
+    /** Set for 'parallel_foreach' loops: the loop is outlined into a task
+        function, and the iteration domain is split into chunks that are
+        launched as tasks and synced at the end of the loop. */
+    bool isParallel = false;
+    /** The "reduce" clauses of a 'parallel_foreach' loop. */
+    std::vector<ParallelReduction *> reductions;
+    /** Set for 'foreach_dynamic' loops: each program instance runs the
+        top-level loop of the body for its own element, and the instances
+        whose loop has ended are given the next elements of the range. */
+    bool isDynamic = false;
+    /** Set by '#pragma interleave' for 'foreach_dynamic' loops: the number
+        of groups of program instances with their own elements that run an
+        iteration of the inner loop in turn. */
+    int interleave = 0;
     Stmt *stmts;
+
+  private:
+    /** Emits the loops over the given range, or over the range given by
+        the start and end expressions if the vectors are empty. */
+    void emitLoops(FunctionEmitContext *ctx, const std::vector<llvm::Value *> &starts,
+                   const std::vector<llvm::Value *> &ends) const;
+    void emitCacheBlockedLoops(FunctionEmitContext *ctx) const;
+    void emitParallelLoops(FunctionEmitContext *ctx) const;
+    void emitDynamicLoop(FunctionEmitContext *ctx) const;
+#ifdef ISPC_XE_ENABLED
+    void emitXeLoops(FunctionEmitContext *ctx, const std::vector<llvm::Value *> &startVals,
+                     const std::vector<llvm::Value *> &endVals, const std::vector<llvm::Constant *> &steps,
+                     bool uniformTests, llvm::BasicBlock *bbExit) const;
+#endif
 };
 
 /** Iteration over each executing program instance.
@@ -486,6 +560,7 @@ class StmtList : public Stmt {
     void EmitCode(FunctionEmitContext *ctx) const;
     void Print(Indent &indent) const;
 
+    Stmt *Optimize();
     Stmt *TypeCheck();
     int EstimateCost() const;
     StmtList *Instantiate(TemplateInstantiation &templInst) const;
@@ -597,4 +672,10 @@ class DeleteStmt : public Stmt {
 };
 
 extern Stmt *CreateForeachActiveStmt(Symbol *iterSym, Stmt *stmts, SourcePos pos);
+
+/** Computes the uniform expressions of the body of a function that don't
+    change in a loop once before the loop, and the ones computed several
+    times from unchanged parameters once at the start of the function.
+    Returns the resulting body. */
+extern Stmt *HoistUniformInvariants(Stmt *code, const std::vector<Symbol *> &args);
 } // namespace ispc
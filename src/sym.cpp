@@ -78,7 +78,7 @@ void SymbolTable::PushScope() {
     if (freeSymbolMaps.size() > 0) {
         sm = freeSymbolMaps.back();
         freeSymbolMaps.pop_back();
-        sm->erase(sm->begin(), sm->end());
+        sm->clear();
     } else
         sm = new SymbolMapType;
 
@@ -165,7 +165,7 @@ bool SymbolTable::LookupFunction(const char *name, std::vector<Symbol *> *matche
 Symbol *SymbolTable::LookupFunction(const char *name, const FunctionType *type) {
     FunctionMapType::iterator iter = functions.find(name);
     if (iter != functions.end()) {
-        std::vector<Symbol *> funcs = iter->second;
+        const std::vector<Symbol *> &funcs = iter->second;
         for (int j = 0; j < (int)funcs.size(); ++j) {
             if (Type::Equal(funcs[j]->type, type))
                 return funcs[j];
@@ -227,7 +227,7 @@ TemplateSymbol *SymbolTable::LookupFunctionTemplate(const TemplateParms *templat
     // - function types match
     FunctionTemplateMapType::iterator iter = functionTemplates.find(name);
     if (iter != functionTemplates.end()) {
-        std::vector<TemplateSymbol *> templs = iter->second;
+        const std::vector<TemplateSymbol *> &templs = iter->second;
         for (auto templ : templs) {
             if (templateParmList->IsEqual(templ->templateParms) && Type::Equal(templ->type, type)) {
                 return templ;
@@ -307,15 +307,20 @@ std::vector<std::string> SymbolTable::ClosestVariableOrFunctionMatch(const char
 
     FunctionMapType::const_iterator iter;
     for (iter = functions.begin(); iter != functions.end(); ++iter) {
-        int dist = StringEditDistance(str, iter->first, maxDelta + 1);
+        std::string name = iter->getKey().str();
+        int dist = StringEditDistance(str, name, maxDelta + 1);
         if (dist <= maxDelta)
-            matches[dist].push_back(iter->first);
+            matches[dist].push_back(name);
     }
 
     // Now, return the first entry of matches[] that is non-empty, if any.
+    // The symbol maps are hashed, so sort it to report the matches in a
+    // stable order.
     for (int i = 0; i <= maxDelta; ++i) {
-        if (matches[i].size())
+        if (matches[i].size()) {
+            std::sort(matches[i].begin(), matches[i].end());
             return matches[i];
+        }
     }
 
     // Otherwise, no joy.
@@ -379,7 +384,7 @@ void SymbolTable::Print() {
     fprintf(stderr, "Functions:\n----------------\n");
     FunctionMapType::iterator fiter = functions.begin();
     while (fiter != functions.end()) {
-        fprintf(stderr, "%s\n", fiter->first.c_str());
+        fprintf(stderr, "%s\n", fiter->getKey().str().c_str());
         std::vector<Symbol *> &syms = fiter->second;
         for (unsigned int j = 0; j < syms.size(); ++j)
             fprintf(stderr, "    %s\n", syms[j]->type->GetString().c_str());
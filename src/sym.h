@@ -43,8 +43,11 @@
 #include "decl.h"
 #include "ispc.h"
 
+#include <algorithm>
 #include <map>
 
+#include <llvm/ADT/StringMap.h>
+
 namespace ispc {
 
 class StructType;
@@ -63,7 +66,7 @@ class ConstExpr;
    function symbols (and vice versa, for non-function symbols)?
  */
 
-class Symbol {
+class Symbol : public Traceable {
   public:
     /** The Symbol constructor takes the name of the symbol, its
         position in a source file, and its type (if known). */
@@ -327,9 +330,10 @@ class SymbolTable {
         active scopes as the program is being parsed.  New maps are added
         and removed from the end of the main vector, so searches for
         symbols start looking at the end of \c variables and work
-        backwards.
+        backwards.  The maps are hashed, since they are searched for every
+        identifier in the program.
      */
-    typedef std::map<std::string, Symbol *> SymbolMapType;
+    typedef llvm::StringMap<Symbol *> SymbolMapType;
     std::vector<SymbolMapType *> variables;
 
     std::vector<SymbolMapType *> freeSymbolMaps;
@@ -339,7 +343,7 @@ class SymbolTable {
         namespace.)  A STL \c vector is used to store the function symbols
         for a given name since, due to function overloading, a name can
         have multiple function symbols associated with it. */
-    typedef std::map<std::string, std::vector<Symbol *>> FunctionMapType;
+    typedef llvm::StringMap<std::vector<Symbol *>> FunctionMapType;
     FunctionMapType functions;
 
     /** This maps ISPC symbols for corresponding LLVM intrinsic functions.
@@ -351,7 +355,7 @@ class SymbolTable {
         *not* scoped.  A STL \c vector is used to store the function templates
         for a given name since, due to function overloading, a name can
         have multiple function templates associated with it. */
-    typedef std::map<std::string, std::vector<TemplateSymbol *>> FunctionTemplateMapType;
+    typedef llvm::StringMap<std::vector<TemplateSymbol *>> FunctionTemplateMapType;
     FunctionTemplateMapType functionTemplates;
 
     /** Scoped types.
@@ -363,10 +367,17 @@ class SymbolTable {
 template <typename Predicate>
 void SymbolTable::GetMatchingFunctions(Predicate pred, std::vector<Symbol *> *matches) const {
     // Iterate through all function symbols and apply the given predicate.
-    // If it returns true, add the Symbol * to the provided vector.
-    FunctionMapType::const_iterator iter;
-    for (iter = functions.begin(); iter != functions.end(); ++iter) {
-        const std::vector<Symbol *> &syms = iter->second;
+    // If it returns true, add the Symbol * to the provided vector.  The
+    // functions are visited in the order of their names, so that the
+    // output that depends on it, like the generated headers, is stable.
+    std::vector<llvm::StringRef> names;
+    names.reserve(functions.size());
+    for (FunctionMapType::const_iterator iter = functions.begin(); iter != functions.end(); ++iter)
+        names.push_back(iter->getKey());
+    std::sort(names.begin(), names.end());
+
+    for (llvm::StringRef name : names) {
+        const std::vector<Symbol *> &syms = functions.find(name)->second;
         for (unsigned int j = 0; j < syms.size(); ++j) {
             if (pred(syms[j]))
                 matches->push_back(syms[j]);
@@ -53,6 +53,8 @@ Arch ParseArch(std::string arch) {
         return Arch::arm;
     } else if (arch == "aarch64") {
         return Arch::aarch64;
+    } else if (arch == "riscv64") {
+        return Arch::riscv64;
     } else if (arch == "wasm32") {
         return Arch::wasm32;
     } else if (arch == "xe32") {
@@ -75,6 +77,8 @@ std::string ArchToString(Arch arch) {
         return "arm";
     case Arch::aarch64:
         return "aarch64";
+    case Arch::riscv64:
+        return "riscv64";
     case Arch::wasm32:
         return "wasm32";
     case Arch::xe32:
@@ -146,6 +150,8 @@ ISPCTarget ParseISPCTarget(std::string target) {
         return ISPCTarget::avx512skx_x8;
     } else if (target == "avx512skx-x16" || target == "avx512skx-i32x16") {
         return ISPCTarget::avx512skx_x16;
+    } else if (target == "avx512skx-ymm-x16") {
+        return ISPCTarget::avx512skx_ymm_x16;
     } else if (target == "avx512skx-x32" || target == "avx512skx-i16x32") {
         return ISPCTarget::avx512skx_x32;
     } else if (target == "avx512skx-x64" || target == "avx512skx-i8x64") {
@@ -156,6 +162,8 @@ ISPCTarget ParseISPCTarget(std::string target) {
         return ISPCTarget::avx512spr_x8;
     } else if (target == "avx512spr-x16") {
         return ISPCTarget::avx512spr_x16;
+    } else if (target == "avx512spr-ymm-x16") {
+        return ISPCTarget::avx512spr_ymm_x16;
     } else if (target == "avx512spr-x32") {
         return ISPCTarget::avx512spr_x32;
     } else if (target == "avx512spr-x64") {
@@ -168,8 +176,22 @@ ISPCTarget ParseISPCTarget(std::string target) {
         return ISPCTarget::neon_i32x4;
     } else if (target == "neon-i32x8") {
         return ISPCTarget::neon_i32x8;
+    } else if (target == "sve-i32x8" || target == "sve") {
+        return ISPCTarget::sve_i32x8;
+    } else if (target == "sve-i32x16") {
+        return ISPCTarget::sve_i32x16;
+    } else if (target == "rvv-i32x4" || target == "rvv") {
+        return ISPCTarget::rvv_i32x4;
+    } else if (target == "rvv-i32x8") {
+        return ISPCTarget::rvv_i32x8;
     } else if (target == "wasm-i32x4") {
         return ISPCTarget::wasm_i32x4;
+    } else if (target == "wasm-i32x8") {
+        return ISPCTarget::wasm_i32x8;
+    } else if (target == "wasm-relaxed-i32x4") {
+        return ISPCTarget::wasm_relaxed_i32x4;
+    } else if (target == "wasm-relaxed-i32x8") {
+        return ISPCTarget::wasm_relaxed_i32x8;
     } else if (target == "gen9-x8") {
         return ISPCTarget::gen9_x8;
     } else if (target == "gen9-x16" || target == "gen9") {
@@ -273,6 +295,8 @@ std::string ISPCTargetToString(ISPCTarget target) {
         return "avx512skx-x8";
     case ISPCTarget::avx512skx_x16:
         return "avx512skx-x16";
+    case ISPCTarget::avx512skx_ymm_x16:
+        return "avx512skx-ymm-x16";
     case ISPCTarget::avx512skx_x32:
         return "avx512skx-x32";
     case ISPCTarget::avx512skx_x64:
@@ -283,6 +307,8 @@ std::string ISPCTargetToString(ISPCTarget target) {
         return "avx512spr-x8";
     case ISPCTarget::avx512spr_x16:
         return "avx512spr-x16";
+    case ISPCTarget::avx512spr_ymm_x16:
+        return "avx512spr-ymm-x16";
     case ISPCTarget::avx512spr_x32:
         return "avx512spr-x32";
     case ISPCTarget::avx512spr_x64:
@@ -295,8 +321,22 @@ std::string ISPCTargetToString(ISPCTarget target) {
         return "neon-i32x4";
     case ISPCTarget::neon_i32x8:
         return "neon-i32x8";
+    case ISPCTarget::sve_i32x8:
+        return "sve-i32x8";
+    case ISPCTarget::sve_i32x16:
+        return "sve-i32x16";
+    case ISPCTarget::rvv_i32x4:
+        return "rvv-i32x4";
+    case ISPCTarget::rvv_i32x8:
+        return "rvv-i32x8";
     case ISPCTarget::wasm_i32x4:
         return "wasm-i32x4";
+    case ISPCTarget::wasm_i32x8:
+        return "wasm-i32x8";
+    case ISPCTarget::wasm_relaxed_i32x4:
+        return "wasm-relaxed-i32x4";
+    case ISPCTarget::wasm_relaxed_i32x8:
+        return "wasm-relaxed-i32x8";
     case ISPCTarget::gen9_x8:
         return "gen9-x8";
     case ISPCTarget::gen9_x16:
@@ -348,11 +388,13 @@ bool ISPCTargetIsX86(ISPCTarget target) {
     case ISPCTarget::avx512skx_x4:
     case ISPCTarget::avx512skx_x8:
     case ISPCTarget::avx512skx_x16:
+    case ISPCTarget::avx512skx_ymm_x16:
     case ISPCTarget::avx512skx_x32:
     case ISPCTarget::avx512skx_x64:
     case ISPCTarget::avx512spr_x4:
     case ISPCTarget::avx512spr_x8:
     case ISPCTarget::avx512spr_x16:
+    case ISPCTarget::avx512spr_ymm_x16:
     case ISPCTarget::avx512spr_x32:
     case ISPCTarget::avx512spr_x64:
         return true;
@@ -373,9 +415,32 @@ bool ISPCTargetIsNeon(ISPCTarget target) {
     }
 }
 
+bool ISPCTargetIsSve(ISPCTarget target) {
+    switch (target) {
+    case ISPCTarget::sve_i32x8:
+    case ISPCTarget::sve_i32x16:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool ISPCTargetIsRvv(ISPCTarget target) {
+    switch (target) {
+    case ISPCTarget::rvv_i32x4:
+    case ISPCTarget::rvv_i32x8:
+        return true;
+    default:
+        return false;
+    }
+}
+
 bool ISPCTargetIsWasm(ISPCTarget target) {
     switch (target) {
     case ISPCTarget::wasm_i32x4:
+    case ISPCTarget::wasm_i32x8:
+    case ISPCTarget::wasm_relaxed_i32x4:
+    case ISPCTarget::wasm_relaxed_i32x8:
         return true;
     default:
         return false;
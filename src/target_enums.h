@@ -42,7 +42,7 @@
 
 namespace ispc {
 
-enum class CallingConv { uninitialized, defaultcall, x86_vectorcall };
+enum class CallingConv { uninitialized, defaultcall, x86_vectorcall, x86_regcall };
 
 enum class TargetOS { windows, linux, custom_linux, freebsd, macos, android, ios, ps4, ps5, web, error };
 
@@ -51,7 +51,7 @@ std::string OSToString(TargetOS os);
 std::string OSToLowerString(TargetOS os);
 TargetOS GetHostOS();
 
-enum class Arch { none, x86, x86_64, arm, aarch64, wasm32, xe32, xe64, error };
+enum class Arch { none, x86, x86_64, arm, aarch64, riscv64, wasm32, xe32, xe64, error };
 
 Arch ParseArch(std::string arch);
 std::string ArchToString(Arch arch);
@@ -83,18 +83,27 @@ enum class ISPCTarget {
     avx512skx_x4,
     avx512skx_x8,
     avx512skx_x16,
+    avx512skx_ymm_x16,
     avx512skx_x32,
     avx512skx_x64,
     avx512spr_x4,
     avx512spr_x8,
     avx512spr_x16,
+    avx512spr_ymm_x16,
     avx512spr_x32,
     avx512spr_x64,
     neon_i8x16,
     neon_i16x8,
     neon_i32x4,
     neon_i32x8,
+    sve_i32x8,
+    sve_i32x16,
+    rvv_i32x4,
+    rvv_i32x8,
     wasm_i32x4,
+    wasm_i32x8,
+    wasm_relaxed_i32x4,
+    wasm_relaxed_i32x8,
     gen9_x8,
     gen9_x16,
     xelp_x8,
@@ -111,6 +120,8 @@ std::pair<std::vector<ISPCTarget>, std::string> ParseISPCTargets(const char *tar
 std::string ISPCTargetToString(ISPCTarget target);
 bool ISPCTargetIsX86(ISPCTarget target);
 bool ISPCTargetIsNeon(ISPCTarget target);
+bool ISPCTargetIsSve(ISPCTarget target);
+bool ISPCTargetIsRvv(ISPCTarget target);
 bool ISPCTargetIsWasm(ISPCTarget target);
 bool ISPCTargetIsGen(ISPCTarget target);
 } // namespace ispc
@@ -177,6 +177,13 @@ const BitcodeLib *TargetLibRegistry::getISPCTargetLib(ISPCTarget target, TargetO
     case ISPCTarget::sse41_i32x8:
         target = ISPCTarget::sse4_i32x8;
         break;
+    // ymm variants differ from the regular targets only in the preferred vector width.
+    case ISPCTarget::avx512skx_ymm_x16:
+        target = ISPCTarget::avx512skx_x16;
+        break;
+    case ISPCTarget::avx512spr_ymm_x16:
+        target = ISPCTarget::avx512spr_x16;
+        break;
     default:
         // Fall through
         ;
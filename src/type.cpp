@@ -138,32 +138,57 @@ const Type *Type::ResolveDependenceForTopType(TemplateInstantiation &templInst)
 ///////////////////////////////////////////////////////////////////////////
 // AtomicType
 
-const AtomicType *AtomicType::UniformBool = new AtomicType(AtomicType::TYPE_BOOL, Variability::Uniform, false);
-const AtomicType *AtomicType::VaryingBool = new AtomicType(AtomicType::TYPE_BOOL, Variability::Varying, false);
-const AtomicType *AtomicType::UniformInt8 = new AtomicType(AtomicType::TYPE_INT8, Variability::Uniform, false);
-const AtomicType *AtomicType::VaryingInt8 = new AtomicType(AtomicType::TYPE_INT8, Variability::Varying, false);
-const AtomicType *AtomicType::UniformUInt8 = new AtomicType(AtomicType::TYPE_UINT8, Variability::Uniform, false);
-const AtomicType *AtomicType::VaryingUInt8 = new AtomicType(AtomicType::TYPE_UINT8, Variability::Varying, false);
-const AtomicType *AtomicType::UniformInt16 = new AtomicType(AtomicType::TYPE_INT16, Variability::Uniform, false);
-const AtomicType *AtomicType::VaryingInt16 = new AtomicType(AtomicType::TYPE_INT16, Variability::Varying, false);
-const AtomicType *AtomicType::UniformUInt16 = new AtomicType(AtomicType::TYPE_UINT16, Variability::Uniform, false);
-const AtomicType *AtomicType::VaryingUInt16 = new AtomicType(AtomicType::TYPE_UINT16, Variability::Varying, false);
-const AtomicType *AtomicType::UniformInt32 = new AtomicType(AtomicType::TYPE_INT32, Variability::Uniform, false);
-const AtomicType *AtomicType::VaryingInt32 = new AtomicType(AtomicType::TYPE_INT32, Variability::Varying, false);
-const AtomicType *AtomicType::UniformUInt32 = new AtomicType(AtomicType::TYPE_UINT32, Variability::Uniform, false);
-const AtomicType *AtomicType::VaryingUInt32 = new AtomicType(AtomicType::TYPE_UINT32, Variability::Varying, false);
-const AtomicType *AtomicType::UniformFloat16 = new AtomicType(AtomicType::TYPE_FLOAT16, Variability::Uniform, false);
-const AtomicType *AtomicType::VaryingFloat16 = new AtomicType(AtomicType::TYPE_FLOAT16, Variability::Varying, false);
-const AtomicType *AtomicType::UniformFloat = new AtomicType(AtomicType::TYPE_FLOAT, Variability::Uniform, false);
-const AtomicType *AtomicType::VaryingFloat = new AtomicType(AtomicType::TYPE_FLOAT, Variability::Varying, false);
-const AtomicType *AtomicType::UniformInt64 = new AtomicType(AtomicType::TYPE_INT64, Variability::Uniform, false);
-const AtomicType *AtomicType::VaryingInt64 = new AtomicType(AtomicType::TYPE_INT64, Variability::Varying, false);
-const AtomicType *AtomicType::UniformUInt64 = new AtomicType(AtomicType::TYPE_UINT64, Variability::Uniform, false);
-const AtomicType *AtomicType::VaryingUInt64 = new AtomicType(AtomicType::TYPE_UINT64, Variability::Varying, false);
-const AtomicType *AtomicType::UniformDouble = new AtomicType(AtomicType::TYPE_DOUBLE, Variability::Uniform, false);
-const AtomicType *AtomicType::VaryingDouble = new AtomicType(AtomicType::TYPE_DOUBLE, Variability::Varying, false);
-const AtomicType *AtomicType::Dependent = new AtomicType(AtomicType::TYPE_DEPENDENT, Variability::Uniform, false);
-const AtomicType *AtomicType::Void = new AtomicType(TYPE_VOID, Variability::Uniform, false);
+const AtomicType *AtomicType::UniformBool =
+    new (Persistent) AtomicType(AtomicType::TYPE_BOOL, Variability::Uniform, false);
+const AtomicType *AtomicType::VaryingBool =
+    new (Persistent) AtomicType(AtomicType::TYPE_BOOL, Variability::Varying, false);
+const AtomicType *AtomicType::UniformInt8 =
+    new (Persistent) AtomicType(AtomicType::TYPE_INT8, Variability::Uniform, false);
+const AtomicType *AtomicType::VaryingInt8 =
+    new (Persistent) AtomicType(AtomicType::TYPE_INT8, Variability::Varying, false);
+const AtomicType *AtomicType::UniformUInt8 =
+    new (Persistent) AtomicType(AtomicType::TYPE_UINT8, Variability::Uniform, false);
+const AtomicType *AtomicType::VaryingUInt8 =
+    new (Persistent) AtomicType(AtomicType::TYPE_UINT8, Variability::Varying, false);
+const AtomicType *AtomicType::UniformInt16 =
+    new (Persistent) AtomicType(AtomicType::TYPE_INT16, Variability::Uniform, false);
+const AtomicType *AtomicType::VaryingInt16 =
+    new (Persistent) AtomicType(AtomicType::TYPE_INT16, Variability::Varying, false);
+const AtomicType *AtomicType::UniformUInt16 =
+    new (Persistent) AtomicType(AtomicType::TYPE_UINT16, Variability::Uniform, false);
+const AtomicType *AtomicType::VaryingUInt16 =
+    new (Persistent) AtomicType(AtomicType::TYPE_UINT16, Variability::Varying, false);
+const AtomicType *AtomicType::UniformInt32 =
+    new (Persistent) AtomicType(AtomicType::TYPE_INT32, Variability::Uniform, false);
+const AtomicType *AtomicType::VaryingInt32 =
+    new (Persistent) AtomicType(AtomicType::TYPE_INT32, Variability::Varying, false);
+const AtomicType *AtomicType::UniformUInt32 =
+    new (Persistent) AtomicType(AtomicType::TYPE_UINT32, Variability::Uniform, false);
+const AtomicType *AtomicType::VaryingUInt32 =
+    new (Persistent) AtomicType(AtomicType::TYPE_UINT32, Variability::Varying, false);
+const AtomicType *AtomicType::UniformFloat16 =
+    new (Persistent) AtomicType(AtomicType::TYPE_FLOAT16, Variability::Uniform, false);
+const AtomicType *AtomicType::VaryingFloat16 =
+    new (Persistent) AtomicType(AtomicType::TYPE_FLOAT16, Variability::Varying, false);
+const AtomicType *AtomicType::UniformFloat =
+    new (Persistent) AtomicType(AtomicType::TYPE_FLOAT, Variability::Uniform, false);
+const AtomicType *AtomicType::VaryingFloat =
+    new (Persistent) AtomicType(AtomicType::TYPE_FLOAT, Variability::Varying, false);
+const AtomicType *AtomicType::UniformInt64 =
+    new (Persistent) AtomicType(AtomicType::TYPE_INT64, Variability::Uniform, false);
+const AtomicType *AtomicType::VaryingInt64 =
+    new (Persistent) AtomicType(AtomicType::TYPE_INT64, Variability::Varying, false);
+const AtomicType *AtomicType::UniformUInt64 =
+    new (Persistent) AtomicType(AtomicType::TYPE_UINT64, Variability::Uniform, false);
+const AtomicType *AtomicType::VaryingUInt64 =
+    new (Persistent) AtomicType(AtomicType::TYPE_UINT64, Variability::Varying, false);
+const AtomicType *AtomicType::UniformDouble =
+    new (Persistent) AtomicType(AtomicType::TYPE_DOUBLE, Variability::Uniform, false);
+const AtomicType *AtomicType::VaryingDouble =
+    new (Persistent) AtomicType(AtomicType::TYPE_DOUBLE, Variability::Varying, false);
+const AtomicType *AtomicType::Dependent =
+    new (Persistent) AtomicType(AtomicType::TYPE_DEPENDENT, Variability::Uniform, false);
+const AtomicType *AtomicType::Void = new (Persistent) AtomicType(TYPE_VOID, Variability::Uniform, false);
 
 AtomicType::AtomicType(BasicType bt, Variability v, bool ic)
     : Type(ATOMIC_TYPE), basicType(bt), variability(v), isConst(ic) {
@@ -264,6 +289,8 @@ const AtomicType *AtomicType::GetAsUnsignedType() const {
     }
 }
 
+void AtomicType::ResetCaches() const { asOtherConstType = asUniformType = asVaryingType = NULL; }
+
 const AtomicType *AtomicType::GetAsConstType() const {
     Assert(basicType != TYPE_DEPENDENT);
     if (isConst == true)
@@ -802,6 +829,127 @@ llvm::Type *TemplateTypeParmType::LLVMType(llvm::LLVMContext *ctx) const { UNREA
 // This should never be called.
 llvm::DIType *TemplateTypeParmType::GetDIType(llvm::DIScope *scope) const { UNREACHABLE(); }
 
+///////////////////////////////////////////////////////////////////////////
+// TemplateArg
+
+TemplateArg::TemplateArg(const Type *t, SourcePos p) : kind(ArgType::Type), type(t), expr(nullptr), pos(p) {}
+
+TemplateArg::TemplateArg(Expr *e, SourcePos p) : kind(ArgType::NonType), type(nullptr), expr(e), pos(p) {}
+
+const Type *TemplateArg::GetAsType() const {
+    Assert(kind == ArgType::Type);
+    return type;
+}
+
+Expr *TemplateArg::GetAsNonType() const {
+    Assert(kind == ArgType::NonType);
+    return expr;
+}
+
+bool TemplateArg::GetConstantValue(int32_t *value) const {
+    const ConstExpr *ce = llvm::dyn_cast_or_null<ConstExpr>(expr);
+    if (kind != ArgType::NonType || ce == nullptr || ce->Count() != 1) {
+        return false;
+    }
+    ce->GetValues(value);
+    return true;
+}
+
+void TemplateArg::SetAsVaryingType() {
+    if (kind == ArgType::Type && type != nullptr && type->GetVariability() == Variability::Unbound) {
+        type = type->GetAsVaryingType();
+    }
+}
+
+bool TemplateArg::FoldConstant() {
+    if (kind == ArgType::Type) {
+        return true;
+    }
+    if (expr == nullptr) {
+        Assert(m->errorCount > 0);
+        return false;
+    }
+    int32_t value;
+    if (GetConstantValue(&value) && Type::Equal(expr->GetType(), AtomicType::UniformInt32->GetAsConstType())) {
+        return true;
+    }
+
+    const Type *exprType = nullptr;
+    Expr *folded = ::TypeCheck(expr);
+    if (folded != nullptr) {
+        folded = ::Optimize(folded);
+    }
+    if (folded != nullptr) {
+        exprType = folded->GetType();
+    }
+    if (folded == nullptr || exprType == nullptr) {
+        Assert(m->errorCount > 0);
+        return false;
+    }
+    if (!llvm::isa<ConstExpr>(folded) || !exprType->IsIntType() || !exprType->IsUniformType() ||
+        CastType<AtomicType>(exprType) == nullptr) {
+        Error(pos, "Non-type template argument must be a uniform integer compile-time constant, found \"%s\".",
+              exprType->GetString().c_str());
+        return false;
+    }
+
+    const Type *int32Type = AtomicType::UniformInt32->GetAsConstType();
+    folded = ::Optimize(new TypeCastExpr(int32Type, folded, pos));
+    if (folded == nullptr || !llvm::isa<ConstExpr>(folded)) {
+        Assert(m->errorCount > 0);
+        return false;
+    }
+    expr = folded;
+    return true;
+}
+
+TemplateArg TemplateArg::Instantiate(TemplateInstantiation &templInst) const {
+    if (kind == ArgType::Type) {
+        return TemplateArg(type ? type->ResolveDependenceForTopType(templInst) : nullptr, pos);
+    }
+    return TemplateArg(expr ? expr->Instantiate(templInst) : nullptr, pos);
+}
+
+bool TemplateArg::IsEqual(const TemplateArg &other) const {
+    if (kind != other.kind) {
+        return false;
+    }
+    if (kind == ArgType::Type) {
+        return Type::Equal(type, other.type);
+    }
+    int32_t value, otherValue;
+    if (GetConstantValue(&value) && other.GetConstantValue(&otherValue)) {
+        return value == otherValue;
+    }
+    return expr == other.expr;
+}
+
+std::string TemplateArg::GetString() const {
+    if (kind == ArgType::Type) {
+        return type ? type->GetString() : "<NULL>";
+    }
+    int32_t value;
+    return GetConstantValue(&value) ? std::to_string(value) : "<dependent>";
+}
+
+std::string TemplateArg::Mangle() const {
+    if (kind == ArgType::Type) {
+        if (type == nullptr) {
+            Assert(m->errorCount > 0);
+            return "";
+        }
+        return type->Mangle();
+    }
+    // Non-type arguments are mangled as "L<value>E", with a leading "n"
+    // for negative values, similar to the Itanium C++ ABI.
+    int32_t value;
+    if (!GetConstantValue(&value)) {
+        Assert(m->errorCount > 0);
+        return "";
+    }
+    return value < 0 ? "Ln" + std::to_string(-(int64_t)value) + "E" : "L" + std::to_string(value) + "E";
+}
+
 ///////////////////////////////////////////////////////////////////////////
 // EnumType
 
@@ -973,6 +1121,9 @@ llvm::Type *EnumType::LLVMType(llvm::LLVMContext *ctx) const {
 }
 
 llvm::DIType *EnumType::GetDIType(llvm::DIScope *scope) const {
+    llvm::DIType *&cached = m->diTypeMap[this];
+    if (cached != NULL)
+        return cached;
 
     std::vector<llvm::Metadata *> enumeratorDescriptors;
     for (unsigned int i = 0; i < enumerators.size(); ++i) {
@@ -994,7 +1145,8 @@ llvm::DIType *EnumType::GetDIType(llvm::DIScope *scope) const {
                                             32 /* align in bits */, elementArray, underlyingType, name);
     switch (variability.type) {
     case Variability::Uniform:
-        return diType;
+        cached = diType;
+        break;
     case Variability::Varying: {
         llvm::Metadata *sub = m->diBuilder->getOrCreateSubrange(0, g->target->getVectorWidth());
 
@@ -1003,15 +1155,18 @@ llvm::DIType *EnumType::GetDIType(llvm::DIScope *scope) const {
         uint64_t width = g->target->getVectorWidth();
         uint64_t size = diType->getSizeInBits() * width;
         uint64_t align = diType->getAlignInBits() * width;
-        return m->diBuilder->createVectorType(size, align, diType, subArray);
+        cached = m->diBuilder->createVectorType(size, align, diType, subArray);
+        break;
     }
     case Variability::SOA: {
-        return lCreateDIArray(diType, variability.soaWidth);
+        cached = lCreateDIArray(diType, variability.soaWidth);
+        break;
     }
     default:
         FATAL("Unexpected variability in EnumType::GetDIType()");
         return NULL;
     }
+    return cached;
 }
 
 void EnumType::SetEnumerators(const std::vector<Symbol *> &e) { enumerators = e; }
@@ -1023,13 +1178,17 @@ const Symbol *EnumType::GetEnumerator(int i) const { return enumerators[i]; }
 ///////////////////////////////////////////////////////////////////////////
 // PointerType
 
-PointerType *PointerType::Void = new PointerType(AtomicType::Void, Variability(Variability::Uniform), false);
+PointerType *PointerType::Void =
+    new (Persistent) PointerType(AtomicType::Void, Variability(Variability::Uniform), false);
 
-PointerType::PointerType(const Type *t, Variability v, bool ic, bool is, bool fr, AddressSpace as)
-    : Type(POINTER_TYPE), variability(v), isConst(ic), isSlice(is), isFrozen(fr), addrSpace(as) {
+PointerType::PointerType(const Type *t, Variability v, bool ic, bool is, bool fr, AddressSpace as, bool ir)
+    : Type(POINTER_TYPE), variability(v), isConst(ic), isSlice(is), isFrozen(fr), addrSpace(as), isRestrict(ir) {
     baseType = t;
+    asOtherConstType = asUniformType = asVaryingType = NULL;
 }
 
+void PointerType::ResetCaches() const { asOtherConstType = asUniformType = asVaryingType = NULL; }
+
 PointerType *PointerType::GetUniform(const Type *t, bool is) {
     return new PointerType(t, Variability(Variability::Uniform), false, is);
 }
@@ -1059,53 +1218,59 @@ const Type *PointerType::GetBaseType() const { return baseType; }
 const PointerType *PointerType::GetAsVaryingType() const {
     if (variability == Variability::Varying)
         return this;
-    else
-        return new PointerType(baseType, Variability(Variability::Varying), isConst, isSlice, isFrozen);
+    if (asVaryingType == NULL)
+        asVaryingType = new PointerType(baseType, Variability(Variability::Varying), isConst, isSlice, isFrozen,
+                                     AddressSpace::ispc_default, isRestrict);
+    return asVaryingType;
 }
 
 const PointerType *PointerType::GetAsUniformType() const {
     if (variability == Variability::Uniform)
         return this;
-    else
-        return new PointerType(baseType, Variability(Variability::Uniform), isConst, isSlice, isFrozen);
+    if (asUniformType == NULL)
+        asUniformType = new PointerType(baseType, Variability(Variability::Uniform), isConst, isSlice, isFrozen,
+                                     AddressSpace::ispc_default, isRestrict);
+    return asUniformType;
 }
 
 const PointerType *PointerType::GetAsUnboundVariabilityType() const {
     if (variability == Variability::Unbound)
         return this;
     else
-        return new PointerType(baseType, Variability(Variability::Unbound), isConst, isSlice, isFrozen);
+        return new PointerType(baseType, Variability(Variability::Unbound), isConst, isSlice, isFrozen,
+                               AddressSpace::ispc_default, isRestrict);
 }
 
 const PointerType *PointerType::GetAsSOAType(int width) const {
     if (GetSOAWidth() == width)
         return this;
     else
-        return new PointerType(baseType, Variability(Variability::SOA, width), isConst, isSlice, isFrozen);
+        return new PointerType(baseType, Variability(Variability::SOA, width), isConst, isSlice, isFrozen,
+                               AddressSpace::ispc_default, isRestrict);
 }
 
 const PointerType *PointerType::GetAsSlice() const {
     if (isSlice)
         return this;
-    return new PointerType(baseType, variability, isConst, true);
+    return new PointerType(baseType, variability, isConst, true, false, AddressSpace::ispc_default, isRestrict);
 }
 
 const PointerType *PointerType::GetAsNonSlice() const {
     if (isSlice == false)
         return this;
-    return new PointerType(baseType, variability, isConst, false);
+    return new PointerType(baseType, variability, isConst, false, false, AddressSpace::ispc_default, isRestrict);
 }
 
 const PointerType *PointerType::GetAsFrozenSlice() const {
     if (isFrozen)
         return this;
-    return new PointerType(baseType, variability, isConst, true, true);
+    return new PointerType(baseType, variability, isConst, true, true, AddressSpace::ispc_default, isRestrict);
 }
 
 const PointerType *PointerType::GetWithAddrSpace(AddressSpace as) const {
     if (addrSpace == as)
         return this;
-    return new PointerType(baseType, variability, isConst, isSlice, isFrozen, as);
+    return new PointerType(baseType, variability, isConst, isSlice, isFrozen, as, isRestrict);
 }
 
 const PointerType *PointerType::ResolveDependence(TemplateInstantiation &templInst) const {
@@ -1119,7 +1284,8 @@ const PointerType *PointerType::ResolveDependence(TemplateInstantiation &templIn
         return this;
     }
 
-    const PointerType *pType = new PointerType(resType, variability, isConst, isSlice, isFrozen);
+    const PointerType *pType =
+        new PointerType(resType, variability, isConst, isSlice, isFrozen, AddressSpace::ispc_default, isRestrict);
     return pType;
 }
 
@@ -1132,21 +1298,33 @@ const PointerType *PointerType::ResolveUnboundVariability(Variability v) const {
     Assert(v != Variability::Unbound);
     Variability ptrVariability = (variability == Variability::Unbound) ? v : variability;
     const Type *resolvedBaseType = baseType->ResolveUnboundVariability(Variability::Uniform);
-    return new PointerType(resolvedBaseType, ptrVariability, isConst, isSlice, isFrozen);
+    return new PointerType(resolvedBaseType, ptrVariability, isConst, isSlice, isFrozen, AddressSpace::ispc_default,
+                           isRestrict);
 }
 
 const PointerType *PointerType::GetAsConstType() const {
     if (isConst == true)
         return this;
-    else
-        return new PointerType(baseType, variability, true, isSlice);
+    if (asOtherConstType == NULL)
+        asOtherConstType =
+            new PointerType(baseType, variability, true, isSlice, false, AddressSpace::ispc_default, isRestrict);
+    return asOtherConstType;
 }
 
 const PointerType *PointerType::GetAsNonConstType() const {
     if (isConst == false)
         return this;
+    if (asOtherConstType == NULL)
+        asOtherConstType =
+            new PointerType(baseType, variability, false, isSlice, false, AddressSpace::ispc_default, isRestrict);
+    return asOtherConstType;
+}
+
+const PointerType *PointerType::GetAsRestrictType() const {
+    if (isRestrict == true)
+        return this;
     else
-        return new PointerType(baseType, variability, false, isSlice);
+        return new PointerType(baseType, variability, isConst, isSlice, isFrozen, addrSpace, true);
 }
 
 std::string PointerType::GetString() const {
@@ -1160,6 +1338,8 @@ std::string PointerType::GetString() const {
     ret += std::string(" * ");
     if (isConst)
         ret += "const ";
+    if (isRestrict)
+        ret += "restrict ";
     if (isSlice)
         ret += "slice ";
     if (isFrozen)
@@ -1208,6 +1388,8 @@ std::string PointerType::GetCDeclaration(const std::string &name) const {
     tempName += std::string(" *");
     if (isConst)
         tempName += " const";
+    if (isRestrict)
+        tempName += " __restrict";
     tempName += std::string(" ");
     tempName += name;
     if (baseIsBasicVarying || baseIsFunction)
@@ -1337,7 +1519,8 @@ const Type *SequentialType::GetElementType(int index) const { return GetElementT
 ///////////////////////////////////////////////////////////////////////////
 // ArrayType
 
-ArrayType::ArrayType(const Type *c, int a) : SequentialType(ARRAY_TYPE), child(c), numElements(a) {
+ArrayType::ArrayType(const Type *c, int a)
+    : SequentialType(ARRAY_TYPE), child(c), numElements(a), asUniformType(NULL), asVaryingType(NULL) {
     // 0 -> unsized array.
     Assert(numElements >= 0);
     Assert(c->IsVoidType() == false);
@@ -1387,7 +1570,9 @@ const ArrayType *ArrayType::GetAsVaryingType() const {
         Assert(m->errorCount > 0);
         return NULL;
     }
-    return new ArrayType(child->GetAsVaryingType(), numElements);
+    if (asVaryingType == NULL)
+        asVaryingType = new ArrayType(child->GetAsVaryingType(), numElements);
+    return asVaryingType;
 }
 
 const ArrayType *ArrayType::GetAsUniformType() const {
@@ -1395,7 +1580,9 @@ const ArrayType *ArrayType::GetAsUniformType() const {
         Assert(m->errorCount > 0);
         return NULL;
     }
-    return new ArrayType(child->GetAsUniformType(), numElements);
+    if (asUniformType == NULL)
+        asUniformType = new ArrayType(child->GetAsUniformType(), numElements);
+    return asUniformType;
 }
 
 const ArrayType *ArrayType::GetAsUnboundVariabilityType() const {
@@ -1623,7 +1810,8 @@ const Type *ArrayType::SizeUnsizedArrays(const Type *type, Expr *initExpr) {
 ///////////////////////////////////////////////////////////////////////////
 // VectorType
 
-VectorType::VectorType(const AtomicType *b, int a) : SequentialType(VECTOR_TYPE), base(b), numElements(a) {
+VectorType::VectorType(const AtomicType *b, int a)
+    : SequentialType(VECTOR_TYPE), base(b), numElements(a), asUniformType(NULL), asVaryingType(NULL) {
     Assert(numElements > 0);
     Assert(base != NULL);
 }
@@ -1642,9 +1830,17 @@ bool VectorType::IsConstType() const { return base->IsConstType(); }
 
 const Type *VectorType::GetBaseType() const { return base; }
 
-const VectorType *VectorType::GetAsVaryingType() const { return new VectorType(base->GetAsVaryingType(), numElements); }
+const VectorType *VectorType::GetAsVaryingType() const {
+    if (asVaryingType == NULL)
+        asVaryingType = new VectorType(base->GetAsVaryingType(), numElements);
+    return asVaryingType;
+}
 
-const VectorType *VectorType::GetAsUniformType() const { return new VectorType(base->GetAsUniformType(), numElements); }
+const VectorType *VectorType::GetAsUniformType() const {
+    if (asUniformType == NULL)
+        asUniformType = new VectorType(base->GetAsUniformType(), numElements);
+    return asUniformType;
+}
 
 const VectorType *VectorType::GetAsUnboundVariabilityType() const {
     return new VectorType(base->GetAsUnboundVariabilityType(), numElements);
@@ -1841,7 +2037,7 @@ StructType::StructType(const std::string &n, const llvm::SmallVector<const Type
                        Variability v, bool ia, SourcePos p)
     : CollectionType(STRUCT_TYPE), name(n), elementTypes(elts), elementNames(en), elementPositions(ep), variability(v),
       isConst(ic), isAnonymous(ia), pos(p) {
-    oppositeConstStructType = NULL;
+    oppositeConstStructType = asUniformType = asVaryingType = NULL;
     finalElementTypes.resize(elts.size(), NULL);
 
     static int count = 0;
@@ -1951,17 +2147,19 @@ const Type *StructType::GetBaseType() const { return this; }
 const StructType *StructType::GetAsVaryingType() const {
     if (IsVaryingType())
         return this;
-    else
-        return new StructType(name, elementTypes, elementNames, elementPositions, isConst,
-                              Variability(Variability::Varying), isAnonymous, pos);
+    if (asVaryingType == NULL)
+        asVaryingType = new StructType(name, elementTypes, elementNames, elementPositions, isConst,
+                                    Variability(Variability::Varying), isAnonymous, pos);
+    return asVaryingType;
 }
 
 const StructType *StructType::GetAsUniformType() const {
     if (IsUniformType())
         return this;
-    else
-        return new StructType(name, elementTypes, elementNames, elementPositions, isConst,
-                              Variability(Variability::Uniform), isAnonymous, pos);
+    if (asUniformType == NULL)
+        asUniformType = new StructType(name, elementTypes, elementNames, elementPositions, isConst,
+                                    Variability(Variability::Uniform), isAnonymous, pos);
+    return asUniformType;
 }
 
 const StructType *StructType::GetAsUnboundVariabilityType() const {
@@ -2100,6 +2298,10 @@ llvm::Type *StructType::LLVMType(llvm::LLVMContext *ctx) const {
 
 // Versioning of this function becomes really messy, so versioning the whole function.
 llvm::DIType *StructType::GetDIType(llvm::DIScope *scope) const {
+    llvm::DIType *&cached = m->diTypeMap[this];
+    if (cached != NULL)
+        return cached;
+
     llvm::Type *llvm_type = LLVMStorageType(g->ctx);
     auto &dataLayout = m->module->getDataLayout();
     auto layout = dataLayout.getStructLayout(llvm::dyn_cast_or_null<llvm::StructType>(llvm_type));
@@ -2127,12 +2329,13 @@ llvm::DIType *StructType::GetDIType(llvm::DIScope *scope) const {
     llvm::DINodeArray elements = m->diBuilder->getOrCreateArray(elementLLVMTypes);
     llvm::DIFile *diFile = pos.GetDIFile();
     llvm::DINamespace *diSpace = pos.GetDINamespace();
-    return m->diBuilder->createStructType(diSpace, GetString(), diFile,
-                                          pos.first_line,                     // Line number
-                                          layout->getSizeInBits(),            // Size in bits
-                                          layout->getAlignment().value() * 8, // Alignment in bits
-                                          llvm::DINode::FlagZero,             // Flags
-                                          NULL, elements);
+    cached = m->diBuilder->createStructType(diSpace, GetString(), diFile,
+                                            pos.first_line,                     // Line number
+                                            layout->getSizeInBits(),            // Size in bits
+                                            layout->getAlignment().value() * 8, // Alignment in bits
+                                            llvm::DINode::FlagZero,             // Flags
+                                            NULL, elements);
+    return cached;
 }
 
 const Type *StructType::GetElementType(int i) const {
@@ -2568,6 +2771,7 @@ FunctionType::FunctionType(const Type *r, const llvm::SmallVector<const Type *,
     Assert(returnType != NULL);
     isSafe = false;
     costOverride = -1;
+    denormals = Denormals::Default;
 }
 
 FunctionType::FunctionType(const Type *r, const llvm::SmallVector<const Type *, 8> &a,
@@ -2582,6 +2786,7 @@ FunctionType::FunctionType(const Type *r, const llvm::SmallVector<const Type *,
     Assert(returnType != NULL);
     isSafe = false;
     costOverride = -1;
+    denormals = Denormals::Default;
 }
 
 Variability FunctionType::GetVariability() const { return Variability(Variability::Uniform); }
@@ -2598,6 +2803,10 @@ bool FunctionType::IsConstType() const { return false; }
 
 bool FunctionType::IsISPCKernel() const { return g->target->isXeTarget() && isTask; }
 
+bool FunctionType::FlushesDenormals() const {
+    return denormals == Denormals::Default ? g->flushDenormals : denormals == Denormals::Flush;
+}
+
 bool FunctionType::IsISPCExternal() const {
     return g->target->isXeTarget() && (isExported || isExternC || isExternSYCL);
 }
@@ -2648,6 +2857,8 @@ const FunctionType *FunctionType::ResolveDependence(TemplateInstantiation &templ
                                          isExternC, isExternSYCL, isUnmasked, isVectorCall, isRegCall);
     ret->isSafe = isSafe;
     ret->costOverride = costOverride;
+    ret->targetClones = targetClones;
+    ret->denormals = denormals;
     return ret;
 }
 
@@ -2671,6 +2882,8 @@ const FunctionType *FunctionType::ResolveUnboundVariability(Variability v) const
                                          isExternC, isExternSYCL, isUnmasked, isVectorCall, isRegCall);
     ret->isSafe = isSafe;
     ret->costOverride = costOverride;
+    ret->targetClones = targetClones;
+    ret->denormals = denormals;
 
     return ret;
 }
@@ -2833,23 +3046,19 @@ const std::string FunctionType::GetReturnTypeString() const {
     return ret + returnType->GetString();
 }
 
-std::string FunctionType::mangleTemplateArgs(std::vector<const Type *> *templateArgs) const {
+std::string FunctionType::mangleTemplateArgs(std::vector<TemplateArg> *templateArgs) const {
     if (templateArgs == nullptr) {
         return "";
     }
     std::string ret = "___";
-    for (const Type *arg : *templateArgs) {
-        if (arg) {
-            ret += arg->Mangle();
-        } else {
-            Assert(m->errorCount > 0);
-        }
+    for (const TemplateArg &arg : *templateArgs) {
+        ret += arg.Mangle();
     }
     return ret;
 }
 
 FunctionType::FunctionMangledName FunctionType::GetFunctionMangledName(bool appFunction,
-                                                                       std::vector<const Type *> *templateArgs) const {
+                                                                       std::vector<TemplateArg> *templateArgs) const {
     FunctionMangledName mangle = {};
     // Mangle internal functions name.
     if (!(isExternC || isExternSYCL || appFunction)) {
@@ -2859,7 +3068,7 @@ FunctionType::FunctionMangledName FunctionType::GetFunctionMangledName(bool appF
     // Always add target suffix except extern "C" and extern "SYCL" internal cases.
     if (g->mangleFunctionsWithTarget) {
         if ((!appFunction && !isExternC && !isExternSYCL) || appFunction) {
-            mangle.suffix += std::string("_") + g->target->GetISAString();
+            mangle.suffix += "_" + g->target->GetVariantString();
         }
     }
     // If the function is declared as regcall, add __regcall3__ prefix.
@@ -2990,6 +3199,12 @@ const unsigned int FunctionType::GetCallingConv() const {
         if ((isVectorCall && isExternC) || !isExternC)
             return (unsigned int)llvm::CallingConv::X86_VectorCall;
     }
+    // With --regcall the functions called from ispc code only pass the varying values in registers. Tasks are
+    // launched by the runtime, so they keep the C calling convention.
+    if (g->calling_conv == CallingConv::x86_regcall) {
+        if (!isExternC && !isExternSYCL && !isTask)
+            return (unsigned int)llvm::CallingConv::X86_RegCall;
+    }
     return (unsigned int)llvm::CallingConv::C;
 }
 
@@ -3240,6 +3455,10 @@ static bool lCheckTypeEquality(const Type *a, const Type *b, bool ignoreConst) {
     if (a == NULL || b == NULL)
         return false;
 
+    // Derived types are memoized, so equal types are often the same instance.
+    if (a == b)
+        return true;
+
     if (ignoreConst == false && a->IsConstType() != b->IsConstType())
         return false;
 
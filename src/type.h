@@ -304,6 +304,7 @@ class AtomicType : public Type {
     const AtomicType *ResolveDependence(TemplateInstantiation &templInst) const;
     const AtomicType *ResolveUnboundVariability(Variability v) const;
     const AtomicType *GetAsUnsignedType() const;
+    void ResetCaches() const;
     const AtomicType *GetAsConstType() const;
     const AtomicType *GetAsNonConstType() const;
 
@@ -406,6 +407,55 @@ class TemplateTypeParmType : public Type {
     mutable const TemplateTypeParmType *asOtherConstType, *asUniformType, *asVaryingType;
 };
 
+/** @brief Template argument.
+
+    A template argument is either a type (for "typename" template parameters)
+    or an expression (for non-type template parameters, like "uniform int N").
+    Non-type arguments are evaluated to uniform int32 constants before the
+    template is instantiated; until then, inside of a template, they may
+    depend on the non-type parameters of the enclosing template.
+ */
+class TemplateArg {
+  public:
+    enum class ArgType { Type, NonType };
+
+    TemplateArg(const Type *t, SourcePos pos);
+    TemplateArg(Expr *e, SourcePos pos);
+
+    ArgType GetKind() const { return kind; }
+    bool IsType() const { return kind == ArgType::Type; }
+    bool IsNonType() const { return kind == ArgType::NonType; }
+
+    const Type *GetAsType() const;
+    Expr *GetAsNonType() const;
+    const SourcePos &GetPos() const { return pos; }
+
+    /** Returns true if the argument is a non-type argument, which was
+        evaluated to a compile-time constant and stores its value in
+        \c value. */
+    bool GetConstantValue(int32_t *value) const;
+
+    /** Applies the "varying by default" rule to type arguments with
+        unbound variability. */
+    void SetAsVaryingType();
+
+    /** Evaluates a non-type argument to a uniform int32 constant.  Issues
+        an error and returns false if it isn't a compile-time constant. */
+    bool FoldConstant();
+
+    TemplateArg Instantiate(TemplateInstantiation &templInst) const;
+
+    bool IsEqual(const TemplateArg &other) const;
+    std::string GetString() const;
+    std::string Mangle() const;
+
+  private:
+    ArgType kind;
+    const Type *type;
+    Expr *expr;
+    SourcePos pos;
+};
+
 /** @brief Type implementation for enumerated types
  *
  *  Note that ISPC enum assumes 32 bit int as underlying type.
@@ -487,7 +537,7 @@ class EnumType : public Type {
 class PointerType : public Type {
   public:
     PointerType(const Type *t, Variability v, bool isConst, bool isSlice = false, bool frozen = false,
-                AddressSpace as = AddressSpace::ispc_default);
+                AddressSpace as = AddressSpace::ispc_default, bool isRestrict = false);
 
     /** Helper method to return a uniform pointer to the given type. */
     static PointerType *GetUniform(const Type *t, bool isSlice = false);
@@ -507,6 +557,10 @@ class PointerType : public Type {
 
     bool IsSlice() const { return isSlice; }
     bool IsFrozenSlice() const { return isFrozen; }
+    /** Returns true if the pointer is qualified with "restrict", so that
+        nothing else accesses the memory accessed through it. */
+    bool IsRestrict() const { return isRestrict; }
+    const PointerType *GetAsRestrictType() const;
     const PointerType *GetAsSlice() const;
     const PointerType *GetAsNonSlice() const;
     const PointerType *GetAsFrozenSlice() const;
@@ -519,6 +573,7 @@ class PointerType : public Type {
 
     const PointerType *ResolveDependence(TemplateInstantiation &templInst) const;
     const PointerType *ResolveUnboundVariability(Variability v) const;
+    void ResetCaches() const;
     const PointerType *GetAsConstType() const;
     const PointerType *GetAsNonConstType() const;
     const PointerType *GetWithAddrSpace(AddressSpace as) const;
@@ -539,6 +594,11 @@ class PointerType : public Type {
     const bool isSlice, isFrozen;
     const Type *baseType;
     const AddressSpace addrSpace;
+    const bool isRestrict;
+
+    /** Derived pointer types, memoized so that deriving the same type
+        again returns the same instance. */
+    mutable const PointerType *asOtherConstType, *asUniformType, *asVaryingType;
 };
 
 /** @brief Abstract base class for types that represent collections of
@@ -657,6 +717,8 @@ class ArrayType : public SequentialType {
     const Type *const child;
     /** Number of elements in the array. */
     const int numElements;
+
+    mutable const ArrayType *asUniformType, *asVaryingType;
 };
 
 /** @brief A (short) vector of atomic types.
@@ -712,6 +774,8 @@ class VectorType : public SequentialType {
     /** Number of elements in the vector */
     const int numElements;
 
+    mutable const VectorType *asUniformType, *asVaryingType;
+
   public:
     /** Returns the number of elements stored in memory for the vector.
         For uniform vectors, this is rounded up so that the number of
@@ -809,6 +873,7 @@ class StructType : public CollectionType {
     mutable llvm::SmallVector<const Type *, 8> finalElementTypes;
 
     mutable const StructType *oppositeConstStructType;
+    mutable const StructType *asUniformType, *asVaryingType;
 };
 
 /** Type implementation representing a struct name that has been declared
@@ -960,7 +1025,7 @@ class FunctionType : public Type {
         The \c appFunction parameter indicates whether the function is generated for
         internal ISPC call or for external call from application.*/
     FunctionMangledName GetFunctionMangledName(bool appFunction,
-                                               std::vector<const Type *> *templateArgs = nullptr) const;
+                                               std::vector<TemplateArg> *templateArgs = nullptr) const;
 
     /** This method returns std::vector of LLVM types of function arguments.
         The \c disableMask parameter indicates whether the mask parameter should be
@@ -1020,8 +1085,21 @@ class FunctionType : public Type {
         function estimate for the function. */
     int costOverride;
 
+    /** Targets, in addition to the one being compiled to, that the function
+        is cloned for with __declspec(target_clones(...)). */
+    std::vector<ISPCTarget> targetClones;
+
+    /** How the function handles denormals when it's called by the
+        application, as given with __declspec(denormals(...)); Default
+        follows --denormals. */
+    enum class Denormals { Default, Preserve, Flush };
+    Denormals denormals;
+
+    /** Returns true if the function runs with denormals flushed to zero. */
+    bool FlushesDenormals() const;
+
   private:
-    std::string mangleTemplateArgs(std::vector<const Type *> *templateArgs) const;
+    std::string mangleTemplateArgs(std::vector<TemplateArg> *templateArgs) const;
 
     const Type *const returnType;
 
@@ -97,7 +97,12 @@ extern void CALLINGCONV print_result_cpu_entry_point();
 
 void ISPCLaunch(void **handlePtr, void *f, void *d, int, int, int);
 void ISPCSync(void *handle);
+void ISPCLaunchAfter(void **handlePtr, void *f, void *d, int, int, int, const int64_t *, int);
+void ISPCLaunchWithHints(void **handlePtr, void *f, void *d, int, int, int, const int64_t *, int, int, int, int);
 void *ISPCAlloc(void **handlePtr, int64_t size, int32_t alignment);
+void *ISPCWorkerScratch(int64_t size);
+void ISPCCancelTasks();
+int ISPCTasksCancelled();
 }
 
 int width() {
@@ -108,15 +113,40 @@ int width() {
 #endif
 }
 
+// Tasks are run as they're launched, so ISPCCancelTasks() skips the rest of
+// the launch being run; it's cleared when the outermost launch returns.
+static bool tasksCancelled = false;
+static int launchDepth = 0;
+
 void ISPCLaunch(void **handle, void *f, void *d, int count0, int count1, int count2) {
     *handle = (void *)(uintptr_t)0xdeadbeef;
     typedef void (*TaskFuncType)(void *, int, int, int, int, int, int, int, int, int, int);
     TaskFuncType func = (TaskFuncType)f;
     int count = count0 * count1 * count2, idx = 0;
+    ++launchDepth;
     for (int k = 0; k < count2; ++k)
         for (int j = 0; j < count1; ++j)
-            for (int i = 0; i < count0; ++i)
+            for (int i = 0; i < count0 && !tasksCancelled; ++i)
                 func(d, 0, 1, idx++, count, i, j, k, count0, count1, count2);
+    if (--launchDepth == 0)
+        tasksCancelled = false;
+}
+
+void ISPCCancelTasks() {
+    if (launchDepth > 0)
+        tasksCancelled = true;
+}
+
+int ISPCTasksCancelled() { return tasksCancelled; }
+
+// Launches run to completion right away, so there's never anything to wait for.
+void ISPCLaunchAfter(void **handle, void *f, void *d, int count0, int count1, int count2, const int64_t *, int) {
+    ISPCLaunch(handle, f, d, count0, count1, count2);
+}
+
+void ISPCLaunchWithHints(void **handle, void *f, void *d, int count0, int count1, int count2, const int64_t *, int,
+                         int, int, int) {
+    ISPCLaunch(handle, f, d, count0, count1, count2);
 }
 
 void ISPCSync(void *) {}
@@ -139,6 +169,19 @@ void *ISPCAlloc(void **handle, int64_t size, int32_t alignment) {
 #endif
 }
 
+// Tasks are all run by the calling thread, so there's a single slab.
+void *ISPCWorkerScratch(int64_t size) {
+    static void *scratch = NULL;
+    static int64_t scratchSize = 0;
+    if (scratch == NULL || size > scratchSize) {
+        void *handle;
+        int64_t grown = scratchSize > 0 ? scratchSize * 2 : 64;
+        scratchSize = size > grown ? size : grown;
+        scratch = ISPCAlloc(&handle, scratchSize, 64);
+    }
+    return scratch;
+}
+
 #if defined(_WIN32) || defined(_WIN64)
 #define ALIGN __declspec(align(64))
 #else
@@ -0,0 +1,16 @@
+// See codegen_threads.ispc for run recipe.
+
+#include <stdio.h>
+
+extern float sum(float a[], int count);
+extern void scale(float a[], int count);
+extern float max_value(float a[], int count);
+
+int main() {
+    float a[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    printf("sum: %d\n", (int)sum(a, 8));
+    printf("max: %d\n", (int)max_value(a, 8));
+    scale(a, 8);
+    printf("scaled: %d\n", (int)sum(a, 8));
+    return 0;
+}
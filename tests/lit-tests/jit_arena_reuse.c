@@ -0,0 +1,74 @@
+// See jit_arena_reuse.ispc for run recipe.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ispc_jit.h"
+
+static char *readFile(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *text = (char *)malloc(size + 1);
+    size_t read = fread(text, 1, size, f);
+    text[read] = '\0';
+    fclose(f);
+    return text;
+}
+
+static const char *other = "export void scale(uniform int a[], uniform int factor, uniform int count) {\n"
+                           "    foreach (i = 0 ... count)\n"
+                           "        a[i] *= factor;\n"
+                           "}\n";
+
+typedef struct {
+    float x, y;
+} Point;
+
+typedef float (*LengthFn)(Point *, int);
+typedef void (*ScaleFn)(int *, int, int);
+
+int main(int argc, char *argv[]) {
+    char *source = argc > 1 ? readFile(argv[1]) : NULL;
+    if (source == NULL) {
+        printf("can't read the source\n");
+        return 1;
+    }
+    Point points[16];
+    for (int i = 0; i < 16; ++i) {
+        points[i].x = (float)i;
+        points[i].y = 1.0f;
+    }
+
+    int compilations = 0, mismatches = 0;
+    for (int iter = 0; iter < 20; ++iter) {
+        ISPCJIT jit = ispcCompileToJIT(source, NULL);
+        if (jit == NULL)
+            return 1;
+        ++compilations;
+        // 0^2 + ... + 15^2 + 16 * 1^2
+        if ((int)((LengthFn)ispcJITLookup(jit, "total_length2"))(points, 16) != 1256)
+            ++mismatches;
+        ispcJITRelease(jit);
+
+        jit = ispcCompileToJIT(other, NULL);
+        if (jit == NULL)
+            return 1;
+        ++compilations;
+        int a[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+        ((ScaleFn)ispcJITLookup(jit, "scale"))(a, 3, 8);
+        for (int i = 0; i < 8; ++i)
+            if (a[i] != 3 * (i + 1))
+                ++mismatches;
+        ispcJITRelease(jit);
+
+        ispcJITClearCache();
+    }
+    printf("compilations: %d\n", compilations);
+    printf("mismatches: %d\n", mismatches);
+    free(source);
+    return 0;
+}
@@ -0,0 +1,67 @@
+// See jit_bindings.ispc for run recipe.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ispc_jit.h"
+
+static char *readFile(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *text = (char *)malloc(size + 1);
+    size_t read = fread(text, 1, size, f);
+    text[read] = '\0';
+    fclose(f);
+    return text;
+}
+
+typedef void (*DivideFn)(int *, int, int);
+typedef float (*ScaledFn)(float, float);
+
+static ISPCJIT compile(const char *source, int64_t divisor, double scale) {
+    ISPCJITBinding bindings[2] = {{"divide", "divisor", 0, divisor, 0.0}, {"scaled", "scale", 1, 0, scale}};
+    ISPCJITOptions options;
+    ispcJITOptionsInit(&options);
+    options.bindings = bindings;
+    options.numBindings = 2;
+    return ispcCompileToJIT(source, &options);
+}
+
+static void run(ISPCJIT jit, int divisor) {
+    int a[5] = {0, 4, 8, 12, 100};
+    ((DivideFn)ispcJITLookup(jit, "divide"))(a, 1, 5);
+    printf("divisor %d: %d %d %d %d %d\n", divisor, a[0], a[1], a[2], a[3], a[4]);
+}
+
+int main(int argc, char *argv[]) {
+    char *source = argc > 1 ? readFile(argv[1]) : NULL;
+    if (source == NULL) {
+        printf("can't read the source\n");
+        return 1;
+    }
+    ISPCJIT by4 = compile(source, 4, 0.5);
+    ISPCJIT by8 = compile(source, 8, 0.5);
+    if (by4 == NULL || by8 == NULL)
+        return 1;
+    run(by4, 4);
+    run(by8, 8);
+    printf("scale 0.5: %d\n", (int)((ScaledFn)ispcJITLookup(by4, "scaled"))(100.0f, 1.0f));
+
+    // Different bound values give different variants, the same values give
+    // the variant that is already in the cache.
+    ISPCJIT again = compile(source, 4, 0.5);
+    if (again == NULL)
+        return 1;
+    printf("distinct variants: %d\n", ispcJITLookup(by4, "divide") != ispcJITLookup(by8, "divide"));
+    printf("cached variant: %d\n", ispcJITLookup(again, "divide") == ispcJITLookup(by4, "divide"));
+
+    ispcJITRelease(again);
+    ispcJITRelease(by8);
+    ispcJITRelease(by4);
+    free(source);
+    return 0;
+}
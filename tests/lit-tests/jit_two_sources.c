@@ -0,0 +1,66 @@
+// See jit_two_sources.ispc for run recipe.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ispc_jit.h"
+
+static char *readFile(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *text = (char *)malloc(size + 1);
+    size_t read = fread(text, 1, size, f);
+    text[read] = '\0';
+    fclose(f);
+    return text;
+}
+
+// Uses the same predefined types as the source of the test, and derives
+// const and varying types from them.
+static const char *second = "export uniform float dot(const uniform float a[], const uniform float b[],\n"
+                            "                         uniform int count) {\n"
+                            "    varying float s = 0;\n"
+                            "    foreach (i = 0 ... count)\n"
+                            "        s += a[i] * b[i];\n"
+                            "    return reduce_add(s);\n"
+                            "}\n";
+
+typedef float (*SumFn)(float *, int);
+typedef float (*DotFn)(const float *, const float *, int);
+
+int main(int argc, char *argv[]) {
+    char *first = argc > 1 ? readFile(argv[1]) : NULL;
+    if (first == NULL) {
+        printf("can't read the source\n");
+        return 1;
+    }
+    float a[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    float b[8] = {2, 2, 2, 2, 2, 2, 2, 2};
+
+    ISPCJIT jitA = ispcCompileToJIT(first, NULL);
+    if (jitA == NULL)
+        return 1;
+    printf("sum: %d\n", (int)((SumFn)ispcJITLookup(jitA, "sum"))(a, 8));
+
+    ISPCJIT jitB = ispcCompileToJIT(second, NULL);
+    if (jitB == NULL)
+        return 1;
+    printf("dot: %d\n", (int)((DotFn)ispcJITLookup(jitB, "dot"))(a, b, 4));
+
+    // Compile the first source again rather than taking it from the cache.
+    ispcJITRelease(jitA);
+    ispcJITClearCache();
+    jitA = ispcCompileToJIT(first, NULL);
+    if (jitA == NULL)
+        return 1;
+    printf("sum again: %d\n", (int)((SumFn)ispcJITLookup(jitA, "sum"))(a, 8));
+
+    ispcJITRelease(jitA);
+    ispcJITRelease(jitB);
+    free(first);
+    return 0;
+}